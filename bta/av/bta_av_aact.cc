@@ -524,8 +524,11 @@ void bta_av_sink_data_cback(uint8_t handle, BT_HDR* p_pkt, uint32_t time_stamp,
     return;
   }
   p_pkt->event = BTA_AV_SINK_MEDIA_DATA_EVT;
+  tBTA_AV_MEDIA av_media;
+  av_media.avk_data.p_pkt = p_pkt;
+  av_media.avk_data.time_stamp = time_stamp;
   p_scb->seps[p_scb->sep_idx].p_app_sink_data_cback(
-      p_scb->PeerAddress(), BTA_AV_SINK_MEDIA_DATA_EVT, (tBTA_AV_MEDIA*)p_pkt);
+      p_scb->PeerAddress(), BTA_AV_SINK_MEDIA_DATA_EVT, &av_media);
   /* Free the buffer: a copy of the packet has been delivered */
   osi_free(p_pkt);
 }
@@ -2195,6 +2198,7 @@ void bta_av_data_path(tBTA_AV_SCB* p_scb, UNUSED_ATTR tBTA_AV_DATA* p_data) {
             (uint8_t*)(p_buf2 + 1) + p_buf2->offset + p_buf2->len;
         memcpy(packet2, data_begin, fragment_len);
         p_buf2->len += fragment_len;
+        bta_av_cb.media_bytes_fragment += fragment_len;
         extra_fragments.push_back(p_buf2);
         p_buf->len -= fragment_len;
       }
@@ -2215,6 +2219,7 @@ void bta_av_data_path(tBTA_AV_SCB* p_scb, UNUSED_ATTR tBTA_AV_DATA* p_data) {
       p_scb->cong = true;
     } else {
       /* there's a buffer, but L2CAP does not seem to be moving data */
+      bta_av_cb.media_l2cap_stalls++;
       if (new_buf) {
         /* just got this buffer from co_data,
          * put it in queue */
@@ -616,6 +616,9 @@ typedef struct {
   uint8_t rs_idx;    /* (index + 1) to SCB for the one waiting for RS on open */
   bool sco_occupied; /* true if SCO is being used or call is in progress */
   uint8_t audio_streams; /* handle mask of streaming audio channels */
+  uint64_t media_bytes_dup;      /* media bytes copied for another channel */
+  uint64_t media_bytes_fragment; /* media bytes copied into RTP fragments */
+  uint32_t media_l2cap_stalls;   /* data path found L2CAP still busy */
 } tBTA_AV_CB;
 
 // total attempts are half seconds
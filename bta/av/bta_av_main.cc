@@ -1203,6 +1203,7 @@ void bta_av_dup_audio_buf(tBTA_AV_SCB* p_scb, BT_HDR* p_buf) {
     BT_HDR* p_new = (BT_HDR*)osi_malloc(copy_size);
     memcpy(p_new, p_buf, copy_size);
     list_append(p_scbi->a2dp_list, p_new);
+    bta_av_cb.media_bytes_dup += p_buf->len;
 
     if (list_length(p_scbi->a2dp_list) > p_bta_av_cfg->audio_mqs) {
       // Drop the oldest packet
@@ -1214,6 +1215,16 @@ void bta_av_dup_audio_buf(tBTA_AV_SCB* p_scb, BT_HDR* p_buf) {
   }
 }
 
+void BTA_AvGetMediaCopyStats(uint64_t* p_bytes_dup,
+                             uint64_t* p_bytes_fragment) {
+  *p_bytes_dup = bta_av_cb.media_bytes_dup;
+  *p_bytes_fragment = bta_av_cb.media_bytes_fragment;
+}
+
+uint32_t BTA_AvGetMediaL2capStallCount(void) {
+  return bta_av_cb.media_l2cap_stalls;
+}
+
 /*******************************************************************************
  *
  * Function         bta_av_sm_execute
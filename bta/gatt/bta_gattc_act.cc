@@ -567,6 +567,8 @@ void bta_gattc_reset_discover_st(tBTA_GATTC_SERV* p_srcb, tGATT_STATUS status) {
   for (uint8_t i = 0; i < BTA_GATTC_CLCB_MAX; i++) {
     if (bta_gattc_cb.clcb[i].p_srcb == p_srcb) {
       bta_gattc_cb.clcb[i].status = status;
+      bta_gattc_cb.clcb[i].request_during_discovery =
+          BTA_GATTC_DISCOVER_REQ_NONE;
       bta_gattc_sm_execute(&bta_gattc_cb.clcb[i], BTA_GATTC_DISCOVER_CMPL_EVT,
                            NULL);
     }
@@ -600,6 +602,8 @@ void bta_gattc_set_discover_st(tBTA_GATTC_SERV* p_srcb) {
     if (bta_gattc_cb.clcb[i].p_srcb == p_srcb) {
       bta_gattc_cb.clcb[i].status = GATT_SUCCESS;
       bta_gattc_cb.clcb[i].state = BTA_GATTC_DISCOVER_ST;
+      bta_gattc_cb.clcb[i].request_during_discovery =
+          BTA_GATTC_DISCOVER_REQ_NONE;
     }
   }
 }
@@ -657,8 +661,16 @@ void bta_gattc_start_discover(tBTA_GATTC_CLCB* p_clcb,
       bta_gattc_set_discover_st(p_clcb->p_srcb);
 
       bta_gattc_init_cache(p_clcb->p_srcb);
-      p_clcb->status = bta_gattc_discover_pri_service(
-          p_clcb->bta_conn_id, p_clcb->p_srcb, GATT_DISC_SRVC_ALL);
+
+      /* servers exposing a Database Hash may share an already known cache, in
+       * which case discovery is skipped once the hash is read */
+      if (p_clcb->transport == BTA_TRANSPORT_LE &&
+          bta_gattc_read_db_hash(p_clcb)) {
+        p_clcb->status = GATT_SUCCESS;
+      } else {
+        p_clcb->status = bta_gattc_discover_pri_service(
+            p_clcb->bta_conn_id, p_clcb->p_srcb, GATT_DISC_SRVC_ALL);
+      }
       if (p_clcb->status != GATT_SUCCESS) {
         LOG(ERROR) << "discovery on server failed";
         bta_gattc_reset_discover_st(p_clcb->p_srcb, p_clcb->status);
@@ -973,9 +985,16 @@ void bta_gattc_op_cmpl(tBTA_GATTC_CLCB* p_clcb, tBTA_GATTC_DATA* p_data) {
   }
 }
 
-/** operation completed */
-void bta_gattc_ignore_op_cmpl(UNUSED_ATTR tBTA_GATTC_CLCB* p_clcb,
-                              tBTA_GATTC_DATA* p_data) {
+/** operation completed while discovery is in progress */
+void bta_gattc_op_cmpl_during_discovery(tBTA_GATTC_CLCB* p_clcb,
+                                        tBTA_GATTC_DATA* p_data) {
+  if (p_clcb->request_during_discovery == BTA_GATTC_DISCOVER_REQ_READ_DB_HASH &&
+      p_data->op_cmpl.op_code == GATTC_OPTYPE_READ) {
+    p_clcb->request_during_discovery = BTA_GATTC_DISCOVER_REQ_NONE;
+    bta_gattc_db_hash_read_cmpl(p_clcb, &p_data->op_cmpl);
+    return;
+  }
+
   /* receive op complete when discovery is started, ignore the response,
       and wait for discovery finish and resent */
   VLOG(1) << __func__ << ": op = " << +p_data->hdr.layer_specific;
@@ -27,10 +27,15 @@
 
 #include "bt_target.h"
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 #include <sstream>
 
 #include "bt_common.h"
@@ -59,6 +64,11 @@ using gatt::StoredAttribute;
 
 static void bta_gattc_cache_write(const RawAddress& server_bda,
                                   const std::vector<StoredAttribute>& attr);
+static void bta_gattc_cache_link(const RawAddress& server_bda,
+                                 const Octet16& hash);
+static bool bta_gattc_hash_cache_load(const Octet16& hash, Database* database);
+static void bta_gattc_hash_cache_write(const Octet16& hash,
+                                       const std::vector<StoredAttribute>& attr);
 static tGATT_STATUS bta_gattc_sdp_service_disc(uint16_t conn_id,
                                                tBTA_GATTC_SERV* p_server_cb);
 const Descriptor* bta_gattc_get_descriptor_srcb(tBTA_GATTC_SERV* p_srcb,
@@ -70,14 +80,32 @@ static void bta_gattc_explore_srvc_finished(uint16_t conn_id,
 
 #define BTA_GATT_SDP_DB_SIZE 4096
 
-#define GATT_CACHE_PREFIX "/data/misc/bluetooth/gatt_cache_"
-#define GATT_CACHE_VERSION 5
+#define GATT_CACHE_DIR "/data/misc/bluetooth/"
+#define GATT_CACHE_FILE_PREFIX "gatt_cache_"
+#define GATT_HASH_CACHE_FILE_PREFIX "gatt_hash_"
+#define GATT_CACHE_VERSION 6
+
+/* Directory holding the cache files, unit tests point it elsewhere */
+static const char* gatt_cache_dir = GATT_CACHE_DIR;
 
 static void bta_gattc_generate_cache_file_name(char* buffer, size_t buffer_len,
                                                const RawAddress& bda) {
-  snprintf(buffer, buffer_len, "%s%02x%02x%02x%02x%02x%02x", GATT_CACHE_PREFIX,
-           bda.address[0], bda.address[1], bda.address[2], bda.address[3],
-           bda.address[4], bda.address[5]);
+  snprintf(buffer, buffer_len, "%s%s%02x%02x%02x%02x%02x%02x", gatt_cache_dir,
+           GATT_CACHE_FILE_PREFIX, bda.address[0], bda.address[1],
+           bda.address[2], bda.address[3], bda.address[4], bda.address[5]);
+}
+
+/* Database Hash keyed caches are content addressed, so devices exposing the
+ * same database share a single file */
+static void bta_gattc_generate_hash_cache_file_name(char* buffer,
+                                                    size_t buffer_len,
+                                                    const Octet16& hash) {
+  int len = snprintf(buffer, buffer_len, "%s%s", gatt_cache_dir,
+                     GATT_HASH_CACHE_FILE_PREFIX);
+  for (uint8_t b : hash) {
+    if (len < 0 || (size_t)len >= buffer_len) return;
+    len += snprintf(buffer + len, buffer_len - len, "%02x", b);
+  }
 }
 
 /*****************************************************************************
@@ -89,6 +117,32 @@ typedef struct {
   uint16_t sdp_conn_id;
 } tBTA_GATTC_CB_DATA;
 
+/* Header of a GATT cache file. Address keyed files either carry the
+ * attributes inline (hash unknown), or are flagged BTA_GATTC_CACHE_LINK and
+ * hold no attributes, the Database Hash keyed file |hash| does. */
+typedef struct {
+  uint16_t version;
+  uint16_t flags;
+  uint16_t num_attr;
+  Octet16 hash;
+} tBTA_GATTC_CACHE_HDR;
+
+#define BTA_GATTC_CACHE_LINK 0x0001
+
+static_assert(sizeof(tBTA_GATTC_CACHE_HDR) % alignof(StoredAttribute) == 0,
+              "attributes following the header must stay aligned");
+
+/* GATT cache usage statistics */
+typedef struct {
+  uint32_t db_hash_read;        /* Database Hash read from remote */
+  uint32_t db_hash_unsupported; /* Database Hash read failed */
+  uint32_t hash_cache_hit;      /* discovery avoided by hash keyed cache */
+  uint32_t addr_cache_hit;      /* cache loaded by remote address */
+  uint32_t full_discovery;      /* full service discovery completed */
+} tBTA_GATTC_CACHE_STATS;
+
+static tBTA_GATTC_CACHE_STATS bta_gattc_cache_stats;
+
 #if (BTA_GATT_DEBUG == TRUE)
 /* utility functions */
 
@@ -144,6 +198,68 @@ tGATT_STATUS bta_gattc_discover_pri_service(uint16_t conn_id,
   return bta_gattc_sdp_service_disc(conn_id, p_server_cb);
 }
 
+/** Read the Database Hash characteristic of the server. Returns true if the
+ * read was issued, in which case discovery continues from
+ * bta_gattc_db_hash_read_cmpl. */
+bool bta_gattc_read_db_hash(tBTA_GATTC_CLCB* p_clcb) {
+  tGATT_READ_PARAM read_param;
+  memset(&read_param, 0, sizeof(read_param));
+
+  read_param.char_type.s_handle = 0x0001;
+  read_param.char_type.e_handle = 0xFFFF;
+  read_param.char_type.uuid = Uuid::From16Bit(GATT_UUID_DATABASE_HASH);
+  read_param.char_type.auth_req = GATT_AUTH_REQ_NONE;
+
+  if (GATTC_Read(p_clcb->bta_conn_id, GATT_READ_BY_TYPE, &read_param) !=
+      GATT_SUCCESS) {
+    return false;
+  }
+
+  p_clcb->request_during_discovery = BTA_GATTC_DISCOVER_REQ_READ_DB_HASH;
+  return true;
+}
+
+/** Database Hash read complete. Load the matching cache if one is stored,
+ * otherwise continue with full service discovery. */
+void bta_gattc_db_hash_read_cmpl(tBTA_GATTC_CLCB* p_clcb,
+                                 tBTA_GATTC_OP_CMPL* p_data) {
+  tBTA_GATTC_SERV* p_srcb = p_clcb->p_srcb;
+
+  /* discovery was cancelled while the read was in flight */
+  if (p_clcb->status != GATT_SUCCESS) {
+    bta_gattc_reset_discover_st(p_srcb, p_clcb->status);
+    return;
+  }
+
+  if (p_data->status == GATT_SUCCESS && p_data->p_cmpl &&
+      p_data->p_cmpl->att_value.len == OCTET16_LEN) {
+    bta_gattc_cache_stats.db_hash_read++;
+    memcpy(p_srcb->db_hash.data(), p_data->p_cmpl->att_value.value,
+           OCTET16_LEN);
+    p_srcb->db_hash_valid = true;
+
+    if (bta_gattc_hash_cache_load(p_srcb->db_hash, &p_srcb->gatt_database)) {
+      VLOG(1) << __func__ << ": known Database Hash, skipping discovery";
+      bta_gattc_cache_stats.hash_cache_hit++;
+      if (btm_sec_is_a_bonded_dev(p_srcb->server_bda)) {
+        bta_gattc_cache_link(p_srcb->server_bda, p_srcb->db_hash);
+      }
+      bta_gattc_reset_discover_st(p_srcb, GATT_SUCCESS);
+      return;
+    }
+  } else {
+    bta_gattc_cache_stats.db_hash_unsupported++;
+    p_srcb->db_hash_valid = false;
+  }
+
+  p_clcb->status = bta_gattc_discover_pri_service(
+      p_clcb->bta_conn_id, p_srcb, GATT_DISC_SRVC_ALL);
+  if (p_clcb->status != GATT_SUCCESS) {
+    LOG(ERROR) << "discovery on server failed";
+    bta_gattc_reset_discover_st(p_srcb, p_clcb->status);
+  }
+}
+
 /** start exploring next service, or finish discovery if no more services left
  */
 static void bta_gattc_explore_next_service(uint16_t conn_id,
@@ -182,10 +298,20 @@ static void bta_gattc_explore_srvc_finished(uint16_t conn_id,
 #if (BTA_GATT_DEBUG == TRUE)
   bta_gattc_display_cache_server(p_srvc_cb->gatt_database);
 #endif
+  bta_gattc_cache_stats.full_discovery++;
+
   /* save cache to NV */
   p_clcb->p_srcb->state = BTA_GATTC_SERV_SAVE;
 
-  if (btm_sec_is_a_bonded_dev(p_srvc_cb->server_bda)) {
+  bool is_bonded = btm_sec_is_a_bonded_dev(p_srvc_cb->server_bda);
+  if (p_srvc_cb->db_hash_valid) {
+    /* the hash validates the content, so it can be kept for any device */
+    bta_gattc_hash_cache_write(p_srvc_cb->db_hash,
+                               p_srvc_cb->gatt_database.Serialize());
+    if (is_bonded) {
+      bta_gattc_cache_link(p_srvc_cb->server_bda, p_srvc_cb->db_hash);
+    }
+  } else if (is_bonded) {
     bta_gattc_cache_write(p_clcb->p_srcb->server_bda,
                           p_clcb->p_srcb->gatt_database.Serialize());
   }
@@ -697,6 +823,184 @@ void bta_gattc_get_gatt_db(uint16_t conn_id, uint16_t start_handle,
                              count);
 }
 
+/* Memory map the cache file |fname| and deserialize the attributes it holds
+ * into |database|. If the file only links to a Database Hash keyed cache,
+ * |database| is left untouched and the hash is returned in |link|. */
+static bool bta_gattc_cache_load_file(const char* fname, Database* database,
+                                      Octet16* link, bool* is_link) {
+  *is_link = false;
+
+  int fd = open(fname, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG(ERROR) << __func__ << ": can't open GATT cache file " << fname
+               << " for reading, error: " << strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(tBTA_GATTC_CACHE_HDR)) {
+    LOG(ERROR) << __func__ << ": can't read GATT cache header: " << fname;
+    close(fd);
+    return false;
+  }
+
+  size_t size = st.st_size;
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    LOG(ERROR) << __func__ << ": can't map GATT cache file " << fname
+               << ", error: " << strerror(errno);
+    return false;
+  }
+
+  const tBTA_GATTC_CACHE_HDR* hdr = (const tBTA_GATTC_CACHE_HDR*)map;
+  bool success = false;
+
+  if (hdr->version != GATT_CACHE_VERSION) {
+    LOG(ERROR) << __func__ << ": wrong GATT cache version: " << fname;
+  } else if (size != sizeof(tBTA_GATTC_CACHE_HDR) +
+                         hdr->num_attr * sizeof(StoredAttribute)) {
+    LOG(ERROR) << __func__ << ": wrong GATT cache size: " << fname;
+  } else if (hdr->flags & BTA_GATTC_CACHE_LINK) {
+    if (hdr->num_attr != 0) {
+      LOG(ERROR) << __func__ << ": GATT cache link with attributes: " << fname;
+    } else {
+      *link = hdr->hash;
+      *is_link = true;
+      success = true;
+    }
+  } else {
+    *link = hdr->hash;
+    *database = Database::Deserialize((const StoredAttribute*)(hdr + 1),
+                                      hdr->num_attr, &success);
+  }
+
+  munmap(map, size);
+  return success;
+}
+
+/* Write |attr| preceded by a header to |fname|, or only a header linking to
+ * the hash keyed file of |hash| if |is_link|. The file is replaced atomically,
+ * as hash keyed files may be read for other devices. */
+static bool bta_gattc_cache_write_file(
+    const char* fname, const Octet16& hash,
+    const std::vector<StoredAttribute>& attr, bool is_link) {
+  char tmp_fname[255] = {0};
+  snprintf(tmp_fname, sizeof(tmp_fname), "%s.tmp", fname);
+
+  FILE* fd = fopen(tmp_fname, "wb");
+  if (!fd) {
+    LOG(ERROR) << __func__
+               << ": can't open GATT cache file for writing: " << tmp_fname;
+    return false;
+  }
+
+  tBTA_GATTC_CACHE_HDR hdr;
+  hdr.version = GATT_CACHE_VERSION;
+  hdr.flags = is_link ? BTA_GATTC_CACHE_LINK : 0;
+  hdr.num_attr = attr.size();
+  hdr.hash = hash;
+
+  if (fwrite(&hdr, sizeof(hdr), 1, fd) != 1) {
+    LOG(ERROR) << __func__ << ": can't write GATT cache header: " << tmp_fname;
+    fclose(fd);
+    unlink(tmp_fname);
+    return false;
+  }
+
+  if (fwrite(attr.data(), sizeof(StoredAttribute), hdr.num_attr, fd) !=
+      hdr.num_attr) {
+    LOG(ERROR) << __func__
+               << ": can't write GATT cache attributes: " << tmp_fname;
+    fclose(fd);
+    unlink(tmp_fname);
+    return false;
+  }
+
+  fclose(fd);
+
+  if (rename(tmp_fname, fname) != 0) {
+    LOG(ERROR) << __func__ << ": can't rename GATT cache file " << tmp_fname
+               << ", error: " << strerror(errno);
+    unlink(tmp_fname);
+    return false;
+  }
+  return true;
+}
+
+/* Remove the least recently used hash keyed caches, so that no more than
+ * BTA_GATTC_HASH_CACHE_MAX are kept. Address keyed files linking to a removed
+ * cache fall back to discovery on next connection. */
+static void bta_gattc_hash_cache_trim() {
+  DIR* dir = opendir(gatt_cache_dir);
+  if (!dir) return;
+
+  std::vector<std::pair<time_t, std::string>> files;
+  const size_t prefix_len = strlen(GATT_HASH_CACHE_FILE_PREFIX);
+  for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir)) {
+    if (strncmp(entry->d_name, GATT_HASH_CACHE_FILE_PREFIX, prefix_len) != 0)
+      continue;
+
+    std::string path = std::string(gatt_cache_dir) + entry->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) continue;
+    files.emplace_back(st.st_mtime, std::move(path));
+  }
+  closedir(dir);
+
+  if (files.size() <= BTA_GATTC_HASH_CACHE_MAX) return;
+
+  std::sort(files.begin(), files.end());
+  for (size_t i = 0; i < files.size() - BTA_GATTC_HASH_CACHE_MAX; i++) {
+    VLOG(1) << __func__ << ": removing " << files[i].second;
+    unlink(files[i].second.c_str());
+  }
+}
+
+/* Load the cache stored for Database Hash |hash| into |database| */
+static bool bta_gattc_hash_cache_load(const Octet16& hash, Database* database) {
+  char fname[255] = {0};
+  bta_gattc_generate_hash_cache_file_name(fname, sizeof(fname), hash);
+
+  Octet16 link;
+  bool is_link = false;
+  Database loaded;
+  if (!bta_gattc_cache_load_file(fname, &loaded, &link, &is_link) || is_link ||
+      link != hash) {
+    return false;
+  }
+
+  /* mark as recently used */
+  utimensat(AT_FDCWD, fname, nullptr, 0);
+
+  *database = std::move(loaded);
+  return true;
+}
+
+/* Store |attr| as the cache content for Database Hash |hash| */
+static void bta_gattc_hash_cache_write(
+    const Octet16& hash, const std::vector<StoredAttribute>& attr) {
+  if (attr.empty()) return;
+
+  char fname[255] = {0};
+  bta_gattc_generate_hash_cache_file_name(fname, sizeof(fname), hash);
+
+  if (bta_gattc_cache_write_file(fname, hash, attr, false))
+    bta_gattc_hash_cache_trim();
+}
+
+/* Make the address keyed cache of |server_bda| refer to the hash keyed cache
+ * |hash| instead of keeping its own copy of the attributes */
+static void bta_gattc_cache_link(const RawAddress& server_bda,
+                                 const Octet16& hash) {
+  char fname[255] = {0};
+  bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
+
+  bta_gattc_cache_write_file(fname, hash, std::vector<StoredAttribute>(),
+                             true);
+}
+
 /*******************************************************************************
  *
  * Function         bta_gattc_cache_load
@@ -712,47 +1016,24 @@ bool bta_gattc_cache_load(tBTA_GATTC_SERV* p_srcb) {
   char fname[255] = {0};
   bta_gattc_generate_cache_file_name(fname, sizeof(fname), p_srcb->server_bda);
 
-  FILE* fd = fopen(fname, "rb");
-  if (!fd) {
-    LOG(ERROR) << __func__ << ": can't open GATT cache file " << fname
-               << " for reading, error: " << strerror(errno);
+  Octet16 hash;
+  bool is_link = false;
+  if (!bta_gattc_cache_load_file(fname, &p_srcb->gatt_database, &hash,
+                                 &is_link)) {
     return false;
   }
 
-  uint16_t cache_ver = 0;
-  bool success = false;
-  uint16_t num_attr = 0;
-
-  if (fread(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't read GATT cache version from: " << fname;
-    goto done;
-  }
-
-  if (cache_ver != GATT_CACHE_VERSION) {
-    LOG(ERROR) << __func__ << ": wrong GATT cache version: " << fname;
-    goto done;
-  }
-
-  if (fread(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't read number of GATT attributes: " << fname;
-    goto done;
-  }
-
-  {
-    std::vector<StoredAttribute> attr(num_attr);
-
-    if (fread(attr.data(), sizeof(StoredAttribute), num_attr, fd) != num_attr) {
-      LOG(ERROR) << __func__ << "s: can't read GATT attributes: " << fname;
-      goto done;
+  if (is_link) {
+    if (!bta_gattc_hash_cache_load(hash, &p_srcb->gatt_database)) {
+      LOG(ERROR) << __func__ << ": linked GATT cache missing for " << fname;
+      return false;
     }
-
-    p_srcb->gatt_database = gatt::Database::Deserialize(attr, &success);
+    p_srcb->db_hash = hash;
+    p_srcb->db_hash_valid = true;
   }
 
-done:
-  fclose(fd);
-  return success;
+  bta_gattc_cache_stats.addr_cache_hit++;
+  return true;
 }
 
 /*******************************************************************************
@@ -772,35 +1053,8 @@ static void bta_gattc_cache_write(const RawAddress& server_bda,
   char fname[255] = {0};
   bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
 
-  FILE* fd = fopen(fname, "wb");
-  if (!fd) {
-    LOG(ERROR) << __func__
-               << ": can't open GATT cache file for writing: " << fname;
-    return;
-  }
-
-  uint16_t cache_ver = GATT_CACHE_VERSION;
-  if (fwrite(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache version: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  uint16_t num_attr = attr.size();
-  if (fwrite(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    LOG(ERROR) << __func__
-               << ": can't write GATT cache attribute count: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  if (fwrite(attr.data(), sizeof(StoredAttribute), num_attr, fd) != num_attr) {
-    LOG(ERROR) << __func__ << ": can't write GATT cache attributes: " << fname;
-    fclose(fd);
-    return;
-  }
-
-  fclose(fd);
+  Octet16 no_hash{};
+  bta_gattc_cache_write_file(fname, no_hash, attr, false);
 }
 
 /*******************************************************************************
@@ -821,3 +1075,26 @@ void bta_gattc_cache_reset(const RawAddress& server_bda) {
   bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
   unlink(fname);
 }
+
+/*******************************************************************************
+ *
+ * Function         bta_debug_gattc_dump
+ *
+ * Description      Dump GATT client cache statistics
+ *
+ * Parameter        fd: file descriptor to dump to
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+void bta_debug_gattc_dump(int fd) {
+  dprintf(fd, "\nBTA GATT Client Cache:\n");
+  dprintf(fd, "  Database Hash read: %u\n", bta_gattc_cache_stats.db_hash_read);
+  dprintf(fd, "  Database Hash not supported: %u\n",
+          bta_gattc_cache_stats.db_hash_unsupported);
+  dprintf(fd, "  Discoveries avoided (hash keyed cache): %u\n",
+          bta_gattc_cache_stats.hash_cache_hit);
+  dprintf(fd, "  Address keyed cache loads: %u\n",
+          bta_gattc_cache_stats.addr_cache_hit);
+  dprintf(fd, "  Full discoveries: %u\n", bta_gattc_cache_stats.full_discovery);
+}
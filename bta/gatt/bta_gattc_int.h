@@ -84,6 +84,11 @@ typedef uint16_t tBTA_GATTC_INT_EVT;
 
 #define BTA_GATTC_WRITE_PREPARE GATT_WRITE_PREPARE
 
+/* max number of Database Hash keyed GATT caches kept in storage */
+#ifndef BTA_GATTC_HASH_CACHE_MAX
+#define BTA_GATTC_HASH_CACHE_MAX 64
+#endif
+
 /* internal strucutre for GATTC register API  */
 typedef struct {
   BT_HDR hdr;
@@ -217,6 +222,9 @@ typedef struct {
   uint16_t attr_index;  /* cahce NV saving/loading attribute index */
 
   uint16_t mtu;
+
+  bool db_hash_valid; /* Database Hash was read from the server */
+  Octet16 db_hash;    /* Database Hash characteristic value */
 } tBTA_GATTC_SERV;
 
 #ifndef BTA_GATTC_NOTIF_REG_MAX
@@ -254,6 +262,11 @@ typedef struct {
 #define BTA_GATTC_REQ_WAITING 0x10
 
   uint8_t auto_update; /* auto update is waiting */
+
+#define BTA_GATTC_DISCOVER_REQ_NONE 0
+#define BTA_GATTC_DISCOVER_REQ_READ_DB_HASH 1
+
+  uint8_t request_during_discovery; /* request issued while discovering */
   bool disc_active;
   bool in_use;
   tBTA_GATTC_STATE state;
@@ -362,8 +375,8 @@ extern void bta_gattc_read_multi(tBTA_GATTC_CLCB* p_clcb,
 extern void bta_gattc_ci_open(tBTA_GATTC_CLCB* p_clcb, tBTA_GATTC_DATA* p_data);
 extern void bta_gattc_ci_close(tBTA_GATTC_CLCB* p_clcb,
                                tBTA_GATTC_DATA* p_data);
-extern void bta_gattc_ignore_op_cmpl(tBTA_GATTC_CLCB* p_clcb,
-                                     tBTA_GATTC_DATA* p_data);
+extern void bta_gattc_op_cmpl_during_discovery(tBTA_GATTC_CLCB* p_clcb,
+                                               tBTA_GATTC_DATA* p_data);
 extern void bta_gattc_restart_discover(tBTA_GATTC_CLCB* p_clcb,
                                        tBTA_GATTC_DATA* p_msg);
 extern void bta_gattc_init_bk_conn(tBTA_GATTC_API_OPEN* p_data,
@@ -451,6 +464,10 @@ extern tBTA_GATTC_CONN* bta_gattc_conn_find(const RawAddress& remote_bda);
 extern tBTA_GATTC_CONN* bta_gattc_conn_find_alloc(const RawAddress& remote_bda);
 extern bool bta_gattc_conn_dealloc(const RawAddress& remote_bda);
 
+extern bool bta_gattc_read_db_hash(tBTA_GATTC_CLCB* p_clcb);
+extern void bta_gattc_db_hash_read_cmpl(tBTA_GATTC_CLCB* p_clcb,
+                                        tBTA_GATTC_OP_CMPL* p_data);
+
 extern bool bta_gattc_cache_load(tBTA_GATTC_SERV* p_srcb);
 extern void bta_gattc_cache_reset(const RawAddress& server_bda);
 
@@ -57,7 +57,7 @@ enum {
   BTA_GATTC_CONFIRM,
   BTA_GATTC_EXEC,
   BTA_GATTC_READ_MULTI,
-  BTA_GATTC_IGNORE_OP_CMPL,
+  BTA_GATTC_OP_CMPL_DURING_DISC,
   BTA_GATTC_DISC_CLOSE,
   BTA_GATTC_RESTART_DISCOVER,
   BTA_GATTC_CFG_MTU,
@@ -90,7 +90,7 @@ const tBTA_GATTC_ACTION bta_gattc_action[] = {
     bta_gattc_confirm,           /* BTA_GATTC_CONFIRM */
     bta_gattc_execute,           /* BTA_GATTC_EXEC */
     bta_gattc_read_multi,        /* BTA_GATTC_READ_MULTI */
-    bta_gattc_ignore_op_cmpl,    /* BTA_GATTC_IGNORE_OP_CMPL */
+    bta_gattc_op_cmpl_during_discovery, /* BTA_GATTC_OP_CMPL_DURING_DISC */
     bta_gattc_disc_close,        /* BTA_GATTC_DISC_CLOSE */
     bta_gattc_restart_discover,  /* BTA_GATTC_RESTART_DISCOVER */
     bta_gattc_cfg_mtu            /* BTA_GATTC_CFG_MTU */
@@ -256,8 +256,8 @@ static const uint8_t bta_gattc_st_discover[][BTA_GATTC_NUM_COLS] = {
                                             BTA_GATTC_DISCOVER_ST},
     /* BTA_GATTC_DISCOVER_CMPL_EVT      */ {BTA_GATTC_DISC_CMPL,
                                             BTA_GATTC_CONN_ST},
-    /* BTA_GATTC_OP_CMPL_EVT            */ {BTA_GATTC_IGNORE_OP_CMPL,
-                                            BTA_GATTC_DISCOVER_ST},
+    /* BTA_GATTC_OP_CMPL_EVT            */
+    {BTA_GATTC_OP_CMPL_DURING_DISC, BTA_GATTC_DISCOVER_ST},
     /* BTA_GATTC_INT_DISCONN_EVT        */ {BTA_GATTC_CLOSE, BTA_GATTC_IDLE_ST},
 
 };
@@ -114,6 +114,11 @@ class Database {
   static Database Deserialize(const std::vector<gatt::StoredAttribute>& nv_attr,
                               bool* success);
 
+  /* Same as above, but reads |count| attributes directly from |nv_attr|, i.e.
+   * from a memory mapped cache file, without copying them first. */
+  static Database Deserialize(const gatt::StoredAttribute* nv_attr,
+                              size_t count, bool* success);
+
   friend class DatabaseBuilder;
 
  private:
@@ -21,6 +21,7 @@
 #include "bta_gatt_api.h"
 #include "bta_gatt_queue.h"
 #include "btm_int.h"
+#include "common/message_loop_thread.h"
 #include "device/include/controller.h"
 #include "embdrv/g722/g722_enc_dec.h"
 #include "gap_api.h"
@@ -31,6 +32,7 @@
 #include <base/logging.h>
 #include <base/strings/string_number_conversions.h>
 #include <hardware/bt_hearing_aid.h>
+#include <future>
 #include <vector>
 
 using base::Closure;
@@ -224,6 +226,17 @@ inline void encoder_state_release() {
   }
 }
 
+// Encodes one channel into |encoded|, reusing its storage. G.722 makes one
+// code byte of each pair of samples.
+void encode_channel(g722_encode_state_t* state,
+                    const std::vector<uint16_t>& pcm,
+                    std::vector<uint8_t>* encoded) {
+  encoded->resize(pcm.size() / 2);
+  int encoded_size = g722_encode(state, encoded->data(),
+                                 (const int16_t*)pcm.data(), pcm.size());
+  encoded->resize(encoded_size);
+}
+
 class HearingAidImpl : public HearingAid {
  private:
   // Keep track of whether the Audio Service has resumed audio playback
@@ -242,7 +255,8 @@ class HearingAidImpl : public HearingAid {
         seq_counter(0),
         current_volume(VOLUME_UNKNOWN),
         callbacks(callbacks),
-        codec_in_use(0) {
+        codec_in_use(0),
+        encoder_thread("bt_hearing_aid_encoder") {
     default_data_interval_ms = (uint16_t)osi_property_get_int32(
         "persist.bluetooth.hearingaid.interval", (int32_t)HA_INTERVAL_20_MS);
     if ((default_data_interval_ms != HA_INTERVAL_10_MS) &&
@@ -262,6 +276,17 @@ class HearingAidImpl : public HearingAid {
                 << ": Overwrites MIN_CE_LEN=" << overwrite_min_ce_len;
     }
 
+    // Binaural streams can have the right channel encoded on a thread of its
+    // own while the left one is encoded here
+    if (osi_property_get_bool("persist.bluetooth.hearingaid.encoder_thread",
+                              false)) {
+      encoder_thread.StartUp();
+      if (!encoder_thread.EnableRealTimeScheduling()) {
+        LOG(WARNING) << __func__
+                     << ": encoder thread runs without real time priority";
+      }
+    }
+
     BTA_GATTC_AppRegister(
         hearingaid_gattc_callback,
         base::Bind(
@@ -1163,8 +1188,8 @@ class HearingAidImpl : public HearingAid {
       return;
     }
 
-    std::vector<uint16_t> chan_left;
-    std::vector<uint16_t> chan_right;
+    chan_left.clear();
+    chan_right.clear();
     if (left == nullptr || right == nullptr) {
       for (int i = 0; i < num_samples; i++) {
         const uint8_t* sample = data.data() + i * 4;
@@ -1195,19 +1220,9 @@ class HearingAidImpl : public HearingAid {
 
     // divide encoded data into packets, add header, send.
 
-    // TODO: make those buffers static and global to prevent constant
-    // reallocations
-    // TODO: this should basically fit the encoded data, tune the size later
-    std::vector<uint8_t> encoded_data_left;
-    if (left) {
-      // TODO: instead of a magic number, we need to figure out the correct
-      // buffer size
-      encoded_data_left.resize(4000);
-      int encoded_size =
-          g722_encode(encoder_state_left, encoded_data_left.data(),
-                      (const int16_t*)chan_left.data(), chan_left.size());
-      encoded_data_left.resize(encoded_size);
+    EncodeChannels(left != nullptr, right != nullptr);
 
+    if (left) {
       uint16_t cid = GAP_ConnGetL2CAPCid(left->gap_handle);
       uint16_t packets_to_flush = L2CA_FlushChannel(cid, L2CAP_FLUSH_CHANS_GET);
       if (packets_to_flush) {
@@ -1222,16 +1237,7 @@ class HearingAidImpl : public HearingAid {
       check_and_do_rssi_read(left);
     }
 
-    std::vector<uint8_t> encoded_data_right;
     if (right) {
-      // TODO: instead of a magic number, we need to figure out the correct
-      // buffer size
-      encoded_data_right.resize(4000);
-      int encoded_size =
-          g722_encode(encoder_state_right, encoded_data_right.data(),
-                      (const int16_t*)chan_right.data(), chan_right.size());
-      encoded_data_right.resize(encoded_size);
-
       uint16_t cid = GAP_ConnGetL2CAPCid(right->gap_handle);
       uint16_t packets_to_flush = L2CA_FlushChannel(cid, L2CAP_FLUSH_CHANS_GET);
       if (packets_to_flush) {
@@ -1267,6 +1273,36 @@ class HearingAidImpl : public HearingAid {
     if (right) right->audio_stats.frame_send_count++;
   }
 
+  // Encodes |chan_left| and |chan_right|, for the devices taking them, into
+  // |encoded_data_left| and |encoded_data_right|. With the encoder thread
+  // running, a binaural stream has its two channels encoded in parallel.
+  void EncodeChannels(bool left, bool right) {
+    encoded_data_left.clear();
+    encoded_data_right.clear();
+
+    if (left && right && encoder_thread.IsRunning()) {
+      std::promise<void> right_encoded;
+      std::future<void> right_future = right_encoded.get_future();
+      encoder_thread.DoInThread(
+          FROM_HERE, base::BindOnce(
+                         [](const std::vector<uint16_t>* pcm,
+                            std::vector<uint8_t>* encoded,
+                            std::promise<void> encoded_promise) {
+                           encode_channel(encoder_state_right, *pcm, encoded);
+                           encoded_promise.set_value();
+                         },
+                         &chan_right, &encoded_data_right,
+                         std::move(right_encoded)));
+      encode_channel(encoder_state_left, chan_left, &encoded_data_left);
+      right_future.wait();
+      return;
+    }
+
+    if (left) encode_channel(encoder_state_left, chan_left, &encoded_data_left);
+    if (right)
+      encode_channel(encoder_state_right, chan_right, &encoded_data_right);
+  }
+
   void SendAudio(uint8_t* encoded_data, uint16_t packet_size,
                  HearingDevice* hearingAid) {
     if (!hearingAid->playback_started || !hearingAid->command_acked) {
@@ -1577,6 +1613,7 @@ class HearingAidImpl : public HearingAid {
 
     hearingDevices.devices.clear();
 
+    encoder_thread.ShutDown();
     encoder_state_release();
   }
 
@@ -1592,6 +1629,15 @@ class HearingAidImpl : public HearingAid {
 
   uint16_t default_data_interval_ms;
 
+  /* PCM of each channel and its G.722 codes, reused from one audio tick to
+   * the next */
+  std::vector<uint16_t> chan_left;
+  std::vector<uint16_t> chan_right;
+  std::vector<uint8_t> encoded_data_left;
+  std::vector<uint8_t> encoded_data_right;
+  /* Encodes the right channel of binaural streams, when enabled */
+  bluetooth::common::MessageLoopThread encoder_thread;
+
   HearingDevices hearingDevices;
 
   void find_server_changed_ccc_handle(uint16_t conn_id,
@@ -33,6 +33,7 @@
 #include "bta_hh_int.h"
 #include "bta_sys.h"
 #include "btm_api.h"
+#include "common/time_util.h"
 #include "l2c_api.h"
 #include "osi/include/osi.h"
 #include "utl.h"
@@ -626,7 +627,8 @@ void bta_hh_data_act(tBTA_HH_DEV_CB* p_cb, tBTA_HH_DATA* p_data) {
 
   bta_hh_co_data((uint8_t)p_data->hid_cback.hdr.layer_specific, p_rpt,
                  pdata->len, p_cb->mode, p_cb->sub_class,
-                 p_cb->dscp_info.ctry_code, p_cb->addr, p_cb->app_id);
+                 p_cb->dscp_info.ctry_code, p_cb->addr, p_cb->app_id,
+                 p_data->hid_cback.timestamp_us);
 
   osi_free_and_reset((void**)&pdata);
 }
@@ -1172,6 +1174,7 @@ static void bta_hh_cback(uint8_t dev_handle, const RawAddress& addr,
     p_buf->data = data;
     p_buf->addr = addr;
     p_buf->p_data = pdata;
+    p_buf->timestamp_us = bluetooth::common::time_get_os_boottime_us();
 
     bta_sys_sendmsg(p_buf);
   }
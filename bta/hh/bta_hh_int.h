@@ -126,6 +126,7 @@ typedef struct {
   RawAddress addr;
   uint32_t data;
   BT_HDR* p_data;
+  uint64_t timestamp_us; /* time the data was received from L2CAP */
 } tBTA_HH_CBACK_DATA;
 
 typedef struct {
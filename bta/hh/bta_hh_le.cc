@@ -35,6 +35,7 @@
 #include "btm_api.h"
 #include "btm_ble_api.h"
 #include "btm_int.h"
+#include "common/time_util.h"
 #include "device/include/interop.h"
 #include "osi/include/log.h"
 #include "srvc_api.h"
@@ -1549,6 +1550,7 @@ void bta_hh_le_srvc_search_cmpl(tBTA_GATTC_SEARCH_CMPL* p_data) {
  *
  ******************************************************************************/
 void bta_hh_le_input_rpt_notify(tBTA_GATTC_NOTIFY* p_data) {
+  uint64_t timestamp_us = bluetooth::common::time_get_os_boottime_us();
   tBTA_HH_DEV_CB* p_dev_cb = bta_hh_le_find_dev_cb_by_conn_id(p_data->conn_id);
   uint8_t app_id;
   uint8_t* p_buf;
@@ -1606,7 +1608,8 @@ void bta_hh_le_input_rpt_notify(tBTA_GATTC_NOTIFY* p_data) {
 
   bta_hh_co_data((uint8_t)p_dev_cb->hid_handle, p_buf, p_data->len,
                  p_dev_cb->mode, 0, /* no sub class*/
-                 p_dev_cb->dscp_info.ctry_code, p_dev_cb->addr, app_id);
+                 p_dev_cb->dscp_info.ctry_code, p_dev_cb->addr, app_id,
+                 timestamp_us);
 
   if (p_buf != p_data->value) osi_free(p_buf);
 }
@@ -361,9 +361,16 @@ typedef struct {
   RawAddress bd_addr;
 } tBTA_AVK_CONFIG;
 
+/* media packet received by the Sink */
+typedef struct {
+  BT_HDR* p_pkt;       /* media payload, after the RTP header */
+  uint32_t time_stamp; /* RTP timestamp of the packet */
+} tBTA_AVK_MEDIA_DATA;
+
 /* union of data associated with AV Media callback */
 typedef union {
   BT_HDR* p_data;
+  tBTA_AVK_MEDIA_DATA avk_data;
   tBTA_AVK_CONFIG avk_config;
 } tBTA_AV_MEDIA;
 
@@ -721,6 +728,24 @@ void BTA_AvOffloadStartRsp(tBTA_AV_HNDL hndl, tBTA_AV_STATUS status);
  */
 int BTA_AvObtainPeerChannelIndex(const RawAddress& peer_address);
 
+/**
+ * Get the number of media bytes copied on the audio data path since AV was
+ * enabled.
+ *
+ * @param p_bytes_dup bytes copied to queue a packet on the other streaming
+ * channels
+ * @param p_bytes_fragment bytes copied into RTP fragments of packets larger
+ * than the stream MTU
+ */
+void BTA_AvGetMediaCopyStats(uint64_t* p_bytes_dup,
+                             uint64_t* p_bytes_fragment);
+
+/**
+ * Get the number of times the audio data path had a media packet to send but
+ * found L2CAP still busy with the earlier ones, since AV was enabled.
+ */
+uint32_t BTA_AvGetMediaL2capStallCount(void);
+
 /**
  * Dump debug-related information for the BTA AV module.
  *
@@ -958,4 +958,17 @@ extern void BTA_GATTS_CancelOpen(tGATT_IF server_if,
  ******************************************************************************/
 extern void BTA_GATTS_Close(uint16_t conn_id);
 
+/*******************************************************************************
+ *
+ * Function         bta_debug_gattc_dump
+ *
+ * Description      Dump GATT client cache statistics.
+ *
+ * Parameters       fd: file descriptor to dump to.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void bta_debug_gattc_dump(int fd);
+
 #endif /* BTA_GATT_API_H */
@@ -40,7 +40,8 @@ typedef struct {
  *
  * Description      This callout function is executed by HH when data is
  *                  received
- *                  in interupt channel.
+ *                  in interupt channel. |timestamp_us| is the boot time at
+ *                  which the report was received from the lower layer.
  *
  *
  * Returns          void.
@@ -49,7 +50,7 @@ typedef struct {
 extern void bta_hh_co_data(uint8_t dev_handle, uint8_t* p_rpt, uint16_t len,
                            tBTA_HH_PROTO_MODE mode, uint8_t sub_class,
                            uint8_t ctry_code, const RawAddress& peer_addr,
-                           uint8_t app_id);
+                           uint8_t app_id, uint64_t timestamp_us);
 
 /*******************************************************************************
  *
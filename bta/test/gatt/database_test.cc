@@ -204,4 +204,43 @@ TEST(GattCacheTest, stored_attribute_to_binary_descriptor_test) {
   // LOG(ERROR) << " " << base::HexEncode(&attr, len);
   EXPECT_EQ(memcmp(binary_form, &attr, len), 0);
 }
-}  // namespace gatt
\ No newline at end of file
+
+/* This test makes sure that deserializing attributes straight from a raw
+ * buffer, as done for memory mapped cache files, gives the same database. */
+TEST(GattDatabaseTest, deserialize_from_raw_buffer_test) {
+  DatabaseBuilder builder;
+  builder.AddService(0x0001, 0x000f, SERVICE_1_UUID, true);
+  builder.AddService(0x0010, 0x001f, SERVICE_2_UUID, false);
+  builder.AddIncludedService(0x0002, SERVICE_2_UUID, 0x0010, 0x001f);
+  builder.AddCharacteristic(0x0003, 0x0004, SERVICE_1_CHAR_1_UUID, 0x02);
+  builder.AddDescriptor(0x0005, SERVICE_1_CHAR_1_DESC_1_UUID);
+
+  Database db = builder.Build();
+  std::vector<StoredAttribute> serialized = db.Serialize();
+
+  std::vector<uint8_t> raw(serialized.size() * sizeof(StoredAttribute));
+  memcpy(raw.data(), serialized.data(), raw.size());
+
+  bool success = false;
+  Database result = Database::Deserialize(
+      reinterpret_cast<const StoredAttribute*>(raw.data()), serialized.size(),
+      &success);
+
+  EXPECT_TRUE(success);
+  EXPECT_EQ(result.ToString(), db.ToString());
+}
+
+/* This test makes sure that a descriptor not preceded by a characteristic is
+ * rejected instead of being attached to a non-existing characteristic. */
+TEST(GattDatabaseTest, deserialize_orphan_descriptor_test) {
+  std::vector<StoredAttribute> attr;
+  attr.push_back({0x0001,
+                  PRIMARY_SERVICE,
+                  {.service = {.uuid = SERVICE_1_UUID, .end_handle = 0x000f}}});
+  attr.push_back({0x0002, SERVICE_1_CHAR_1_DESC_1_UUID, {}});
+
+  bool success = true;
+  Database::Deserialize(attr, &success);
+  EXPECT_FALSE(success);
+}
+}  // namespace gatt
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include "bta/gatt/bta_gattc_cache.cc"
+
+using bluetooth::Uuid;
+
+namespace {
+
+constexpr uint16_t kConnId = 0x0001;
+
+tBTA_GATTC_CLCB clcb;
+bool bonded;
+int discover_calls;
+int reset_calls;
+tGATT_STATUS reset_status;
+
+}  // namespace
+
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+tGATT_STATUS GATTC_Discover(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
+                            uint16_t start_handle, uint16_t end_handle,
+                            const Uuid& uuid) {
+  discover_calls++;
+  return GATT_SUCCESS;
+}
+tGATT_STATUS GATTC_Discover(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
+                            uint16_t start_handle, uint16_t end_handle) {
+  discover_calls++;
+  return GATT_SUCCESS;
+}
+tGATT_STATUS GATTC_Read(uint16_t conn_id, tGATT_READ_TYPE type,
+                        tGATT_READ_PARAM* p_read) {
+  return GATT_SUCCESS;
+}
+
+bool SDP_InitDiscoveryDb(tSDP_DISCOVERY_DB* p_db, uint32_t len,
+                         uint16_t num_uuid, const Uuid* p_uuid_list,
+                         uint16_t num_attr, uint16_t* p_attr_list) {
+  return false;
+}
+bool SDP_ServiceSearchAttributeRequest2(const RawAddress& p_bd_addr,
+                                        tSDP_DISCOVERY_DB* p_db,
+                                        tSDP_DISC_CMPL_CB2* p_cb,
+                                        void* user_data) {
+  return false;
+}
+tSDP_DISC_REC* SDP_FindServiceInDb(tSDP_DISCOVERY_DB* p_db,
+                                   uint16_t service_uuid,
+                                   tSDP_DISC_REC* p_start_rec) {
+  return nullptr;
+}
+bool SDP_FindProtocolListElemInRec(tSDP_DISC_REC* p_rec, uint16_t layer_uuid,
+                                   tSDP_PROTOCOL_ELEM* p_elem) {
+  return false;
+}
+bool SDP_FindServiceUUIDInRec(tSDP_DISC_REC* p_rec, Uuid* p_uuid) {
+  return false;
+}
+
+bool btm_sec_is_a_bonded_dev(const RawAddress& bda) { return bonded; }
+
+tBTA_GATTC_CLCB* bta_gattc_find_clcb_by_conn_id(uint16_t conn_id) {
+  return conn_id == clcb.bta_conn_id ? &clcb : nullptr;
+}
+tBTA_GATTC_SERV* bta_gattc_find_scb_by_cid(uint16_t conn_id) {
+  return conn_id == clcb.bta_conn_id ? clcb.p_srcb : nullptr;
+}
+bool bta_gattc_sm_execute(tBTA_GATTC_CLCB* p_clcb, uint16_t event,
+                          tBTA_GATTC_DATA* p_data) {
+  return true;
+}
+void bta_gattc_reset_discover_st(tBTA_GATTC_SERV* p_srcb,
+                                 tGATT_STATUS status) {
+  reset_calls++;
+  reset_status = status;
+}
+
+namespace {
+
+const RawAddress kServerBda({0x11, 0x22, 0x33, 0x44, 0x55, 0x66});
+const Octet16 kHash{0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+                    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10};
+const Octet16 kOtherHash{0xaa};
+
+gatt::Database BuildDatabase() {
+  gatt::DatabaseBuilder builder;
+  builder.AddService(0x0001, 0x0005, Uuid::From16Bit(0x1800), true);
+  builder.AddCharacteristic(0x0002, 0x0003, Uuid::From16Bit(0x2a00), 0x02);
+  builder.AddDescriptor(0x0004, Uuid::From16Bit(0x2902));
+  builder.AddService(0x0010, 0x0012, Uuid::From16Bit(0x1801), true);
+  builder.AddCharacteristic(0x0011, 0x0012, Uuid::From16Bit(0x2b2a), 0x02);
+  return builder.Build();
+}
+
+class GattCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    cache_dir_ = ::testing::TempDir() + "gatt_cache_test_XXXXXX";
+    ASSERT_NE(mkdtemp(&cache_dir_[0]), nullptr);
+    cache_dir_ += "/";
+    gatt_cache_dir = cache_dir_.c_str();
+
+    srcb_ = tBTA_GATTC_SERV();
+    srcb_.server_bda = kServerBda;
+    clcb = tBTA_GATTC_CLCB();
+    clcb.bta_conn_id = kConnId;
+    clcb.transport = BTA_TRANSPORT_LE;
+    clcb.p_srcb = &srcb_;
+    clcb.status = GATT_SUCCESS;
+
+    bonded = false;
+    discover_calls = 0;
+    reset_calls = 0;
+    reset_status = GATT_ERROR;
+  }
+
+  void TearDown() override {
+    DIR* dir = opendir(cache_dir_.c_str());
+    if (dir) {
+      while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        unlink((cache_dir_ + entry->d_name).c_str());
+      }
+      closedir(dir);
+    }
+    rmdir(cache_dir_.c_str());
+    gatt_cache_dir = GATT_CACHE_DIR;
+  }
+
+  /* Completes the Database Hash read of |clcb| with |hash| */
+  void ReadDbHash(const Octet16& hash) {
+    tGATT_CL_COMPLETE cmpl;
+    memset(&cmpl, 0, sizeof(cmpl));
+    cmpl.att_value.len = OCTET16_LEN;
+    memcpy(cmpl.att_value.value, hash.data(), OCTET16_LEN);
+
+    tBTA_GATTC_OP_CMPL op_cmpl;
+    memset(&op_cmpl, 0, sizeof(op_cmpl));
+    op_cmpl.status = GATT_SUCCESS;
+    op_cmpl.p_cmpl = &cmpl;
+    bta_gattc_db_hash_read_cmpl(&clcb, &op_cmpl);
+  }
+
+  std::string cache_dir_;
+  tBTA_GATTC_SERV srcb_;
+};
+
+}  // namespace
+
+TEST_F(GattCacheTest, hash_cache_hit_skips_discovery) {
+  gatt::Database database = BuildDatabase();
+  bta_gattc_hash_cache_write(kHash, database.Serialize());
+
+  ReadDbHash(kHash);
+
+  EXPECT_EQ(discover_calls, 0);
+  EXPECT_EQ(reset_calls, 1);
+  EXPECT_EQ(reset_status, GATT_SUCCESS);
+  EXPECT_TRUE(srcb_.db_hash_valid);
+  EXPECT_EQ(srcb_.db_hash, kHash);
+  EXPECT_EQ(srcb_.gatt_database.ToString(), database.ToString());
+}
+
+TEST_F(GattCacheTest, hash_cache_miss_starts_discovery) {
+  bta_gattc_hash_cache_write(kOtherHash, BuildDatabase().Serialize());
+
+  ReadDbHash(kHash);
+
+  EXPECT_EQ(discover_calls, 1);
+  EXPECT_EQ(reset_calls, 0);
+  EXPECT_TRUE(srcb_.db_hash_valid);
+  EXPECT_TRUE(srcb_.gatt_database.IsEmpty());
+
+  gatt::Database database;
+  EXPECT_FALSE(bta_gattc_hash_cache_load(kHash, &database));
+}
+
+TEST_F(GattCacheTest, bonded_hash_cache_hit_links_address) {
+  gatt::Database database = BuildDatabase();
+  bta_gattc_hash_cache_write(kHash, database.Serialize());
+  bonded = true;
+
+  ReadDbHash(kHash);
+  ASSERT_EQ(reset_status, GATT_SUCCESS);
+
+  tBTA_GATTC_SERV srcb;
+  srcb.server_bda = kServerBda;
+  ASSERT_TRUE(bta_gattc_cache_load(&srcb));
+  EXPECT_TRUE(srcb.db_hash_valid);
+  EXPECT_EQ(srcb.db_hash, kHash);
+  EXPECT_EQ(srcb.gatt_database.ToString(), database.ToString());
+}
+
+TEST_F(GattCacheTest, link_loads_hash_cache) {
+  gatt::Database database = BuildDatabase();
+  bta_gattc_hash_cache_write(kHash, database.Serialize());
+  bta_gattc_cache_link(kServerBda, kHash);
+
+  ASSERT_TRUE(bta_gattc_cache_load(&srcb_));
+  EXPECT_TRUE(srcb_.db_hash_valid);
+  EXPECT_EQ(srcb_.db_hash, kHash);
+  EXPECT_EQ(srcb_.gatt_database.ToString(), database.ToString());
+}
+
+TEST_F(GattCacheTest, link_to_missing_hash_cache_fails) {
+  bta_gattc_cache_link(kServerBda, kHash);
+
+  EXPECT_FALSE(bta_gattc_cache_load(&srcb_));
+  EXPECT_FALSE(srcb_.db_hash_valid);
+}
+
+TEST_F(GattCacheTest, address_cache_loads_inline_attributes) {
+  gatt::Database database = BuildDatabase();
+  bta_gattc_cache_write(kServerBda, database.Serialize());
+
+  ASSERT_TRUE(bta_gattc_cache_load(&srcb_));
+  EXPECT_FALSE(srcb_.db_hash_valid);
+  EXPECT_EQ(srcb_.gatt_database.ToString(), database.ToString());
+}
+
+TEST_F(GattCacheTest, hash_cache_is_not_read_as_link) {
+  /* a hash keyed file is never a link, even when read by address */
+  gatt::Database database = BuildDatabase();
+  bta_gattc_hash_cache_write(kHash, database.Serialize());
+
+  char hash_fname[255] = {0};
+  bta_gattc_generate_hash_cache_file_name(hash_fname, sizeof(hash_fname),
+                                          kHash);
+  gatt::Database loaded;
+  Octet16 link;
+  bool is_link = true;
+  ASSERT_TRUE(bta_gattc_cache_load_file(hash_fname, &loaded, &link, &is_link));
+  EXPECT_FALSE(is_link);
+  EXPECT_EQ(link, kHash);
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares reading the bonding values of every paired device the way
+// btif_in_fetch_bonded_devices() did, looking each key up by section and key
+// name and decoding its string, with reading the typed records of the bond
+// store. Also measures the one time cost of building the store when the
+// config is loaded, and a single device property read.
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "btif/include/btif_config_cache.h"
+
+using ::benchmark::State;
+
+namespace {
+
+constexpr size_t kTemporarySectionCapacity = 10000;
+
+std::string MakeAddress(int n) {
+  char addr[18];
+  snprintf(addr, sizeof(addr), "00:11:22:33:%02x:%02x", (n >> 8) & 0xff,
+           n & 0xff);
+  return addr;
+}
+
+// A bt_config.conf with |num_devices| bonded devices, half of them dual mode
+// with LE keys
+std::unique_ptr<config_t> MakeConfig(int num_devices) {
+  auto config = std::make_unique<config_t>();
+  config->sections.push_back(section_t{"Adapter", {}});
+  config->sections.back().Set("Address", "01:02:03:04:05:06");
+  for (int i = 0; i < num_devices; i++) {
+    config->sections.push_back(section_t{MakeAddress(i), {}});
+    section_t& section = config->sections.back();
+    section.Set("Timestamp", "1600000000");
+    section.Set("Name", "Device " + std::to_string(i));
+    section.Set("DevClass", "2360344");
+    section.Set("Service", "0000110a-0000-1000-8000-00805f9b34fb");
+    section.Set("LinkKeyType", "5");
+    section.Set("PinLength", "0");
+    section.Set("LinkKey", "00112233445566778899aabbccddeeff");
+    if (i % 2) {
+      section.Set("DevType", "3");
+      section.Set("AddrType", "0");
+      section.Set("LE_KEY_PENC",
+                  "00112233445566778899aabbccddeeff0011223344556677000010");
+      section.Set("LE_KEY_PID",
+                  "00112233445566778899aabbccddeeff00001122334455");
+      section.Set("LE_KEY_LENC", "00112233445566778899aabbccddeeff0000001010");
+    } else {
+      section.Set("DevType", "1");
+    }
+  }
+  return config;
+}
+
+// btif_config_get_bin() without the lock and the keystore
+bool GetBin(BtifConfigCache& cache, const std::string& section,
+            const std::string& key, uint8_t* value, size_t* length) {
+  auto value_str = cache.GetString(section, key);
+  if (!value_str) return false;
+  size_t value_len = value_str->length();
+  if ((value_len % 2) != 0 || *length < (value_len / 2)) return false;
+  for (size_t i = 0; i < value_len; ++i)
+    if (!isxdigit(value_str->c_str()[i])) return false;
+  const char* ptr = value_str->c_str();
+  for (*length = 0; *ptr; ptr += 2, *length += 1) {
+    sscanf(ptr, "%02hhx", &value[*length]);
+  }
+  return true;
+}
+
+const char* const kLeKeys[] = {"LE_KEY_PENC",  "LE_KEY_PID",  "LE_KEY_LID",
+                               "LE_KEY_PCSRK", "LE_KEY_LENC", "LE_KEY_LCSRK"};
+
+}  // namespace
+
+class BM_BtifBondStore : public ::benchmark::Fixture {
+ protected:
+  // Argument is the number of bonded devices
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    num_devices_ = st.range(0);
+    cache_ = std::make_unique<BtifConfigCache>(kTemporarySectionCapacity);
+    cache_->Init(MakeConfig(num_devices_));
+  }
+
+  void TearDown(State& st) override {
+    cache_.reset();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  int num_devices_ = 0;
+  std::unique_ptr<BtifConfigCache> cache_;
+};
+
+/* The lookups of btif_in_fetch_bonded_devices() and
+ * btif_in_fetch_bonded_ble_device() for every device section */
+BENCHMARK_DEFINE_F(BM_BtifBondStore, load_bonds_from_strings)(State& state) {
+  for (auto _ : state) {
+    int num_keys = 0;
+    for (const section_t& section : cache_->GetPersistentSections()) {
+      const std::string& name = section.name;
+      if (!RawAddress::IsValidAddress(name)) continue;
+      uint8_t key[64];
+      size_t size = 16;
+      if (GetBin(*cache_, name, "LinkKey", key, &size) &&
+          cache_->GetInt(name, "LinkKeyType")) {
+        benchmark::DoNotOptimize(cache_->GetInt(name, "DevClass"));
+        benchmark::DoNotOptimize(cache_->GetInt(name, "PinLength"));
+        benchmark::DoNotOptimize(cache_->GetInt(name, "DevType"));
+        num_keys++;
+      }
+      auto dev_type = cache_->GetInt(name, "DevType");
+      if (dev_type && ((*dev_type & 2) || cache_->HasKey(name, "LE_KEY_PENC"))) {
+        benchmark::DoNotOptimize(cache_->GetInt(name, "AddrType"));
+        for (const char* le_key : kLeKeys) {
+          size = sizeof(key);
+          if (GetBin(*cache_, name, le_key, key, &size)) num_keys++;
+        }
+      }
+    }
+    benchmark::DoNotOptimize(num_keys);
+  }
+  state.SetItemsProcessed(state.iterations() * num_devices_);
+}
+
+/* The same values read from the typed records, including the copy
+ * btif_config_get_bond_records() makes under the config lock */
+BENCHMARK_DEFINE_F(BM_BtifBondStore, load_bonds_from_records)(State& state) {
+  for (auto _ : state) {
+    int num_keys = 0;
+    const auto& stored = cache_->GetBondStore().Records();
+    std::vector<BtifBondRecord> records(stored.begin(), stored.end());
+    for (const BtifBondRecord& record : records) {
+      uint8_t key[64];
+      const BtifBondKey& link_key = record.keys[BTIF_BOND_KEY_LINK_KEY];
+      if (link_key.state == BtifBondKey::DECODED && record.link_key_type) {
+        memcpy(key, link_key.value.data(), link_key.value.size());
+        benchmark::DoNotOptimize(record.dev_class);
+        benchmark::DoNotOptimize(record.pin_length);
+        num_keys++;
+      }
+      if (record.dev_type &&
+          ((*record.dev_type & 2) ||
+           record.keys[BTIF_BOND_KEY_LE_PENC].state != BtifBondKey::ABSENT)) {
+        benchmark::DoNotOptimize(record.addr_type);
+        for (int id = BTIF_BOND_KEY_LE_PENC; id < BTIF_BOND_KEY_COUNT; id++) {
+          const BtifBondKey& le_key = record.keys[id];
+          if (le_key.state != BtifBondKey::DECODED) continue;
+          memcpy(key, le_key.value.data(), le_key.value.size());
+          num_keys++;
+        }
+      }
+      benchmark::DoNotOptimize(key);
+    }
+    benchmark::DoNotOptimize(num_keys);
+  }
+  state.SetItemsProcessed(state.iterations() * num_devices_);
+}
+
+/* Loading the config into the cache, which builds the bond store */
+BENCHMARK_DEFINE_F(BM_BtifBondStore, init_with_bond_store)(State& state) {
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto config = MakeConfig(num_devices_);
+    BtifConfigCache cache(kTemporarySectionCapacity);
+    state.ResumeTiming();
+    cache.Init(std::move(config));
+    benchmark::DoNotOptimize(cache.GetBondStore().Records().size());
+  }
+  state.SetItemsProcessed(state.iterations() * num_devices_);
+}
+
+/* A remote device property read, e.g. BT_PROPERTY_TYPE_OF_DEVICE */
+BENCHMARK_DEFINE_F(BM_BtifBondStore, device_type_from_strings)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        cache_->GetInt(MakeAddress(i++ % num_devices_), "DevType"));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(BM_BtifBondStore, device_type_from_records)(State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    const BtifBondRecord* record =
+        cache_->GetBondStore().Find(MakeAddress(i++ % num_devices_));
+    benchmark::DoNotOptimize(record->dev_type);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_BtifBondStore, load_bonds_from_strings)
+    ->Arg(50)
+    ->Arg(500);
+BENCHMARK_REGISTER_F(BM_BtifBondStore, load_bonds_from_records)
+    ->Arg(50)
+    ->Arg(500);
+BENCHMARK_REGISTER_F(BM_BtifBondStore, init_with_bond_store)
+    ->Arg(50)
+    ->Arg(500);
+BENCHMARK_REGISTER_F(BM_BtifBondStore, device_type_from_strings)
+    ->Arg(50)
+    ->Arg(500);
+BENCHMARK_REGISTER_F(BM_BtifBondStore, device_type_from_records)
+    ->Arg(50)
+    ->Arg(500);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Loopback throughput of the PAN TAP data path. A SOCK_SEQPACKET socket pair
+ * stands in for the TAP driver, it keeps frame boundaries like a TAP fd does.
+ * A peer thread plays the remote end (iperf style sender or sink) while the
+ * benchmark runs the btif side the way btif_pan.cc does, the BNEP layer being
+ * replaced by a sink that releases the buffers. */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/if_ether.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+
+#include "bt_common.h"
+#include "btif/include/btif_pan_internal.h"
+#include "stack/include/pan_api.h"
+
+using ::benchmark::State;
+
+#define FRAME_PAYLOAD_LEN (ETH_DATA_LEN)
+#define FRAMES_PER_ITERATION 1000
+#define SOCKET_BUFFER_SIZE (1024 * 1024)
+
+namespace {
+
+/* Previous receive path: staging buffer, copy and poll per frame */
+unsigned char g_congest_packet[1600];
+
+/* Stand-in for forward_bnep(): BNEP consumes the buffer */
+void bnep_sink(tETH_HDR* eth_hdr, BT_HDR* buffer) {
+  benchmark::DoNotOptimize(eth_hdr->h_proto);
+  osi_free(buffer);
+}
+
+void wait_readable(int fd) {
+  struct pollfd ufd = {.fd = fd, .events = POLLIN, .revents = 0};
+  int ret;
+  OSI_NO_INTR(ret = poll(&ufd, 1, -1));
+}
+
+/* Returns the number of frames consumed in one wakeup */
+int read_burst_copy_poll(int fd) {
+  int frames = 0;
+  for (int i = 0; i < PAN_BUF_MAX; i++) {
+    BT_HDR* buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
+    buffer->offset = PAN_MINIMUM_OFFSET;
+    buffer->len = PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset;
+    uint8_t* packet = (uint8_t*)buffer + sizeof(BT_HDR) + buffer->offset;
+
+    ssize_t ret;
+    OSI_NO_INTR(ret = read(fd, g_congest_packet, sizeof(g_congest_packet)));
+    if (ret <= 0) {
+      osi_free(buffer);
+      break;
+    }
+    memcpy(packet, g_congest_packet, ret);
+    buffer->len = ret;
+
+    tETH_HDR hdr;
+    memcpy(&hdr, packet, sizeof(tETH_HDR));
+    buffer->len -= sizeof(tETH_HDR);
+    buffer->offset += sizeof(tETH_HDR);
+    bnep_sink(&hdr, buffer);
+    frames++;
+
+    struct pollfd ufd = {.fd = fd, .events = POLLIN, .revents = 0};
+    OSI_NO_INTR(ret = poll(&ufd, 1, 0));
+    if (ret <= 0) break;
+  }
+  return frames;
+}
+
+/* Current receive path, see btu_exec_tap_fd_read() */
+int read_burst_vectored(int fd) {
+  int frames = 0;
+  for (int i = 0; i < PAN_BUF_MAX; i++) {
+    BT_HDR* buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
+    buffer->offset = PAN_MINIMUM_OFFSET;
+    buffer->len = PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset;
+
+    tETH_HDR hdr;
+    if (btpan_tap_read_frame(fd, &hdr, buffer) <= 0) {
+      osi_free(buffer);
+      break;
+    }
+    bnep_sink(&hdr, buffer);
+    frames++;
+  }
+  return frames;
+}
+
+/* Previous transmit path, see btpan_tap_send() */
+void write_frame_copy(int fd, const tETH_HDR* eth_hdr, const uint8_t* buf,
+                      uint16_t len) {
+  char packet[TAP_MAX_PKT_WRITE_LEN + sizeof(tETH_HDR)];
+  memcpy(packet, eth_hdr, sizeof(tETH_HDR));
+  memcpy(packet + sizeof(tETH_HDR), buf, len);
+  ssize_t ret;
+  OSI_NO_INTR(ret = write(fd, packet, len + sizeof(tETH_HDR)));
+}
+
+void write_frame_vectored(int fd, const tETH_HDR* eth_hdr, const uint8_t* buf,
+                          uint16_t len) {
+  btpan_tap_write_frame(fd, eth_hdr, buf, len);
+}
+
+}  // namespace
+
+class BM_PanTap : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    int fds[2];
+    int ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds);
+    CHECK_EQ(ret, 0);
+    tap_fd_ = fds[0];
+    peer_fd_ = fds[1];
+    int size = SOCKET_BUFFER_SIZE;
+    setsockopt(tap_fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(tap_fd_, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(peer_fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(peer_fd_, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    /* the btif side of a TAP is non-blocking */
+    fcntl(tap_fd_, F_SETFL, fcntl(tap_fd_, F_GETFL, 0) | O_NONBLOCK);
+
+    eth_hdr_.h_dest = RawAddress({0x22, 0x22, 0x22, 0x22, 0x22, 0x22});
+    eth_hdr_.h_src = RawAddress({0x11, 0x11, 0x11, 0x11, 0x11, 0x11});
+    eth_hdr_.h_proto = htons(ETH_P_IP);
+    memset(payload_, 0x5a, sizeof(payload_));
+    running_ = true;
+  }
+
+  void TearDown(State& st) override {
+    running_ = false;
+    shutdown(tap_fd_, SHUT_RDWR);
+    if (peer_.joinable()) peer_.join();
+    close(tap_fd_);
+    close(peer_fd_);
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  /* Remote end sending full sized frames as fast as the TAP takes them */
+  void StartSender() {
+    peer_ = std::thread([this]() {
+      while (running_) {
+        if (btpan_tap_write_frame(peer_fd_, &eth_hdr_, payload_,
+                                  FRAME_PAYLOAD_LEN) < 0)
+          break;
+      }
+    });
+  }
+
+  /* Remote end draining whatever the TAP writes */
+  void StartSink() {
+    peer_ = std::thread([this]() {
+      uint8_t frame[ETH_FRAME_LEN];
+      while (running_) {
+        ssize_t ret;
+        OSI_NO_INTR(ret = read(peer_fd_, frame, sizeof(frame)));
+        if (ret <= 0) break;
+      }
+    });
+  }
+
+  void RunReceive(State& state, int (*read_burst)(int)) {
+    StartSender();
+    uint64_t wakeups = 0;
+    for (auto _ : state) {
+      int frames = 0;
+      while (frames < FRAMES_PER_ITERATION) {
+        wait_readable(tap_fd_);
+        frames += read_burst(tap_fd_);
+        wakeups++;
+      }
+    }
+    state.SetBytesProcessed(state.iterations() * FRAMES_PER_ITERATION *
+                            (FRAME_PAYLOAD_LEN + sizeof(tETH_HDR)));
+    state.counters["frames_per_wakeup"] =
+        (double)(state.iterations() * FRAMES_PER_ITERATION) / wakeups;
+  }
+
+  void RunTransmit(State& state,
+                   void (*write_frame)(int, const tETH_HDR*, const uint8_t*,
+                                       uint16_t)) {
+    StartSink();
+    /* transmit through a blocking fd so that the sink paces the sender */
+    fcntl(tap_fd_, F_SETFL, fcntl(tap_fd_, F_GETFL, 0) & ~O_NONBLOCK);
+    for (auto _ : state) {
+      for (int i = 0; i < FRAMES_PER_ITERATION; i++) {
+        write_frame(tap_fd_, &eth_hdr_, payload_, FRAME_PAYLOAD_LEN);
+      }
+    }
+    state.SetBytesProcessed(state.iterations() * FRAMES_PER_ITERATION *
+                            (FRAME_PAYLOAD_LEN + sizeof(tETH_HDR)));
+  }
+
+  int tap_fd_ = -1;
+  int peer_fd_ = -1;
+  tETH_HDR eth_hdr_;
+  uint8_t payload_[FRAME_PAYLOAD_LEN];
+  std::atomic<bool> running_;
+  std::thread peer_;
+};
+
+BENCHMARK_F(BM_PanTap, receive_copy_poll)(State& state) {
+  RunReceive(state, read_burst_copy_poll);
+};
+
+BENCHMARK_F(BM_PanTap, receive_vectored)(State& state) {
+  RunReceive(state, read_burst_vectored);
+};
+
+BENCHMARK_F(BM_PanTap, transmit_copy)(State& state) {
+  RunTransmit(state, write_frame_copy);
+};
+
+BENCHMARK_F(BM_PanTap, transmit_vectored)(State& state) {
+  RunTransmit(state, write_frame_vectored);
+};
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  // The peer thread stops on EPIPE when the TAP end is shut down
+  signal(SIGPIPE, SIG_IGN);
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
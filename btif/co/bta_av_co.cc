@@ -31,6 +31,7 @@
 
 #include "bt_target.h"
 
+#include "a2dp_abr.h"
 #include "a2dp_api.h"
 #include "a2dp_sbc.h"
 #include "bta_av_api.h"
@@ -1468,6 +1469,12 @@ void BtaAvCo::GetPeerEncoderParameters(
   p_peer_params->is_peer_edr = btif_av_is_peer_edr(peer_address);
   p_peer_params->peer_supports_3mbps =
       btif_av_peer_supports_3mbps(peer_address);
+  uint8_t abr_level;
+  if (BTM_GetPeerA2dpAbrLevel(peer_address, &abr_level)) {
+    p_peer_params->abr_start_level = abr_level;
+  } else {
+    p_peer_params->abr_start_level = A2DP_ABR_NUM_LEVELS - 1;
+  }
   APPL_TRACE_DEBUG(
       "%s: peer_address=%s peer_mtu=%d is_peer_edr=%s peer_supports_3mbps=%s",
       __func__, peer_address.ToString().c_str(), p_peer_params->peer_mtu,
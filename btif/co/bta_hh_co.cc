@@ -25,14 +25,17 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
+#include <mutex>
 
 #include "bta_api.h"
 #include "bta_hh_api.h"
 #include "bta_hh_co.h"
 #include "btif_hh.h"
 #include "btif_util.h"
+#include "common/time_util.h"
 #include "osi/include/osi.h"
 
 const char* dev_path = "/dev/uhid";
@@ -45,6 +48,17 @@ static tBTA_HH_RPT_CACHE_ENTRY sReportCache[BTA_HH_NV_LOAD_MAX];
 #define GET_RPT_RSP_OFFSET 9
 #define THREAD_NORMAL_PRIORITY 0
 #define BT_HH_THREAD "bt_hh_thread"
+/* epoll token of the eventfd used to stop the UHID service thread */
+#define UHID_WAKEUP_TOKEN UINT64_MAX
+
+/* A single thread services the UHID fds of all the connected devices. It is
+ * started with the first device and stopped with the last one. */
+static int uhid_epoll_fd = -1;
+static int uhid_wakeup_fd = -1;
+static pthread_t uhid_thread_id = -1;
+/* Serializes the handling of UHID events with the (un)registration of the
+ * device fds done from the BTA thread */
+static std::mutex uhid_lock;
 
 void uhid_set_non_blocking(int fd) {
   int opts = fcntl(fd, F_GETFL);
@@ -60,17 +74,18 @@ void uhid_set_non_blocking(int fd) {
 }
 
 /*Internal function to perform UHID write and error checking*/
-static int uhid_write(int fd, const struct uhid_event* ev) {
+static int uhid_write(int fd, const struct uhid_event* ev,
+                      size_t size = sizeof(struct uhid_event)) {
   ssize_t ret;
-  OSI_NO_INTR(ret = write(fd, ev, sizeof(*ev)));
+  OSI_NO_INTR(ret = write(fd, ev, size));
 
   if (ret < 0) {
     int rtn = -errno;
     APPL_TRACE_ERROR("%s: Cannot write to uhid:%s", __func__, strerror(errno));
     return rtn;
-  } else if (ret != (ssize_t)sizeof(*ev)) {
+  } else if (ret != (ssize_t)size) {
     APPL_TRACE_ERROR("%s: Wrong size written to uhid: %zd != %zu", __func__,
-                     ret, sizeof(*ev));
+                     ret, size);
     return -EFAULT;
   }
 
@@ -218,19 +233,32 @@ static inline pthread_t create_thread(void* (*start_routine)(void*),
   return thread_id;
 }
 
+static inline uint64_t uhid_epoll_token(const btif_hh_device_t* p_dev) {
+  return ((uint64_t)(p_dev - btif_hh_cb.devices) << 32) | (uint32_t)p_dev->fd;
+}
+
+/* Stops watching the fd of a device. Called with uhid_lock held. */
+static void uhid_unwatch_locked(btif_hh_device_t* p_dev) {
+  if (!p_dev->uhid_registered) return;
+  if (epoll_ctl(uhid_epoll_fd, EPOLL_CTL_DEL, p_dev->fd, NULL) < 0)
+    APPL_TRACE_ERROR("%s: Cannot remove fd %d from epoll: %s", __func__,
+                     p_dev->fd, strerror(errno));
+  p_dev->uhid_registered = false;
+}
+
 /*******************************************************************************
  *
  * Function btif_hh_poll_event_thread
  *
- * Description the polling thread which polls for event from UHID driver
+ * Description the thread which waits for the events from the UHID driver of
+ *             all the connected devices
  *
  * Returns void
  *
  ******************************************************************************/
-static void* btif_hh_poll_event_thread(void* arg) {
-  btif_hh_device_t* p_dev = (btif_hh_device_t*)arg;
-  APPL_TRACE_DEBUG("%s: Thread created fd = %d", __func__, p_dev->fd);
-  struct pollfd pfds[1];
+static void* btif_hh_poll_event_thread(UNUSED_ATTR void* arg) {
+  APPL_TRACE_DEBUG("%s: Thread created", __func__);
+  struct epoll_event events[BTIF_HH_MAX_HID + 1];
 
   // This thread is created by bt_main_thread with RT priority. Lower the thread
   // priority here since the tasks in this thread is not timing critical.
@@ -238,50 +266,137 @@ static void* btif_hh_poll_event_thread(void* arg) {
   sched_params.sched_priority = THREAD_NORMAL_PRIORITY;
   if (sched_setscheduler(gettid(), SCHED_OTHER, &sched_params)) {
     APPL_TRACE_ERROR("%s: Failed to set thread priority to normal", __func__);
-    p_dev->hh_poll_thread_id = -1;
-    return 0;
   }
   pthread_setname_np(pthread_self(), BT_HH_THREAD);
 
-  pfds[0].fd = p_dev->fd;
-  pfds[0].events = POLLIN;
-
-  // Set the uhid fd as non-blocking to ensure we never block the BTU thread
-  uhid_set_non_blocking(p_dev->fd);
-
-  while (p_dev->hh_keep_polling) {
+  for (;;) {
     int ret;
-    OSI_NO_INTR(ret = poll(pfds, 1, 50));
+    OSI_NO_INTR(ret = epoll_wait(uhid_epoll_fd, events, ARRAY_SIZE(events), -1));
     if (ret < 0) {
       APPL_TRACE_ERROR("%s: Cannot poll for fds: %s\n", __func__,
                        strerror(errno));
       break;
     }
-    if (pfds[0].revents & POLLIN) {
-      APPL_TRACE_DEBUG("%s: POLLIN", __func__);
-      ret = uhid_read_event(p_dev);
-      if (ret != 0) break;
+
+    for (int i = 0; i < ret; i++) {
+      if (events[i].data.u64 == UHID_WAKEUP_TOKEN) return 0;
+
+      std::lock_guard<std::mutex> lock(uhid_lock);
+      uint32_t idx = events[i].data.u64 >> 32;
+      int fd = (int)(uint32_t)events[i].data.u64;
+      btif_hh_device_t* p_dev = &btif_hh_cb.devices[idx];
+      // The device may have been unregistered while the event was pending
+      if (!p_dev->uhid_registered || p_dev->fd != fd) continue;
+
+      if (events[i].events & EPOLLIN) {
+        APPL_TRACE_DEBUG("%s: POLLIN fd = %d", __func__, fd);
+        if (uhid_read_event(p_dev) != 0) uhid_unwatch_locked(p_dev);
+      } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        APPL_TRACE_ERROR("%s: Error on uhid fd = %d", __func__, fd);
+        uhid_unwatch_locked(p_dev);
+      }
     }
   }
 
-  p_dev->hh_poll_thread_id = -1;
   return 0;
 }
 
-static inline void btif_hh_close_poll_thread(btif_hh_device_t* p_dev) {
+static bool btif_hh_start_poll_thread() {
+  uhid_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (uhid_epoll_fd < 0) {
+    APPL_TRACE_ERROR("%s: Cannot create epoll fd: %s", __func__,
+                     strerror(errno));
+    return false;
+  }
+
+  uhid_wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.u64 = UHID_WAKEUP_TOKEN;
+  if (uhid_wakeup_fd < 0 ||
+      epoll_ctl(uhid_epoll_fd, EPOLL_CTL_ADD, uhid_wakeup_fd, &ev) < 0) {
+    APPL_TRACE_ERROR("%s: Cannot set up wakeup fd: %s", __func__,
+                     strerror(errno));
+  } else {
+    uhid_thread_id = create_thread(btif_hh_poll_event_thread, NULL);
+    if (uhid_thread_id != (pthread_t)-1) return true;
+  }
+
+  if (uhid_wakeup_fd >= 0) close(uhid_wakeup_fd);
+  close(uhid_epoll_fd);
+  uhid_wakeup_fd = -1;
+  uhid_epoll_fd = -1;
+  return false;
+}
+
+static void btif_hh_stop_poll_thread() {
   APPL_TRACE_DEBUG("%s", __func__);
-  p_dev->hh_keep_polling = 0;
-  if (p_dev->hh_poll_thread_id > 0)
-    pthread_join(p_dev->hh_poll_thread_id, NULL);
+  eventfd_write(uhid_wakeup_fd, 1);
+  pthread_join(uhid_thread_id, NULL);
+  uhid_thread_id = -1;
+  close(uhid_wakeup_fd);
+  close(uhid_epoll_fd);
+  uhid_wakeup_fd = -1;
+  uhid_epoll_fd = -1;
+}
+
+/* Hands the uhid fd of a device over to the service thread */
+static void btif_hh_open_poll(btif_hh_device_t* p_dev) {
+  std::lock_guard<std::mutex> lock(uhid_lock);
+  if (p_dev->uhid_registered) return;
+  if (uhid_epoll_fd < 0 && !btif_hh_start_poll_thread()) return;
+
+  // Set the uhid fd as non-blocking to ensure we never block the BTU thread
+  uhid_set_non_blocking(p_dev->fd);
 
-  return;
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.u64 = uhid_epoll_token(p_dev);
+  if (epoll_ctl(uhid_epoll_fd, EPOLL_CTL_ADD, p_dev->fd, &ev) < 0) {
+    APPL_TRACE_ERROR("%s: Cannot add fd %d to epoll: %s", __func__, p_dev->fd,
+                     strerror(errno));
+    return;
+  }
+  p_dev->uhid_registered = true;
+}
+
+/* Stops servicing a uhid fd, and the service thread with the last one */
+static void btif_hh_close_poll(int fd) {
+  APPL_TRACE_DEBUG("%s: fd = %d", __func__, fd);
+  bool idle = true;
+  {
+    std::lock_guard<std::mutex> lock(uhid_lock);
+    if (uhid_epoll_fd < 0) return;
+    for (int i = 0; i < BTIF_HH_MAX_HID; i++) {
+      btif_hh_device_t* p_dev = &btif_hh_cb.devices[i];
+      if (p_dev->uhid_registered && p_dev->fd == fd) uhid_unwatch_locked(p_dev);
+      if (p_dev->uhid_registered) idle = false;
+    }
+  }
+
+  // The thread takes uhid_lock, join it without holding the lock
+  if (idle) btif_hh_stop_poll_thread();
+}
+
+static void btif_hh_record_input_latency(btif_hh_input_stats_t* p_stats,
+                                         uint64_t latency_us) {
+  size_t bucket = 0;
+  for (uint64_t v = latency_us >> 1; v != 0; v >>= 1) bucket++;
+  if (bucket >= BTIF_HH_LATENCY_BUCKETS) bucket = BTIF_HH_LATENCY_BUCKETS - 1;
+
+  p_stats->count++;
+  p_stats->total_us += latency_us;
+  if (latency_us > p_stats->max_us) p_stats->max_us = latency_us;
+  p_stats->latency_buckets[bucket]++;
 }
 
 void bta_hh_co_destroy(int fd) {
+  btif_hh_close_poll(fd);
+
   struct uhid_event ev;
   memset(&ev, 0, sizeof(ev));
   ev.type = UHID_DESTROY;
-  uhid_write(fd, &ev);
+  uhid_write(fd, &ev, sizeof(ev.type));
   APPL_TRACE_DEBUG("%s: Closing fd=%d", __func__, fd);
   close(fd);
 }
@@ -290,16 +405,16 @@ int bta_hh_co_write(int fd, uint8_t* rpt, uint16_t len) {
   APPL_TRACE_VERBOSE("%s: UHID write %d", __func__, len);
 
   struct uhid_event ev;
-  memset(&ev, 0, sizeof(ev));
-  ev.type = UHID_INPUT;
-  ev.u.input.size = len;
-  if (len > sizeof(ev.u.input.data)) {
+  if (len > sizeof(ev.u.input2.data)) {
     APPL_TRACE_WARNING("%s: Report size greater than allowed size", __func__);
     return -1;
   }
-  memcpy(ev.u.input.data, rpt, len);
+  // Only the report is written, the kernel zero fills the rest of the event
+  ev.type = UHID_INPUT2;
+  ev.u.input2.size = len;
+  memcpy(ev.u.input2.data, rpt, len);
 
-  return uhid_write(fd, &ev);
+  return uhid_write(fd, &ev, offsetof(struct uhid_event, u.input2.data) + len);
 }
 
 /*******************************************************************************
@@ -343,9 +458,7 @@ void bta_hh_co_open(uint8_t dev_handle, uint8_t sub_class,
           APPL_TRACE_DEBUG("%s: uhid fd = %d", __func__, p_dev->fd);
       }
 
-      p_dev->hh_keep_polling = 1;
-      p_dev->hh_poll_thread_id =
-          create_thread(btif_hh_poll_event_thread, p_dev);
+      btif_hh_open_poll(p_dev);
       break;
     }
     p_dev = NULL;
@@ -361,6 +474,7 @@ void bta_hh_co_open(uint8_t dev_handle, uint8_t sub_class,
         p_dev->sub_class = sub_class;
         p_dev->app_id = app_id;
         p_dev->local_vup = false;
+        memset(&p_dev->input_stats, 0, sizeof(p_dev->input_stats));
 
         btif_hh_cb.device_num++;
         // This is a new device,open the uhid driver now.
@@ -371,9 +485,7 @@ void bta_hh_co_open(uint8_t dev_handle, uint8_t sub_class,
           return;
         } else {
           APPL_TRACE_DEBUG("%s: uhid fd = %d", __func__, p_dev->fd);
-          p_dev->hh_keep_polling = 1;
-          p_dev->hh_poll_thread_id =
-              create_thread(btif_hh_poll_event_thread, p_dev);
+          btif_hh_open_poll(p_dev);
         }
 
         break;
@@ -428,7 +540,7 @@ void bta_hh_co_close(uint8_t dev_handle, uint8_t app_id) {
           "%s: Found an existing device with the same handle "
           "dev_status = %d, dev_handle =%d",
           __func__, p_dev->dev_status, p_dev->dev_handle);
-      btif_hh_close_poll_thread(p_dev);
+      if (p_dev->fd >= 0) btif_hh_close_poll(p_dev->fd);
       break;
     }
   }
@@ -447,13 +559,14 @@ void bta_hh_co_close(uint8_t dev_handle, uint8_t app_id) {
  *                  mode        - Hid host Protocol Mode
  *                  sub_clas    - Device Subclass
  *                  app_id      - application id
+ *                  timestamp_us - time the report was received
  *
  * Returns          void
  ******************************************************************************/
 void bta_hh_co_data(uint8_t dev_handle, uint8_t* p_rpt, uint16_t len,
                     tBTA_HH_PROTO_MODE mode, uint8_t sub_class,
                     uint8_t ctry_code, UNUSED_ATTR const RawAddress& peer_addr,
-                    uint8_t app_id) {
+                    uint8_t app_id, uint64_t timestamp_us) {
   btif_hh_device_t* p_dev;
 
   APPL_TRACE_DEBUG(
@@ -480,8 +593,15 @@ void bta_hh_co_data(uint8_t dev_handle, uint8_t* p_rpt, uint16_t len,
 
   // Send the HID data to the kernel.
   if ((p_dev->fd >= 0) && p_dev->ready_for_data) {
-    bta_hh_co_write(p_dev->fd, p_rpt, len);
+    if (bta_hh_co_write(p_dev->fd, p_rpt, len) == 0) {
+      btif_hh_record_input_latency(
+          &p_dev->input_stats,
+          bluetooth::common::time_get_os_boottime_us() - timestamp_us);
+    } else {
+      p_dev->input_stats.errors++;
+    }
   } else {
+    p_dev->input_stats.errors++;
     APPL_TRACE_WARNING("%s: Error: fd = %d, ready %d, len = %d", __func__,
                        p_dev->fd, p_dev->ready_for_data, len);
   }
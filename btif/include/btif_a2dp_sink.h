@@ -120,8 +120,9 @@ void btif_a2dp_sink_set_rx_flush(bool enable);
 // maximum size |MAX_INPUT_A2DP_FRAME_QUEUE_SZ|, the oldest buffer is
 // removed from the queue.
 // |p_buf| is the buffer to enqueue.
+// |time_stamp| is the RTP timestamp of the buffer.
 // Returns the number of buffers in the Sink queue after the enqueing.
-uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_buf);
+uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_buf, uint32_t time_stamp);
 
 // Dump debug-related information for the A2DP Sink module.
 // |fd| is the file descriptor to use for writing the ASCII formatted
@@ -0,0 +1,164 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Decodes the oldest packet of the Sink queue, handing its PCM back through
+// BtifA2dpSinkPlayout::AddPcm(). |p_media_timestamp| is set to the timestamp
+// BtifA2dpSinkPlayout::OnPacketReceived() returned for the packet.
+// Returns false if the queue is empty.
+typedef bool (*btif_a2dp_sink_decode_next_t)(uint32_t* p_media_timestamp);
+
+// Writes |len| bytes of PCM to the audio track.
+typedef void (*btif_a2dp_sink_write_pcm_t)(const uint8_t* data, size_t len);
+
+// Playout engine of the A2DP Sink.
+//
+// The received packets are timed against the local boot time clock: the
+// spread of their arrival times sizes the buffer, and the drift between the
+// RTP clock of the Source and the local clock is estimated from the earliest
+// arrivals. Audio is played out at the local clock, resampled by a small
+// ratio so that the buffer stays at its target depth instead of slowly
+// filling up or running dry.
+class BtifA2dpSinkPlayout {
+ public:
+  BtifA2dpSinkPlayout(btif_a2dp_sink_decode_next_t decode_next,
+                      btif_a2dp_sink_write_pcm_t write_pcm)
+      : decode_next_(decode_next), write_pcm_(write_pcm) {
+    Configure(0, 0, 0, false);
+  }
+
+  // Resets the engine and its statistics for a new decoder configuration.
+  // |drift_compensation| false plays out at the rate of the Source, and only
+  // drops audio once the buffer is too deep.
+  void Configure(int sample_rate, int channel_count, int bits_per_sample,
+                 bool drift_compensation);
+
+  // Drops the buffered audio after the Sink queue was flushed. The clock
+  // drift estimate and the statistics are kept.
+  void Flush();
+
+  // Times a packet entering the Sink queue. Returns the timestamp of the
+  // packet on the media timeline of the Sink, which carries on over RTP
+  // timestamp discontinuities; it is handed back when the packet is decoded.
+  uint32_t OnPacketReceived(uint32_t rtp_timestamp, uint64_t arrival_us);
+
+  // Counts a packet dropped from a full Sink queue without being decoded.
+  void OnPacketDropped() { queue_dropped_packets_++; }
+
+  // Decoded audio of the packet being decoded.
+  void AddPcm(const uint8_t* data, size_t len);
+
+  // Plays out the audio due at |now_us|, decoding packets as needed.
+  void OnTick(uint64_t now_us);
+
+  bool IsPlaying() const { return playing_; }
+  uint64_t DepthUs() const;
+  uint64_t TargetDepthUs() const;
+  double DriftPpm() const { return drift_ppm_; }
+  double CorrectionPpm() const { return correction_ppm_; }
+  size_t Underruns() const { return underruns_; }
+  size_t Overflows() const { return overflows_; }
+  size_t Discontinuities() const { return discontinuities_; }
+  uint64_t FramesPlayed() const { return frames_played_; }
+
+  // Dumps the buffer state and statistics.
+  void Dump(int fd) const;
+
+ private:
+  // Earliest and latest transit time of the packets received during one
+  // window of the local clock
+  struct ArrivalWindow {
+    uint64_t start_us;
+    int64_t min_transit_us;
+    int64_t max_transit_us;
+  };
+
+  uint64_t FramesToUs(uint64_t frames) const;
+  uint64_t DepthFrames() const;
+  uint64_t LatePeakUs() const;
+  size_t PcmFrames() const { return (pcm_.size() - pcm_read_) / frame_bytes_; }
+  void ResetArrivalWindows();
+  void CloseArrivalWindow();
+  void EstimateDrift();
+  // Decodes packets until |frames| frames of PCM are buffered. Returns false
+  // if the Sink queue ran dry first.
+  bool DecodeUntil(size_t frames);
+  void ConsumePcm(size_t frames);
+  // Resamples up to |frames| frames of output from the PCM buffer, and
+  // returns the number of frames written.
+  size_t Resample(size_t frames, uint64_t step_q32);
+  void StartBuffering(uint64_t now_us);
+
+  btif_a2dp_sink_decode_next_t decode_next_;
+  btif_a2dp_sink_write_pcm_t write_pcm_;
+
+  int sample_rate_;
+  int channel_count_;
+  int sample_bytes_;
+  size_t frame_bytes_;
+  bool drift_compensation_;
+
+  // Media timeline, in frames since Configure()
+  bool has_rx_;
+  uint32_t last_rtp_timestamp_;
+  uint32_t last_packet_frames_;
+  uint64_t media_timestamp_;
+  uint64_t first_rx_timestamp_;
+  bool has_decoded_;
+  uint64_t decoded_end_timestamp_;
+  bool queue_empty_;
+
+  // Arrival timing
+  bool has_transit_;
+  int64_t last_transit_us_;
+  double jitter_us_;  // RFC 3550 interarrival jitter
+  ArrivalWindow current_window_;
+  std::vector<ArrivalWindow> windows_;  // ring of closed windows
+  size_t windows_next_;
+  bool drift_valid_;
+  double drift_ppm_;
+
+  // Decoded audio not played out yet, and the position of the resampler in it
+  std::vector<uint8_t> pcm_;
+  size_t pcm_read_;
+  uint64_t phase_q32_;
+  std::vector<uint8_t> output_;
+
+  // Playout state
+  bool playing_;
+  uint64_t play_start_us_;
+  uint64_t play_start_frames_;
+  bool rebuffering_;
+  uint64_t buffering_start_us_;
+  double depth_average_us_;
+  double correction_ppm_;
+
+  // Statistics
+  size_t packets_received_;
+  size_t discontinuities_;
+  size_t underruns_;
+  size_t overflows_;
+  size_t queue_dropped_packets_;
+  uint64_t overflow_dropped_frames_;
+  uint64_t frames_played_;
+  uint64_t rebuffering_us_;
+  uint64_t max_depth_us_;
+};
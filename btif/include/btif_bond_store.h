@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "osi/include/config.h"
+#include "raw_address.h"
+
+// Keys of a device section holding hex encoded keys
+enum BtifBondKeyId {
+  BTIF_BOND_KEY_LINK_KEY,
+  BTIF_BOND_KEY_LE_PENC,
+  BTIF_BOND_KEY_LE_PID,
+  BTIF_BOND_KEY_LE_LID,
+  BTIF_BOND_KEY_LE_PCSRK,
+  BTIF_BOND_KEY_LE_LENC,
+  BTIF_BOND_KEY_LE_LCSRK,
+  BTIF_BOND_KEY_COUNT,
+};
+
+// A hex encoded key, decoded when it is written.
+struct BtifBondKey {
+  enum State : uint8_t {
+    ABSENT,
+    DECODED,
+    // Present but not plain hex: keystore placeholder or malformed value,
+    // only btif_config_get_bin() knows how to read it
+    OPAQUE,
+  };
+
+  State state = ABSENT;
+  std::vector<uint8_t> value;
+};
+
+// The bonding values of a paired device section, with the integers and keys
+// decoded as btif_config_get_int() and btif_config_get_bin() decode them.
+struct BtifBondRecord {
+  std::string section_name;
+  RawAddress bd_addr;
+  BtifBondKey keys[BTIF_BOND_KEY_COUNT];
+  std::optional<int> link_key_type;
+  std::optional<int> pin_length;
+  std::optional<int> dev_class;
+  std::optional<int> dev_type;
+  std::optional<int> addr_type;
+};
+
+// Typed mirror of the paired device sections of the config, so that bond
+// loading and device property reads neither look sections up by name in the
+// config list nor parse strings. BtifConfigCache keeps it in sync with its
+// persistent sections.
+class BtifBondStore {
+ public:
+  void Clear();
+
+  // Rebuilds the store from the persistent sections
+  void Load(const std::list<section_t>& sections);
+
+  // A section was added to the persistent sections, after the existing ones
+  void AddSection(const section_t& section);
+  void RemoveSection(const std::string& section_name);
+
+  // A key of a persistent section was written or removed
+  void Set(const std::string& section_name, const std::string& key,
+           const std::string& value);
+  void Remove(const std::string& section_name, const std::string& key);
+
+  const BtifBondRecord* Find(const std::string& section_name) const;
+
+  // Records in the order of the persistent sections
+  const std::list<BtifBondRecord>& Records() const { return records_; }
+
+  static const char* KeyName(BtifBondKeyId id);
+
+  // The BtifBondKeyId of |key|, or -1 if it is not a key the store decodes
+  static int KeyId(const std::string& key);
+
+  // The integer field |key| is decoded to, or nullptr
+  static std::optional<int> BtifBondRecord::*IntField(const std::string& key);
+
+ private:
+  static void SetValue(BtifBondRecord* record, const std::string& key,
+                       const std::string* value);
+
+  std::list<BtifBondRecord> records_;
+  std::unordered_map<std::string, std::list<BtifBondRecord>::iterator> index_;
+};
@@ -25,6 +25,8 @@
 
 #include <list>
 #include <string>
+#include <vector>
+#include "btif_bond_store.h"
 #include "osi/include/config.h"
 
 static const char BTIF_CONFIG_MODULE[] = "btif_config_module";
@@ -41,6 +43,20 @@ static const std::string BT_CONFIG_KEY_REMOTE_VER_MFCT = "Manufacturer";
 static const std::string BT_CONFIG_KEY_REMOTE_VER_VER = "LmpVer";
 static const std::string BT_CONFIG_KEY_REMOTE_VER_SUBVER = "LmpSubVer";
 
+static const std::string BT_CONFIG_KEY_LEARNED_CONN_INTERVAL =
+    "LearnedConnInterval";
+static const std::string BT_CONFIG_KEY_LEARNED_CONN_LATENCY =
+    "LearnedConnLatency";
+static const std::string BT_CONFIG_KEY_LEARNED_CONN_TIMEOUT =
+    "LearnedConnTimeout";
+static const std::string BT_CONFIG_KEY_LEARNED_TX_PHY = "LearnedTxPhy";
+static const std::string BT_CONFIG_KEY_LEARNED_RX_PHY = "LearnedRxPhy";
+static const std::string BT_CONFIG_KEY_LEARNED_DATA_LENGTH =
+    "LearnedDataLength";
+static const std::string BT_CONFIG_KEY_LEARNED_MTU = "LearnedMtu";
+static const std::string BT_CONFIG_KEY_LEARNED_A2DP_LEVEL = "LearnedA2dpLevel";
+static const std::string BT_CONFIG_KEY_LEARNED_RSSI = "LearnedRssi";
+
 bool btif_config_has_section(const char* section);
 bool btif_config_exist(const std::string& section, const std::string& key);
 bool btif_config_get_int(const std::string& section, const std::string& key,
@@ -66,6 +82,15 @@ size_t btif_config_get_bin_length(const std::string& section,
 
 const std::list<section_t>& btif_config_sections();
 
+// Bonding values of the paired device of |section|, decoded once when they
+// were written. Returns false if the device has no persistent section. Keys
+// the record marks OPAQUE have to be read with btif_config_get_bin().
+bool btif_config_get_bond_record(const std::string& section,
+                                 BtifBondRecord* record);
+
+// Bonding values of all the paired devices, in config order
+std::vector<BtifBondRecord> btif_config_get_bond_records();
+
 void btif_config_save(void);
 void btif_config_flush(void);
 bool btif_config_clear(void);
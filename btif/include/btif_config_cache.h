@@ -19,6 +19,7 @@
 #include <map>
 #include <unordered_set>
 
+#include "btif_bond_store.h"
 #include "common/lru.h"
 #include "osi/include/config.h"
 #include "osi/include/log.h"
@@ -54,7 +55,11 @@ class BtifConfigCache {
   std::optional<bool> GetBool(const std::string& section_name,
                               const std::string& key);
 
+  // Typed view of the persistent device sections
+  const BtifBondStore& GetBondStore() const { return bond_store_; }
+
  private:
   bluetooth::common::LruCache<std::string, section_t> unpaired_devices_cache_;
   config_t paired_devices_list_;
+  BtifBondStore bond_store_;
 };
@@ -32,4 +32,6 @@ extern const btgatt_server_interface_t btgattServerInterface;
 
 BleAdvertiserInterface* get_ble_advertiser_instance();
 BleScannerInterface* get_ble_scanner_instance();
+
+void btif_debug_scanner_dump(int fd);
 #endif
@@ -42,6 +42,11 @@
 #define BTIF_HH_MAX_POLLING_ATTEMPTS 10
 #define BTIF_HH_POLLING_SLEEP_DURATION_US 5000
 
+/* Number of buckets of the input latency histogram. Bucket 0 counts the
+ * reports delivered in less than 2 us, bucket n those delivered in
+ * [2^n, 2^(n+1)) us and the last one all the slower ones. */
+#define BTIF_HH_LATENCY_BUCKETS 20
+
 /*******************************************************************************
  *  Type definitions and return values
  ******************************************************************************/
@@ -56,6 +61,15 @@ typedef enum {
   BTIF_HH_DEV_DISCONNECTED
 } BTIF_HH_STATUS;
 
+/* Delivery of the input reports of a device to UHID */
+typedef struct {
+  uint64_t count;        /* reports written to UHID */
+  uint64_t errors;       /* reports that could not be written */
+  uint64_t total_us;     /* sum of the latencies */
+  uint64_t max_us;       /* worst latency */
+  uint64_t latency_buckets[BTIF_HH_LATENCY_BUCKETS];
+} btif_hh_input_stats_t;
+
 typedef struct {
   bthh_connection_state_t dev_status;
   uint8_t dev_handle;
@@ -65,12 +79,12 @@ typedef struct {
   uint8_t app_id;
   int fd;
   bool ready_for_data;
-  pthread_t hh_poll_thread_id;
-  uint8_t hh_keep_polling;
+  bool uhid_registered;  // fd is watched by the UHID service thread
   alarm_t* vup_timer;
   fixed_queue_t* get_rpt_id_queue;
   uint8_t get_rpt_snt;
   bool local_vup;  // Indicated locally initiated VUP
+  btif_hh_input_stats_t input_stats;
 } btif_hh_device_t;
 
 /* Control block to maintain properties of devices */
@@ -114,4 +128,6 @@ extern void btif_hh_getreport(btif_hh_device_t* p_dev,
                               uint16_t bufferSize);
 extern void btif_hh_service_registration(bool enable);
 
+extern void btif_debug_hh_dump(int fd);
+
 #endif
@@ -27,8 +27,11 @@
 #ifndef BTIF_PAN_INTERNAL_H
 #define BTIF_PAN_INTERNAL_H
 
+#include <sys/uio.h>
+
 #include "bt_types.h"
 #include "btif_pan.h"
+#include "osi/include/osi.h"
 
 /*******************************************************************************
  *  Constants & Macros
@@ -79,8 +82,8 @@ typedef struct {
   int open_count;
   int flow;  // 1: outbound data flow on; 0: outbound data flow off
   btpan_conn_t conns[MAX_PAN_CONNS];
-  int congest_packet_size;
-  unsigned char congest_packet[1600];  // max ethernet packet size
+  BT_HDR* congest_buf;      // frame read from the TAP that BNEP could not take
+  tETH_HDR congest_eth_hdr;  // ethernet header of congest_buf
 } btpan_cb_t;
 
 /*******************************************************************************
@@ -111,4 +114,38 @@ static inline int is_valid_bt_eth_addr(const RawAddress& addr) {
   return addr.address[0] & 1 ? 0 : 1; /* Cannot be multicasting address */
 }
 
+/* Reads one frame from the TAP |fd|: the ethernet header into |eth_hdr| and
+ * the payload straight into the data area of |buffer|, whose len is the room
+ * available on input and the payload length on output.
+ * Returns the frame length as read(2) does. */
+static inline ssize_t btpan_tap_read_frame(int fd, tETH_HDR* eth_hdr,
+                                           BT_HDR* buffer) {
+  struct iovec iov[2];
+  iov[0].iov_base = eth_hdr;
+  iov[0].iov_len = sizeof(tETH_HDR);
+  iov[1].iov_base = (uint8_t*)(buffer + 1) + buffer->offset;
+  iov[1].iov_len = buffer->len;
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = readv(fd, iov, 2));
+  buffer->len = (ret > (ssize_t)sizeof(tETH_HDR)) ? ret - sizeof(tETH_HDR) : 0;
+  return ret;
+}
+
+/* Writes one frame made of |eth_hdr| and |len| bytes of |payload| to the TAP
+ * |fd| without assembling it first.
+ * Returns the frame length as write(2) does. */
+static inline ssize_t btpan_tap_write_frame(int fd, const tETH_HDR* eth_hdr,
+                                            const void* payload, uint16_t len) {
+  struct iovec iov[2];
+  iov[0].iov_base = (void*)eth_hdr;
+  iov[0].iov_len = sizeof(tETH_HDR);
+  iov[1].iov_base = (void*)payload;
+  iov[1].iov_len = len;
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = writev(fd, iov, 2));
+  return ret;
+}
+
 #endif
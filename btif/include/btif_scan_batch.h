@@ -0,0 +1,63 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "raw_address.h"
+
+// An LE scan result as handed to the scanner callbacks
+struct BtifScanResult {
+  RawAddress bd_addr;
+  uint8_t device_type;
+  int8_t rssi;
+  uint8_t addr_type;
+  uint16_t ble_evt_type;
+  uint8_t ble_primary_phy;
+  uint8_t ble_secondary_phy;
+  uint8_t ble_advertising_sid;
+  int8_t ble_tx_power;
+  uint16_t ble_periodic_adv_int;
+  std::vector<uint8_t> value;
+};
+
+// Scan results waiting to be delivered together. A result repeating one
+// already in the batch, same advertiser and same data, only refreshes its
+// RSSI and TX power.
+class BtifScanResultBatch {
+ public:
+  explicit BtifScanResultBatch(size_t capacity) : capacity_(capacity) {
+    results_.reserve(capacity);
+  }
+
+  // Adds |result|, whose data is |len| bytes at |data|. Returns false if it
+  // was merged into a result already in the batch.
+  bool Add(const BtifScanResult& result, const uint8_t* data, size_t len);
+
+  // Hands over the results, in the order they were received
+  std::vector<BtifScanResult> Take();
+
+  bool empty() const { return results_.empty(); }
+  bool full() const { return results_.size() >= capacity_; }
+  size_t size() const { return results_.size(); }
+
+ private:
+  size_t capacity_;
+  std::vector<BtifScanResult> results_;
+};
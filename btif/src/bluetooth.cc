@@ -47,6 +47,7 @@
 #include <hardware/bt_sock.h>
 
 #include "bt_utils.h"
+#include "bta/include/bta_gatt_api.h"
 #include "bta/include/bta_hearing_aid_api.h"
 #include "bta/include/bta_hf_client_api.h"
 #include "btif/avrcp/avrcp_service.h"
@@ -58,7 +59,9 @@
 #include "btif_debug.h"
 #include "btif_debug_btsnoop.h"
 #include "btif_debug_conn.h"
+#include "btif_gatt.h"
 #include "btif_hf.h"
+#include "btif_hh.h"
 #include "btif_keystore.h"
 #include "btif_storage.h"
 #include "btsnoop.h"
@@ -67,6 +70,7 @@
 #include "common/metric_id_allocator.h"
 #include "common/metrics.h"
 #include "device/include/interop.h"
+#include "hci/include/hci_layer.h"
 #include "main/shim/dumpsys.h"
 #include "main/shim/shim.h"
 #include "osi/include/alarm.h"
@@ -75,6 +79,8 @@
 #include "osi/include/osi.h"
 #include "osi/include/wakelock.h"
 #include "stack/gatt/connection_manager.h"
+#include "stack/include/btm_api.h"
+#include "stack/include/port_api.h"
 #include "stack_manager.h"
 
 using bluetooth::hearing_aid::HearingAidInterface;
@@ -335,19 +341,27 @@ static void dump(int fd, const char** arguments) {
   btif_debug_a2dp_dump(fd);
   btif_debug_av_dump(fd);
   bta_debug_av_dump(fd);
+  bta_debug_gattc_dump(fd);
+  btif_debug_scanner_dump(fd);
+  btif_debug_hh_dump(fd);
   stack_debug_avdtp_api_dump(fd);
+  stack_debug_sco_dump(fd);
+  stack_debug_rfcomm_dump(fd);
+  stack_debug_peer_profile_dump(fd);
   bluetooth::avrcp::AvrcpService::DebugDump(fd);
   btif_debug_config_dump(fd);
   BTA_HfClientDumpStatistics(fd);
   wakelock_debug_dump(fd);
   osi_allocator_debug_dump(fd);
   alarm_debug_dump(fd);
+  bte_trace_dump(fd);
   HearingAid::DebugDump(fd);
   connection_manager::dump(fd);
   bluetooth::bqr::DebugDump(fd);
   if (bluetooth::shim::is_gd_shim_enabled()) {
     bluetooth::shim::Dump(fd);
   } else {
+    hci_layer_dump(fd);
 #if (BTSNOOP_MEM == TRUE)
     btif_debug_btsnoop_dump(fd);
 #endif
@@ -30,28 +30,36 @@
 #include "bt_common.h"
 #include "btif_a2dp.h"
 #include "btif_a2dp_sink.h"
+#include "btif_a2dp_sink_playout.h"
 #include "btif_av.h"
 #include "btif_av_co.h"
 #include "btif_avrcp_audio_track.h"
 #include "btif_util.h"
 #include "common/message_loop_thread.h"
+#include "common/time_util.h"
 #include "osi/include/fixed_queue.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 
 using bluetooth::common::MessageLoopThread;
 using LockGuard = std::lock_guard<std::mutex>;
 
 /**
- * The receiving queue buffer size.
+ * The receiving queue buffer size. The playout engine keeps the queue at the
+ * depth the arrival jitter needs; this bounds it while nothing is played out.
  */
-#define MAX_INPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
+#define MAX_INPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 10)
 
 #define BTIF_SINK_MEDIA_TIME_TICK_MS 20
 
 /* In case of A2DP Sink, we will delay start by 5 AVDTP Packets */
 #define MAX_A2DP_DELAYED_START_FRAME_COUNT 5
 
+/* Property turning the resampling of the Sink audio to the local clock off */
+#define BTIF_A2DP_SINK_DRIFT_COMPENSATION_PROP \
+  "persist.bluetooth.a2dp_sink.drift_compensation.enabled"
+
 enum {
   BTIF_A2DP_SINK_STATE_OFF,
   BTIF_A2DP_SINK_STATE_STARTING_UP,
@@ -79,6 +87,9 @@ typedef struct {
   btif_a2dp_sink_focus_state_t focus_state;
 } tBTIF_MEDIA_SINK_FOCUS_UPDATE;
 
+static bool btif_a2dp_sink_decode_next(uint32_t* p_media_timestamp);
+static void btif_a2dp_sink_write_pcm(const uint8_t* data, size_t len);
+
 /* BTIF A2DP Sink control block */
 class BtifA2dpSinkControlBlock {
  public:
@@ -91,7 +102,9 @@ class BtifA2dpSinkControlBlock {
         channel_count(0),
         rx_focus_state(BTIF_A2DP_SINK_FOCUS_NOT_GRANTED),
         audio_track(nullptr),
-        decoder_interface(nullptr) {}
+        decoder_interface(nullptr),
+        use_playout(false),
+        playout(btif_a2dp_sink_decode_next, btif_a2dp_sink_write_pcm) {}
 
   void Reset() {
     if (audio_track != nullptr) {
@@ -108,6 +121,8 @@ class BtifA2dpSinkControlBlock {
     sample_rate = 0;
     channel_count = 0;
     decoder_interface = nullptr;
+    use_playout = false;
+    playout.Configure(0, 0, 0, false);
   }
 
   MessageLoopThread worker_thread;
@@ -120,6 +135,10 @@ class BtifA2dpSinkControlBlock {
   btif_a2dp_sink_focus_state_t rx_focus_state; /* audio focus state */
   void* audio_track;
   const tA2DP_DECODER_INTERFACE* decoder_interface;
+  // Decoders with start and suspend (LDAC) buffer and pace their output
+  // themselves; the others are played out through |playout|.
+  bool use_playout;
+  BtifA2dpSinkPlayout playout;
 };
 
 // Mutex for below data structures.
@@ -188,7 +207,8 @@ bool btif_a2dp_sink_init() {
     return false;
   }
 
-  btif_a2dp_sink_cb.rx_audio_queue = fixed_queue_new(SIZE_MAX);
+  btif_a2dp_sink_cb.rx_audio_queue =
+      fixed_queue_new_lock_free(MAX_INPUT_A2DP_FRAME_QUEUE_SZ);
 
   /* Schedule the rest of the operations */
   if (!btif_a2dp_sink_cb.worker_thread.EnableRealTimeScheduling()) {
@@ -454,6 +474,7 @@ static void btif_a2dp_sink_audio_handle_stop_decoding() {
     LockGuard lock(g_mutex);
     btif_a2dp_sink_cb.rx_flush = true;
     btif_a2dp_sink_audio_rx_flush_req();
+    btif_a2dp_sink_cb.playout.Flush();
     old_alarm = btif_a2dp_sink_cb.decode_alarm;
     btif_a2dp_sink_cb.decode_alarm = nullptr;
   }
@@ -508,13 +529,21 @@ static void btif_a2dp_sink_audio_handle_start_decoding() {
             btif_decode_alarm_cb, nullptr);
 }
 
-static void btif_a2dp_sink_on_decode_complete(uint8_t* data, uint32_t len) {
+static void btif_a2dp_sink_write_pcm(const uint8_t* data, size_t len) {
 #ifndef OS_GENERIC
   BtifAvrcpAudioTrackWriteData(btif_a2dp_sink_cb.audio_track,
-                               reinterpret_cast<void*>(data), len);
+                               const_cast<uint8_t*>(data), len);
 #endif
 }
 
+static void btif_a2dp_sink_on_decode_complete(uint8_t* data, uint32_t len) {
+  if (btif_a2dp_sink_cb.use_playout) {
+    btif_a2dp_sink_cb.playout.AddPcm(data, len);
+    return;
+  }
+  btif_a2dp_sink_write_pcm(data, len);
+}
+
 // Must be called while locked.
 static void btif_a2dp_sink_handle_inc_media(BT_HDR* p_msg) {
   if ((btif_av_get_peer_sep() == AVDT_TSEP_SNK) ||
@@ -529,11 +558,26 @@ static void btif_a2dp_sink_handle_inc_media(BT_HDR* p_msg) {
   }
 }
 
+// Decodes the oldest packet of the Sink queue.
+// Must be called while locked.
+static bool btif_a2dp_sink_decode_next(uint32_t* p_media_timestamp) {
+  BT_HDR* p_msg =
+      (BT_HDR*)fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue);
+  if (p_msg == NULL) return false;
+  APPL_TRACE_DEBUG("%s: number of packets in queue %zu", __func__,
+                   fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue));
+
+  memcpy(p_media_timestamp, p_msg->data, sizeof(*p_media_timestamp));
+  btif_a2dp_sink_handle_inc_media(p_msg);
+  osi_free(p_msg);
+  return true;
+}
+
 static void btif_a2dp_sink_avk_handle_timer() {
   LockGuard lock(g_mutex);
 
-  BT_HDR* p_msg;
-  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
+  if (!btif_a2dp_sink_cb.use_playout &&
+      fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
     APPL_TRACE_DEBUG("%s: empty queue", __func__);
     return;
   }
@@ -547,21 +591,19 @@ static void btif_a2dp_sink_avk_handle_timer() {
   /* Play only in BTIF_A2DP_SINK_FOCUS_GRANTED case */
   if (btif_a2dp_sink_cb.rx_flush) {
     fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_cb.playout.Flush();
     return;
   }
 
-  APPL_TRACE_DEBUG("%s: process frames begin", __func__);
-  while (true) {
-    p_msg = (BT_HDR*)fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue);
-    if (p_msg == NULL) {
-      break;
-    }
-    APPL_TRACE_DEBUG("%s: number of packets in queue %zu", __func__,
-                     fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue));
+  if (btif_a2dp_sink_cb.use_playout) {
+    btif_a2dp_sink_cb.playout.OnTick(
+        bluetooth::common::time_get_os_boottime_us());
+    return;
+  }
 
-    /* Queue packet has less frames */
-    btif_a2dp_sink_handle_inc_media(p_msg);
-    osi_free(p_msg);
+  APPL_TRACE_DEBUG("%s: process frames begin", __func__);
+  uint32_t media_timestamp;
+  while (btif_a2dp_sink_decode_next(&media_timestamp)) {
   }
   APPL_TRACE_DEBUG("%s: process frames end", __func__);
 }
@@ -579,6 +621,7 @@ static void btif_a2dp_sink_audio_rx_flush_event() {
   LockGuard lock(g_mutex);
   // Flush all received encoded audio buffers
   fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+  btif_a2dp_sink_cb.playout.Flush();
 }
 
 static void btif_a2dp_sink_decoder_update_event(
@@ -614,6 +657,12 @@ static void btif_a2dp_sink_decoder_update_event(
   btif_a2dp_sink_cb.bits_per_sample = bits_per_sample;
   btif_a2dp_sink_cb.channel_count = channel_count;
 
+  // Packets of the previous configuration cannot be played out any more
+  fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+  btif_a2dp_sink_cb.playout.Configure(
+      sample_rate, channel_count, bits_per_sample,
+      osi_property_get_bool(BTIF_A2DP_SINK_DRIFT_COMPENSATION_PROP, true));
+
   btif_a2dp_sink_cb.rx_flush = false;
   APPL_TRACE_DEBUG("%s: reset to Sink role", __func__);
 
@@ -623,6 +672,8 @@ static void btif_a2dp_sink_decoder_update_event(
               __func__);
     return;
   }
+  btif_a2dp_sink_cb.use_playout =
+      (btif_a2dp_sink_cb.decoder_interface->decoder_start == nullptr);
 
   if (!btif_a2dp_sink_cb.decoder_interface->decoder_init(
           btif_a2dp_sink_on_decode_complete)) {
@@ -647,25 +698,29 @@ static void btif_a2dp_sink_decoder_update_event(
   }
 }
 
-uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
+uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt, uint32_t time_stamp) {
   LockGuard lock(g_mutex);
   if (btif_a2dp_sink_cb.rx_flush) /* Flush enabled, do not enqueue */
     return fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
 
   if (fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue) ==
       MAX_INPUT_A2DP_FRAME_QUEUE_SZ) {
-    uint8_t ret = fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
     osi_free(fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue));
-    return ret;
+    btif_a2dp_sink_cb.playout.OnPacketDropped();
   }
 
   BTIF_TRACE_VERBOSE("%s +", __func__);
-  /* Allocate and queue this buffer */
-  BT_HDR* p_msg =
-      reinterpret_cast<BT_HDR*>(osi_malloc(sizeof(*p_msg) + p_pkt->len));
+  uint32_t media_timestamp = btif_a2dp_sink_cb.playout.OnPacketReceived(
+      time_stamp, bluetooth::common::time_get_os_boottime_us());
+
+  /* Allocate and queue this buffer, its media timestamp in front of the
+   * payload */
+  BT_HDR* p_msg = reinterpret_cast<BT_HDR*>(
+      osi_malloc(sizeof(*p_msg) + sizeof(media_timestamp) + p_pkt->len));
   memcpy(p_msg, p_pkt, sizeof(*p_msg));
-  p_msg->offset = 0;
-  memcpy(p_msg->data, p_pkt->data + p_pkt->offset, p_pkt->len);
+  p_msg->offset = sizeof(media_timestamp);
+  memcpy(p_msg->data, &media_timestamp, sizeof(media_timestamp));
+  memcpy(p_msg->data + p_msg->offset, p_pkt->data + p_pkt->offset, p_pkt->len);
   fixed_queue_enqueue(btif_a2dp_sink_cb.rx_audio_queue, p_msg);
   if (fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue) ==
       MAX_A2DP_DELAYED_START_FRAME_COUNT) {
@@ -689,8 +744,14 @@ void btif_a2dp_sink_audio_rx_flush_req() {
       FROM_HERE, base::BindOnce(btif_a2dp_sink_command_ready, p_buf));
 }
 
-void btif_a2dp_sink_debug_dump(UNUSED_ATTR int fd) {
-  // Nothing to do
+void btif_a2dp_sink_debug_dump(int fd) {
+  LockGuard lock(g_mutex);
+
+  dprintf(fd, "\nA2DP Sink State:\n");
+  dprintf(fd,
+          "  RxQueue length                                          : %zu\n",
+          fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue));
+  btif_a2dp_sink_cb.playout.Dump(fd);
 }
 
 void btif_a2dp_sink_set_focus_state_req(btif_a2dp_sink_focus_state_t state) {
@@ -713,6 +774,7 @@ static void btif_a2dp_sink_set_focus_state_event(
   btif_a2dp_sink_cb.rx_focus_state = state;
   if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_NOT_GRANTED) {
     fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_cb.playout.Flush();
     btif_a2dp_sink_cb.rx_flush = true;
   } else if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_GRANTED) {
     btif_a2dp_sink_cb.rx_flush = false;
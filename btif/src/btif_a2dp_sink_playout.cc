@@ -0,0 +1,501 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "bt_btif_a2dp_sink_playout"
+
+#include "btif_a2dp_sink_playout.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "osi/include/log.h"
+
+namespace {
+
+// Decode period of the Sink (BTIF_SINK_MEDIA_TIME_TICK_MS): audio arriving
+// just after a tick waits for the next one.
+constexpr uint64_t kTickUs = 20 * 1000;
+
+// Bounds of the target buffer depth
+constexpr uint64_t kMinTargetDepthUs = 40 * 1000;
+constexpr uint64_t kMaxTargetDepthUs = 300 * 1000;
+
+// Depth above the target from which the oldest audio is dropped
+constexpr uint64_t kOverflowMarginUs = 200 * 1000;
+
+// Arrivals are grouped in windows of the local clock. The latest arrivals of
+// the last few windows size the buffer, the earliest arrivals of all of them
+// estimate the clock drift: queuing only ever delays a packet, so the
+// earliest ones follow the clock of the Source.
+constexpr uint64_t kArrivalWindowUs = 1000 * 1000;
+constexpr size_t kNumArrivalWindows = 32;
+constexpr size_t kLatePeakWindows = 8;
+constexpr size_t kMinDriftWindows = 8;
+
+// Time over which a depth error is corrected, and the largest correction of
+// the playout rate: 2000 ppm is a pitch shift of 3.5 cents.
+constexpr double kCorrectionTimeUs = 20.0 * 1000 * 1000;
+constexpr double kMaxCorrectionPpm = 2000;
+
+// Smoothing of the depth sampled at every tick
+constexpr double kDepthAverageWeight = 1.0 / 32;
+
+// Most audio played at once after the decode thread was held up
+constexpr uint64_t kMaxCatchUpUs = 100 * 1000;
+
+constexpr uint64_t kUnityStepQ32 = 1ULL << 32;
+
+int32_t ReadSample(const uint8_t* p, int sample_bytes) {
+  switch (sample_bytes) {
+    case 2: {
+      int16_t sample;
+      memcpy(&sample, p, sizeof(sample));
+      return sample;
+    }
+    case 3:
+      return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 |
+                       (uint32_t)p[2] << 24) >>
+             8;
+    case 4: {
+      int32_t sample;
+      memcpy(&sample, p, sizeof(sample));
+      return sample;
+    }
+  }
+  return 0;
+}
+
+void WriteSample(uint8_t* p, int sample_bytes, int32_t sample) {
+  switch (sample_bytes) {
+    case 2: {
+      int16_t sample16 = sample;
+      memcpy(p, &sample16, sizeof(sample16));
+      break;
+    }
+    case 3:
+      p[0] = sample;
+      p[1] = sample >> 8;
+      p[2] = sample >> 16;
+      break;
+    case 4:
+      memcpy(p, &sample, sizeof(sample));
+      break;
+  }
+}
+
+bool IsEmpty(int64_t min_transit_us, int64_t max_transit_us) {
+  return min_transit_us > max_transit_us;
+}
+
+}  // namespace
+
+void BtifA2dpSinkPlayout::Configure(int sample_rate, int channel_count,
+                                    int bits_per_sample,
+                                    bool drift_compensation) {
+  sample_rate_ = sample_rate;
+  channel_count_ = channel_count;
+  sample_bytes_ = bits_per_sample / 8;
+  frame_bytes_ = std::max(channel_count_ * sample_bytes_, 1);
+  drift_compensation_ = drift_compensation;
+
+  has_rx_ = false;
+  last_rtp_timestamp_ = 0;
+  last_packet_frames_ = 0;
+  media_timestamp_ = 0;
+  first_rx_timestamp_ = 0;
+  has_decoded_ = false;
+  decoded_end_timestamp_ = 0;
+  queue_empty_ = true;
+
+  has_transit_ = false;
+  last_transit_us_ = 0;
+  jitter_us_ = 0;
+  ResetArrivalWindows();
+  drift_valid_ = false;
+  drift_ppm_ = 0;
+
+  pcm_.clear();
+  pcm_read_ = 0;
+  phase_q32_ = 0;
+
+  playing_ = false;
+  play_start_us_ = 0;
+  play_start_frames_ = 0;
+  rebuffering_ = false;
+  buffering_start_us_ = 0;
+  depth_average_us_ = 0;
+  correction_ppm_ = 0;
+
+  packets_received_ = 0;
+  discontinuities_ = 0;
+  underruns_ = 0;
+  overflows_ = 0;
+  queue_dropped_packets_ = 0;
+  overflow_dropped_frames_ = 0;
+  frames_played_ = 0;
+  rebuffering_us_ = 0;
+  max_depth_us_ = 0;
+}
+
+void BtifA2dpSinkPlayout::Flush() {
+  has_rx_ = false;
+  has_decoded_ = false;
+  queue_empty_ = true;
+  has_transit_ = false;
+  ResetArrivalWindows();
+
+  pcm_.clear();
+  pcm_read_ = 0;
+  phase_q32_ = 0;
+
+  playing_ = false;
+  rebuffering_ = false;
+  depth_average_us_ = 0;
+  correction_ppm_ = 0;
+}
+
+uint32_t BtifA2dpSinkPlayout::OnPacketReceived(uint32_t rtp_timestamp,
+                                               uint64_t arrival_us) {
+  if (sample_rate_ == 0) return rtp_timestamp;
+  packets_received_++;
+
+  if (!has_rx_) {
+    // Carry on after the audio received before the last flush
+    media_timestamp_ += last_packet_frames_;
+    first_rx_timestamp_ = media_timestamp_;
+    has_rx_ = true;
+  } else {
+    int32_t frames = (int32_t)(rtp_timestamp - last_rtp_timestamp_);
+    if (frames <= 0 || frames > sample_rate_) {
+      // The Source restarted its RTP timestamps: play the packet right after
+      // the previous one, and time the arrivals again.
+      LOG_INFO(LOG_TAG, "%s: RTP timestamp %u after %u", __func__,
+               rtp_timestamp, last_rtp_timestamp_);
+      discontinuities_++;
+      has_transit_ = false;
+      ResetArrivalWindows();
+    } else {
+      last_packet_frames_ = frames;
+    }
+    media_timestamp_ += last_packet_frames_;
+  }
+  last_rtp_timestamp_ = rtp_timestamp;
+  queue_empty_ = false;
+
+  int64_t transit_us =
+      (int64_t)arrival_us - (int64_t)FramesToUs(media_timestamp_);
+  if (has_transit_) {
+    double delta_us = std::abs((double)(transit_us - last_transit_us_));
+    jitter_us_ += (delta_us - jitter_us_) / 16;
+  }
+  has_transit_ = true;
+  last_transit_us_ = transit_us;
+
+  ArrivalWindow& window = current_window_;
+  if (!IsEmpty(window.min_transit_us, window.max_transit_us) &&
+      arrival_us - window.start_us >= kArrivalWindowUs) {
+    CloseArrivalWindow();
+  }
+  if (IsEmpty(window.min_transit_us, window.max_transit_us)) {
+    window.start_us = arrival_us;
+  }
+  window.min_transit_us = std::min(window.min_transit_us, transit_us);
+  window.max_transit_us = std::max(window.max_transit_us, transit_us);
+
+  return (uint32_t)media_timestamp_;
+}
+
+void BtifA2dpSinkPlayout::AddPcm(const uint8_t* data, size_t len) {
+  pcm_.insert(pcm_.end(), data, data + len);
+}
+
+void BtifA2dpSinkPlayout::OnTick(uint64_t now_us) {
+  if (sample_rate_ == 0) return;
+
+  uint64_t depth_us = DepthUs();
+  uint64_t target_us = TargetDepthUs();
+  max_depth_us_ = std::max(max_depth_us_, depth_us);
+
+  if (!playing_) {
+    if (depth_us < target_us) return;
+    if (rebuffering_) rebuffering_us_ += now_us - buffering_start_us_;
+    LOG_INFO(LOG_TAG, "%s: playing at a depth of %llu ms, target %llu ms",
+             __func__, (unsigned long long)depth_us / 1000,
+             (unsigned long long)target_us / 1000);
+    playing_ = true;
+    rebuffering_ = false;
+    // Start with one tick of audio
+    play_start_us_ = now_us - std::min(now_us, kTickUs);
+    play_start_frames_ = frames_played_;
+    depth_average_us_ = depth_us;
+  }
+
+  // Audio due since the playout started, at the local clock
+  uint64_t due = (now_us - play_start_us_) * sample_rate_ / 1000000;
+  uint64_t played = frames_played_ - play_start_frames_;
+  if (due <= played) return;
+  uint64_t frames = due - played;
+  uint64_t max_frames = kMaxCatchUpUs * sample_rate_ / 1000000;
+  bool held_up = frames > max_frames;
+  if (held_up) frames = max_frames;
+
+  depth_average_us_ += (depth_us - depth_average_us_) * kDepthAverageWeight;
+  if (drift_compensation_) {
+    double correction_ppm =
+        (depth_average_us_ - target_us) / kCorrectionTimeUs * 1000000;
+    if (drift_valid_) correction_ppm += drift_ppm_;
+    correction_ppm_ = std::max(-kMaxCorrectionPpm,
+                               std::min(correction_ppm, kMaxCorrectionPpm));
+  }
+
+  if (depth_us > target_us + kOverflowMarginUs) {
+    // Drop the oldest audio down to the target depth
+    size_t excess = (depth_us - target_us) * sample_rate_ / 1000000;
+    DecodeUntil(excess);
+    size_t dropped = std::min(excess, PcmFrames());
+    ConsumePcm(dropped);
+    phase_q32_ = 0;
+    overflows_++;
+    overflow_dropped_frames_ += dropped;
+    LOG_WARN(LOG_TAG, "%s: dropped %llu ms at a depth of %llu ms", __func__,
+             (unsigned long long)FramesToUs(dropped) / 1000,
+             (unsigned long long)depth_us / 1000);
+  }
+
+  // Input frames needed: every output frame but an unresampled one is
+  // interpolated between two input frames.
+  uint64_t step_q32 =
+      (uint64_t)std::llround((1 + correction_ppm_ / 1000000) * kUnityStepQ32);
+  size_t needed = frames;
+  if (step_q32 != kUnityStepQ32 || phase_q32_ != 0) {
+    needed = ((phase_q32_ + step_q32 * (frames - 1)) >> 32) + 2;
+  }
+  bool underrun = !DecodeUntil(needed);
+  frames_played_ += Resample(frames, step_q32);
+
+  if (held_up) {
+    play_start_us_ = now_us;
+    play_start_frames_ = frames_played_;
+  }
+  if (underrun) {
+    underruns_++;
+    LOG_WARN(LOG_TAG, "%s: underrun, buffering to %llu ms", __func__,
+             (unsigned long long)TargetDepthUs() / 1000);
+    StartBuffering(now_us);
+  }
+}
+
+uint64_t BtifA2dpSinkPlayout::FramesToUs(uint64_t frames) const {
+  if (sample_rate_ == 0) return 0;
+  return frames * 1000000 / sample_rate_;
+}
+
+uint64_t BtifA2dpSinkPlayout::DepthFrames() const {
+  uint64_t frames = PcmFrames();
+  if (has_rx_ && !queue_empty_) {
+    uint64_t rx_end = media_timestamp_ + last_packet_frames_;
+    uint64_t next = has_decoded_ ? decoded_end_timestamp_ : first_rx_timestamp_;
+    if (rx_end > next) frames += rx_end - next;
+  }
+  return frames;
+}
+
+uint64_t BtifA2dpSinkPlayout::DepthUs() const {
+  return FramesToUs(DepthFrames());
+}
+
+uint64_t BtifA2dpSinkPlayout::LatePeakUs() const {
+  int64_t late_peak_us = 0;
+  if (!IsEmpty(current_window_.min_transit_us,
+               current_window_.max_transit_us)) {
+    late_peak_us =
+        current_window_.max_transit_us - current_window_.min_transit_us;
+  }
+  size_t count = windows_.size();
+  for (size_t i = 0; i < std::min(count, kLatePeakWindows); i++) {
+    const ArrivalWindow& window =
+        windows_[(windows_next_ + kNumArrivalWindows - 1 - i) %
+                 kNumArrivalWindows];
+    late_peak_us =
+        std::max(late_peak_us, window.max_transit_us - window.min_transit_us);
+  }
+  return late_peak_us;
+}
+
+uint64_t BtifA2dpSinkPlayout::TargetDepthUs() const {
+  uint64_t target_us = LatePeakUs() * 5 / 4 + kTickUs;
+  return std::max(kMinTargetDepthUs, std::min(target_us, kMaxTargetDepthUs));
+}
+
+void BtifA2dpSinkPlayout::ResetArrivalWindows() {
+  current_window_.start_us = 0;
+  current_window_.min_transit_us = std::numeric_limits<int64_t>::max();
+  current_window_.max_transit_us = std::numeric_limits<int64_t>::min();
+  windows_.clear();
+  windows_.reserve(kNumArrivalWindows);
+  windows_next_ = 0;
+}
+
+void BtifA2dpSinkPlayout::CloseArrivalWindow() {
+  if (windows_.size() < kNumArrivalWindows) {
+    windows_.push_back(current_window_);
+  } else {
+    windows_[windows_next_] = current_window_;
+  }
+  windows_next_ = (windows_next_ + 1) % kNumArrivalWindows;
+  current_window_.min_transit_us = std::numeric_limits<int64_t>::max();
+  current_window_.max_transit_us = std::numeric_limits<int64_t>::min();
+  EstimateDrift();
+}
+
+void BtifA2dpSinkPlayout::EstimateDrift() {
+  size_t count = windows_.size();
+  if (count < kMinDriftWindows) return;
+
+  // Least squares slope of the earliest transit time over the local time.
+  // The transit time of a Source running fast shrinks.
+  uint64_t origin_us = windows_[count < kNumArrivalWindows ? 0 : windows_next_]
+                           .start_us;
+  double mean_x = 0, mean_y = 0;
+  for (const ArrivalWindow& window : windows_) {
+    mean_x += (double)(window.start_us - origin_us);
+    mean_y += (double)window.min_transit_us;
+  }
+  mean_x /= count;
+  mean_y /= count;
+  double covariance = 0, variance = 0;
+  for (const ArrivalWindow& window : windows_) {
+    double dx = (double)(window.start_us - origin_us) - mean_x;
+    covariance += dx * ((double)window.min_transit_us - mean_y);
+    variance += dx * dx;
+  }
+  if (variance == 0) return;
+  drift_ppm_ = -covariance / variance * 1000000;
+  drift_valid_ = true;
+}
+
+bool BtifA2dpSinkPlayout::DecodeUntil(size_t frames) {
+  while (PcmFrames() < frames) {
+    size_t frames_before = PcmFrames();
+    uint32_t timestamp;
+    if (!decode_next_(&timestamp)) {
+      queue_empty_ = true;
+      return false;
+    }
+    // Back to the full media timestamp, from its lower 32 bits
+    uint64_t packet_timestamp =
+        media_timestamp_ - (uint32_t)((uint32_t)media_timestamp_ - timestamp);
+    has_decoded_ = true;
+    decoded_end_timestamp_ = packet_timestamp + (PcmFrames() - frames_before);
+  }
+  return true;
+}
+
+void BtifA2dpSinkPlayout::ConsumePcm(size_t frames) {
+  pcm_read_ += frames * frame_bytes_;
+  if (pcm_read_ >= pcm_.size()) {
+    pcm_.clear();
+    pcm_read_ = 0;
+  } else if (pcm_read_ > pcm_.size() / 2) {
+    pcm_.erase(pcm_.begin(), pcm_.begin() + pcm_read_);
+    pcm_read_ = 0;
+  }
+}
+
+size_t BtifA2dpSinkPlayout::Resample(size_t frames, uint64_t step_q32) {
+  size_t available = PcmFrames();
+  if (step_q32 == kUnityStepQ32 && phase_q32_ == 0) {
+    size_t count = std::min(frames, available);
+    if (count > 0) write_pcm_(pcm_.data() + pcm_read_, count * frame_bytes_);
+    ConsumePcm(count);
+    return count;
+  }
+
+  // Linear interpolation, the phase being the position in the input frames
+  // as a Q32 fixed point number
+  output_.resize(frames * frame_bytes_);
+  const uint8_t* input = pcm_.data() + pcm_read_;
+  uint8_t* output = output_.data();
+  size_t count = 0;
+  for (; count < frames; count++) {
+    size_t index = phase_q32_ >> 32;
+    if (index + 1 >= available) break;
+    int64_t fraction = (phase_q32_ >> 16) & 0xffff;
+    const uint8_t* frame0 = input + index * frame_bytes_;
+    const uint8_t* frame1 = frame0 + frame_bytes_;
+    for (int channel = 0; channel < channel_count_; channel++) {
+      int64_t sample0 =
+          ReadSample(frame0 + channel * sample_bytes_, sample_bytes_);
+      int64_t sample1 =
+          ReadSample(frame1 + channel * sample_bytes_, sample_bytes_);
+      WriteSample(output, sample_bytes_,
+                  sample0 + (((sample1 - sample0) * fraction) >> 16));
+      output += sample_bytes_;
+    }
+    phase_q32_ += step_q32;
+  }
+  if (count > 0) write_pcm_(output_.data(), count * frame_bytes_);
+  ConsumePcm(phase_q32_ >> 32);
+  phase_q32_ &= kUnityStepQ32 - 1;
+  return count;
+}
+
+void BtifA2dpSinkPlayout::StartBuffering(uint64_t now_us) {
+  playing_ = false;
+  rebuffering_ = true;
+  buffering_start_us_ = now_us;
+  phase_q32_ = 0;
+}
+
+void BtifA2dpSinkPlayout::Dump(int fd) const {
+  dprintf(fd,
+          "  Playout (playing/sample rate/drift compensation)        : %s / "
+          "%d / %s\n",
+          playing_ ? "true" : "false", sample_rate_,
+          drift_compensation_ ? "true" : "false");
+  dprintf(fd,
+          "  Buffer depth in ms (current/target/max)                 : %llu / "
+          "%llu / %llu\n",
+          (unsigned long long)DepthUs() / 1000,
+          (unsigned long long)TargetDepthUs() / 1000,
+          (unsigned long long)max_depth_us_ / 1000);
+  dprintf(fd,
+          "  Arrival jitter in ms (interarrival/late peak)           : %.1f / "
+          "%.1f\n",
+          jitter_us_ / 1000, LatePeakUs() / 1000.0);
+  dprintf(fd,
+          "  Clock drift in ppm (estimated/correction)               : %.1f / "
+          "%.1f\n",
+          drift_ppm_, correction_ppm_);
+  dprintf(fd,
+          "  Counts (packets/discontinuities/queue dropped)          : %zu / "
+          "%zu / %zu\n",
+          packets_received_, discontinuities_, queue_dropped_packets_);
+  dprintf(fd,
+          "  Counts (underruns/overflows)                            : %zu / "
+          "%zu\n",
+          underruns_, overflows_);
+  dprintf(fd,
+          "  Audio in ms (played/overflow dropped/rebuffering)       : %llu / "
+          "%llu / %llu\n",
+          (unsigned long long)FramesToUs(frames_played_) / 1000,
+          (unsigned long long)FramesToUs(overflow_dropped_frames_) / 1000,
+          (unsigned long long)rebuffering_us_ / 1000);
+}
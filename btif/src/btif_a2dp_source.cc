@@ -32,6 +32,7 @@
 #include "audio_a2dp_hw/include/audio_a2dp_hw.h"
 #include "audio_hal_interface/a2dp_encoding.h"
 #include "bt_common.h"
+#include "bta_av_api.h"
 #include "bta_av_ci.h"
 #include "btif_a2dp.h"
 #include "btif_a2dp_audio_interface.h"
@@ -40,6 +41,7 @@
 #include "btif_av.h"
 #include "btif_av_co.h"
 #include "btif_util.h"
+#include "common/a2dp_latency_tracer.h"
 #include "common/message_loop_thread.h"
 #include "common/metrics.h"
 #include "common/repeating_timer.h"
@@ -47,9 +49,11 @@
 #include "osi/include/fixed_queue.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 #include "osi/include/wakelock.h"
 #include "uipc.h"
 
+using bluetooth::common::A2dpLatencyTracer;
 using bluetooth::common::A2dpSessionMetrics;
 using bluetooth::common::BluetoothMetricsLogger;
 using bluetooth::common::RepeatingTimer;
@@ -63,6 +67,20 @@ extern std::unique_ptr<tUIPC_STATE> a2dp_uipc;
  */
 #define MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
 
+/**
+ * Capacity of the lock-free tx queue. The overflow check of
+ * btif_a2dp_source_enqueue_callback() keeps it within
+ * MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ, plus a buffer enqueued without frames.
+ */
+#define A2DP_SOURCE_TX_QUEUE_CAPACITY (MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ + 1)
+
+/**
+ * Property keeping the timestamps of the last media packets, dumped as trace
+ * events in dumpsys.
+ */
+#define A2DP_LATENCY_TRACE_EVENTS_PROP \
+  "persist.bluetooth.a2dp_latency_trace.enabled"
+
 class SchedulingStats {
  public:
   SchedulingStats() { Reset(); }
@@ -180,6 +198,9 @@ class BtifA2dpSource {
         tx_flush(false),
         encoder_interface(nullptr),
         encoder_interval_ms(0),
+        copy_stats_dump_us(0),
+        bytes_dup_at_dump(0),
+        bytes_fragment_at_dump(0),
         state_(kStateOff) {}
 
   void Reset() {
@@ -218,6 +239,10 @@ class BtifA2dpSource {
   uint64_t encoder_interval_ms; /* Local copy of the encoder interval */
   BtifMediaStats stats;
   BtifMediaStats accumulated_stats;
+  /* BTA AV media copy counters at the previous debug dump */
+  uint64_t copy_stats_dump_us;
+  uint64_t bytes_dup_at_dump;
+  uint64_t bytes_fragment_at_dump;
 
  private:
   BtifA2dpSource::RunState state_;
@@ -342,7 +367,8 @@ bool btif_a2dp_source_startup(void) {
 
   btif_a2dp_source_cb.Reset();
   btif_a2dp_source_cb.SetState(BtifA2dpSource::kStateStartingUp);
-  btif_a2dp_source_cb.tx_audio_queue = fixed_queue_new(SIZE_MAX);
+  btif_a2dp_source_cb.tx_audio_queue =
+      fixed_queue_new_lock_free(A2DP_SOURCE_TX_QUEUE_CAPACITY);
 
   // Schedule the rest of the operations
   btif_a2dp_source_thread.DoInThread(
@@ -366,6 +392,8 @@ static void btif_a2dp_source_startup_delayed() {
       btif_a2dp_control_init();
     }
   }
+  A2dpLatencyTracer::GetInstance().SetTraceEventsEnabled(
+      osi_property_get_bool(A2DP_LATENCY_TRACE_EVENTS_PROP, false));
   btif_a2dp_source_cb.SetState(BtifA2dpSource::kStateRunning);
 }
 
@@ -881,6 +909,16 @@ static void btif_a2dp_source_audio_tx_stop_event(void) {
   /* Reset the media feeding state */
   if (btif_a2dp_source_cb.encoder_interface != nullptr)
     btif_a2dp_source_cb.encoder_interface->feeding_reset();
+
+  /* Remember the bitrate the stream settled on for the next one to the peer */
+  const tA2DP_ENCODER_INTERFACE* encoder_interface =
+      btif_a2dp_source_cb.encoder_interface;
+  if (encoder_interface != nullptr &&
+      encoder_interface->get_settled_link_quality_level != nullptr) {
+    BTM_SetPeerA2dpAbrLevel(
+        btif_av_source_active_peer(),
+        encoder_interface->get_settled_link_quality_level());
+  }
 }
 
 static void btif_a2dp_source_audio_handle_timer(void) {
@@ -905,6 +943,14 @@ static void btif_a2dp_source_audio_handle_timer(void) {
     btif_a2dp_source_cb.encoder_interface->set_transmit_queue_length(
         transmit_queue_length);
   }
+  if (btif_a2dp_source_cb.encoder_interface->set_link_quality != nullptr) {
+    tA2DP_LINK_QUALITY link_quality;
+    link_quality.tx_queue_length = transmit_queue_length;
+    link_quality.l2cap_stall_count = BTA_AvGetMediaL2capStallCount();
+    link_quality.flush_count =
+        BTM_GetAclFlushCount(btif_av_source_active_peer());
+    btif_a2dp_source_cb.encoder_interface->set_link_quality(&link_quality);
+  }
   btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
   bta_av_ci_src_data_ready(BTA_AV_CHNL_AUDIO);
   update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_enqueue_stats,
@@ -922,6 +968,8 @@ static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
     bytes_read = UIPC_Read(*a2dp_uipc, UIPC_CH_ID_AV_AUDIO, &event, p_buf, len);
   }
 
+  if (bytes_read > 0) A2dpLatencyTracer::GetInstance().OnPcmRead();
+
   if (bytes_read < len) {
     LOG_WARN(LOG_TAG, "%s: UNDERFLOW: ONLY READ %d BYTES OUT OF %d", __func__,
              bytes_read, len);
@@ -941,6 +989,7 @@ static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
 static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n,
                                               uint32_t bytes_read) {
   uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
+  A2dpLatencyTracer::GetInstance().OnPacketEncoded(p_buf);
   btif_a2dp_control_log_bytes_read(bytes_read);
 
   /* Check if timer was stopped (media task stopped) */
@@ -1070,6 +1119,7 @@ BT_HDR* btif_a2dp_source_audio_readbuf(void) {
   btif_a2dp_source_cb.stats.tx_queue_total_readbuf_calls++;
   btif_a2dp_source_cb.stats.tx_queue_last_readbuf_us = now_us;
   if (p_buf != nullptr) {
+    A2dpLatencyTracer::GetInstance().OnPacketDequeued(p_buf);
     // Update the statistics
     update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_dequeue_stats,
                             now_us,
@@ -1290,6 +1340,40 @@ void btif_a2dp_source_debug_dump(int fd) {
       (unsigned long long)dequeue_stats->max_premature_scheduling_delta_us /
           1000,
       (unsigned long long)ave_time_us / 1000);
+
+  //
+  // Media copies on the audio data path
+  //
+  uint64_t bytes_dup, bytes_fragment;
+  BTA_AvGetMediaCopyStats(&bytes_dup, &bytes_fragment);
+  dprintf(fd,
+          "  Media bytes copied (dup/fragment)                       : %llu / "
+          "%llu\n",
+          (unsigned long long)bytes_dup, (unsigned long long)bytes_fragment);
+
+  uint64_t dup_per_second = 0;
+  uint64_t fragment_per_second = 0;
+  if (btif_a2dp_source_cb.copy_stats_dump_us != 0 &&
+      now_us > btif_a2dp_source_cb.copy_stats_dump_us &&
+      bytes_dup >= btif_a2dp_source_cb.bytes_dup_at_dump &&
+      bytes_fragment >= btif_a2dp_source_cb.bytes_fragment_at_dump) {
+    uint64_t elapsed_us = now_us - btif_a2dp_source_cb.copy_stats_dump_us;
+    dup_per_second = (bytes_dup - btif_a2dp_source_cb.bytes_dup_at_dump) *
+                     1000000 / elapsed_us;
+    fragment_per_second =
+        (bytes_fragment - btif_a2dp_source_cb.bytes_fragment_at_dump) *
+        1000000 / elapsed_us;
+  }
+  dprintf(fd,
+          "  Media bytes copied per second since last dump (dup/frag): %llu / "
+          "%llu\n",
+          (unsigned long long)dup_per_second,
+          (unsigned long long)fragment_per_second);
+  btif_a2dp_source_cb.copy_stats_dump_us = now_us;
+  btif_a2dp_source_cb.bytes_dup_at_dump = bytes_dup;
+  btif_a2dp_source_cb.bytes_fragment_at_dump = bytes_fragment;
+
+  A2dpLatencyTracer::GetInstance().Dump(fd);
 }
 
 static void btif_a2dp_source_update_metrics(void) {
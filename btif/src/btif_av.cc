@@ -2705,7 +2705,8 @@ static void bta_av_sink_media_callback(const RawAddress& peer_address,
         int state = peer->StateMachine().StateId();
         if ((state == BtifAvStateMachine::kStateStarted) ||
             (state == BtifAvStateMachine::kStateOpened)) {
-          uint8_t queue_len = btif_a2dp_sink_enqueue_buf((BT_HDR*)p_data);
+          uint8_t queue_len = btif_a2dp_sink_enqueue_buf(
+              p_data->avk_data.p_pkt, p_data->avk_data.time_stamp);
           BTIF_TRACE_DEBUG("%s: Packets in Sink queue %d", __func__, queue_len);
         }
       }
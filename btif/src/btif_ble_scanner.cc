@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <set>
 #include <unordered_set>
 #include "device/include/controller.h"
 
@@ -40,7 +41,9 @@
 #include "btif_dm.h"
 #include "btif_gatt.h"
 #include "btif_gatt_util.h"
+#include "btif_scan_batch.h"
 #include "btif_storage.h"
+#include "osi/include/alarm.h"
 #include "osi/include/log.h"
 #include "stack/include/btu.h"
 #include "vendor_api.h"
@@ -157,12 +160,96 @@ void bta_scan_results_cb_impl(RawAddress bd_addr, tBT_DEVICE_TYPE device_type,
             ble_tx_power, rssi, ble_periodic_adv_int, std::move(value));
 }
 
+void bta_scan_results_batch_cb_impl(std::vector<BtifScanResult> results) {
+  for (BtifScanResult& r : results) {
+    bta_scan_results_cb_impl(r.bd_addr, r.device_type, r.rssi, r.addr_type,
+                             r.ble_evt_type, r.ble_primary_phy,
+                             r.ble_secondary_phy, r.ble_advertising_sid,
+                             r.ble_tx_power, r.ble_periodic_adv_int,
+                             std::move(r.value));
+  }
+}
+
+// Scan result batching, all on the main thread. Scanners get the results of
+// a batch in a single JNI thread task, unless one of them asked for every
+// result on its own.
+struct ScanBatchStats {
+  uint64_t results;    // results received from the stack
+  uint64_t immediate;  // results delivered on their own
+  uint64_t batched;    // results delivered in a batch
+  uint64_t merged;     // results merged into one already in the batch
+  uint64_t batches;    // batches delivered
+};
+
+BtifScanResultBatch scan_batch(BTIF_SCAN_BATCH_MAX_RESULTS);
+alarm_t* scan_batch_timer = nullptr;
+std::set<int> scan_batch_opted_out;
+ScanBatchStats scan_batch_stats;
+
+bool scan_batch_enabled() {
+  return BTIF_SCAN_BATCH_WINDOW_MS > 0 && scan_batch_opted_out.empty();
+}
+
+void scan_batch_flush() {
+  if (scan_batch_timer) alarm_cancel(scan_batch_timer);
+  if (scan_batch.empty()) return;
+
+  scan_batch_stats.batched += scan_batch.size();
+  scan_batch_stats.batches++;
+  do_in_jni_thread(
+      Bind(bta_scan_results_batch_cb_impl, base::Passed(scan_batch.Take())));
+}
+
+void scan_batch_timeout(void* data) { scan_batch_flush(); }
+
+void scan_batch_set_opt_out(int scanner_id, bool opt_out) {
+  if (opt_out) {
+    scan_batch_opted_out.insert(scanner_id);
+    // Results received so far go first
+    scan_batch_flush();
+  } else {
+    scan_batch_opted_out.erase(scanner_id);
+  }
+}
+
+void scan_batch_add(const tBTA_DM_INQ_RES* r) {
+  BtifScanResult result = {
+      .bd_addr = r->bd_addr,
+      .device_type = r->device_type,
+      .rssi = r->rssi,
+      .addr_type = r->ble_addr_type,
+      .ble_evt_type = r->ble_evt_type,
+      .ble_primary_phy = r->ble_primary_phy,
+      .ble_secondary_phy = r->ble_secondary_phy,
+      .ble_advertising_sid = r->ble_advertising_sid,
+      .ble_tx_power = r->ble_tx_power,
+      .ble_periodic_adv_int = r->ble_periodic_adv_int,
+  };
+  if (!scan_batch.Add(result, r->p_eir, r->p_eir ? r->eir_len : 0)) {
+    scan_batch_stats.merged++;
+    return;
+  }
+
+  if (scan_batch.full()) {
+    scan_batch_flush();
+    return;
+  }
+
+  if (scan_batch.size() == 1) {
+    if (scan_batch_timer == nullptr)
+      scan_batch_timer = alarm_new("btif_scan.batch_timer");
+    alarm_set_on_mloop(scan_batch_timer, BTIF_SCAN_BATCH_WINDOW_MS,
+                       scan_batch_timeout, nullptr);
+  }
+}
+
 void bta_scan_results_cb(tBTA_DM_SEARCH_EVT event, tBTA_DM_SEARCH* p_data) {
   uint8_t len;
 
   if (event == BTA_DM_INQ_CMPL_EVT) {
     BTIF_TRACE_DEBUG("%s  BLE observe complete. Num Resp %d", __func__,
                      p_data->inq_cmpl.num_resps);
+    scan_batch_flush();
     return;
   }
 
@@ -171,18 +258,23 @@ void bta_scan_results_cb(tBTA_DM_SEARCH_EVT event, tBTA_DM_SEARCH* p_data) {
     return;
   }
 
-  vector<uint8_t> value;
-  if (p_data->inq_res.p_eir) {
-    value.insert(value.begin(), p_data->inq_res.p_eir,
-                 p_data->inq_res.p_eir + p_data->inq_res.eir_len);
+  tBTA_DM_INQ_RES* r = &p_data->inq_res;
+  if (r->p_eir && AdvertiseDataParser::GetFieldByType(
+                      r->p_eir, r->eir_len, BTM_EIR_COMPLETE_LOCAL_NAME_TYPE,
+                      &len)) {
+    r->remt_name_not_required = true;
+  }
 
-    if (AdvertiseDataParser::GetFieldByType(
-            value, BTM_EIR_COMPLETE_LOCAL_NAME_TYPE, &len)) {
-      p_data->inq_res.remt_name_not_required = true;
-    }
+  scan_batch_stats.results++;
+  if (scan_batch_enabled()) {
+    scan_batch_add(r);
+    return;
   }
 
-  tBTA_DM_INQ_RES* r = &p_data->inq_res;
+  vector<uint8_t> value;
+  if (r->p_eir) value.assign(r->p_eir, r->p_eir + r->eir_len);
+
+  scan_batch_stats.immediate++;
   do_in_jni_thread(Bind(bta_scan_results_cb_impl, r->bd_addr, r->device_type,
                         r->rssi, r->ble_addr_type, r->ble_evt_type,
                         r->ble_primary_phy, r->ble_secondary_phy,
@@ -217,6 +309,8 @@ class BleScannerInterfaceImpl : public BleScannerInterface {
   }
 
   void Unregister(int scanner_id) override {
+    do_in_main_thread(FROM_HERE,
+                      Bind(&scan_batch_set_opt_out, scanner_id, false));
     do_in_main_thread(FROM_HERE, Bind(&BTA_GATTC_AppDeregister, scanner_id));
   }
 
@@ -224,6 +318,7 @@ class BleScannerInterfaceImpl : public BleScannerInterface {
     do_in_jni_thread(Bind(
         [](bool start) {
           if (!start) {
+            do_in_main_thread(FROM_HERE, Bind(&scan_batch_flush));
             do_in_main_thread(FROM_HERE,
                               Bind(&BTA_DmBleObserve, false, 0, nullptr));
             return;
@@ -339,12 +434,34 @@ class BleScannerInterfaceImpl : public BleScannerInterface {
                          uint8_t adv_handle, SyncTransferCb cb) override {}
   void SyncTxParameters(RawAddress address, uint8_t mode, uint16_t skip,
                          uint16_t timeout, StartSyncCb cb) override {}
+
+  void SetScanResultBatching(int scanner_id, bool batch) override {
+    do_in_main_thread(FROM_HERE,
+                      Bind(&scan_batch_set_opt_out, scanner_id, !batch));
+  }
 };
 
 BleScannerInterface* btLeScannerInstance = nullptr;
 
 }  // namespace
 
+void btif_debug_scanner_dump(int fd) {
+  const ScanBatchStats& stats = scan_batch_stats;
+  dprintf(fd, "\nLE Scan Results:\n");
+  dprintf(fd, "  Batch window: %d ms, max results: %d, scanners opted out: %zu\n",
+          BTIF_SCAN_BATCH_WINDOW_MS, BTIF_SCAN_BATCH_MAX_RESULTS,
+          scan_batch_opted_out.size());
+  dprintf(fd, "  Results: %llu, delivered on their own: %llu\n",
+          (unsigned long long)stats.results,
+          (unsigned long long)stats.immediate);
+  dprintf(fd,
+          "  Delivered in batches: %llu in %llu batches (%.1f per batch), "
+          "merged duplicates: %llu\n",
+          (unsigned long long)stats.batched, (unsigned long long)stats.batches,
+          stats.batches ? (double)stats.batched / stats.batches : 0.0,
+          (unsigned long long)stats.merged);
+}
+
 BleScannerInterface* get_ble_scanner_instance() {
   if (btLeScannerInstance == nullptr)
     btLeScannerInstance = new BleScannerInterfaceImpl();
@@ -0,0 +1,154 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "btif_bond_store.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <iterator>
+#include <limits>
+
+namespace {
+
+const char* const kKeyNames[BTIF_BOND_KEY_COUNT] = {
+    "LinkKey",      "LE_KEY_PENC", "LE_KEY_PID",  "LE_KEY_LID",
+    "LE_KEY_PCSRK", "LE_KEY_LENC", "LE_KEY_LCSRK"};
+
+// Same rules as BtifConfigCache::GetInt()
+std::optional<int> decode_int(const std::string* value) {
+  if (value == nullptr) return std::nullopt;
+  char* endptr;
+  long ret_long = strtol(value->c_str(), &endptr, 0);
+  if (*endptr != '\0') return std::nullopt;
+  if (ret_long >= std::numeric_limits<int>::max()) return std::nullopt;
+  return static_cast<int>(ret_long);
+}
+
+int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return c - 'A' + 10;
+}
+
+// Same rules as btif_config_get_bin() for values not kept in the keystore
+void decode_key(const std::string* value, BtifBondKey* key) {
+  key->value.clear();
+  if (value == nullptr) {
+    key->state = BtifBondKey::ABSENT;
+    return;
+  }
+
+  key->state = BtifBondKey::OPAQUE;
+  size_t value_len = value->length();
+  if ((value_len % 2) != 0) return;
+  for (char c : *value) {
+    if (!isxdigit(static_cast<unsigned char>(c))) return;
+  }
+
+  key->value.resize(value_len / 2);
+  for (size_t i = 0; i < key->value.size(); i++) {
+    key->value[i] = (hex_digit((*value)[2 * i]) << 4) |
+                    hex_digit((*value)[2 * i + 1]);
+  }
+  key->state = BtifBondKey::DECODED;
+}
+
+}  // namespace
+
+const char* BtifBondStore::KeyName(BtifBondKeyId id) { return kKeyNames[id]; }
+
+int BtifBondStore::KeyId(const std::string& key) {
+  for (int id = 0; id < BTIF_BOND_KEY_COUNT; id++) {
+    if (key == kKeyNames[id]) return id;
+  }
+  return -1;
+}
+
+std::optional<int> BtifBondRecord::*BtifBondStore::IntField(
+    const std::string& key) {
+  if (key == "LinkKeyType") return &BtifBondRecord::link_key_type;
+  if (key == "PinLength") return &BtifBondRecord::pin_length;
+  if (key == "DevClass") return &BtifBondRecord::dev_class;
+  if (key == "DevType") return &BtifBondRecord::dev_type;
+  if (key == "AddrType") return &BtifBondRecord::addr_type;
+  return nullptr;
+}
+
+void BtifBondStore::SetValue(BtifBondRecord* record, const std::string& key,
+                             const std::string* value) {
+  int id = KeyId(key);
+  if (id >= 0) {
+    decode_key(value, &record->keys[id]);
+    return;
+  }
+
+  auto field = IntField(key);
+  if (field != nullptr) record->*field = decode_int(value);
+}
+
+void BtifBondStore::Clear() {
+  index_.clear();
+  records_.clear();
+}
+
+void BtifBondStore::Load(const std::list<section_t>& sections) {
+  Clear();
+  for (const section_t& section : sections) AddSection(section);
+}
+
+void BtifBondStore::AddSection(const section_t& section) {
+  RawAddress bd_addr;
+  if (!RawAddress::FromString(section.name, bd_addr)) return;
+  if (index_.count(section.name) != 0) RemoveSection(section.name);
+
+  BtifBondRecord record;
+  record.section_name = section.name;
+  record.bd_addr = bd_addr;
+  for (const entry_t& entry : section.entries) {
+    SetValue(&record, entry.key, &entry.value);
+  }
+  records_.push_back(std::move(record));
+  index_[section.name] = std::prev(records_.end());
+}
+
+void BtifBondStore::RemoveSection(const std::string& section_name) {
+  auto it = index_.find(section_name);
+  if (it == index_.end()) return;
+  records_.erase(it->second);
+  index_.erase(it);
+}
+
+void BtifBondStore::Set(const std::string& section_name, const std::string& key,
+                        const std::string& value) {
+  auto it = index_.find(section_name);
+  if (it == index_.end()) return;
+  SetValue(&*it->second, key, &value);
+}
+
+void BtifBondStore::Remove(const std::string& section_name,
+                           const std::string& key) {
+  auto it = index_.find(section_name);
+  if (it == index_.end()) return;
+  SetValue(&*it->second, key, nullptr);
+}
+
+const BtifBondRecord* BtifBondStore::Find(
+    const std::string& section_name) const {
+  auto it = index_.find(section_name);
+  if (it == index_.end()) return nullptr;
+  return &*it->second;
+}
@@ -408,6 +408,8 @@ void AddLinkQualityEventToQueue(uint8_t length, uint8_t* p_link_quality_event) {
     LOG(WARNING) << __func__ << ": failed to log BQR event to statsd, error "
                  << ret;
   }
+  btm_peer_profile_rssi(p_bqr_event->bqr_link_quality_event_.connection_handle,
+                        p_bqr_event->bqr_link_quality_event_.rssi);
   kpBqrEventQueue->Enqueue(p_bqr_event.release());
 }
 
@@ -29,6 +29,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <functional>
 #include <mutex>
 #include <sstream>
@@ -416,6 +417,17 @@ bool btif_config_get_int(const std::string& section, const std::string& key,
                          int* value) {
   CHECK(value != NULL);
   std::unique_lock<std::recursive_mutex> lock(config_lock);
+  auto field = BtifBondStore::IntField(key);
+  if (field != nullptr) {
+    const BtifBondRecord* record =
+        btif_config_cache.GetBondStore().Find(section);
+    if (record != nullptr) {
+      if (!(record->*field)) return false;
+      *value = *(record->*field);
+      return true;
+    }
+  }
+
   auto ret = btif_config_cache.GetInt(section, key);
   if (!ret) {
     return false;
@@ -484,6 +496,26 @@ bool btif_config_get_bin(const std::string& section, const std::string& key,
   CHECK(length != NULL);
 
   std::unique_lock<std::recursive_mutex> lock(config_lock);
+
+  // Keys of paired devices are decoded when written, unless they are kept in
+  // the keystore
+  int key_id = BtifBondStore::KeyId(key);
+  if (key_id >= 0 && !btif_is_niap_mode()) {
+    const BtifBondRecord* record =
+        btif_config_cache.GetBondStore().Find(section);
+    const BtifBondKey* bond_key =
+        (record != nullptr) ? &record->keys[key_id] : nullptr;
+    if (bond_key != nullptr && bond_key->state == BtifBondKey::ABSENT) {
+      return false;
+    }
+    if (bond_key != nullptr && bond_key->state == BtifBondKey::DECODED) {
+      if (*length < bond_key->value.size()) return false;
+      std::copy(bond_key->value.begin(), bond_key->value.end(), value);
+      *length = bond_key->value.size();
+      return true;
+    }
+  }
+
   const std::string* value_str;
   auto value_str_from_config = btif_config_cache.GetString(section, key);
 
@@ -588,6 +620,43 @@ const std::list<section_t>& btif_config_sections() {
   return btif_config_cache.GetPersistentSections();
 }
 
+/* In NIAP mode, reading a key through btif_config_get_bin() moves it to the
+ * keystore; leave the keys of that list to it. */
+static void btif_config_copy_bond_record(const BtifBondRecord& src,
+                                         BtifBondRecord* dst) {
+  *dst = src;
+  if (!btif_is_niap_mode()) return;
+  for (BtifBondKey& key : dst->keys) {
+    if (key.state == BtifBondKey::DECODED) {
+      key.state = BtifBondKey::OPAQUE;
+      key.value.clear();
+    }
+  }
+}
+
+bool btif_config_get_bond_record(const std::string& section,
+                                 BtifBondRecord* record) {
+  CHECK(record != NULL);
+
+  std::unique_lock<std::recursive_mutex> lock(config_lock);
+  const BtifBondRecord* stored =
+      btif_config_cache.GetBondStore().Find(section);
+  if (stored == nullptr) return false;
+  btif_config_copy_bond_record(*stored, record);
+  return true;
+}
+
+std::vector<BtifBondRecord> btif_config_get_bond_records() {
+  std::unique_lock<std::recursive_mutex> lock(config_lock);
+  const auto& stored = btif_config_cache.GetBondStore().Records();
+  std::vector<BtifBondRecord> records(stored.size());
+  size_t i = 0;
+  for (const BtifBondRecord& record : stored) {
+    btif_config_copy_bond_record(record, &records[i++]);
+  }
+  return records;
+}
+
 bool btif_config_remove(const std::string& section, const std::string& key) {
   if (is_niap_mode() && btif_in_encrypt_key_name_list(key)) {
     get_bluetooth_keystore_interface()->set_encrypt_key_or_remove_key(
@@ -66,12 +66,14 @@ BtifConfigCache::~BtifConfigCache() { Clear(); }
 void BtifConfigCache::Clear() {
   unpaired_devices_cache_.Clear();
   paired_devices_list_.sections.clear();
+  bond_store_.Clear();
 }
 
 void BtifConfigCache::Init(std::unique_ptr<config_t> source) {
   // get the config persistent data from btif_config file
   paired_devices_list_ = std::move(*source);
   source.reset();
+  bond_store_.Load(paired_devices_list_.sections);
 }
 
 bool BtifConfigCache::HasPersistentSection(const std::string& section_name) {
@@ -105,6 +107,7 @@ void BtifConfigCache::RemovePersistentSectionsWithKey(const std::string& key) {
   for (auto it = paired_devices_list_.sections.begin();
        it != paired_devices_list_.sections.end();) {
     if (it->Has(key)) {
+      bond_store_.RemoveSection(it->name);
       it = paired_devices_list_.sections.erase(it);
       continue;
     }
@@ -137,12 +140,16 @@ bool BtifConfigCache::RemoveKey(const std::string& section_name,
     }
     section_iter->entries.erase(entry_iter);
     if (section_iter->entries.empty()) {
+      bond_store_.RemoveSection(section_name);
       paired_devices_list_.sections.erase(section_iter);
     } else if (!has_link_key_in_section(*section_iter)) {
       // if no link key in section after removal, move it to unpaired section
+      bond_store_.RemoveSection(section_name);
       auto moved_section = std::move(*section_iter);
       paired_devices_list_.sections.erase(section_iter);
       unpaired_devices_cache_.Put(section_name, std::move(moved_section));
+    } else {
+      bond_store_.Remove(section_name, key);
     }
     return true;
   }
@@ -193,6 +200,7 @@ void BtifConfigCache::SetString(std::string section_name, std::string key,
       // when a unpaired section got the LinkKey, move this section to the
       // paired devices list
       paired_devices_list_.sections.emplace_back(std::move(section));
+      bond_store_.AddSection(paired_devices_list_.sections.back());
     } else {
       // update to the unpaired devices cache
       unpaired_devices_cache_.Put(section_name, section);
@@ -205,6 +213,7 @@ void BtifConfigCache::SetString(std::string section_name, std::string key,
       return;
     }
     section_found->Set(key, value);
+    bond_store_.Set(section_name, key, value);
   }
 }
 
@@ -715,7 +715,7 @@ static void execute_storage_request(uint16_t event, char* p_param) {
         if (cmn_vsc_cb.filter_support == 1)
           local_le_features.max_adv_filter_supported = cmn_vsc_cb.max_filter;
         else
-          local_le_features.max_adv_filter_supported = 0;
+          local_le_features.max_adv_filter_supported = BTM_BLE_SW_FILTER_MAX;
         local_le_features.max_adv_instance = cmn_vsc_cb.adv_inst_max;
         local_le_features.max_irk_list_size = cmn_vsc_cb.max_irk_list_sz;
         local_le_features.rpa_offload_supported = cmn_vsc_cb.rpa_offloading;
@@ -31,6 +31,7 @@
 
 #include <base/logging.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -488,8 +489,6 @@ void btif_hh_remove_device(RawAddress bd_addr) {
     BTIF_TRACE_WARNING("%s: device_num = 0", __func__);
   }
 
-  p_dev->hh_keep_polling = 0;
-  p_dev->hh_poll_thread_id = -1;
   BTIF_TRACE_DEBUG("%s: uhid fd = %d", __func__, p_dev->fd);
   if (p_dev->fd >= 0) {
     bta_hh_co_destroy(p_dev->fd);
@@ -1656,8 +1655,6 @@ static void cleanup(void) {
         bta_hh_co_destroy(p_dev->fd);
         p_dev->fd = -1;
       }
-      p_dev->hh_keep_polling = 0;
-      p_dev->hh_poll_thread_id = -1;
     }
   }
 
@@ -1713,3 +1710,35 @@ const bthh_interface_t* btif_hh_get_interface() {
   BTIF_TRACE_EVENT("%s", __func__);
   return &bthhInterface;
 }
+
+void btif_debug_hh_dump(int fd) {
+  dprintf(fd, "\nHID Host:\n");
+  dprintf(fd, "  Connected devices: %d\n", btif_hh_cb.device_num);
+
+  for (int i = 0; i < BTIF_HH_MAX_HID; i++) {
+    const btif_hh_device_t* p_dev = &btif_hh_cb.devices[i];
+    if (p_dev->dev_status == BTHH_CONN_STATE_UNKNOWN) continue;
+
+    const btif_hh_input_stats_t* p_stats = &p_dev->input_stats;
+    dprintf(fd, "  %s: handle=%d uhid_fd=%d ready=%s\n",
+            p_dev->bd_addr.ToString().c_str(), p_dev->dev_handle, p_dev->fd,
+            p_dev->ready_for_data ? "true" : "false");
+    dprintf(fd,
+            "    Input reports: %" PRIu64 " delivered, %" PRIu64 " dropped\n",
+            p_stats->count, p_stats->errors);
+    if (p_stats->count == 0) continue;
+
+    dprintf(fd, "    Input latency (us): avg=%" PRIu64 " max=%" PRIu64 "\n",
+            p_stats->total_us / p_stats->count, p_stats->max_us);
+    for (int b = 0; b < BTIF_HH_LATENCY_BUCKETS; b++) {
+      if (p_stats->latency_buckets[b] == 0) continue;
+      if (b == BTIF_HH_LATENCY_BUCKETS - 1) {
+        dprintf(fd, "      >= %u: %" PRIu64 "\n", 1u << b,
+                p_stats->latency_buckets[b]);
+      } else {
+        dprintf(fd, "      < %u: %" PRIu64 "\n", 2u << b,
+                p_stats->latency_buckets[b]);
+      }
+    }
+  }
+}
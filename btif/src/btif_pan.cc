@@ -42,7 +42,6 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
-#include <sys/poll.h>
 #include <sys/prctl.h>
 #include <sys/select.h>
 #include <sys/socket.h>
@@ -88,8 +87,6 @@
                        __func__, #s, __LINE__)                           \
   } while (0)
 
-#define MIN(x, y) (((x) < (y)) ? (x) : (y))
-
 btpan_cb_t btpan_cb;
 
 static bool jni_initialized;
@@ -417,18 +414,14 @@ int btpan_tap_send(int tap_fd, const RawAddress& src, const RawAddress& dst,
     eth_hdr.h_dest = dst;
     eth_hdr.h_src = src;
     eth_hdr.h_proto = htons(proto);
-    char packet[TAP_MAX_PKT_WRITE_LEN + sizeof(tETH_HDR)];
-    memcpy(packet, &eth_hdr, sizeof(tETH_HDR));
     if (len > TAP_MAX_PKT_WRITE_LEN) {
       LOG_ERROR(LOG_TAG, "btpan_tap_send eth packet size:%d is exceeded limit!",
                 len);
       return -1;
     }
-    memcpy(packet + sizeof(tETH_HDR), buf, len);
 
-    /* Send data to network interface */
-    ssize_t ret;
-    OSI_NO_INTR(ret = write(tap_fd, packet, len + sizeof(tETH_HDR)));
+    /* Send data to network interface, straight from the stack buffer */
+    ssize_t ret = btpan_tap_write_frame(tap_fd, &eth_hdr, buf, len);
     BTIF_TRACE_DEBUG("ret:%d", ret);
     return (int)ret;
   }
@@ -436,6 +429,7 @@ int btpan_tap_send(int tap_fd, const RawAddress& src, const RawAddress& dst,
 }
 
 int btpan_tap_close(int fd) {
+  osi_free_and_reset((void**)&btpan_cb.congest_buf);
   if (tap_if_down(TAP_IF_NAME) == 0) close(fd);
   if (pan_pth >= 0) btsock_thread_wakeup(pan_pth);
   return 0;
@@ -665,31 +659,36 @@ static void bta_pan_callback(tBTA_PAN_EVT event, tBTA_PAN* p_data) {
                         sizeof(tBTA_PAN), NULL);
 }
 
-#define IS_EXCEPTION(e) ((e) & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL))
 static void btu_exec_tap_fd_read(int fd) {
-  struct pollfd ufd;
-
   if (fd == INVALID_FD || fd != btpan_cb.tap_fd) return;
 
   // Don't occupy BTU context too long, avoid buffer overruns and
   // give other profiles a chance to run by limiting the amount of memory
   // PAN can use.
+  // The TAP fd is non-blocking: frames are pulled until the driver queue is
+  // drained, so a burst is handled within a single wakeup.
   for (int i = 0; i < PAN_BUF_MAX && btif_is_enabled() && btpan_cb.flow; i++) {
-    BT_HDR* buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
-    buffer->offset = PAN_MINIMUM_OFFSET;
-    buffer->len = PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset;
-
-    uint8_t* packet = (uint8_t*)buffer + sizeof(BT_HDR) + buffer->offset;
-
-    // If we don't have an undelivered packet left over, pull one from the TAP
-    // driver.
-    // We save it in the congest_packet right away in case we can't deliver it
-    // in this
-    // attempt.
-    if (!btpan_cb.congest_packet_size) {
-      ssize_t ret;
-      OSI_NO_INTR(ret = read(fd, btpan_cb.congest_packet,
-                             sizeof(btpan_cb.congest_packet)));
+    BT_HDR* buffer;
+    tETH_HDR hdr;
+
+    if (btpan_cb.congest_buf) {
+      // Retry the frame BNEP could not take last time before pulling a new
+      // one from the TAP driver.
+      buffer = btpan_cb.congest_buf;
+      hdr = btpan_cb.congest_eth_hdr;
+      btpan_cb.congest_buf = NULL;
+    } else {
+      // Read the frame straight into the buffer handed to BNEP, leaving room
+      // for the lower layer headers in front of the payload.
+      buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
+      buffer->offset = PAN_MINIMUM_OFFSET;
+      buffer->len = PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset;
+
+      ssize_t ret = btpan_tap_read_frame(fd, &hdr, buffer);
+      if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        osi_free(buffer);
+        break;
+      }
       switch (ret) {
         case -1:
           BTIF_TRACE_ERROR("%s unable to read from driver: %s", __func__,
@@ -705,43 +704,24 @@ static void btu_exec_tap_fd_read(int fd) {
           btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
           return;
         default:
-          btpan_cb.congest_packet_size = ret;
           break;
       }
-    }
 
-    memcpy(packet, btpan_cb.congest_packet,
-           MIN(btpan_cb.congest_packet_size, buffer->len));
-    buffer->len = MIN(btpan_cb.congest_packet_size, buffer->len);
-
-    if (buffer->len > sizeof(tETH_HDR) && should_forward((tETH_HDR*)packet)) {
-      // Extract the ethernet header from the buffer since the PAN_WriteBuf
-      // inside
-      // forward_bnep can't handle two pointers that point inside the same GKI
-      // buffer.
-      tETH_HDR hdr;
-      memcpy(&hdr, packet, sizeof(tETH_HDR));
-
-      // Skip the ethernet header.
-      buffer->len -= sizeof(tETH_HDR);
-      buffer->offset += sizeof(tETH_HDR);
-      if (forward_bnep(&hdr, buffer) != FORWARD_CONGEST)
-        btpan_cb.congest_packet_size = 0;
-    } else {
-      BTIF_TRACE_WARNING("%s dropping packet of length %d", __func__,
-                         buffer->len);
-      btpan_cb.congest_packet_size = 0;
-      osi_free(buffer);
+      if (ret <= (ssize_t)sizeof(tETH_HDR) || !should_forward(&hdr)) {
+        BTIF_TRACE_WARNING("%s dropping packet of length %d", __func__,
+                           (int)ret);
+        osi_free(buffer);
+        continue;
+      }
     }
 
-    // Bail out of the loop if reading from the TAP fd would block.
-    ufd.fd = fd;
-    ufd.events = POLLIN;
-    ufd.revents = 0;
-
-    int ret;
-    OSI_NO_INTR(ret = poll(&ufd, 1, 0));
-    if (ret <= 0 || IS_EXCEPTION(ufd.revents)) break;
+    // BNEP leaves the buffer to us when its transmit queue is full; keep it
+    // for the next attempt and stop pulling frames until then.
+    if (forward_bnep(&hdr, buffer) == FORWARD_CONGEST) {
+      btpan_cb.congest_buf = buffer;
+      btpan_cb.congest_eth_hdr = hdr;
+      break;
+    }
   }
 
   if (btpan_cb.flow) {
@@ -0,0 +1,47 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "btif_scan_batch.h"
+
+#include <string.h>
+
+bool BtifScanResultBatch::Add(const BtifScanResult& result,
+                              const uint8_t* data, size_t len) {
+  // Batches are small, a linear search beats hashing the data
+  for (BtifScanResult& queued : results_) {
+    if (queued.bd_addr != result.bd_addr ||
+        queued.addr_type != result.addr_type ||
+        queued.ble_evt_type != result.ble_evt_type ||
+        queued.value.size() != len ||
+        (len != 0 && memcmp(queued.value.data(), data, len) != 0))
+      continue;
+
+    queued.rssi = result.rssi;
+    queued.ble_tx_power = result.ble_tx_power;
+    return false;
+  }
+
+  results_.push_back(result);
+  results_.back().value.assign(data, data + len);
+  return true;
+}
+
+std::vector<BtifScanResult> BtifScanResultBatch::Take() {
+  std::vector<BtifScanResult> results;
+  results.reserve(capacity_);
+  results.swap(results_);
+  return results;
+}
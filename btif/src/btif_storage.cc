@@ -171,12 +171,10 @@ extern void btif_gatts_add_bonded_dev_from_nv(const RawAddress& bda);
  ******************************************************************************/
 
 static bt_status_t btif_in_fetch_bonded_ble_device(
-    const std::string& remote_bd_addr, int add,
+    const BtifBondRecord& record, int add,
     btif_bonded_devices_t* p_bonded_devices);
 static bt_status_t btif_in_fetch_bonded_device(const std::string& bdstr);
 
-static bool btif_has_ble_keys(const std::string& bdstr);
-
 /*******************************************************************************
  *  Static functions
  ******************************************************************************/
@@ -398,6 +396,94 @@ static int cfg2prop(const RawAddress* remote_bd_addr, bt_property_t* prop) {
   return ret;
 }
 
+/*******************************************************************************
+ *
+ * Function         btif_in_read_bond_key
+ *
+ * Description      Internal helper function to read a key of a bonded device
+ *                  record, as btif_config_get_bin() would
+ *
+ * Returns          true if the key was read, false otherwise
+ *
+ ******************************************************************************/
+static bool btif_in_read_bond_key(const BtifBondRecord& record,
+                                  BtifBondKeyId key_id, uint8_t* value,
+                                  size_t* length) {
+  const BtifBondKey& key = record.keys[key_id];
+  switch (key.state) {
+    case BtifBondKey::DECODED:
+      if (*length < key.value.size()) return false;
+      memcpy(value, key.value.data(), key.value.size());
+      *length = key.value.size();
+      return true;
+    case BtifBondKey::OPAQUE:
+      return btif_config_get_bin(record.section_name,
+                                 BtifBondStore::KeyName(key_id), value, length);
+    default:
+      return false;
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         btif_in_read_bond_record
+ *
+ * Description      Internal helper function to fill a bonded device record
+ *                  for a device without a persistent config section
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void btif_in_read_bond_record(const std::string& bdstr,
+                                     BtifBondRecord* record) {
+  record->section_name = bdstr;
+  RawAddress::FromString(bdstr, record->bd_addr);
+  for (int id = 0; id < BTIF_BOND_KEY_COUNT; id++) {
+    if (btif_config_exist(bdstr, BtifBondStore::KeyName((BtifBondKeyId)id)))
+      record->keys[id].state = BtifBondKey::OPAQUE;
+  }
+  int value;
+  if (btif_config_get_int(bdstr, "LinkKeyType", &value))
+    record->link_key_type = value;
+  if (btif_config_get_int(bdstr, "DevType", &value)) record->dev_type = value;
+  if (btif_config_get_int(bdstr, "AddrType", &value)) record->addr_type = value;
+}
+
+/*******************************************************************************
+ *
+ * Function         btif_in_le_key_id
+ *
+ * Description      Internal helper function to map a BTIF_DM_LE_KEY_* type to
+ *                  the key of the bonded device record holding it
+ *
+ * Returns          true if |key_type| is a stored LE key, false otherwise
+ *
+ ******************************************************************************/
+static bool btif_in_le_key_id(uint8_t key_type, BtifBondKeyId* key_id) {
+  switch (key_type) {
+    case BTIF_DM_LE_KEY_PENC:
+      *key_id = BTIF_BOND_KEY_LE_PENC;
+      return true;
+    case BTIF_DM_LE_KEY_PID:
+      *key_id = BTIF_BOND_KEY_LE_PID;
+      return true;
+    case BTIF_DM_LE_KEY_PCSRK:
+      *key_id = BTIF_BOND_KEY_LE_PCSRK;
+      return true;
+    case BTIF_DM_LE_KEY_LENC:
+      *key_id = BTIF_BOND_KEY_LE_LENC;
+      return true;
+    case BTIF_DM_LE_KEY_LCSRK:
+      *key_id = BTIF_BOND_KEY_LE_LCSRK;
+      return true;
+    case BTIF_DM_LE_KEY_LID:
+      *key_id = BTIF_BOND_KEY_LE_LID;
+      return true;
+    default:
+      return false;
+  }
+}
+
 /*******************************************************************************
  *
  * Function         btif_in_fetch_bonded_devices
@@ -411,17 +497,22 @@ static int cfg2prop(const RawAddress* remote_bd_addr, bt_property_t* prop) {
 static bt_status_t btif_in_fetch_bonded_device(const std::string& bdstr) {
   bool bt_linkkey_file_found = false;
 
+  BtifBondRecord record;
+  if (!btif_config_get_bond_record(bdstr, &record)) {
+    btif_in_read_bond_record(bdstr, &record);
+  }
+
   LinkKey link_key;
   size_t size = link_key.size();
-  if (btif_config_get_bin(bdstr, "LinkKey", link_key.data(), &size)) {
-    int linkkey_type;
-    if (btif_config_get_int(bdstr, "LinkKeyType", &linkkey_type)) {
+  if (btif_in_read_bond_key(record, BTIF_BOND_KEY_LINK_KEY, link_key.data(),
+                            &size)) {
+    if (record.link_key_type) {
       bt_linkkey_file_found = true;
     } else {
       bt_linkkey_file_found = false;
     }
   }
-  if ((btif_in_fetch_bonded_ble_device(bdstr, false, NULL) !=
+  if ((btif_in_fetch_bonded_ble_device(record, false, NULL) !=
        BT_STATUS_SUCCESS) &&
       (!bt_linkkey_file_found)) {
     BTIF_TRACE_DEBUG("Remote device:%s, no link key or ble key found",
@@ -446,34 +537,27 @@ static bt_status_t btif_in_fetch_bonded_devices(
   memset(p_bonded_devices, 0, sizeof(btif_bonded_devices_t));
 
   bool bt_linkkey_file_found = false;
-  int device_type;
 
-  // TODO: this code is not thread safe, it can corrupt config content.
-  // b/67595284
-  for (const section_t& section : btif_config_sections()) {
-    const std::string& name = section.name;
-    if (!RawAddress::IsValidAddress(name)) continue;
+  for (const BtifBondRecord& record : btif_config_get_bond_records()) {
+    const std::string& name = record.section_name;
 
     BTIF_TRACE_DEBUG("Remote device:%s", name.c_str());
     LinkKey link_key;
     size_t size = sizeof(link_key);
-    if (btif_config_get_bin(name, "LinkKey", link_key.data(), &size)) {
-      int linkkey_type;
-      if (btif_config_get_int(name, "LinkKeyType", &linkkey_type)) {
-        RawAddress bd_addr;
-        RawAddress::FromString(name, bd_addr);
+    if (btif_in_read_bond_key(record, BTIF_BOND_KEY_LINK_KEY, link_key.data(),
+                              &size)) {
+      if (record.link_key_type) {
+        int linkkey_type = *record.link_key_type;
+        const RawAddress& bd_addr = record.bd_addr;
         if (add) {
           DEV_CLASS dev_class = {0, 0, 0};
-          int cod;
-          int pin_length = 0;
-          if (btif_config_get_int(name, "DevClass", &cod))
-            uint2devclass((uint32_t)cod, dev_class);
-          btif_config_get_int(name, "PinLength", &pin_length);
+          int pin_length = record.pin_length.value_or(0);
+          if (record.dev_class)
+            uint2devclass((uint32_t)*record.dev_class, dev_class);
           BTA_DmAddDevice(bd_addr, dev_class, link_key, 0, 0,
                           (uint8_t)linkkey_type, 0, pin_length);
 
-          if (btif_config_get_int(name, "DevType", &device_type) &&
-              (device_type == BT_DEVICE_TYPE_DUMO)) {
+          if (record.dev_type && (*record.dev_type == BT_DEVICE_TYPE_DUMO)) {
             btif_gatts_add_bonded_dev_from_nv(bd_addr);
           }
         }
@@ -483,7 +567,7 @@ static bt_status_t btif_in_fetch_bonded_devices(
         bt_linkkey_file_found = false;
       }
     }
-    if (!btif_in_fetch_bonded_ble_device(name, add, p_bonded_devices) && !bt_linkkey_file_found) {
+    if (!btif_in_fetch_bonded_ble_device(record, add, p_bonded_devices) && !bt_linkkey_file_found) {
       BTIF_TRACE_DEBUG("Remote device:%s, no link key or ble key found",
                        name.c_str());
     }
@@ -491,18 +575,21 @@ static bt_status_t btif_in_fetch_bonded_devices(
   return BT_STATUS_SUCCESS;
 }
 
-static void btif_read_le_key(const uint8_t key_type, const size_t key_len,
-                             RawAddress bd_addr, const uint8_t addr_type,
-                             const bool add_key, bool* device_added,
-                             bool* key_found) {
+static void btif_read_le_key(const BtifBondRecord& record,
+                             const uint8_t key_type, const size_t key_len,
+                             const uint8_t addr_type, const bool add_key,
+                             bool* device_added, bool* key_found) {
   CHECK(device_added);
   CHECK(key_found);
 
   tBTA_LE_KEY_VALUE key;
   memset(&key, 0, sizeof(key));
 
-  if (btif_storage_get_ble_bonding_key(&bd_addr, key_type, (uint8_t*)&key,
-                                       key_len) == BT_STATUS_SUCCESS) {
+  const RawAddress& bd_addr = record.bd_addr;
+  BtifBondKeyId key_id;
+  size_t length = key_len;
+  if (btif_in_le_key_id(key_type, &key_id) &&
+      btif_in_read_bond_key(record, key_id, (uint8_t*)&key, &length)) {
     if (add_key) {
       if (!*device_added) {
         BTA_DmAddBleDevice(bd_addr, addr_type, BT_DEVICE_TYPE_BLE);
@@ -1055,31 +1142,11 @@ bt_status_t btif_storage_add_ble_bonding_key(RawAddress* remote_bd_addr,
                                              const uint8_t* key,
                                              uint8_t key_type,
                                              uint8_t key_length) {
-  const char* name;
-  switch (key_type) {
-    case BTIF_DM_LE_KEY_PENC:
-      name = "LE_KEY_PENC";
-      break;
-    case BTIF_DM_LE_KEY_PID:
-      name = "LE_KEY_PID";
-      break;
-    case BTIF_DM_LE_KEY_PCSRK:
-      name = "LE_KEY_PCSRK";
-      break;
-    case BTIF_DM_LE_KEY_LENC:
-      name = "LE_KEY_LENC";
-      break;
-    case BTIF_DM_LE_KEY_LCSRK:
-      name = "LE_KEY_LCSRK";
-      break;
-    case BTIF_DM_LE_KEY_LID:
-      name = "LE_KEY_LID";
-      break;
-    default:
-      return BT_STATUS_FAIL;
-  }
-  int ret =
-      btif_config_set_bin(remote_bd_addr->ToString(), name, key, key_length);
+  BtifBondKeyId key_id;
+  if (!btif_in_le_key_id(key_type, &key_id)) return BT_STATUS_FAIL;
+  int ret = btif_config_set_bin(remote_bd_addr->ToString(),
+                                BtifBondStore::KeyName(key_id), key,
+                                key_length);
   btif_config_save();
   return ret ? BT_STATUS_SUCCESS : BT_STATUS_FAIL;
 }
@@ -1098,32 +1165,12 @@ bt_status_t btif_storage_get_ble_bonding_key(RawAddress* remote_bd_addr,
                                              uint8_t key_type,
                                              uint8_t* key_value,
                                              int key_length) {
-  const char* name;
-  switch (key_type) {
-    case BTIF_DM_LE_KEY_PENC:
-      name = "LE_KEY_PENC";
-      break;
-    case BTIF_DM_LE_KEY_PID:
-      name = "LE_KEY_PID";
-      break;
-    case BTIF_DM_LE_KEY_PCSRK:
-      name = "LE_KEY_PCSRK";
-      break;
-    case BTIF_DM_LE_KEY_LENC:
-      name = "LE_KEY_LENC";
-      break;
-    case BTIF_DM_LE_KEY_LCSRK:
-      name = "LE_KEY_LCSRK";
-      break;
-    case BTIF_DM_LE_KEY_LID:
-      name = "LE_KEY_LID";
-      break;
-    default:
-      return BT_STATUS_FAIL;
-  }
+  BtifBondKeyId key_id;
+  if (!btif_in_le_key_id(key_type, &key_id)) return BT_STATUS_FAIL;
   size_t length = key_length;
-  int ret =
-      btif_config_get_bin(remote_bd_addr->ToString(), name, key_value, &length);
+  int ret = btif_config_get_bin(remote_bd_addr->ToString(),
+                                BtifBondStore::KeyName(key_id), key_value,
+                                &length);
   return ret ? BT_STATUS_SUCCESS : BT_STATUS_FAIL;
 }
 
@@ -1243,46 +1290,45 @@ bt_status_t btif_storage_remove_ble_local_keys(void) {
 }
 
 static bt_status_t btif_in_fetch_bonded_ble_device(
-    const std::string& remote_bd_addr, int add,
+    const BtifBondRecord& record, int add,
     btif_bonded_devices_t* p_bonded_devices) {
-  int device_type;
   int addr_type;
   bool device_added = false;
   bool key_found = false;
 
-  if (!btif_config_get_int(remote_bd_addr, "DevType", &device_type))
-    return BT_STATUS_FAIL;
+  if (!record.dev_type) return BT_STATUS_FAIL;
+  int device_type = *record.dev_type;
 
   if ((device_type & BT_DEVICE_TYPE_BLE) == BT_DEVICE_TYPE_BLE ||
-      btif_has_ble_keys(remote_bd_addr)) {
+      record.keys[BTIF_BOND_KEY_LE_PENC].state != BtifBondKey::ABSENT) {
     BTIF_TRACE_DEBUG("%s Found a LE device: %s", __func__,
-                     remote_bd_addr.c_str());
+                     record.section_name.c_str());
 
-    RawAddress bd_addr;
-    RawAddress::FromString(remote_bd_addr, bd_addr);
+    RawAddress bd_addr = record.bd_addr;
 
-    if (btif_storage_get_remote_addr_type(&bd_addr, &addr_type) !=
-        BT_STATUS_SUCCESS) {
+    if (record.addr_type) {
+      addr_type = *record.addr_type;
+    } else {
       addr_type = BLE_ADDR_PUBLIC;
       btif_storage_set_remote_addr_type(&bd_addr, BLE_ADDR_PUBLIC);
     }
 
-    btif_read_le_key(BTIF_DM_LE_KEY_PENC, sizeof(tBTM_LE_PENC_KEYS), bd_addr,
+    btif_read_le_key(record, BTIF_DM_LE_KEY_PENC, sizeof(tBTM_LE_PENC_KEYS),
                      addr_type, add, &device_added, &key_found);
 
-    btif_read_le_key(BTIF_DM_LE_KEY_PID, sizeof(tBTM_LE_PID_KEYS), bd_addr,
+    btif_read_le_key(record, BTIF_DM_LE_KEY_PID, sizeof(tBTM_LE_PID_KEYS),
                      addr_type, add, &device_added, &key_found);
 
-    btif_read_le_key(BTIF_DM_LE_KEY_LID, sizeof(tBTM_LE_PID_KEYS), bd_addr,
+    btif_read_le_key(record, BTIF_DM_LE_KEY_LID, sizeof(tBTM_LE_PID_KEYS),
                      addr_type, add, &device_added, &key_found);
 
-    btif_read_le_key(BTIF_DM_LE_KEY_PCSRK, sizeof(tBTM_LE_PCSRK_KEYS), bd_addr,
+    btif_read_le_key(record, BTIF_DM_LE_KEY_PCSRK, sizeof(tBTM_LE_PCSRK_KEYS),
                      addr_type, add, &device_added, &key_found);
 
-    btif_read_le_key(BTIF_DM_LE_KEY_LENC, sizeof(tBTM_LE_LENC_KEYS), bd_addr,
+    btif_read_le_key(record, BTIF_DM_LE_KEY_LENC, sizeof(tBTM_LE_LENC_KEYS),
                      addr_type, add, &device_added, &key_found);
 
-    btif_read_le_key(BTIF_DM_LE_KEY_LCSRK, sizeof(tBTM_LE_LCSRK_KEYS), bd_addr,
+    btif_read_le_key(record, BTIF_DM_LE_KEY_LCSRK, sizeof(tBTM_LE_LCSRK_KEYS),
                      addr_type, add, &device_added, &key_found);
 
     // Fill in the bonded devices
@@ -1303,10 +1349,6 @@ bt_status_t btif_storage_set_remote_addr_type(const RawAddress* remote_bd_addr,
   return ret ? BT_STATUS_SUCCESS : BT_STATUS_FAIL;
 }
 
-bool btif_has_ble_keys(const std::string& bdstr) {
-  return btif_config_exist(bdstr, "LE_KEY_PENC");
-}
-
 /*******************************************************************************
  *
  * Function         btif_storage_get_remote_addr_type
@@ -0,0 +1,372 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "btif/include/btif_a2dp_sink_playout.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr uint64_t kTickUs = 20 * 1000;
+// Sink queue size, MAX_INPUT_A2DP_FRAME_QUEUE_SZ
+constexpr size_t kMaxQueueLength = 140;
+// Time given to the estimates before counting underruns
+constexpr uint64_t kWarmUpUs = 10 * 1000 * 1000;
+
+// The Sink queue and the decoder: a decoded packet is a ramp of samples, one
+// step per frame of the Source, so that the played out audio shows where it
+// was resampled, dropped or ran dry.
+struct QueuedPacket {
+  uint32_t media_timestamp;
+  uint64_t first_frame;
+  uint32_t frames;
+};
+
+struct Harness {
+  BtifA2dpSinkPlayout* playout = nullptr;
+  int channel_count = 2;
+  int sample_bytes = 2;
+  std::deque<QueuedPacket> queue;
+
+  // Played out audio
+  uint64_t frames_written = 0;
+  bool has_last_sample = false;
+  int64_t last_sample = 0;
+  int wrap_frames = 0;
+  size_t glitches = 0;
+};
+
+Harness g_harness;
+
+int64_t RampValue(uint64_t frame, int sample_bytes) {
+  return frame % (1ULL << (sample_bytes * 8 - 1));
+}
+
+int64_t ReadSample(const uint8_t* p, int sample_bytes) {
+  int32_t sample = 0;
+  if (sample_bytes == 2) {
+    int16_t sample16;
+    memcpy(&sample16, p, sizeof(sample16));
+    sample = sample16;
+  } else if (sample_bytes == 3) {
+    sample = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 |
+                       (uint32_t)p[2] << 24) >>
+             8;
+  } else {
+    memcpy(&sample, p, sizeof(sample));
+  }
+  return sample;
+}
+
+bool DecodeNext(uint32_t* p_media_timestamp) {
+  if (g_harness.queue.empty()) return false;
+  QueuedPacket packet = g_harness.queue.front();
+  g_harness.queue.pop_front();
+  *p_media_timestamp = packet.media_timestamp;
+
+  int sample_bytes = g_harness.sample_bytes;
+  std::vector<uint8_t> pcm(packet.frames * g_harness.channel_count *
+                           sample_bytes);
+  uint8_t* p = pcm.data();
+  for (uint32_t i = 0; i < packet.frames; i++) {
+    int32_t value = RampValue(packet.first_frame + i, sample_bytes);
+    for (int channel = 0; channel < g_harness.channel_count; channel++) {
+      memcpy(p, &value, sample_bytes);
+      p += sample_bytes;
+    }
+  }
+  g_harness.playout->AddPcm(pcm.data(), pcm.size());
+  return true;
+}
+
+// Counts the places where the ramp does not go on by zero to two steps per
+// frame, apart from the frames interpolated where it wraps around
+void WritePcm(const uint8_t* data, size_t len) {
+  int sample_bytes = g_harness.sample_bytes;
+  size_t frame_bytes = g_harness.channel_count * sample_bytes;
+  int64_t wrap = 1LL << (sample_bytes * 8 - 1);
+  for (size_t offset = 0; offset + frame_bytes <= len; offset += frame_bytes) {
+    int64_t sample = ReadSample(data + offset, sample_bytes);
+    int64_t right =
+        ReadSample(data + offset + frame_bytes - sample_bytes, sample_bytes);
+    if (sample != right) g_harness.glitches++;
+    if (g_harness.has_last_sample) {
+      int64_t step = sample - g_harness.last_sample;
+      if (g_harness.last_sample >= wrap - 3) g_harness.wrap_frames = 3;
+      if (g_harness.wrap_frames > 0) {
+        g_harness.wrap_frames--;
+      } else if (step < 0 || step > 2) {
+        g_harness.glitches++;
+      }
+    }
+    g_harness.has_last_sample = true;
+    g_harness.last_sample = sample;
+  }
+  g_harness.frames_written += len / frame_bytes;
+}
+
+// Timing of the media packets of a Source, as seen by the Sink
+struct TimedPacket {
+  uint32_t rtp_timestamp;
+  uint64_t arrival_us;
+  uint32_t frames;
+};
+
+struct TimingTrace {
+  const char* name;
+  int sample_rate;
+  double source_ppm;  // Source clock against the Sink clock
+  std::vector<TimedPacket> packets;
+};
+
+// A Source sending |frames_per_packet| frames per packet for |duration_us|,
+// with its clock |source_ppm| fast. |delay_us| gives the transmission delay
+// of each packet, on top of a fixed 30 ms; the link keeps packets in order.
+template <typename DelayFunction>
+TimingTrace MakeTrace(const char* name, int sample_rate, double source_ppm,
+                      uint32_t frames_per_packet, uint64_t duration_us,
+                      DelayFunction delay_us) {
+  TimingTrace trace = {name, sample_rate, source_ppm, {}};
+  std::mt19937 gen(1);
+  uint32_t rtp_timestamp = 0x12345678;
+  uint64_t last_arrival_us = 0;
+  for (uint64_t frame = 0;; frame += frames_per_packet) {
+    double send_us =
+        frame * 1000000.0 / sample_rate / (1 + source_ppm / 1000000);
+    if (send_us > duration_us) break;
+    uint64_t arrival_us =
+        std::max(last_arrival_us,
+                 (uint64_t)send_us + 30 * 1000 + delay_us((uint64_t)send_us,
+                                                          gen));
+    trace.packets.push_back({rtp_timestamp, arrival_us, frames_per_packet});
+    rtp_timestamp += frames_per_packet;
+    last_arrival_us = arrival_us;
+  }
+  return trace;
+}
+
+// Timing traces shaped after the ones captured from phones streaming to a
+// Sink: SBC packets of 7 frames of 128 samples, or AAC packets of 1024.
+std::vector<TimingTrace> MakeTraces() {
+  constexpr uint64_t kTenMinutesUs = 10ULL * 60 * 1000 * 1000;
+  auto small_jitter = [](uint64_t, std::mt19937& gen) {
+    return std::uniform_int_distribution<uint64_t>(0, 3000)(gen);
+  };
+  std::vector<TimingTrace> traces;
+  traces.push_back(
+      MakeTrace("fast_source", 44100, 250, 896, kTenMinutesUs, small_jitter));
+  traces.push_back(
+      MakeTrace("slow_source", 44100, -250, 896, kTenMinutesUs, small_jitter));
+  // Wi-Fi scans on the shared antenna hold the link for 60 ms every 5 s
+  traces.push_back(MakeTrace(
+      "wifi_coex", 48000, 100, 1024, kTenMinutesUs,
+      [](uint64_t send_us, std::mt19937& gen) -> uint64_t {
+        uint64_t in_period_us = send_us % (5 * 1000 * 1000);
+        uint64_t jitter_us =
+            std::uniform_int_distribution<uint64_t>(0, 5000)(gen);
+        if (in_period_us < 60 * 1000) return 60 * 1000 - in_period_us;
+        return jitter_us;
+      }));
+  // A Source sending its packets in bursts every 80 ms
+  traces.push_back(
+      MakeTrace("bursty_source", 44100, -150, 896, kTenMinutesUs,
+                [](uint64_t send_us, std::mt19937&) -> uint64_t {
+                  uint64_t burst_us = 80 * 1000;
+                  return (burst_us - send_us % burst_us) % burst_us;
+                }));
+  return traces;
+}
+
+struct ReplayResult {
+  size_t underruns = 0;  // after the warm up
+  size_t overflows = 0;
+  size_t glitches = 0;  // after the warm up
+  double drift_ppm = 0;
+  uint64_t max_depth_us = 0;  // after the warm up
+  uint64_t final_depth_us = 0;
+  uint64_t final_target_us = 0;
+  uint64_t frames_written = 0;
+};
+
+// Replays |trace| into the playout engine, ticked every 20 ms by a decode
+// alarm firing up to 2 ms late.
+ReplayResult Replay(const TimingTrace& trace, bool drift_compensation,
+                    int channel_count = 2, int bits_per_sample = 16) {
+  BtifA2dpSinkPlayout playout(DecodeNext, WritePcm);
+  playout.Configure(trace.sample_rate, channel_count, bits_per_sample,
+                    drift_compensation);
+  g_harness = Harness();
+  g_harness.playout = &playout;
+  g_harness.channel_count = channel_count;
+  g_harness.sample_bytes = bits_per_sample / 8;
+
+  std::mt19937 gen(2);
+  ReplayResult result;
+  size_t next_packet = 0;
+  uint64_t source_frame = 0;
+  uint64_t end_us = trace.packets.back().arrival_us + 1000 * 1000;
+  size_t underruns_at_warm_up = 0;
+  size_t glitches_at_warm_up = 0;
+  for (uint64_t tick_us = kTickUs; tick_us < end_us; tick_us += kTickUs) {
+    uint64_t now_us =
+        tick_us + std::uniform_int_distribution<uint64_t>(0, 2000)(gen);
+    while (next_packet < trace.packets.size() &&
+           trace.packets[next_packet].arrival_us <= now_us) {
+      const TimedPacket& packet = trace.packets[next_packet++];
+      uint32_t media_timestamp =
+          playout.OnPacketReceived(packet.rtp_timestamp, packet.arrival_us);
+      if (g_harness.queue.size() == kMaxQueueLength) {
+        g_harness.queue.pop_front();
+        playout.OnPacketDropped();
+      }
+      g_harness.queue.push_back({media_timestamp, source_frame, packet.frames});
+      source_frame += packet.frames;
+    }
+    if (next_packet == trace.packets.size()) break;
+
+    playout.OnTick(now_us);
+    if (tick_us == kWarmUpUs) {
+      underruns_at_warm_up = playout.Underruns();
+      glitches_at_warm_up = g_harness.glitches;
+    } else if (tick_us > kWarmUpUs && playout.IsPlaying()) {
+      result.max_depth_us = std::max(result.max_depth_us, playout.DepthUs());
+    }
+  }
+
+  result.underruns = playout.Underruns() - underruns_at_warm_up;
+  result.overflows = playout.Overflows();
+  result.glitches = g_harness.glitches - glitches_at_warm_up;
+  result.drift_ppm = playout.DriftPpm();
+  result.final_depth_us = playout.DepthUs();
+  result.final_target_us = playout.TargetDepthUs();
+  result.frames_written = g_harness.frames_written;
+  return result;
+}
+
+const std::vector<TimingTrace>& Traces() {
+  static const std::vector<TimingTrace> traces = MakeTraces();
+  return traces;
+}
+
+const TimingTrace& FindTrace(const char* name) {
+  for (const TimingTrace& trace : Traces()) {
+    if (strcmp(trace.name, name) == 0) return trace;
+  }
+  abort();
+}
+
+TEST(BtifA2dpSinkPlayoutTest, replay_timing_traces) {
+  for (const TimingTrace& trace : Traces()) {
+    SCOPED_TRACE(trace.name);
+    ReplayResult fixed = Replay(trace, false);
+    ReplayResult adjusted = Replay(trace, true);
+
+    EXPECT_EQ(adjusted.underruns, 0u);
+    EXPECT_EQ(adjusted.overflows, 0u);
+    EXPECT_EQ(adjusted.glitches, 0u);
+    EXPECT_LE(adjusted.underruns, fixed.underruns);
+    EXPECT_LE(adjusted.max_depth_us, fixed.max_depth_us);
+    EXPECT_NEAR(adjusted.drift_ppm, trace.source_ppm, 30);
+    // The buffer ends up at its target depth, give or take a packet
+    EXPECT_NEAR((double)adjusted.final_depth_us,
+                (double)adjusted.final_target_us, 30 * 1000);
+  }
+}
+
+TEST(BtifA2dpSinkPlayoutTest, slow_source_runs_dry_without_compensation) {
+  ReplayResult result = Replay(FindTrace("slow_source"), false);
+  EXPECT_GT(result.underruns, 0u);
+}
+
+TEST(BtifA2dpSinkPlayoutTest, fast_source_builds_latency_without_compensation) {
+  const TimingTrace& trace = FindTrace("fast_source");
+  ReplayResult fixed = Replay(trace, false);
+  ReplayResult adjusted = Replay(trace, true);
+  // 250 ppm over 10 minutes is 150 ms more audio than played out
+  EXPECT_GT(fixed.max_depth_us, adjusted.max_depth_us + 100 * 1000);
+  EXPECT_LT(adjusted.max_depth_us, adjusted.final_target_us + 30 * 1000);
+}
+
+TEST(BtifA2dpSinkPlayoutTest, jitter_sizes_the_buffer) {
+  ReplayResult steady = Replay(FindTrace("fast_source"), true);
+  ReplayResult bursty = Replay(FindTrace("bursty_source"), true);
+  ReplayResult wifi = Replay(FindTrace("wifi_coex"), true);
+  EXPECT_LT(steady.final_target_us, 50 * 1000u);
+  EXPECT_GE(bursty.final_target_us, 80 * 1000u);
+  EXPECT_GE(wifi.final_target_us, 60 * 1000u);
+}
+
+TEST(BtifA2dpSinkPlayoutTest, resamples_packed_24_bit_mono) {
+  ReplayResult result = Replay(FindTrace("slow_source"), true, 1, 24);
+  EXPECT_EQ(result.underruns, 0u);
+  EXPECT_EQ(result.glitches, 0u);
+}
+
+TEST(BtifA2dpSinkPlayoutTest, rtp_timestamp_restart) {
+  // The Source restarts its RTP timestamps half way through
+  TimingTrace trace = FindTrace("slow_source");
+  for (size_t i = trace.packets.size() / 2; i < trace.packets.size(); i++) {
+    trace.packets[i].rtp_timestamp -= 0x40000000;
+  }
+  ReplayResult result = Replay(trace, true);
+  EXPECT_EQ(result.underruns, 0u);
+  EXPECT_EQ(result.glitches, 0u);
+  EXPECT_NEAR(result.drift_ppm, trace.source_ppm, 30);
+}
+
+TEST(BtifA2dpSinkPlayoutTest, flush_buffers_again) {
+  BtifA2dpSinkPlayout playout(DecodeNext, WritePcm);
+  playout.Configure(44100, 2, 16, true);
+  g_harness = Harness();
+  g_harness.playout = &playout;
+
+  uint64_t now_us = 0;
+  uint32_t rtp_timestamp = 0;
+  auto receive = [&]() {
+    uint32_t media_timestamp = playout.OnPacketReceived(rtp_timestamp, now_us);
+    g_harness.queue.push_back({media_timestamp, 0, 896});
+    rtp_timestamp += 896;
+    now_us += 896 * 1000000ULL / 44100;
+  };
+
+  // Two packets of 20 ms reach the smallest target depth
+  receive();
+  playout.OnTick(now_us);
+  EXPECT_FALSE(playout.IsPlaying());
+  receive();
+  playout.OnTick(now_us);
+  EXPECT_TRUE(playout.IsPlaying());
+  EXPECT_GT(g_harness.frames_written, 0u);
+
+  g_harness.queue.clear();
+  playout.Flush();
+  EXPECT_FALSE(playout.IsPlaying());
+  EXPECT_EQ(playout.DepthUs(), 0u);
+  playout.OnTick(now_us += kTickUs);
+  EXPECT_FALSE(playout.IsPlaying());
+  EXPECT_EQ(playout.Underruns(), 0u);
+}
+
+}  // namespace
@@ -0,0 +1,210 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "btif/include/btif_bond_store.h"
+
+#include <ctype.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "btif/include/btif_config_cache.h"
+
+namespace {
+
+const int kCapacity = 3;
+const std::string kBtAddr1 = "11:22:33:44:55:66";
+const std::string kBtAddr2 = "aa:bb:cc:dd:ee:ff";
+const std::string kBtAddr3 = "ab:cd:ef:12:34:56";
+
+std::unique_ptr<config_t> MakeConfig() {
+  auto config = std::make_unique<config_t>();
+  config->sections.push_back(section_t{"Adapter", {}});
+  config->sections.back().Set("Address", "01:02:03:04:05:06");
+  config->sections.push_back(section_t{kBtAddr1, {}});
+  config->sections.back().Set("LinkKey", "00112233445566778899aabbccddeeff");
+  config->sections.back().Set("LinkKeyType", "4");
+  config->sections.back().Set("PinLength", "0");
+  config->sections.back().Set("DevClass", "2360344");
+  config->sections.back().Set("DevType", "3");
+  config->sections.push_back(section_t{kBtAddr2, {}});
+  config->sections.back().Set("LE_KEY_PENC", "encrypted");
+  config->sections.back().Set("LE_KEY_PID", "0A0b");
+  config->sections.back().Set("DevType", "0x2");
+  config->sections.back().Set("AddrType", "not a number");
+  return config;
+}
+
+TEST(BtifBondStoreTest, load_decodes_device_sections) {
+  BtifConfigCache cache(kCapacity);
+  cache.Init(MakeConfig());
+  const BtifBondStore& store = cache.GetBondStore();
+
+  ASSERT_EQ(store.Records().size(), 2u);
+  EXPECT_EQ(store.Records().front().section_name, kBtAddr1);
+  EXPECT_EQ(store.Find("Adapter"), nullptr);
+
+  const BtifBondRecord* record = store.Find(kBtAddr1);
+  ASSERT_NE(record, nullptr);
+  EXPECT_EQ(record->bd_addr.ToString(), kBtAddr1);
+  const BtifBondKey& link_key = record->keys[BTIF_BOND_KEY_LINK_KEY];
+  ASSERT_EQ(link_key.state, BtifBondKey::DECODED);
+  ASSERT_EQ(link_key.value.size(), 16u);
+  EXPECT_EQ(link_key.value[0], 0x00);
+  EXPECT_EQ(link_key.value[1], 0x11);
+  EXPECT_EQ(link_key.value[15], 0xff);
+  EXPECT_EQ(record->link_key_type, 4);
+  EXPECT_EQ(record->pin_length, 0);
+  EXPECT_EQ(record->dev_class, 2360344);
+  EXPECT_EQ(record->dev_type, 3);
+  EXPECT_FALSE(record->addr_type);
+  EXPECT_EQ(record->keys[BTIF_BOND_KEY_LE_PENC].state, BtifBondKey::ABSENT);
+
+  record = store.Find(kBtAddr2);
+  ASSERT_NE(record, nullptr);
+  EXPECT_EQ(record->keys[BTIF_BOND_KEY_LE_PENC].state, BtifBondKey::OPAQUE);
+  EXPECT_EQ(record->keys[BTIF_BOND_KEY_LE_PID].state, BtifBondKey::DECODED);
+  EXPECT_EQ(record->keys[BTIF_BOND_KEY_LE_PID].value,
+            std::vector<uint8_t>({0x0a, 0x0b}));
+  EXPECT_EQ(record->dev_type, 2);
+  EXPECT_FALSE(record->addr_type);
+}
+
+TEST(BtifBondStoreTest, follows_writes_to_paired_sections) {
+  BtifConfigCache cache(kCapacity);
+  cache.Init(MakeConfig());
+  const BtifBondStore& store = cache.GetBondStore();
+
+  cache.SetInt(kBtAddr1, "AddrType", 1);
+  cache.SetString(kBtAddr1, "LinkKey", "ffeeddccbbaa99887766554433221100");
+  const BtifBondRecord* record = store.Find(kBtAddr1);
+  ASSERT_NE(record, nullptr);
+  EXPECT_EQ(record->addr_type, 1);
+  EXPECT_EQ(record->keys[BTIF_BOND_KEY_LINK_KEY].value[0], 0xff);
+
+  cache.RemoveKey(kBtAddr1, "DevClass");
+  EXPECT_FALSE(store.Find(kBtAddr1)->dev_class);
+}
+
+TEST(BtifBondStoreTest, follows_sections_in_and_out_of_paired_list) {
+  BtifConfigCache cache(kCapacity);
+  cache.Init(MakeConfig());
+  const BtifBondStore& store = cache.GetBondStore();
+
+  // Unpaired sections are not in the store until they get a link key
+  cache.SetInt(kBtAddr3, "DevType", 1);
+  EXPECT_EQ(store.Find(kBtAddr3), nullptr);
+  cache.SetString(kBtAddr3, "LinkKey", "0102");
+  const BtifBondRecord* record = store.Find(kBtAddr3);
+  ASSERT_NE(record, nullptr);
+  EXPECT_EQ(record->dev_type, 1);
+  EXPECT_EQ(store.Records().back().section_name, kBtAddr3);
+
+  // Removing the last key moves it back to the unpaired cache
+  cache.RemoveKey(kBtAddr3, "LinkKey");
+  EXPECT_EQ(store.Find(kBtAddr3), nullptr);
+  EXPECT_TRUE(cache.HasUnpairedSection(kBtAddr3));
+
+  cache.SetInt(kBtAddr1, "Restricted", 1);
+  cache.RemovePersistentSectionsWithKey("Restricted");
+  EXPECT_EQ(store.Find(kBtAddr1), nullptr);
+  EXPECT_EQ(store.Records().size(), 1u);
+
+  cache.Clear();
+  EXPECT_TRUE(store.Records().empty());
+}
+
+// What btif_config_get_int() and btif_config_get_bin() return from the
+// strings of the config
+std::optional<std::vector<uint8_t>> DecodeHex(
+    const std::optional<std::string>& value) {
+  if (!value || value->size() % 2 != 0) return std::nullopt;
+  for (char c : *value) {
+    if (!isxdigit(static_cast<unsigned char>(c))) return std::nullopt;
+  }
+  std::vector<uint8_t> bytes;
+  for (size_t i = 0; i < value->size(); i += 2) {
+    bytes.push_back(std::stoul(value->substr(i, 2), nullptr, 16));
+  }
+  return bytes;
+}
+
+/* Random writes and removals over a few devices and keys; after each step the
+ * store must hold a record for every persistent device section, in order,
+ * with the values the string getters decode. */
+TEST(BtifBondStoreTest, equivalent_to_string_getters) {
+  const std::vector<std::string> kSections = {
+      kBtAddr1, kBtAddr2, kBtAddr3, "01:02:03:04:05:06", "Adapter"};
+  const std::vector<std::string> kKeys = {
+      "LinkKey",  "LE_KEY_PENC", "LE_KEY_LID", "LinkKeyType", "PinLength",
+      "DevClass", "DevType",     "AddrType",   "Name"};
+  const std::vector<std::string> kValues = {
+      "0", "12", "0x1f", "-3", "abcd", "0102030405060708", "encrypted", "zz",
+      "", "99999999999"};
+
+  std::mt19937 gen(7);
+  auto pick = [&gen](const std::vector<std::string>& v) {
+    return v[std::uniform_int_distribution<size_t>(0, v.size() - 1)(gen)];
+  };
+
+  BtifConfigCache cache(kCapacity);
+  cache.Init(MakeConfig());
+  for (int step = 0; step < 5000; step++) {
+    std::string section = pick(kSections);
+    std::string key = pick(kKeys);
+    if (std::uniform_int_distribution<int>(0, 3)(gen) == 0) {
+      cache.RemoveKey(section, key);
+    } else {
+      cache.SetString(section, key, pick(kValues));
+    }
+
+    const auto& records = cache.GetBondStore().Records();
+    auto record = records.begin();
+    for (const section_t& persistent : cache.GetPersistentSections()) {
+      if (!RawAddress::IsValidAddress(persistent.name)) continue;
+      ASSERT_NE(record, records.end()) << "step " << step;
+      ASSERT_EQ(record->section_name, persistent.name) << "step " << step;
+
+      const std::string& name = persistent.name;
+      for (int id = 0; id < BTIF_BOND_KEY_COUNT; id++) {
+        const char* key_name = BtifBondStore::KeyName((BtifBondKeyId)id);
+        auto value = cache.GetString(name, key_name);
+        const BtifBondKey& bond_key = record->keys[id];
+        if (!value) {
+          EXPECT_EQ(bond_key.state, BtifBondKey::ABSENT) << "step " << step;
+        } else if (auto bytes = DecodeHex(value)) {
+          EXPECT_EQ(bond_key.state, BtifBondKey::DECODED) << "step " << step;
+          EXPECT_EQ(bond_key.value, *bytes) << "step " << step;
+        } else {
+          EXPECT_EQ(bond_key.state, BtifBondKey::OPAQUE) << "step " << step;
+        }
+      }
+      for (const char* key_name :
+           {"LinkKeyType", "PinLength", "DevClass", "DevType", "AddrType"}) {
+        auto field = BtifBondStore::IntField(key_name);
+        EXPECT_EQ((*record).*field, cache.GetInt(name, key_name))
+            << "step " << step << " " << key_name;
+      }
+      record++;
+    }
+    ASSERT_EQ(record, records.end()) << "step " << step;
+  }
+}
+
+}  // namespace
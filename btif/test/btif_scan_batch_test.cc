@@ -0,0 +1,94 @@
+/*
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "btif/include/btif_scan_batch.h"
+
+namespace {
+
+const RawAddress kAddress1({0xc0, 0x11, 0x22, 0x33, 0x44, 0x01});
+const RawAddress kAddress2({0xc0, 0x11, 0x22, 0x33, 0x44, 0x02});
+
+const std::vector<uint8_t> kData1 = {0x02, 0x01, 0x06};
+const std::vector<uint8_t> kData2 = {0x02, 0x01, 0x04};
+
+BtifScanResult make_result(const RawAddress& addr, int8_t rssi) {
+  BtifScanResult result = {};
+  result.bd_addr = addr;
+  result.addr_type = 1;
+  result.ble_evt_type = 0x13;
+  result.rssi = rssi;
+  return result;
+}
+
+}  // namespace
+
+TEST(BtifScanResultBatchTest, keeps_order) {
+  BtifScanResultBatch batch(4);
+  EXPECT_TRUE(batch.empty());
+  EXPECT_TRUE(batch.Add(make_result(kAddress1, -50), kData1.data(),
+                        kData1.size()));
+  EXPECT_TRUE(batch.Add(make_result(kAddress2, -60), kData1.data(),
+                        kData1.size()));
+
+  std::vector<BtifScanResult> results = batch.Take();
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ(kAddress1, results[0].bd_addr);
+  EXPECT_EQ(kData1, results[0].value);
+  EXPECT_EQ(kAddress2, results[1].bd_addr);
+  EXPECT_TRUE(batch.empty());
+}
+
+TEST(BtifScanResultBatchTest, duplicate_refreshes_rssi) {
+  BtifScanResultBatch batch(4);
+  batch.Add(make_result(kAddress1, -50), kData1.data(), kData1.size());
+  EXPECT_FALSE(batch.Add(make_result(kAddress1, -70), kData1.data(),
+                         kData1.size()));
+
+  std::vector<BtifScanResult> results = batch.Take();
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ(-70, results[0].rssi);
+}
+
+TEST(BtifScanResultBatchTest, new_data_is_not_a_duplicate) {
+  BtifScanResultBatch batch(4);
+  batch.Add(make_result(kAddress1, -50), kData1.data(), kData1.size());
+  EXPECT_TRUE(batch.Add(make_result(kAddress1, -50), kData2.data(),
+                        kData2.size()));
+
+  BtifScanResult scan_response = make_result(kAddress1, -50);
+  scan_response.ble_evt_type = 0x1b;
+  EXPECT_TRUE(batch.Add(scan_response, kData1.data(), kData1.size()));
+  EXPECT_EQ(3u, batch.size());
+}
+
+TEST(BtifScanResultBatchTest, no_data) {
+  BtifScanResultBatch batch(4);
+  EXPECT_TRUE(batch.Add(make_result(kAddress1, -50), nullptr, 0));
+  EXPECT_FALSE(batch.Add(make_result(kAddress1, -50), nullptr, 0));
+  EXPECT_TRUE(batch.Take()[0].value.empty());
+}
+
+TEST(BtifScanResultBatchTest, full) {
+  BtifScanResultBatch batch(2);
+  batch.Add(make_result(kAddress1, -50), kData1.data(), kData1.size());
+  EXPECT_FALSE(batch.full());
+  batch.Add(make_result(kAddress2, -50), kData1.data(), kData1.size());
+  EXPECT_TRUE(batch.full());
+  batch.Take();
+  EXPECT_FALSE(batch.full());
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/a2dp_latency_tracer.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "common/time_util.h"
+
+namespace bluetooth {
+
+namespace common {
+
+namespace {
+
+// More than the TX audio queue, the AV data path, L2CAP and the controller
+// hold together
+constexpr size_t kMaxPacketsInFlight = 64;
+// A packet not completed by then was dropped on the way
+constexpr uint64_t kMaxInFlightUs = 2000000;
+// Packets kept for the trace events, about 20 seconds of SBC
+constexpr size_t kMaxTraceEventPackets = 1024;
+
+const char* const kStageNames[kA2dpLatencyNumStages] = {
+    "encode", "tx queue", "avdtp", "l2cap", "hci", "controller", "total",
+};
+
+double UsToMs(uint64_t us) { return us / 1000.0; }
+
+}  // namespace
+
+const uint64_t A2dpLatencyHistogram::kBucketUpperUs[kA2dpLatencyNumBuckets] = {
+    250,   500,    1000,   2000,   5000,   10000,
+    20000, 50000, 100000, 200000, 500000, UINT64_MAX,
+};
+
+void A2dpLatencyHistogram::Add(uint64_t latency_us) {
+  count++;
+  total_us += latency_us;
+  max_us = std::max(max_us, latency_us);
+  size_t bucket = 0;
+  while (latency_us > kBucketUpperUs[bucket]) bucket++;
+  buckets[bucket]++;
+}
+
+uint64_t A2dpLatencyHistogram::PercentileUs(int percent) const {
+  if (count == 0) return 0;
+  uint64_t rank = (count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kA2dpLatencyNumBuckets; i++) {
+    seen += buckets[i];
+    if (seen >= rank) return std::min(kBucketUpperUs[i], max_us);
+  }
+  return max_us;
+}
+
+A2dpLatencyTracer& A2dpLatencyTracer::GetInstance() {
+  static A2dpLatencyTracer instance(time_get_os_boottime_us);
+  return instance;
+}
+
+A2dpLatencyTracer::A2dpLatencyTracer(Clock clock)
+    : clock_(clock),
+      packets_(kMaxPacketsInFlight),
+      trace_events_enabled_(false) {
+  Reset();
+}
+
+void A2dpLatencyTracer::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_read_us_ = 0;
+  in_flight_ = 0;
+  next_token_ = 1;
+  for (Packet& packet : packets_) packet.active = false;
+  for (A2dpLatencyHistogram& histogram : histograms_) {
+    histogram = A2dpLatencyHistogram();
+  }
+  completed_count_ = 0;
+  lost_count_ = 0;
+  trace_events_.clear();
+  trace_events_next_ = 0;
+}
+
+void A2dpLatencyTracer::SetTraceEventsEnabled(bool enabled) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  trace_events_enabled_ = enabled;
+  if (enabled) {
+    trace_events_.reserve(kMaxTraceEventPackets);
+  } else {
+    trace_events_.clear();
+    trace_events_.shrink_to_fit();
+    trace_events_next_ = 0;
+  }
+}
+
+void A2dpLatencyTracer::OnPcmRead() {
+  if (pending_read_us_.load(std::memory_order_relaxed) != 0) return;
+  pending_read_us_.store(clock_(), std::memory_order_relaxed);
+}
+
+void A2dpLatencyTracer::OnPacketEncoded(const void* buffer) {
+  uint64_t now_us = clock_();
+  uint64_t read_us = pending_read_us_.exchange(0, std::memory_order_relaxed);
+  if (read_us == 0) read_us = now_us;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Packet* slot = nullptr;
+  Packet* oldest = nullptr;
+  for (Packet& packet : packets_) {
+    if (packet.active &&
+        (packet.buffer == buffer ||
+         now_us - packet.hop_us[kHopRead] > kMaxInFlightUs)) {
+      // Dropped on the way: its buffer was even freed and allocated again
+      ReleaseLocked(&packet, true);
+    }
+    if (!packet.active) {
+      if (slot == nullptr) slot = &packet;
+      continue;
+    }
+    if (oldest == nullptr ||
+        packet.hop_us[kHopRead] < oldest->hop_us[kHopRead]) {
+      oldest = &packet;
+    }
+  }
+  if (slot == nullptr) {
+    ReleaseLocked(oldest, true);
+    slot = oldest;
+  }
+
+  *slot = {};
+  slot->active = true;
+  slot->buffer = buffer;
+  slot->token = next_token_++;
+  slot->hop = kHopEncoded;
+  slot->hop_us[kHopRead] = read_us;
+  slot->hop_us[kHopEncoded] = now_us;
+  in_flight_++;
+}
+
+void A2dpLatencyTracer::OnPacketDequeued(const void* buffer) {
+  if (in_flight_.load(std::memory_order_relaxed) == 0) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  StampLocked(buffer, kHopEncoded, kHopDequeued);
+}
+
+void A2dpLatencyTracer::OnAvdtpWrite(const void* buffer) {
+  if (in_flight_.load(std::memory_order_relaxed) == 0) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  StampLocked(buffer, kHopDequeued, kHopAvdtpWrite);
+}
+
+void A2dpLatencyTracer::OnL2capSend(const void* buffer, uint16_t handle,
+                                    uint16_t packets_in_flight) {
+  if (in_flight_.load(std::memory_order_relaxed) == 0) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Packet* packet = FindLocked(buffer, kHopAvdtpWrite);
+  // The next part of a packet sent in segments
+  if (packet == nullptr) packet = FindLocked(buffer, kHopL2capSend);
+  if (packet == nullptr) return;
+  packet->hop = kHopL2capSend;
+  packet->hop_us[kHopL2capSend] = clock_();
+  packet->handle = handle;
+  packet->completions_needed = packets_in_flight;
+}
+
+void A2dpLatencyTracer::OnHciTransmit(const void* buffer) {
+  if (in_flight_.load(std::memory_order_relaxed) == 0) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Packet* packet = FindLocked(buffer, kHopL2capSend);
+  if (packet == nullptr) return;
+  packet->hop = kHopHciTransmit;
+  packet->hop_us[kHopHciTransmit] = clock_();
+  packet->buffer = nullptr;
+}
+
+void A2dpLatencyTracer::OnPacketsCompleted(uint16_t handle,
+                                           uint16_t num_packets) {
+  if (in_flight_.load(std::memory_order_relaxed) == 0) return;
+  uint64_t now_us = clock_();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Packet& packet : packets_) {
+    if (!packet.active || packet.hop < kHopL2capSend ||
+        packet.handle != handle) {
+      continue;
+    }
+    if (packet.completions_needed > num_packets) {
+      packet.completions_needed -= num_packets;
+      continue;
+    }
+    if (packet.hop != kHopHciTransmit) {
+      // Only the segments sent so far, the others are still in L2CAP
+      packet.completions_needed = 0;
+      continue;
+    }
+    packet.hop_us[kHopCompleted] = now_us;
+    CompleteLocked(&packet);
+  }
+}
+
+A2dpLatencyHistogram A2dpLatencyTracer::GetHistogram(
+    A2dpLatencyStage stage) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return histograms_[static_cast<size_t>(stage)];
+}
+
+uint64_t A2dpLatencyTracer::GetCompletedCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return completed_count_;
+}
+
+uint64_t A2dpLatencyTracer::GetLostCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lost_count_;
+}
+
+A2dpLatencyTracer::Packet* A2dpLatencyTracer::FindLocked(const void* buffer,
+                                                          Hop previous) {
+  for (Packet& packet : packets_) {
+    if (packet.active && packet.buffer == buffer && packet.hop == previous) {
+      return &packet;
+    }
+  }
+  return nullptr;
+}
+
+void A2dpLatencyTracer::StampLocked(const void* buffer, Hop previous,
+                                    Hop hop) {
+  Packet* packet = FindLocked(buffer, previous);
+  if (packet == nullptr) return;
+  packet->hop = hop;
+  packet->hop_us[hop] = clock_();
+}
+
+void A2dpLatencyTracer::CompleteLocked(Packet* packet) {
+  packet->hop = kHopCompleted;
+  // Each stage ends on the hop of the same rank
+  for (int hop = kHopEncoded; hop <= kHopCompleted; hop++) {
+    histograms_[hop - 1].Add(packet->hop_us[hop] - packet->hop_us[hop - 1]);
+  }
+  histograms_[static_cast<size_t>(A2dpLatencyStage::kTotal)].Add(
+      packet->hop_us[kHopCompleted] - packet->hop_us[kHopRead]);
+  completed_count_++;
+
+  if (trace_events_enabled_) {
+    if (trace_events_.size() < kMaxTraceEventPackets) {
+      trace_events_.push_back(*packet);
+    } else {
+      trace_events_[trace_events_next_] = *packet;
+      trace_events_next_ = (trace_events_next_ + 1) % kMaxTraceEventPackets;
+    }
+  }
+  ReleaseLocked(packet, false);
+}
+
+void A2dpLatencyTracer::ReleaseLocked(Packet* packet, bool lost) {
+  packet->active = false;
+  in_flight_--;
+  if (lost) lost_count_++;
+}
+
+void A2dpLatencyTracer::Dump(int fd) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  dprintf(fd, "\nA2DP Latency:\n");
+  dprintf(fd,
+          "  Packets (completed/lost/in flight)                      : %" PRIu64
+          " / %" PRIu64 " / %zu\n",
+          completed_count_, lost_count_, in_flight_.load());
+  dprintf(fd,
+          "  Stage latency in ms           count      avg      p50      p95"
+          "      p99      max\n");
+  for (size_t i = 0; i < kA2dpLatencyNumStages; i++) {
+    const A2dpLatencyHistogram& histogram = histograms_[i];
+    dprintf(fd, "    %-20s %12" PRIu64 " %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+            kStageNames[i], histogram.count,
+            histogram.count ? UsToMs(histogram.total_us / histogram.count) : 0,
+            UsToMs(histogram.PercentileUs(50)),
+            UsToMs(histogram.PercentileUs(95)),
+            UsToMs(histogram.PercentileUs(99)), UsToMs(histogram.max_us));
+  }
+
+  dprintf(fd, "  Packets per bucket, up to ms:\n    %-12s", "");
+  for (size_t b = 0; b + 1 < kA2dpLatencyNumBuckets; b++) {
+    dprintf(fd, " %6g", UsToMs(A2dpLatencyHistogram::kBucketUpperUs[b]));
+  }
+  dprintf(fd, " %6s\n", "more");
+  for (size_t i = 0; i < kA2dpLatencyNumStages; i++) {
+    dprintf(fd, "    %-12s", kStageNames[i]);
+    for (size_t b = 0; b < kA2dpLatencyNumBuckets; b++) {
+      dprintf(fd, " %6" PRIu64, histograms_[i].buckets[b]);
+    }
+    dprintf(fd, "\n");
+  }
+
+  if (!trace_events_enabled_) return;
+  dprintf(fd,
+          "  Trace events kept (packets)                             : %zu\n",
+          trace_events_.size());
+  lock.unlock();
+  dprintf(fd, "  Trace events, for Perfetto or chrome://tracing:\n");
+  DumpTraceEvents(fd);
+}
+
+void A2dpLatencyTracer::DumpTraceEvents(int fd) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  dprintf(fd, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  // Oldest first, once the ring wrapped around
+  size_t kept = trace_events_.size();
+  for (size_t i = 0; i < kept; i++) {
+    WriteTraceEvent(fd, trace_events_[(trace_events_next_ + i) % kept],
+                    i == 0);
+  }
+  dprintf(fd, "\n]}\n");
+}
+
+void A2dpLatencyTracer::WriteTraceEvent(int fd, const Packet& packet,
+                                        bool first) {
+  // Nested async slices: one track per packet, with one slice per stage
+  const char* format =
+      "%s\n{\"name\":\"%s\",\"cat\":\"a2dp\",\"ph\":\"%c\",\"id\":%" PRIu32
+      ",\"pid\":1,\"tid\":1,\"ts\":%" PRIu64 "}";
+  dprintf(fd, format, first ? "" : ",", "A2DP packet", 'b', packet.token,
+          packet.hop_us[kHopRead]);
+  for (int hop = kHopEncoded; hop <= kHopCompleted; hop++) {
+    dprintf(fd, format, ",", kStageNames[hop - 1], 'b', packet.token,
+            packet.hop_us[hop - 1]);
+    dprintf(fd, format, ",", kStageNames[hop - 1], 'e', packet.token,
+            packet.hop_us[hop]);
+  }
+  dprintf(fd, format, ",", "A2DP packet", 'e', packet.token,
+          packet.hop_us[kHopCompleted]);
+}
+
+}  // namespace common
+
+}  // namespace bluetooth
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace bluetooth {
+
+namespace common {
+
+// Stages of the A2DP Source path, measured between two hops of a media
+// packet. kTotal goes from the PCM read to the controller completion.
+enum class A2dpLatencyStage {
+  kEncode,      // PCM read to encoded packet
+  kTxQueue,     // waiting in the btif TX audio queue
+  kAvdtp,       // BTA AV data path to the AVDTP media channel write
+  kL2cap,       // waiting for controller buffers in L2CAP
+  kHci,         // L2CAP hand-off to the HCI transport write
+  kController,  // HCI write to the Number Of Completed Packets event
+  kTotal,
+};
+
+constexpr size_t kA2dpLatencyNumStages = 7;
+constexpr size_t kA2dpLatencyNumBuckets = 12;
+
+// Latency histogram of one stage
+struct A2dpLatencyHistogram {
+  // Upper bound of each bucket, the last one being unbounded
+  static const uint64_t kBucketUpperUs[kA2dpLatencyNumBuckets];
+
+  uint64_t count = 0;
+  uint64_t total_us = 0;
+  uint64_t max_us = 0;
+  uint64_t buckets[kA2dpLatencyNumBuckets] = {};
+
+  void Add(uint64_t latency_us);
+  // Upper bound of the bucket holding the |percent| percentile
+  uint64_t PercentileUs(int percent) const;
+};
+
+/**
+ * End-to-end latency tracer of the A2DP Source media packets.
+ *
+ * A packet gets a trace token when the encoder hands it to btif, and each
+ * layer stamps it as the packet goes by. The BT_HDR header has no field left
+ * along this path, so the token is attached to the buffer itself: hops look
+ * their packet up by its BT_HDR address, until the HCI layer frees the buffer
+ * after writing it to the transport. From there the packet is only known by
+ * its position on its ACL link, and the Number Of Completed Packets events of
+ * that link complete it.
+ *
+ * Stage latencies of every completed packet are kept in histograms. When
+ * trace events are enabled, the timestamps of the last packets are also kept
+ * and can be dumped in the Chrome JSON trace event format, which Perfetto and
+ * chrome://tracing load.
+ *
+ * The hops take a short lock and do not allocate; the ones also seen by
+ * unrelated traffic (L2CAP, HCI) return at once while no packet is traced.
+ */
+class A2dpLatencyTracer {
+ public:
+  using Clock = uint64_t (*)();
+
+  static A2dpLatencyTracer& GetInstance();
+
+  // |clock| gives the hop timestamps, in microseconds
+  explicit A2dpLatencyTracer(Clock clock);
+
+  A2dpLatencyTracer(const A2dpLatencyTracer&) = delete;
+  A2dpLatencyTracer& operator=(const A2dpLatencyTracer&) = delete;
+
+  // Drops the packets in flight and clears the histograms
+  void Reset();
+
+  // Keeps the timestamps of the last packets for DumpTraceEvents()
+  void SetTraceEventsEnabled(bool enabled);
+
+  // Encoder thread: PCM was read from the audio HAL. The first read since the
+  // previous packet starts the next packet.
+  void OnPcmRead();
+  // Encoder thread: the packet in |buffer| was encoded and is about to be
+  // queued
+  void OnPacketEncoded(const void* buffer);
+  // |buffer| was taken out of the TX audio queue by the AV data path
+  void OnPacketDequeued(const void* buffer);
+  // |buffer| is written to the AVDTP media channel
+  void OnAvdtpWrite(const void* buffer);
+  // L2CAP hands |buffer| to HCI on the ACL link |handle|, with
+  // |packets_in_flight| packets not completed yet on that link, this one
+  // included. Called again for each part of a packet sent in segments.
+  void OnL2capSend(const void* buffer, uint16_t handle,
+                   uint16_t packets_in_flight);
+  // HCI is writing the last fragment of |buffer| to the transport; the
+  // buffer is freed right after.
+  void OnHciTransmit(const void* buffer);
+  // The controller completed |num_packets| packets of the ACL link |handle|
+  void OnPacketsCompleted(uint16_t handle, uint16_t num_packets);
+
+  A2dpLatencyHistogram GetHistogram(A2dpLatencyStage stage);
+  uint64_t GetCompletedCount();
+  // Packets dropped on the way, or never completed
+  uint64_t GetLostCount();
+
+  // Dumps the stage histograms, and the trace events when enabled
+  void Dump(int fd);
+  // Dumps the packets kept since trace events were enabled, as a JSON object
+  void DumpTraceEvents(int fd);
+
+ private:
+  enum Hop {
+    kHopRead,
+    kHopEncoded,
+    kHopDequeued,
+    kHopAvdtpWrite,
+    kHopL2capSend,
+    kHopHciTransmit,
+    kHopCompleted,
+    kNumHops,
+  };
+
+  struct Packet {
+    bool active;
+    // Buffer of the packet, until HCI freed it
+    const void* buffer;
+    uint32_t token;
+    Hop hop;  // last hop stamped
+    uint16_t handle;
+    uint16_t completions_needed;
+    uint64_t hop_us[kNumHops];
+  };
+
+  // Packet in flight whose buffer is |buffer| and whose last hop is
+  // |previous|, or nullptr
+  Packet* FindLocked(const void* buffer, Hop previous);
+  void StampLocked(const void* buffer, Hop previous, Hop hop);
+  void CompleteLocked(Packet* packet);
+  void ReleaseLocked(Packet* packet, bool lost);
+  void WriteTraceEvent(int fd, const Packet& packet, bool first);
+
+  const Clock clock_;
+  // Start of the packet being encoded, owned by the encoder thread
+  std::atomic<uint64_t> pending_read_us_{0};
+  // Lets the hops shared with other traffic skip the lock
+  std::atomic<size_t> in_flight_{0};
+
+  std::mutex mutex_;
+  uint32_t next_token_;
+  std::vector<Packet> packets_;
+  A2dpLatencyHistogram histograms_[kA2dpLatencyNumStages];
+  uint64_t completed_count_;
+  uint64_t lost_count_;
+  bool trace_events_enabled_;
+  std::vector<Packet> trace_events_;  // ring of the last completed packets
+  size_t trace_events_next_;
+};
+
+}  // namespace common
+
+}  // namespace bluetooth
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "common/a2dp_latency_tracer.h"
+
+using bluetooth::common::A2dpLatencyHistogram;
+using bluetooth::common::A2dpLatencyStage;
+using bluetooth::common::A2dpLatencyTracer;
+
+namespace {
+
+uint64_t fake_now_us;
+
+uint64_t FakeClock() { return fake_now_us; }
+
+constexpr uint16_t kHandle = 0x0002;
+constexpr uint16_t kOtherHandle = 0x0003;
+
+class A2dpLatencyTracerTest : public ::testing::Test {
+ protected:
+  A2dpLatencyTracerTest() : tracer_(FakeClock) { fake_now_us = 1000000; }
+
+  void Advance(uint64_t us) { fake_now_us += us; }
+
+  // Runs |buffer| down to HCI, |us| per hop
+  void SendToHci(const void* buffer, uint64_t us, uint16_t packets_in_flight) {
+    tracer_.OnPcmRead();
+    Advance(us);
+    tracer_.OnPacketEncoded(buffer);
+    Advance(us);
+    tracer_.OnPacketDequeued(buffer);
+    Advance(us);
+    tracer_.OnAvdtpWrite(buffer);
+    Advance(us);
+    tracer_.OnL2capSend(buffer, kHandle, packets_in_flight);
+    Advance(us);
+    tracer_.OnHciTransmit(buffer);
+  }
+
+  uint64_t Total(A2dpLatencyStage stage) {
+    return tracer_.GetHistogram(stage).total_us;
+  }
+
+  std::string DumpToString(bool trace_events) {
+    FILE* file = tmpfile();
+    if (trace_events) {
+      tracer_.DumpTraceEvents(fileno(file));
+    } else {
+      tracer_.Dump(fileno(file));
+    }
+    std::string out;
+    char buffer[4096];
+    rewind(file);
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      out.append(buffer, n);
+    }
+    fclose(file);
+    return out;
+  }
+
+  A2dpLatencyTracer tracer_;
+  int buffers_[4];
+};
+
+size_t Count(const std::string& haystack, const std::string& needle) {
+  size_t count = 0;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + 1)) {
+    count++;
+  }
+  return count;
+}
+
+TEST_F(A2dpLatencyTracerTest, times_each_stage) {
+  tracer_.OnPcmRead();
+  Advance(100);
+  tracer_.OnPcmRead();  // more PCM for the same packet
+  Advance(200);
+  tracer_.OnPacketEncoded(&buffers_[0]);
+  Advance(15000);
+  tracer_.OnPacketDequeued(&buffers_[0]);
+  Advance(50);
+  tracer_.OnAvdtpWrite(&buffers_[0]);
+  Advance(4000);
+  tracer_.OnL2capSend(&buffers_[0], kHandle, 1);
+  Advance(400);
+  tracer_.OnHciTransmit(&buffers_[0]);
+  Advance(7000);
+  tracer_.OnPacketsCompleted(kHandle, 1);
+
+  EXPECT_EQ(tracer_.GetCompletedCount(), 1u);
+  EXPECT_EQ(tracer_.GetLostCount(), 0u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kEncode), 300u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kTxQueue), 15000u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kAvdtp), 50u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kL2cap), 4000u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kHci), 400u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kController), 7000u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kTotal), 26750u);
+
+  A2dpLatencyHistogram total = tracer_.GetHistogram(A2dpLatencyStage::kTotal);
+  EXPECT_EQ(total.count, 1u);
+  EXPECT_EQ(total.buckets[7], 1u);  // up to 50 ms
+  EXPECT_EQ(total.PercentileUs(99), 26750u);
+}
+
+TEST_F(A2dpLatencyTracerTest, completes_after_earlier_packets_of_its_link) {
+  // A packet of another channel is already in flight on the link
+  SendToHci(&buffers_[0], 100, 2);
+  SendToHci(&buffers_[1], 100, 3);
+
+  // Other links do not count
+  tracer_.OnPacketsCompleted(kOtherHandle, 5);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 0u);
+
+  tracer_.OnPacketsCompleted(kHandle, 1);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 0u);
+  Advance(1000);
+  tracer_.OnPacketsCompleted(kHandle, 1);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 1u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kController), 1500u);
+  Advance(1000);
+  tracer_.OnPacketsCompleted(kHandle, 4);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 2u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kController), 1500u + 2000u);
+}
+
+TEST_F(A2dpLatencyTracerTest, packet_sent_in_segments) {
+  tracer_.OnPacketEncoded(&buffers_[0]);
+  tracer_.OnPacketDequeued(&buffers_[0]);
+  tracer_.OnAvdtpWrite(&buffers_[0]);
+  tracer_.OnL2capSend(&buffers_[0], kHandle, 2);
+  Advance(3000);
+  tracer_.OnPacketsCompleted(kHandle, 2);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 0u);
+
+  // The last segments, once the controller had room for them
+  tracer_.OnL2capSend(&buffers_[0], kHandle, 1);
+  tracer_.OnHciTransmit(&buffers_[0]);
+  Advance(2000);
+  tracer_.OnPacketsCompleted(kHandle, 1);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 1u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kL2cap), 3000u);
+  EXPECT_EQ(Total(A2dpLatencyStage::kController), 2000u);
+}
+
+TEST_F(A2dpLatencyTracerTest, ignores_other_buffers_and_hops_out_of_order) {
+  tracer_.OnPacketEncoded(&buffers_[0]);
+  // Other traffic on the lower layers
+  tracer_.OnL2capSend(&buffers_[1], kHandle, 1);
+  tracer_.OnHciTransmit(&buffers_[1]);
+  tracer_.OnPacketsCompleted(kHandle, 1);
+  // Not dequeued yet
+  tracer_.OnAvdtpWrite(&buffers_[0]);
+  tracer_.OnL2capSend(&buffers_[0], kHandle, 1);
+  tracer_.OnPacketsCompleted(kHandle, 1);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 0u);
+
+  tracer_.OnPacketDequeued(&buffers_[0]);
+  tracer_.OnAvdtpWrite(&buffers_[0]);
+  tracer_.OnL2capSend(&buffers_[0], kHandle, 1);
+  tracer_.OnHciTransmit(&buffers_[0]);
+  tracer_.OnPacketsCompleted(kHandle, 1);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 1u);
+}
+
+TEST_F(A2dpLatencyTracerTest, counts_dropped_packets_as_lost) {
+  // Flushed from the TX queue, and its buffer allocated again
+  tracer_.OnPacketEncoded(&buffers_[0]);
+  tracer_.OnPacketEncoded(&buffers_[0]);
+  EXPECT_EQ(tracer_.GetLostCount(), 1u);
+
+  // Never completed
+  SendToHci(&buffers_[1], 100, 1);
+  Advance(3000000);
+  tracer_.OnPacketEncoded(&buffers_[2]);
+  EXPECT_EQ(tracer_.GetLostCount(), 3u);
+
+  // More packets than can be in flight
+  for (int i = 0; i < 100; i++) {
+    Advance(1000);
+    tracer_.OnPacketEncoded(reinterpret_cast<char*>(this) + i);
+  }
+  EXPECT_EQ(tracer_.GetLostCount(), 3u + 37u);
+  EXPECT_EQ(tracer_.GetCompletedCount(), 0u);
+}
+
+TEST_F(A2dpLatencyTracerTest, dumps_histograms_and_trace_events) {
+  EXPECT_EQ(DumpToString(true),
+            "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n]}\n");
+
+  tracer_.SetTraceEventsEnabled(true);
+  for (int i = 0; i < 3; i++) {
+    SendToHci(&buffers_[i], 1000, 1);
+    tracer_.OnPacketsCompleted(kHandle, 1);
+  }
+
+  std::string dump = DumpToString(false);
+  EXPECT_NE(dump.find("Packets (completed/lost/in flight)"), std::string::npos);
+  EXPECT_NE(dump.find("controller"), std::string::npos);
+  EXPECT_NE(dump.find("Trace events kept (packets)"), std::string::npos);
+  EXPECT_NE(dump.find("\"traceEvents\""), std::string::npos);
+
+  std::string events = DumpToString(true);
+  EXPECT_EQ(Count(events, "\"ph\":\"b\""), 3u * 7u);
+  EXPECT_EQ(Count(events, "\"ph\":\"e\""), 3u * 7u);
+  EXPECT_EQ(Count(events, "\"name\":\"A2DP packet\""), 3u * 2u);
+  EXPECT_NE(events.find("\"name\":\"tx queue\""), std::string::npos);
+  EXPECT_EQ(events.find("[\n{\"name\":\"A2DP packet\""), events.find('['));
+
+  tracer_.SetTraceEventsEnabled(false);
+  EXPECT_EQ(DumpToString(false).find("Trace events"), std::string::npos);
+}
+
+}  // namespace
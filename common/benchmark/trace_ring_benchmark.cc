@@ -0,0 +1,142 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the cost of a stack trace call site formatting its message with
+// vsnprintf, as LogMsg() does before handing it to the platform logger, with
+// recording it in binary form into the calling thread's trace ring. The
+// vsnprintf numbers are a lower bound of the synchronous path since they leave
+// out the logger itself.
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <atomic>
+
+#include "common/trace_ring.h"
+
+using ::benchmark::State;
+using bluetooth::common::FormattedTrace;
+using bluetooth::common::TraceRecorder;
+
+namespace {
+
+constexpr size_t kSlotsPerThread = 512;
+constexpr const char* kAddress = "aa:bb:cc:dd:ee:ff";
+
+std::atomic<uint64_t> g_delivered{0};
+
+void FormatLikeLogMsg(uint32_t trace_set_mask, const char* fmt, ...) {
+  char buffer[256];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buffer, sizeof(buffer) - 12, fmt, ap);
+  va_end(ap);
+  benchmark::DoNotOptimize(buffer);
+  benchmark::DoNotOptimize(trace_set_mask);
+}
+
+void RecordTrace(TraceRecorder* recorder, uint32_t trace_set_mask,
+                 const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  recorder->Record(trace_set_mask, fmt, ap);
+  va_end(ap);
+}
+
+// Argument is the kind of call site: 0 integers only, 1 with a function name
+// and an address string, 2 with a double and padded fields
+template <typename Trace>
+void TraceCallSites(State& state, Trace trace) {
+  uint64_t i = 0;
+  switch (state.range(0)) {
+    case 0:
+      for (auto _ : state) {
+        trace(0x100, "L2CAP - rcv L2CAP conn req CID: 0x%x handle 0x%04x psm %d",
+              0x40, 0x0b, static_cast<int>(i++));
+      }
+      break;
+    case 1:
+      for (auto _ : state) {
+        trace(0x100, "%s: bd_addr=%s, hci_status=0x%02x, link_key_type=%u",
+              __func__, kAddress, static_cast<int>(i++ & 0xff), 4u);
+      }
+      break;
+    default:
+      for (auto _ : state) {
+        trace(0x100, "%s: [%-12s] tx %8lu bytes, %.2f kbps, q=%*d", __func__,
+              "a2dp_source", static_cast<unsigned long>(i++), 328.5, 4, 3);
+      }
+      break;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Shared by every benchmark thread, each recording into its own ring
+TraceRecorder* GetRecorder() {
+  static TraceRecorder* recorder = [] {
+    auto* recorder = new TraceRecorder(
+        kSlotsPerThread, [](const FormattedTrace& trace) {
+          benchmark::DoNotOptimize(trace.message.data());
+          g_delivered++;
+        });
+    recorder->Start();
+    return recorder;
+  }();
+  return recorder;
+}
+
+class BM_TraceRing : public ::benchmark::Fixture {};
+
+BENCHMARK_DEFINE_F(BM_TraceRing, vsnprintf)(State& state) {
+  TraceCallSites(state, [](uint32_t mask, const char* fmt, auto... args) {
+    FormatLikeLogMsg(mask, fmt, args...);
+  });
+}
+
+BENCHMARK_DEFINE_F(BM_TraceRing, binary_record)(State& state) {
+  TraceCallSites(state, [](uint32_t mask, const char* fmt, auto... args) {
+    RecordTrace(GetRecorder(), mask, fmt, args...);
+  });
+}
+
+BENCHMARK_REGISTER_F(BM_TraceRing, vsnprintf)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Threads(1)
+    ->Threads(4);
+BENCHMARK_REGISTER_F(BM_TraceRing, binary_record)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Threads(1)
+    ->Threads(4);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,663 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common/trace_ring.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+
+#include "common/time_util.h"
+
+namespace bluetooth {
+
+namespace common {
+
+namespace {
+
+// Size of one ring slot, sequence number included
+constexpr size_t kSlotSize = 256;
+// Arguments a format string may take and still be recorded in binary form
+constexpr size_t kMaxArgs = 16;
+// Longest conversion specification ("%-08.3lld") that can be replayed
+constexpr size_t kMaxSpecLength = 31;
+// Format strings whose layout each thread remembers
+constexpr size_t kSignatureCacheSize = 256;
+constexpr uint64_t kNullString = UINT64_MAX;
+constexpr auto kDrainPeriod = std::chrono::milliseconds(50);
+
+enum ArgType : uint8_t {
+  kInt,
+  kLong,
+  kLongLong,
+  kSizeT,
+  kIntMax,
+  kPtrDiff,
+  kPointer,
+  kDouble,
+  kString,
+};
+
+enum LengthModifier { kNone, kChar, kShort, kL, kLL, kJ, kZ, kT, kLongDoubleL };
+
+struct Conversion {
+  const char* end;
+  bool supported;
+  // false for "%%"
+  bool has_arg;
+  // number of '*' width and precision arguments preceding the value
+  uint8_t stars;
+  ArgType type;
+};
+
+// Parse the conversion specification starting at |p|, which points just
+// after the '%'. Anything the formatter cannot replay from a binary record
+// (positional or wide arguments, long double, %n, %m, "%.*s" on a buffer
+// that may not be terminated) is reported as unsupported.
+Conversion ParseConversion(const char* start, const char* p) {
+  Conversion conv = {p, true, true, 0, kInt};
+  while (*p != '\0' && strchr("-+ #0'", *p) != nullptr) p++;
+  if (*p == '*') {
+    conv.stars++;
+    p++;
+  } else {
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '$') conv.supported = false;
+  }
+  bool precision = false;
+  if (*p == '.') {
+    precision = true;
+    p++;
+    if (*p == '*') {
+      conv.stars++;
+      p++;
+    } else {
+      while (*p >= '0' && *p <= '9') p++;
+    }
+  }
+
+  LengthModifier length = kNone;
+  switch (*p) {
+    case 'h':
+      length = (p[1] == 'h') ? kChar : kShort;
+      p += (length == kChar) ? 2 : 1;
+      break;
+    case 'l':
+      length = (p[1] == 'l') ? kLL : kL;
+      p += (length == kLL) ? 2 : 1;
+      break;
+    case 'q':
+      length = kLL;
+      p++;
+      break;
+    case 'j':
+      length = kJ;
+      p++;
+      break;
+    case 'z':
+      length = kZ;
+      p++;
+      break;
+    case 't':
+      length = kT;
+      p++;
+      break;
+    case 'L':
+      length = kLongDoubleL;
+      p++;
+      break;
+  }
+
+  const char c = *p;
+  if (c == '\0') {
+    conv.end = p;
+    conv.supported = false;
+    return conv;
+  }
+  conv.end = p + 1;
+  if (static_cast<size_t>(conv.end - start) > kMaxSpecLength) {
+    conv.supported = false;
+  }
+
+  switch (c) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      switch (length) {
+        case kL:
+          conv.type = kLong;
+          break;
+        case kLL:
+          conv.type = kLongLong;
+          break;
+        case kJ:
+          conv.type = kIntMax;
+          break;
+        case kZ:
+          conv.type = kSizeT;
+          break;
+        case kT:
+          conv.type = kPtrDiff;
+          break;
+        case kLongDoubleL:
+          conv.supported = false;
+          break;
+        default:
+          conv.type = kInt;
+          break;
+      }
+      break;
+    case 'c':
+      conv.type = kInt;
+      if (length != kNone) conv.supported = false;
+      break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      conv.type = kDouble;
+      if (length == kLongDoubleL) conv.supported = false;
+      break;
+    case 's':
+      conv.type = kString;
+      if (length != kNone || precision) conv.supported = false;
+      break;
+    case 'p':
+      conv.type = kPointer;
+      break;
+    case '%':
+      conv.has_arg = false;
+      if (conv.end - start != 2) conv.supported = false;
+      break;
+    default:
+      conv.supported = false;
+      break;
+  }
+  return conv;
+}
+
+struct Signature {
+  const char* fmt;
+  bool supported;
+  uint8_t num_args;
+  ArgType types[kMaxArgs];
+};
+
+Signature ParseSignature(const char* fmt) {
+  Signature sig = {fmt, true, 0, {}};
+  for (const char* p = fmt; *p != '\0';) {
+    if (*p++ != '%') continue;
+    Conversion conv = ParseConversion(p - 1, p);
+    p = conv.end;
+    size_t num_args = sig.num_args + conv.stars + (conv.has_arg ? 1 : 0);
+    if (!conv.supported || num_args > kMaxArgs) {
+      sig.supported = false;
+      return sig;
+    }
+    for (int i = 0; i < conv.stars; i++) sig.types[sig.num_args++] = kInt;
+    if (conv.has_arg) sig.types[sig.num_args++] = conv.type;
+  }
+  return sig;
+}
+
+}  // namespace
+
+// Header and payload of one trace. When |fmt| is null, |payload| holds the
+// already formatted message. Otherwise it starts with |num_args| 64-bit
+// argument values, followed by the bytes of the copied string arguments; a
+// string argument value is its payload offset in the high half and its length
+// in the low half.
+struct TraceRecord {
+  uint64_t timestamp_us;
+  const char* fmt;
+  uint32_t trace_set_mask;
+  uint16_t payload_used;
+  uint8_t num_args;
+  alignas(8) uint8_t payload[kSlotSize - 4 * sizeof(uint64_t)];
+};
+
+class TraceRing {
+ public:
+  TraceRing(size_t slots, int thread_id)
+      : thread_id_(thread_id), slots_(new Slot[slots]), mask_(slots - 1) {
+    for (auto& entry : signatures_) entry.fmt = nullptr;
+  }
+
+  int thread_id() const { return thread_id_; }
+  size_t capacity() const { return mask_ + 1; }
+  uint64_t head() const { return head_.load(std::memory_order_acquire); }
+
+  // Producer only: the record is published by EndWrite()
+  TraceRecord* BeginWrite() {
+    uint64_t index = head_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[index & mask_];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return &slot.record;
+  }
+
+  void EndWrite() {
+    uint64_t index = head_.load(std::memory_order_relaxed);
+    slots_[index & mask_].seq.store(2 * index + 2, std::memory_order_release);
+    head_.store(index + 1, std::memory_order_release);
+  }
+
+  // Any thread: copy record |index|, returns false if it was not written yet
+  // or was overwritten before or during the copy.
+  bool Read(uint64_t index, TraceRecord* out) const {
+    const Slot& slot = slots_[index & mask_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * index + 2) return false;
+    memcpy(out, &slot.record, sizeof(TraceRecord));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+  }
+
+  // Producer only
+  const Signature& LookupSignature(const char* fmt) {
+    Signature& entry = signatures_[(reinterpret_cast<uintptr_t>(fmt) >> 3) %
+                                   kSignatureCacheSize];
+    if (entry.fmt != fmt) entry = ParseSignature(fmt);
+    return entry;
+  }
+
+  // Next record to send to the sink, guarded by the recorder drain mutex
+  uint64_t drained = 0;
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    TraceRecord record;
+  };
+  static_assert(sizeof(Slot) == kSlotSize, "trace slot size");
+
+  const int thread_id_;
+  std::unique_ptr<Slot[]> slots_;
+  const size_t mask_;
+  std::atomic<uint64_t> head_{0};
+  Signature signatures_[kSignatureCacheSize];
+};
+
+namespace {
+
+std::atomic<uint64_t> next_recorder_id{1};
+
+struct ThreadRing {
+  uint64_t recorder_id;
+  std::shared_ptr<TraceRing> ring;
+};
+thread_local std::vector<ThreadRing> thread_rings;
+
+// Copy the arguments described by |sig| into |record|, false if the strings
+// do not fit in the payload.
+bool CaptureArgs(const Signature& sig, TraceRecord* record, va_list args) {
+  size_t used = sig.num_args * sizeof(uint64_t);
+  if (used > sizeof(record->payload)) return false;
+  uint8_t* payload = record->payload;
+  for (int i = 0; i < sig.num_args; i++) {
+    uint64_t value = 0;
+    switch (sig.types[i]) {
+      case kInt:
+        value = static_cast<uint64_t>(va_arg(args, int));
+        break;
+      case kLong:
+        value = static_cast<uint64_t>(va_arg(args, long));
+        break;
+      case kLongLong:
+        value = static_cast<uint64_t>(va_arg(args, long long));
+        break;
+      case kSizeT:
+        value = static_cast<uint64_t>(va_arg(args, size_t));
+        break;
+      case kIntMax:
+        value = static_cast<uint64_t>(va_arg(args, intmax_t));
+        break;
+      case kPtrDiff:
+        value = static_cast<uint64_t>(va_arg(args, ptrdiff_t));
+        break;
+      case kPointer:
+        value = reinterpret_cast<uintptr_t>(va_arg(args, void*));
+        break;
+      case kDouble: {
+        double d = va_arg(args, double);
+        memcpy(&value, &d, sizeof(value));
+        break;
+      }
+      case kString: {
+        const char* s = va_arg(args, const char*);
+        if (s == nullptr) {
+          value = kNullString;
+          break;
+        }
+        size_t room = sizeof(record->payload) - used;
+        size_t length = strnlen(s, room);
+        if (length == room) return false;
+        memcpy(payload + used, s, length);
+        value = (static_cast<uint64_t>(used) << 32) | length;
+        used += length;
+        break;
+      }
+    }
+    memcpy(payload + i * sizeof(uint64_t), &value, sizeof(value));
+  }
+  record->num_args = sig.num_args;
+  record->payload_used = used;
+  return true;
+}
+
+template <typename T>
+int FormatArg(char* out, size_t size, const char* spec, const int* stars,
+              int num_stars, T value) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  switch (num_stars) {
+    case 0:
+      return snprintf(out, size, spec, value);
+    case 1:
+      return snprintf(out, size, spec, stars[0], value);
+    default:
+      return snprintf(out, size, spec, stars[0], stars[1], value);
+  }
+#pragma GCC diagnostic pop
+}
+
+std::string FormatRecord(const TraceRecord& record) {
+  if (record.fmt == nullptr) {
+    const char* text = reinterpret_cast<const char*>(record.payload);
+    return std::string(text, strnlen(text, sizeof(record.payload)));
+  }
+
+  std::string message;
+  const uint8_t* payload = record.payload;
+  int arg = 0;
+  auto next_value = [&]() {
+    uint64_t value = 0;
+    if (arg < record.num_args) {
+      memcpy(&value, payload + arg * sizeof(uint64_t), sizeof(value));
+    }
+    arg++;
+    return value;
+  };
+
+  for (const char* p = record.fmt; *p != '\0';) {
+    const char* literal = p;
+    while (*p != '\0' && *p != '%') p++;
+    message.append(literal, p - literal);
+    if (*p == '\0') break;
+
+    const char* start = p++;
+    Conversion conv = ParseConversion(start, p);
+    p = conv.end;
+    if (!conv.has_arg) {
+      message.push_back('%');
+      continue;
+    }
+
+    char spec[kMaxSpecLength + 1];
+    size_t spec_length = conv.end - start;
+    memcpy(spec, start, spec_length);
+    spec[spec_length] = '\0';
+    int stars[2] = {};
+    for (int i = 0; i < conv.stars; i++) {
+      stars[i] = static_cast<int>(next_value());
+    }
+    uint64_t value = next_value();
+
+    char out[512];
+    int length = 0;
+    switch (conv.type) {
+      case kInt:
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                           static_cast<int>(value));
+        break;
+      case kLong:
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                           static_cast<long>(value));
+        break;
+      case kLongLong:
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                           static_cast<long long>(value));
+        break;
+      case kSizeT:
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                           static_cast<size_t>(value));
+        break;
+      case kIntMax:
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                           static_cast<intmax_t>(value));
+        break;
+      case kPtrDiff:
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                           static_cast<ptrdiff_t>(value));
+        break;
+      case kPointer:
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                           reinterpret_cast<void*>(value));
+        break;
+      case kDouble: {
+        double d;
+        memcpy(&d, &value, sizeof(d));
+        length = FormatArg(out, sizeof(out), spec, stars, conv.stars, d);
+        break;
+      }
+      case kString: {
+        if (value == kNullString) {
+          length = FormatArg(out, sizeof(out), spec, stars, conv.stars,
+                             static_cast<const char*>(nullptr));
+          break;
+        }
+        std::string s(reinterpret_cast<const char*>(payload + (value >> 32)),
+                      static_cast<size_t>(value & 0xffffffff));
+        length =
+            FormatArg(out, sizeof(out), spec, stars, conv.stars, s.c_str());
+        break;
+      }
+    }
+    if (length > 0) {
+      message.append(out, std::min(static_cast<size_t>(length),
+                                   sizeof(out) - 1));
+    }
+  }
+  return message;
+}
+
+}  // namespace
+
+TraceRecorder::TraceRecorder(size_t slots_per_thread, Sink sink)
+    : id_(next_recorder_id++),
+      slots_per_thread_(
+          slots_per_thread <= 1
+              ? 1
+              : size_t{1} << (64 - __builtin_clzll(slots_per_thread - 1))),
+      sink_(std::move(sink)) {}
+
+TraceRecorder::~TraceRecorder() { Stop(); }
+
+void TraceRecorder::Start() {
+  std::lock_guard<std::mutex> lock(wake_mutex_);
+  if (running_) return;
+  running_ = true;
+  drain_thread_ = std::thread(&TraceRecorder::DrainLoop, this);
+}
+
+void TraceRecorder::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    if (!running_) return;
+    running_ = false;
+  }
+  wake_.notify_one();
+  drain_thread_.join();
+  DrainRings();
+}
+
+TraceRing* TraceRecorder::GetThreadRing() {
+  for (auto& entry : thread_rings) {
+    if (entry.recorder_id == id_) return entry.ring.get();
+  }
+  auto ring = std::make_shared<TraceRing>(
+      slots_per_thread_, static_cast<int>(syscall(SYS_gettid)));
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.push_back(ring);
+  }
+  thread_rings.push_back({id_, ring});
+  return ring.get();
+}
+
+void TraceRecorder::Record(uint32_t trace_set_mask, const char* fmt,
+                           va_list args) {
+  TraceRing* ring = GetThreadRing();
+  const Signature& sig = ring->LookupSignature(fmt);
+
+  TraceRecord* record = ring->BeginWrite();
+  record->timestamp_us = time_get_os_boottime_us();
+  record->trace_set_mask = trace_set_mask;
+  record->fmt = fmt;
+
+  va_list copy;
+  va_copy(copy, args);
+  if (!sig.supported || !CaptureArgs(sig, record, copy)) {
+    char* text = reinterpret_cast<char*>(record->payload);
+    vsnprintf(text, sizeof(record->payload), fmt, args);
+    record->fmt = nullptr;
+    record->num_args = 0;
+    record->payload_used = strlen(text) + 1;
+  }
+  va_end(copy);
+  ring->EndWrite();
+}
+
+void TraceRecorder::Wake() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_pending_ = true;
+  }
+  wake_.notify_one();
+}
+
+void TraceRecorder::Flush() { DrainRings(); }
+
+std::vector<std::shared_ptr<TraceRing>> TraceRecorder::SnapshotRings() {
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  return rings_;
+}
+
+void TraceRecorder::DrainLoop() {
+  std::unique_lock<std::mutex> lock(wake_mutex_);
+  while (running_) {
+    wake_.wait_for(lock, kDrainPeriod,
+                   [this] { return wake_pending_ || !running_; });
+    wake_pending_ = false;
+    lock.unlock();
+    DrainRings();
+    lock.lock();
+  }
+}
+
+void TraceRecorder::DrainRings() {
+  std::lock_guard<std::mutex> lock(drain_mutex_);
+  TraceRecord record;
+  for (const auto& ring : SnapshotRings()) {
+    uint64_t head = ring->head();
+    if (head - ring->drained > ring->capacity()) {
+      dropped_count_ += head - ring->capacity() - ring->drained;
+      ring->drained = head - ring->capacity();
+    }
+    for (; ring->drained < head; ring->drained++) {
+      if (!ring->Read(ring->drained, &record)) {
+        dropped_count_++;
+        continue;
+      }
+      if (sink_) {
+        sink_({record.timestamp_us, record.trace_set_mask, ring->thread_id(),
+               FormatRecord(record)});
+      }
+    }
+  }
+
+  // Release the rings of threads that exited once they have been drained
+  std::lock_guard<std::mutex> rings_lock(rings_mutex_);
+  for (auto it = rings_.begin(); it != rings_.end();) {
+    if (it->use_count() == 1 && (*it)->drained == (*it)->head()) {
+      retired_count_ += (*it)->head();
+      it = rings_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::vector<FormattedTrace> TraceRecorder::Recent(uint64_t window_us) {
+  uint64_t now_us = time_get_os_boottime_us();
+  uint64_t since_us = now_us > window_us ? now_us - window_us : 0;
+
+  std::vector<FormattedTrace> traces;
+  TraceRecord record;
+  for (const auto& ring : SnapshotRings()) {
+    uint64_t head = ring->head();
+    uint64_t first = head > ring->capacity() ? head - ring->capacity() : 0;
+    for (uint64_t index = first; index < head; index++) {
+      if (!ring->Read(index, &record) || record.timestamp_us < since_us) {
+        continue;
+      }
+      traces.push_back({record.timestamp_us, record.trace_set_mask,
+                        ring->thread_id(), FormatRecord(record)});
+    }
+  }
+  std::stable_sort(traces.begin(), traces.end(),
+                   [](const FormattedTrace& a, const FormattedTrace& b) {
+                     return a.timestamp_us < b.timestamp_us;
+                   });
+  return traces;
+}
+
+void TraceRecorder::Dump(int fd, uint64_t window_us) {
+  dprintf(fd, "  Records: %" PRIu64 "\n", GetRecordCount());
+  dprintf(fd, "  Dropped before reaching logcat: %" PRIu64 "\n",
+          GetDroppedCount());
+  dprintf(fd, "  Last %" PRIu64 " ms:\n", window_us / 1000);
+  for (const auto& trace : Recent(window_us)) {
+    dprintf(fd, "    %" PRIu64 ".%06" PRIu64 " %5d %08x %s\n",
+            trace.timestamp_us / 1000000, trace.timestamp_us % 1000000,
+            trace.thread_id, trace.trace_set_mask, trace.message.c_str());
+  }
+}
+
+uint64_t TraceRecorder::GetRecordCount() {
+  uint64_t count = retired_count_;
+  for (const auto& ring : SnapshotRings()) count += ring->head();
+  return count;
+}
+
+uint64_t TraceRecorder::GetDroppedCount() { return dropped_count_; }
+
+}  // namespace common
+
+}  // namespace bluetooth
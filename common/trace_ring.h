@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdarg.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bluetooth {
+
+namespace common {
+
+class TraceRing;
+
+// A trace message rebuilt from its binary record.
+struct FormattedTrace {
+  uint64_t timestamp_us;
+  uint32_t trace_set_mask;
+  int thread_id;
+  std::string message;
+};
+
+/**
+ * Deferred printf-style trace recorder.
+ *
+ * Record() does not format anything: it stores the address of the format
+ * string, which serves as a static format id, together with the raw
+ * arguments into a ring owned by the calling thread. The argument layout of
+ * each format string is parsed once and cached per thread. String arguments
+ * are copied into the record since their storage is not expected to outlive
+ * the call. A record that does not fit, or whose format uses a conversion
+ * that cannot be replayed, is formatted eagerly instead.
+ *
+ * Each ring has a single producer and is never blocked: when the consumer
+ * falls behind, the oldest records are overwritten and counted as dropped.
+ * A background thread drains the rings into the sink; Recent() re-reads the
+ * rings without consuming them, so the last seconds of traces stay
+ * available for dumpsys even after they were sent to the sink.
+ */
+class TraceRecorder {
+ public:
+  // Receives each drained record, in order within a thread.
+  using Sink = std::function<void(const FormattedTrace& trace)>;
+
+  /**
+   * @param slots_per_thread ring size of each recording thread, rounded up
+   *        to a power of two
+   * @param sink where the background thread sends formatted records
+   */
+  TraceRecorder(size_t slots_per_thread, Sink sink);
+  ~TraceRecorder();
+
+  TraceRecorder(const TraceRecorder&) = delete;
+  TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+  // Start the background drain thread
+  void Start();
+
+  // Stop the background drain thread after a last drain
+  void Stop();
+
+  // Record a trace from the calling thread. Never blocks.
+  void Record(uint32_t trace_set_mask, const char* fmt, va_list args);
+
+  // Ask the drain thread to run now instead of at its next period
+  void Wake();
+
+  // Send every pending record to the sink from the calling thread
+  void Flush();
+
+  // Records still held by the rings that are at most |window_us| old,
+  // formatted and ordered by timestamp across threads
+  std::vector<FormattedTrace> Recent(uint64_t window_us);
+
+  // Write Recent(|window_us|) and the recorder counters to |fd|
+  void Dump(int fd, uint64_t window_us);
+
+  // Records written so far
+  uint64_t GetRecordCount();
+
+  // Records overwritten before they reached the sink
+  uint64_t GetDroppedCount();
+
+ private:
+  TraceRing* GetThreadRing();
+  void DrainLoop();
+  void DrainRings();
+  std::vector<std::shared_ptr<TraceRing>> SnapshotRings();
+
+  const uint64_t id_;
+  const size_t slots_per_thread_;
+  Sink sink_;
+
+  std::mutex rings_mutex_;
+  std::vector<std::shared_ptr<TraceRing>> rings_;
+
+  // Serializes drains of the rings into the sink
+  std::mutex drain_mutex_;
+  std::atomic<uint64_t> dropped_count_{0};
+  // Records of the rings released after their thread exited
+  std::atomic<uint64_t> retired_count_{0};
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool wake_pending_ = false;
+  bool running_ = false;
+  std::thread drain_thread_;
+};
+
+}  // namespace common
+
+}  // namespace bluetooth
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <climits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/trace_ring.h"
+
+using bluetooth::common::FormattedTrace;
+using bluetooth::common::TraceRecorder;
+
+namespace {
+
+void RecordTo(TraceRecorder* recorder, uint32_t mask, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  recorder->Record(mask, fmt, ap);
+  va_end(ap);
+}
+
+class TraceRecorderTest : public ::testing::Test {
+ protected:
+  TraceRecorderTest()
+      : recorder_(64, [this](const FormattedTrace& trace) {
+          traces_.push_back(trace);
+        }) {}
+
+  template <typename... Args>
+  void Record(uint32_t mask, const char* fmt, Args... args) {
+    RecordTo(&recorder_, mask, fmt, args...);
+  }
+
+  // What LogMsg printed before the deferred path existed
+  static std::string Printf(const char* fmt, ...) {
+    char buffer[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, ap);
+    va_end(ap);
+    return buffer;
+  }
+
+  std::vector<FormattedTrace> traces_;
+  TraceRecorder recorder_;
+};
+
+#define EXPECT_REPLAYED(fmt, ...)                               \
+  do {                                                          \
+    traces_.clear();                                            \
+    Record(1, fmt, ##__VA_ARGS__);                              \
+    recorder_.Flush();                                          \
+    ASSERT_EQ(traces_.size(), 1u);                              \
+    EXPECT_EQ(traces_[0].message, Printf(fmt, ##__VA_ARGS__));  \
+  } while (0)
+
+TEST_F(TraceRecorderTest, replays_conversions_like_printf) {
+  EXPECT_REPLAYED("no arguments");
+  EXPECT_REPLAYED("%d %i %u %x %X %o %c", -5, 7, 4000000000u, 0xbeef, 0xbeef,
+                  8, 'z');
+  EXPECT_REPLAYED("%hhu %hd %lu %lld %" PRIu64 " %zu %jd %td",
+                  static_cast<unsigned char>(250), static_cast<short>(-3),
+                  ULONG_MAX, LLONG_MIN, UINT64_MAX, sizeof(int),
+                  static_cast<intmax_t>(-1), static_cast<ptrdiff_t>(-2));
+  EXPECT_REPLAYED("%s: handle 0x%04x, %d%% done", __func__, 0x41, 50);
+  EXPECT_REPLAYED("[%-8s] [%8s] [%*d] [%-*.*f]", "left", "right", 6, 42, 9, 2,
+                  3.14159);
+  EXPECT_REPLAYED("%f %e %g %a", 1.5, -2.25e10, 0.0001, 8.0);
+  EXPECT_REPLAYED("%p %p", reinterpret_cast<void*>(0x1234), nullptr);
+  EXPECT_REPLAYED("%s|%s", static_cast<const char*>(nullptr), "");
+}
+
+TEST_F(TraceRecorderTest, unsupported_formats_are_formatted_eagerly) {
+  EXPECT_REPLAYED("%.*s", 3, "abcdef");
+  EXPECT_REPLAYED("%2$s %1$s", "world", "hello");
+  EXPECT_REPLAYED("%Lf", static_cast<long double>(1.25));
+  EXPECT_REPLAYED("%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d", 1, 2,
+                  3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17);
+}
+
+TEST_F(TraceRecorderTest, strings_are_copied_when_recorded) {
+  char name[] = "before";
+  Record(1, "name %s", name);
+  strcpy(name, "after!");
+  recorder_.Flush();
+  ASSERT_EQ(traces_.size(), 1u);
+  EXPECT_EQ(traces_[0].message, "name before");
+}
+
+TEST_F(TraceRecorderTest, long_strings_are_truncated_not_lost) {
+  std::string big(1000, 'x');
+  Record(1, "%s end", big.c_str());
+  recorder_.Flush();
+  ASSERT_EQ(traces_.size(), 1u);
+  EXPECT_EQ(traces_[0].message.substr(0, 100), big.substr(0, 100));
+  EXPECT_GT(traces_[0].message.size(), 200u);
+}
+
+TEST_F(TraceRecorderTest, keeps_mask_and_order) {
+  for (int i = 0; i < 10; i++) Record(0x100 + i, "trace %d", i);
+  recorder_.Flush();
+  ASSERT_EQ(traces_.size(), 10u);
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(traces_[i].trace_set_mask, 0x100u + i);
+    EXPECT_EQ(traces_[i].message, "trace " + std::to_string(i));
+  }
+  EXPECT_EQ(recorder_.GetRecordCount(), 10u);
+  EXPECT_EQ(recorder_.GetDroppedCount(), 0u);
+
+  // Drained records are not sent twice
+  recorder_.Flush();
+  EXPECT_EQ(traces_.size(), 10u);
+}
+
+TEST_F(TraceRecorderTest, overwrites_oldest_when_not_drained) {
+  for (int i = 0; i < 100; i++) Record(1, "trace %d", i);
+  recorder_.Flush();
+  ASSERT_EQ(traces_.size(), 64u);
+  EXPECT_EQ(traces_.front().message, "trace 36");
+  EXPECT_EQ(traces_.back().message, "trace 99");
+  EXPECT_EQ(recorder_.GetDroppedCount(), 36u);
+}
+
+TEST_F(TraceRecorderTest, recent_keeps_drained_records) {
+  Record(1, "first %s", "trace");
+  Record(2, "second %d", 2);
+  recorder_.Flush();
+
+  auto recent = recorder_.Recent(60 * 1000000);
+  ASSERT_EQ(recent.size(), 2u);
+  EXPECT_EQ(recent[0].message, "first trace");
+  EXPECT_EQ(recent[1].message, "second 2");
+  EXPECT_LE(recent[0].timestamp_us, recent[1].timestamp_us);
+}
+
+TEST_F(TraceRecorderTest, threads_record_into_their_own_rings) {
+  constexpr int kThreads = 4;
+  constexpr int kRecords = 50;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([this, t] {
+      for (int i = 0; i < kRecords; i++) Record(t, "thread %d trace %d", t, i);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  recorder_.Flush();
+
+  ASSERT_EQ(traces_.size(), static_cast<size_t>(kThreads * kRecords));
+  std::vector<int> next(kThreads, 0);
+  for (const auto& trace : traces_) {
+    int t = trace.trace_set_mask;
+    EXPECT_EQ(trace.message, "thread " + std::to_string(t) + " trace " +
+                                 std::to_string(next[t]++));
+  }
+  // The rings of the exited threads are released once drained
+  EXPECT_EQ(recorder_.GetRecordCount(),
+            static_cast<uint64_t>(kThreads * kRecords));
+  EXPECT_TRUE(recorder_.Recent(60 * 1000000).empty());
+}
+
+TEST(TraceRecorderDrainTest, drain_thread_delivers_without_flush) {
+  std::atomic<int> delivered{0};
+  TraceRecorder recorder(
+      64, [&delivered](const FormattedTrace&) { delivered++; });
+  recorder.Start();
+  RecordTo(&recorder, 1, "background %d", 1);
+  recorder.Wake();
+  for (int i = 0; i < 100 && delivered == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(delivered, 1);
+  recorder.Stop();
+  EXPECT_EQ(delivered, 1);
+}
+
+}  // namespace
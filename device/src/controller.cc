@@ -21,16 +21,28 @@
 #include "device/include/controller.h"
 
 #include <base/logging.h>
+#include <base/strings/stringprintf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
 
 #include "bt_target.h"
 #include "bt_types.h"
 #include "btcore/include/event_mask.h"
 #include "btcore/include/module.h"
 #include "btcore/include/version.h"
+#include "common/time_util.h"
 #include "hcimsgs.h"
 #include "main/shim/controller.h"
 #include "main/shim/shim.h"
 #include "osi/include/future.h"
+#include "osi/include/log.h"
+#include "osi/include/osi.h"
+#include "osi/include/properties.h"
 #include "stack/include/btm_ble_api.h"
 
 const bt_event_mask_t BLE_EVENT_MASK = {{0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
@@ -54,235 +66,603 @@ const uint8_t SCO_HOST_BUFFER_SIZE = 0xff;
 #define BLE_SUPPORTED_FEATURES_SIZE 8
 #define MAX_LOCAL_SUPPORTED_CODECS_SIZE 8
 
+// Most commands sent at once during start up: the largest batch is the
+// background validation of a snapshot, up to 12 reads on an LE controller
+#define MAX_BATCH_COMMANDS 16
+#define MAX_STARTUP_STEPS 32
+
+// The capabilities read at start up can be persisted and reused on the next
+// start up, the controller being re-read in the background.
+#define PROPERTY_CONTROLLER_SNAPSHOT "persist.bluetooth.controller_snapshot"
+#define CONTROLLER_SNAPSHOT_PATH "/data/misc/bluedroid/bt_controller.snapshot"
+// "BTC" followed by the format version
+#define CONTROLLER_SNAPSHOT_MAGIC 0x42544301
+
+// Everything the controller reports about itself during start up. It only
+// changes with the controller firmware.
+typedef struct {
+  RawAddress address;
+  bt_version_t bt_version;
+
+  uint8_t supported_commands[HCI_SUPPORTED_COMMANDS_ARRAY_SIZE];
+  bt_device_features_t features_classic[MAX_FEATURES_CLASSIC_PAGE_COUNT];
+  uint8_t last_features_classic_page_index;
+
+  uint16_t acl_data_size_classic;
+  uint16_t acl_data_size_ble;
+  uint16_t acl_buffer_count_classic;
+  uint8_t acl_buffer_count_ble;
+
+  uint8_t ble_white_list_size;
+  uint8_t ble_resolving_list_max_size;
+  uint8_t ble_supported_states[BLE_SUPPORTED_STATES_SIZE];
+  bt_device_features_t features_ble;
+  uint16_t ble_suggested_default_data_length;
+  uint16_t ble_supported_max_tx_octets;
+  uint16_t ble_supported_max_tx_time;
+  uint16_t ble_supported_max_rx_octets;
+  uint16_t ble_supported_max_rx_time;
+
+  uint16_t ble_maxium_advertising_data_length;
+  uint8_t ble_number_of_supported_advertising_sets;
+  uint8_t local_supported_codecs[MAX_LOCAL_SUPPORTED_CODECS_SIZE];
+  uint8_t number_of_local_supported_codecs;
+} controller_capabilities_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t size;
+  controller_capabilities_t capabilities;
+} controller_snapshot_t;
+
+typedef void (*capability_parser_t)(BT_HDR* response,
+                                    controller_capabilities_t* caps);
+
+typedef struct {
+  const char* name;
+  BT_HDR* command;
+  capability_parser_t parse;
+} startup_command_t;
+
+typedef struct {
+  startup_command_t commands[MAX_BATCH_COMMANDS];
+  size_t count;
+} startup_batch_t;
+
+typedef struct {
+  const char* name;
+  uint64_t done_us;  // since the start of start_up()
+} startup_step_t;
+
 static const hci_t* local_hci;
 static const hci_packet_factory_t* packet_factory;
 static const hci_packet_parser_t* packet_parser;
 
-static RawAddress address;
-static bt_version_t bt_version;
-
-static uint8_t supported_commands[HCI_SUPPORTED_COMMANDS_ARRAY_SIZE];
-static bt_device_features_t features_classic[MAX_FEATURES_CLASSIC_PAGE_COUNT];
-static uint8_t last_features_classic_page_index;
-
-static uint16_t acl_data_size_classic;
-static uint16_t acl_data_size_ble;
-static uint16_t acl_buffer_count_classic;
-static uint8_t acl_buffer_count_ble;
-
-static uint8_t ble_white_list_size;
-static uint8_t ble_resolving_list_max_size;
-static uint8_t ble_supported_states[BLE_SUPPORTED_STATES_SIZE];
-static bt_device_features_t features_ble;
-static uint16_t ble_suggested_default_data_length;
-static uint16_t ble_supported_max_tx_octets;
-static uint16_t ble_supported_max_tx_time;
-static uint16_t ble_supported_max_rx_octets;
-static uint16_t ble_supported_max_rx_time;
-
-static uint16_t ble_maxium_advertising_data_length;
-static uint8_t ble_number_of_supported_advertising_sets;
-static uint8_t local_supported_codecs[MAX_LOCAL_SUPPORTED_CODECS_SIZE];
-static uint8_t number_of_local_supported_codecs = 0;
+static controller_capabilities_t capabilities;
 
 static bool readable;
 static bool ble_supported;
 static bool simple_pairing_supported;
 static bool secure_connections_supported;
 
-#define AWAIT_COMMAND(command) \
-  static_cast<BT_HDR*>(        \
-      future_await(local_hci->transmit_command_futured(command)))
+static const char* snapshot_path;
+static bool started_from_snapshot;
 
-// Module lifecycle functions
+// After a start up from snapshot, the capabilities are read again in the
+// background and compared to the snapshot.
+static controller_capabilities_t snapshot_capabilities;
+static controller_capabilities_t validation;
+static int validation_pending;
 
-static future_t* start_up(void) {
-  BT_HDR* response;
+static uint64_t startup_start_us;
+static startup_step_t startup_steps[MAX_STARTUP_STEPS];
+static size_t startup_step_count;
 
-  // Send the initial reset command
-  response = AWAIT_COMMAND(packet_factory->make_reset());
-  packet_parser->parse_generic_command_complete(response);
+// Start up trace
 
-  // Request the classic buffer size next
-  response = AWAIT_COMMAND(packet_factory->make_read_buffer_size());
-  packet_parser->parse_read_buffer_size_response(
-      response, &acl_data_size_classic, &acl_buffer_count_classic);
+static void startup_trace_begin(void) {
+  startup_start_us = bluetooth::common::time_get_os_boottime_us();
+  startup_step_count = 0;
+}
 
-  // Tell the controller about our buffer sizes and buffer counts next
-  // TODO(zachoverflow): factor this out. eww l2cap contamination. And why just
-  // a hardcoded 10?
-  response = AWAIT_COMMAND(packet_factory->make_host_buffer_size(
-      L2CAP_MTU_SIZE, SCO_HOST_BUFFER_SIZE, L2CAP_HOST_FC_ACL_BUFS, 10));
+static void startup_trace_step(const char* name) {
+  if (startup_step_count == MAX_STARTUP_STEPS) return;
+  startup_steps[startup_step_count].name = name;
+  startup_steps[startup_step_count].done_us =
+      bluetooth::common::time_get_os_boottime_us() - startup_start_us;
+  startup_step_count++;
+}
+
+static void startup_trace_end(void) {
+  std::string steps;
+  for (size_t i = 0; i < startup_step_count; i++) {
+    steps += base::StringPrintf(" %s=%" PRIu64, startup_steps[i].name,
+                                startup_steps[i].done_us);
+  }
+  LOG_INFO(LOG_TAG, "%s: controller started in %" PRIu64 " us%s, steps (us):%s",
+           __func__,
+           bluetooth::common::time_get_os_boottime_us() - startup_start_us,
+           started_from_snapshot ? " from snapshot" : "", steps.c_str());
+}
+
+// Response parsers
 
+static void parse_generic(BT_HDR* response,
+                          UNUSED_ATTR controller_capabilities_t* caps) {
   packet_parser->parse_generic_command_complete(response);
+}
 
-  // Read the local version info off the controller next, including
-  // information such as manufacturer and supported HCI version
-  response = AWAIT_COMMAND(packet_factory->make_read_local_version_info());
-  packet_parser->parse_read_local_version_info_response(response, &bt_version);
+static void parse_read_buffer_size(BT_HDR* response,
+                                   controller_capabilities_t* caps) {
+  packet_parser->parse_read_buffer_size_response(
+      response, &caps->acl_data_size_classic, &caps->acl_buffer_count_classic);
+}
 
-  // Read the bluetooth address off the controller next
-  response = AWAIT_COMMAND(packet_factory->make_read_bd_addr());
-  packet_parser->parse_read_bd_addr_response(response, &address);
+static void parse_read_local_version_info(BT_HDR* response,
+                                          controller_capabilities_t* caps) {
+  packet_parser->parse_read_local_version_info_response(response,
+                                                        &caps->bt_version);
+}
 
-  // Request the controller's supported commands next
-  response =
-      AWAIT_COMMAND(packet_factory->make_read_local_supported_commands());
+static void parse_read_bd_addr(BT_HDR* response,
+                               controller_capabilities_t* caps) {
+  packet_parser->parse_read_bd_addr_response(response, &caps->address);
+}
+
+static void parse_read_local_supported_commands(
+    BT_HDR* response, controller_capabilities_t* caps) {
   packet_parser->parse_read_local_supported_commands_response(
-      response, supported_commands, HCI_SUPPORTED_COMMANDS_ARRAY_SIZE);
+      response, caps->supported_commands, HCI_SUPPORTED_COMMANDS_ARRAY_SIZE);
 #if (BTM_SCO_ENHANCED_SYNC_ENABLED == FALSE)
-  supported_commands[29] &= ~0x08;
+  caps->supported_commands[29] &= ~0x08;
 #endif
+}
 
-  // Read page 0 of the controller features next
-  uint8_t page_number = 0;
-  response = AWAIT_COMMAND(
-      packet_factory->make_read_local_extended_features(page_number));
+static void parse_read_local_extended_features(
+    BT_HDR* response, controller_capabilities_t* caps) {
+  uint8_t page_number;
   packet_parser->parse_read_local_extended_features_response(
-      response, &page_number, &last_features_classic_page_index,
-      features_classic, MAX_FEATURES_CLASSIC_PAGE_COUNT);
+      response, &page_number, &caps->last_features_classic_page_index,
+      caps->features_classic, MAX_FEATURES_CLASSIC_PAGE_COUNT);
 
-  CHECK(page_number == 0);
-  page_number++;
+  // If we modify the BT_HOST_SUPPORT, we will need ext. feat. page 1
+  if (page_number == 0 &&
+      HCI_LE_SPT_SUPPORTED(caps->features_classic[0].as_array) &&
+      caps->last_features_classic_page_index < 1)
+    caps->last_features_classic_page_index = 1;
+}
 
-  // Inform the controller what page 0 features we support, based on what
-  // it told us it supports. We need to do this first before we request the
-  // next page, because the controller's response for page 1 may be
-  // dependent on what we configure from page 0
-  simple_pairing_supported =
-      HCI_SIMPLE_PAIRING_SUPPORTED(features_classic[0].as_array);
+static void parse_ble_read_white_list_size(BT_HDR* response,
+                                           controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_white_list_size_response(
+      response, &caps->ble_white_list_size);
+}
+
+static void parse_ble_read_buffer_size(BT_HDR* response,
+                                       controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_buffer_size_response(
+      response, &caps->acl_data_size_ble, &caps->acl_buffer_count_ble);
+
+  // Response of 0 indicates ble has the same buffer size as classic
+  if (caps->acl_data_size_ble == 0)
+    caps->acl_data_size_ble = caps->acl_data_size_classic;
+}
+
+static void parse_ble_read_supported_states(BT_HDR* response,
+                                            controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_supported_states_response(
+      response, caps->ble_supported_states, sizeof(caps->ble_supported_states));
+}
+
+static void parse_ble_read_local_supported_features(
+    BT_HDR* response, controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_local_supported_features_response(
+      response, &caps->features_ble);
+}
+
+static void parse_ble_read_resolving_list_size(
+    BT_HDR* response, controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_resolving_list_size_response(
+      response, &caps->ble_resolving_list_max_size);
+}
+
+static void parse_ble_read_maximum_data_length(
+    BT_HDR* response, controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_maximum_data_length_response(
+      response, &caps->ble_supported_max_tx_octets,
+      &caps->ble_supported_max_tx_time, &caps->ble_supported_max_rx_octets,
+      &caps->ble_supported_max_rx_time);
+}
+
+static void parse_ble_read_suggested_default_data_length(
+    BT_HDR* response, controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_suggested_default_data_length_response(
+      response, &caps->ble_suggested_default_data_length);
+}
+
+static void parse_ble_read_maximum_advertising_data_length(
+    BT_HDR* response, controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_maximum_advertising_data_length(
+      response, &caps->ble_maxium_advertising_data_length);
+}
+
+static void parse_ble_read_number_of_supported_advertising_sets(
+    BT_HDR* response, controller_capabilities_t* caps) {
+  packet_parser->parse_ble_read_number_of_supported_advertising_sets(
+      response, &caps->ble_number_of_supported_advertising_sets);
+}
+
+static void parse_read_local_supported_codecs(BT_HDR* response,
+                                              controller_capabilities_t* caps) {
+  packet_parser->parse_read_local_supported_codecs_response(
+      response, &caps->number_of_local_supported_codecs,
+      caps->local_supported_codecs);
+}
+
+// Command batches
+//
+// The commands of a batch do not depend on each other: they are all queued to
+// the HCI layer at once, which sends them as fast as the command credits of
+// the controller allow. Only the commands depending on the results of a batch
+// wait for it to complete.
+
+static void batch_add(startup_batch_t* batch, const char* name,
+                      BT_HDR* command, capability_parser_t parse) {
+  CHECK(batch->count < MAX_BATCH_COMMANDS);
+  startup_command_t* entry = &batch->commands[batch->count++];
+  entry->name = name;
+  entry->command = command;
+  entry->parse = parse;
+}
+
+static void run_batch(const startup_batch_t* batch,
+                      controller_capabilities_t* caps) {
+  future_t* futures[MAX_BATCH_COMMANDS];
+  for (size_t i = 0; i < batch->count; i++)
+    futures[i] =
+        local_hci->transmit_command_futured(batch->commands[i].command);
+
+  for (size_t i = 0; i < batch->count; i++) {
+    BT_HDR* response = static_cast<BT_HDR*>(future_await(futures[i]));
+    batch->commands[i].parse(response, caps);
+    startup_trace_step(batch->commands[i].name);
+  }
+}
+
+// Adds the commands reading the classic features pages from |first_page| on
+static void add_read_feature_pages(startup_batch_t* batch,
+                                   const controller_capabilities_t* caps,
+                                   uint8_t first_page) {
+  static const char* names[MAX_FEATURES_CLASSIC_PAGE_COUNT] = {
+      "read_features_page_0", "read_features_page_1", "read_features_page_2"};
+  for (uint8_t page = first_page;
+       page <= caps->last_features_classic_page_index &&
+       page < MAX_FEATURES_CLASSIC_PAGE_COUNT;
+       page++) {
+    batch_add(batch, names[page],
+              packet_factory->make_read_local_extended_features(page),
+              parse_read_local_extended_features);
+  }
+}
+
+// Adds the LE reads that only depend on LE being supported
+static void add_ble_reads(startup_batch_t* batch) {
+  batch_add(batch, "ble_read_white_list_size",
+            packet_factory->make_ble_read_white_list_size(),
+            parse_ble_read_white_list_size);
+  batch_add(batch, "ble_read_buffer_size",
+            packet_factory->make_ble_read_buffer_size(),
+            parse_ble_read_buffer_size);
+  batch_add(batch, "ble_read_supported_states",
+            packet_factory->make_ble_read_supported_states(),
+            parse_ble_read_supported_states);
+  batch_add(batch, "ble_read_local_supported_features",
+            packet_factory->make_ble_read_local_supported_features(),
+            parse_ble_read_local_supported_features);
+}
+
+// Adds the LE reads that depend on the LE features
+static void add_ble_feature_reads(startup_batch_t* batch,
+                                  const controller_capabilities_t* caps) {
+  if (HCI_LE_ENHANCED_PRIVACY_SUPPORTED(caps->features_ble.as_array)) {
+    batch_add(batch, "ble_read_resolving_list_size",
+              packet_factory->make_ble_read_resolving_list_size(),
+              parse_ble_read_resolving_list_size);
+  }
+
+  if (HCI_LE_DATA_LEN_EXT_SUPPORTED(caps->features_ble.as_array)) {
+    batch_add(batch, "ble_read_maximum_data_length",
+              packet_factory->make_ble_read_maximum_data_length(),
+              parse_ble_read_maximum_data_length);
+    batch_add(batch, "ble_read_suggested_default_data_length",
+              packet_factory->make_ble_read_suggested_default_data_length(),
+              parse_ble_read_suggested_default_data_length);
+  }
+
+  if (HCI_LE_EXTENDED_ADVERTISING_SUPPORTED(caps->features_ble.as_array)) {
+    batch_add(batch, "ble_read_maximum_advertising_data_length",
+              packet_factory->make_ble_read_maximum_advertising_data_length(),
+              parse_ble_read_maximum_advertising_data_length);
+    batch_add(
+        batch, "ble_read_number_of_supported_advertising_sets",
+        packet_factory->make_ble_read_number_of_supported_advertising_sets(),
+        parse_ble_read_number_of_supported_advertising_sets);
+  }
+}
+
+static void add_read_local_supported_codecs(
+    startup_batch_t* batch, const controller_capabilities_t* caps) {
+  if (HCI_READ_LOCAL_CODECS_SUPPORTED(caps->supported_commands)) {
+    batch_add(batch, "read_local_supported_codecs",
+              packet_factory->make_read_local_supported_codecs(),
+              parse_read_local_supported_codecs);
+  }
+}
+
+// Tells the controller what page 0 features we support, based on what it told
+// us it supports. This must be done before reading page 1, as the controller's
+// response for page 1 may be dependent on it.
+static void add_host_support_writes(startup_batch_t* batch) {
   if (simple_pairing_supported) {
-    response = AWAIT_COMMAND(
-        packet_factory->make_write_simple_pairing_mode(HCI_SP_MODE_ENABLED));
-    packet_parser->parse_generic_command_complete(response);
+    batch_add(
+        batch, "write_simple_pairing_mode",
+        packet_factory->make_write_simple_pairing_mode(HCI_SP_MODE_ENABLED),
+        parse_generic);
   }
 
-  if (HCI_LE_SPT_SUPPORTED(features_classic[0].as_array)) {
+  if (HCI_LE_SPT_SUPPORTED(capabilities.features_classic[0].as_array)) {
     uint8_t simultaneous_le_host =
-        HCI_SIMUL_LE_BREDR_SUPPORTED(features_classic[0].as_array)
+        HCI_SIMUL_LE_BREDR_SUPPORTED(capabilities.features_classic[0].as_array)
             ? BTM_BLE_SIMULTANEOUS_HOST
             : 0;
-    response = AWAIT_COMMAND(packet_factory->make_ble_write_host_support(
-        BTM_BLE_HOST_SUPPORT, simultaneous_le_host));
+    batch_add(batch, "ble_write_host_support",
+              packet_factory->make_ble_write_host_support(
+                  BTM_BLE_HOST_SUPPORT, simultaneous_le_host),
+              parse_generic);
+  }
+}
 
-    packet_parser->parse_generic_command_complete(response);
+// The writes depending on the features pages 1 and 2
+static void add_feature_writes(startup_batch_t* batch) {
+#if (SC_MODE_INCLUDED == TRUE)
+  if (secure_connections_supported) {
+    batch_add(batch, "write_secure_connections_host_support",
+              packet_factory->make_write_secure_connections_host_support(
+                  HCI_SC_MODE_ENABLED),
+              parse_generic);
+  }
+#endif
 
-    // If we modified the BT_HOST_SUPPORT, we will need ext. feat. page 1
-    if (last_features_classic_page_index < 1)
-      last_features_classic_page_index = 1;
+  if (ble_supported) {
+    batch_add(batch, "ble_set_event_mask",
+              packet_factory->make_ble_set_event_mask(&BLE_EVENT_MASK),
+              parse_generic);
   }
 
-  // Done telling the controller about what page 0 features we support
-  // Request the remaining feature pages
-  while (page_number <= last_features_classic_page_index &&
-         page_number < MAX_FEATURES_CLASSIC_PAGE_COUNT) {
-    response = AWAIT_COMMAND(
-        packet_factory->make_read_local_extended_features(page_number));
-    packet_parser->parse_read_local_extended_features_response(
-        response, &page_number, &last_features_classic_page_index,
-        features_classic, MAX_FEATURES_CLASSIC_PAGE_COUNT);
-
-    page_number++;
+  if (simple_pairing_supported) {
+    batch_add(batch, "set_event_mask",
+              packet_factory->make_set_event_mask(&CLASSIC_EVENT_MASK),
+              parse_generic);
   }
+}
 
+static void update_feature_flags(void) {
+  simple_pairing_supported =
+      HCI_SIMPLE_PAIRING_SUPPORTED(capabilities.features_classic[0].as_array);
 #if (SC_MODE_INCLUDED == TRUE)
   secure_connections_supported =
-      HCI_SC_CTRLR_SUPPORTED(features_classic[2].as_array);
-  if (secure_connections_supported) {
-    response = AWAIT_COMMAND(
-        packet_factory->make_write_secure_connections_host_support(
-            HCI_SC_MODE_ENABLED));
-    packet_parser->parse_generic_command_complete(response);
-  }
+      HCI_SC_CTRLR_SUPPORTED(capabilities.features_classic[2].as_array);
 #endif
+  ble_supported =
+      capabilities.last_features_classic_page_index >= 1 &&
+      HCI_LE_HOST_SUPPORTED(capabilities.features_classic[1].as_array);
+}
+
+// Capability snapshot
+
+static bool snapshot_load(controller_snapshot_t* snapshot) {
+  int fd;
+  OSI_NO_INTR(fd = open(snapshot_path, O_RDONLY | O_CLOEXEC));
+  if (fd < 0) return false;
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = read(fd, snapshot, sizeof(*snapshot)));
+  close(fd);
+
+  return ret == (ssize_t)sizeof(*snapshot) &&
+         snapshot->magic == CONTROLLER_SNAPSHOT_MAGIC &&
+         snapshot->size == sizeof(snapshot->capabilities);
+}
+
+static void snapshot_save(const controller_capabilities_t* caps) {
+  controller_snapshot_t snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));
+  snapshot.magic = CONTROLLER_SNAPSHOT_MAGIC;
+  snapshot.size = sizeof(snapshot.capabilities);
+  memcpy(&snapshot.capabilities, caps, sizeof(snapshot.capabilities));
+
+  // Write a temporary file and rename it over the snapshot, so that it is
+  // never seen partially written
+  std::string temp_path = std::string(snapshot_path) + ".new";
+  int fd;
+  OSI_NO_INTR(fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC |
+                                               O_CLOEXEC,
+                        S_IRUSR | S_IWUSR));
+  if (fd < 0) {
+    LOG_ERROR(LOG_TAG, "%s: unable to open %s: %s", __func__,
+              temp_path.c_str(), strerror(errno));
+    return;
+  }
 
-  ble_supported = last_features_classic_page_index >= 1 &&
-                  HCI_LE_HOST_SUPPORTED(features_classic[1].as_array);
-  if (ble_supported) {
-    // Request the ble white list size next
-    response = AWAIT_COMMAND(packet_factory->make_ble_read_white_list_size());
-    packet_parser->parse_ble_read_white_list_size_response(
-        response, &ble_white_list_size);
-
-    // Request the ble buffer size next
-    response = AWAIT_COMMAND(packet_factory->make_ble_read_buffer_size());
-    packet_parser->parse_ble_read_buffer_size_response(
-        response, &acl_data_size_ble, &acl_buffer_count_ble);
-
-    // Response of 0 indicates ble has the same buffer size as classic
-    if (acl_data_size_ble == 0) acl_data_size_ble = acl_data_size_classic;
-
-    // Request the ble supported states next
-    response = AWAIT_COMMAND(packet_factory->make_ble_read_supported_states());
-    packet_parser->parse_ble_read_supported_states_response(
-        response, ble_supported_states, sizeof(ble_supported_states));
-
-    // Request the ble supported features next
-    response =
-        AWAIT_COMMAND(packet_factory->make_ble_read_local_supported_features());
-    packet_parser->parse_ble_read_local_supported_features_response(
-        response, &features_ble);
-
-    if (HCI_LE_ENHANCED_PRIVACY_SUPPORTED(features_ble.as_array)) {
-      response =
-          AWAIT_COMMAND(packet_factory->make_ble_read_resolving_list_size());
-      packet_parser->parse_ble_read_resolving_list_size_response(
-          response, &ble_resolving_list_max_size);
-    }
+  ssize_t ret;
+  OSI_NO_INTR(ret = write(fd, &snapshot, sizeof(snapshot)));
+  bool written = ret == (ssize_t)sizeof(snapshot) && fsync(fd) == 0;
+  close(fd);
 
-    if (HCI_LE_DATA_LEN_EXT_SUPPORTED(features_ble.as_array)) {
-      response =
-          AWAIT_COMMAND(packet_factory->make_ble_read_maximum_data_length());
-      packet_parser->parse_ble_read_maximum_data_length_response(
-          response, &ble_supported_max_tx_octets, &ble_supported_max_tx_time,
-          &ble_supported_max_rx_octets, &ble_supported_max_rx_time);
-
-      response = AWAIT_COMMAND(
-          packet_factory->make_ble_read_suggested_default_data_length());
-      packet_parser->parse_ble_read_suggested_default_data_length_response(
-          response, &ble_suggested_default_data_length);
-    }
+  if (!written || rename(temp_path.c_str(), snapshot_path) != 0) {
+    LOG_ERROR(LOG_TAG, "%s: unable to write %s: %s", __func__, snapshot_path,
+              strerror(errno));
+    unlink(temp_path.c_str());
+  }
+}
 
-    if (HCI_LE_EXTENDED_ADVERTISING_SUPPORTED(features_ble.as_array)) {
-      response = AWAIT_COMMAND(
-          packet_factory->make_ble_read_maximum_advertising_data_length());
-      packet_parser->parse_ble_read_maximum_advertising_data_length(
-          response, &ble_maxium_advertising_data_length);
-
-      response = AWAIT_COMMAND(
-          packet_factory->make_ble_read_number_of_supported_advertising_sets());
-      packet_parser->parse_ble_read_number_of_supported_advertising_sets(
-          response, &ble_number_of_supported_advertising_sets);
-    } else {
-      /* If LE Excended Advertising is not supported, use the default value */
-      ble_maxium_advertising_data_length = 31;
-    }
+// The snapshot applies to the controller if it has the same identity, and
+// reports the same values for what was read before the snapshot was loaded.
+static bool snapshot_matches(const controller_capabilities_t* snapshot,
+                             const controller_capabilities_t* caps) {
+  return snapshot->address == caps->address &&
+         !memcmp(&snapshot->bt_version, &caps->bt_version,
+                 sizeof(caps->bt_version)) &&
+         snapshot->acl_data_size_classic == caps->acl_data_size_classic &&
+         snapshot->acl_buffer_count_classic == caps->acl_buffer_count_classic &&
+         !memcmp(snapshot->supported_commands, caps->supported_commands,
+                 sizeof(caps->supported_commands)) &&
+         !memcmp(&snapshot->features_classic[0], &caps->features_classic[0],
+                 sizeof(caps->features_classic[0]));
+}
+
+static void validation_complete(void) {
+  if (!memcmp(&validation, &snapshot_capabilities, sizeof(validation))) {
+    LOG_INFO(LOG_TAG, "%s: controller capability snapshot is up to date",
+             __func__);
+    return;
+  }
 
-    // Set the ble event mask next
-    response =
-        AWAIT_COMMAND(packet_factory->make_ble_set_event_mask(&BLE_EVENT_MASK));
-    packet_parser->parse_generic_command_complete(response);
+  // The stack is already running with the snapshot values, drop the snapshot
+  // so that the next start up reads the controller.
+  LOG_ERROR(LOG_TAG,
+            "%s: controller capabilities differ from the snapshot, "
+            "discarding it",
+            __func__);
+  unlink(snapshot_path);
+}
+
+static void validation_command_complete(BT_HDR* response, void* context) {
+  capability_parser_t parse = reinterpret_cast<capability_parser_t>(context);
+  parse(response, &validation);
+  if (--validation_pending == 0) validation_complete();
+}
+
+// Reads the capabilities taken from the snapshot again, without waiting for
+// the responses. They are compared to the snapshot once all are received.
+static void validation_start(void) {
+  startup_batch_t batch;
+  batch.count = 0;
+
+  // What was read before loading the snapshot is already known to match
+  memcpy(&validation, &snapshot_capabilities, sizeof(validation));
+  memset(validation.features_classic + 1, 0,
+         sizeof(validation.features_classic) -
+             sizeof(validation.features_classic[0]));
+  add_read_feature_pages(&batch, &snapshot_capabilities, 1);
+  if (ble_supported) {
+    add_ble_reads(&batch);
+    add_ble_feature_reads(&batch, &snapshot_capabilities);
+  }
+  add_read_local_supported_codecs(&batch, &snapshot_capabilities);
+  if (batch.count == 0) return;
+
+  validation_pending = batch.count;
+  for (size_t i = 0; i < batch.count; i++) {
+    local_hci->transmit_command(
+        batch.commands[i].command, validation_command_complete, NULL,
+        reinterpret_cast<void*>(batch.commands[i].parse));
   }
+}
 
-  if (simple_pairing_supported) {
-    response =
-        AWAIT_COMMAND(packet_factory->make_set_event_mask(&CLASSIC_EVENT_MASK));
-    packet_parser->parse_generic_command_complete(response);
+// Module lifecycle functions
+
+static future_t* start_up(void) {
+  startup_batch_t batch;
+  controller_snapshot_t snapshot;
+
+  startup_trace_begin();
+  memset(&capabilities, 0, sizeof(capabilities));
+  started_from_snapshot = false;
+
+  // Send the initial reset command
+  batch.count = 0;
+  batch_add(&batch, "reset", packet_factory->make_reset(), parse_generic);
+  run_batch(&batch, &capabilities);
+
+  // Read the controller identity, its buffers, supported commands and
+  // page 0 of its features, and tell it about our buffer sizes.
+  // TODO(zachoverflow): factor this out. eww l2cap contamination. And why just
+  // a hardcoded 10?
+  batch.count = 0;
+  batch_add(&batch, "read_local_version_info",
+            packet_factory->make_read_local_version_info(),
+            parse_read_local_version_info);
+  batch_add(&batch, "read_bd_addr", packet_factory->make_read_bd_addr(),
+            parse_read_bd_addr);
+  batch_add(&batch, "read_buffer_size",
+            packet_factory->make_read_buffer_size(), parse_read_buffer_size);
+  batch_add(&batch, "host_buffer_size",
+            packet_factory->make_host_buffer_size(
+                L2CAP_MTU_SIZE, SCO_HOST_BUFFER_SIZE, L2CAP_HOST_FC_ACL_BUFS,
+                10),
+            parse_generic);
+  batch_add(&batch, "read_local_supported_commands",
+            packet_factory->make_read_local_supported_commands(),
+            parse_read_local_supported_commands);
+  add_read_feature_pages(&batch, &capabilities, 0);
+  run_batch(&batch, &capabilities);
+
+  if (snapshot_path && snapshot_load(&snapshot) &&
+      snapshot_matches(&snapshot.capabilities, &capabilities)) {
+    memcpy(&capabilities, &snapshot.capabilities, sizeof(capabilities));
+    memcpy(&snapshot_capabilities, &snapshot.capabilities,
+           sizeof(snapshot_capabilities));
+    started_from_snapshot = true;
   }
 
-  // read local supported codecs
-  if (HCI_READ_LOCAL_CODECS_SUPPORTED(supported_commands)) {
-    response =
-        AWAIT_COMMAND(packet_factory->make_read_local_supported_codecs());
-    packet_parser->parse_read_local_supported_codecs_response(
-        response, &number_of_local_supported_codecs, local_supported_codecs);
+  update_feature_flags();
+
+  batch.count = 0;
+  add_host_support_writes(&batch);
+  if (started_from_snapshot) {
+    // Everything else is known already, only configure the controller
+    add_feature_writes(&batch);
+    run_batch(&batch, &capabilities);
+  } else {
+    run_batch(&batch, &capabilities);
+
+    // Request the remaining feature pages
+    uint8_t page_number = 1;
+    while (page_number <= capabilities.last_features_classic_page_index &&
+           page_number < MAX_FEATURES_CLASSIC_PAGE_COUNT) {
+      batch.count = 0;
+      add_read_feature_pages(&batch, &capabilities, page_number);
+      page_number = capabilities.last_features_classic_page_index + 1;
+      run_batch(&batch, &capabilities);
+    }
+    update_feature_flags();
+
+    batch.count = 0;
+    add_feature_writes(&batch);
+    add_read_local_supported_codecs(&batch, &capabilities);
+    if (ble_supported) add_ble_reads(&batch);
+    run_batch(&batch, &capabilities);
+
+    if (ble_supported) {
+      /* If LE Excended Advertising is not supported, use the default value */
+      capabilities.ble_maxium_advertising_data_length = 31;
+      batch.count = 0;
+      add_ble_feature_reads(&batch, &capabilities);
+      run_batch(&batch, &capabilities);
+    }
+
+    if (snapshot_path) snapshot_save(&capabilities);
   }
 
-  if (!HCI_READ_ENCR_KEY_SIZE_SUPPORTED(supported_commands)) {
+  if (!HCI_READ_ENCR_KEY_SIZE_SUPPORTED(capabilities.supported_commands)) {
     LOG(FATAL) << " Controller must support Read Encryption Key Size command";
   }
 
   readable = true;
+  startup_trace_end();
+
+  if (started_from_snapshot) validation_start();
   return future_new_immediate(FUTURE_SUCCESS);
 }
 
@@ -305,31 +685,31 @@ static bool get_is_ready(void) { return readable; }
 
 static const RawAddress* get_address(void) {
   CHECK(readable);
-  return &address;
+  return &capabilities.address;
 }
 
 static const bt_version_t* get_bt_version(void) {
   CHECK(readable);
-  return &bt_version;
+  return &capabilities.bt_version;
 }
 
 // TODO(zachoverflow): hide inside, move decoder inside too
 static const bt_device_features_t* get_features_classic(int index) {
   CHECK(readable);
   CHECK(index < MAX_FEATURES_CLASSIC_PAGE_COUNT);
-  return &features_classic[index];
+  return &capabilities.features_classic[index];
 }
 
 static uint8_t get_last_features_classic_index(void) {
   CHECK(readable);
-  return last_features_classic_page_index;
+  return capabilities.last_features_classic_page_index;
 }
 
 static uint8_t* get_local_supported_codecs(uint8_t* number_of_codecs) {
   CHECK(readable);
-  if (number_of_local_supported_codecs) {
-    *number_of_codecs = number_of_local_supported_codecs;
-    return local_supported_codecs;
+  if (capabilities.number_of_local_supported_codecs) {
+    *number_of_codecs = capabilities.number_of_local_supported_codecs;
+    return capabilities.local_supported_codecs;
   }
   return NULL;
 }
@@ -337,13 +717,13 @@ static uint8_t* get_local_supported_codecs(uint8_t* number_of_codecs) {
 static const bt_device_features_t* get_features_ble(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return &features_ble;
+  return &capabilities.features_ble;
 }
 
 static const uint8_t* get_ble_supported_states(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return ble_supported_states;
+  return capabilities.ble_supported_states;
 }
 
 static bool supports_simple_pairing(void) {
@@ -358,42 +738,45 @@ static bool supports_secure_connections(void) {
 
 static bool supports_simultaneous_le_bredr(void) {
   CHECK(readable);
-  return HCI_SIMUL_LE_BREDR_SUPPORTED(features_classic[0].as_array);
+  return HCI_SIMUL_LE_BREDR_SUPPORTED(
+      capabilities.features_classic[0].as_array);
 }
 
 static bool supports_reading_remote_extended_features(void) {
   CHECK(readable);
-  return HCI_READ_REMOTE_EXT_FEATURES_SUPPORTED(supported_commands);
+  return HCI_READ_REMOTE_EXT_FEATURES_SUPPORTED(
+      capabilities.supported_commands);
 }
 
 static bool supports_interlaced_inquiry_scan(void) {
   CHECK(readable);
-  return HCI_LMP_INTERLACED_INQ_SCAN_SUPPORTED(features_classic[0].as_array);
+  return HCI_LMP_INTERLACED_INQ_SCAN_SUPPORTED(
+      capabilities.features_classic[0].as_array);
 }
 
 static bool supports_rssi_with_inquiry_results(void) {
   CHECK(readable);
-  return HCI_LMP_INQ_RSSI_SUPPORTED(features_classic[0].as_array);
+  return HCI_LMP_INQ_RSSI_SUPPORTED(capabilities.features_classic[0].as_array);
 }
 
 static bool supports_extended_inquiry_response(void) {
   CHECK(readable);
-  return HCI_EXT_INQ_RSP_SUPPORTED(features_classic[0].as_array);
+  return HCI_EXT_INQ_RSP_SUPPORTED(capabilities.features_classic[0].as_array);
 }
 
 static bool supports_master_slave_role_switch(void) {
   CHECK(readable);
-  return HCI_SWITCH_SUPPORTED(features_classic[0].as_array);
+  return HCI_SWITCH_SUPPORTED(capabilities.features_classic[0].as_array);
 }
 
 static bool supports_enhanced_setup_synchronous_connection(void) {
   assert(readable);
-  return HCI_ENH_SETUP_SYNCH_CONN_SUPPORTED(supported_commands);
+  return HCI_ENH_SETUP_SYNCH_CONN_SUPPORTED(capabilities.supported_commands);
 }
 
 static bool supports_enhanced_accept_synchronous_connection(void) {
   assert(readable);
-  return HCI_ENH_ACCEPT_SYNCH_CONN_SUPPORTED(supported_commands);
+  return HCI_ENH_ACCEPT_SYNCH_CONN_SUPPORTED(capabilities.supported_commands);
 }
 
 static bool supports_ble(void) {
@@ -404,118 +787,121 @@ static bool supports_ble(void) {
 static bool supports_ble_privacy(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_ENHANCED_PRIVACY_SUPPORTED(features_ble.as_array);
+  return HCI_LE_ENHANCED_PRIVACY_SUPPORTED(capabilities.features_ble.as_array);
 }
 
 static bool supports_ble_set_privacy_mode() {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_ENHANCED_PRIVACY_SUPPORTED(features_ble.as_array) &&
-         HCI_LE_SET_PRIVACY_MODE_SUPPORTED(supported_commands);
+  return HCI_LE_ENHANCED_PRIVACY_SUPPORTED(
+             capabilities.features_ble.as_array) &&
+         HCI_LE_SET_PRIVACY_MODE_SUPPORTED(capabilities.supported_commands);
 }
 
 static bool supports_ble_packet_extension(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_DATA_LEN_EXT_SUPPORTED(features_ble.as_array);
+  return HCI_LE_DATA_LEN_EXT_SUPPORTED(capabilities.features_ble.as_array);
 }
 
 static bool supports_ble_connection_parameters_request(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_CONN_PARAM_REQ_SUPPORTED(features_ble.as_array);
+  return HCI_LE_CONN_PARAM_REQ_SUPPORTED(capabilities.features_ble.as_array);
 }
 
 static bool supports_ble_2m_phy(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_2M_PHY_SUPPORTED(features_ble.as_array);
+  return HCI_LE_2M_PHY_SUPPORTED(capabilities.features_ble.as_array);
 }
 
 static bool supports_ble_coded_phy(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_CODED_PHY_SUPPORTED(features_ble.as_array);
+  return HCI_LE_CODED_PHY_SUPPORTED(capabilities.features_ble.as_array);
 }
 
 static bool supports_ble_extended_advertising(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_EXTENDED_ADVERTISING_SUPPORTED(features_ble.as_array);
+  return HCI_LE_EXTENDED_ADVERTISING_SUPPORTED(
+      capabilities.features_ble.as_array);
 }
 
 static bool supports_ble_periodic_advertising(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return HCI_LE_PERIODIC_ADVERTISING_SUPPORTED(features_ble.as_array);
+  return HCI_LE_PERIODIC_ADVERTISING_SUPPORTED(
+      capabilities.features_ble.as_array);
 }
 
 static uint16_t get_acl_data_size_classic(void) {
   CHECK(readable);
-  return acl_data_size_classic;
+  return capabilities.acl_data_size_classic;
 }
 
 static uint16_t get_acl_data_size_ble(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return acl_data_size_ble;
+  return capabilities.acl_data_size_ble;
 }
 
 static uint16_t get_acl_packet_size_classic(void) {
   CHECK(readable);
-  return acl_data_size_classic + HCI_DATA_PREAMBLE_SIZE;
+  return capabilities.acl_data_size_classic + HCI_DATA_PREAMBLE_SIZE;
 }
 
 static uint16_t get_acl_packet_size_ble(void) {
   CHECK(readable);
-  return acl_data_size_ble + HCI_DATA_PREAMBLE_SIZE;
+  return capabilities.acl_data_size_ble + HCI_DATA_PREAMBLE_SIZE;
 }
 
 static uint16_t get_ble_suggested_default_data_length(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return ble_suggested_default_data_length;
+  return capabilities.ble_suggested_default_data_length;
 }
 
 static uint16_t get_ble_maximum_tx_data_length(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return ble_supported_max_tx_octets;
+  return capabilities.ble_supported_max_tx_octets;
 }
 
 static uint16_t get_ble_maxium_advertising_data_length(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return ble_maxium_advertising_data_length;
+  return capabilities.ble_maxium_advertising_data_length;
 }
 
 static uint8_t get_ble_number_of_supported_advertising_sets(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return ble_number_of_supported_advertising_sets;
+  return capabilities.ble_number_of_supported_advertising_sets;
 }
 
 static uint16_t get_acl_buffer_count_classic(void) {
   CHECK(readable);
-  return acl_buffer_count_classic;
+  return capabilities.acl_buffer_count_classic;
 }
 
 static uint8_t get_acl_buffer_count_ble(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return acl_buffer_count_ble;
+  return capabilities.acl_buffer_count_ble;
 }
 
 static uint8_t get_ble_white_list_size(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return ble_white_list_size;
+  return capabilities.ble_white_list_size;
 }
 
 static uint8_t get_ble_resolving_list_max_size(void) {
   CHECK(readable);
   CHECK(ble_supported);
-  return ble_resolving_list_max_size;
+  return capabilities.ble_resolving_list_max_size;
 }
 
 static void set_ble_resolving_list_max_size(int resolving_list_max_size) {
@@ -525,7 +911,7 @@ static void set_ble_resolving_list_max_size(int resolving_list_max_size) {
     CHECK(readable);
   }
   CHECK(ble_supported);
-  ble_resolving_list_max_size = resolving_list_max_size;
+  capabilities.ble_resolving_list_max_size = resolving_list_max_size;
 }
 
 static uint8_t get_le_all_initiating_phys() {
@@ -597,6 +983,9 @@ const controller_t* bluetooth::legacy::controller_get_interface() {
     local_hci = hci_layer_get_interface();
     packet_factory = hci_packet_factory_get_interface();
     packet_parser = hci_packet_parser_get_interface();
+
+    if (osi_property_get_bool(PROPERTY_CONTROLLER_SNAPSHOT, false))
+      snapshot_path = CONTROLLER_SNAPSHOT_PATH;
   }
 
   return &interface;
@@ -0,0 +1,339 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "device/src/controller.cc"
+#include "osi/include/allocator.h"
+
+// The controller start up is run against a fake HCI layer. Every command
+// completes immediately, and the fake parsers report an LE controller
+// supporting every feature and command, so that each batch is as large as it
+// can be.
+
+namespace bluetooth {
+namespace shim {
+bool is_gd_shim_enabled() { return false; }
+const controller_t* controller_get_interface() { return nullptr; }
+}  // namespace shim
+namespace legacy {
+const hci_t* hci_layer_get_interface() { return nullptr; }
+}  // namespace legacy
+}  // namespace bluetooth
+
+const hci_packet_factory_t* hci_packet_factory_get_interface() {
+  return nullptr;
+}
+const hci_packet_parser_t* hci_packet_parser_get_interface() {
+  return nullptr;
+}
+
+namespace {
+
+constexpr uint8_t kLastFeaturesPage = 2;
+constexpr uint8_t kWhiteListSize = 32;
+
+// The commands sent by start_up(), and the validation reads sent after it
+int futured_commands;
+struct pending_command_t {
+  BT_HDR* command;
+  command_complete_cb complete_callback;
+  void* context;
+};
+std::vector<pending_command_t> pending_commands;
+
+uint8_t white_list_size = kWhiteListSize;
+
+// The fake packet factory tags each command with the features page it reads
+BT_HDR* make_command(uint16_t page = 0) {
+  BT_HDR* command = static_cast<BT_HDR*>(osi_calloc(sizeof(BT_HDR)));
+  command->layer_specific = page;
+  return command;
+}
+
+BT_HDR* make_command_void(void) { return make_command(); }
+BT_HDR* make_host_buffer_size(uint16_t, uint8_t, uint16_t, uint16_t) {
+  return make_command();
+}
+BT_HDR* make_read_local_extended_features(uint8_t page) {
+  return make_command(page);
+}
+BT_HDR* make_mode_command(uint8_t) { return make_command(); }
+BT_HDR* make_event_mask_command(const bt_event_mask_t*) {
+  return make_command();
+}
+BT_HDR* make_ble_write_host_support(uint8_t, uint8_t) { return make_command(); }
+
+void transmit_command(BT_HDR* command, command_complete_cb complete_callback,
+                      command_status_cb, void* context) {
+  pending_commands.push_back({command, complete_callback, context});
+}
+
+future_t* transmit_command_futured(BT_HDR* command) {
+  futured_commands++;
+  return future_new_immediate(command);
+}
+
+void parse_generic_command_complete(BT_HDR* response) { osi_free(response); }
+
+void parse_read_buffer_size_response(BT_HDR* response, uint16_t* data_size,
+                                     uint16_t* acl_buffer_count) {
+  *data_size = 1021;
+  *acl_buffer_count = 8;
+  osi_free(response);
+}
+
+void parse_read_local_version_info_response(BT_HDR* response,
+                                            bt_version_t* bt_version) {
+  bt_version->hci_version = 9;
+  bt_version->manufacturer = 15;
+  osi_free(response);
+}
+
+void parse_read_bd_addr_response(BT_HDR* response, RawAddress* address) {
+  RawAddress::FromString("11:22:33:44:55:66", *address);
+  osi_free(response);
+}
+
+void parse_bytes_response(BT_HDR* response, uint8_t* bytes, size_t length) {
+  memset(bytes, 0xff, length);
+  osi_free(response);
+}
+
+void parse_read_local_extended_features_response(
+    BT_HDR* response, uint8_t* page_number, uint8_t* max_page_number,
+    bt_device_features_t* feature_pages, size_t feature_pages_count) {
+  *page_number = response->layer_specific;
+  *max_page_number = kLastFeaturesPage;
+  if (*page_number < feature_pages_count)
+    memset(&feature_pages[*page_number], 0xff, sizeof(feature_pages[0]));
+  osi_free(response);
+}
+
+void parse_ble_read_white_list_size_response(BT_HDR* response,
+                                             uint8_t* white_list_size_ptr) {
+  *white_list_size_ptr = white_list_size;
+  osi_free(response);
+}
+
+void parse_ble_read_buffer_size_response(BT_HDR* response, uint16_t* data_size,
+                                         uint8_t* acl_buffer_count) {
+  *data_size = 251;
+  *acl_buffer_count = 8;
+  osi_free(response);
+}
+
+void parse_ble_read_local_supported_features_response(
+    BT_HDR* response, bt_device_features_t* supported_features) {
+  memset(supported_features, 0xff, sizeof(*supported_features));
+  osi_free(response);
+}
+
+void parse_uint8_response(BT_HDR* response, uint8_t* value) {
+  *value = 16;
+  osi_free(response);
+}
+
+void parse_uint16_response(BT_HDR* response, uint16_t* value) {
+  *value = 251;
+  osi_free(response);
+}
+
+void parse_ble_read_maximum_data_length_response(BT_HDR* response,
+                                                 uint16_t* tx_data_length,
+                                                 uint16_t* tx_time,
+                                                 uint16_t* rx_data_length,
+                                                 uint16_t* rx_time) {
+  *tx_data_length = *rx_data_length = 251;
+  *tx_time = *rx_time = 2120;
+  osi_free(response);
+}
+
+void parse_read_local_supported_codecs_response(BT_HDR* response,
+                                                uint8_t* number_of_codecs,
+                                                uint8_t* local_codecs) {
+  *number_of_codecs = 2;
+  local_codecs[0] = 0x02;
+  local_codecs[1] = 0x05;
+  osi_free(response);
+}
+
+hci_t fake_hci;
+hci_packet_factory_t fake_packet_factory;
+hci_packet_parser_t fake_packet_parser;
+
+void init_fakes(void) {
+  fake_hci.transmit_command = transmit_command;
+  fake_hci.transmit_command_futured = transmit_command_futured;
+
+  hci_packet_factory_t* f = &fake_packet_factory;
+  f->make_reset = make_command_void;
+  f->make_read_buffer_size = make_command_void;
+  f->make_host_buffer_size = make_host_buffer_size;
+  f->make_read_local_version_info = make_command_void;
+  f->make_read_bd_addr = make_command_void;
+  f->make_read_local_supported_commands = make_command_void;
+  f->make_read_local_extended_features = make_read_local_extended_features;
+  f->make_write_simple_pairing_mode = make_mode_command;
+  f->make_write_secure_connections_host_support = make_mode_command;
+  f->make_set_event_mask = make_event_mask_command;
+  f->make_ble_write_host_support = make_ble_write_host_support;
+  f->make_ble_read_white_list_size = make_command_void;
+  f->make_ble_read_buffer_size = make_command_void;
+  f->make_ble_read_supported_states = make_command_void;
+  f->make_ble_read_local_supported_features = make_command_void;
+  f->make_ble_read_resolving_list_size = make_command_void;
+  f->make_ble_read_suggested_default_data_length = make_command_void;
+  f->make_ble_read_maximum_data_length = make_command_void;
+  f->make_ble_read_maximum_advertising_data_length = make_command_void;
+  f->make_ble_read_number_of_supported_advertising_sets = make_command_void;
+  f->make_ble_set_event_mask = make_event_mask_command;
+  f->make_read_local_supported_codecs = make_command_void;
+
+  hci_packet_parser_t* p = &fake_packet_parser;
+  p->parse_generic_command_complete = parse_generic_command_complete;
+  p->parse_read_buffer_size_response = parse_read_buffer_size_response;
+  p->parse_read_local_version_info_response =
+      parse_read_local_version_info_response;
+  p->parse_read_bd_addr_response = parse_read_bd_addr_response;
+  p->parse_read_local_supported_commands_response = parse_bytes_response;
+  p->parse_read_local_extended_features_response =
+      parse_read_local_extended_features_response;
+  p->parse_ble_read_white_list_size_response =
+      parse_ble_read_white_list_size_response;
+  p->parse_ble_read_buffer_size_response = parse_ble_read_buffer_size_response;
+  p->parse_ble_read_supported_states_response = parse_bytes_response;
+  p->parse_ble_read_local_supported_features_response =
+      parse_ble_read_local_supported_features_response;
+  p->parse_ble_read_resolving_list_size_response = parse_uint8_response;
+  p->parse_ble_read_suggested_default_data_length_response =
+      parse_uint16_response;
+  p->parse_ble_read_maximum_data_length_response =
+      parse_ble_read_maximum_data_length_response;
+  p->parse_ble_read_maximum_advertising_data_length = parse_uint16_response;
+  p->parse_ble_read_number_of_supported_advertising_sets =
+      parse_uint8_response;
+  p->parse_read_local_supported_codecs_response =
+      parse_read_local_supported_codecs_response;
+}
+
+}  // namespace
+
+class ControllerStartUpTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    init_fakes();
+    controller_ = controller_get_test_interface(
+        &fake_hci, &fake_packet_factory, &fake_packet_parser);
+    snapshot_file_ = ::testing::TempDir() + "controller_test_snapshot";
+    unlink(snapshot_file_.c_str());
+    snapshot_path = snapshot_file_.c_str();
+    futured_commands = 0;
+    pending_commands.clear();
+    white_list_size = kWhiteListSize;
+  }
+
+  void TearDown() override {
+    ShutDown();
+    unlink(snapshot_file_.c_str());
+    snapshot_path = nullptr;
+  }
+
+  void StartUp() {
+    futured_commands = 0;
+    future_t* future = start_up();
+    EXPECT_EQ(FUTURE_SUCCESS, future_await(future));
+    EXPECT_TRUE(controller_->get_is_ready());
+  }
+
+  void ShutDown() { EXPECT_EQ(FUTURE_SUCCESS, future_await(shut_down())); }
+
+  void CompletePendingCommands() {
+    std::vector<pending_command_t> commands;
+    commands.swap(pending_commands);
+    for (const pending_command_t& pending : commands)
+      pending.complete_callback(pending.command, pending.context);
+  }
+
+  bool SnapshotExists() const {
+    struct stat st;
+    return stat(snapshot_file_.c_str(), &st) == 0;
+  }
+
+  const controller_t* controller_;
+  std::string snapshot_file_;
+};
+
+TEST_F(ControllerStartUpTest, cold_start_up_saves_snapshot) {
+  StartUp();
+
+  EXPECT_FALSE(started_from_snapshot);
+  // Reset, 6 identity reads, 2 host support writes, 2 feature pages, 8 feature
+  // writes, codec and LE reads, then 5 LE feature reads
+  EXPECT_EQ(24, futured_commands);
+  EXPECT_TRUE(pending_commands.empty());
+  EXPECT_TRUE(SnapshotExists());
+
+  EXPECT_TRUE(controller_->supports_ble());
+  EXPECT_TRUE(controller_->supports_ble_extended_advertising());
+  EXPECT_EQ(kLastFeaturesPage, controller_->get_last_features_classic_index());
+  EXPECT_EQ(kWhiteListSize, controller_->get_ble_white_list_size());
+  EXPECT_EQ(251, controller_->get_ble_maximum_tx_data_length());
+}
+
+TEST_F(ControllerStartUpTest, start_up_from_snapshot_validates_it) {
+  StartUp();
+  controller_capabilities_t cold_capabilities = capabilities;
+  ShutDown();
+
+  StartUp();
+
+  EXPECT_TRUE(started_from_snapshot);
+  // Reset, 6 identity reads, 2 host support writes and 3 feature writes
+  EXPECT_EQ(12, futured_commands);
+  EXPECT_EQ(0, memcmp(&cold_capabilities, &capabilities,
+                      sizeof(capabilities)));
+
+  // Feature pages 1 and 2, 4 LE reads, 5 LE feature reads and the codecs
+  EXPECT_EQ(12u, pending_commands.size());
+  CompletePendingCommands();
+  EXPECT_EQ(0, validation_pending);
+  EXPECT_TRUE(SnapshotExists());
+}
+
+TEST_F(ControllerStartUpTest, stale_snapshot_is_discarded) {
+  StartUp();
+  ShutDown();
+
+  StartUp();
+  EXPECT_TRUE(started_from_snapshot);
+
+  white_list_size = kWhiteListSize / 2;
+  CompletePendingCommands();
+  EXPECT_FALSE(SnapshotExists());
+
+  ShutDown();
+  StartUp();
+  EXPECT_FALSE(started_from_snapshot);
+  EXPECT_EQ(kWhiteListSize / 2, controller_->get_ble_white_list_size());
+  EXPECT_TRUE(SnapshotExists());
+}
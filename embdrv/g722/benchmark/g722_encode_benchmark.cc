@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* G.722 encoding of a stereo stream the way the hearing aid profile does it,
+ * one 10 ms frame of each channel per call. The time reported per iteration
+ * is the time to encode one frame of one channel. */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "embdrv/g722/g722_enc_dec.h"
+#include "embdrv/g722/test/g722_encode_reference.h"
+
+using ::benchmark::State;
+
+// 10 ms at 16 kHz
+#define FRAME_SAMPLES 160
+#define NUM_FRAMES 100
+
+class BM_G722Encode : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    /* Speech like: a few harmonics under noise */
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 600);
+    pcm_.resize(FRAME_SAMPLES * NUM_FRAMES);
+    for (size_t i = 0; i < pcm_.size(); i++) {
+      double t = i / 16000.0;
+      pcm_[i] = 6000 * sin(2 * M_PI * 220 * t) +
+                3000 * sin(2 * M_PI * 660 * t) +
+                1000 * sin(2 * M_PI * 2400 * t) + noise(rng);
+    }
+    out_.resize(FRAME_SAMPLES);
+    state_ = g722_encode_init(nullptr, 64000, G722_PACKED);
+  }
+
+  void TearDown(State& st) override {
+    g722_encode_release(state_);
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  template <typename Encode>
+  void Replay(State& state, Encode encode) {
+    size_t frame = 0;
+    for (auto _ : state) {
+      encode(pcm_.data() + frame * FRAME_SAMPLES);
+      frame = (frame + 1) % NUM_FRAMES;
+    }
+    state.SetItemsProcessed(state.iterations() * FRAME_SAMPLES);
+  }
+
+  std::vector<int16_t> pcm_;
+  std::vector<uint8_t> out_;
+  g722_encode_state_t* state_;
+};
+
+BENCHMARK_DEFINE_F(BM_G722Encode, reference)(State& state) {
+  Replay(state, [this](const int16_t* frame) {
+    benchmark::DoNotOptimize(
+        g722_reference_encode(state_, out_.data(), frame, FRAME_SAMPLES));
+  });
+}
+BENCHMARK_REGISTER_F(BM_G722Encode, reference)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_DEFINE_F(BM_G722Encode, block_qmf)(State& state) {
+  Replay(state, [this](const int16_t* frame) {
+    benchmark::DoNotOptimize(
+        g722_encode(state_, out_.data(), frame, FRAME_SAMPLES));
+  });
+}
+BENCHMARK_REGISTER_F(BM_G722Encode, block_qmf)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
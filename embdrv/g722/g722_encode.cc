@@ -75,7 +75,7 @@ static void block4(g722_band_t *band, int d)
     int wd2;
     int wd3;
     int i;
-    int sg[7];
+    int sg[3];
     int ap1, ap2;
     int sg0, sgi;
     int sz;
@@ -120,27 +120,25 @@ static void block4(g722_band_t *band, int d)
 
     /* Block 4, UPZERO */
     /* Block 4, FILTEZ */
+    /* Block 4, DELAYA */
+    /* Walking down the delay line lets each tap read its old d[i] for the
+       coefficient update before d[i - 1] moves into it. */
     wd1 = (d == 0)  ?  0  :  128;
 
-    sg0 = sg[0] = d >> 15;
-    for (i = 1;  i < 7;  i++)
-    {
-	sgi = band->d[i] >> 15;
-	wd2 = (sgi == sg0) ? wd1 : -wd1;
-        wd3 = (band->b[i]*32640) >> 15;
-        band->bp[i] = saturate(wd2 + wd3);
-    }
-
-    /* Block 4, DELAYA */
+    sg0 = d >> 15;
     sz = 0;
     for (i = 6;  i > 0;  i--)
     {
-	int bi;
+        int bi;
+
+        sgi = band->d[i] >> 15;
+        wd2 = (sgi == sg0) ? wd1 : -wd1;
+        wd3 = (band->b[i]*32640) >> 15;
+        bi = band->bp[i] = band->b[i] = saturate(wd2 + wd3);
 
         band->d[i] = band->d[i - 1];
-        bi = band->b[i] = band->bp[i];
-        wd1 = saturate(band->d[i] + band->d[i]);
-        sz += (bi*wd1) >> 15;
+        wd3 = saturate(band->d[i] + band->d[i]);
+        sz += (bi*wd3) >> 15;
     }
     band->sz = sz;
     
@@ -268,8 +266,79 @@ static int16_t ihp[3] = {0, 3, 2};
 static int16_t wh[3] = {0, -214, 798};
 static int16_t rh2[4] = {2, 1, 2, 1};
 
-int g722_encode(g722_encode_state_t *s, uint8_t g722_data[],
-                       const int16_t amp[], int len)
+/* Sample pairs run through the QMF at a time */
+#define QMF_BLOCK_PAIRS (80)
+/* Pairs of history kept in s->x. The 24 tap QMF uses the last 11 of them with
+   the current pair. */
+#define QMF_HISTORY_PAIRS (12)
+
+/* Splits |pairs| sample pairs into the low and high bands. The two samples of
+   each pair are kept in separate arrays, so the even and odd taps are plain
+   dot products over contiguous memory, and the outer loop over the pairs runs
+   on whole vectors of them. |first| and |second| start with the 11 pairs of
+   history. */
+static void qmf_analysis(const int16_t first[], const int16_t second[],
+                         int pairs, int xlow[], int xhigh[])
+{
+    int sumodd[QMF_BLOCK_PAIRS];
+    int sumeven[QMF_BLOCK_PAIRS];
+    int i;
+    int k;
+
+    for (k = 0;  k < pairs;  k++)
+    {
+        sumodd[k] = 0;
+        sumeven[k] = 0;
+    }
+    for (i = 0;  i < 12;  i++)
+    {
+        const int codd = qmf_coeffs[i];
+        const int ceven = qmf_coeffs[11 - i];
+
+        for (k = 0;  k < pairs;  k++)
+        {
+            sumodd[k] += first[k + i]*codd;
+            sumeven[k] += second[k + i]*ceven;
+        }
+    }
+    /* We shift by 12 to allow for the QMF filters (DC gain = 4096), plus 1
+       to allow for us summing two filters, plus 1 to allow for the 15 bit
+       input to the G.722 algorithm. */
+    for (k = 0;  k < pairs;  k++)
+    {
+        xlow[k] = (sumeven[k] + sumodd[k]) >> 14;
+        xhigh[k] = (sumeven[k] - sumodd[k]) >> 14;
+#ifdef RUN_LIKE_REFERENCE_G722
+        /* The following lines are only used to verify bit-exactness
+         * with reference implementation of G.722. Higher precision
+         * is achieved without limiting the values.
+         */
+        xlow[k] = limitValues(xlow[k]);
+        xhigh[k] = limitValues(xhigh[k]);
+#endif
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Block 1L, QUANTL. The decision levels grow with the q6 table index, so the
+   index of the first one above |wd| is one more than the number of levels at
+   or below it. Counting them all has no data dependent branch and runs on
+   vectors, where trying them in turn mispredicts on every sample. */
+static __inline int quantl(int wd, int det)
+{
+    int below;
+    int i;
+
+    below = 0;
+    for (i = 1;  i < 30;  i++)
+        below += (wd >= ((q6[i]*det) >> 12));
+    return below + 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Runs the ADPCM of both bands on one pair of band samples, returning the
+   code for them */
+static __inline int encode_bands(g722_encode_state_t *s, int xlow, int xhigh)
 {
     int dlow;
     int dhigh;
@@ -284,153 +353,160 @@ int g722_encode(g722_encode_state_t *s, uint8_t g722_data[],
     int eh;
     int mih;
     int i;
-    int j;
-    /* Low and high band PCM from the QMF */
-    int xlow;
-    int xhigh;
-    int g722_bytes;
-    /* Even and odd tap accumulators */
-    int sumeven;
-    int sumodd;
     int ihigh;
     int ilow;
-    int code;
+    int nb;
+
+    /* Block 1L, SUBTRA */
+    el = saturate(xlow - s->band[0].s);
+
+    /* Block 1L, QUANTL */
+    wd = (el >= 0)  ?  el  :  -(el + 1);
+    i = quantl(wd, s->band[0].det);
+    ilow = (el < 0)  ?  iln[i]  :  ilp[i];
+
+    /* Block 2L, INVQAL */
+    ril = ilow >> 2;
+    wd2 = qm4[ril];
+    dlow = (s->band[0].det*wd2) >> 15;
+
+    /* Block 3L, LOGSCL */
+    il4 = rl42[ril];
+    wd = (s->band[0].nb*127) >> 7;
+    s->band[0].nb = wd + wl[il4];
+    if (s->band[0].nb < 0)
+        s->band[0].nb = 0;
+    else if (s->band[0].nb > 18432)
+        s->band[0].nb = 18432;
+
+    /* Block 3L, SCALEL */
+    wd1 = (s->band[0].nb >> 6) & 31;
+    wd2 = 8 - (s->band[0].nb >> 11);
+    wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
+    s->band[0].det = wd3 << 2;
+
+    block4(&s->band[0], dlow);
+
+    /* Block 1H, SUBTRA */
+    eh = saturate(xhigh - s->band[1].s);
+
+    /* Block 1H, QUANTH */
+    wd = (eh >= 0)  ?  eh  :  -(eh + 1);
+    wd1 = (564*s->band[1].det) >> 12;
+    mih = (wd >= wd1)  ?  2  :  1;
+    ihigh = (eh < 0)  ?  ihn[mih]  :  ihp[mih];
+
+    /* Block 2H, INVQAH */
+    wd2 = qm2[ihigh];
+    dhigh = (s->band[1].det*wd2) >> 15;
+
+    /* Block 3H, LOGSCH */
+    ih2 = rh2[ihigh];
+    wd = (s->band[1].nb*127) >> 7;
+
+    nb = wd + wh[ih2];
+    if (nb < 0)
+        nb = 0;
+    else if (nb > 22528)
+        nb = 22528;
+    s->band[1].nb = nb;
+
+    /* Block 3H, SCALEH */
+    wd1 = (s->band[1].nb >> 6) & 31;
+    wd2 = 10 - (s->band[1].nb >> 11);
+    wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
+    s->band[1].det = wd3 << 2;
+
+    block4(&s->band[1], dhigh);
+#if   BITS_PER_SAMPLE == 8
+    return ((ihigh << 6) | ilow);
+#elif BITS_PER_SAMPLE == 7
+    return ((ihigh << 6) | ilow) >> 1;
+#elif BITS_PER_SAMPLE == 6
+    return ((ihigh << 6) | ilow) >> 2;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
 
-    g722_bytes = 0;
-    xhigh = 0;
-    for (j = 0;  j < len;  )
+static __inline int put_code(g722_encode_state_t *s, uint8_t g722_data[],
+                             int g722_bytes, int code)
+{
+#if PACKED_OUTPUT == 1
+    /* Pack the code bits */
+    s->out_buffer |= (code << s->out_bits);
+    s->out_bits += s->bits_per_sample;
+    if (s->out_bits >= 8)
     {
-        if (s->itu_test_mode)
-        {
-            xlow =
-            xhigh = amp[j++] >> 1;
-        }
-        else
-        {
-            {
-                /* Apply the transmit QMF */
-                /* Shuffle the buffer down */
-                for (i = 0;  i < 22;  i++)
-                    s->x[i] = s->x[i + 2];
-                //TODO: if len is odd, then this can be a buffer overrun
-                s->x[22] = amp[j++];
-                s->x[23] = amp[j++];
-    
-                /* Discard every other QMF output */
-                sumeven = 0;
-                sumodd = 0;
-                for (i = 0;  i < 12;  i++)
-                {
-                    sumodd += s->x[2*i]*qmf_coeffs[i];
-                    sumeven += s->x[2*i + 1]*qmf_coeffs[11 - i];
-                }
-                /* We shift by 12 to allow for the QMF filters (DC gain = 4096), plus 1
-                   to allow for us summing two filters, plus 1 to allow for the 15 bit
-                   input to the G.722 algorithm. */
-                xlow = (sumeven + sumodd) >> 14;
-                xhigh = (sumeven - sumodd) >> 14;
-
-#ifdef RUN_LIKE_REFERENCE_G722
-                /* The following lines are only used to verify bit-exactness
-                 * with reference implementation of G.722. Higher precision
-                 * is achieved without limiting the values.
-                 */
-                xlow = limitValues(xlow);
-                xhigh = limitValues(xhigh);
+        g722_data[g722_bytes++] = (uint8_t) (s->out_buffer & 0xFF);
+        s->out_bits -= 8;
+        s->out_buffer >>= 8;
+    }
+#else
+    (void) s;
+    g722_data[g722_bytes++] = (uint8_t) code;
 #endif
-            }
-        }
-        /* Block 1L, SUBTRA */
-        el = saturate(xlow - s->band[0].s);
+    return g722_bytes;
+}
+/*- End of function --------------------------------------------------------*/
 
-        /* Block 1L, QUANTL */
-        wd = (el >= 0)  ?  el  :  -(el + 1);
+/* Encodes |len| samples. The QMF takes the samples in pairs, |len| must be
+   even; a trailing odd sample is ignored. */
+int g722_encode(g722_encode_state_t *s, uint8_t g722_data[],
+                       const int16_t amp[], int len)
+{
+    int16_t first[QMF_HISTORY_PAIRS + QMF_BLOCK_PAIRS];
+    int16_t second[QMF_HISTORY_PAIRS + QMF_BLOCK_PAIRS];
+    /* Low and high band PCM from the QMF */
+    int xlow[QMF_BLOCK_PAIRS];
+    int xhigh[QMF_BLOCK_PAIRS];
+    int g722_bytes;
+    int pairs;
+    int done;
+    int i;
+    int j;
 
-        for (i = 1;  i < 30;  i++)
+    g722_bytes = 0;
+    if (s->itu_test_mode)
+    {
+        for (j = 0;  j < len;  j++)
         {
-            wd1 = (q6[i]*s->band[0].det) >> 12;
-            if (wd < wd1)
-                break;
+            i = amp[j] >> 1;
+            g722_bytes = put_code(s, g722_data, g722_bytes,
+                                  encode_bands(s, i, i));
         }
-        ilow = (el < 0)  ?  iln[i]  :  ilp[i];
-
-        /* Block 2L, INVQAL */
-        ril = ilow >> 2;
-        wd2 = qm4[ril];
-        dlow = (s->band[0].det*wd2) >> 15;
-
-        /* Block 3L, LOGSCL */
-        il4 = rl42[ril];
-        wd = (s->band[0].nb*127) >> 7;
-        s->band[0].nb = wd + wl[il4];
-        if (s->band[0].nb < 0)
-            s->band[0].nb = 0;
-        else if (s->band[0].nb > 18432)
-            s->band[0].nb = 18432;
-
-        /* Block 3L, SCALEL */
-        wd1 = (s->band[0].nb >> 6) & 31;
-        wd2 = 8 - (s->band[0].nb >> 11);
-        wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-        s->band[0].det = wd3 << 2;
-
-        block4(&s->band[0], dlow);
+        return g722_bytes;
+    }
+
+    /* s->x holds the last pairs, interleaved, the oldest first */
+    for (i = 0;  i < QMF_HISTORY_PAIRS;  i++)
+    {
+        first[i] = (int16_t) s->x[2*i];
+        second[i] = (int16_t) s->x[2*i + 1];
+    }
+    for (done = 0;  done < len/2;  done += pairs)
+    {
+        pairs = len/2 - done;
+        if (pairs > QMF_BLOCK_PAIRS)
+            pairs = QMF_BLOCK_PAIRS;
+
+        for (i = 0;  i < pairs;  i++)
         {
-	    int nb;
-
-            /* Block 1H, SUBTRA */
-            eh = saturate(xhigh - s->band[1].s);
-
-            /* Block 1H, QUANTH */
-            wd = (eh >= 0)  ?  eh  :  -(eh + 1);
-            wd1 = (564*s->band[1].det) >> 12;
-            mih = (wd >= wd1)  ?  2  :  1;
-            ihigh = (eh < 0)  ?  ihn[mih]  :  ihp[mih];
-
-            /* Block 2H, INVQAH */
-            wd2 = qm2[ihigh];
-            dhigh = (s->band[1].det*wd2) >> 15;
-
-            /* Block 3H, LOGSCH */
-            ih2 = rh2[ihigh];
-            wd = (s->band[1].nb*127) >> 7;
-
-            nb = wd + wh[ih2];
-            if (nb < 0)
-                nb = 0;
-            else if (nb > 22528)
-                nb = 22528;
-	    s->band[1].nb = nb;
-
-            /* Block 3H, SCALEH */
-            wd1 = (s->band[1].nb >> 6) & 31;
-            wd2 = 10 - (s->band[1].nb >> 11);
-            wd3 = (wd2 < 0)  ?  (ilb[wd1] << -wd2)  :  (ilb[wd1] >> wd2);
-            s->band[1].det = wd3 << 2;
-
-            block4(&s->band[1], dhigh);
-#if   BITS_PER_SAMPLE == 8
-            code = ((ihigh << 6) | ilow);
-#elif BITS_PER_SAMPLE == 7
-            code = ((ihigh << 6) | ilow) >> 1;
-#elif BITS_PER_SAMPLE == 6
-            code = ((ihigh << 6) | ilow) >> 2;
-#endif
+            first[QMF_HISTORY_PAIRS + i] = amp[2*(done + i)];
+            second[QMF_HISTORY_PAIRS + i] = amp[2*(done + i) + 1];
         }
-
-#if PACKED_OUTPUT == 1
-            /* Pack the code bits */
-            s->out_buffer |= (code << s->out_bits);
-            s->out_bits += s->bits_per_sample;
-            if (s->out_bits >= 8)
-            {
-                g722_data[g722_bytes++] = (uint8_t) (s->out_buffer & 0xFF);
-                s->out_bits -= 8;
-                s->out_buffer >>= 8;
-            }
-#else
-            g722_data[g722_bytes++] = (uint8_t) code;
-#endif
+        qmf_analysis(first + 1, second + 1, pairs, xlow, xhigh);
+        for (i = 0;  i < pairs;  i++)
+            g722_bytes = put_code(s, g722_data, g722_bytes,
+                                  encode_bands(s, xlow[i], xhigh[i]));
+
+        /* Slide the history down to the start of the block */
+        memmove(first, first + pairs, QMF_HISTORY_PAIRS*sizeof(first[0]));
+        memmove(second, second + pairs, QMF_HISTORY_PAIRS*sizeof(second[0]));
+    }
+    for (i = 0;  i < QMF_HISTORY_PAIRS;  i++)
+    {
+        s->x[2*i] = first[i];
+        s->x[2*i + 1] = second[i];
     }
     return g722_bytes;
 }
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "embdrv/g722/g722_enc_dec.h"
+
+/* The scalar SpanDSP encoder g722_encode() was derived from, sample by sample
+ * QMF and linear quantizer search. State comes from g722_encode_init(). */
+int g722_reference_encode(g722_encode_state_t* s, uint8_t g722_data[],
+                          const int16_t amp[], int len);
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "embdrv/g722/g722_enc_dec.h"
+#include "embdrv/g722/test/g722_encode_reference.h"
+
+namespace {
+
+// 10 ms at 16 kHz, as the hearing aid encodes it
+constexpr int kFrameSamples = 160;
+
+std::vector<int16_t> make_noise(size_t len, int16_t amplitude) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> dist(-amplitude, amplitude);
+  std::vector<int16_t> pcm(len);
+  for (int16_t& sample : pcm) sample = dist(rng);
+  return pcm;
+}
+
+std::vector<int16_t> make_sine(size_t len, double freq, double amplitude) {
+  std::vector<int16_t> pcm(len);
+  for (size_t i = 0; i < len; i++) {
+    pcm[i] = amplitude * sin(2 * M_PI * freq * i / 16000);
+  }
+  return pcm;
+}
+
+// Encodes |pcm| with both encoders, |chunk| samples per call, and checks they
+// produce the same codes
+void expect_bit_exact(const std::vector<int16_t>& pcm, int chunk,
+                      int rate = 64000) {
+  g722_encode_state_t* state = g722_encode_init(nullptr, rate, G722_PACKED);
+  g722_encode_state_t* reference =
+      g722_encode_init(nullptr, rate, G722_PACKED);
+
+  std::vector<uint8_t> out(chunk);
+  std::vector<uint8_t> expected(chunk);
+  for (size_t pos = 0; pos + chunk <= pcm.size(); pos += chunk) {
+    int len = g722_encode(state, out.data(), pcm.data() + pos, chunk);
+    int expected_len = g722_reference_encode(reference, expected.data(),
+                                             pcm.data() + pos, chunk);
+    ASSERT_EQ(expected_len, len) << "at sample " << pos;
+    ASSERT_TRUE(std::equal(expected.begin(), expected.begin() + len,
+                           out.begin()))
+        << "at sample " << pos;
+  }
+
+  g722_encode_release(state);
+  g722_encode_release(reference);
+}
+
+}  // namespace
+
+TEST(G722EncodeTest, silence) {
+  expect_bit_exact(std::vector<int16_t>(kFrameSamples * 10), kFrameSamples);
+}
+
+TEST(G722EncodeTest, noise) {
+  expect_bit_exact(make_noise(kFrameSamples * 200, 16383), kFrameSamples);
+}
+
+TEST(G722EncodeTest, full_scale_noise) {
+  expect_bit_exact(make_noise(kFrameSamples * 200, 32767), kFrameSamples);
+}
+
+TEST(G722EncodeTest, sine_sweep) {
+  for (double freq : {100.0, 1000.0, 3400.0, 5000.0, 7900.0}) {
+    expect_bit_exact(make_sine(kFrameSamples * 50, freq, 12000), kFrameSamples);
+  }
+}
+
+TEST(G722EncodeTest, saturated_square_wave) {
+  std::vector<int16_t> pcm(kFrameSamples * 50);
+  for (size_t i = 0; i < pcm.size(); i++) {
+    pcm[i] = (i / 20) % 2 ? INT16_MAX : INT16_MIN;
+  }
+  expect_bit_exact(pcm, kFrameSamples);
+}
+
+// The QMF history carries over calls of any even size, shorter or longer than
+// its own block
+TEST(G722EncodeTest, chunk_sizes) {
+  std::vector<int16_t> pcm = make_noise(kFrameSamples * 60, 8000);
+  for (int chunk : {2, 4, 22, 24, 26, 158, 320, 960}) {
+    expect_bit_exact(pcm, chunk);
+  }
+}
+
+TEST(G722EncodeTest, lower_rates) {
+  std::vector<int16_t> pcm = make_noise(kFrameSamples * 50, 16383);
+  expect_bit_exact(pcm, kFrameSamples, 56000);
+  expect_bit_exact(pcm, kFrameSamples, 48000);
+}
+
+TEST(G722EncodeTest, one_code_per_pair) {
+  g722_encode_state_t* state = g722_encode_init(nullptr, 64000, G722_PACKED);
+  std::vector<int16_t> pcm = make_noise(kFrameSamples, 1000);
+  std::vector<uint8_t> out(kFrameSamples);
+  EXPECT_EQ(kFrameSamples / 2,
+            g722_encode(state, out.data(), pcm.data(), kFrameSamples));
+  g722_encode_release(state);
+}
@@ -79,6 +79,7 @@ Declarations of codec functions, data types, and macros.
 
 #define OI_SBC_SYNCWORD 0x9c
 #define OI_SBC_ENHANCED_SYNCWORD 0x9d
+#define OI_mSBC_SYNCWORD 0xad
 
 /**@name Sampling frequencies */
 /**@{*/
@@ -136,6 +137,9 @@ Declarations of codec functions, data types, and macros.
 /**< A block size of 16 blocks was used to encode the stream. One possible value
  * for the @a blocks parameter of OI_CODEC_SBC_EncoderConfigure() */
 #define SBC_BLOCKS_16 3
+/**< A block size of 15 blocks, only used by mSBC streams. It cannot be carried
+ * in a standard SBC frame header. */
+#define SBC_BLOCKS_15 4
 /**@}*/
 
 /**@name Bit allocation methods */
@@ -237,6 +241,8 @@ typedef struct {
   uint8_t limitFrameFormat;
   uint8_t restrictSubbands;
   uint8_t enhancedEnabled;
+  /* Boolean, set by OI_CODEC_SBC_DecoderConfigureMSbc() */
+  uint8_t mSbcEnabled;
   uint8_t bufferedBlocks;
 } OI_CODEC_SBC_DECODER_CONTEXT;
 
@@ -328,6 +334,20 @@ OI_STATUS OI_CODEC_SBC_DecoderConfigureRaw(
     uint8_t mode, uint8_t subbands, uint8_t blocks, uint8_t alloc,
     uint8_t maxBitpool);
 
+/**
+ * This function sets the decoder up for an mSBC stream, as carried over eSCO
+ * by the Hands-Free Profile wideband speech. mSBC frames have a fixed format
+ * (16 kHz, mono, 8 subbands, 15 blocks, loudness allocation, bitpool 26) and
+ * their header only holds the mSBC syncword followed by two reserved bytes.
+ * OI_CODEC_SBC_DecoderReset must be called prior to calling this function.
+ * After it is called, OI_CODEC_SBC_DecodeFrame() only looks for mSBC frames.
+ *
+ * @param context        Decoder context structure, to be used for every frame
+ *                       of the stream.
+ */
+OI_STATUS OI_CODEC_SBC_DecoderConfigureMSbc(
+    OI_CODEC_SBC_DECODER_CONTEXT* context);
+
 /**
  * Decode one SBC frame. The frame has no header bytes. The context must have
  * been previously initialized by calling  OI_CODEC_SBC_DecoderConfigureRaw().
@@ -90,6 +90,28 @@ OI_STATUS OI_CODEC_SBC_DecoderConfigureRaw(
   return OI_OK;
 }
 
+OI_STATUS OI_CODEC_SBC_DecoderConfigureMSbc(
+    OI_CODEC_SBC_DECODER_CONTEXT* context) {
+  context->common.frameInfo.enhanced = FALSE;
+  context->common.frameInfo.freqIndex = SBC_FREQ_16000;
+  context->common.frameInfo.mode = SBC_MONO;
+  context->common.frameInfo.subbands = SBC_SUBBANDS_8;
+  context->common.frameInfo.blocks = SBC_BLOCKS_15;
+  context->common.frameInfo.alloc = SBC_LOUDNESS;
+  context->common.frameInfo.bitpool = 26;
+
+  OI_SBC_ExpandFrameFields(&context->common.frameInfo);
+
+  if (context->common.frameInfo.nrof_channels > context->common.maxChannels) {
+    return OI_STATUS_INVALID_PARAMETERS;
+  }
+
+  context->mSbcEnabled = TRUE;
+  context->enhancedEnabled = FALSE;
+  context->limitFrameFormat = FALSE;
+  return OI_OK;
+}
+
 OI_STATUS OI_CODEC_SBC_DecodeRaw(OI_CODEC_SBC_DECODER_CONTEXT* context,
                                  uint8_t bitpool, const OI_BYTE** frameData,
                                  uint32_t* frameBytes, int16_t* pcmData,
@@ -90,7 +90,15 @@ INLINE void OI_SBC_ReadHeader(OI_CODEC_SBC_COMMON_CONTEXT* common,
   OI_CODEC_SBC_FRAME_INFO* frame = &common->frameInfo;
   uint8_t d1;
 
-  OI_ASSERT(data[0] == OI_SBC_SYNCWORD || data[0] == OI_SBC_ENHANCED_SYNCWORD);
+  OI_ASSERT(data[0] == OI_SBC_SYNCWORD || data[0] == OI_SBC_ENHANCED_SYNCWORD ||
+            data[0] == OI_mSBC_SYNCWORD);
+
+  if (data[0] == OI_mSBC_SYNCWORD) {
+    /* The frame format was set by OI_CODEC_SBC_DecoderConfigureMSbc(), the
+     * two header bytes are reserved */
+    frame->crc = data[3];
+    return;
+  }
 
   /* Avoid filling out all these strucutures if we already remember the values
    * from last time. Just in case we get a stream corresponding to data[1] ==
@@ -56,6 +56,20 @@ PRIVATE OI_STATUS FindSyncword(OI_CODEC_SBC_DECODER_CONTEXT* context,
     return OI_CODEC_SBC_NOT_ENOUGH_HEADER_DATA;
   }
 
+  if (context->mSbcEnabled) {
+    /* An mSBC stream only carries mSBC frames */
+    while (*frameBytes && (**frameData != OI_mSBC_SYNCWORD)) {
+      (*frameBytes)--;
+      (*frameData)++;
+    }
+    if (*frameBytes) {
+      context->common.frameInfo.enhanced = FALSE;
+      return OI_OK;
+    } else {
+      return OI_CODEC_SBC_NO_SYNCWORD;
+    }
+  }
+
 #ifdef SBC_ENHANCED
   if (context->limitFrameFormat && context->enhancedEnabled) {
     /* If the context is restricted, only search for specified SYNCWORD */
@@ -38,7 +38,8 @@ const OI_CHAR* const OI_CODEC_SBC_ModeText[] = {
 const OI_CHAR* const OI_CODEC_SBC_SubbandsText[] = {"SBC_SUBBANDS_4",
                                                     "SBC_SUBBANDS_8"};
 const OI_CHAR* const OI_CODEC_SBC_BlocksText[] = {
-    "SBC_BLOCKS_4", "SBC_BLOCKS_8", "SBC_BLOCKS_12", "SBC_BLOCKS_16"};
+    "SBC_BLOCKS_4", "SBC_BLOCKS_8", "SBC_BLOCKS_12", "SBC_BLOCKS_16",
+    "SBC_BLOCKS_15"};
 const OI_CHAR* const OI_CODEC_SBC_AllocText[] = {"SBC_LOUDNESS", "SBC_SNR"};
 
 #ifdef OI_DEBUG
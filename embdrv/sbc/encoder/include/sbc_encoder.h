@@ -63,6 +63,15 @@
 #define SBC_BLOCK_2 12
 #define SBC_BLOCK_3 16
 
+/* mSBC, the Hands-Free Profile wideband speech codec, is SBC with a fixed
+ * format: 16 kHz, mono, 8 subbands, 15 blocks, loudness allocation and a
+ * bitpool of 26. Its frame header only holds a syncword. */
+#define SBC_FORMAT_GENERAL 0
+#define SBC_FORMAT_MSBC 1
+
+#define SBC_MSBC_BLOCKS 15
+#define SBC_MSBC_BITPOOL 26
+
 #define SBC_NULL 0
 
 #ifndef SBC_MAX_NUM_FRAME
@@ -185,6 +194,14 @@ typedef struct SBC_ENC_PARAMS_TAG {
 
   uint16_t FrameHeader;
 
+  uint8_t Format; /* SBC_FORMAT_GENERAL or SBC_FORMAT_MSBC */
+
+  /* Analysis filter state, kept per encoder so that encoders of different
+   * streams can run side by side */
+  int32_t s32X[ENC_VX_BUFFER_SIZE / 2]; /* input history, 32 bits aligned for
+                                           the SHIFTUP macros */
+  int16_t ShiftCounter;
+  int16_t EncMaxShiftCounter;
 } SBC_ENC_PARAMS;
 
 #ifdef __cplusplus
@@ -27,13 +27,6 @@
 #include "bt_target.h"
 #include "sbc_enc_func_declare.h"
 
-int16_t EncMaxShiftCounter;
-
-#if (SBC_JOINT_STE_INCLUDED == TRUE)
-int32_t s32LRDiff[SBC_MAX_NUM_OF_BLOCKS] = {0};
-int32_t s32LRSum[SBC_MAX_NUM_OF_BLOCKS] = {0};
-#endif
-
 uint32_t SBC_Encode(SBC_ENC_PARAMS* pstrEncParams, int16_t* input,
                     uint8_t* output) {
   int32_t s32Ch;                 /* counter for ch*/
@@ -49,6 +42,8 @@ uint32_t SBC_Encode(SBC_ENC_PARAMS* pstrEncParams, int16_t* input,
   int32_t s32MaxValue2;
   uint32_t u32CountSum, u32CountDiff;
   int32_t *pSum, *pDiff;
+  int32_t s32LRDiff[SBC_MAX_NUM_OF_BLOCKS];
+  int32_t s32LRSum[SBC_MAX_NUM_OF_BLOCKS];
 #endif
   register int32_t s32NumOfSubBands = pstrEncParams->s16NumOfSubBands;
 
@@ -167,6 +162,15 @@ void SBC_Encoder_Init(SBC_ENC_PARAMS* pstrEncParams) {
   int16_t s16FrameLen;      /*to store frame length*/
   uint16_t HeaderParams;
 
+  /* mSBC has a single format */
+  if (pstrEncParams->Format == SBC_FORMAT_MSBC) {
+    pstrEncParams->s16SamplingFreq = SBC_sf16000;
+    pstrEncParams->s16ChannelMode = SBC_MONO;
+    pstrEncParams->s16NumOfSubBands = SUB_BANDS_8;
+    pstrEncParams->s16NumOfBlocks = SBC_MSBC_BLOCKS;
+    pstrEncParams->s16AllocationMethod = SBC_LOUDNESS;
+  }
+
   /* Required number of channels */
   if (pstrEncParams->s16ChannelMode == SBC_MONO)
     pstrEncParams->s16NumOfChannels = 1;
@@ -227,6 +231,9 @@ void SBC_Encoder_Init(SBC_ENC_PARAMS* pstrEncParams) {
             : s16Bitpool;
   }
 
+  if (pstrEncParams->Format == SBC_FORMAT_MSBC)
+    pstrEncParams->s16BitPool = SBC_MSBC_BITPOOL;
+
   if (pstrEncParams->s16BitPool < 0) pstrEncParams->s16BitPool = 0;
   /* sampling freq */
   HeaderParams = ((pstrEncParams->s16SamplingFreq & 3) << 6);
@@ -244,15 +251,19 @@ void SBC_Encoder_Init(SBC_ENC_PARAMS* pstrEncParams) {
 
   if (pstrEncParams->s16NumOfSubBands == 4) {
     if (pstrEncParams->s16NumOfChannels == 1)
-      EncMaxShiftCounter = ((ENC_VX_BUFFER_SIZE - 4 * 10) >> 2) << 2;
+      pstrEncParams->EncMaxShiftCounter =
+          ((ENC_VX_BUFFER_SIZE - 4 * 10) >> 2) << 2;
     else
-      EncMaxShiftCounter = ((ENC_VX_BUFFER_SIZE - 4 * 10 * 2) >> 3) << 2;
+      pstrEncParams->EncMaxShiftCounter =
+          ((ENC_VX_BUFFER_SIZE - 4 * 10 * 2) >> 3) << 2;
   } else {
     if (pstrEncParams->s16NumOfChannels == 1)
-      EncMaxShiftCounter = ((ENC_VX_BUFFER_SIZE - 8 * 10) >> 3) << 3;
+      pstrEncParams->EncMaxShiftCounter =
+          ((ENC_VX_BUFFER_SIZE - 8 * 10) >> 3) << 3;
     else
-      EncMaxShiftCounter = ((ENC_VX_BUFFER_SIZE - 8 * 10 * 2) >> 4) << 3;
+      pstrEncParams->EncMaxShiftCounter =
+          ((ENC_VX_BUFFER_SIZE - 8 * 10 * 2) >> 4) << 3;
   }
 
-  SbcAnalysisInit();
+  SbcAnalysisInit(pstrEncParams);
 }
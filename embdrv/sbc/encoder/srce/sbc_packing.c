@@ -79,11 +79,16 @@ uint32_t EncPacking(SBC_ENC_PARAMS* pstrEncParams, uint8_t* output) {
 #endif
 #endif
 
-  pu8PacketPtr = output;           /*Initialize the ptr*/
-  *pu8PacketPtr++ = (uint8_t)0x9C; /*Sync word*/
-  *pu8PacketPtr++ = (uint8_t)(pstrEncParams->FrameHeader);
-
-  *pu8PacketPtr = (uint8_t)(pstrEncParams->s16BitPool & 0x00FF);
+  pu8PacketPtr = output; /*Initialize the ptr*/
+  if (pstrEncParams->Format == SBC_FORMAT_MSBC) {
+    *pu8PacketPtr++ = (uint8_t)0xAD; /*Sync word*/
+    *pu8PacketPtr++ = (uint8_t)0x00; /*Reserved*/
+    *pu8PacketPtr = (uint8_t)0x00;   /*Reserved*/
+  } else {
+    *pu8PacketPtr++ = (uint8_t)0x9C; /*Sync word*/
+    *pu8PacketPtr++ = (uint8_t)(pstrEncParams->FrameHeader);
+    *pu8PacketPtr = (uint8_t)(pstrEncParams->s16BitPool & 0x00FF);
+  }
   pu8PacketPtr += 2; /*skip for CRC*/
 
   /*here it indicate if it is byte boundary or nibble boundary*/
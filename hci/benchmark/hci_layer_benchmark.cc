@@ -0,0 +1,247 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Command throughput of the legacy HCI layer against a fake controller. The
+ * controller answers every command with a Command Complete event after a fixed
+ * latency, standing in for the transport round trip, and accepts as many
+ * commands at once as its command buffer allows. */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include "hci/src/hci_layer.cc"
+#include "osi/include/allocator.h"
+#include "stack/include/bt_types.h"
+#include "stack/include/hcidefs.h"
+
+using ::benchmark::State;
+
+#define COMMANDS_PER_ITERATION 100
+
+namespace {
+
+allocator_t benchmark_allocator = {
+    .alloc = osi_malloc,
+    .free = osi_free,
+};
+
+class FakeController {
+ public:
+  void Start(int command_buffers, int latency_us) {
+    command_buffers_ = command_buffers;
+    latency_ = std::chrono::microseconds(latency_us);
+    running_ = true;
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void Receive(const BT_HDR* command) {
+    const uint8_t* stream = command->data + command->offset;
+    uint16_t opcode;
+    STREAM_TO_UINT16(opcode, stream);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      received_.push_back({std::chrono::steady_clock::now() + latency_, opcode});
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  struct Received {
+    std::chrono::steady_clock::time_point respond_at;
+    uint16_t opcode;
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+      if (received_.empty()) {
+        cv_.wait(lock);
+        continue;
+      }
+      if (std::chrono::steady_clock::now() < received_.front().respond_at) {
+        cv_.wait_until(lock, received_.front().respond_at);
+        continue;
+      }
+
+      uint16_t opcode = received_.front().opcode;
+      received_.pop_front();
+      int credits = command_buffers_ - received_.size();
+      lock.unlock();
+      SendCommandComplete(opcode, credits);
+      lock.lock();
+    }
+  }
+
+  void SendCommandComplete(uint16_t opcode, int credits) {
+    BT_HDR* event = static_cast<BT_HDR*>(
+        osi_calloc(sizeof(BT_HDR) + HCIE_PREAMBLE_SIZE + 4));
+    event->event = MSG_HC_TO_STACK_HCI_EVT;
+    event->len = HCIE_PREAMBLE_SIZE + 4;
+    uint8_t* stream = event->data;
+    UINT8_TO_STREAM(stream, HCI_COMMAND_COMPLETE_EVT);
+    UINT8_TO_STREAM(stream, 4);
+    UINT8_TO_STREAM(stream, credits);
+    UINT16_TO_STREAM(stream, opcode);
+    UINT8_TO_STREAM(stream, HCI_SUCCESS);
+    hci_event_received(FROM_HERE, event);
+  }
+
+  int command_buffers_;
+  std::chrono::microseconds latency_;
+  bool running_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Received> received_;
+  std::thread thread_;
+};
+
+FakeController fake_controller;
+
+void capture(const BT_HDR* packet, bool is_received) {}
+
+const btsnoop_t fake_btsnoop = {.capture = capture};
+
+// Commands fit in one fragment
+void fragment_and_dispatch(BT_HDR* packet) { transmit_fragment(packet, true); }
+
+const packet_fragmenter_t fake_packet_fragmenter = {
+    .fragment_and_dispatch = fragment_and_dispatch};
+
+BT_HDR* make_command(uint16_t opcode) {
+  BT_HDR* command =
+      static_cast<BT_HDR*>(osi_calloc(sizeof(BT_HDR) + HCIC_PREAMBLE_SIZE));
+  command->len = HCIC_PREAMBLE_SIZE;
+  uint8_t* stream = command->data;
+  UINT16_TO_STREAM(stream, opcode);
+  UINT8_TO_STREAM(stream, 0);
+  return command;
+}
+
+std::mutex completed_mutex;
+std::condition_variable completed_cv;
+int completed;
+
+void command_complete(BT_HDR* response, void* context) {
+  osi_free(response);
+  {
+    std::lock_guard<std::mutex> lock(completed_mutex);
+    completed++;
+  }
+  completed_cv.notify_one();
+}
+
+}  // namespace
+
+void hci_initialize() {}
+void hci_close() {}
+void hci_transmit(BT_HDR* packet) { fake_controller.Receive(packet); }
+int hci_open_firmware_log_file() { return INVALID_FD; }
+void hci_close_firmware_log_file(int fd) {}
+void hci_log_firmware_debug_packet(int fd, BT_HDR* packet) {}
+const allocator_t* buffer_allocator_get_interface() {
+  return &benchmark_allocator;
+}
+
+class BM_HciLayer : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    hci_layer_get_test_interface(&benchmark_allocator, &fake_btsnoop,
+                                 &fake_packet_fragmenter);
+    // As after a reset, until the controller reports its command buffers
+    command_credits = 1;
+    hci_thread.StartUp();
+    fake_controller.Start(st.range(0), st.range(1));
+  }
+
+  void TearDown(State& st) override {
+    hci_thread.ShutDown();
+    fake_controller.Stop();
+    clear_waiting_commands();
+    command_latency.clear();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  void ReportRate(State& state) {
+    state.counters["commands_per_second"] = ::benchmark::Counter(
+        state.iterations() * COMMANDS_PER_ITERATION,
+        ::benchmark::Counter::kIsRate);
+  }
+};
+
+// Each command waits for the previous one to complete
+BENCHMARK_DEFINE_F(BM_HciLayer, await_each)(State& state) {
+  for (auto _ : state) {
+    for (int i = 0; i < COMMANDS_PER_ITERATION; i++) {
+      future_t* future = interface.transmit_command_futured(
+          make_command(HCI_READ_LOCAL_VERSION_INFO));
+      osi_free(future_await(future));
+    }
+  }
+  ReportRate(state);
+}
+
+// All commands are sent at once, the HCI layer paces them to the credits
+BENCHMARK_DEFINE_F(BM_HciLayer, pipelined)(State& state) {
+  for (auto _ : state) {
+    completed = 0;
+    for (int i = 0; i < COMMANDS_PER_ITERATION; i++) {
+      interface.transmit_command(make_command(HCI_READ_LOCAL_VERSION_INFO + i),
+                                 command_complete, NULL, NULL);
+    }
+    std::unique_lock<std::mutex> lock(completed_mutex);
+    completed_cv.wait(lock,
+                      []() { return completed == COMMANDS_PER_ITERATION; });
+  }
+  ReportRate(state);
+}
+
+// Arguments are the controller command buffers and its latency in us
+BENCHMARK_REGISTER_F(BM_HciLayer, await_each)
+    ->Args({1, 0})
+    ->Args({1, 250})
+    ->Args({8, 250});
+BENCHMARK_REGISTER_F(BM_HciLayer, pipelined)
+    ->Args({1, 0})
+    ->Args({1, 250})
+    ->Args({4, 0})
+    ->Args({4, 250})
+    ->Args({8, 250});
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
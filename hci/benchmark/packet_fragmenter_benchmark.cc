@@ -0,0 +1,241 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* ACL reassembly of LE traffic: L2CAP packets of the maximum LE MTU sent over
+ * 27 byte LE fragments, interleaved across connections the way the controller
+ * delivers them. The fragments are allocated like the transport does, one
+ * buffer each, and the reassembled packets are freed by the sink. */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "hci/src/packet_fragmenter.cc"
+#include "osi/include/allocator.h"
+
+using ::benchmark::State;
+
+#define L2CAP_PAYLOAD_SIZE 1021
+#define LE_FRAGMENT_SIZE 27
+#define PACKETS_PER_CONNECTION 16
+
+namespace {
+
+allocator_t benchmark_allocator = {
+    .alloc = osi_malloc,
+    .free = osi_free,
+};
+
+uint64_t packets_reassembled;
+
+void on_reassembled(BT_HDR* packet) {
+  benchmark::DoNotOptimize(packet->data[packet->len - 1]);
+  osi_free(packet);
+  packets_reassembled++;
+}
+
+const packet_fragmenter_callbacks_t benchmark_callbacks = {
+    .reassembled = on_reassembled,
+};
+
+BT_HDR* make_fragment(uint16_t handle, bool start, const uint8_t* data,
+                      uint16_t len) {
+  BT_HDR* packet = (BT_HDR*)osi_malloc(sizeof(BT_HDR) + HCI_ACL_PREAMBLE_SIZE +
+                                       len);
+  packet->event = MSG_HC_TO_STACK_HCI_ACL;
+  packet->offset = 0;
+  packet->layer_specific = 0;
+  packet->len = HCI_ACL_PREAMBLE_SIZE + len;
+  uint8_t* stream = packet->data;
+  UINT16_TO_STREAM(stream, start ? APPLY_START_FLAG(handle)
+                                 : APPLY_CONTINUATION_FLAG(handle));
+  UINT16_TO_STREAM(stream, len);
+  memcpy(stream, data, len);
+  return packet;
+}
+
+/* Previous reassembly: same copies, partial packets in a hash map */
+std::unordered_map<uint16_t, BT_HDR*> map_partial_packets;
+
+void reassemble_map(BT_HDR* packet) {
+  uint8_t* stream = packet->data;
+  uint16_t handle;
+  STREAM_TO_UINT16(handle, stream);
+  STREAM_SKIP_UINT16(stream);
+  uint8_t boundary_flag = GET_BOUNDARY_FLAG(handle);
+  handle = handle & HANDLE_MASK;
+
+  if (boundary_flag == START_PACKET_BOUNDARY) {
+    uint16_t l2cap_length;
+    STREAM_TO_UINT16(l2cap_length, stream);
+    uint16_t full_length =
+        l2cap_length + L2CAP_HEADER_SIZE + HCI_ACL_PREAMBLE_SIZE;
+    BT_HDR* partial_packet = (BT_HDR*)osi_malloc(full_length + sizeof(BT_HDR));
+    partial_packet->event = packet->event;
+    partial_packet->len = full_length;
+    partial_packet->offset = packet->len;
+    memcpy(partial_packet->data, packet->data, packet->len);
+    map_partial_packets[handle] = partial_packet;
+    osi_free(packet);
+    return;
+  }
+
+  auto map_iter = map_partial_packets.find(handle);
+  BT_HDR* partial_packet = map_iter->second;
+  uint16_t len = packet->len - HCI_ACL_PREAMBLE_SIZE;
+  memcpy(partial_packet->data + partial_packet->offset,
+         packet->data + HCI_ACL_PREAMBLE_SIZE, len);
+  osi_free(packet);
+  partial_packet->offset += len;
+  if (partial_packet->offset == partial_packet->len) {
+    map_partial_packets.erase(handle);
+    partial_packet->offset = 0;
+    on_reassembled(partial_packet);
+  }
+}
+
+/* Fragments kept in a chain and coalesced once the packet is complete. L2CAP
+ * needs contiguous packets, so every byte is still copied once. */
+struct Chain {
+  std::vector<BT_HDR*> fragments;
+  uint16_t full_length;
+  uint16_t received;
+};
+Chain chains[HANDLE_MASK + 1];
+
+void reassemble_chain(BT_HDR* packet) {
+  uint8_t* stream = packet->data;
+  uint16_t handle;
+  STREAM_TO_UINT16(handle, stream);
+  STREAM_SKIP_UINT16(stream);
+  uint8_t boundary_flag = GET_BOUNDARY_FLAG(handle);
+  Chain& chain = chains[handle & HANDLE_MASK];
+
+  if (boundary_flag == START_PACKET_BOUNDARY) {
+    uint16_t l2cap_length;
+    STREAM_TO_UINT16(l2cap_length, stream);
+    chain.full_length =
+        l2cap_length + L2CAP_HEADER_SIZE + HCI_ACL_PREAMBLE_SIZE;
+    chain.received = packet->len;
+  } else {
+    chain.received += packet->len - HCI_ACL_PREAMBLE_SIZE;
+  }
+  chain.fragments.push_back(packet);
+  if (chain.received < chain.full_length) return;
+
+  BT_HDR* full_packet = (BT_HDR*)osi_malloc(chain.full_length + sizeof(BT_HDR));
+  full_packet->event = packet->event;
+  full_packet->len = chain.full_length;
+  full_packet->offset = 0;
+  uint16_t offset = 0;
+  for (size_t i = 0; i < chain.fragments.size(); i++) {
+    BT_HDR* fragment = chain.fragments[i];
+    uint16_t skip = i == 0 ? 0 : HCI_ACL_PREAMBLE_SIZE;
+    memcpy(full_packet->data + offset, fragment->data + skip,
+           fragment->len - skip);
+    offset += fragment->len - skip;
+    osi_free(fragment);
+  }
+  chain.fragments.clear();
+  on_reassembled(full_packet);
+}
+
+}  // namespace
+
+// Needed for linkage
+const controller_t* controller_get_interface() { return nullptr; }
+
+class BM_AclReassembly : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    buffer_allocator = &benchmark_allocator;
+    init(&benchmark_callbacks);
+    packets_reassembled = 0;
+
+    // L2CAP header followed by the payload
+    payload_.resize(L2CAP_HEADER_SIZE + L2CAP_PAYLOAD_SIZE);
+    uint8_t* stream = payload_.data();
+    UINT16_TO_STREAM(stream, L2CAP_PAYLOAD_SIZE);
+    UINT16_TO_STREAM(stream, 0x0040);
+    for (size_t i = L2CAP_HEADER_SIZE; i < payload_.size(); i++)
+      payload_[i] = i;
+  }
+
+  void TearDown(State& st) override {
+    cleanup();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  void Run(State& state, void (*reassemble)(BT_HDR*)) {
+    int connections = state.range(0);
+    for (auto _ : state) {
+      for (int p = 0; p < PACKETS_PER_CONNECTION; p++) {
+        for (size_t offset = 0; offset < payload_.size();
+             offset += LE_FRAGMENT_SIZE) {
+          uint16_t len = std::min<size_t>(LE_FRAGMENT_SIZE,
+                                          payload_.size() - offset);
+          for (int c = 0; c < connections; c++) {
+            reassemble(make_fragment(c + 1, offset == 0,
+                                     payload_.data() + offset, len));
+          }
+        }
+      }
+    }
+    CHECK(packets_reassembled ==
+          state.iterations() * connections * PACKETS_PER_CONNECTION);
+    state.SetBytesProcessed(state.iterations() * connections *
+                            PACKETS_PER_CONNECTION * payload_.size());
+    state.counters["packets_per_second"] = ::benchmark::Counter(
+        packets_reassembled, ::benchmark::Counter::kIsRate);
+  }
+
+  std::vector<uint8_t> payload_;
+};
+
+BENCHMARK_DEFINE_F(BM_AclReassembly, map_copy)(State& state) {
+  Run(state, reassemble_map);
+}
+
+BENCHMARK_DEFINE_F(BM_AclReassembly, chain_coalesce)(State& state) {
+  Run(state, reassemble_chain);
+}
+
+BENCHMARK_DEFINE_F(BM_AclReassembly, in_place)(State& state) {
+  Run(state, reassemble_and_dispatch);
+}
+
+// Argument is the number of connections
+BENCHMARK_REGISTER_F(BM_AclReassembly, map_copy)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK_REGISTER_F(BM_AclReassembly, chain_coalesce)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16);
+BENCHMARK_REGISTER_F(BM_AclReassembly, in_place)->Arg(1)->Arg(4)->Arg(16);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
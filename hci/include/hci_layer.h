@@ -100,4 +100,7 @@ const hci_t* hci_layer_get_test_interface(
 void post_to_main_message_loop(const base::Location& from_here, BT_HDR* p_msg);
 
 void hci_layer_cleanup_interface();
+
+// Dumps the command flow control state and the per opcode command latency.
+void hci_layer_dump(int fd);
 bool hci_is_root_inflammation_event_received();
@@ -55,6 +55,9 @@ typedef struct packet_fragmenter_t {
   // callback is called
   // with the reassembled data.
   void (*reassemble_and_dispatch)(BT_HDR* packet);
+
+  // Dumps the reassembly statistics to |fd|.
+  void (*dump)(int fd);
 } packet_fragmenter_t;
 
 const packet_fragmenter_t* packet_fragmenter_get_interface();
@@ -27,18 +27,23 @@
 #include <base/threading/thread.h>
 #include <frameworks/base/core/proto/android/bluetooth/hci/enums.pb.h>
 
+#include <inttypes.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <chrono>
+#include <map>
 #include <mutex>
+#include <queue>
+#include <unordered_map>
 
 #include "btcore/include/module.h"
 #include "btif/include/btif_bqr.h"
 #include "btsnoop.h"
 #include "buffer_allocator.h"
+#include "common/a2dp_latency_tracer.h"
 #include "common/message_loop_thread.h"
 #include "common/metrics.h"
 #include "common/once_timer.h"
@@ -48,7 +53,6 @@
 #include "hcimsgs.h"
 #include "main/shim/shim.h"
 #include "osi/include/alarm.h"
-#include "osi/include/list.h"
 #include "osi/include/log.h"
 #include "osi/include/properties.h"
 #include "osi/include/reactor.h"
@@ -68,7 +72,7 @@ extern void hci_log_firmware_debug_packet(int fd, BT_HDR* packet);
 
 static int hci_firmware_log_fd = INVALID_FD;
 
-typedef struct {
+typedef struct waiting_command_t {
   uint16_t opcode;
   future_t* complete_future;
   command_complete_cb complete_callback;
@@ -76,8 +80,45 @@ typedef struct {
   void* context;
   BT_HDR* command;
   std::chrono::time_point<std::chrono::steady_clock> timestamp;
+
+  // Links of the commands pending response, in the order they were sent
+  struct waiting_command_t* prev;
+  struct waiting_command_t* next;
+  // Next command pending response with the same opcode
+  struct waiting_command_t* next_same_opcode;
 } waiting_command_t;
 
+// Commands pending response with a given opcode, oldest first
+typedef struct {
+  waiting_command_t* first;
+  waiting_command_t* last;
+} opcode_pending_t;
+
+// Commands sent to the controller and waiting for their Command Complete or
+// Command Status event. They are linked in the order they were sent, and
+// indexed by opcode: the controller answers the commands with the same opcode
+// in order, so the oldest pending command of the event's opcode is the one
+// being answered.
+typedef struct {
+  waiting_command_t* oldest;
+  waiting_command_t* newest;
+  int count;
+  // Entries are kept once created, there are only so many opcodes in use
+  std::unordered_map<command_opcode_t, opcode_pending_t> by_opcode;
+} pending_commands_t;
+
+// Command latency, from the command being sent to its Command Complete or
+// Command Status event. Bucket |i| counts latencies under 2^(i+1) us, the
+// last one everything above.
+#define HCI_COMMAND_LATENCY_BUCKETS 22
+
+typedef struct {
+  uint64_t count;
+  uint64_t total_us;
+  uint64_t max_us;
+  uint64_t buckets[HCI_COMMAND_LATENCY_BUCKETS];
+} command_latency_t;
+
 // Using a define here, because it can be stringified for the property lookup
 // Default timeout should be less than BLE_START_TIMEOUT and
 // having less than 3 sec would hold the wakelock for init
@@ -109,11 +150,13 @@ static alarm_t* startup_timer;
 // Outbound-related
 static int command_credits = 1;
 static std::mutex command_credits_mutex;
-static std::queue<base::Closure> command_queue;
+static std::queue<waiting_command_t*> command_queue;
+static bool send_commands_scheduled;
 
 // Inbound-related
 static alarm_t* command_response_timer;
-static list_t* commands_pending_response;
+static pending_commands_t commands_pending_response;
+static std::unordered_map<command_opcode_t, command_latency_t> command_latency;
 static std::recursive_timed_mutex commands_pending_response_mutex;
 static OnceTimer abort_timer;
 
@@ -125,8 +168,11 @@ static uint8_t root_inflamed_vendor_error_code = 0;
 static base::Callback<void(const base::Location&, BT_HDR*)> send_data_upwards;
 
 static bool filter_incoming_event(BT_HDR* packet);
-static waiting_command_t* get_waiting_command(command_opcode_t opcode);
+static void add_waiting_command(waiting_command_t* wait_entry);
+static waiting_command_t* get_waiting_command(command_opcode_t opcode,
+                                              int* sent_after);
 static int get_num_waiting_commands();
+static void clear_waiting_commands();
 
 static void hci_root_inflamed_abort();
 static void hci_timeout_abort(void);
@@ -134,7 +180,8 @@ static void event_finish_startup(void* context);
 static void startup_timer_expired(void* context);
 
 static void enqueue_command(waiting_command_t* wait_entry);
-static void event_command_ready(waiting_command_t* wait_entry);
+static void schedule_send_commands();
+static void event_commands_ready();
 static void enqueue_packet(void* packet);
 static void event_packet_ready(void* packet);
 static void command_timed_out(void* context);
@@ -235,14 +282,6 @@ static future_t* hci_module_start_up(void) {
     goto error;
   }
 
-  commands_pending_response = list_new(NULL);
-  if (!commands_pending_response) {
-    LOG_ERROR(LOG_TAG,
-              "%s unable to create list for commands pending response.",
-              __func__);
-    goto error;
-  }
-
   // Make sure we run in a bounded amount of time
   future_t* local_startup_future;
   local_startup_future = future_new();
@@ -279,11 +318,17 @@ static future_t* hci_module_shut_down() {
   // Close HCI to prevent callbacks.
   hci_close();
 
+  clear_waiting_commands();
+
   {
-    std::lock_guard<std::recursive_timed_mutex> lock(
-        commands_pending_response_mutex);
-    list_free(commands_pending_response);
-    commands_pending_response = NULL;
+    std::lock_guard<std::mutex> command_credits_lock(command_credits_mutex);
+    while (!command_queue.empty()) {
+      waiting_command_t* wait_entry = command_queue.front();
+      command_queue.pop();
+      buffer_allocator->free(wait_entry->command);
+      osi_free(wait_entry);
+    }
+    send_commands_scheduled = false;
   }
 
   packet_fragmenter->cleanup();
@@ -391,32 +436,54 @@ static void startup_timer_expired(UNUSED_ATTR void* context) {
 
 // Command/packet transmitting functions
 static void enqueue_command(waiting_command_t* wait_entry) {
-  base::Closure callback = base::Bind(&event_command_ready, wait_entry);
-
   std::lock_guard<std::mutex> command_credits_lock(command_credits_mutex);
-  if (command_credits > 0) {
-    if (!hci_thread.DoInThread(FROM_HERE, std::move(callback))) {
-      // HCI Layer was shut down or not running
-      buffer_allocator->free(wait_entry->command);
-      osi_free(wait_entry);
-      return;
-    }
-    command_credits--;
-  } else {
-    command_queue.push(std::move(callback));
+  if (!hci_thread.IsRunning()) {
+    // HCI Layer was shut down or not running
+    buffer_allocator->free(wait_entry->command);
+    osi_free(wait_entry);
+    return;
   }
+
+  command_queue.push(wait_entry);
+  schedule_send_commands();
 }
 
-static void event_command_ready(waiting_command_t* wait_entry) {
-  {
-    /// Move it to the list of commands awaiting response
-    std::lock_guard<std::recursive_timed_mutex> lock(
-        commands_pending_response_mutex);
-    wait_entry->timestamp = std::chrono::steady_clock::now();
-    list_append(commands_pending_response, wait_entry);
+// Has the HCI thread send the queued commands, if there are credits for them
+// and it isn't about to already. Called with |command_credits_mutex| held.
+static void schedule_send_commands() {
+  if (command_credits <= 0 || command_queue.empty() || send_commands_scheduled)
+    return;
+
+  if (!hci_thread.DoInThread(FROM_HERE, base::Bind(&event_commands_ready))) {
+    LOG(ERROR) << __func__ << ": failed to enqueue commands";
+    return;
+  }
+  send_commands_scheduled = true;
+}
+
+// Sends as many queued commands as there are credits, so that a burst of
+// commands costs one hop to the HCI thread instead of one per command.
+static void event_commands_ready() {
+  for (;;) {
+    waiting_command_t* wait_entry;
+    {
+      std::lock_guard<std::mutex> command_credits_lock(command_credits_mutex);
+      if (command_credits <= 0 || command_queue.empty()) {
+        send_commands_scheduled = false;
+        break;
+      }
+      wait_entry = command_queue.front();
+      command_queue.pop();
+      command_credits--;
+
+      // Move it to the commands awaiting response before the credits are
+      // released, so that it is accounted for by process_command_credits()
+      wait_entry->timestamp = std::chrono::steady_clock::now();
+      add_waiting_command(wait_entry);
+    }
+    // Send it off
+    packet_fragmenter->fragment_and_dispatch(wait_entry->command);
   }
-  // Send it off
-  packet_fragmenter->fragment_and_dispatch(wait_entry->command);
 
   update_command_response_timer();
 }
@@ -446,6 +513,11 @@ static void transmit_fragment(BT_HDR* packet, bool send_transmit_finished) {
       (packet->event & MSG_EVT_MASK) != MSG_STACK_TO_HC_HCI_CMD &&
       send_transmit_finished;
 
+  if ((packet->event & MSG_EVT_MASK) == MSG_STACK_TO_HC_HCI_ACL &&
+      send_transmit_finished) {
+    bluetooth::common::A2dpLatencyTracer::GetInstance().OnHciTransmit(packet);
+  }
+
   hci_transmit(packet);
 
   if (free_after_transmit) {
@@ -487,11 +559,8 @@ static void command_timed_out_log_info(void* original_wait_entry) {
   LOG_ERROR(LOG_TAG, "%s: %d commands pending response", __func__,
             get_num_waiting_commands());
 
-  for (const list_node_t* node = list_begin(commands_pending_response);
-       node != list_end(commands_pending_response); node = list_next(node)) {
-    waiting_command_t* wait_entry =
-        reinterpret_cast<waiting_command_t*>(list_node(node));
-
+  for (waiting_command_t* wait_entry = commands_pending_response.oldest;
+       wait_entry != NULL; wait_entry = wait_entry->next) {
     int wait_time_ms =
         std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - wait_entry->timestamp)
@@ -568,7 +637,12 @@ static void command_timed_out(void* original_wait_entry) {
 }
 
 // Event/packet receiving functions
-void process_command_credits(int credits) {
+
+// |in_flight| is the number of commands the controller may not have received
+// yet when it reported |credits|: the ones sent after the command it answers.
+// Counting them is conservative, it keeps about half of the controller's
+// command buffers in use when it is saturated, but never overruns them.
+void process_command_credits(int credits, int in_flight) {
   std::lock_guard<std::mutex> command_credits_lock(command_credits_mutex);
 
   if (!hci_thread.IsRunning()) {
@@ -577,15 +651,9 @@ void process_command_credits(int credits) {
   }
 
   // Subtract commands in flight.
-  command_credits = credits - get_num_waiting_commands();
+  command_credits = credits - in_flight;
 
-  while (command_credits > 0 && !command_queue.empty()) {
-    if (!hci_thread.DoInThread(FROM_HERE, std::move(command_queue.front()))) {
-      LOG(ERROR) << __func__ << ": failed to enqueue command";
-    }
-    command_queue.pop();
-    command_credits--;
-  }
+  schedule_send_commands();
 }
 
 bool hci_is_root_inflammation_event_received() {
@@ -640,6 +708,7 @@ static bool filter_incoming_event(BT_HDR* packet) {
   uint8_t event_code;
   uint8_t length;
   int credits = 0;
+  int in_flight = 0;
   command_opcode_t opcode;
 
   STREAM_TO_UINT8(event_code, stream);
@@ -649,9 +718,9 @@ static bool filter_incoming_event(BT_HDR* packet) {
     STREAM_TO_UINT8(credits, stream);
     STREAM_TO_UINT16(opcode, stream);
 
-    wait_entry = get_waiting_command(opcode);
+    wait_entry = get_waiting_command(opcode, &in_flight);
 
-    process_command_credits(credits);
+    process_command_credits(credits, in_flight);
 
     if (!wait_entry) {
       if (opcode != HCI_COMMAND_NONE) {
@@ -681,9 +750,9 @@ static bool filter_incoming_event(BT_HDR* packet) {
 
     // If a command generates a command status event, it won't be getting a
     // command complete event
-    wait_entry = get_waiting_command(opcode);
+    wait_entry = get_waiting_command(opcode, &in_flight);
 
-    process_command_credits(credits);
+    process_command_credits(credits, in_flight);
 
     if (!wait_entry) {
       LOG_WARN(
@@ -754,29 +823,105 @@ static void dispatch_reassembled(BT_HDR* packet) {
 
 // Misc internal functions
 
-static waiting_command_t* get_waiting_command(command_opcode_t opcode) {
+static void add_waiting_command(waiting_command_t* wait_entry) {
   std::lock_guard<std::recursive_timed_mutex> lock(
       commands_pending_response_mutex);
+  pending_commands_t& pending = commands_pending_response;
+
+  wait_entry->prev = pending.newest;
+  wait_entry->next = NULL;
+  if (pending.newest)
+    pending.newest->next = wait_entry;
+  else
+    pending.oldest = wait_entry;
+  pending.newest = wait_entry;
+  pending.count++;
+
+  opcode_pending_t& same_opcode = pending.by_opcode[wait_entry->opcode];
+  wait_entry->next_same_opcode = NULL;
+  if (same_opcode.last)
+    same_opcode.last->next_same_opcode = wait_entry;
+  else
+    same_opcode.first = wait_entry;
+  same_opcode.last = wait_entry;
+}
 
-  for (const list_node_t* node = list_begin(commands_pending_response);
-       node != list_end(commands_pending_response); node = list_next(node)) {
-    waiting_command_t* wait_entry =
-        reinterpret_cast<waiting_command_t*>(list_node(node));
-
-    if (!wait_entry || wait_entry->opcode != opcode) continue;
-
-    list_remove(commands_pending_response, wait_entry);
-
-    return wait_entry;
-  }
+static void record_command_latency(const waiting_command_t* wait_entry) {
+  uint64_t latency_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - wait_entry->timestamp)
+          .count();
+  int bucket = 0;
+  for (uint64_t v = latency_us >> 1; v != 0; v >>= 1) bucket++;
+  if (bucket >= HCI_COMMAND_LATENCY_BUCKETS)
+    bucket = HCI_COMMAND_LATENCY_BUCKETS - 1;
+
+  command_latency_t& latency = command_latency[wait_entry->opcode];
+  latency.count++;
+  latency.total_us += latency_us;
+  if (latency_us > latency.max_us) latency.max_us = latency_us;
+  latency.buckets[bucket]++;
+}
 
-  return NULL;
+// Removes and returns the oldest command pending response with |opcode|, or
+// NULL. |sent_after| is set to the number of commands still pending that were
+// sent after it, or all of them if there is no such command.
+static waiting_command_t* get_waiting_command(command_opcode_t opcode,
+                                              int* sent_after) {
+  std::lock_guard<std::recursive_timed_mutex> lock(
+      commands_pending_response_mutex);
+  pending_commands_t& pending = commands_pending_response;
+
+  *sent_after = pending.count;
+  auto it = pending.by_opcode.find(opcode);
+  if (it == pending.by_opcode.end() || it->second.first == NULL) return NULL;
+
+  opcode_pending_t& same_opcode = it->second;
+  waiting_command_t* wait_entry = same_opcode.first;
+  same_opcode.first = wait_entry->next_same_opcode;
+  if (same_opcode.first == NULL) same_opcode.last = NULL;
+
+  // Only a few commands can be in flight, this walk is bounded by the credits
+  *sent_after = 0;
+  for (waiting_command_t* newer = wait_entry->next; newer != NULL;
+       newer = newer->next)
+    (*sent_after)++;
+
+  if (wait_entry->prev)
+    wait_entry->prev->next = wait_entry->next;
+  else
+    pending.oldest = wait_entry->next;
+  if (wait_entry->next)
+    wait_entry->next->prev = wait_entry->prev;
+  else
+    pending.newest = wait_entry->prev;
+  pending.count--;
+
+  record_command_latency(wait_entry);
+  return wait_entry;
 }
 
 static int get_num_waiting_commands() {
   std::lock_guard<std::recursive_timed_mutex> lock(
       commands_pending_response_mutex);
-  return list_length(commands_pending_response);
+  return commands_pending_response.count;
+}
+
+// Drops the commands pending response, their responses won't come anymore
+static void clear_waiting_commands() {
+  std::lock_guard<std::recursive_timed_mutex> lock(
+      commands_pending_response_mutex);
+  pending_commands_t& pending = commands_pending_response;
+
+  while (pending.oldest) {
+    waiting_command_t* wait_entry = pending.oldest;
+    pending.oldest = wait_entry->next;
+    buffer_allocator->free(wait_entry->command);
+    osi_free(wait_entry);
+  }
+  pending.newest = NULL;
+  pending.count = 0;
+  pending.by_opcode.clear();
 }
 
 static void update_command_response_timer(void) {
@@ -784,11 +929,11 @@ static void update_command_response_timer(void) {
       commands_pending_response_mutex);
 
   if (command_response_timer == NULL) return;
-  if (list_is_empty(commands_pending_response)) {
+  if (commands_pending_response.oldest == NULL) {
     alarm_cancel(command_response_timer);
   } else {
     alarm_set(command_response_timer, COMMAND_PENDING_TIMEOUT_MS,
-              command_timed_out, list_front(commands_pending_response));
+              command_timed_out, commands_pending_response.oldest);
   }
 }
 
@@ -846,6 +991,46 @@ static bool filter_bqr_event(int16_t bqr_parameter_length,
   return intercepted;
 }
 
+void hci_layer_dump(int fd) {
+  dprintf(fd, "\nHCI Layer:\n");
+
+  {
+    std::lock_guard<std::mutex> command_credits_lock(command_credits_mutex);
+    dprintf(fd, "  Command credits: %d, queued commands: %zu\n",
+            command_credits, command_queue.size());
+  }
+
+  if (packet_fragmenter) packet_fragmenter->dump(fd);
+
+  std::lock_guard<std::recursive_timed_mutex> lock(
+      commands_pending_response_mutex);
+  dprintf(fd, "  Commands pending response: %d\n",
+          commands_pending_response.count);
+
+  // Sorted by opcode
+  std::map<command_opcode_t, command_latency_t> latencies(
+      command_latency.begin(), command_latency.end());
+  if (latencies.empty()) return;
+
+  dprintf(fd, "  Command latency (us):\n");
+  for (const auto& it : latencies) {
+    const command_latency_t& latency = it.second;
+    dprintf(fd,
+            "    opcode 0x%04x: count=%" PRIu64 " avg=%" PRIu64 " max=%" PRIu64
+            "\n",
+            it.first, latency.count, latency.total_us / latency.count,
+            latency.max_us);
+    for (int b = 0; b < HCI_COMMAND_LATENCY_BUCKETS; b++) {
+      if (latency.buckets[b] == 0) continue;
+      if (b == HCI_COMMAND_LATENCY_BUCKETS - 1) {
+        dprintf(fd, "      >= %u: %" PRIu64 "\n", 1u << b, latency.buckets[b]);
+      } else {
+        dprintf(fd, "      < %u: %" PRIu64 "\n", 2u << b, latency.buckets[b]);
+      }
+    }
+  }
+}
+
 static void init_layer_interface() {
   if (!interface_created) {
     // It's probably ok for this to live forever. It's small and
@@ -21,11 +21,12 @@
 #include "packet_fragmenter.h"
 
 #include <base/logging.h>
+#include <inttypes.h>
 #include <string.h>
-#include <unordered_map>
 
 #include "bt_target.h"
 #include "buffer_allocator.h"
+#include "common/time_util.h"
 #include "device/include/controller.h"
 #include "hci_internals.h"
 #include "osi/include/log.h"
@@ -51,13 +52,41 @@ static const allocator_t* buffer_allocator;
 static const controller_t* controller;
 static const packet_fragmenter_callbacks_t* callbacks;
 
-static std::unordered_map<uint16_t /* handle */, BT_HDR*> partial_packets;
+// An L2CAP packet being reassembled from the ACL fragments of a connection.
+// The packet is allocated at its full length when its first fragment is
+// received, and each fragment is copied once, at its final place.
+typedef struct {
+  BT_HDR* packet;
+  uint64_t start_us;
+} partial_packet_t;
+
+// Indexed by connection handle, fragments are matched without a lookup
+static partial_packet_t partial_packets[HANDLE_MASK + 1];
+
+// Reassembly of the packets received in more than one fragment
+static struct {
+  uint64_t packets;
+  uint64_t fragments;
+  uint64_t max_fragments;
+  uint64_t bytes_copied;
+  uint64_t total_latency_us;
+  uint64_t max_latency_us;
+  // Fragments dropped, and fragments passed on or truncated with an invalid
+  // length
+  uint64_t dropped;
+} reassembly_stats;
 
 static void init(const packet_fragmenter_callbacks_t* result_callbacks) {
   callbacks = result_callbacks;
 }
 
-static void cleanup() { partial_packets.clear(); }
+static void cleanup() {
+  for (partial_packet_t& partial : partial_packets) {
+    if (partial.packet == NULL) continue;
+    buffer_allocator->free(partial.packet);
+    partial.packet = NULL;
+  }
+}
 
 static void fragment_and_dispatch(BT_HDR* packet) {
   CHECK(packet != NULL);
@@ -121,6 +150,17 @@ static bool check_uint16_overflow(uint16_t a, uint16_t b) {
   return (UINT16_MAX - a) < b;
 }
 
+static void record_reassembly(uint16_t fragments, uint64_t start_us) {
+  uint64_t latency_us = bluetooth::common::time_get_os_boottime_us() - start_us;
+  reassembly_stats.packets++;
+  reassembly_stats.fragments += fragments;
+  if (fragments > reassembly_stats.max_fragments)
+    reassembly_stats.max_fragments = fragments;
+  reassembly_stats.total_latency_us += latency_us;
+  if (latency_us > reassembly_stats.max_latency_us)
+    reassembly_stats.max_latency_us = latency_us;
+}
+
 static void reassemble_and_dispatch(BT_HDR* packet) {
   if ((packet->event & MSG_EVT_MASK) == MSG_HC_TO_STACK_HCI_ACL) {
     uint8_t* stream = packet->data;
@@ -140,6 +180,7 @@ static void reassemble_and_dispatch(BT_HDR* packet) {
       LOG_WARN(LOG_TAG, "dropping broadcast packet");
       android_errorWriteLog(0x534e4554, "169327567");
       buffer_allocator->free(packet);
+      reassembly_stats.dropped++;
       return;
     }
 
@@ -147,26 +188,28 @@ static void reassemble_and_dispatch(BT_HDR* packet) {
       if (acl_length < 2) {
         LOG_WARN(LOG_TAG, "%s invalid acl_length %d", __func__, acl_length);
         buffer_allocator->free(packet);
+        reassembly_stats.dropped++;
         return;
       }
       uint16_t l2cap_length;
       STREAM_TO_UINT16(l2cap_length, stream);
-      auto map_iter = partial_packets.find(handle);
-      if (map_iter != partial_packets.end()) {
+      partial_packet_t& partial = partial_packets[handle];
+      if (partial.packet != NULL) {
         LOG_WARN(LOG_TAG,
                  "%s found unfinished packet for handle with start packet. "
                  "Dropping old.",
                  __func__);
 
-        BT_HDR* hdl = map_iter->second;
-        partial_packets.erase(map_iter);
-        buffer_allocator->free(hdl);
+        buffer_allocator->free(partial.packet);
+        partial.packet = NULL;
+        reassembly_stats.dropped++;
       }
 
       if (acl_length < L2CAP_HEADER_PDU_LEN_SIZE) {
         LOG_WARN(LOG_TAG, "%s L2CAP packet too small (%d < %d). Dropping it.",
                  __func__, packet->len, L2CAP_HEADER_PDU_LEN_SIZE);
         buffer_allocator->free(packet);
+        reassembly_stats.dropped++;
         return;
       }
 
@@ -181,14 +224,17 @@ static void reassemble_and_dispatch(BT_HDR* packet) {
         LOG_ERROR(LOG_TAG, "%s Dropping L2CAP packet with invalid length (%d).",
                   __func__, l2cap_length);
         buffer_allocator->free(packet);
+        reassembly_stats.dropped++;
         return;
       }
 
       if (full_length <= packet->len) {
-        if (full_length < packet->len)
+        if (full_length < packet->len) {
           LOG_WARN(LOG_TAG,
                    "%s found l2cap full length %d less than the hci length %d.",
                    __func__, l2cap_length, packet->len);
+          reassembly_stats.dropped++;
+        }
 
         callbacks->reassembled(packet);
         return;
@@ -199,28 +245,33 @@ static void reassemble_and_dispatch(BT_HDR* packet) {
       partial_packet->event = packet->event;
       partial_packet->len = full_length;
       partial_packet->offset = packet->len;
+      // Number of fragments received so far, until the packet is dispatched
+      partial_packet->layer_specific = 1;
 
       memcpy(partial_packet->data, packet->data, packet->len);
+      reassembly_stats.bytes_copied += packet->len;
 
       // Update the ACL data size to indicate the full expected length
       stream = partial_packet->data;
       STREAM_SKIP_UINT16(stream);  // skip the handle
       UINT16_TO_STREAM(stream, full_length - HCI_ACL_PREAMBLE_SIZE);
 
-      partial_packets[handle] = partial_packet;
+      partial.packet = partial_packet;
+      partial.start_us = bluetooth::common::time_get_os_boottime_us();
 
       // Free the old packet buffer, since we don't need it anymore
       buffer_allocator->free(packet);
     } else {
-      auto map_iter = partial_packets.find(handle);
-      if (map_iter == partial_packets.end()) {
+      partial_packet_t& partial = partial_packets[handle];
+      if (partial.packet == NULL) {
         LOG_WARN(LOG_TAG,
                  "%s got continuation for unknown packet. Dropping it.",
                  __func__);
         buffer_allocator->free(packet);
+        reassembly_stats.dropped++;
         return;
       }
-      BT_HDR* partial_packet = map_iter->second;
+      BT_HDR* partial_packet = partial.packet;
 
       packet->offset = HCI_ACL_PREAMBLE_SIZE;
       uint16_t projected_offset =
@@ -233,18 +284,23 @@ static void reassemble_and_dispatch(BT_HDR* packet) {
                  __func__, partial_packet->len);
         packet->len = (partial_packet->len - partial_packet->offset) + packet->offset;
         projected_offset = partial_packet->len;
+        reassembly_stats.dropped++;
       }
 
       memcpy(partial_packet->data + partial_packet->offset,
              packet->data + packet->offset, packet->len - packet->offset);
+      reassembly_stats.bytes_copied += packet->len - packet->offset;
+      partial_packet->layer_specific++;
 
       // Free the old packet buffer, since we don't need it anymore
       buffer_allocator->free(packet);
       partial_packet->offset = projected_offset;
 
       if (partial_packet->offset == partial_packet->len) {
-        partial_packets.erase(handle);
+        partial.packet = NULL;
+        record_reassembly(partial_packet->layer_specific, partial.start_us);
         partial_packet->offset = 0;
+        partial_packet->layer_specific = 0;
         callbacks->reassembled(partial_packet);
       }
     }
@@ -253,10 +309,27 @@ static void reassemble_and_dispatch(BT_HDR* packet) {
   }
 }
 
+static void dump(int fd) {
+  dprintf(fd, "  ACL reassembly:\n");
+  dprintf(fd,
+          "    Packets: %" PRIu64 " reassembled, %" PRIu64
+          " dropped or invalid fragments\n",
+          reassembly_stats.packets, reassembly_stats.dropped);
+  dprintf(fd, "    Bytes copied: %" PRIu64 "\n", reassembly_stats.bytes_copied);
+  if (reassembly_stats.packets == 0) return;
+
+  dprintf(fd, "    Fragments per packet: avg=%" PRIu64 " max=%" PRIu64 "\n",
+          reassembly_stats.fragments / reassembly_stats.packets,
+          reassembly_stats.max_fragments);
+  dprintf(fd, "    Reassembly latency (us): avg=%" PRIu64 " max=%" PRIu64 "\n",
+          reassembly_stats.total_latency_us / reassembly_stats.packets,
+          reassembly_stats.max_latency_us);
+}
+
 static const packet_fragmenter_t interface = {init, cleanup,
 
                                               fragment_and_dispatch,
-                                              reassemble_and_dispatch};
+                                              reassemble_and_dispatch, dump};
 
 const packet_fragmenter_t* packet_fragmenter_get_interface() {
   controller = controller_get_interface();
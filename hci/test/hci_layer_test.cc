@@ -57,15 +57,30 @@ class HciLayerTest : public AllocationTestHarness {
     AllocationTestHarness::SetUp();
     // Disable our allocation tracker to allow ASAN full range
     allocation_tracker_uninit();
-    commands_pending_response = list_new(NULL);
     buffer_allocator = &buffer_allocator_;
   }
 
   void TearDown() override {
-    list_free(commands_pending_response);
+    clear_waiting_commands();
+    command_latency.clear();
     AllocationTestHarness::TearDown();
   }
 
+  waiting_command_t* AddWaitingCommand(command_opcode_t opcode) const {
+    waiting_command_t* wait_entry = reinterpret_cast<waiting_command_t*>(
+        osi_calloc(sizeof(waiting_command_t)));
+    wait_entry->opcode = opcode;
+    wait_entry->command = static_cast<BT_HDR*>(osi_calloc(sizeof(BT_HDR)));
+    wait_entry->timestamp = std::chrono::steady_clock::now();
+    add_waiting_command(wait_entry);
+    return wait_entry;
+  }
+
+  void FreeWaitingCommand(waiting_command_t* wait_entry) const {
+    osi_free(wait_entry->command);
+    osi_free(wait_entry);
+  }
+
   BT_HDR* AllocateHciEventPacket(size_t packet_length) const {
     return AllocatePacket(packet_length, MSG_HC_TO_STACK_HCI_EVT);
   }
@@ -122,3 +137,40 @@ TEST_F(HciLayerTest, FilterIncomingEvent) {
     CHECK(filter_incoming_event(packet));
   }
 }
+
+TEST_F(HciLayerTest, WaitingCommandsMatchedByOpcodeInOrder) {
+  waiting_command_t* reset = AddWaitingCommand(HCI_RESET);
+  waiting_command_t* first_read = AddWaitingCommand(HCI_READ_BD_ADDR);
+  waiting_command_t* second_read = AddWaitingCommand(HCI_READ_BD_ADDR);
+  waiting_command_t* version = AddWaitingCommand(HCI_READ_LOCAL_VERSION_INFO);
+  EXPECT_EQ(4, get_num_waiting_commands());
+  EXPECT_EQ(reset, commands_pending_response.oldest);
+
+  int sent_after;
+  EXPECT_EQ(nullptr, get_waiting_command(HCI_WRITE_SCAN_ENABLE, &sent_after));
+  EXPECT_EQ(4, sent_after);
+
+  // Commands with the same opcode are answered in the order they were sent
+  EXPECT_EQ(first_read, get_waiting_command(HCI_READ_BD_ADDR, &sent_after));
+  EXPECT_EQ(2, sent_after);
+  EXPECT_EQ(reset, get_waiting_command(HCI_RESET, &sent_after));
+  EXPECT_EQ(2, sent_after);
+  EXPECT_EQ(second_read, commands_pending_response.oldest);
+  EXPECT_EQ(second_read, get_waiting_command(HCI_READ_BD_ADDR, &sent_after));
+  EXPECT_EQ(1, sent_after);
+  EXPECT_EQ(nullptr, get_waiting_command(HCI_READ_BD_ADDR, &sent_after));
+  EXPECT_EQ(version,
+            get_waiting_command(HCI_READ_LOCAL_VERSION_INFO, &sent_after));
+  EXPECT_EQ(0, sent_after);
+
+  EXPECT_EQ(0, get_num_waiting_commands());
+  EXPECT_EQ(nullptr, commands_pending_response.oldest);
+  EXPECT_EQ(nullptr, commands_pending_response.newest);
+  EXPECT_EQ(2u, command_latency[HCI_READ_BD_ADDR].count);
+  EXPECT_EQ(1u, command_latency[HCI_RESET].count);
+
+  FreeWaitingCommand(reset);
+  FreeWaitingCommand(first_read);
+  FreeWaitingCommand(second_read);
+  FreeWaitingCommand(version);
+}
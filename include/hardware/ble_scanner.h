@@ -139,6 +139,10 @@ class BleScannerInterface {
                          uint8_t adv_handle, SyncTransferCb cb) = 0;
   virtual void SyncTxParameters(RawAddress addr, uint8_t mode, uint16_t skip,
                                 uint16_t timeout,StartSyncCb start_cb) = 0;
+
+  /** Lets scan results reach the scanner in batches, or asks for every result
+   * as soon as it is received. Scanners accept batches by default. */
+  virtual void SetScanResultBatching(int scanner_id, bool batch) {}
 };
 
 #endif /* ANDROID_INCLUDE_BLE_SCANNER_H */
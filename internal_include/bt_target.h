@@ -123,6 +123,17 @@
 #define BTIF_DM_OOB_TEST TRUE
 #endif
 
+/* LE scan results are handed to the scanners in batches, this many
+ * milliseconds after the first result of a batch or as soon as it holds
+ * BTIF_SCAN_BATCH_MAX_RESULTS results. 0 delivers every result on its own. */
+#ifndef BTIF_SCAN_BATCH_WINDOW_MS
+#define BTIF_SCAN_BATCH_WINDOW_MS 50
+#endif
+
+#ifndef BTIF_SCAN_BATCH_MAX_RESULTS
+#define BTIF_SCAN_BATCH_MAX_RESULTS 32
+#endif
+
 // How long to wait before activating sniff mode after entering the
 // idle state for server FT/RFCOMM, OPS connections
 #ifndef BTA_FTS_OPS_IDLE_TO_SNIFF_DELAY_MS
@@ -638,6 +649,27 @@
 #define BLE_MAX_L2CAP_CLIENTS 15
 #endif
 
+/* The number of advertisers the LE scan keeps state for: advertising data
+ * waiting for a scan response or chained packets, and the last data reported.
+ * The least recently heard advertiser is dropped when the table is full. */
+#ifndef BTM_BLE_ADV_CACHE_SIZE
+#define BTM_BLE_ADV_CACHE_SIZE 256
+#endif
+
+/* An advertisement carrying the same data as the one last reported for the
+ * device less than this many milliseconds ago is not reported again to
+ * observers. 0 reports every advertisement. */
+#ifndef BTM_BLE_ADV_DUP_SUPPRESS_MS
+#define BTM_BLE_ADV_DUP_SUPPRESS_MS 0
+#endif
+
+/* The number of advertising packet content filters the host applies itself
+ * when the controller does not support them. 0 leaves all filtering to the
+ * upper layers. */
+#ifndef BTM_BLE_SW_FILTER_MAX
+#define BTM_BLE_SW_FILTER_MAX 16
+#endif
+
 /******************************************************************************
  *
  * ATT/GATT Protocol/Profile Settings
@@ -827,6 +859,13 @@
 #define PORT_RX_BUF_CRITICAL_WM 15
 #endif
 
+/* The largest credit window of a port delivering received data to a callback,
+ * in number of buffers. The window grows from PORT_RX_BUF_HIGH_WM with the
+ * rate the application takes the data at. */
+#ifndef PORT_RX_BUF_MAX_WM
+#define PORT_RX_BUF_MAX_WM 40
+#endif
+
 /* The port transmit queue high watermark level, in bytes. */
 #ifndef PORT_TX_HIGH_WM
 #define PORT_TX_HIGH_WM (BTA_RFC_MTU_SIZE * PORT_TX_BUF_HIGH_WM)
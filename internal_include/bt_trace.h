@@ -686,6 +686,10 @@ extern uint8_t appl_trace_level;
 
 void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...);
 
+/* Write the deferred traces of the last few seconds, if deferred tracing is
+ * enabled */
+void bte_trace_dump(int fd);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,16 +26,20 @@
 #include <sys/time.h>
 #include <time.h>
 
+#include <atomic>
+
 #include "avrc_api.h"
 #include "bt_common.h"
 #include "bta_api.h"
 #include "bte.h"
 #include "btm_api.h"
 #include "btu.h"
+#include "common/trace_ring.h"
 #include "l2c_api.h"
 #include "main_int.h"
 #include "osi/include/config.h"
 #include "osi/include/log.h"
+#include "osi/include/properties.h"
 #include "port_api.h"
 #include "sdp_api.h"
 #include "stack_config.h"
@@ -69,6 +73,25 @@
 
 #define MSG_BUFFER_OFFSET 0
 
+/* Trace records kept by each thread when deferred tracing is enabled */
+#ifndef BTE_TRACE_RING_SLOTS
+#define BTE_TRACE_RING_SLOTS 512
+#endif
+
+/* Seconds of deferred traces written by dumpsys */
+#ifndef BTE_TRACE_DUMP_WINDOW_S
+#define BTE_TRACE_DUMP_WINDOW_S 10
+#endif
+
+#define PROPERTY_DEFERRED_TRACE "persist.bluetooth.deferred_trace"
+
+using bluetooth::common::FormattedTrace;
+using bluetooth::common::TraceRecorder;
+
+/* Set once by init() when deferred tracing is enabled, then kept for the
+ * lifetime of the process since LogMsg() may run on any thread */
+static std::atomic<TraceRecorder*> trace_recorder{nullptr};
+
 /* LayerIDs for BTA, currently everything maps onto appl_trace_level */
 static const char* const bt_layer_tags[] = {
     "bt_btif",
@@ -171,16 +194,10 @@ static tBTTRC_FUNC_MAP bttrc_set_level_map[] = {
 
     {0, 0, NULL, NULL, DEFAULT_CONF_TRACE_LEVEL}};
 
-void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {
-  char buffer[BTE_LOG_BUF_SIZE];
+static void log_trace(uint32_t trace_set_mask, const char* buffer) {
   int trace_layer = TRACE_GET_LAYER(trace_set_mask);
   if (trace_layer >= TRACE_LAYER_MAX_NUM) trace_layer = 0;
 
-  va_list ap;
-  va_start(ap, fmt_str);
-  vsnprintf(&buffer[MSG_BUFFER_OFFSET], BTE_LOG_MAX_SIZE, fmt_str, ap);
-  va_end(ap);
-
   switch (TRACE_GET_TYPE(trace_set_mask)) {
     case TRACE_TYPE_ERROR:
       LOG_ERROR(bt_layer_tags[trace_layer], "%s", buffer);
@@ -203,6 +220,48 @@ void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {
   }
 }
 
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {
+  va_list ap;
+  va_start(ap, fmt_str);
+
+  TraceRecorder* recorder = trace_recorder.load(std::memory_order_acquire);
+  if (recorder != nullptr) {
+    /* Record the format and arguments, the drain thread formats them */
+    recorder->Record(trace_set_mask, fmt_str, ap);
+    va_end(ap);
+    if (TRACE_GET_TYPE(trace_set_mask) == TRACE_TYPE_ERROR) recorder->Wake();
+    return;
+  }
+
+  char buffer[BTE_LOG_BUF_SIZE];
+  vsnprintf(&buffer[MSG_BUFFER_OFFSET], BTE_LOG_MAX_SIZE, fmt_str, ap);
+  va_end(ap);
+  log_trace(trace_set_mask, buffer);
+}
+
+void bte_trace_dump(int fd) {
+  TraceRecorder* recorder = trace_recorder.load(std::memory_order_acquire);
+  if (recorder == nullptr) return;
+
+  dprintf(fd, "\nDeferred Stack Traces:\n");
+  recorder->Dump(fd, BTE_TRACE_DUMP_WINDOW_S * 1000000ULL);
+}
+
+static void init_deferred_trace(void) {
+  if (trace_recorder.load() != nullptr ||
+      !osi_property_get_bool(PROPERTY_DEFERRED_TRACE, false)) {
+    return;
+  }
+
+  LOG_INFO(LOG_TAG, "%s: recording stack traces in binary form", __func__);
+  TraceRecorder* recorder =
+      new TraceRecorder(BTE_TRACE_RING_SLOTS, [](const FormattedTrace& trace) {
+        log_trace(trace.trace_set_mask, trace.message.c_str());
+      });
+  recorder->Start();
+  trace_recorder.store(recorder, std::memory_order_release);
+}
+
 /* this function should go into BTAPP_DM for example */
 static uint8_t BTAPP_SetTraceLevel(uint8_t new_level) {
   if (new_level != 0xFF) appl_trace_level = new_level;
@@ -237,6 +296,8 @@ static void load_levels_from_config(const config_t* config) {
 }
 
 static future_t* init(void) {
+  init_deferred_trace();
+
   const stack_config_t* stack_config = stack_config_get_interface();
   if (!stack_config->get_trace_config_enabled()) {
     LOG_INFO(LOG_TAG, "using compile default trace settings");
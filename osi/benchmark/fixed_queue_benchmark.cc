@@ -0,0 +1,127 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares a fixed queue made of a list, a mutex and two semaphores, as
+// created by fixed_queue_new(), with one backed by a lock-free ring, as
+// created by fixed_queue_new_lock_free(). Measures an enqueue followed by a
+// dequeue on a single thread, then the rate 1 and 4 producer threads enqueue
+// at while a consumer thread dequeues, blocking when the queue is empty.
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+#include <thread>
+
+#include "osi/include/fixed_queue.h"
+
+using ::benchmark::State;
+
+namespace {
+
+// Argument of the benchmarks: the kind of queue
+constexpr int64_t kListQueue = 0;
+constexpr int64_t kLockFreeQueue = 1;
+
+// Enough for the producers not to wait on the consumer most of the time
+constexpr size_t kCapacity = 1024;
+
+char g_element;
+char g_stop;
+
+fixed_queue_t* NewQueue(int64_t kind) {
+  if (kind == kLockFreeQueue) return fixed_queue_new_lock_free(kCapacity);
+  return fixed_queue_new(kCapacity);
+}
+
+// The queue the producer threads of a benchmark run share, and the consumer
+// thread draining it. The first producer thread in sets them up, the last one
+// out tears them down: all the threads of a run start their loop together.
+std::mutex g_shared_mutex;
+int g_shared_users = 0;
+fixed_queue_t* g_shared_queue = nullptr;
+std::thread* g_consumer = nullptr;
+
+void Consume(fixed_queue_t* queue) {
+  for (;;) {
+    void* data = fixed_queue_dequeue(queue);
+    if (data == &g_stop) return;
+    benchmark::DoNotOptimize(data);
+  }
+}
+
+fixed_queue_t* AcquireSharedQueue(int64_t kind) {
+  std::lock_guard<std::mutex> lock(g_shared_mutex);
+  if (g_shared_users++ == 0) {
+    g_shared_queue = NewQueue(kind);
+    CHECK(g_shared_queue != nullptr);
+    g_consumer = new std::thread(Consume, g_shared_queue);
+  }
+  return g_shared_queue;
+}
+
+void ReleaseSharedQueue() {
+  std::lock_guard<std::mutex> lock(g_shared_mutex);
+  if (--g_shared_users > 0) return;
+  fixed_queue_enqueue(g_shared_queue, &g_stop);
+  g_consumer->join();
+  delete g_consumer;
+  g_consumer = nullptr;
+  fixed_queue_free(g_shared_queue, nullptr);
+  g_shared_queue = nullptr;
+}
+
+void BM_FixedQueueEnqueueDequeue(State& state) {
+  fixed_queue_t* queue = NewQueue(state.range(0));
+  CHECK(queue != nullptr);
+  for (auto _ : state) {
+    fixed_queue_enqueue(queue, &g_element);
+    benchmark::DoNotOptimize(fixed_queue_dequeue(queue));
+  }
+  state.SetItemsProcessed(state.iterations());
+  fixed_queue_free(queue, nullptr);
+}
+
+void BM_FixedQueueProducers(State& state) {
+  fixed_queue_t* queue = AcquireSharedQueue(state.range(0));
+  for (auto _ : state) {
+    fixed_queue_enqueue(queue, &g_element);
+  }
+  state.SetItemsProcessed(state.iterations());
+  ReleaseSharedQueue();
+}
+
+BENCHMARK(BM_FixedQueueEnqueueDequeue)->Arg(kListQueue)->Arg(kLockFreeQueue);
+BENCHMARK(BM_FixedQueueProducers)
+    ->Arg(kListQueue)
+    ->Arg(kLockFreeQueue)
+    ->Threads(1)
+    ->Threads(4)
+    ->UseRealTime();
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
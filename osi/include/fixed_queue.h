@@ -36,6 +36,21 @@ typedef void (*fixed_queue_cb)(fixed_queue_t* queue, void* context);
 // the returned queue with |fixed_queue_free|.
 fixed_queue_t* fixed_queue_new(size_t capacity);
 
+// Maximum capacity of a queue created with |fixed_queue_new_lock_free|.
+#define FIXED_QUEUE_LOCK_FREE_MAX_CAPACITY 4096
+
+// Creates a new fixed queue with the given |capacity|, like |fixed_queue_new|,
+// but backed by a ring allocated upfront instead of a list guarded by a mutex.
+// The ring has |capacity| slots rounded up to a power of two, and at least
+// two. Enqueuing and dequeuing take no lock and allocate nothing, and only
+// touch the file descriptors when the queue becomes empty, non-empty, full or
+// not full. Any number of threads may enqueue and dequeue. |capacity| must be
+// between 1 and FIXED_QUEUE_LOCK_FREE_MAX_CAPACITY.
+// |fixed_queue_try_remove_from_queue| and |fixed_queue_get_list| may not be
+// called on the returned queue. Returns NULL on failure. The caller must free
+// the returned queue with |fixed_queue_free|.
+fixed_queue_t* fixed_queue_new_lock_free(size_t capacity);
+
 // Frees a queue and (optionally) the enqueued elements.
 // |queue| is the queue to free. If the |free_cb| callback is not null,
 // it is called on each queue element to free it.
@@ -95,11 +110,11 @@ void* fixed_queue_try_peek_last(fixed_queue_t* queue);
 // function will never block the caller. If the queue is empty or NULL, this
 // function returns NULL immediately. |data| may not be NULL. If the |data|
 // element is found in the queue, a pointer to the removed data is returned,
-// otherwise NULL.
+// otherwise NULL. |queue| may not be a lock-free queue.
 void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data);
 
 // Returns the iterateable list with all entries in the |queue|. This function
-// will never block the caller. |queue| may not be NULL.
+// will never block the caller. |queue| may not be NULL, nor a lock-free queue.
 //
 // NOTE: The return result of this function is not thread safe: the list could
 // be modified by another thread, and the result would be unpredictable.
@@ -17,8 +17,13 @@
  ******************************************************************************/
 
 #include <base/logging.h>
+#include <errno.h>
+#include <poll.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <mutex>
 
 #include "osi/include/allocator.h"
@@ -28,6 +33,50 @@
 #include "osi/include/reactor.h"
 #include "osi/include/semaphore.h"
 
+// Positions written by different threads are kept this far apart, so that
+// they do not share a cache line. The ring is allocated with plain new, which
+// does not honour over-aligned types before C++17: explicit padding is used
+// rather than alignas.
+#define FIXED_QUEUE_CACHE_LINE_SIZE 64
+
+// Slot of a lock-free ring. |sequence| is the position the slot is ready
+// for: |pos| to be written at position |pos|, |pos| + 1 to be read.
+typedef struct {
+  std::atomic<size_t> sequence;
+  void* data;
+} fixed_queue_slot_t;
+
+// Bounded ring with a sequence number per slot: producers and consumers
+// claim a position with a compare-and-swap, then hand the slot over through
+// its sequence number, so neither waits for the other. The number of slots is
+// a power of two of at least two: a single slot could not tell being written
+// from being free for the next lap, and indexing with |mask| stays continuous
+// when the positions wrap around. |capacity| bounds the elements held.
+typedef struct fixed_queue_ring_t {
+  fixed_queue_slot_t* slots;
+  size_t mask;
+  size_t capacity;
+
+  // Next positions to write and to read, on their own cache lines
+  char pad0[FIXED_QUEUE_CACHE_LINE_SIZE];
+  std::atomic<size_t> enqueue_pos;
+  char pad1[FIXED_QUEUE_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeue_pos;
+  char pad2[FIXED_QUEUE_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+  // Elements counted in after being written and counted out after being
+  // read. It is off by the operations in progress, and below zero while
+  // elements are read before being counted in.
+  std::atomic<ssize_t> length;
+  char pad3[FIXED_QUEUE_CACHE_LINE_SIZE - sizeof(std::atomic<ssize_t>)];
+
+  // Non-blocking event fds, readable while the ring is not empty and while it
+  // is not full respectively. They are only written when |length| crosses
+  // these limits.
+  int dequeue_fd;
+  int enqueue_fd;
+} fixed_queue_ring_t;
+
 typedef struct fixed_queue_t {
   list_t* list;
   semaphore_t* enqueue_sem;
@@ -35,6 +84,10 @@ typedef struct fixed_queue_t {
   std::mutex* mutex;
   size_t capacity;
 
+  // Replaces |list|, |enqueue_sem|, |dequeue_sem| and |mutex| in a lock-free
+  // queue
+  fixed_queue_ring_t* ring;
+
   reactor_object_t* dequeue_object;
   fixed_queue_cb dequeue_ready;
   void* dequeue_context;
@@ -42,6 +95,18 @@ typedef struct fixed_queue_t {
 
 static void internal_dequeue_ready(void* context);
 
+static fixed_queue_ring_t* ring_new(size_t capacity);
+static void ring_free(fixed_queue_ring_t* ring, fixed_queue_free_cb free_cb);
+static bool ring_try_enqueue(fixed_queue_ring_t* ring, void* data);
+static void* ring_try_dequeue(fixed_queue_ring_t* ring);
+static void ring_enqueue(fixed_queue_ring_t* ring, void* data);
+static void* ring_dequeue(fixed_queue_ring_t* ring);
+static bool ring_is_empty(fixed_queue_ring_t* ring);
+static void* ring_peek_first(fixed_queue_ring_t* ring);
+static void* ring_peek_last(fixed_queue_ring_t* ring);
+static size_t ring_length(fixed_queue_ring_t* ring);
+static void ring_settle_dequeue_fd(fixed_queue_ring_t* ring);
+
 fixed_queue_t* fixed_queue_new(size_t capacity) {
   fixed_queue_t* ret =
       static_cast<fixed_queue_t*>(osi_calloc(sizeof(fixed_queue_t)));
@@ -65,11 +130,31 @@ error:
   return NULL;
 }
 
+fixed_queue_t* fixed_queue_new_lock_free(size_t capacity) {
+  CHECK(capacity > 0);
+  CHECK(capacity <= FIXED_QUEUE_LOCK_FREE_MAX_CAPACITY);
+
+  fixed_queue_ring_t* ring = ring_new(capacity);
+  if (!ring) return NULL;
+
+  fixed_queue_t* ret =
+      static_cast<fixed_queue_t*>(osi_calloc(sizeof(fixed_queue_t)));
+  ret->capacity = capacity;
+  ret->ring = ring;
+  return ret;
+}
+
 void fixed_queue_free(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
   if (!queue) return;
 
   fixed_queue_unregister_dequeue(queue);
 
+  if (queue->ring) {
+    ring_free(queue->ring, free_cb);
+    osi_free(queue);
+    return;
+  }
+
   if (free_cb)
     for (const list_node_t* node = list_begin(queue->list);
          node != list_end(queue->list); node = list_next(node))
@@ -85,8 +170,8 @@ void fixed_queue_free(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
 void fixed_queue_flush(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
   if (!queue) return;
 
-  while (!fixed_queue_is_empty(queue)) {
-    void* data = fixed_queue_try_dequeue(queue);
+  void* data;
+  while ((data = fixed_queue_try_dequeue(queue)) != NULL) {
     if (free_cb != NULL) {
       free_cb(data);
     }
@@ -96,6 +181,8 @@ void fixed_queue_flush(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
 bool fixed_queue_is_empty(fixed_queue_t* queue) {
   if (queue == NULL) return true;
 
+  if (queue->ring) return ring_is_empty(queue->ring);
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list);
 }
@@ -103,6 +190,8 @@ bool fixed_queue_is_empty(fixed_queue_t* queue) {
 size_t fixed_queue_length(fixed_queue_t* queue) {
   if (queue == NULL) return 0;
 
+  if (queue->ring) return ring_length(queue->ring);
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_length(queue->list);
 }
@@ -117,6 +206,11 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) {
+    ring_enqueue(queue->ring, data);
+    return;
+  }
+
   semaphore_wait(queue->enqueue_sem);
 
   {
@@ -130,6 +224,8 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_dequeue(fixed_queue_t* queue) {
   CHECK(queue != NULL);
 
+  if (queue->ring) return ring_dequeue(queue->ring);
+
   semaphore_wait(queue->dequeue_sem);
 
   void* ret = NULL;
@@ -148,6 +244,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) return ring_try_enqueue(queue->ring, data);
+
   if (!semaphore_try_wait(queue->enqueue_sem)) return false;
 
   {
@@ -162,6 +260,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) return ring_try_dequeue(queue->ring);
+
   if (!semaphore_try_wait(queue->dequeue_sem)) return NULL;
 
   void* ret = NULL;
@@ -179,6 +279,8 @@ void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
 void* fixed_queue_try_peek_first(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) return ring_peek_first(queue->ring);
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_front(queue->list);
 }
@@ -186,6 +288,8 @@ void* fixed_queue_try_peek_first(fixed_queue_t* queue) {
 void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) return ring_peek_last(queue->ring);
+
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_back(queue->list);
 }
@@ -193,6 +297,8 @@ void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
 void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
   if (queue == NULL) return NULL;
 
+  CHECK(queue->ring == NULL);
+
   bool removed = false;
   {
     std::lock_guard<std::mutex> lock(*queue->mutex);
@@ -212,6 +318,7 @@ void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
 
 list_t* fixed_queue_get_list(fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  CHECK(queue->ring == NULL);
 
   // NOTE: Using the list in this way is not thread-safe.
   // Using this list in any context where threads can call other functions
@@ -221,11 +328,13 @@ list_t* fixed_queue_get_list(fixed_queue_t* queue) {
 
 int fixed_queue_get_dequeue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  if (queue->ring) return queue->ring->dequeue_fd;
   return semaphore_get_fd(queue->dequeue_sem);
 }
 
 int fixed_queue_get_enqueue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  if (queue->ring) return queue->ring->enqueue_fd;
   return semaphore_get_fd(queue->enqueue_sem);
 }
 
@@ -258,5 +367,195 @@ static void internal_dequeue_ready(void* context) {
   CHECK(context != NULL);
 
   fixed_queue_t* queue = static_cast<fixed_queue_t*>(context);
+
+  // The dequeue fd of a ring can be left readable for a moment after the
+  // ring emptied: the callback may dequeue without checking.
+  if (queue->ring && ring_is_empty(queue->ring)) {
+    ring_settle_dequeue_fd(queue->ring);
+    return;
+  }
+
   queue->dequeue_ready(queue, queue->dequeue_context);
 }
+
+static void ring_signal(int fd) { eventfd_write(fd, 1ULL); }
+
+static void ring_clear(int fd) {
+  eventfd_t value;
+  eventfd_read(fd, &value);
+}
+
+static void ring_wait(int fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  while (poll(&pfd, 1, -1) == -1 && errno == EINTR)
+    ;
+}
+
+static fixed_queue_ring_t* ring_new(size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) size <<= 1;
+
+  fixed_queue_ring_t* ring = new fixed_queue_ring_t;
+  ring->mask = size - 1;
+  ring->capacity = capacity;
+  ring->slots = new fixed_queue_slot_t[size];
+  for (size_t i = 0; i < size; i++) {
+    ring->slots[i].sequence.store(i, std::memory_order_relaxed);
+    ring->slots[i].data = NULL;
+  }
+  ring->enqueue_pos.store(0, std::memory_order_relaxed);
+  ring->dequeue_pos.store(0, std::memory_order_relaxed);
+  ring->length.store(0);
+
+  ring->dequeue_fd = eventfd(0, EFD_NONBLOCK);
+  ring->enqueue_fd = eventfd(1, EFD_NONBLOCK);
+  if (ring->dequeue_fd == INVALID_FD || ring->enqueue_fd == INVALID_FD) {
+    LOG(ERROR) << __func__
+               << ": unable to allocate event fds: " << strerror(errno);
+    ring_free(ring, NULL);
+    return NULL;
+  }
+  return ring;
+}
+
+static void ring_free(fixed_queue_ring_t* ring, fixed_queue_free_cb free_cb) {
+  void* data;
+  while ((data = ring_try_dequeue(ring)) != NULL) {
+    if (free_cb) free_cb(data);
+  }
+
+  if (ring->dequeue_fd != INVALID_FD) close(ring->dequeue_fd);
+  if (ring->enqueue_fd != INVALID_FD) close(ring->enqueue_fd);
+  delete[] ring->slots;
+  delete ring;
+}
+
+// Makes the dequeue fd readable again if the ring is not empty. Clearing it
+// first and checking after does not lose an enqueue signalling it meanwhile.
+static void ring_settle_dequeue_fd(fixed_queue_ring_t* ring) {
+  if (ring->length.load() > 0) return;
+  ring_clear(ring->dequeue_fd);
+  if (ring->length.load() > 0) ring_signal(ring->dequeue_fd);
+}
+
+// Same as |ring_settle_dequeue_fd| for the enqueue fd and a full ring
+static void ring_settle_enqueue_fd(fixed_queue_ring_t* ring) {
+  if (ring->length.load() < (ssize_t)ring->capacity) return;
+  ring_clear(ring->enqueue_fd);
+  if (ring->length.load() < (ssize_t)ring->capacity)
+    ring_signal(ring->enqueue_fd);
+}
+
+static bool ring_try_enqueue(fixed_queue_ring_t* ring, void* data) {
+  fixed_queue_slot_t* slot;
+  size_t pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+  for (;;) {
+    // The ring holds |capacity| elements even when it has more slots. The
+    // dequeue position only grows: when it is read before claiming |pos| the
+    // ring is never overfilled.
+    size_t dequeue_pos = ring->dequeue_pos.load(std::memory_order_acquire);
+    if ((ssize_t)(pos - dequeue_pos) >= (ssize_t)ring->capacity) {
+      size_t current = ring->enqueue_pos.load(std::memory_order_relaxed);
+      if (current == pos) return false;
+      pos = current;
+      continue;
+    }
+
+    slot = &ring->slots[pos & ring->mask];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    ssize_t diff = (ssize_t)(sequence - pos);
+    if (diff == 0) {
+      if (ring->enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      // The slot still holds the element written a lap ago
+      return false;
+    } else {
+      pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  slot->data = data;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  ssize_t length = ring->length.fetch_add(1);
+  if (length == 0) ring_signal(ring->dequeue_fd);
+  if (length == (ssize_t)ring->capacity - 1) ring_settle_enqueue_fd(ring);
+  return true;
+}
+
+static void* ring_try_dequeue(fixed_queue_ring_t* ring) {
+  fixed_queue_slot_t* slot;
+  size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+  for (;;) {
+    slot = &ring->slots[pos & ring->mask];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    ssize_t diff = (ssize_t)(sequence - (pos + 1));
+    if (diff == 0) {
+      if (ring->dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      // The slot has not been written yet
+      return NULL;
+    } else {
+      pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+  void* data = slot->data;
+  slot->sequence.store(pos + ring->mask + 1, std::memory_order_release);
+
+  ssize_t length = ring->length.fetch_sub(1);
+  if (length == (ssize_t)ring->capacity) ring_signal(ring->enqueue_fd);
+  if (length == 1) ring_settle_dequeue_fd(ring);
+  return data;
+}
+
+static void ring_enqueue(fixed_queue_ring_t* ring, void* data) {
+  while (!ring_try_enqueue(ring, data)) {
+    ring_settle_enqueue_fd(ring);
+    ring_wait(ring->enqueue_fd);
+  }
+}
+
+static void* ring_dequeue(fixed_queue_ring_t* ring) {
+  void* data;
+  while ((data = ring_try_dequeue(ring)) == NULL) {
+    ring_settle_dequeue_fd(ring);
+    ring_wait(ring->dequeue_fd);
+  }
+  return data;
+}
+
+// Only reads the sequence of the next slot to read: its data may be written
+// by a producer on the next lap meanwhile.
+static bool ring_is_empty(fixed_queue_ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load(std::memory_order_acquire);
+  fixed_queue_slot_t* slot = &ring->slots[pos & ring->mask];
+  return slot->sequence.load(std::memory_order_acquire) != pos + 1;
+}
+
+static void* ring_peek_first(fixed_queue_ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load(std::memory_order_acquire);
+  fixed_queue_slot_t* slot = &ring->slots[pos & ring->mask];
+  if (slot->sequence.load(std::memory_order_acquire) != pos + 1) return NULL;
+  return slot->data;
+}
+
+static void* ring_peek_last(fixed_queue_ring_t* ring) {
+  size_t pos = ring->enqueue_pos.load(std::memory_order_acquire);
+  if (pos == ring->dequeue_pos.load(std::memory_order_acquire)) return NULL;
+  fixed_queue_slot_t* slot = &ring->slots[(pos - 1) & ring->mask];
+  if (slot->sequence.load(std::memory_order_acquire) != pos) return NULL;
+  return slot->data;
+}
+
+static size_t ring_length(fixed_queue_ring_t* ring) {
+  ssize_t length = ring->length.load();
+  if (length < 0) return 0;
+  if (length > (ssize_t)ring->capacity) return ring->capacity;
+  return length;
+}
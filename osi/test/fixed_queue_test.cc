@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <climits>
+#include <thread>
+#include <vector>
 
 #include "AllocationTestHarness.h"
 
@@ -348,3 +351,191 @@ TEST_F(FixedQueueTest, test_fixed_queue_register_dequeue) {
   thread_free(worker_thread);
   fixed_queue_free(queue, NULL);
 }
+
+TEST_F(FixedQueueTest, test_fixed_queue_lock_free_enqueue_dequeue) {
+  fixed_queue_t* queue = fixed_queue_new_lock_free(3);
+  ASSERT_TRUE(queue != NULL);
+  EXPECT_EQ((size_t)3, fixed_queue_capacity(queue));
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_dequeue(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_peek_first(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_peek_last(queue));
+
+  // Wrap around the ring a few times
+  for (int lap = 0; lap < 3; lap++) {
+    fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+    EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING2));
+    fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING3);
+    EXPECT_FALSE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+    EXPECT_EQ((size_t)3, fixed_queue_length(queue));
+    EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_try_peek_first(queue));
+    EXPECT_EQ(DUMMY_DATA_STRING3, fixed_queue_try_peek_last(queue));
+
+    EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_dequeue(queue));
+    EXPECT_EQ(DUMMY_DATA_STRING2, fixed_queue_try_dequeue(queue));
+    EXPECT_EQ((size_t)1, fixed_queue_length(queue));
+    EXPECT_EQ(DUMMY_DATA_STRING3, fixed_queue_dequeue(queue));
+    EXPECT_TRUE(fixed_queue_is_empty(queue));
+    EXPECT_EQ(NULL, fixed_queue_try_peek_last(queue));
+  }
+
+  // Flushing and freeing call the callback on the elements left
+  test_queue_entry_free_counter = 0;
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  fixed_queue_flush(queue, test_queue_entry_free_cb);
+  EXPECT_EQ(2, test_queue_entry_free_counter);
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING3);
+  fixed_queue_free(queue, test_queue_entry_free_cb);
+  EXPECT_EQ(3, test_queue_entry_free_counter);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_lock_free_capacity_one) {
+  fixed_queue_t* queue = fixed_queue_new_lock_free(1);
+  ASSERT_TRUE(queue != NULL);
+  EXPECT_EQ((size_t)1, fixed_queue_capacity(queue));
+
+  for (int lap = 0; lap < 3; lap++) {
+    EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING1));
+    EXPECT_FALSE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING2));
+    EXPECT_EQ((size_t)1, fixed_queue_length(queue));
+    EXPECT_FALSE(fixed_queue_is_empty(queue));
+    EXPECT_FALSE(is_fd_readable(fixed_queue_get_enqueue_fd(queue)));
+
+    EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_try_dequeue(queue));
+    EXPECT_EQ(NULL, fixed_queue_try_dequeue(queue));
+    EXPECT_TRUE(fixed_queue_is_empty(queue));
+    EXPECT_TRUE(is_fd_readable(fixed_queue_get_enqueue_fd(queue)));
+  }
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_lock_free_get_enqueue_dequeue_fd) {
+  fixed_queue_t* queue = fixed_queue_new_lock_free(TEST_QUEUE_SIZE);
+  ASSERT_TRUE(queue != NULL);
+
+  int enqueue_fd = fixed_queue_get_enqueue_fd(queue);
+  int dequeue_fd = fixed_queue_get_dequeue_fd(queue);
+  EXPECT_TRUE(enqueue_fd >= 0);
+  EXPECT_TRUE(dequeue_fd >= 0);
+  EXPECT_TRUE(enqueue_fd < FD_SETSIZE);
+  EXPECT_TRUE(dequeue_fd < FD_SETSIZE);
+
+  // Empty queue: only the enqueue_fd should be readable
+  EXPECT_TRUE(is_fd_readable(enqueue_fd));
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  // Non-empty queue: both should be readable
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING);
+  EXPECT_TRUE(is_fd_readable(enqueue_fd));
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  fixed_queue_dequeue(queue);
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  // Full queue: only the dequeue_fd should be readable
+  for (size_t i = 0; i < TEST_QUEUE_SIZE; i++) {
+    EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+  }
+  EXPECT_FALSE(is_fd_readable(enqueue_fd));
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  fixed_queue_dequeue(queue);
+  EXPECT_TRUE(is_fd_readable(enqueue_fd));
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_lock_free_register_dequeue) {
+  fixed_queue_t* queue = fixed_queue_new_lock_free(TEST_QUEUE_SIZE);
+  ASSERT_TRUE(queue != NULL);
+
+  received_message_future = future_new();
+  ASSERT_TRUE(received_message_future != NULL);
+
+  thread_t* worker_thread = thread_new("test_fixed_queue_worker_thread");
+  ASSERT_TRUE(worker_thread != NULL);
+
+  fixed_queue_register_dequeue(queue, thread_get_reactor(worker_thread),
+                               fixed_queue_ready, NULL);
+
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING);
+  const char* msg = (const char*)future_await(received_message_future);
+  EXPECT_EQ(DUMMY_DATA_STRING, msg);
+
+  fixed_queue_unregister_dequeue(queue);
+  thread_free(worker_thread);
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_lock_free_producers) {
+  const size_t kProducers = 4;
+  const size_t kPerProducer = 10000;
+
+  // A small queue makes the producers block on it being full
+  fixed_queue_t* queue = fixed_queue_new_lock_free(4);
+  ASSERT_TRUE(queue != NULL);
+
+  // Each element encodes its producer and its rank
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < kProducers; p++) {
+    producers.emplace_back([queue, p, kPerProducer] {
+      for (size_t i = 0; i < kPerProducer; i++) {
+        fixed_queue_enqueue(queue, (void*)(p * kPerProducer + i + 1));
+      }
+    });
+  }
+
+  // Elements of each producer arrive in the order they were enqueued
+  std::vector<size_t> next(kProducers, 0);
+  for (size_t n = 0; n < kProducers * kPerProducer; n++) {
+    size_t value = (size_t)fixed_queue_dequeue(queue) - 1;
+    size_t p = value / kPerProducer;
+    ASSERT_LT(p, kProducers);
+    EXPECT_EQ(next[p], value % kPerProducer);
+    next[p] = value % kPerProducer + 1;
+  }
+  for (auto& producer : producers) producer.join();
+
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_dequeue(queue));
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_lock_free_producers_consumers) {
+  const size_t kThreads = 4;
+  const size_t kPerProducer = 10000;
+
+  for (size_t capacity : {1, 2, 3}) {
+    SCOPED_TRACE(capacity);
+    fixed_queue_t* queue = fixed_queue_new_lock_free(capacity);
+    ASSERT_TRUE(queue != NULL);
+
+    // Every element is received once, whichever consumer receives it
+    std::vector<std::atomic<int>> received(kThreads * kPerProducer);
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < kThreads; p++) {
+      threads.emplace_back([queue, p, kPerProducer] {
+        for (size_t i = 0; i < kPerProducer; i++) {
+          fixed_queue_enqueue(queue, (void*)(p * kPerProducer + i + 1));
+        }
+      });
+    }
+    for (size_t c = 0; c < kThreads; c++) {
+      threads.emplace_back([queue, &received, kPerProducer] {
+        for (size_t i = 0; i < kPerProducer; i++) {
+          size_t value = (size_t)fixed_queue_dequeue(queue) - 1;
+          if (value < received.size()) received[value]++;
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    for (size_t i = 0; i < received.size(); i++) {
+      ASSERT_EQ(1, received[i].load()) << "element " << i;
+    }
+    EXPECT_TRUE(fixed_queue_is_empty(queue));
+    EXPECT_EQ((size_t)0, fixed_queue_length(queue));
+    fixed_queue_free(queue, NULL);
+  }
+}
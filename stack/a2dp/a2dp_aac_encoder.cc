@@ -31,6 +31,7 @@
 #include "common/time_util.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 
 //
 // Encoder for AAC Source Codec
@@ -91,6 +92,10 @@ typedef struct {
   tA2DP_AAC_ENCODER_PARAMS aac_encoder_params;
   tA2DP_AAC_FEEDING_STATE aac_feeding_state;
 
+  int configured_bit_rate;  // AACENC_BITRATE for the configured bitrate
+  A2dpAbr abr;              // Adaptive bitrate on congested links
+  int abr_start_level;      // Level the peer settled on before
+
   a2dp_aac_encoder_stats_t stats;
 } tA2DP_AAC_ENCODER_CB;
 
@@ -108,6 +113,7 @@ static void a2dp_aac_get_num_frame_iteration(uint8_t* num_of_iterations,
                                              uint64_t timestamp_us);
 static void a2dp_aac_encode_frames(uint8_t nb_frame);
 static bool a2dp_aac_read_feeding(uint8_t* read_buffer, uint32_t* bytes_read);
+static void a2dp_aac_apply_abr_level(void);
 
 bool A2DP_LoadEncoderAac(void) {
   // Nothing to do - the library is statically linked
@@ -137,6 +143,7 @@ void a2dp_aac_encoder_init(const tA2DP_ENCODER_INIT_PEER_PARAMS* p_peer_params,
   a2dp_aac_encoder_cb.is_peer_edr = p_peer_params->is_peer_edr;
   a2dp_aac_encoder_cb.peer_supports_3mbps = p_peer_params->peer_supports_3mbps;
   a2dp_aac_encoder_cb.peer_mtu = p_peer_params->peer_mtu;
+  a2dp_aac_encoder_cb.abr_start_level = p_peer_params->abr_start_level;
   a2dp_aac_encoder_cb.timestamp = 0;
 
   a2dp_aac_encoder_cb.use_SCMS_T = false;  // TODO: should be a parameter
@@ -355,6 +362,8 @@ static void a2dp_aac_encoder_update(uint16_t peer_mtu,
     return;  // TODO: Return an error?
   }
 
+  a2dp_aac_encoder_cb.configured_bit_rate = aac_param_value;
+
   // Set the encoder's parameters: PEAK Bit Rate
   aac_error = aacEncoder_SetParam(a2dp_aac_encoder_cb.aac_handle,
                                   AACENC_PEAK_BITRATE, aac_peak_bit_rate);
@@ -446,6 +455,9 @@ static void a2dp_aac_encoder_update(uint16_t peer_mtu,
               __func__, aac_param_value, aac_error);
     return;  // TODO: Return an error?
   }
+  // The encoder picks its own bitrate in VBR mode
+  bool is_constant_bit_rate =
+      (aac_param_value == A2DP_AAC_VARIABLE_BIT_RATE_DISABLED);
 
   // Mark the end of setting the encoder's parameters
   aac_error =
@@ -478,6 +490,13 @@ static void a2dp_aac_encoder_update(uint16_t peer_mtu,
 
   // After encoder params ready, reset the feeding state and its interval.
   a2dp_aac_feeding_reset();
+
+  a2dp_aac_encoder_cb.abr.Init(
+      is_constant_bit_rate &&
+          osi_property_get_bool(A2DP_ABR_ENABLED_PROP, true),
+      a2dp_aac_encoder_interval_ms, a2dp_aac_encoder_cb.abr_start_level);
+  if (a2dp_aac_encoder_cb.abr.Level() != A2DP_ABR_NUM_LEVELS - 1)
+    a2dp_aac_apply_abr_level();
 }
 
 void a2dp_aac_encoder_cleanup(void) {
@@ -543,6 +562,33 @@ void a2dp_aac_send_frames(uint64_t timestamp_us) {
   }
 }
 
+void a2dp_aac_set_link_quality(const tA2DP_LINK_QUALITY* p_link_quality) {
+  if (!a2dp_aac_encoder_cb.abr.Update(*p_link_quality)) return;
+  a2dp_aac_apply_abr_level();
+}
+
+int a2dp_aac_get_settled_link_quality_level(void) {
+  return a2dp_aac_encoder_cb.abr.SettledLevel();
+}
+
+static void a2dp_aac_apply_abr_level(void) {
+  if (!a2dp_aac_encoder_cb.has_aac_handle) return;
+
+  // The encoder applies the new bitrate from the next frame on
+  int bit_rate = a2dp_aac_encoder_cb.configured_bit_rate / 100 *
+                 a2dp_aac_encoder_cb.abr.BitratePercent();
+  AACENC_ERROR aac_error = aacEncoder_SetParam(a2dp_aac_encoder_cb.aac_handle,
+                                               AACENC_BITRATE, bit_rate);
+  if (aac_error != AACENC_OK) {
+    LOG_ERROR(LOG_TAG,
+              "%s: Cannot set AAC parameter AACENC_BITRATE to %d: "
+              "AAC error 0x%x",
+              __func__, bit_rate, aac_error);
+    return;
+  }
+  LOG_INFO(LOG_TAG, "%s: bit rate %d", __func__, bit_rate);
+}
+
 // Obtains the number of frames to send and number of iterations
 // to be used. |num_of_iterations| and |num_of_frames| parameters
 // are used as output param for returning the respective values.
@@ -787,4 +833,6 @@ void A2dpCodecConfigAacSource::debug_codec_dump(int fd) {
           "%zu\n",
           stats->media_read_total_expected_read_bytes,
           stats->media_read_total_actual_read_bytes);
+
+  a2dp_aac_encoder_cb.abr.Dump(fd);
 }
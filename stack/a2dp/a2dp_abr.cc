@@ -0,0 +1,179 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "a2dp_abr"
+
+#include "a2dp_abr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "osi/include/log.h"
+
+// Queued packets from which the link is falling behind. The Source flushes
+// the whole TX queue when it reaches MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ packets.
+#define A2DP_ABR_QUEUE_HIGH_THRESHOLD 6
+
+// Queued packets up to which the link is keeping up.
+#define A2DP_ABR_QUEUE_LOW_THRESHOLD 2
+
+// Ticks a lower level is given to drain the queue before the next step down.
+#define A2DP_ABR_DOWN_HOLD_TICKS 10
+
+// Clear ticks before a step up (3 seconds at a 20 ms interval), and the
+// longest wait after repeated failed step ups.
+#define A2DP_ABR_UP_WAIT_TICKS 150
+#define A2DP_ABR_MAX_UP_WAIT_TICKS 1500
+
+// A step down within this many ticks of a step up means the link could not
+// sustain the higher level.
+#define A2DP_ABR_PROBE_TICKS 250
+
+static const int a2dp_abr_bitrate_percent[A2DP_ABR_NUM_LEVELS] = {50, 65, 80,
+                                                                  100};
+
+void A2dpAbr::Init(bool enabled, uint64_t interval_ms, int start_level) {
+  enabled_ = enabled;
+  interval_ms_ = interval_ms;
+  level_ = A2DP_ABR_NUM_LEVELS - 1;
+  if (enabled) level_ = std::max(0, std::min(start_level, level_));
+
+  has_last_sample_ = false;
+  last_l2cap_stall_count_ = 0;
+  last_flush_count_ = 0;
+
+  ticks_since_change_ = A2DP_ABR_DOWN_HOLD_TICKS;
+  clear_ticks_ = 0;
+  up_wait_ticks_ = A2DP_ABR_UP_WAIT_TICKS;
+  last_change_was_up_ = false;
+
+  steps_down_ = 0;
+  steps_up_ = 0;
+  congested_ticks_ = 0;
+  memset(ticks_at_level_, 0, sizeof(ticks_at_level_));
+}
+
+int A2dpAbr::BitratePercent(int level) {
+  level = std::max(0, std::min(level, A2DP_ABR_NUM_LEVELS - 1));
+  return a2dp_abr_bitrate_percent[level];
+}
+
+int A2dpAbr::SettledLevel() const {
+  int settled = level_;
+  for (int level = 0; level < A2DP_ABR_NUM_LEVELS; level++) {
+    if (ticks_at_level_[level] > ticks_at_level_[settled]) settled = level;
+  }
+  return settled;
+}
+
+bool A2dpAbr::Update(const tA2DP_LINK_QUALITY& link_quality) {
+  // The counters only grow; a smaller one comes from a new ACL link or AV
+  // being enabled again. The first sample only gives the counts so far.
+  uint32_t new_stalls = 0;
+  uint32_t new_flushes = 0;
+  if (has_last_sample_ &&
+      link_quality.l2cap_stall_count >= last_l2cap_stall_count_) {
+    new_stalls = link_quality.l2cap_stall_count - last_l2cap_stall_count_;
+  }
+  if (has_last_sample_ && link_quality.flush_count >= last_flush_count_) {
+    new_flushes = link_quality.flush_count - last_flush_count_;
+  }
+  has_last_sample_ = true;
+  last_l2cap_stall_count_ = link_quality.l2cap_stall_count;
+  last_flush_count_ = link_quality.flush_count;
+
+  ticks_at_level_[level_]++;
+  ticks_since_change_++;
+
+  const char* reason = nullptr;
+  if (link_quality.tx_queue_length >= A2DP_ABR_QUEUE_HIGH_THRESHOLD) {
+    reason = "TX queue";
+  } else if (new_flushes > 0) {
+    reason = "flushed packets";
+  } else if (new_stalls > 0 &&
+             link_quality.tx_queue_length > A2DP_ABR_QUEUE_LOW_THRESHOLD) {
+    reason = "L2CAP stalls";
+  }
+
+  if (reason != nullptr) {
+    congested_ticks_++;
+    clear_ticks_ = 0;
+    if (!enabled_ || level_ == 0) return false;
+    // Let the lower level drain the queue before going further down
+    if (!last_change_was_up_ && ticks_since_change_ < A2DP_ABR_DOWN_HOLD_TICKS)
+      return false;
+    if (last_change_was_up_ && ticks_since_change_ < A2DP_ABR_PROBE_TICKS) {
+      up_wait_ticks_ =
+          std::min(up_wait_ticks_ * 2, (uint32_t)A2DP_ABR_MAX_UP_WAIT_TICKS);
+    }
+    StepTo(level_ - 1, reason, link_quality);
+    return true;
+  }
+
+  if (link_quality.tx_queue_length > A2DP_ABR_QUEUE_LOW_THRESHOLD ||
+      new_stalls > 0) {
+    clear_ticks_ = 0;
+    return false;
+  }
+  clear_ticks_++;
+  if (last_change_was_up_ && ticks_since_change_ >= A2DP_ABR_PROBE_TICKS)
+    up_wait_ticks_ = A2DP_ABR_UP_WAIT_TICKS;
+
+  if (!enabled_ || level_ == A2DP_ABR_NUM_LEVELS - 1) return false;
+  if (clear_ticks_ < up_wait_ticks_) return false;
+  StepTo(level_ + 1, "link clear", link_quality);
+  return true;
+}
+
+void A2dpAbr::StepTo(int level, const char* reason,
+                     const tA2DP_LINK_QUALITY& link_quality) {
+  LOG_INFO(LOG_TAG,
+           "%s: level %d -> %d (%d%% bitrate) on %s: TX queue %zu, L2CAP "
+           "stalls %u, flushed packets %u, next step up after %u ticks",
+           __func__, level_, level, BitratePercent(level), reason,
+           link_quality.tx_queue_length, link_quality.l2cap_stall_count,
+           link_quality.flush_count, up_wait_ticks_);
+  if (level > level_) {
+    steps_up_++;
+    last_change_was_up_ = true;
+  } else {
+    steps_down_++;
+    last_change_was_up_ = false;
+  }
+  level_ = level;
+  ticks_since_change_ = 0;
+  clear_ticks_ = 0;
+}
+
+void A2dpAbr::Dump(int fd) const {
+  dprintf(fd,
+          "  Adaptive bitrate (enabled/level/bitrate)                : %s / "
+          "%d / %d%%\n",
+          enabled_ ? "true" : "false", level_, BitratePercent());
+  dprintf(fd,
+          "  Adaptive bitrate steps (down/up), congested ticks       : %zu / "
+          "%zu, %zu\n",
+          steps_down_, steps_up_, congested_ticks_);
+  dprintf(fd,
+          "  Adaptive bitrate time per level in ms                   :");
+  for (int level = 0; level < A2DP_ABR_NUM_LEVELS; level++) {
+    dprintf(fd, " %d%%=%llu", BitratePercent(level),
+            (unsigned long long)(ticks_at_level_[level] * interval_ms_));
+  }
+  dprintf(fd, "\n");
+}
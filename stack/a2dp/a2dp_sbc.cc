@@ -100,8 +100,9 @@ static const tA2DP_ENCODER_INTERFACE a2dp_encoder_interface_sbc = {
     a2dp_sbc_feeding_flush,
     a2dp_sbc_get_encoder_interval_ms,
     a2dp_sbc_send_frames,
-    nullptr  // set_transmit_queue_length
-};
+    nullptr,  // set_transmit_queue_length
+    a2dp_sbc_set_link_quality,
+    a2dp_sbc_get_settled_link_quality_level};
 
 static const tA2DP_DECODER_INTERFACE a2dp_decoder_interface_sbc = {
     a2dp_sbc_decoder_init,
@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "a2dp_sbc.h"
 #include "a2dp_sbc_up_sample.h"
 #include "bt_common.h"
@@ -125,6 +127,10 @@ typedef struct {
   uint16_t peer_mtu;        /* MTU of the A2DP peer */
   uint32_t timestamp;       /* Timestamp for the A2DP frames */
   SBC_ENC_PARAMS sbc_encoder_params;
+  int16_t configured_bitpool; /* Bitpool for the configured bitrate */
+  int16_t min_bitpool;        /* Lowest bitpool the peer accepts */
+  A2dpAbr abr;                /* Adaptive bitpool on congested links */
+  int abr_start_level;        /* Level the peer settled on before */
   tA2DP_FEEDING_PARAMS feeding_params;
   tA2DP_SBC_FEEDING_STATE feeding_state;
   int16_t pcmBuffer[SBC_MAX_PCM_BUFFER_SIZE];
@@ -141,6 +147,7 @@ static void a2dp_sbc_encoder_update(uint16_t peer_mtu,
                                     bool* p_config_updated);
 static bool a2dp_sbc_read_feeding(uint32_t* bytes);
 static void a2dp_sbc_encode_frames(uint8_t nb_frame);
+static void a2dp_sbc_apply_abr_level(void);
 static void a2dp_sbc_get_num_frame_iteration(uint8_t* num_of_iterations,
                                              uint8_t* num_of_frames,
                                              uint64_t timestamp_us);
@@ -171,6 +178,7 @@ void a2dp_sbc_encoder_init(const tA2DP_ENCODER_INIT_PEER_PARAMS* p_peer_params,
   a2dp_sbc_encoder_cb.is_peer_edr = p_peer_params->is_peer_edr;
   a2dp_sbc_encoder_cb.peer_supports_3mbps = p_peer_params->peer_supports_3mbps;
   a2dp_sbc_encoder_cb.peer_mtu = p_peer_params->peer_mtu;
+  a2dp_sbc_encoder_cb.abr_start_level = p_peer_params->abr_start_level;
   a2dp_sbc_encoder_cb.timestamp = 0;
 
   // NOTE: Ignore the restart_input / restart_output flags - this initization
@@ -394,6 +402,15 @@ static void a2dp_sbc_encoder_update(uint16_t peer_mtu,
   /* Reset the SBC encoder */
   SBC_Encoder_Init(&a2dp_sbc_encoder_cb.sbc_encoder_params);
   a2dp_sbc_encoder_cb.tx_sbc_frames = calculate_max_frames_per_packet();
+
+  /* The adaptive bitpool starts from the bitpool just computed */
+  a2dp_sbc_encoder_cb.configured_bitpool = p_encoder_params->s16BitPool;
+  a2dp_sbc_encoder_cb.min_bitpool = min_bitpool;
+  a2dp_sbc_encoder_cb.abr.Init(
+      osi_property_get_bool(A2DP_ABR_ENABLED_PROP, true),
+      A2DP_SBC_ENCODER_INTERVAL_MS, a2dp_sbc_encoder_cb.abr_start_level);
+  if (a2dp_sbc_encoder_cb.abr.Level() != A2DP_ABR_NUM_LEVELS - 1)
+    a2dp_sbc_apply_abr_level();
 }
 
 void a2dp_sbc_encoder_cleanup(void) {
@@ -440,6 +457,28 @@ void a2dp_sbc_send_frames(uint64_t timestamp_us) {
   }
 }
 
+void a2dp_sbc_set_link_quality(const tA2DP_LINK_QUALITY* p_link_quality) {
+  if (!a2dp_sbc_encoder_cb.abr.Update(*p_link_quality)) return;
+  a2dp_sbc_apply_abr_level();
+}
+
+int a2dp_sbc_get_settled_link_quality_level(void) {
+  return a2dp_sbc_encoder_cb.abr.SettledLevel();
+}
+
+static void a2dp_sbc_apply_abr_level(void) {
+  /* The bitpool is in every frame header: frames encoded from now on use the
+   * new one, and the packets carry as many of the shorter frames as fit. */
+  SBC_ENC_PARAMS* p_encoder_params = &a2dp_sbc_encoder_cb.sbc_encoder_params;
+  int bitpool = a2dp_sbc_encoder_cb.configured_bitpool *
+                a2dp_sbc_encoder_cb.abr.BitratePercent() / 100;
+  p_encoder_params->s16BitPool =
+      std::max(bitpool, (int)a2dp_sbc_encoder_cb.min_bitpool);
+  a2dp_sbc_encoder_cb.tx_sbc_frames = calculate_max_frames_per_packet();
+  LOG_INFO(LOG_TAG, "%s: bitpool %d, %d frames per packet", __func__,
+           p_encoder_params->s16BitPool, a2dp_sbc_encoder_cb.tx_sbc_frames);
+}
+
 // Obtains the number of frames to send and number of iterations
 // to be used. |num_of_iterations| and |num_of_frames| parameters
 // are used as output param for returning the respective values.
@@ -1001,4 +1040,12 @@ void A2dpCodecConfigSbcSource::debug_codec_dump(int fd) {
           "%zu\n",
           stats->media_read_total_expected_frames,
           stats->media_read_total_dropped_frames);
+
+  dprintf(fd,
+          "  Bitpool (current/configured/min)                        : %d / "
+          "%d / %d\n",
+          a2dp_sbc_encoder_cb.sbc_encoder_params.s16BitPool,
+          a2dp_sbc_encoder_cb.configured_bitpool,
+          a2dp_sbc_encoder_cb.min_bitpool);
+  a2dp_sbc_encoder_cb.abr.Dump(fd);
 }
@@ -34,6 +34,7 @@
 #include "bt_types.h"
 #include "bt_utils.h"
 #include "btu.h"
+#include "common/a2dp_latency_tracer.h"
 #include "osi/include/osi.h"
 
 /* This table is used to lookup the callback event that matches a particular
@@ -1534,6 +1535,7 @@ void avdt_scb_chk_snd_pkt(AvdtpScb* p_scb, UNUSED_ATTR tAVDT_SCB_EVT* p_data) {
     if (p_scb->p_pkt != NULL) {
       p_pkt = p_scb->p_pkt;
       p_scb->p_pkt = NULL;
+      bluetooth::common::A2dpLatencyTracer::GetInstance().OnAvdtpWrite(p_pkt);
       avdt_ad_write_req(AVDT_CHAN_MEDIA, p_scb->p_ccb, p_scb, p_pkt);
 
       (*p_scb->stream_config.p_avdt_ctrl_cback)(
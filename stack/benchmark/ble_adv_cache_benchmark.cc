@@ -0,0 +1,317 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Replays a stream of LE Advertising Report events through the ingest stage of
+ * btm_ble_process_adv_pkt_cont(): scan response merge, data validation and
+ * inquiry database lookup. The stream is recorded once per fixture from a
+ * population of advertisers doing active scanning exchanges, in the HCI event
+ * format the controller sends. */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <list>
+#include <random>
+#include <vector>
+
+#include "advertise_data_parser.h"
+#include "bt_target.h"
+#include "bt_types.h"
+#include "stack/btm/btm_ble_adv_cache.h"
+
+using ::benchmark::State;
+
+#define ADV_IND 0x00
+#define SCAN_RSP 0x04
+#define INQ_DB_SIZE 40
+#define REPORTS_PER_EVENT 3
+#define EVENTS_PER_ADVERTISER 20
+
+namespace {
+
+struct InqDbEntry {
+  bool in_use;
+  RawAddress addr;
+};
+
+/* Stand-in for the BTM inquiry database */
+InqDbEntry g_inq_db[INQ_DB_SIZE];
+size_t g_inq_db_next;
+
+InqDbEntry* inq_db_find(const RawAddress& addr) {
+  for (InqDbEntry& ent : g_inq_db) {
+    if (ent.in_use && ent.addr == addr) return &ent;
+  }
+  return nullptr;
+}
+
+InqDbEntry* inq_db_new(const RawAddress& addr) {
+  InqDbEntry* ent = &g_inq_db[g_inq_db_next++ % INQ_DB_SIZE];
+  ent->in_use = true;
+  ent->addr = addr;
+  return ent;
+}
+
+/* Cache of the advertisements waiting for their scan response, as done before
+ * the per advertiser table */
+class ListAdvertisingCache {
+ public:
+  const std::vector<uint8_t>& Set(uint8_t addr_type, const RawAddress& addr,
+                                  std::vector<uint8_t> data) {
+    auto it = Find(addr_type, addr);
+    if (it != items.end()) {
+      it->data = std::move(data);
+      return it->data;
+    }
+    if (items.size() > cache_max) items.pop_back();
+    items.emplace_front(addr_type, addr, std::move(data));
+    return items.front().data;
+  }
+
+  const std::vector<uint8_t>& Append(uint8_t addr_type, const RawAddress& addr,
+                                     std::vector<uint8_t> data) {
+    auto it = Find(addr_type, addr);
+    if (it != items.end()) {
+      it->data.insert(it->data.end(), data.begin(), data.end());
+      return it->data;
+    }
+    if (items.size() > cache_max) items.pop_back();
+    items.emplace_front(addr_type, addr, std::move(data));
+    return items.front().data;
+  }
+
+  void Clear(uint8_t addr_type, const RawAddress& addr) {
+    auto it = Find(addr_type, addr);
+    if (it != items.end()) items.erase(it);
+  }
+
+ private:
+  struct Item {
+    uint8_t addr_type;
+    RawAddress addr;
+    std::vector<uint8_t> data;
+
+    Item(uint8_t addr_type, const RawAddress& addr, std::vector<uint8_t> data)
+        : addr_type(addr_type), addr(addr), data(data) {}
+  };
+
+  std::list<Item>::iterator Find(uint8_t addr_type, const RawAddress& addr) {
+    for (auto it = items.begin(); it != items.end(); it++) {
+      if (it->addr_type == addr_type && it->addr == addr) return it;
+    }
+    return items.end();
+  }
+
+  const size_t cache_max = 7;
+  std::list<Item> items;
+};
+
+ListAdvertisingCache g_list_cache;
+AdvertisingCache* g_table_cache;
+
+uint64_t g_reported;
+
+void report(const InqDbEntry* ent, const std::vector<uint8_t>& data) {
+  benchmark::DoNotOptimize(ent);
+  benchmark::DoNotOptimize(data.data());
+  g_reported++;
+}
+
+void ingest_list(uint8_t evt_type, uint8_t addr_type, const RawAddress& bda,
+                 uint8_t data_len, uint8_t* data) {
+  std::vector<uint8_t> tmp;
+  if (data_len != 0) tmp.insert(tmp.begin(), data, data + data_len);
+  AdvertiseDataParser::RemoveTrailingZeros(tmp);
+
+  bool is_start = evt_type == ADV_IND;
+  const std::vector<uint8_t>& adv_data =
+      is_start ? g_list_cache.Set(addr_type, bda, std::move(tmp))
+               : g_list_cache.Append(addr_type, bda, std::move(tmp));
+  if (is_start) return;  // waiting for the scan response
+
+  if (!AdvertiseDataParser::IsValid(adv_data)) return;
+
+  InqDbEntry* ent = inq_db_find(bda);
+  if (ent == nullptr) ent = inq_db_new(bda);
+  report(ent, adv_data);
+  g_list_cache.Clear(addr_type, bda);
+}
+
+void ingest_table(uint8_t evt_type, uint8_t addr_type, const RawAddress& bda,
+                  uint8_t data_len, uint8_t* data) {
+  bool is_start = evt_type == ADV_IND;
+  AdvertisingCache::Entry& entry = g_table_cache->Get(addr_type, bda);
+  if (is_start || !entry.pending) entry.data.clear();
+  size_t fragment_start = entry.data.size();
+  entry.data.insert(entry.data.end(), data, data + data_len);
+  AdvertiseDataParser::RemoveTrailingZeros(entry.data, fragment_start);
+  entry.pending = true;
+  if (is_start) return;  // waiting for the scan response
+
+  entry.pending = false;
+  if (!AdvertiseDataParser::IsValid(entry.data)) return;
+
+  InqDbEntry* ent = nullptr;
+  if (entry.inq_db_index < INQ_DB_SIZE &&
+      g_inq_db[entry.inq_db_index].in_use &&
+      g_inq_db[entry.inq_db_index].addr == bda) {
+    ent = &g_inq_db[entry.inq_db_index];
+  } else {
+    ent = inq_db_find(bda);
+    if (ent == nullptr) ent = inq_db_new(bda);
+    entry.inq_db_index = ent - g_inq_db;
+  }
+  report(ent, entry.data);
+}
+
+/* Parses an LE Advertising Report event as btm_ble_process_adv_pkt() does */
+void process_adv_report_event(
+    const std::vector<uint8_t>& event,
+    void (*ingest)(uint8_t, uint8_t, const RawAddress&, uint8_t, uint8_t*)) {
+  uint8_t* p = const_cast<uint8_t*>(event.data());
+  uint8_t num_reports, evt_type, addr_type, data_len;
+  int8_t rssi;
+  RawAddress bda;
+
+  STREAM_TO_UINT8(num_reports, p);
+  while (num_reports--) {
+    STREAM_TO_UINT8(evt_type, p);
+    STREAM_TO_UINT8(addr_type, p);
+    STREAM_TO_BDADDR(bda, p);
+    STREAM_TO_UINT8(data_len, p);
+    uint8_t* data = p;
+    p += data_len;
+    STREAM_TO_INT8(rssi, p);
+    benchmark::DoNotOptimize(rssi);
+    ingest(evt_type, addr_type, bda, data_len, data);
+  }
+}
+
+}  // namespace
+
+class BM_BleAdvIngest : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    size_t num_advertisers = st.range(0);
+    RecordStream(num_advertisers);
+    memset(g_inq_db, 0, sizeof(g_inq_db));
+    g_inq_db_next = 0;
+    g_reported = 0;
+    size_t cache_size = st.range(1);
+    if (cache_size != 0) g_table_cache = new AdvertisingCache(cache_size);
+  }
+
+  void TearDown(State& st) override {
+    delete g_table_cache;
+    g_table_cache = nullptr;
+    events_.clear();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  /* Each advertiser sends an ADV_IND followed by the SCAN_RSP to our scan
+   * request, advertisers being heard in random order. Reports are batched in
+   * events as the controller does. */
+  void RecordStream(size_t num_advertisers) {
+    std::mt19937 rng(1);
+    std::vector<uint32_t> order;
+    for (uint32_t round = 0; round < EVENTS_PER_ADVERTISER; round++) {
+      for (uint32_t n = 0; n < num_advertisers; n++) order.push_back(n);
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+
+    std::vector<uint8_t> event;
+    uint8_t num_reports = 0;
+    for (uint32_t n : order) {
+      for (uint8_t evt_type : {ADV_IND, SCAN_RSP}) {
+        if (num_reports == 0) event.push_back(0);
+        AppendReport(event, evt_type, n);
+        event[0] = ++num_reports;
+        if (num_reports == REPORTS_PER_EVENT) {
+          events_.push_back(std::move(event));
+          event.clear();
+          num_reports = 0;
+        }
+      }
+    }
+    if (num_reports != 0) events_.push_back(std::move(event));
+    num_reports_ = order.size() * 2;
+  }
+
+  void AppendReport(std::vector<uint8_t>& event, uint8_t evt_type, uint32_t n) {
+    uint8_t adv[31] = {0x02, 0x01, 0x06,                    /* flags */
+                       0x03, 0x03, 0x0f, 0x18,              /* battery */
+                       0x09, 0xff, 0xe0, 0x00, (uint8_t)n,  /* manufacturer */
+                       (uint8_t)(n >> 8), 0x11, 0x22, 0x33, 0x44};
+    uint8_t scan_rsp[31] = {0x0b, 0x09, 's', 'e', 'n', 's', 'o', 'r', '-'};
+    scan_rsp[9] = '0' + n % 10;
+    scan_rsp[10] = '0' + n / 10 % 10;
+    scan_rsp[11] = '0' + n / 100 % 10;
+    const uint8_t* data = evt_type == ADV_IND ? adv : scan_rsp;
+
+    event.push_back(evt_type);
+    event.push_back(BLE_ADDR_RANDOM);
+    RawAddress addr({0xc0, 0x00, 0x00, (uint8_t)(n >> 16), (uint8_t)(n >> 8),
+                     (uint8_t)n});
+    for (int i = 5; i >= 0; i--) event.push_back(addr.address[i]);
+    /* controllers pad legacy PDUs to 31 bytes */
+    event.push_back(31);
+    event.insert(event.end(), data, data + 31);
+    event.push_back((uint8_t)-60);
+  }
+
+  void Replay(State& state, void (*ingest)(uint8_t, uint8_t, const RawAddress&,
+                                           uint8_t, uint8_t*)) {
+    for (auto _ : state) {
+      for (const auto& event : events_) process_adv_report_event(event, ingest);
+    }
+    state.SetItemsProcessed(state.iterations() * num_reports_);
+    state.counters["reported"] = g_reported / state.iterations();
+  }
+
+  std::vector<std::vector<uint8_t>> events_;
+  size_t num_reports_ = 0;
+};
+
+/* Arguments: number of advertisers, size of the advertiser table */
+BENCHMARK_DEFINE_F(BM_BleAdvIngest, list_cache)(State& state) {
+  Replay(state, ingest_list);
+}
+BENCHMARK_REGISTER_F(BM_BleAdvIngest, list_cache)
+    ->Args({10, 0})
+    ->Args({200, 0})
+    ->Args({2000, 0});
+
+BENCHMARK_DEFINE_F(BM_BleAdvIngest, table_cache)(State& state) {
+  Replay(state, ingest_table);
+}
+BENCHMARK_REGISTER_F(BM_BleAdvIngest, table_cache)
+    ->Args({10, BTM_BLE_ADV_CACHE_SIZE})
+    ->Args({200, BTM_BLE_ADV_CACHE_SIZE})
+    ->Args({2000, BTM_BLE_ADV_CACHE_SIZE})
+    ->Args({2000, 4096});
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
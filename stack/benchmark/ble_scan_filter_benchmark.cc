@@ -0,0 +1,258 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host side advertising packet content filtering of a stream of complete
+ * advertisements, as btm_ble_process_adv_pkt_cont() hands them over once the
+ * scan response is merged. The advertisers look like the ones heard in a busy
+ * place: beacons with manufacturer data, Eddystone service data, sensors with
+ * a name and a 16 bit service UUID. Filters are name prefixes, manufacturer
+ * data under a mask, service UUIDs and addresses, looking for a few devices
+ * among many. */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "advertise_data_parser.h"
+#include "bt_types.h"
+#include "btm_api_types.h"
+#include "btm_ble_api_types.h"
+#include "stack/btm/btm_ble_scan_filter.h"
+
+using ::benchmark::State;
+using bluetooth::Uuid;
+
+#define NUM_ADVERTISERS 500
+#define NUM_FILTER_INDEXES 256
+
+namespace {
+
+struct Advertisement {
+  RawAddress addr;
+  int8_t rssi;
+  std::vector<uint8_t> data;
+};
+
+RawAddress make_address(uint32_t n) {
+  return RawAddress({0xc0, 0x00, 0x00, (uint8_t)(n >> 16), (uint8_t)(n >> 8),
+                     (uint8_t)n});
+}
+
+std::string sensor_name(uint32_t n) { return "sensor-" + std::to_string(n); }
+
+/* Filters set up one condition at a time, the way a simple host matcher
+ * would: every condition looks up its field in the advertising data. */
+class LinearScanFilter {
+ public:
+  void Add(const ApcfCommand& cmd) { conditions_.push_back(cmd); }
+
+  bool Match(const RawAddress& addr, const std::vector<uint8_t>& data) const {
+    for (const ApcfCommand& cmd : conditions_) {
+      if (MatchCondition(cmd, addr, data)) return true;
+    }
+    return false;
+  }
+
+ private:
+  static bool MatchCondition(const ApcfCommand& cmd, const RawAddress& addr,
+                             const std::vector<uint8_t>& data) {
+    uint8_t len;
+    const uint8_t* p;
+    switch (cmd.type) {
+      case BTM_BLE_PF_ADDR_FILTER:
+        return cmd.address == addr;
+
+      case BTM_BLE_PF_SRVC_UUID: {
+        uint16_t uuid = cmd.uuid.As16Bit();
+        p = AdvertiseDataParser::GetFieldByType(
+            data, BT_EIR_COMPLETE_16BITS_UUID_TYPE, &len);
+        for (uint8_t i = 0; p && i + 1 < len; i += 2) {
+          if ((p[i] | p[i + 1] << 8) == uuid) return true;
+        }
+        return false;
+      }
+
+      case BTM_BLE_PF_LOCAL_NAME:
+        p = AdvertiseDataParser::GetFieldByType(
+            data, BT_EIR_COMPLETE_LOCAL_NAME_TYPE, &len);
+        return p && len >= cmd.name.size() &&
+               std::equal(cmd.name.begin(), cmd.name.end(), p);
+
+      case BTM_BLE_PF_MANU_DATA:
+        p = AdvertiseDataParser::GetFieldByType(
+            data, BT_EIR_MANUFACTURER_SPECIFIC_TYPE, &len);
+        if (!p || len < 2 + cmd.data.size()) return false;
+        if ((p[0] | p[1] << 8) != cmd.company) return false;
+        for (size_t i = 0; i < cmd.data.size(); i++) {
+          if ((p[2 + i] & cmd.data_mask[i]) != (cmd.data[i] & cmd.data_mask[i]))
+            return false;
+        }
+        return true;
+    }
+    return false;
+  }
+
+  std::vector<ApcfCommand> conditions_;
+};
+
+}  // namespace
+
+class BM_BleScanFilter : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    RecordStream();
+    SetUpFilters(st.range(0));
+  }
+
+  void TearDown(State& st) override {
+    stream_.clear();
+    engine_ = ScanFilterEngine();
+    linear_ = LinearScanFilter();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  void RecordStream() {
+    std::mt19937 rng(1);
+    for (uint32_t n = 0; n < NUM_ADVERTISERS; n++) {
+      Advertisement adv;
+      adv.addr = make_address(n);
+      adv.rssi = -40 - (int8_t)(rng() % 50);
+      adv.data = {0x02, BT_EIR_FLAGS_TYPE, 0x06};
+      switch (n % 3) {
+        case 0: {
+          /* iBeacon like: company, type, proximity UUID, major, minor */
+          uint8_t beacon[] = {0x1a, BT_EIR_MANUFACTURER_SPECIFIC_TYPE,
+                              0x4c, 0x00, 0x02, 0x15};
+          adv.data.insert(adv.data.end(), beacon, beacon + sizeof(beacon));
+          for (int i = 0; i < 16; i++) adv.data.push_back(rng());
+          adv.data.insert(adv.data.end(), {(uint8_t)(n >> 8), (uint8_t)n, 0x00,
+                                           0x01, 0xc5});
+          break;
+        }
+        case 1: {
+          /* Eddystone UID */
+          uint8_t eddystone[] = {0x03, BT_EIR_COMPLETE_16BITS_UUID_TYPE,
+                                 0xaa, 0xfe, 0x15,
+                                 BT_EIR_SERVICE_DATA_16BITS_UUID_TYPE,
+                                 0xaa, 0xfe, 0x00, 0xe7};
+          adv.data.insert(adv.data.end(), eddystone,
+                          eddystone + sizeof(eddystone));
+          for (int i = 0; i < 16; i++) adv.data.push_back(rng());
+          break;
+        }
+        case 2: {
+          /* Sensor with its name in the merged scan response */
+          adv.data.insert(adv.data.end(),
+                          {0x05, BT_EIR_COMPLETE_16BITS_UUID_TYPE, 0x0f, 0x18,
+                           (uint8_t)(0x1a + n % 4), 0x18});
+          std::string name = sensor_name(n);
+          adv.data.push_back(name.size() + 1);
+          adv.data.push_back(BT_EIR_COMPLETE_LOCAL_NAME_TYPE);
+          adv.data.insert(adv.data.end(), name.begin(), name.end());
+          break;
+        }
+      }
+      stream_.push_back(std::move(adv));
+    }
+  }
+
+  /* Filter conditions cycle through the four kinds. There are more conditions
+   * than filter indexes at 1000, so an index then gets several conditions of
+   * the same kind. Few of them match anything in the stream. */
+  void SetUpFilters(int num_conditions) {
+    for (int i = 0; i < num_conditions; i++) {
+      ApcfCommand cmd = {};
+      switch (i % 4) {
+        case 0:
+          cmd.type = BTM_BLE_PF_ADDR_FILTER;
+          cmd.address = make_address(NUM_ADVERTISERS + i);
+          cmd.addr_type = BLE_ADDR_RANDOM;
+          break;
+        case 1: {
+          cmd.type = BTM_BLE_PF_LOCAL_NAME;
+          std::string name = sensor_name(i * 50 + 2);
+          cmd.name.assign(name.begin(), name.end());
+          break;
+        }
+        case 2:
+          /* Major number of the beacons */
+          cmd.type = BTM_BLE_PF_MANU_DATA;
+          cmd.company = 0x004c;
+          cmd.data = {0x02, 0x15};
+          cmd.data.resize(18);
+          cmd.data_mask.resize(18);
+          cmd.data_mask[0] = cmd.data_mask[1] = 0xff;
+          cmd.data.push_back((i * 50) >> 8);
+          cmd.data_mask.push_back(0xff);
+          cmd.data.push_back(i * 50);
+          cmd.data_mask.push_back(0xff);
+          break;
+        case 3:
+          cmd.type = BTM_BLE_PF_SRVC_UUID;
+          cmd.uuid = Uuid::From16Bit(0x2a00 + i);
+          break;
+      }
+      engine_.Add(i % NUM_FILTER_INDEXES, cmd);
+      linear_.Add(cmd);
+    }
+    engine_.Enable(true);
+  }
+
+  template <typename Match>
+  void Replay(State& state, Match match) {
+    uint64_t passed = 0;
+    for (auto _ : state) {
+      for (const Advertisement& adv : stream_) passed += match(adv);
+    }
+    state.SetItemsProcessed(state.iterations() * stream_.size());
+    state.counters["passed"] = passed / state.iterations();
+  }
+
+  std::vector<Advertisement> stream_;
+  ScanFilterEngine engine_;
+  LinearScanFilter linear_;
+};
+
+/* Argument is the number of filter conditions */
+BENCHMARK_DEFINE_F(BM_BleScanFilter, linear)(State& state) {
+  Replay(state, [this](const Advertisement& adv) {
+    return linear_.Match(adv.addr, adv.data);
+  });
+}
+BENCHMARK_REGISTER_F(BM_BleScanFilter, linear)->Arg(10)->Arg(100)->Arg(1000);
+
+BENCHMARK_DEFINE_F(BM_BleScanFilter, compiled)(State& state) {
+  Replay(state, [this](const Advertisement& adv) {
+    return engine_.Match(BLE_ADDR_RANDOM, adv.addr, adv.rssi, adv.data.data(),
+                         adv.data.size());
+  });
+}
+BENCHMARK_REGISTER_F(BM_BleScanFilter, compiled)->Arg(10)->Arg(100)->Arg(1000);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares security device record lookups walking the record list, as
+// btm_find_dev() and btm_find_dev_by_handle() did, with the hash index, for a
+// list of bonded devices of the size a long lived phone accumulates.
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+
+#include <list>
+#include <vector>
+
+#include "bt_target.h"
+#include "stack/btm/btm_sec_dev_index.h"
+
+using ::benchmark::State;
+
+namespace {
+
+RawAddress MakeAddress(uint32_t n) {
+  RawAddress addr;
+  addr.address[0] = 0xc0;
+  addr.address[1] = 0x11;
+  addr.address[2] = n >> 24;
+  addr.address[3] = n >> 16;
+  addr.address[4] = n >> 8;
+  addr.address[5] = n;
+  return addr;
+}
+
+/* Record lookups as done before the index; the record list is a linked list
+ * of heap allocated records, like the list_t of btm_cb.sec_dev_rec */
+tBTM_SEC_DEV_REC* linear_find_dev(const std::list<tBTM_SEC_DEV_REC*>& records,
+                                  const RawAddress& bd_addr) {
+  for (auto* p_dev_rec : records) {
+    if (p_dev_rec->bd_addr == bd_addr) return p_dev_rec;
+    if (p_dev_rec->ble.pseudo_addr == bd_addr) return p_dev_rec;
+  }
+  return nullptr;
+}
+
+tBTM_SEC_DEV_REC* linear_find_dev_by_handle(
+    const std::list<tBTM_SEC_DEV_REC*>& records, uint16_t handle) {
+  for (auto* p_dev_rec : records) {
+    if (p_dev_rec->hci_handle == handle || p_dev_rec->ble_hci_handle == handle)
+      return p_dev_rec;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+class BM_SecDevRecIndex : public ::benchmark::Fixture {
+ protected:
+  // Argument is the number of bonded device records
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    num_records_ = st.range(0);
+    for (uint32_t i = 0; i < num_records_; i++) {
+      auto* p_dev_rec =
+          static_cast<tBTM_SEC_DEV_REC*>(calloc(1, sizeof(tBTM_SEC_DEV_REC)));
+      p_dev_rec->bd_addr = MakeAddress(i);
+      p_dev_rec->hci_handle = BTM_SEC_INVALID_HANDLE;
+      p_dev_rec->ble_hci_handle = BTM_SEC_INVALID_HANDLE;
+      /* A few devices are connected, the most recently bonded ones */
+      if (i >= num_records_ - kConnected) {
+        p_dev_rec->hci_handle = i - (num_records_ - kConnected);
+      }
+      records_.push_back(p_dev_rec);
+      index_.Add(p_dev_rec);
+    }
+  }
+
+  void TearDown(State& st) override {
+    index_.Clear();
+    for (auto* p_dev_rec : records_) free(p_dev_rec);
+    records_.clear();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  static constexpr uint32_t kConnected = 4;
+
+  uint32_t num_records_ = 0;
+  std::list<tBTM_SEC_DEV_REC*> records_;
+  SecDevRecIndex index_;
+};
+
+/* Lookups of known devices, spread over the whole list */
+BENCHMARK_DEFINE_F(BM_SecDevRecIndex, find_dev_linear)(State& state) {
+  uint32_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        linear_find_dev(records_, MakeAddress(i++ % num_records_)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(BM_SecDevRecIndex, find_dev_indexed)(State& state) {
+  uint32_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        index_.FindByAddress(MakeAddress(i++ % num_records_)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/* Lookups of devices never bonded, e.g. for every inquiry or advertising
+ * report of a new device */
+BENCHMARK_DEFINE_F(BM_SecDevRecIndex, find_dev_miss_linear)(State& state) {
+  uint32_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        linear_find_dev(records_, MakeAddress(num_records_ + i++)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(BM_SecDevRecIndex, find_dev_miss_indexed)(State& state) {
+  uint32_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        index_.FindByAddress(MakeAddress(num_records_ + i++)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/* Lookups of connected devices by handle, as done for HCI events */
+BENCHMARK_DEFINE_F(BM_SecDevRecIndex, find_dev_by_handle_linear)
+(State& state) {
+  uint16_t handle = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        linear_find_dev_by_handle(records_, handle++ % kConnected));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(BM_SecDevRecIndex, find_dev_by_handle_indexed)
+(State& state) {
+  uint16_t handle = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index_.FindByHandle(handle++ % kConnected));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_SecDevRecIndex, find_dev_linear)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_REGISTER_F(BM_SecDevRecIndex, find_dev_indexed)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_REGISTER_F(BM_SecDevRecIndex, find_dev_miss_linear)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_REGISTER_F(BM_SecDevRecIndex, find_dev_miss_indexed)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_REGISTER_F(BM_SecDevRecIndex, find_dev_by_handle_linear)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_REGISTER_F(BM_SecDevRecIndex, find_dev_by_handle_indexed)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
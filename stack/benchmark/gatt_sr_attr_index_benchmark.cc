@@ -0,0 +1,227 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <base/logging.h>
+#include <benchmark/benchmark.h>
+#include <list>
+#include <vector>
+
+#include "stack/gatt/gatt_int.h"
+
+using ::benchmark::State;
+using bluetooth::Uuid;
+
+/* A large server database: 50 services of 40 attributes each */
+#define NUM_SERVICES 50
+#define NUM_ATTRS_PER_SERVICE 40
+#define FIRST_CHAR_UUID 0x2A00
+
+tGATT_CB gatt_cb;
+
+namespace connection_manager {
+bool background_connect_remove(uint8_t app_id, const RawAddress& address) {
+  return false;
+}
+bool direct_connect_remove(uint8_t app_id, const RawAddress& address) {
+  return false;
+}
+}  // namespace connection_manager
+
+BT_HDR* attp_build_sr_msg(tGATT_TCB& tcb, uint8_t op_code,
+                          tGATT_SR_MSG* p_msg) {
+  return nullptr;
+}
+tGATT_STATUS attp_send_cl_msg(tGATT_TCB& tcb, tGATT_CLCB* p_clcb,
+                              uint8_t op_code, tGATT_CL_MSG* p_msg) {
+  return 0;
+}
+tGATT_STATUS attp_send_sr_msg(tGATT_TCB& tcb, BT_HDR* p_msg) { return 0; }
+uint8_t btm_ble_read_sec_key_size(const RawAddress& bd_addr) { return 0; }
+bool BTM_GetSecurityFlagsByTransport(const RawAddress& bd_addr,
+                                     uint8_t* p_sec_flags,
+                                     tBT_TRANSPORT transport) {
+  return false;
+}
+void gatt_act_discovery(tGATT_CLCB* p_clcb) {}
+bool gatt_disconnect(tGATT_TCB* p_tcb) { return false; }
+tGATT_CH_STATE gatt_get_ch_state(tGATT_TCB* p_tcb) { return 0; }
+void gatt_set_ch_state(tGATT_TCB* p_tcb, tGATT_CH_STATE ch_state) {}
+void gatt_dequeue_sr_cmd(tGATT_TCB& tcb) {}
+void gatts_proc_srv_chg_ind_ack(tGATT_TCB tcb) {}
+void gatt_update_app_use_link_flag(tGATT_IF gatt_if, tGATT_TCB* p_tcb,
+                                   bool is_add, bool check_acl_link) {}
+bool SDP_AddAttribute(uint32_t handle, uint16_t attr_id, uint8_t attr_type,
+                      uint32_t attr_len, uint8_t* p_val) {
+  return false;
+}
+bool SDP_AddProtocolList(uint32_t handle, uint16_t num_elem,
+                         tSDP_PROTOCOL_ELEM* p_elem_list) {
+  return false;
+}
+bool SDP_AddServiceClassIdList(uint32_t handle, uint16_t num_services,
+                               uint16_t* p_service_uuids) {
+  return false;
+}
+bool SDP_AddUuidSequence(uint32_t handle, uint16_t attr_id, uint16_t num_uuids,
+                         uint16_t* p_uuids) {
+  return false;
+}
+uint32_t SDP_CreateRecord(void) { return 0; }
+
+namespace {
+
+/* Service lookup as done before the attribute index */
+tGATT_ATTR* linear_find_attr(uint16_t handle) {
+  for (auto& el : *gatt_cb.srv_list_info) {
+    if (el.s_hdl <= handle && el.e_hdl >= handle) {
+      for (auto& attr : el.p_db->attr_list) {
+        if (attr.handle == handle) return &attr;
+      }
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+/* Read By Type scan as done before the attribute index */
+size_t linear_count_by_type(const Uuid& type, uint16_t s_hdl, uint16_t e_hdl) {
+  size_t count = 0;
+  for (auto& el : *gatt_cb.srv_list_info) {
+    if (el.s_hdl <= e_hdl && el.e_hdl >= s_hdl) {
+      for (auto& attr : el.p_db->attr_list) {
+        if (attr.handle >= s_hdl && attr.handle <= e_hdl && type == attr.uuid)
+          count++;
+      }
+    }
+  }
+  return count;
+}
+
+}  // namespace
+
+class BM_GattSrAttrIndex : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    gatt_cb.srv_list_info = new std::list<tGATT_SRV_LIST_ELEM>();
+    dbs_.resize(NUM_SERVICES);
+
+    uint16_t handle = 1;
+    for (int i = 0; i < NUM_SERVICES; i++) {
+      tGATT_SVC_DB& db = dbs_[i];
+      uint16_t s_hdl = handle;
+      for (int j = 0; j < NUM_ATTRS_PER_SERVICE; j++) {
+        tGATT_ATTR attr;
+        attr.handle = handle++;
+        attr.permission = GATT_PERM_READ;
+        attr.gatt_type = BTGATT_DB_CHARACTERISTIC;
+        if (j == 0) {
+          attr.uuid = Uuid::From16Bit(GATT_UUID_PRI_SERVICE);
+        } else if (j % 2) {
+          attr.uuid = Uuid::From16Bit(GATT_UUID_CHAR_DECLARE);
+        } else {
+          attr.uuid = Uuid::From16Bit(FIRST_CHAR_UUID + j);
+        }
+        db.attr_list.emplace_back(std::move(attr));
+      }
+      db.end_handle = handle - 1;
+
+      tGATT_SRV_LIST_ELEM el;
+      memset(&el, 0, sizeof(el));
+      el.s_hdl = s_hdl;
+      el.e_hdl = db.end_handle;
+      el.p_db = &db;
+      el.is_primary = true;
+      gatt_cb.srv_list_info->push_back(el);
+    }
+    last_handle_ = handle - 1;
+    gatt_sr_rebuild_attr_index();
+  }
+
+  void TearDown(State& st) override {
+    delete gatt_cb.srv_list_info;
+    gatt_cb.srv_list_info = nullptr;
+    gatt_sr_rebuild_attr_index();
+    dbs_.clear();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  std::vector<tGATT_SVC_DB> dbs_;
+  uint16_t last_handle_ = 0;
+};
+
+BENCHMARK_F(BM_GattSrAttrIndex, find_attr_by_handle_linear)(State& state) {
+  for (auto _ : state) {
+    for (uint16_t handle = 1; handle <= last_handle_; handle++) {
+      benchmark::DoNotOptimize(linear_find_attr(handle));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * last_handle_);
+};
+
+BENCHMARK_F(BM_GattSrAttrIndex, find_attr_by_handle_indexed)(State& state) {
+  for (auto _ : state) {
+    for (uint16_t handle = 1; handle <= last_handle_; handle++) {
+      benchmark::DoNotOptimize(gatt_sr_find_attr_by_handle(handle));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * last_handle_);
+};
+
+BENCHMARK_F(BM_GattSrAttrIndex, find_service_by_handle)(State& state) {
+  for (auto _ : state) {
+    for (uint16_t handle = 1; handle <= last_handle_; handle++) {
+      benchmark::DoNotOptimize(gatt_sr_find_i_rcb_by_handle(handle));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * last_handle_);
+};
+
+/* Read By Type of a characteristic UUID, as done by a client looking up a
+ * single characteristic over the whole database */
+BENCHMARK_F(BM_GattSrAttrIndex, read_by_type_linear)(State& state) {
+  Uuid type = Uuid::From16Bit(FIRST_CHAR_UUID + 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(linear_count_by_type(type, 0x0001, 0xFFFF));
+  }
+};
+
+BENCHMARK_F(BM_GattSrAttrIndex, read_by_type_indexed)(State& state) {
+  Uuid type = Uuid::From16Bit(FIRST_CHAR_UUID + 2);
+  for (auto _ : state) {
+    tGATT_ATTR_INDEX_RANGE range =
+        gatt_sr_find_attrs_by_type(type, 0x0001, 0xFFFF);
+    benchmark::DoNotOptimize(range.second - range.first);
+  }
+};
+
+BENCHMARK_F(BM_GattSrAttrIndex, rebuild_index)(State& state) {
+  for (auto _ : state) {
+    gatt_sr_rebuild_attr_index();
+  }
+};
+
+int main(int argc, char** argv) {
+  // Disable LOG() output from libchrome
+  logging::LoggingSettings log_settings;
+  log_settings.logging_dest = logging::LoggingDestination::LOG_NONE;
+  CHECK(logging::InitLogging(log_settings)) << "Failed to set up logging";
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
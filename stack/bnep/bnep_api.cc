@@ -322,9 +322,14 @@ tBNEP_RESULT BNEP_Disconnect(uint16_t handle) {
  *                  BNEP_MTU_EXCEDED        - If the data length is greater than
  *                                            the MTU
  *                  BNEP_IGNORE_CMD         - If the packet is filtered out
- *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full
+ *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full, the
+ *                                            buffer is not freed: the caller
+ *                                            still owns it, and frees it or
+ *                                            writes it again later
  *                  BNEP_SUCCESS            - If written successfully
  *
+ *                  The buffer is freed by BNEP on every other return.
+ *
  ******************************************************************************/
 tBNEP_RESULT BNEP_WriteBuf(uint16_t handle, const RawAddress& p_dest_addr,
                            BT_HDR* p_buf, uint16_t protocol,
@@ -346,6 +351,12 @@ tBNEP_RESULT BNEP_WriteBuf(uint16_t handle, const RawAddress& p_dest_addr,
     return (BNEP_MTU_EXCEDED);
   }
 
+  /* Check transmit queue before touching the buffer, so that the caller can
+   * keep it for a retry */
+  if (fixed_queue_length(p_bcb->xmit_q) >= BNEP_MAX_XMITQ_DEPTH) {
+    return (BNEP_Q_SIZE_EXCEEDED);
+  }
+
   /* Check if the packet should be filtered out */
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
   if (bnep_is_packet_allowed(p_bcb, p_dest_addr, protocol, fw_ext_present,
@@ -383,7 +394,10 @@ tBNEP_RESULT BNEP_WriteBuf(uint16_t handle, const RawAddress& p_dest_addr,
         protocol = 0;
       else {
         new_len += 4;
-        if (new_len > org_len) return BNEP_IGNORE_CMD;
+        if (new_len > org_len) {
+          osi_free(p_buf);
+          return BNEP_IGNORE_CMD;
+        }
         p_data[2] = 0;
         p_data[3] = 0;
       }
@@ -394,12 +408,6 @@ tBNEP_RESULT BNEP_WriteBuf(uint16_t handle, const RawAddress& p_dest_addr,
     }
   }
 
-  /* Check transmit queue */
-  if (fixed_queue_length(p_bcb->xmit_q) >= BNEP_MAX_XMITQ_DEPTH) {
-    osi_free(p_buf);
-    return (BNEP_Q_SIZE_EXCEEDED);
-  }
-
   /* Build the BNEP header */
   bnepu_build_bnep_hdr(p_bcb, p_buf, protocol, p_src_addr, &p_dest_addr,
                        fw_ext_present);
@@ -429,7 +437,9 @@ tBNEP_RESULT BNEP_WriteBuf(uint16_t handle, const RawAddress& p_dest_addr,
  *                  BNEP_MTU_EXCEDED        - If the data length is greater than
  *                                            the MTU
  *                  BNEP_IGNORE_CMD         - If the packet is filtered out
- *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full
+ *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full, nothing
+ *                                            is copied and the caller may
+ *                                            write the data again later
  *                  BNEP_NO_RESOURCES       - If not able to allocate a buffer
  *                  BNEP_SUCCESS            - If written successfully
  *
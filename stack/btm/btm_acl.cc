@@ -42,10 +42,13 @@
 #include "bt_target.h"
 #include "bt_types.h"
 #include "bt_utils.h"
+#include "btif_config.h"
 #include "btm_api.h"
 #include "btm_int.h"
+#include "btm_peer_profile.h"
 #include "btu.h"
 #include "common/metrics.h"
+#include "common/time_util.h"
 #include "device/include/controller.h"
 #include "device/include/interop.h"
 #include "hcidefs.h"
@@ -121,6 +124,11 @@ uint8_t btm_handle_to_acl_index(uint16_t hci_handle) {
   tACL_CONN* p = &btm_cb.acl_db[0];
   uint8_t xx;
   BTM_TRACE_DEBUG("btm_handle_to_acl_index");
+  if (hci_handle < BTM_ACL_HANDLE_INDEX_SIZE) {
+    xx = btm_cb.acl_handle_index[hci_handle];
+    return (xx == 0) ? MAX_L2CAP_LINKS : xx - 1;
+  }
+
   for (xx = 0; xx < MAX_L2CAP_LINKS; xx++, p++) {
     if ((p->in_use) && (p->hci_handle == hci_handle)) {
       break;
@@ -131,6 +139,31 @@ uint8_t btm_handle_to_acl_index(uint16_t hci_handle) {
   return (xx);
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_acl_index_handle
+ *
+ * Description      This function refreshes the handle index entry of
+ *                  |hci_handle| after an acl_db entry started or stopped
+ *                  using it.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void btm_acl_index_handle(uint16_t hci_handle) {
+  if (hci_handle >= BTM_ACL_HANDLE_INDEX_SIZE) return;
+
+  uint8_t index = 0;
+  for (uint8_t xx = 0; xx < MAX_L2CAP_LINKS; xx++) {
+    if (btm_cb.acl_db[xx].in_use &&
+        btm_cb.acl_db[xx].hci_handle == hci_handle) {
+      index = xx + 1;
+      break;
+    }
+  }
+  btm_cb.acl_handle_index[hci_handle] = index;
+}
+
 #if (BLE_PRIVACY_SPT == TRUE)
 /*******************************************************************************
  *
@@ -201,7 +234,10 @@ void btm_acl_created(const RawAddress& bda, DEV_CLASS dc, BD_NAME bdn,
   /* Ensure we don't have duplicates */
   p = btm_bda_to_acl(bda, transport);
   if (p != (tACL_CONN*)NULL) {
+    uint16_t old_handle = p->hci_handle;
     p->hci_handle = hci_handle;
+    btm_acl_index_handle(old_handle);
+    btm_acl_index_handle(hci_handle);
     p->link_role = link_role;
     p->transport = transport;
     VLOG(1) << "Duplicate btm_acl_created: RemBdAddr: " << bda;
@@ -214,9 +250,11 @@ void btm_acl_created(const RawAddress& bda, DEV_CLASS dc, BD_NAME bdn,
     if (!p->in_use) {
       p->in_use = true;
       p->hci_handle = hci_handle;
+      btm_acl_index_handle(hci_handle);
       p->link_role = link_role;
       p->link_up_issued = false;
       p->remote_addr = bda;
+      p->flush_count = 0;
 
       p->transport = transport;
 #if (BLE_PRIVACY_SPT == TRUE)
@@ -232,6 +270,7 @@ void btm_acl_created(const RawAddress& bda, DEV_CLASS dc, BD_NAME bdn,
       p->switch_role_state = BTM_ACL_SWKEY_STATE_IDLE;
 
       btm_pm_sm_alloc(xx);
+      btm_peer_profile_link_up(bda, transport);
 
       if (dc) memcpy(p->remote_dc, dc, DEV_CLASS_LEN);
 
@@ -345,6 +384,8 @@ void btm_acl_removed(const RawAddress& bda, tBT_TRANSPORT transport) {
   p = btm_bda_to_acl(bda, transport);
   if (p != (tACL_CONN*)NULL) {
     p->in_use = false;
+    btm_acl_index_handle(p->hci_handle);
+    btm_peer_profile_link_down(bda, transport, btm_cb.acl_disc_reason);
 
     /* if the disconnected channel has a pending role switch, clear it now */
     btm_acl_report_role_change(HCI_ERR_NO_CONNECTION, &bda);
@@ -900,7 +941,8 @@ void btm_read_remote_version_complete(uint8_t* p) {
 
       if (p_acl_cb->transport == BT_TRANSPORT_LE) {
         l2cble_notify_le_connection(p_acl_cb->remote_addr);
-        btm_use_preferred_conn_params(p_acl_cb->remote_addr);
+        if (!btm_peer_profile_apply_le(p_acl_cb->remote_addr))
+          btm_use_preferred_conn_params(p_acl_cb->remote_addr);
       }
       break;
     }
@@ -1931,6 +1973,43 @@ tBTM_STATUS BTM_ReadFailedContactCounter(const RawAddress& remote_bda,
   return (BTM_UNKNOWN_ADDR);
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_acl_flush_occurred
+ *
+ * Description      This function is called when the controller flushed the
+ *                  packet it was sending on an ACL link, i.e. on a Flush
+ *                  Occurred event.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_acl_flush_occurred(uint16_t hci_handle) {
+  uint8_t index = btm_handle_to_acl_index(hci_handle);
+  if (index >= MAX_L2CAP_LINKS) return;
+
+  btm_cb.acl_db[index].flush_count++;
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_GetAclFlushCount
+ *
+ * Description      This function returns the number of packets the controller
+ *                  flushed on the BR/EDR ACL link to a peer since the link was
+ *                  established. Unlike the Failed Contact Counter, the count is
+ *                  not reset when a packet is acknowledged, and reading it
+ *                  sends no HCI command.
+ *
+ * Returns          the count, or 0 if there is no link to the peer
+ *
+ ******************************************************************************/
+uint32_t BTM_GetAclFlushCount(const RawAddress& remote_bda) {
+  tACL_CONN* p = btm_bda_to_acl(remote_bda, BT_TRANSPORT_BR_EDR);
+  if (p == NULL) return 0;
+  return p->flush_count;
+}
+
 /*******************************************************************************
  *
  * Function         BTM_ReadAutomaticFlushTimeout
@@ -2135,6 +2214,7 @@ void btm_read_rssi_complete(uint8_t* p) {
           break;
         }
       }
+      btm_peer_profile_rssi(handle, result.rssi);
     } else {
       result.status = BTM_ERR_PROCESSING;
     }
@@ -2593,3 +2673,323 @@ void btm_acl_chk_peer_pkt_type_support(tACL_CONN* p, uint16_t* p_pkt_type) {
           (BTM_ACL_PKT_TYPES_MASK_NO_2_DH5 + BTM_ACL_PKT_TYPES_MASK_NO_3_DH5);
   }
 }
+
+/*******************************************************************************
+ *
+ * Link parameters learned per peer
+ *
+ ******************************************************************************/
+
+/* PHY values of the LE PHY Update Complete event */
+#define BTM_PEER_PROFILE_PHY_1M 1
+#define BTM_PEER_PROFILE_PHY_2M 2
+#define BTM_PEER_PROFILE_PHY_CODED 3
+
+static bool btm_peer_profile_load(const RawAddress& bda,
+                                  PeerProfile* p_profile);
+static void btm_peer_profile_store(const RawAddress& bda,
+                                   const PeerProfile* p_profile);
+
+static PeerProfileCache& btm_peer_profiles() {
+  static PeerProfileCache cache(bluetooth::common::time_get_os_boottime_us,
+                                btm_peer_profile_load, btm_peer_profile_store);
+  return cache;
+}
+
+/* The keys of a profile in the config, all written together */
+static const std::string* const btm_peer_profile_keys[] = {
+    &BT_CONFIG_KEY_LEARNED_CONN_INTERVAL, &BT_CONFIG_KEY_LEARNED_CONN_LATENCY,
+    &BT_CONFIG_KEY_LEARNED_CONN_TIMEOUT,  &BT_CONFIG_KEY_LEARNED_TX_PHY,
+    &BT_CONFIG_KEY_LEARNED_RX_PHY,        &BT_CONFIG_KEY_LEARNED_DATA_LENGTH,
+    &BT_CONFIG_KEY_LEARNED_MTU,           &BT_CONFIG_KEY_LEARNED_A2DP_LEVEL,
+    &BT_CONFIG_KEY_LEARNED_RSSI};
+
+static bool btm_peer_profile_load(const RawAddress& bda,
+                                  PeerProfile* p_profile) {
+  const std::string section = bda.ToString();
+  int values[sizeof(btm_peer_profile_keys) / sizeof(btm_peer_profile_keys[0])];
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    if (!btif_config_get_int(section, *btm_peer_profile_keys[i], &values[i]))
+      return false;
+  }
+  p_profile->conn_interval = values[0];
+  p_profile->conn_latency = values[1];
+  p_profile->supervision_tout = values[2];
+  p_profile->tx_phy = values[3];
+  p_profile->rx_phy = values[4];
+  p_profile->tx_data_len = values[5];
+  p_profile->att_mtu = values[6];
+  p_profile->a2dp_level = values[7];
+  p_profile->rssi = values[8];
+  return true;
+}
+
+static void btm_peer_profile_store(const RawAddress& bda,
+                                   const PeerProfile* p_profile) {
+  const std::string section = bda.ToString();
+  if (p_profile == nullptr) {
+    if (!btif_config_exist(section, BT_CONFIG_KEY_LEARNED_CONN_INTERVAL))
+      return;
+    for (const std::string* p_key : btm_peer_profile_keys)
+      btif_config_remove(section, *p_key);
+    btif_config_save();
+    return;
+  }
+
+  /* Unbonded peers are only remembered until the stack is restarted */
+  if (!btm_sec_is_a_bonded_dev(bda)) return;
+
+  const int values[] = {p_profile->conn_interval, p_profile->conn_latency,
+                        p_profile->supervision_tout, p_profile->tx_phy,
+                        p_profile->rx_phy,          p_profile->tx_data_len,
+                        p_profile->att_mtu,         p_profile->a2dp_level,
+                        p_profile->rssi};
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    btif_config_set_int(section, *btm_peer_profile_keys[i], values[i]);
+  btif_config_save();
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_link_up
+ *
+ * Description      This function starts learning the parameters of a new ACL
+ *                  link.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_peer_profile_link_up(const RawAddress& bda, tBT_TRANSPORT transport) {
+  PeerProfile initial;
+  if (transport == BT_TRANSPORT_LE) {
+    tL2C_LCB* p_lcb = l2cu_find_lcb_by_bd_addr(bda, BT_TRANSPORT_LE);
+    if (p_lcb != NULL) {
+      initial.conn_interval = p_lcb->conn_interval;
+      initial.conn_latency = p_lcb->latency;
+      initial.supervision_tout = p_lcb->timeout;
+    }
+    initial.tx_phy = BTM_PEER_PROFILE_PHY_1M;
+    initial.rx_phy = BTM_PEER_PROFILE_PHY_1M;
+    initial.tx_data_len = BTM_BLE_DATA_SIZE_MIN;
+  }
+  btm_peer_profiles().OnLinkUp(bda, transport == BT_TRANSPORT_LE, initial,
+                               NULL);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_link_down
+ *
+ * Description      This function learns the parameters an ACL link settled
+ *                  on when it was disconnected with |reason|, unless it timed
+ *                  out.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_peer_profile_link_down(const RawAddress& bda, tBT_TRANSPORT transport,
+                                uint8_t reason) {
+  bool lost = (reason == HCI_ERR_CONNECTION_TOUT ||
+               reason == HCI_ERR_LMP_RESPONSE_TIMEOUT ||
+               reason == HCI_ERR_INSTANT_PASSED ||
+               reason == HCI_ERR_CONN_FAILED_ESTABLISHMENT);
+  btm_peer_profiles().OnLinkDown(bda, transport == BT_TRANSPORT_LE, lost);
+}
+
+/* Returns the PHY mask of |phy| for BTM_BleSetPhy(), or 0 if the controller
+ * or the peer does not support it */
+static uint8_t btm_peer_profile_phy_mask(const tACL_CONN* p_acl, uint8_t phy) {
+  const controller_t* controller = controller_get_interface();
+  switch (phy) {
+    case BTM_PEER_PROFILE_PHY_1M:
+      return PHY_LE_1M_MASK;
+    case BTM_PEER_PROFILE_PHY_2M:
+      if (!controller->supports_ble_2m_phy() ||
+          !HCI_LE_2M_PHY_SUPPORTED(p_acl->peer_le_features))
+        return 0;
+      return PHY_LE_2M_MASK;
+    case BTM_PEER_PROFILE_PHY_CODED:
+      if (!controller->supports_ble_coded_phy() ||
+          !HCI_LE_CODED_PHY_SUPPORTED(p_acl->peer_le_features))
+        return 0;
+      return PHY_LE_CODED_MASK;
+    default:
+      return 0;
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_apply_le
+ *
+ * Description      This function requests, once the remote features of a new
+ *                  LE link are known, the PHY, data length and connection
+ *                  parameters the previous links to the peer settled on.
+ *
+ * Returns          true if the learned connection parameters were requested
+ *
+ ******************************************************************************/
+bool btm_peer_profile_apply_le(const RawAddress& bda) {
+  PeerProfileCache& cache = btm_peer_profiles();
+  PeerProfile learned;
+  if (!cache.Get(bda, &learned)) return false;
+
+  tACL_CONN* p_acl = btm_bda_to_acl(bda, BT_TRANSPORT_LE);
+  tL2C_LCB* p_lcb = l2cu_find_lcb_by_bd_addr(bda, BT_TRANSPORT_LE);
+  if (p_acl == NULL || p_lcb == NULL) return false;
+
+  uint8_t tx_phys = btm_peer_profile_phy_mask(p_acl, learned.tx_phy);
+  uint8_t rx_phys = btm_peer_profile_phy_mask(p_acl, learned.rx_phy);
+  if (tx_phys != 0 && rx_phys != 0 &&
+      (tx_phys != PHY_LE_1M_MASK || rx_phys != PHY_LE_1M_MASK)) {
+    BTM_TRACE_DEBUG("%s: %s: PHY 0x%x/0x%x", __func__,
+                    bda.ToString().c_str(), tx_phys, rx_phys);
+    BTM_BleSetPhy(bda, tx_phys, rx_phys, 0);
+    cache.OnApplied(bda, true, PeerProfileCache::kPhy);
+  }
+
+  if (learned.tx_data_len > BTM_BLE_DATA_SIZE_MIN &&
+      learned.tx_data_len != p_lcb->tx_data_len &&
+      BTM_SetBleDataLength(bda, learned.tx_data_len) == BTM_SUCCESS) {
+    cache.OnApplied(bda, true, PeerProfileCache::kDataLength);
+  }
+
+  /* As master only: a slave leaves the master the time to set up the link
+   * before asking for other parameters */
+  if (p_lcb->link_role != HCI_ROLE_MASTER || learned.conn_interval == 0 ||
+      learned.conn_interval == p_lcb->conn_interval)
+    return false;
+  BTM_TRACE_DEBUG("%s: %s: interval %d, latency %d, timeout %d", __func__,
+                  bda.ToString().c_str(), learned.conn_interval,
+                  learned.conn_latency, learned.supervision_tout);
+  if (!L2CA_UpdateBleConnParams(bda, learned.conn_interval,
+                                learned.conn_interval, learned.conn_latency,
+                                learned.supervision_tout))
+    return false;
+  cache.OnApplied(bda, true, PeerProfileCache::kConnParams);
+  return true;
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_conn_params
+ *
+ * Description      This function records the connection parameters an LE link
+ *                  was updated to.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_peer_profile_conn_params(const RawAddress& bda, uint16_t interval,
+                                  uint16_t latency, uint16_t timeout) {
+  btm_peer_profiles().OnConnParams(bda, interval, latency, timeout);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_phy
+ *
+ * Description      This function records the PHY an LE link was updated to.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_peer_profile_phy(uint16_t handle, uint8_t tx_phy, uint8_t rx_phy) {
+  uint8_t index = btm_handle_to_acl_index(handle);
+  if (index >= MAX_L2CAP_LINKS) return;
+  btm_peer_profiles().OnPhy(btm_cb.acl_db[index].remote_addr, tx_phy, rx_phy);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_data_length
+ *
+ * Description      This function records the data length of an LE link.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_peer_profile_data_length(const RawAddress& bda, uint16_t tx_data_len) {
+  btm_peer_profiles().OnDataLength(bda, tx_data_len);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_mtu
+ *
+ * Description      This function records the ATT MTU of an LE link.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_peer_profile_mtu(const RawAddress& bda, uint16_t mtu) {
+  btm_peer_profiles().OnMtu(bda, mtu);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_peer_profile_rssi
+ *
+ * Description      This function records the RSSI of the ACL link |handle|,
+ *                  read or reported by the controller.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_peer_profile_rssi(uint16_t handle, int8_t rssi) {
+  uint8_t index = btm_handle_to_acl_index(handle);
+  if (index >= MAX_L2CAP_LINKS) return;
+  const tACL_CONN* p_acl = &btm_cb.acl_db[index];
+  btm_peer_profiles().OnRssi(p_acl->remote_addr,
+                             p_acl->transport == BT_TRANSPORT_LE, rssi);
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_GetPeerA2dpAbrLevel
+ *
+ * Description      This function returns the A2DP adaptive bitrate level the
+ *                  streams to the peer settled on before, to start the next
+ *                  one at.
+ *
+ * Returns          true if a level was learned
+ *
+ ******************************************************************************/
+bool BTM_GetPeerA2dpAbrLevel(const RawAddress& bd_addr, uint8_t* p_level) {
+  PeerProfile learned;
+  if (!btm_peer_profiles().Get(bd_addr, &learned) || learned.a2dp_level < 0)
+    return false;
+  *p_level = learned.a2dp_level;
+  btm_peer_profiles().OnApplied(bd_addr, false, PeerProfileCache::kA2dpLevel);
+  return true;
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_SetPeerA2dpAbrLevel
+ *
+ * Description      This function records the A2DP adaptive bitrate level a
+ *                  stream to the peer settled on. It can be called from the
+ *                  A2DP Source thread.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void BTM_SetPeerA2dpAbrLevel(const RawAddress& bd_addr, uint8_t level) {
+  btm_peer_profiles().OnA2dpLevel(bd_addr, level);
+}
+
+/*******************************************************************************
+ *
+ * Function         stack_debug_peer_profile_dump
+ *
+ * Description      This function dumps the link parameters learned per peer,
+ *                  and how often they were reused.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void stack_debug_peer_profile_dump(int fd) {
+  dprintf(fd, "\nLearned peer link parameters:\n");
+  btm_peer_profiles().Dump(fd);
+}
@@ -33,6 +33,7 @@
 #include "hcimsgs.h"
 
 #include "btm_ble_int.h"
+#include "btm_sec_dev_index.h"
 #include "stack/crypto_toolbox/crypto_toolbox.h"
 
 /* This function generates Resolvable Private Address (RPA) from Identity
@@ -170,6 +171,7 @@ bool btm_ble_init_pseudo_addr(tBTM_SEC_DEV_REC* p_dev_rec,
                               const RawAddress& new_pseudo_addr) {
   if (p_dev_rec->ble.pseudo_addr.IsEmpty()) {
     p_dev_rec->ble.pseudo_addr = new_pseudo_addr;
+    btm_sec_update_dev_index(p_dev_rec);
     return true;
   }
 
@@ -272,22 +274,31 @@ tBTM_SEC_DEV_REC* btm_ble_resolve_random_addr(const RawAddress& random_bda) {
 tBTM_SEC_DEV_REC* btm_find_dev_by_identity_addr(const RawAddress& bd_addr,
                                                 uint8_t addr_type) {
 #if (BLE_PRIVACY_SPT == TRUE)
-  list_node_t* end = list_end(btm_cb.sec_dev_rec);
-  for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
-       node = list_next(node)) {
-    tBTM_SEC_DEV_REC* p_dev_rec =
-        static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
-    if (p_dev_rec->ble.identity_addr == bd_addr) {
-      if ((p_dev_rec->ble.identity_addr_type & (~BLE_ADDR_TYPE_ID_BIT)) !=
-          (addr_type & (~BLE_ADDR_TYPE_ID_BIT)))
-        BTM_TRACE_WARNING(
-            "%s find pseudo->random match with diff addr type: %d vs %d",
-            __func__, p_dev_rec->ble.identity_addr_type, addr_type);
-
-      /* found the match */
-      return p_dev_rec;
+  tBTM_SEC_DEV_REC* p_dev_rec = NULL;
+  if (SecDevRecIndex::IsIndexed(bd_addr)) {
+    p_dev_rec = btm_cb.sec_dev_rec_index->FindByIdentityAddress(bd_addr);
+  } else {
+    list_node_t* end = list_end(btm_cb.sec_dev_rec);
+    for (list_node_t* node = list_begin(btm_cb.sec_dev_rec); node != end;
+         node = list_next(node)) {
+      tBTM_SEC_DEV_REC* p_rec = static_cast<tBTM_SEC_DEV_REC*>(list_node(node));
+      if (p_rec->ble.identity_addr == bd_addr) {
+        p_dev_rec = p_rec;
+        break;
+      }
     }
   }
+
+  if (p_dev_rec != NULL) {
+    if ((p_dev_rec->ble.identity_addr_type & (~BLE_ADDR_TYPE_ID_BIT)) !=
+        (addr_type & (~BLE_ADDR_TYPE_ID_BIT)))
+      BTM_TRACE_WARNING(
+          "%s find pseudo->random match with diff addr type: %d vs %d",
+          __func__, p_dev_rec->ble.identity_addr_type, addr_type);
+
+    /* found the match */
+    return p_dev_rec;
+  }
 #endif
 
   return NULL;
@@ -0,0 +1,166 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btm_ble_adv_cache.h"
+
+#include <base/logging.h>
+#include <string.h>
+
+AdvertisingCache::AdvertisingCache(size_t capacity) : entries_(capacity) {
+  CHECK(capacity > 0 && capacity < kEmpty);
+
+  /* keep the index at most half full so that probe sequences stay short */
+  size_t index_size = 1;
+  int bits = 0;
+  while (index_size < 2 * capacity) {
+    index_size <<= 1;
+    bits++;
+  }
+  index_.assign(index_size, kEmpty);
+  index_mask_ = index_size - 1;
+  index_shift_ = 64 - bits;
+}
+
+size_t AdvertisingCache::HomeSlot(uint8_t addr_type,
+                                  const RawAddress& addr) const {
+  uint64_t key = addr_type;
+  for (uint8_t b : addr.address) key = (key << 8) | b;
+  /* Fibonacci hashing, the top bits are the best mixed */
+  return (key * 0x9E3779B97F4A7C15ull) >> index_shift_;
+}
+
+/* Returns the slot holding device |addr_type, addr|, or the empty slot where
+ * it would be inserted */
+size_t AdvertisingCache::FindSlot(uint8_t addr_type,
+                                  const RawAddress& addr) const {
+  size_t slot = HomeSlot(addr_type, addr);
+  while (index_[slot] != kEmpty) {
+    const Entry& entry = entries_[index_[slot]];
+    if (entry.addr == addr && entry.addr_type == addr_type) break;
+    slot = (slot + 1) & index_mask_;
+  }
+  return slot;
+}
+
+/* Removes the index at |slot|, moving back the following entries of the
+ * cluster that would not be reachable anymore */
+void AdvertisingCache::EraseSlot(size_t slot) {
+  size_t next = slot;
+  for (;;) {
+    next = (next + 1) & index_mask_;
+    if (index_[next] == kEmpty) break;
+
+    const Entry& entry = entries_[index_[next]];
+    size_t home = HomeSlot(entry.addr_type, entry.addr);
+    bool reachable = (slot <= next) ? (slot < home && home <= next)
+                                    : (slot < home || home <= next);
+    if (reachable) continue;
+
+    index_[slot] = index_[next];
+    slot = next;
+  }
+  index_[slot] = kEmpty;
+}
+
+void AdvertisingCache::LruUnlink(uint32_t idx) {
+  Entry& entry = entries_[idx];
+  if (entry.lru_prev != kEmpty)
+    entries_[entry.lru_prev].lru_next = entry.lru_next;
+  else
+    lru_head_ = entry.lru_next;
+  if (entry.lru_next != kEmpty)
+    entries_[entry.lru_next].lru_prev = entry.lru_prev;
+  else
+    lru_tail_ = entry.lru_prev;
+}
+
+void AdvertisingCache::LruPushFront(uint32_t idx) {
+  Entry& entry = entries_[idx];
+  entry.lru_prev = kEmpty;
+  entry.lru_next = lru_head_;
+  if (lru_head_ != kEmpty) entries_[lru_head_].lru_prev = idx;
+  lru_head_ = idx;
+  if (lru_tail_ == kEmpty) lru_tail_ = idx;
+}
+
+AdvertisingCache::Entry& AdvertisingCache::Get(uint8_t addr_type,
+                                               const RawAddress& addr) {
+  size_t slot = FindSlot(addr_type, addr);
+  uint32_t idx = index_[slot];
+  if (idx != kEmpty) {
+    if (idx != lru_head_) {
+      LruUnlink(idx);
+      LruPushFront(idx);
+    }
+    return entries_[idx];
+  }
+
+  if (num_entries_ < entries_.size()) {
+    idx = num_entries_++;
+  } else {
+    /* recycle the least recently heard advertiser */
+    idx = lru_tail_;
+    const Entry& old = entries_[idx];
+    EraseSlot(FindSlot(old.addr_type, old.addr));
+    LruUnlink(idx);
+    evictions_++;
+    slot = FindSlot(addr_type, addr);
+  }
+
+  Entry& entry = entries_[idx];
+  entry.addr_type = addr_type;
+  entry.addr = addr;
+  entry.data.clear();
+  entry.pending = false;
+  entry.reported_hash = 0;
+  entry.reported_time_ms = 0;
+  entry.inq_db_index = kNoInqDbIndex;
+
+  index_[slot] = idx;
+  LruPushFront(idx);
+  return entry;
+}
+
+AdvertisingCache::Entry* AdvertisingCache::Find(uint8_t addr_type,
+                                                const RawAddress& addr) {
+  uint32_t idx = index_[FindSlot(addr_type, addr)];
+  return idx != kEmpty ? &entries_[idx] : nullptr;
+}
+
+void AdvertisingCache::Clear() {
+  for (uint32_t i = 0; i < num_entries_; i++) entries_[i].data.clear();
+  index_.assign(index_.size(), kEmpty);
+  num_entries_ = 0;
+  lru_head_ = kEmpty;
+  lru_tail_ = kEmpty;
+}
+
+uint64_t AdvertisingCache::HashData(const uint8_t* data, size_t len) {
+  /* FNV-1a on 64 bit words, advertising data is hashed for every report */
+  uint64_t hash = 0xcbf29ce484222325ull ^ len;
+  while (len >= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ull;
+    hash ^= hash >> 29;
+    data += sizeof(word);
+    len -= sizeof(word);
+  }
+  while (len--) hash = (hash ^ *data++) * 0x100000001b3ull;
+  return hash;
+}
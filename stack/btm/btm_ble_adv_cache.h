@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "types/raw_address.h"
+
+/* Per advertiser state of the LE scan, kept in a bounded table indexed by
+ * address. Lookups go through an open addressed hash index, and the least
+ * recently used advertiser is recycled when the table is full. Entries are
+ * never freed, so the advertising data buffers are reused across advertisers
+ * instead of being reallocated for every report. */
+class AdvertisingCache {
+ public:
+  static constexpr uint16_t kNoInqDbIndex = UINT16_MAX;
+
+  struct Entry {
+    uint8_t addr_type;
+    RawAddress addr;
+
+    /* Advertising data of the device. While |pending| is set it is still being
+     * assembled from the advertisement, its chained packets and the scan
+     * response, otherwise it holds the last complete data. */
+    std::vector<uint8_t> data;
+    bool pending;
+
+    /* Hash of the data last reported to the observers, and when */
+    uint64_t reported_hash;
+    uint64_t reported_time_ms;
+
+    /* Index of the device in the inquiry database, it must be checked against
+     * the entry found there before use */
+    uint16_t inq_db_index;
+
+   private:
+    friend class AdvertisingCache;
+    uint32_t lru_prev;
+    uint32_t lru_next;
+  };
+
+  explicit AdvertisingCache(size_t capacity);
+
+  /* Returns the entry of device |addr_type, addr|, creating it if needed */
+  Entry& Get(uint8_t addr_type, const RawAddress& addr);
+
+  /* Returns the entry of device |addr_type, addr|, or nullptr */
+  Entry* Find(uint8_t addr_type, const RawAddress& addr);
+
+  /* Drops all the entries */
+  void Clear();
+
+  size_t size() const { return num_entries_; }
+  size_t capacity() const { return entries_.size(); }
+  uint64_t evictions() const { return evictions_; }
+
+  /* Hash of advertising data, used to recognize repeated advertisements */
+  static uint64_t HashData(const uint8_t* data, size_t len);
+
+ private:
+  static constexpr uint32_t kEmpty = UINT32_MAX;
+
+  size_t HomeSlot(uint8_t addr_type, const RawAddress& addr) const;
+  size_t FindSlot(uint8_t addr_type, const RawAddress& addr) const;
+  void EraseSlot(size_t slot);
+  void LruUnlink(uint32_t idx);
+  void LruPushFront(uint32_t idx);
+
+  std::vector<Entry> entries_;
+  /* Open addressed index of |entries_|, with linear probing */
+  std::vector<uint32_t> index_;
+  size_t index_mask_;
+  int index_shift_;
+  uint32_t num_entries_ = 0;
+  /* Most and least recently used entries */
+  uint32_t lru_head_ = kEmpty;
+  uint32_t lru_tail_ = kEmpty;
+  uint64_t evictions_ = 0;
+};
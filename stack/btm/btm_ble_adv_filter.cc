@@ -23,6 +23,7 @@
 #include "bt_types.h"
 #include "bt_utils.h"
 #include "btm_ble_api.h"
+#include "btm_ble_scan_filter.h"
 #include "btm_int.h"
 #include "btu.h"
 #include "device/include/controller.h"
@@ -82,6 +83,13 @@ bool is_filtering_supported() {
   return cmn_ble_vsc_cb.filter_support != 0 && cmn_ble_vsc_cb.max_filter != 0;
 }
 
+/* Filters applied by the host when the controller has none */
+static ScanFilterEngine sw_filter;
+
+static bool is_filtering_emulated() {
+  return !is_filtering_supported() && BTM_BLE_SW_FILTER_MAX > 0;
+}
+
 /*******************************************************************************
  *
  * Function         btm_ble_condtype_to_ocf
@@ -599,6 +607,12 @@ void BTM_LE_PF_uuid_filter(tBTM_BLE_SCAN_COND_OP action,
 void BTM_LE_PF_set(tBTM_BLE_PF_FILT_INDEX filt_index,
                    std::vector<ApcfCommand> commands,
                    tBTM_BLE_PF_CFG_CBACK cb) {
+  if (is_filtering_emulated() && filt_index < BTM_BLE_SW_FILTER_MAX) {
+    for (const ApcfCommand& cmd : commands) sw_filter.Add(filt_index, cmd);
+    cb.Run(0, 0, 0);
+    return;
+  }
+
   if (!is_filtering_supported()) {
     cb.Run(0, BTM_BLE_PF_ENABLE, 1 /* BTA_FAILURE */);
     return;
@@ -667,6 +681,12 @@ void BTM_LE_PF_set(tBTM_BLE_PF_FILT_INDEX filt_index,
  */
 void BTM_LE_PF_clear(tBTM_BLE_PF_FILT_INDEX filt_index,
                      tBTM_BLE_PF_CFG_CBACK cb) {
+  if (is_filtering_emulated()) {
+    sw_filter.Clear(filt_index);
+    cb.Run(0, 0, 0);
+    return;
+  }
+
   if (!is_filtering_supported()) {
     cb.Run(0, BTM_BLE_PF_ENABLE, 1 /* BTA_FAILURE */);
     return;
@@ -744,6 +764,24 @@ void BTM_BleAdvFilterParamSetup(
                 BTM_BLE_ADV_FILT_FEAT_SELN_LEN + BTM_BLE_ADV_FILT_TRACK_NUM;
   uint8_t param[len], *p;
 
+  if (is_filtering_emulated()) {
+    if (BTM_BLE_SCAN_COND_ADD == action) {
+      if (filt_index >= BTM_BLE_SW_FILTER_MAX) {
+        cb.Run(0, BTM_BLE_PF_ENABLE, 1 /* BTA_FAILURE */);
+        return;
+      }
+      sw_filter.SetParams(filt_index, p_filt_params->feat_seln,
+                          p_filt_params->filt_logic_type,
+                          (int8_t)p_filt_params->rssi_high_thres);
+    } else if (BTM_BLE_SCAN_COND_DELETE == action) {
+      sw_filter.DeleteParams(filt_index);
+    } else if (BTM_BLE_SCAN_COND_CLEAR == action) {
+      sw_filter.ClearParams();
+    }
+    cb.Run(BTM_BLE_SW_FILTER_MAX, action, 0);
+    return;
+  }
+
   if (!is_filtering_supported()) {
     cb.Run(0, BTM_BLE_PF_ENABLE, 1 /* BTA_FAILURE */);
     return;
@@ -862,6 +900,12 @@ void enable_cmpl_cback(tBTM_BLE_PF_STATUS_CBACK p_stat_cback, uint8_t* p,
  ******************************************************************************/
 void BTM_BleEnableDisableFilterFeature(uint8_t enable,
                                        tBTM_BLE_PF_STATUS_CBACK p_stat_cback) {
+  if (is_filtering_emulated()) {
+    sw_filter.Enable(enable != 0);
+    if (p_stat_cback) p_stat_cback.Run(enable, 0);
+    return;
+  }
+
   if (!is_filtering_supported()) {
     if (p_stat_cback) p_stat_cback.Run(BTM_BLE_PF_ENABLE, 1 /* BTA_FAILURE */);
     return;
@@ -879,6 +923,22 @@ void BTM_BleEnableDisableFilterFeature(uint8_t enable,
                             base::Bind(&enable_cmpl_cback, p_stat_cback));
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_ble_adv_filter_match
+ *
+ * Description      This function checks an advertising report against the
+ *                  filters emulated by the host
+ *
+ * Returns          true if the report is to be delivered
+ *
+ ******************************************************************************/
+bool btm_ble_adv_filter_match(uint8_t addr_type, const RawAddress& bda,
+                              int8_t rssi, const uint8_t* data, size_t len) {
+  if (!is_filtering_emulated()) return true;
+  return sw_filter.Match(addr_type, bda, rssi, data, len);
+}
+
 /*******************************************************************************
  *
  * Function         btm_ble_adv_filter_init
@@ -30,7 +30,6 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
-#include <list>
 #include <vector>
 
 #include "bt_types.h"
@@ -44,6 +43,7 @@
 #include "osi/include/osi.h"
 
 #include "advertise_data_parser.h"
+#include "btm_ble_adv_cache.h"
 #include "btm_ble_int.h"
 #include "gatt_int.h"
 #include "gattdefs.h"
@@ -69,77 +69,9 @@
 
 namespace {
 
-class AdvertisingCache {
- public:
-  /* Set the data to |data| for device |addr_type, addr| */
-  const std::vector<uint8_t>& Set(uint8_t addr_type, const RawAddress& addr,
-                                  std::vector<uint8_t> data) {
-    auto it = Find(addr_type, addr);
-    if (it != items.end()) {
-      it->data = std::move(data);
-      return it->data;
-    }
-
-    if (items.size() > cache_max) {
-      items.pop_back();
-    }
-
-    items.emplace_front(addr_type, addr, std::move(data));
-    return items.front().data;
-  }
-
-  /* Append |data| for device |addr_type, addr| */
-  const std::vector<uint8_t>& Append(uint8_t addr_type, const RawAddress& addr,
-                                     std::vector<uint8_t> data) {
-    auto it = Find(addr_type, addr);
-    if (it != items.end()) {
-      it->data.insert(it->data.end(), data.begin(), data.end());
-      return it->data;
-    }
-
-    if (items.size() > cache_max) {
-      items.pop_back();
-    }
-
-    items.emplace_front(addr_type, addr, std::move(data));
-    return items.front().data;
-  }
-
-  /* Clear data for device |addr_type, addr| */
-  void Clear(uint8_t addr_type, const RawAddress& addr) {
-    auto it = Find(addr_type, addr);
-    if (it != items.end()) {
-      items.erase(it);
-    }
-  }
-
- private:
-  struct Item {
-    uint8_t addr_type;
-    RawAddress addr;
-    std::vector<uint8_t> data;
-
-    Item(uint8_t addr_type, const RawAddress& addr, std::vector<uint8_t> data)
-        : addr_type(addr_type), addr(addr), data(data) {}
-  };
-
-  std::list<Item>::iterator Find(uint8_t addr_type, const RawAddress& addr) {
-    for (auto it = items.begin(); it != items.end(); it++) {
-      if (it->addr_type == addr_type && it->addr == addr) {
-        return it;
-      }
-    }
-    return items.end();
-  }
-
-  /* we keep maximum 7 devices in the cache */
-  const size_t cache_max = 7;
-  std::list<Item> items;
-};
-
 /* Devices in this cache are waiting for eiter scan response, or chained packets
- * on secondary channel */
-AdvertisingCache cache;
+ * on secondary channel, or have been reported already */
+AdvertisingCache cache(BTM_BLE_ADV_CACHE_SIZE);
 
 }  // namespace
 
@@ -1926,6 +1858,22 @@ void btm_ble_process_adv_pkt(uint8_t data_len, uint8_t* data) {
   }
 }
 
+/* Finds the inquiry database entry of an advertiser, trying the one it had
+ * last time first */
+static tINQ_DB_ENT* btm_ble_inq_db_find(AdvertisingCache::Entry& entry,
+                                        const RawAddress& bda) {
+  tINQ_DB_ENT* inq_db = btm_cb.btm_inq_vars.inq_db;
+  if (entry.inq_db_index < BTM_INQ_DB_SIZE) {
+    tINQ_DB_ENT* p_i = &inq_db[entry.inq_db_index];
+    if (p_i->in_use && p_i->inq_info.results.remote_bd_addr == bda) return p_i;
+  }
+
+  tINQ_DB_ENT* p_i = btm_inq_db_find(bda);
+  entry.inq_db_index =
+      p_i ? p_i - inq_db : AdvertisingCache::kNoInqDbIndex;
+  return p_i;
+}
+
 /**
  * This function is called after random address resolution is done, and proceed
  * to process adv packet.
@@ -1939,24 +1887,24 @@ void btm_ble_process_adv_pkt_cont(uint16_t evt_type, uint8_t addr_type,
   tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
   bool update = true;
 
-  std::vector<uint8_t> tmp;
-  if (data_len != 0) tmp.insert(tmp.begin(), data, data + data_len);
-
   bool is_scannable = ble_evt_type_is_scannable(evt_type);
   bool is_scan_resp = ble_evt_type_is_scan_resp(evt_type);
 
   bool is_start =
       ble_evt_type_is_legacy(evt_type) && is_scannable && !is_scan_resp;
 
-  if (ble_evt_type_is_legacy(evt_type))
-    AdvertiseDataParser::RemoveTrailingZeros(tmp);
+  AdvertisingCache::Entry& entry = cache.Get(addr_type, bda);
 
   // We might have send scan request to this device before, but didn't get the
   // response. In such case make sure data is put at start, not appended to
   // already existing data.
-  std::vector<uint8_t> const& adv_data =
-      is_start ? cache.Set(addr_type, bda, std::move(tmp))
-               : cache.Append(addr_type, bda, std::move(tmp));
+  if (is_start || !entry.pending) entry.data.clear();
+
+  size_t fragment_start = entry.data.size();
+  entry.data.insert(entry.data.end(), data, data + data_len);
+  if (ble_evt_type_is_legacy(evt_type))
+    AdvertiseDataParser::RemoveTrailingZeros(entry.data, fragment_start);
+  entry.pending = true;
 
   bool data_complete = (ble_evt_type_data_status(evt_type) != 0x01);
 
@@ -1974,13 +1922,41 @@ void btm_ble_process_adv_pkt_cont(uint16_t evt_type, uint8_t addr_type,
     return;
   }
 
+  // The data is complete, the next advertisement of the device starts over
+  entry.pending = false;
+  std::vector<uint8_t> const& adv_data = entry.data;
+
   if (!AdvertiseDataParser::IsValid(adv_data)) {
     DVLOG(1) << __func__ << "Dropping bad advertisement packet: "
              << base::HexEncode(adv_data.data(), adv_data.size());
     return;
   }
 
-  tINQ_DB_ENT* p_i = btm_inq_db_find(bda);
+#if (BTM_BLE_ADV_DUP_SUPPRESS_MS > 0)
+  // Observers only: discovery needs the inquiry database to be updated. The
+  // data is recorded as reported once it is delivered to the observer.
+  bool suppress_dup = !BTM_BLE_IS_INQ_ACTIVE(btm_cb.ble_ctr_cb.scan_activity);
+  uint64_t now_ms = 0;
+  uint64_t data_hash = 0;
+  if (suppress_dup) {
+    now_ms = bluetooth::common::time_get_os_boottime_ms();
+    data_hash = AdvertisingCache::HashData(adv_data.data(), adv_data.size());
+    if (data_hash == entry.reported_hash &&
+        now_ms - entry.reported_time_ms < BTM_BLE_ADV_DUP_SUPPRESS_MS) {
+      DVLOG(1) << __func__ << ": Duplicate advertisement from " << bda;
+      return;
+    }
+  }
+#endif
+
+  // Without controller filters, observers only get what the host filters pass.
+  // Discovery still sees every device.
+  bool filter_pass = btm_ble_adv_filter_match(addr_type, bda, rssi,
+                                              adv_data.data(), adv_data.size());
+  if (!filter_pass && !BTM_BLE_IS_INQ_ACTIVE(btm_cb.ble_ctr_cb.scan_activity))
+    return;
+
+  tINQ_DB_ENT* p_i = btm_ble_inq_db_find(entry, bda);
 
   /* Check if this address has already been processed for this inquiry */
   if (btm_inq_find_bdaddr(bda)) {
@@ -2001,6 +1977,7 @@ void btm_ble_process_adv_pkt_cont(uint16_t evt_type, uint8_t addr_type,
   if (p_i == NULL) {
     p_i = btm_inq_db_new(bda);
     if (p_i != NULL) {
+      entry.inq_db_index = p_i - p_inq->inq_db;
       p_inq->inq_cmpl_info.num_resp++;
       p_i->time_of_resp = bluetooth::common::time_get_os_boottime_ms();
     } else
@@ -2019,7 +1996,6 @@ void btm_ble_process_adv_pkt_cont(uint16_t evt_type, uint8_t addr_type,
 
   uint8_t result = btm_ble_is_discoverable(bda, adv_data);
   if (result == 0) {
-    cache.Clear(addr_type, bda);
     LOG_WARN(LOG_TAG,
              "%s device no longer discoverable, discarding advertising packet",
              __func__);
@@ -2058,12 +2034,16 @@ void btm_ble_process_adv_pkt_cont(uint16_t evt_type, uint8_t addr_type,
   }
 
   tBTM_INQ_RESULTS_CB* p_obs_results_cb = btm_cb.ble_ctr_cb.p_obs_results_cb;
-  if (p_obs_results_cb && (result & BTM_BLE_OBS_RESULT)) {
+  if (p_obs_results_cb && (result & BTM_BLE_OBS_RESULT) && filter_pass) {
+#if (BTM_BLE_ADV_DUP_SUPPRESS_MS > 0)
+    if (suppress_dup) {
+      entry.reported_hash = data_hash;
+      entry.reported_time_ms = now_ms;
+    }
+#endif
     (p_obs_results_cb)((tBTM_INQ_RESULTS*)&p_i->inq_info.results,
                        const_cast<uint8_t*>(adv_data.data()), adv_data.size());
   }
-
-  cache.Clear(addr_type, bda);
 }
 
 void btm_ble_process_phy_update_pkt(uint8_t len, uint8_t* data) {
@@ -2078,6 +2058,7 @@ void btm_ble_process_phy_update_pkt(uint8_t len, uint8_t* data) {
   STREAM_TO_UINT8(tx_phy, p);
   STREAM_TO_UINT8(rx_phy, p);
 
+  if (status == HCI_SUCCESS) btm_peer_profile_phy(handle, tx_phy, rx_phy);
   gatt_notify_phy_updated(status, handle, tx_phy, rx_phy);
 }
 
@@ -0,0 +1,437 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btm_ble_scan_filter.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "bt_types.h"
+#include "btm_api_types.h"
+#include "btm_ble_api_types.h"
+
+using bluetooth::Uuid;
+
+namespace {
+
+/* AD types of the service solicitation UUID lists */
+constexpr uint8_t kSolicitation16BitUuids = 0x14;
+constexpr uint8_t kSolicitation32BitUuids = 0x1F;
+constexpr uint8_t kSolicitation128BitUuids = 0x15;
+
+constexpr uint8_t kSrvcUuids = 0;
+constexpr uint8_t kSolUuids = 1;
+
+/* Position of 16 and 32 bit UUIDs in the little endian 128 bit form */
+constexpr size_t kShortUuidOffset = 12;
+
+const Uuid::UUID128Bit kBaseUuid = Uuid::From16Bit(0).To128BitLE();
+
+uint32_t short_uuid_from_le(const uint8_t* p, size_t len) {
+  uint32_t uuid = p[0] | p[1] << 8;
+  if (len == Uuid::kNumBytes32) uuid |= p[2] << 16 | (uint32_t)p[3] << 24;
+  return uuid;
+}
+
+}  // namespace
+
+void ScanFilterEngine::PatternTrie::Clear() { nodes_.assign(1, Node()); }
+
+void ScanFilterEngine::PatternTrie::Add(const std::vector<uint8_t>& pattern,
+                                        const std::vector<uint8_t>& mask,
+                                        uint8_t filt_index) {
+  uint32_t node = 0;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    uint8_t m = i < mask.size() ? mask[i] : 0xFF;
+    uint8_t value = pattern[i] & m;
+
+    uint32_t child = nodes_.size();
+    if (m == 0xFF) {
+      auto& exact = nodes_[node].exact;
+      auto it = std::lower_bound(
+          exact.begin(), exact.end(), value,
+          [](const ExactEdge& edge, uint8_t v) { return edge.value < v; });
+      if (it != exact.end() && it->value == value) {
+        node = it->child;
+        continue;
+      }
+      exact.insert(it, {value, child});
+    } else {
+      auto& masked = nodes_[node].masked;
+      auto it = std::find_if(masked.begin(), masked.end(),
+                             [&](const MaskedEdge& edge) {
+                               return edge.value == value && edge.mask == m;
+                             });
+      if (it != masked.end()) {
+        node = it->child;
+        continue;
+      }
+      masked.push_back({value, m, child});
+    }
+    nodes_.emplace_back();
+    node = child;
+  }
+
+  nodes_[node].accept.set(filt_index);
+  nodes_[node].accepting = true;
+}
+
+void ScanFilterEngine::PatternTrie::Match(const uint8_t* data, size_t len,
+                                          FilterSet* out) const {
+  if (empty()) return;
+  MatchFrom(0, data, len, out);
+}
+
+void ScanFilterEngine::PatternTrie::MatchFrom(uint32_t node,
+                                              const uint8_t* data, size_t len,
+                                              FilterSet* out) const {
+  for (;;) {
+    const Node& n = nodes_[node];
+    if (n.accepting) *out |= n.accept;
+    if (len == 0) return;
+
+    /* Matching edges other than the last one branch off, the last one goes
+     * on in this loop */
+    uint32_t next = 0;
+    for (const MaskedEdge& edge : n.masked) {
+      if ((data[0] & edge.mask) != edge.value) continue;
+      if (next != 0) MatchFrom(next, data + 1, len - 1, out);
+      next = edge.child;
+    }
+
+    auto it = std::lower_bound(
+        n.exact.begin(), n.exact.end(), data[0],
+        [](const ExactEdge& edge, uint8_t v) { return edge.value < v; });
+    if (it != n.exact.end() && it->value == data[0]) {
+      if (next != 0) MatchFrom(next, data + 1, len - 1, out);
+      next = it->child;
+    }
+
+    if (next == 0) return;
+    node = next;
+    data++;
+    len--;
+  }
+}
+
+size_t ScanFilterEngine::UuidHash::operator()(
+    const Uuid::UUID128Bit& uuid) const {
+  uint64_t lo, hi;
+  memcpy(&lo, uuid.data(), sizeof(lo));
+  memcpy(&hi, uuid.data() + sizeof(lo), sizeof(hi));
+  /* UUIDs sharing the base differ in their low bits */
+  return (hi ^ (lo * 0x9E3779B97F4A7C15ull)) * 0x9E3779B97F4A7C15ull >> 32;
+}
+
+void ScanFilterEngine::Add(uint8_t filt_index, const ApcfCommand& cmd) {
+  conditions_.push_back({filt_index, cmd});
+  compiled_ = false;
+}
+
+void ScanFilterEngine::Clear(uint8_t filt_index) {
+  conditions_.erase(std::remove_if(conditions_.begin(), conditions_.end(),
+                                   [filt_index](const Condition& condition) {
+                                     return condition.filt_index == filt_index;
+                                   }),
+                    conditions_.end());
+  compiled_ = false;
+}
+
+void ScanFilterEngine::SetParams(uint8_t filt_index, uint16_t feat_seln,
+                                 uint8_t filt_logic_type,
+                                 int8_t rssi_high_thres) {
+  params_[filt_index] = {true, feat_seln, filt_logic_type, rssi_high_thres};
+  compiled_ = false;
+}
+
+void ScanFilterEngine::DeleteParams(uint8_t filt_index) {
+  params_[filt_index] = {};
+  compiled_ = false;
+}
+
+void ScanFilterEngine::ClearParams() {
+  params_.fill({});
+  compiled_ = false;
+}
+
+void ScanFilterEngine::Compile() {
+  addresses_.clear();
+  for (int i = kSrvcUuids; i <= kSolUuids; i++) {
+    short_uuids_[i].clear();
+    uuids_[i].clear();
+    masked_uuids_[i].clear();
+  }
+  any_service_data_.reset();
+  names_.Clear();
+  manufacturer_data_.Clear();
+  service_data_.Clear();
+  condition_features_.fill(0);
+
+  for (const Condition& condition : conditions_) {
+    const ApcfCommand& cmd = condition.cmd;
+    uint8_t filt_index = condition.filt_index;
+
+    /* Same checks and limits as the controller commands */
+    if (cmd.data.size() != cmd.data_mask.size() && cmd.data.size() != 0 &&
+        cmd.data_mask.size() != 0)
+      continue;
+
+    switch (cmd.type) {
+      case BTM_BLE_PF_ADDR_FILTER:
+        addresses_[cmd.address].push_back({cmd.addr_type, filt_index});
+        break;
+
+      case BTM_BLE_PF_SRVC_DATA:
+        any_service_data_.set(filt_index);
+        break;
+
+      case BTM_BLE_PF_SRVC_UUID:
+      case BTM_BLE_PF_SRVC_SOL_UUID: {
+        int list = cmd.type == BTM_BLE_PF_SRVC_UUID ? kSrvcUuids : kSolUuids;
+        Uuid::UUID128Bit uuid = cmd.uuid.To128BitLE();
+        size_t uuid_len = cmd.uuid.GetShortestRepresentationSize();
+        if (cmd.uuid_mask.IsEmpty()) {
+          if (uuid_len == Uuid::kNumBytes128)
+            uuids_[list][uuid].set(filt_index);
+          else
+            short_uuids_[list][cmd.uuid.As32Bit()].set(filt_index);
+          break;
+        }
+
+        /* The mask has the size of the shortest form of the UUID */
+        Uuid::UUID128Bit mask;
+        if (uuid_len == Uuid::kNumBytes128) {
+          mask = cmd.uuid_mask.To128BitLE();
+        } else {
+          mask.fill(0xFF);
+          Uuid::UUID128Bit short_mask = cmd.uuid_mask.To128BitLE();
+          memcpy(mask.data() + kShortUuidOffset,
+                 short_mask.data() + kShortUuidOffset, uuid_len);
+        }
+        for (size_t i = 0; i < uuid.size(); i++) uuid[i] &= mask[i];
+        masked_uuids_[list].push_back({uuid, mask, filt_index});
+        break;
+      }
+
+      case BTM_BLE_PF_LOCAL_NAME: {
+        size_t size = std::min(cmd.name.size(), (size_t)BTM_BLE_PF_STR_LEN_MAX);
+        names_.Add(std::vector<uint8_t>(cmd.name.begin(),
+                                        cmd.name.begin() + size),
+                   {}, filt_index);
+        break;
+      }
+
+      case BTM_BLE_PF_MANU_DATA: {
+        /* Company identifier first, as in the advertising data */
+        uint16_t company_mask = cmd.company_mask ? cmd.company_mask : 0xFFFF;
+        std::vector<uint8_t> pattern = {(uint8_t)cmd.company,
+                                        (uint8_t)(cmd.company >> 8)};
+        std::vector<uint8_t> mask = {(uint8_t)company_mask,
+                                     (uint8_t)(company_mask >> 8)};
+        size_t size =
+            std::min(cmd.data.size(), (size_t)(BTM_BLE_PF_STR_LEN_MAX - 2));
+        if (size > 0 && cmd.data_mask.size() != 0) {
+          pattern.insert(pattern.end(), cmd.data.begin(),
+                         cmd.data.begin() + size);
+          mask.insert(mask.end(), cmd.data_mask.begin(),
+                      cmd.data_mask.begin() + size);
+        }
+        manufacturer_data_.Add(pattern, mask, filt_index);
+        break;
+      }
+
+      case BTM_BLE_PF_SRVC_DATA_PATTERN: {
+        size_t size =
+            std::min(cmd.data.size(), (size_t)(BTM_BLE_PF_STR_LEN_MAX - 2));
+        std::vector<uint8_t> pattern(cmd.data.begin(),
+                                     cmd.data.begin() + size);
+        std::vector<uint8_t> mask(
+            cmd.data_mask.begin(),
+            cmd.data_mask.begin() + std::min(size, cmd.data_mask.size()));
+        service_data_.Add(pattern, mask, filt_index);
+        break;
+      }
+
+      default:
+        continue;
+    }
+    condition_features_[filt_index] |= 1 << cmd.type;
+  }
+
+  active_filters_.clear();
+  pass_all_filters_.clear();
+  for (size_t i = 0; i < kNumFilters; i++) {
+    if (params_[i].set && (params_[i].feat_seln & kAllFeatures) == 0)
+      pass_all_filters_.push_back(i);
+    else if (params_[i].set || condition_features_[i] != 0)
+      active_filters_.push_back(i);
+  }
+  compiled_ = true;
+}
+
+void ScanFilterEngine::MatchUuid(int list, const uint8_t* p, size_t len,
+                                 FilterSet* matched) const {
+  Uuid::UUID128Bit uuid = kBaseUuid;
+  if (len == Uuid::kNumBytes128) {
+    memcpy(uuid.data(), p, len);
+    /* A UUID sent in full can still be one of the short ones */
+    if (memcmp(uuid.data(), kBaseUuid.data(), kShortUuidOffset) == 0) {
+      p += kShortUuidOffset;
+      len = Uuid::kNumBytes32;
+    }
+  } else if (!masked_uuids_[list].empty()) {
+    memcpy(uuid.data() + kShortUuidOffset, p, len);
+  }
+
+  if (len == Uuid::kNumBytes128) {
+    auto it = uuids_[list].find(uuid);
+    if (it != uuids_[list].end()) *matched |= it->second;
+  } else if (!short_uuids_[list].empty()) {
+    auto it = short_uuids_[list].find(short_uuid_from_le(p, len));
+    if (it != short_uuids_[list].end()) *matched |= it->second;
+  }
+
+  for (const MaskedUuid& masked : masked_uuids_[list]) {
+    size_t i = 0;
+    while (i < uuid.size() && (uuid[i] & masked.mask[i]) == masked.uuid[i])
+      i++;
+    if (i == uuid.size()) matched->set(masked.filt_index);
+  }
+}
+
+bool ScanFilterEngine::Match(uint8_t addr_type, const RawAddress& addr,
+                             int8_t rssi, const uint8_t* data, size_t len) {
+  if (!enabled_) return true;
+  if (!compiled_) Compile();
+
+  /* A filter selecting no feature lets everything through */
+  for (uint8_t filt_index : pass_all_filters_) {
+    if (rssi >= params_[filt_index].rssi_high_thres) return true;
+  }
+  if (active_filters_.empty()) return false;
+
+  FilterSet matched[kNumFeatures];
+
+  if (!addresses_.empty()) {
+    auto it = addresses_.find(addr);
+    if (it != addresses_.end()) {
+      for (const AddressFilter& filter : it->second) {
+        /* Types past random stand for any address type */
+        if (filter.addr_type > BLE_ADDR_RANDOM ||
+            filter.addr_type == (addr_type & BLE_ADDR_TYPE_MASK))
+          matched[BTM_BLE_PF_ADDR_FILTER].set(filter.filt_index);
+      }
+    }
+  }
+
+  bool want_uuids[2] = {
+      !short_uuids_[kSrvcUuids].empty() || !uuids_[kSrvcUuids].empty() ||
+          !masked_uuids_[kSrvcUuids].empty(),
+      !short_uuids_[kSolUuids].empty() || !uuids_[kSolUuids].empty() ||
+          !masked_uuids_[kSolUuids].empty()};
+
+  /* One pass over the AD structures */
+  size_t pos = 0;
+  while (pos + 1 < len) {
+    size_t field_len = data[pos];
+    if (field_len == 0 || pos + 1 + field_len > len) break;
+    uint8_t type = data[pos + 1];
+    const uint8_t* field = data + pos + 2;
+    size_t size = field_len - 1;
+    pos += 1 + field_len;
+
+    int list = kSrvcUuids;
+    size_t uuid_len = 0;
+    switch (type) {
+      case BT_EIR_MORE_16BITS_UUID_TYPE:
+      case BT_EIR_COMPLETE_16BITS_UUID_TYPE:
+        uuid_len = Uuid::kNumBytes16;
+        break;
+      case BT_EIR_MORE_32BITS_UUID_TYPE:
+      case BT_EIR_COMPLETE_32BITS_UUID_TYPE:
+        uuid_len = Uuid::kNumBytes32;
+        break;
+      case BT_EIR_MORE_128BITS_UUID_TYPE:
+      case BT_EIR_COMPLETE_128BITS_UUID_TYPE:
+        uuid_len = Uuid::kNumBytes128;
+        break;
+      case kSolicitation16BitUuids:
+        list = kSolUuids;
+        uuid_len = Uuid::kNumBytes16;
+        break;
+      case kSolicitation32BitUuids:
+        list = kSolUuids;
+        uuid_len = Uuid::kNumBytes32;
+        break;
+      case kSolicitation128BitUuids:
+        list = kSolUuids;
+        uuid_len = Uuid::kNumBytes128;
+        break;
+
+      case BT_EIR_SHORTENED_LOCAL_NAME_TYPE:
+      case BT_EIR_COMPLETE_LOCAL_NAME_TYPE:
+        names_.Match(field, size, &matched[BTM_BLE_PF_LOCAL_NAME]);
+        break;
+
+      case BT_EIR_MANUFACTURER_SPECIFIC_TYPE:
+        manufacturer_data_.Match(field, size, &matched[BTM_BLE_PF_MANU_DATA]);
+        break;
+
+      case BT_EIR_SERVICE_DATA_16BITS_UUID_TYPE:
+      case BT_EIR_SERVICE_DATA_32BITS_UUID_TYPE:
+      case BT_EIR_SERVICE_DATA_128BITS_UUID_TYPE:
+        matched[BTM_BLE_PF_SRVC_DATA] |= any_service_data_;
+        service_data_.Match(field, size,
+                            &matched[BTM_BLE_PF_SRVC_DATA_PATTERN]);
+        break;
+    }
+
+    if (uuid_len == 0 || !want_uuids[list]) continue;
+    int feature =
+        list == kSrvcUuids ? BTM_BLE_PF_SRVC_UUID : BTM_BLE_PF_SRVC_SOL_UUID;
+    for (size_t i = 0; i + uuid_len <= size; i += uuid_len)
+      MatchUuid(list, field + i, uuid_len, &matched[feature]);
+  }
+
+  /* Most reports match no condition at all */
+  FilterSet candidates;
+  for (size_t feature = 0; feature < kNumFeatures; feature++)
+    candidates |= matched[feature];
+  if (candidates.none()) return false;
+
+  for (uint8_t filt_index : active_filters_) {
+    if (!candidates[filt_index]) continue;
+
+    const Params& params = params_[filt_index];
+    uint16_t selected = condition_features_[filt_index];
+    bool match_all = true;
+    if (params.set) {
+      if (rssi < params.rssi_high_thres) continue;
+      selected = params.feat_seln & kAllFeatures;
+      match_all = params.filt_logic_type == BTM_BLE_PF_LOGIC_AND;
+    }
+
+    uint16_t features = 0;
+    for (size_t feature = 0; feature < kNumFeatures; feature++) {
+      if (matched[feature][filt_index]) features |= 1 << feature;
+    }
+    features &= selected;
+    if (match_all ? features == selected : features != 0) return true;
+  }
+  return false;
+}
@@ -0,0 +1,158 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <hardware/bt_common_types.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <bitset>
+#include <unordered_map>
+#include <vector>
+
+#include "types/raw_address.h"
+
+/* Host side emulation of the Advertising Packet Content Filter, used when the
+ * controller does not support it. Filters are set up with the same commands as
+ * the controller ones, and compiled on first use into hash tables for the
+ * address and UUID conditions and a byte trie for the local name, manufacturer
+ * data and service data patterns, so a report is matched in one pass over its
+ * advertising data whatever the number of filters.
+ *
+ * Like the controller, a filter passes a report if the features it selects
+ * match, all of them or any of them depending on its logic type, and the RSSI
+ * is at least its threshold. Byte patterns match the start of the field under
+ * their mask. Several conditions of one feature are always combined with OR. */
+class ScanFilterEngine {
+ public:
+  /* Adds condition |cmd| to filter |filt_index| */
+  void Add(uint8_t filt_index, const ApcfCommand& cmd);
+
+  /* Removes the conditions of filter |filt_index| */
+  void Clear(uint8_t filt_index);
+
+  /* Sets which features filter |filt_index| requires, as in the APCF feature
+   * selection. A filter without parameters uses the features it has
+   * conditions for, all of them required. */
+  void SetParams(uint8_t filt_index, uint16_t feat_seln,
+                 uint8_t filt_logic_type, int8_t rssi_high_thres);
+  void DeleteParams(uint8_t filt_index);
+  void ClearParams();
+
+  void Enable(bool enable) { enabled_ = enable; }
+  bool enabled() const { return enabled_; }
+  size_t num_conditions() const { return conditions_.size(); }
+
+  /* Returns whether a report passes the filters. Everything passes while the
+   * engine is disabled. */
+  bool Match(uint8_t addr_type, const RawAddress& addr, int8_t rssi,
+             const uint8_t* data, size_t len);
+
+ private:
+  static constexpr size_t kNumFilters = 256;
+  static constexpr size_t kNumFeatures = 7;
+  static constexpr uint16_t kAllFeatures = (1 << kNumFeatures) - 1;
+  using FilterSet = std::bitset<kNumFilters>;
+
+  struct Condition {
+    uint8_t filt_index;
+    ApcfCommand cmd;
+  };
+
+  struct Params {
+    bool set;
+    uint16_t feat_seln;
+    uint8_t filt_logic_type;
+    int8_t rssi_high_thres;
+  };
+
+  /* Anchored multi-pattern matcher over masked byte patterns. Bytes with a
+   * full mask follow an edge found by binary search, the others are tried one
+   * by one. */
+  class PatternTrie {
+   public:
+    void Clear();
+    void Add(const std::vector<uint8_t>& pattern,
+             const std::vector<uint8_t>& mask, uint8_t filt_index);
+    /* Adds to |out| the filters with a pattern matching the start of |data| */
+    void Match(const uint8_t* data, size_t len, FilterSet* out) const;
+    bool empty() const { return nodes_.size() <= 1; }
+
+   private:
+    struct ExactEdge {
+      uint8_t value;
+      uint32_t child;
+    };
+    struct MaskedEdge {
+      uint8_t value;
+      uint8_t mask;
+      uint32_t child;
+    };
+    struct Node {
+      bool accepting = false;
+      FilterSet accept; /* filters whose pattern ends here */
+      std::vector<ExactEdge> exact; /* sorted by value */
+      std::vector<MaskedEdge> masked;
+    };
+
+    void MatchFrom(uint32_t node, const uint8_t* data, size_t len,
+                   FilterSet* out) const;
+
+    std::vector<Node> nodes_{1};
+  };
+
+  struct UuidHash {
+    size_t operator()(const bluetooth::Uuid::UUID128Bit& uuid) const;
+  };
+
+  struct MaskedUuid {
+    bluetooth::Uuid::UUID128Bit uuid;
+    bluetooth::Uuid::UUID128Bit mask;
+    uint8_t filt_index;
+  };
+
+  struct AddressFilter {
+    uint8_t addr_type;
+    uint8_t filt_index;
+  };
+
+  void Compile();
+  /* Matches the little endian UUID of |len| bytes at |p| */
+  void MatchUuid(int list, const uint8_t* p, size_t len,
+                 FilterSet* matched) const;
+
+  bool enabled_ = false;
+  std::vector<Condition> conditions_;
+  std::array<Params, kNumFilters> params_{};
+
+  /* Compiled form of |conditions_|, rebuilt when they change */
+  bool compiled_ = false;
+  std::vector<uint8_t> active_filters_;
+  std::vector<uint8_t> pass_all_filters_;
+  std::array<uint8_t, kNumFilters> condition_features_{};
+  std::unordered_map<RawAddress, std::vector<AddressFilter>> addresses_;
+  std::unordered_map<uint32_t, FilterSet> short_uuids_[2];
+  std::unordered_map<bluetooth::Uuid::UUID128Bit, FilterSet, UuidHash>
+      uuids_[2];
+  std::vector<MaskedUuid> masked_uuids_[2];
+  FilterSet any_service_data_;
+  PatternTrie names_;
+  PatternTrie manufacturer_data_;
+  PatternTrie service_data_;
+};
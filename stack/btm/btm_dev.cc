@@ -31,6 +31,7 @@
 #include "bt_types.h"
 #include "btm_api.h"
 #include "btm_int.h"
+#include "btm_sec_dev_index.h"
 #include "btu.h"
 #include "device/include/controller.h"
 #include "hcidefs.h"
@@ -75,6 +76,7 @@ bool BTM_SecAddDevice(const RawAddress& bd_addr, DEV_CLASS dev_class,
 
     p_dev_rec->bd_addr = bd_addr;
     p_dev_rec->hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_BR_EDR);
+    btm_sec_update_dev_index(p_dev_rec);
 
     /* use default value for background connection params */
     /* update conn params, use default value for background connection params */
@@ -154,6 +156,7 @@ bool BTM_SecAddDevice(const RawAddress& bd_addr, DEV_CLASS dev_class,
 void wipe_secrets_and_remove(tBTM_SEC_DEV_REC* p_dev_rec) {
   p_dev_rec->link_key.fill(0);
   memset(&p_dev_rec->ble.keys, 0, sizeof(tBTM_SEC_BLE_KEYS));
+  btm_cb.sec_dev_rec_index->Remove(p_dev_rec);
   list_remove(btm_cb.sec_dev_rec, p_dev_rec);
 }
 
@@ -266,6 +269,7 @@ tBTM_SEC_DEV_REC* btm_sec_alloc_dev(const RawAddress& bd_addr) {
 
   p_dev_rec->ble_hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_LE);
   p_dev_rec->hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_BR_EDR);
+  btm_sec_update_dev_index(p_dev_rec);
 
   return (p_dev_rec);
 }
@@ -337,12 +341,23 @@ bool is_handle_equal(void* data, void* context) {
  *
  ******************************************************************************/
 tBTM_SEC_DEV_REC* btm_find_dev_by_handle(uint16_t handle) {
+  if (SecDevRecIndex::IsIndexed(handle)) {
+    return btm_cb.sec_dev_rec_index->FindByHandle(handle);
+  }
+
   list_node_t* n = list_foreach(btm_cb.sec_dev_rec, is_handle_equal, &handle);
   if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
 
   return NULL;
 }
 
+static bool is_address_unresolvable(void* data, void* context) {
+  tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
+  const RawAddress* bd_addr = ((RawAddress*)context);
+
+  return !btm_ble_addr_resolvable(*bd_addr, p_dev_rec);
+}
+
 bool is_address_equal(void* data, void* context) {
   tBTM_SEC_DEV_REC* p_dev_rec = static_cast<tBTM_SEC_DEV_REC*>(data);
   const RawAddress* bd_addr = ((RawAddress*)context);
@@ -360,12 +375,26 @@ bool is_address_equal(void* data, void* context) {
  * Function         btm_find_dev
  *
  * Description      Look for the record in the device database for the record
- *                  with specified BD address
+ *                  with specified BD address. A record whose BD address or
+ *                  LE pseudo address matches is preferred over one whose IRK
+ *                  resolves the address.
  *
  * Returns          Pointer to the record or NULL
  *
  ******************************************************************************/
 tBTM_SEC_DEV_REC* btm_find_dev(const RawAddress& bd_addr) {
+  if (SecDevRecIndex::IsIndexed(bd_addr)) {
+    tBTM_SEC_DEV_REC* p_dev_rec =
+        btm_cb.sec_dev_rec_index->FindByAddress(bd_addr);
+    if (p_dev_rec != NULL || !BTM_BLE_IS_RESOLVE_BDA(bd_addr)) return p_dev_rec;
+
+    /* If a LE random address is looking for device record */
+    list_node_t* n = list_foreach(btm_cb.sec_dev_rec, is_address_unresolvable,
+                                  (void*)&bd_addr);
+    if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
+    return NULL;
+  }
+
   list_node_t* n =
       list_foreach(btm_cb.sec_dev_rec, is_address_equal, (void*)&bd_addr);
   if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
@@ -411,6 +440,7 @@ void btm_consolidate_dev(tBTM_SEC_DEV_REC* p_target_rec) {
           temp_rec.new_encryption_key_is_p256;
       p_target_rec->no_smp_on_br = temp_rec.no_smp_on_br;
       p_target_rec->bond_type = temp_rec.bond_type;
+      btm_sec_update_dev_index(p_target_rec);
 
       /* remove the combined record */
       wipe_secrets_and_remove(p_dev_rec);
@@ -520,6 +550,7 @@ tBTM_SEC_DEV_REC* btm_sec_allocate_dev_rec(void) {
   p_dev_rec =
       static_cast<tBTM_SEC_DEV_REC*>(osi_calloc(sizeof(tBTM_SEC_DEV_REC)));
   list_append(btm_cb.sec_dev_rec, p_dev_rec);
+  btm_cb.sec_dev_rec_index->Add(p_dev_rec);
 
   // Initialize defaults
   p_dev_rec->sec_flags = BTM_SEC_IN_USE;
@@ -530,6 +561,22 @@ tBTM_SEC_DEV_REC* btm_sec_allocate_dev_rec(void) {
   return p_dev_rec;
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_sec_update_dev_index
+ *
+ * Description      Re-index a device record after its BD address, LE pseudo
+ *                  or identity address, or one of its connection handles was
+ *                  written. Must be called after every such write for
+ *                  btm_find_dev() and friends to find the record.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_sec_update_dev_index(tBTM_SEC_DEV_REC* p_dev_rec) {
+  btm_cb.sec_dev_rec_index->Update(p_dev_rec);
+}
+
 /*******************************************************************************
  *
  * Function         btm_get_bond_type_dev
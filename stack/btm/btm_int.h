@@ -90,6 +90,7 @@ extern void btm_cont_rswitch(tACL_CONN* p, tBTM_SEC_DEV_REC* p_dev_rec,
                              uint8_t hci_status);
 
 extern uint8_t btm_handle_to_acl_index(uint16_t hci_handle);
+extern void btm_acl_flush_occurred(uint16_t hci_handle);
 extern void btm_read_link_policy_complete(uint8_t* p);
 
 extern void btm_read_rssi_timeout(void* data);
@@ -136,6 +137,23 @@ extern bool btm_acl_notif_conn_collision(const RawAddress& bda);
 extern void btm_acl_update_conn_addr(uint16_t conn_handle,
                                      const RawAddress& address);
 
+/* Link parameters learned per peer */
+extern void btm_peer_profile_link_up(const RawAddress& bda,
+                                     tBT_TRANSPORT transport);
+extern void btm_peer_profile_link_down(const RawAddress& bda,
+                                       tBT_TRANSPORT transport,
+                                       uint8_t reason);
+extern bool btm_peer_profile_apply_le(const RawAddress& bda);
+extern void btm_peer_profile_conn_params(const RawAddress& bda,
+                                         uint16_t interval, uint16_t latency,
+                                         uint16_t timeout);
+extern void btm_peer_profile_phy(uint16_t handle, uint8_t tx_phy,
+                                 uint8_t rx_phy);
+extern void btm_peer_profile_data_length(const RawAddress& bda,
+                                         uint16_t tx_data_len);
+extern void btm_peer_profile_mtu(const RawAddress& bda, uint16_t mtu);
+extern void btm_peer_profile_rssi(uint16_t handle, int8_t rssi);
+
 extern void btm_pm_reset(void);
 extern void btm_pm_sm_alloc(uint8_t ind);
 extern void btm_pm_proc_cmd_status(uint8_t status);
@@ -207,6 +225,7 @@ extern void wipe_secrets_and_remove(tBTM_SEC_DEV_REC* p_dev_rec);
 extern tBTM_SEC_DEV_REC* btm_find_dev(const RawAddress& bd_addr);
 extern tBTM_SEC_DEV_REC* btm_find_or_alloc_dev(const RawAddress& bd_addr);
 extern tBTM_SEC_DEV_REC* btm_find_dev_by_handle(uint16_t handle);
+extern void btm_sec_update_dev_index(tBTM_SEC_DEV_REC* p_dev_rec);
 extern tBTM_BOND_TYPE btm_get_bond_type_dev(const RawAddress& bd_addr);
 extern bool btm_set_bond_type_dev(const RawAddress& bd_addr,
                                   tBTM_BOND_TYPE bond_type);
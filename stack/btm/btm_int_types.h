@@ -108,6 +108,8 @@ typedef struct {
                                       connection */
   BD_FEATURES peer_le_features; /* Peer LE Used features mask for the device */
 
+  uint32_t flush_count; /* packets flushed by the controller on the link */
+
 } tACL_CONN;
 
 /* Define the Device Management control structure
@@ -724,6 +726,12 @@ typedef bool CONNECTION_TYPE;
 // Bluetooth Quality Report - Report receiver
 typedef void(tBTM_BT_QUALITY_REPORT_RECEIVER)(uint8_t len, uint8_t* p_stream);
 
+/* Lookup index of the security device records, see btm_sec_dev_index.h */
+class SecDevRecIndex;
+
+/* HCI connection handles are 12 bits, 0x0F00 and above are reserved */
+#define BTM_ACL_HANDLE_INDEX_SIZE 0x0F00
+
 /* Define a structure to hold all the BTM data
 */
 
@@ -736,6 +744,9 @@ typedef struct {
   **      ACL Management
   ****************************************************/
   tACL_CONN acl_db[MAX_L2CAP_LINKS];
+  /* acl_db index + 1 of the first link in use with each HCI handle, 0 if
+   * there is none */
+  uint8_t acl_handle_index[BTM_ACL_HANDLE_INDEX_SIZE];
   uint8_t btm_scn[BTM_MAX_SCN]; /* current SCNs: true if SCN is in use */
   uint16_t btm_def_link_policy;
   uint16_t btm_def_link_super_tout;
@@ -810,6 +821,7 @@ typedef struct {
   uint8_t disc_reason;              /* for legacy devices */
   tBTM_SEC_SERV_REC sec_serv_rec[BTM_SEC_MAX_SERVICE_RECORDS];
   list_t* sec_dev_rec; /* list of tBTM_SEC_DEV_REC */
+  SecDevRecIndex* sec_dev_rec_index; /* hash index of sec_dev_rec */
   tBTM_SEC_SERV_REC* p_out_serv;
   tBTM_MKEY_CALLBACK* mkey_cback;
 
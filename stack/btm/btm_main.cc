@@ -26,6 +26,7 @@
 #include "bt_target.h"
 #include "bt_types.h"
 #include "btm_int.h"
+#include "btm_sec_dev_index.h"
 #include "stack_config.h"
 
 /* Global BTM control block structure
@@ -69,6 +70,7 @@ void btm_init(void) {
   btm_sco_init(); /* SCO Database and Structures (If included) */
 
   btm_cb.sec_dev_rec = list_new(osi_free);
+  btm_cb.sec_dev_rec_index = new SecDevRecIndex();
 
   btm_dev_init(); /* Device Manager Structures & HCI_Reset */
 }
@@ -93,6 +95,8 @@ void btm_free(void) {
 
   list_free(btm_cb.sec_dev_rec);
   btm_cb.sec_dev_rec = NULL;
+  delete btm_cb.sec_dev_rec_index;
+  btm_cb.sec_dev_rec_index = NULL;
 
   alarm_free(btm_cb.sec_collision_timer);
   btm_cb.sec_collision_timer = NULL;
@@ -0,0 +1,357 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btm_peer_profile.h"
+
+#include <base/logging.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+bool SameProfile(const PeerProfile& a, const PeerProfile& b) {
+  return a.conn_interval == b.conn_interval &&
+         a.conn_latency == b.conn_latency &&
+         a.supervision_tout == b.supervision_tout && a.tx_phy == b.tx_phy &&
+         a.rx_phy == b.rx_phy && a.tx_data_len == b.tx_data_len &&
+         a.att_mtu == b.att_mtu && a.a2dp_level == b.a2dp_level &&
+         a.rssi == b.rssi;
+}
+
+}  // namespace
+
+PeerProfileCache::PeerProfileCache(Clock clock, Load load, Store store)
+    : clock_(clock),
+      load_(std::move(load)),
+      store_(std::move(store)),
+      links_up_(0),
+      links_learned_(0),
+      links_lost_(0),
+      profiles_stored_(0),
+      profiles_forgotten_(0),
+      converge_applied_links_(0),
+      converge_applied_us_(0),
+      converge_default_links_(0),
+      converge_default_us_(0) {
+  memset(param_stats_, 0, sizeof(param_stats_));
+}
+
+PeerProfileCache::Peer& PeerProfileCache::FindPeerLocked(
+    const RawAddress& bd_addr) {
+  auto it = peers_.find(bd_addr);
+  if (it == peers_.end()) {
+    Peer peer;
+    peer.learned = load_ && load_(bd_addr, &peer.profile);
+    if (!peer.learned) peer.profile = PeerProfile();
+    it = peers_.emplace(bd_addr, peer).first;
+  }
+  it->second.last_used_us = clock_();
+  return it->second;
+}
+
+PeerProfileCache::Link* PeerProfileCache::FindLinkLocked(
+    const RawAddress& bd_addr, bool is_le) {
+  auto it = links_.find(LinkKey(bd_addr, is_le));
+  return (it == links_.end()) ? nullptr : &it->second;
+}
+
+void PeerProfileCache::EvictLocked() {
+  while (peers_.size() > kMaxPeers) {
+    auto oldest = peers_.end();
+    for (auto it = peers_.begin(); it != peers_.end(); ++it) {
+      if (links_.count(LinkKey(it->first, false)) != 0 ||
+          links_.count(LinkKey(it->first, true)) != 0)
+        continue;
+      if (oldest == peers_.end() ||
+          it->second.last_used_us < oldest->second.last_used_us)
+        oldest = it;
+    }
+    if (oldest == peers_.end()) return;
+    peers_.erase(oldest);
+  }
+}
+
+bool PeerProfileCache::OnLinkUp(const RawAddress& bd_addr, bool is_le,
+                                const PeerProfile& initial,
+                                PeerProfile* p_learned) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t now_us = clock_();
+  const Peer& peer = FindPeerLocked(bd_addr);
+
+  Link link;
+  link.connected_us = now_us;
+  link.changed_us = 0;
+  link.learned = peer.profile;
+  link.applied = 0;
+  link.observed = initial;
+  link.longest = initial;
+  link.longest_us = 0;
+  link.conn_params_us = now_us;
+  links_[LinkKey(bd_addr, is_le)] = link;
+
+  links_up_++;
+  if (peer.learned) links_learned_++;
+  if (p_learned != nullptr) *p_learned = peer.profile;
+  bool learned = peer.learned;
+  EvictLocked();
+  return learned;
+}
+
+void PeerProfileCache::CloseConnParamsLocked(Link& link, uint64_t now_us) {
+  uint64_t held_us = now_us - link.conn_params_us;
+  if (held_us <= link.longest_us) return;
+  link.longest.conn_interval = link.observed.conn_interval;
+  link.longest.conn_latency = link.observed.conn_latency;
+  link.longest.supervision_tout = link.observed.supervision_tout;
+  link.longest_us = held_us;
+}
+
+void PeerProfileCache::CountHeldLocked(const Link& link) {
+  const PeerProfile& learned = link.learned;
+  const PeerProfile& longest = link.longest;
+  const PeerProfile& observed = link.observed;
+  bool held[kNumParams];
+  held[kConnParams] = longest.conn_interval == learned.conn_interval &&
+                      longest.conn_latency == learned.conn_latency;
+  held[kPhy] = observed.tx_phy == learned.tx_phy &&
+               observed.rx_phy == learned.rx_phy;
+  held[kDataLength] = observed.tx_data_len == learned.tx_data_len;
+  held[kA2dpLevel] = observed.a2dp_level == learned.a2dp_level;
+  for (int param = 0; param < kNumParams; param++) {
+    if ((link.applied & (1 << param)) && held[param])
+      param_stats_[param].held++;
+  }
+}
+
+void PeerProfileCache::OnLinkDown(const RawAddress& bd_addr, bool is_le,
+                                  bool lost) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = links_.find(LinkKey(bd_addr, is_le));
+  if (it == links_.end()) return;
+  Link link = it->second;
+  links_.erase(it);
+
+  uint64_t now_us = clock_();
+  if (is_le) {
+    CloseConnParamsLocked(link, now_us);
+    uint64_t converge_us =
+        (link.changed_us != 0) ? link.changed_us - link.connected_us : 0;
+    if (link.applied != 0) {
+      converge_applied_links_++;
+      converge_applied_us_ += converge_us;
+    } else {
+      converge_default_links_++;
+      converge_default_us_ += converge_us;
+    }
+  }
+
+  Peer& peer = FindPeerLocked(bd_addr);
+  if (lost) {
+    links_lost_++;
+    /* The LE parameters applied may be what the link could not sustain */
+    uint8_t suspects = link.applied & ~(1 << kA2dpLevel);
+    if (suspects == 0 || !peer.learned) return;
+    LOG(INFO) << __func__ << ": forgetting the parameters applied to "
+              << bd_addr << " (0x" << std::hex << +suspects << std::dec
+              << "): link lost";
+    PeerProfile& profile = peer.profile;
+    if (suspects & (1 << kConnParams)) {
+      profile.conn_interval = 0;
+      profile.conn_latency = 0;
+      profile.supervision_tout = 0;
+    }
+    if (suspects & (1 << kPhy)) {
+      profile.tx_phy = 0;
+      profile.rx_phy = 0;
+    }
+    if (suspects & (1 << kDataLength)) profile.tx_data_len = 0;
+    profiles_forgotten_++;
+    if (SameProfile(profile, PeerProfile())) {
+      peer.learned = false;
+      if (store_) store_(bd_addr, nullptr);
+    } else if (store_) {
+      store_(bd_addr, &profile);
+    }
+    return;
+  }
+
+  CountHeldLocked(link);
+
+  /* Parameters the link did not report keep their learned value */
+  PeerProfile profile = peer.profile;
+  const PeerProfile& observed = link.observed;
+  if (is_le) {
+    if (link.longest.conn_interval != 0) {
+      profile.conn_interval = link.longest.conn_interval;
+      profile.conn_latency = link.longest.conn_latency;
+      profile.supervision_tout = link.longest.supervision_tout;
+    }
+    if (observed.tx_phy != 0) {
+      profile.tx_phy = observed.tx_phy;
+      profile.rx_phy = observed.rx_phy;
+    }
+    if (observed.tx_data_len != 0) profile.tx_data_len = observed.tx_data_len;
+    if (observed.att_mtu != 0) profile.att_mtu = observed.att_mtu;
+  } else if (observed.a2dp_level >= 0) {
+    profile.a2dp_level = observed.a2dp_level;
+  }
+  if (observed.rssi != PEER_PROFILE_NO_RSSI) profile.rssi = observed.rssi;
+
+  /* Also when nothing was learned: the profile is still empty */
+  if (SameProfile(profile, peer.profile)) return;
+  peer.learned = true;
+  peer.profile = profile;
+  profiles_stored_++;
+  if (store_) store_(bd_addr, &peer.profile);
+}
+
+bool PeerProfileCache::Get(const RawAddress& bd_addr, PeerProfile* p_profile) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Peer& peer = FindPeerLocked(bd_addr);
+  bool learned = peer.learned;
+  if (learned) *p_profile = peer.profile;
+  EvictLocked();
+  return learned;
+}
+
+void PeerProfileCache::OnApplied(const RawAddress& bd_addr, bool is_le,
+                                 Param param) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Link* p_link = FindLinkLocked(bd_addr, is_le);
+  if (p_link == nullptr || (p_link->applied & (1 << param))) return;
+  p_link->applied |= 1 << param;
+  param_stats_[param].applied++;
+}
+
+void PeerProfileCache::OnConnParams(const RawAddress& bd_addr,
+                                    uint16_t interval, uint16_t latency,
+                                    uint16_t timeout) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Link* p_link = FindLinkLocked(bd_addr, true);
+  if (p_link == nullptr) return;
+  PeerProfile& observed = p_link->observed;
+  if (observed.conn_interval == interval && observed.conn_latency == latency &&
+      observed.supervision_tout == timeout)
+    return;
+
+  uint64_t now_us = clock_();
+  CloseConnParamsLocked(*p_link, now_us);
+  observed.conn_interval = interval;
+  observed.conn_latency = latency;
+  observed.supervision_tout = timeout;
+  p_link->conn_params_us = now_us;
+  p_link->changed_us = now_us;
+}
+
+void PeerProfileCache::OnPhy(const RawAddress& bd_addr, uint8_t tx_phy,
+                             uint8_t rx_phy) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Link* p_link = FindLinkLocked(bd_addr, true);
+  if (p_link == nullptr) return;
+  PeerProfile& observed = p_link->observed;
+  if (observed.tx_phy == tx_phy && observed.rx_phy == rx_phy) return;
+  observed.tx_phy = tx_phy;
+  observed.rx_phy = rx_phy;
+  p_link->changed_us = clock_();
+}
+
+void PeerProfileCache::OnDataLength(const RawAddress& bd_addr,
+                                    uint16_t tx_data_len) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Link* p_link = FindLinkLocked(bd_addr, true);
+  if (p_link == nullptr || p_link->observed.tx_data_len == tx_data_len) return;
+  p_link->observed.tx_data_len = tx_data_len;
+  p_link->changed_us = clock_();
+}
+
+void PeerProfileCache::OnMtu(const RawAddress& bd_addr, uint16_t mtu) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Link* p_link = FindLinkLocked(bd_addr, true);
+  if (p_link == nullptr || p_link->observed.att_mtu == mtu) return;
+  p_link->observed.att_mtu = mtu;
+  p_link->changed_us = clock_();
+}
+
+void PeerProfileCache::OnA2dpLevel(const RawAddress& bd_addr, int level) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Link* p_link = FindLinkLocked(bd_addr, false);
+  if (p_link == nullptr) return;
+  p_link->observed.a2dp_level = (int8_t)level;
+}
+
+void PeerProfileCache::OnRssi(const RawAddress& bd_addr, bool is_le,
+                              int8_t rssi) {
+  if (rssi == PEER_PROFILE_NO_RSSI) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  Link* p_link = FindLinkLocked(bd_addr, is_le);
+  if (p_link == nullptr) return;
+  int8_t& average = p_link->observed.rssi;
+  if (average == PEER_PROFILE_NO_RSSI) {
+    average = rssi;
+  } else {
+    average = (int8_t)((3 * average + rssi) / 4);
+  }
+}
+
+void PeerProfileCache::Dump(int fd) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  static const char* param_names[kNumParams] = {
+      "conn params", "PHY", "data length", "A2DP level"};
+
+  dprintf(fd,
+          "  Links (started/with learned profile/lost)               : %llu / "
+          "%llu / %llu\n",
+          (unsigned long long)links_up_, (unsigned long long)links_learned_,
+          (unsigned long long)links_lost_);
+  dprintf(fd,
+          "  Profiles (stored/forgotten on a lost link)              : %llu / "
+          "%llu\n",
+          (unsigned long long)profiles_stored_,
+          (unsigned long long)profiles_forgotten_);
+  for (int param = 0; param < kNumParams; param++) {
+    dprintf(fd,
+            "  Learned %-11s (applied/held)                      : %llu / "
+            "%llu\n",
+            param_names[param],
+            (unsigned long long)param_stats_[param].applied,
+            (unsigned long long)param_stats_[param].held);
+  }
+  dprintf(fd,
+          "  LE link settled after in ms (learned/default)           : %llu / "
+          "%llu\n",
+          (unsigned long long)(converge_applied_links_
+                                   ? converge_applied_us_ /
+                                         converge_applied_links_ / 1000
+                                   : 0),
+          (unsigned long long)(converge_default_links_
+                                   ? converge_default_us_ /
+                                         converge_default_links_ / 1000
+                                   : 0));
+
+  for (const auto& entry : peers_) {
+    if (!entry.second.learned) continue;
+    const PeerProfile& profile = entry.second.profile;
+    dprintf(fd,
+            "  %s: interval %u, latency %u, timeout %u, PHY %u/%u, data "
+            "length %u, MTU %u, A2DP level %d, RSSI %d\n",
+            entry.first.ToString().c_str(), profile.conn_interval,
+            profile.conn_latency, profile.supervision_tout, profile.tx_phy,
+            profile.rx_phy, profile.tx_data_len, profile.att_mtu,
+            profile.a2dp_level, profile.rssi);
+  }
+}
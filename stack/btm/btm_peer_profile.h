@@ -0,0 +1,172 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "types/raw_address.h"
+
+/* RSSI not available, as reported by the controller */
+#define PEER_PROFILE_NO_RSSI 127
+
+/* Link parameters a peer settled on. Parameters not learned are zero, or -1
+ * for the A2DP level and PEER_PROFILE_NO_RSSI for the RSSI. */
+struct PeerProfile {
+  /* LE connection parameters: interval in 1.25 ms, latency in connection
+   * events, supervision timeout in 10 ms */
+  uint16_t conn_interval = 0;
+  uint16_t conn_latency = 0;
+  uint16_t supervision_tout = 0;
+  /* LE PHY of each direction: 1 for LE 1M, 2 for LE 2M, 3 for LE Coded */
+  uint8_t tx_phy = 0;
+  uint8_t rx_phy = 0;
+  /* LE data length of the controller, in octets */
+  uint16_t tx_data_len = 0;
+  /* ATT MTU of the LE link */
+  uint16_t att_mtu = 0;
+  /* A2DP encoder adaptive bitrate level */
+  int8_t a2dp_level = -1;
+  /* Average RSSI in dBm, of the RSSI reads and the quality reports */
+  int8_t rssi = PEER_PROFILE_NO_RSSI;
+};
+
+/* Link parameters learned per peer.
+ *
+ * Every link starts from default parameters, then converges on the ones the
+ * peer and the applications settle on, through connection parameter updates,
+ * PHY updates, data length changes and the A2DP adaptive bitrate. The cache
+ * records, when a link ends cleanly, the parameters it settled on: the
+ * connection parameters it spent the most time with, and the last PHY and
+ * data length. The next link to the peer can start from them.
+ *
+ * A link lost to a timeout records nothing, and makes the cache forget the
+ * LE parameters that were applied to it: the peer is not given them again.
+ *
+ * The stack reports the links and their parameters from its thread; the A2DP
+ * Source reports the adaptive bitrate from its own.
+ */
+class PeerProfileCache {
+ public:
+  /* Learned parameters applied to a link, for the statistics */
+  enum Param { kConnParams, kPhy, kDataLength, kA2dpLevel, kNumParams };
+
+  /* Monotonic clock, in microseconds */
+  using Clock = uint64_t (*)();
+  /* Reads the profile of |bd_addr| from storage. Returns true if found. */
+  using Load = std::function<bool(const RawAddress& bd_addr,
+                                  PeerProfile* p_profile)>;
+  /* Writes the profile of |bd_addr| to storage, or erases it for nullptr */
+  using Store = std::function<void(const RawAddress& bd_addr,
+                                   const PeerProfile* p_profile)>;
+
+  PeerProfileCache(Clock clock, Load load, Store store);
+
+  PeerProfileCache(const PeerProfileCache&) = delete;
+  PeerProfileCache& operator=(const PeerProfileCache&) = delete;
+
+  /* Starts a link to |bd_addr|, with the parameters it was created with in
+   * |initial|. Returns true, and the profile learned from the previous links
+   * in |p_learned|, if there is one. */
+  bool OnLinkUp(const RawAddress& bd_addr, bool is_le,
+                const PeerProfile& initial, PeerProfile* p_learned);
+  /* Ends a link to |bd_addr|, |lost| if it timed out */
+  void OnLinkDown(const RawAddress& bd_addr, bool is_le, bool lost);
+
+  /* Returns true, and the learned profile in |p_profile|, if there is one */
+  bool Get(const RawAddress& bd_addr, PeerProfile* p_profile);
+  /* Counts learned |param| applied to the link, once per link */
+  void OnApplied(const RawAddress& bd_addr, bool is_le, Param param);
+
+  /* Parameters of the LE link */
+  void OnConnParams(const RawAddress& bd_addr, uint16_t interval,
+                    uint16_t latency, uint16_t timeout);
+  void OnPhy(const RawAddress& bd_addr, uint8_t tx_phy, uint8_t rx_phy);
+  void OnDataLength(const RawAddress& bd_addr, uint16_t tx_data_len);
+  void OnMtu(const RawAddress& bd_addr, uint16_t mtu);
+  /* Adaptive bitrate level an A2DP stream on the BR/EDR link settled on */
+  void OnA2dpLevel(const RawAddress& bd_addr, int level);
+  void OnRssi(const RawAddress& bd_addr, bool is_le, int8_t rssi);
+
+  void Dump(int fd);
+
+ private:
+  /* Peers kept in memory; the least recently used without a link go first */
+  static constexpr size_t kMaxPeers = 64;
+
+  struct Peer {
+    bool learned;
+    PeerProfile profile;
+    uint64_t last_used_us;
+  };
+
+  struct Link {
+    uint64_t connected_us;
+    /* Last change of the LE parameters, 0 if none */
+    uint64_t changed_us;
+    PeerProfile learned;
+    uint8_t applied;  /* bits of Param */
+    PeerProfile observed;
+    /* Connection parameters held the longest, and since when the current
+     * ones are */
+    PeerProfile longest;
+    uint64_t longest_us;
+    uint64_t conn_params_us;
+  };
+
+  using LinkKey = std::pair<RawAddress, bool>;
+
+  struct ParamStats {
+    uint64_t applied;
+    uint64_t held;  /* still in use when the link ended */
+  };
+
+  Peer& FindPeerLocked(const RawAddress& bd_addr);
+  Link* FindLinkLocked(const RawAddress& bd_addr, bool is_le);
+  void EvictLocked();
+  /* Keeps the connection parameters of |link| if they were held longer */
+  void CloseConnParamsLocked(Link& link, uint64_t now_us);
+  void CountHeldLocked(const Link& link);
+
+  const Clock clock_;
+  const Load load_;
+  const Store store_;
+
+  std::mutex mutex_;
+  std::map<RawAddress, Peer> peers_;
+  std::map<LinkKey, Link> links_;
+
+  /* Statistics */
+  uint64_t links_up_;
+  uint64_t links_learned_;  /* started with a learned profile */
+  uint64_t links_lost_;
+  uint64_t profiles_stored_;
+  uint64_t profiles_forgotten_;
+  ParamStats param_stats_[kNumParams];
+  /* Time from the LE link up to its last parameter change, per LE link
+   * started with and without learned parameters applied */
+  uint64_t converge_applied_links_;
+  uint64_t converge_applied_us_;
+  uint64_t converge_default_links_;
+  uint64_t converge_default_us_;
+};
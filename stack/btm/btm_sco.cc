@@ -26,6 +26,7 @@
 #include <device/include/esco_parameters.h>
 #include <stack/include/btm_api_types.h>
 #include <string.h>
+#include <algorithm>
 #include "bt_common.h"
 #include "bt_target.h"
 #include "bt_types.h"
@@ -33,12 +34,16 @@
 #include "btm_api.h"
 #include "btm_int.h"
 #include "btm_int_types.h"
+#include "btm_sco_hci.h"
 #include "btu.h"
+#include "common/time_util.h"
 #include "device/include/controller.h"
 #include "device/include/esco_parameters.h"
 #include "hcidefs.h"
 #include "hcimsgs.h"
+#include "osi/include/alarm.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 
 /******************************************************************************/
 /*               L O C A L    D A T A    D E F I N I T I O N S                */
@@ -54,11 +59,29 @@
 #define SCO_ST_PEND_ROLECHANGE 7
 #define SCO_ST_PEND_MODECHANGE 8
 
+/* Property routing the (e)SCO audio over HCI, coded by the host, instead of
+ * the PCM interface of the controller. Needs the enhanced synchronous
+ * connection commands. */
+#define BTM_SCO_HCI_ROUTE_PROP "persist.bluetooth.sco.hci_route"
+
+/* Timer sending the packets of the (e)SCO link routed over HCI, when the
+ * controller gives none */
+static alarm_t* sco_hci_tick_alarm = NULL;
+
 /******************************************************************************/
 /*            L O C A L    F U N C T I O N     P R O T O T Y P E S            */
 /******************************************************************************/
 
 static uint16_t btm_sco_voice_settings_to_legacy(enh_esco_params_t* p_parms);
+static void btm_sco_hci_transmit(uint16_t hci_handle, const uint8_t* data,
+                                 uint8_t len);
+
+/* Audio of the (e)SCO link routed over HCI */
+static ScoHciPath& btm_sco_hci_path() {
+  static ScoHciPath path(bluetooth::common::time_get_os_boottime_us,
+                         btm_sco_hci_transmit);
+  return path;
+}
 
 /*******************************************************************************
  *
@@ -70,7 +93,108 @@ static uint16_t btm_sco_voice_settings_to_legacy(enh_esco_params_t* p_parms);
  * Returns          void
  *
  ******************************************************************************/
-void btm_sco_flush_sco_data(UNUSED_ATTR uint16_t sco_inx) {}
+void btm_sco_flush_sco_data(uint16_t sco_inx) {
+#if (BTM_MAX_SCO_LINKS > 0)
+  if (sco_inx >= BTM_MAX_SCO_LINKS || !btm_sco_hci_path().IsActive() ||
+      btm_sco_hci_path().handle() != btm_cb.sco_cb.sco_db[sco_inx].hci_handle) {
+    return;
+  }
+
+  BTM_TRACE_DEBUG("%s: stop SCO audio over HCI for handle 0x%04x", __func__,
+                  btm_cb.sco_cb.sco_db[sco_inx].hci_handle);
+  alarm_free(sco_hci_tick_alarm);
+  sco_hci_tick_alarm = NULL;
+  btm_sco_hci_path().Stop();
+#endif
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_sco_hci_tick
+ *
+ * Description      Timer callback sending the SCO packets due, when the
+ *                  controller did not give the packets clocking them.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void btm_sco_hci_tick(UNUSED_ATTR void* data) {
+  btm_sco_hci_path().SendDuePackets();
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_sco_hci_start
+ *
+ * Description      This function starts the audio of a SCO connection routed
+ *                  over HCI.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void btm_sco_hci_start(tSCO_CONN* p) {
+  if (btm_sco_hci_path().IsActive()) {
+    LOG(WARNING) << __func__ << ": SCO audio over HCI already runs for handle "
+                 << loghex(btm_sco_hci_path().handle());
+    return;
+  }
+
+  /* The air coding format is transparent when the host codes mSBC */
+  ScoHciPath::Codec codec =
+      (p->esco.setup.transmit_coding_format.coding_format ==
+       ESCO_CODING_FORMAT_TRANSPNT)
+          ? ScoHciPath::Codec::kMsbc
+          : ScoHciPath::Codec::kCvsd;
+  /* One packet per interval, of 5 bytes per slot at 64 kbit/s */
+  uint8_t tx_interval = p->esco.data.tx_interval ? p->esco.data.tx_interval : 6;
+  uint16_t packet_len = p->esco.data.rx_pkt_len ? p->esco.data.rx_pkt_len
+                                                : tx_interval * 5;
+  packet_len = std::min<uint16_t>(packet_len, BTM_SCO_DATA_SIZE_MAX);
+
+  LOG(INFO) << __func__ << ": handle " << loghex(p->hci_handle) << ", "
+            << ((codec == ScoHciPath::Codec::kMsbc) ? "mSBC" : "CVSD")
+            << ", packet length " << packet_len;
+  btm_sco_hci_path().Start(p->hci_handle, codec, packet_len);
+
+  uint64_t interval_ms = std::max<uint64_t>(packet_len * 125 / 1000, 1);
+  sco_hci_tick_alarm = alarm_new_periodic("btm.sco_hci_tick");
+  alarm_set_on_mloop(sco_hci_tick_alarm, interval_ms, btm_sco_hci_tick, NULL);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_sco_set_data_path
+ *
+ * Description      This function sets the data path of the enhanced (e)SCO
+ *                  setup |p_setup|. When the audio is routed over HCI, the
+ *                  host codes it and the controller carries it as is.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void btm_sco_set_data_path(enh_esco_params_t* p_setup) {
+  p_setup->input_data_path = p_setup->output_data_path =
+      btm_cb.sco_cb.sco_route;
+  if (btm_cb.sco_cb.sco_route != ESCO_DATA_PATH_HCI) return;
+
+  esco_coding_format_t coding_format =
+      (p_setup->transmit_coding_format.coding_format ==
+           ESCO_CODING_FORMAT_MSBC ||
+       p_setup->transmit_coding_format.coding_format ==
+           ESCO_CODING_FORMAT_TRANSPNT)
+          ? ESCO_CODING_FORMAT_TRANSPNT
+          : ESCO_CODING_FORMAT_CVSD;
+  p_setup->transmit_coding_format.coding_format = coding_format;
+  p_setup->receive_coding_format.coding_format = coding_format;
+  p_setup->input_coding_format.coding_format = coding_format;
+  p_setup->output_coding_format.coding_format = coding_format;
+  p_setup->input_bandwidth = p_setup->output_bandwidth = TXRX_64KBITS_RATE;
+  p_setup->input_coded_data_size = p_setup->output_coded_data_size = 8;
+  p_setup->input_pcm_data_format = p_setup->output_pcm_data_format =
+      ESCO_PCM_DATA_FORMAT_NA;
+  p_setup->input_pcm_payload_msb_position =
+      p_setup->output_pcm_payload_msb_position = 0;
+}
 
 /*******************************************************************************
  *
@@ -86,7 +210,9 @@ void btm_sco_init(void) {
   btm_cb.sco_cb.sco_disc_reason = BTM_INVALID_SCO_DISC_REASON;
   btm_cb.sco_cb.def_esco_parms = esco_parameters_for_codec(ESCO_CODEC_CVSD);
   btm_cb.sco_cb.def_esco_parms.max_latency_ms = 12;
-  btm_cb.sco_cb.sco_route = ESCO_DATA_PATH_PCM;
+  btm_cb.sco_cb.sco_route = osi_property_get_bool(BTM_SCO_HCI_ROUTE_PROP, false)
+                                ? ESCO_DATA_PATH_HCI
+                                : ESCO_DATA_PATH_PCM;
 }
 
 /*******************************************************************************
@@ -165,8 +291,7 @@ static void btm_esco_conn_rsp(uint16_t sco_inx, uint8_t hci_status,
     if (controller_get_interface()
             ->supports_enhanced_setup_synchronous_connection()) {
       /* Use the saved SCO routing */
-      p_setup->input_data_path = p_setup->output_data_path =
-          btm_cb.sco_cb.sco_route;
+      btm_sco_set_data_path(p_setup);
 
       BTM_TRACE_DEBUG(
           "%s: txbw 0x%x, rxbw 0x%x, lat 0x%x, retrans 0x%02x, "
@@ -199,6 +324,29 @@ static void btm_esco_conn_rsp(uint16_t sco_inx, uint8_t hci_status,
  *
  ******************************************************************************/
 void btm_route_sco_data(BT_HDR* p_msg) {
+  uint8_t* p = (uint8_t*)(p_msg + 1) + p_msg->offset;
+  uint16_t handle;
+  uint8_t len;
+
+  if (p_msg->len < HCI_SCO_PREAMBLE_SIZE) {
+    osi_free(p_msg);
+    return;
+  }
+  STREAM_TO_UINT16(handle, p);
+  STREAM_TO_UINT8(len, p);
+  if (len > p_msg->len - HCI_SCO_PREAMBLE_SIZE) {
+    BTM_TRACE_WARNING("%s: bad SCO data length %u for handle 0x%04x", __func__,
+                      len, handle);
+    osi_free(p_msg);
+    return;
+  }
+
+  /* Packet status flag, above the connection handle */
+  uint8_t packet_status = (handle >> 12) & 0x03;
+  handle = HCID_GET_HANDLE(handle);
+  if (btm_sco_hci_path().IsActive() && btm_sco_hci_path().handle() == handle) {
+    btm_sco_hci_path().OnRxPacket(packet_status, p, len);
+  }
   osi_free(p_msg);
 }
 
@@ -211,7 +359,7 @@ void btm_route_sco_data(BT_HDR* p_msg) {
  *                  HCI_SCO_PREAMBLE_SIZE bytes, and the data length can not
  *                  exceed BTM_SCO_DATA_SIZE_MAX bytes, whose default value is
  *                  set to 60 and is configurable. Data longer than the maximum
- *                  bytes will be truncated.
+ *                  bytes will be truncated. p_buf is freed by the stack.
  *
  * Returns          BTM_SUCCESS: data write is successful
  *                  BTM_ILLEGAL_VALUE: SCO data contains illegal offset value.
@@ -223,9 +371,127 @@ void btm_route_sco_data(BT_HDR* p_msg) {
  *
  *
  ******************************************************************************/
-tBTM_STATUS BTM_WriteScoData(UNUSED_ATTR uint16_t sco_inx,
-                             UNUSED_ATTR BT_HDR* p_buf) {
+tBTM_STATUS BTM_WriteScoData(uint16_t sco_inx, BT_HDR* p_buf) {
+#if (BTM_MAX_SCO_LINKS > 0)
+  uint8_t* p;
+  tBTM_STATUS status = BTM_SUCCESS;
+
+  if (sco_inx >= BTM_MAX_SCO_LINKS ||
+      btm_cb.sco_cb.sco_db[sco_inx].state != SCO_ST_CONNECTED ||
+      btm_cb.sco_cb.sco_route != ESCO_DATA_PATH_HCI) {
+    osi_free(p_buf);
+    return (BTM_UNKNOWN_ADDR);
+  }
+  tSCO_CONN* p_ccb = &btm_cb.sco_cb.sco_db[sco_inx];
+  if (p_buf->offset < HCI_SCO_PREAMBLE_SIZE) {
+    osi_free(p_buf);
+    return (BTM_ILLEGAL_VALUE);
+  }
+  if (p_buf->len > BTM_SCO_DATA_SIZE_MAX) {
+    p_buf->len = BTM_SCO_DATA_SIZE_MAX;
+    status = BTM_SCO_BAD_LENGTH;
+  }
+
+  p_buf->offset -= HCI_SCO_PREAMBLE_SIZE;
+  p = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  UINT16_TO_STREAM(p, p_ccb->hci_handle);
+  UINT8_TO_STREAM(p, p_buf->len);
+  p_buf->len += HCI_SCO_PREAMBLE_SIZE;
+
+  bte_main_hci_send(p_buf, BT_EVT_TO_LM_HCI_SCO);
+  return (status);
+#else
+  osi_free(p_buf);
   return (BTM_NO_RESOURCES);
+#endif
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_sco_hci_transmit
+ *
+ * Description      This function sends a packet of the SCO audio routed over
+ *                  HCI.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void btm_sco_hci_transmit(uint16_t hci_handle, const uint8_t* data,
+                                 uint8_t len) {
+  uint16_t sco_inx = btm_find_scb_by_handle(hci_handle);
+  if (sco_inx >= BTM_MAX_SCO_LINKS) return;
+
+  BT_HDR* p_buf =
+      (BT_HDR*)osi_malloc(BT_HDR_SIZE + HCI_SCO_PREAMBLE_SIZE + len);
+  p_buf->offset = HCI_SCO_PREAMBLE_SIZE;
+  p_buf->len = len;
+  p_buf->layer_specific = 0;
+  memcpy((uint8_t*)(p_buf + 1) + p_buf->offset, data, len);
+  BTM_WriteScoData(sco_inx, p_buf);
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_ReadScoPcm
+ *
+ * Description      This function reads the audio received on the SCO
+ *                  connection routed over HCI: |num_samples| samples of 16 bit
+ *                  mono PCM at BTM_GetScoPcmSampleRate(), padded with silence.
+ *                  It can be called from the audio thread.
+ *
+ * Returns          The number of samples received
+ *
+ ******************************************************************************/
+uint32_t BTM_ReadScoPcm(int16_t* pcm, uint32_t num_samples) {
+  return btm_sco_hci_path().ReadPcm(pcm, num_samples);
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_WriteScoPcm
+ *
+ * Description      This function queues |num_samples| samples of 16 bit mono
+ *                  PCM at BTM_GetScoPcmSampleRate() to send on the SCO
+ *                  connection routed over HCI. It can be called from the
+ *                  audio thread.
+ *
+ * Returns          The number of samples queued, 0 without SCO audio over HCI
+ *
+ ******************************************************************************/
+uint32_t BTM_WriteScoPcm(const int16_t* pcm, uint32_t num_samples) {
+  return btm_sco_hci_path().WritePcm(pcm, num_samples);
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_GetScoPcmSampleRate
+ *
+ * Description      This function returns the sample rate of the audio of the
+ *                  SCO connection routed over HCI: 8000 for CVSD, 16000 for
+ *                  mSBC.
+ *
+ * Returns          The sample rate in Hz
+ *
+ ******************************************************************************/
+uint32_t BTM_GetScoPcmSampleRate(void) {
+  return btm_sco_hci_path().SampleRate();
+}
+
+/*******************************************************************************
+ *
+ * Function         stack_debug_sco_dump
+ *
+ * Description      This function dumps the SCO audio routed over HCI.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void stack_debug_sco_dump(int fd) {
+  dprintf(fd, "\nSCO audio over HCI:\n");
+  dprintf(fd,
+          "  Routed over HCI                                         : %s\n",
+          (btm_cb.sco_cb.sco_route == ESCO_DATA_PATH_HCI) ? "true" : "false");
+  btm_sco_hci_path().Dump(fd);
 }
 
 #if (BTM_MAX_SCO_LINKS > 0)
@@ -311,8 +577,7 @@ static tBTM_STATUS btm_send_connect_request(uint16_t acl_handle,
     if (controller_get_interface()
             ->supports_enhanced_setup_synchronous_connection()) {
       /* Use the saved SCO routing */
-      p_setup->input_data_path = p_setup->output_data_path =
-          btm_cb.sco_cb.sco_route;
+      btm_sco_set_data_path(p_setup);
       LOG(INFO) << __func__ << std::hex << ": enhanced parameter list"
                 << " txbw=0x" << unsigned(p_setup->transmit_bandwidth)
                 << ", rxbw=0x" << unsigned(p_setup->receive_bandwidth)
@@ -839,6 +1104,12 @@ void btm_sco_connected(uint8_t hci_status, const RawAddress* bda,
         if (p_esco_data) p->esco.data = *p_esco_data;
       }
 
+      if (btm_cb.sco_cb.sco_route == ESCO_DATA_PATH_HCI &&
+          controller_get_interface()
+              ->supports_enhanced_setup_synchronous_connection()) {
+        btm_sco_hci_start(p);
+      }
+
       (*p->p_conn_cb)(xx);
 
       return;
@@ -1186,8 +1457,7 @@ tBTM_STATUS BTM_ChangeEScoLinkParms(uint16_t sco_inx,
     if (controller_get_interface()
             ->supports_enhanced_setup_synchronous_connection()) {
       /* Use the saved SCO routing */
-      p_setup->input_data_path = p_setup->output_data_path =
-          btm_cb.sco_cb.sco_route;
+      btm_sco_set_data_path(p_setup);
 
       btsnd_hcic_enhanced_set_up_synchronous_connection(p_sco->hci_handle,
                                                         p_setup);
@@ -0,0 +1,314 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btm_sco_codec.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "embdrv/sbc/decoder/include/oi_status.h"
+
+namespace {
+
+/* CVSD parameters of the Core specification, scaled to the fixed point of
+ * CvsdState */
+constexpr int32_t kCvsdStepMin = 10 << 10;
+constexpr int32_t kCvsdStepMax = 1280 << 10;
+constexpr int32_t kCvsdMax = 32767 << 10;
+constexpr int32_t kCvsdMin = -(32768 << 10);
+
+/* CVSD samples per PCM sample */
+constexpr int kCvsdOversampling = 8;
+
+/* Second byte of the H2 header, carrying the packet sequence number */
+constexpr uint8_t kH2Sequence[] = {0x08, 0x38, 0xc8, 0xf8};
+constexpr uint8_t kH2Sync = 0x01;
+constexpr size_t kH2HeaderBytes = 2;
+constexpr size_t kMsbcFrameBytes = 57;
+
+/* Raised cosine of the concealment overlap-add:
+ * (1 + cos(pi * (i + 1) / 17)) / 2 */
+constexpr float kRcos[] = {0.99148655f, 0.96623611f, 0.92510857f, 0.86950446f,
+                           0.80131732f, 0.72286918f, 0.63683150f, 0.54613418f,
+                           0.45386582f, 0.36316850f, 0.27713082f, 0.19868268f,
+                           0.13049554f, 0.07489143f, 0.03376389f, 0.00851345f};
+
+/* Beyond this many frames in a row, the concealment fades to silence instead
+ * of repeating the same pitch period */
+constexpr int kMaxConcealedFrames = 8;
+
+int16_t Crop(float value) {
+  if (value > 32767.0f) return 32767;
+  if (value < -32768.0f) return -32768;
+  return static_cast<int16_t>(lrintf(value));
+}
+
+/* SBC header CRC-8, x^8 + x^4 + x^3 + x^2 + 1 */
+uint8_t SbcCrc8(uint8_t crc, uint8_t byte) {
+  for (int bit = 7; bit >= 0; bit--) {
+    bool feedback = ((crc >> 7) ^ (byte >> bit)) & 0x01;
+    crc <<= 1;
+    if (feedback) crc ^= 0x1d;
+  }
+  return crc;
+}
+
+/* mSBC frame of null scale factors and samples, whose decoding gives the zero
+ * input response of the synthesis filters */
+class SilentMsbcFrame {
+ public:
+  SilentMsbcFrame() {
+    memset(frame_, 0, sizeof(frame_));
+    frame_[0] = OI_mSBC_SYNCWORD;
+    /* The CRC covers the two reserved header bytes and the 8 scale factors */
+    uint8_t crc = 0x0f;
+    for (size_t i = 1; i < 8; i++) {
+      if (i != 3) crc = SbcCrc8(crc, frame_[i]);
+    }
+    frame_[3] = crc;
+  }
+
+  const uint8_t* data() const { return frame_; }
+  size_t size() const { return sizeof(frame_); }
+
+ private:
+  uint8_t frame_[kMsbcFrameBytes];
+};
+
+const SilentMsbcFrame kSilentMsbcFrame;
+
+}  // namespace
+
+void CvsdState::Reset() {
+  estimate_ = 0;
+  step_ = kCvsdStepMin;
+  history_ = 0x05;
+}
+
+int16_t CvsdState::Step(bool bit) {
+  /* The step grows while the last 4 bits are all the same, the signal
+   * slope overloading the estimate, and decays otherwise */
+  history_ = ((history_ << 1) | bit) & 0x0f;
+  if (history_ == 0x00 || history_ == 0x0f) {
+    step_ = std::min(step_ + kCvsdStepMin, kCvsdStepMax);
+  } else {
+    step_ = std::max(step_ - (step_ >> 10), kCvsdStepMin);
+  }
+
+  int32_t sample = estimate_ + (bit ? step_ : -step_);
+  sample = std::min(std::max(sample, kCvsdMin), kCvsdMax);
+  /* The accumulator leaks by 1/32 every sample */
+  estimate_ = sample - (sample >> 5);
+  return static_cast<int16_t>(sample >> kFracBits);
+}
+
+void CvsdEncoder::Reset() {
+  state_.Reset();
+  last_sample_ = 0;
+}
+
+void CvsdEncoder::Encode(const int16_t* pcm, size_t num_samples,
+                         uint8_t* out) {
+  for (size_t i = 0; i < num_samples; i++) {
+    /* Up samples to 64 kHz by linear interpolation */
+    int32_t delta = pcm[i] - last_sample_;
+    uint8_t byte = 0;
+    for (int j = 0; j < kCvsdOversampling; j++) {
+      int16_t sample = static_cast<int16_t>(
+          last_sample_ + delta * (j + 1) / kCvsdOversampling);
+      bool bit = state_.Bit(sample);
+      state_.Step(bit);
+      if (bit) byte |= 1 << j;
+    }
+    out[i] = byte;
+    last_sample_ = pcm[i];
+  }
+}
+
+void CvsdDecoder::Reset() { state_.Reset(); }
+
+void CvsdDecoder::Decode(const uint8_t* data, size_t len, int16_t* pcm) {
+  for (size_t i = 0; i < len; i++) {
+    /* Down samples to 8 kHz by averaging, which also filters out most of the
+     * granular noise */
+    int32_t sum = 0;
+    for (int j = 0; j < kCvsdOversampling; j++) {
+      sum += state_.Step((data[i] >> j) & 0x01);
+    }
+    pcm[i] = static_cast<int16_t>(sum / kCvsdOversampling);
+  }
+}
+
+void MsbcPlc::Reset() {
+  memset(history_, 0, sizeof(history_));
+  best_lag_ = 0;
+  lost_frames_ = 0;
+}
+
+size_t MsbcPlc::PatternMatch() const {
+  /* Normalized cross correlation of the last samples with the window */
+  const int16_t* pattern = &history_[kHistory - kTemplate];
+  float max_correlation = -INFINITY;
+  size_t best_match = 0;
+  for (size_t n = 0; n < kWindow; n++) {
+    float sum_xy = 0.0f;
+    float sum_x2 = 0.0f;
+    for (size_t i = 0; i < kTemplate; i++) {
+      float x = history_[n + i];
+      sum_xy += pattern[i] * x;
+      sum_x2 += x * x;
+    }
+    float correlation = sum_xy / sqrtf(sum_x2 + 1.0f);
+    if (correlation > max_correlation) {
+      best_match = n;
+      max_correlation = correlation;
+    }
+  }
+  return best_match;
+}
+
+float MsbcPlc::AmplitudeMatch(size_t best_match) const {
+  float sum_x = 0.0f;
+  float sum_y = 0.000001f;
+  for (size_t i = 0; i < kFrameSamples; i++) {
+    sum_x += abs(history_[kHistory - kFrameSamples + i]);
+    sum_y += abs(history_[best_match + i]);
+  }
+  /* Bounded to keep the substitution from drifting in level */
+  return std::min(std::max(sum_x / sum_y, 0.75f), 1.2f);
+}
+
+void MsbcPlc::BadFrame(const int16_t* zir, int16_t* out) {
+  int16_t* next = &history_[kHistory];
+  const size_t end = kFrameSamples + kReconverge + kOverlap;
+  lost_frames_++;
+
+  if (lost_frames_ == 1) {
+    /* The substitution starts right after the best matching pattern */
+    best_lag_ = PatternMatch() + kTemplate;
+    float scale = AmplitudeMatch(best_lag_);
+    const int16_t* source = &history_[best_lag_];
+
+    size_t i = 0;
+    for (; i < kOverlap; i++) {
+      next[i] = Crop(zir[i] * kRcos[i] +
+                     scale * source[i] * kRcos[kOverlap - 1 - i]);
+    }
+    for (; i < kFrameSamples; i++) next[i] = Crop(scale * source[i]);
+    for (; i < kFrameSamples + kOverlap; i++) {
+      size_t j = i - kFrameSamples;
+      next[i] = Crop(scale * source[i] * kRcos[j] +
+                     source[i] * kRcos[kOverlap - 1 - j]);
+    }
+    for (; i < end; i++) next[i] = source[i];
+  } else if (lost_frames_ <= kMaxConcealedFrames) {
+    for (size_t i = 0; i < end; i++) next[i] = history_[best_lag_ + i];
+  } else {
+    for (size_t i = 0; i < end; i++) next[i] = 0;
+  }
+
+  memcpy(out, next, kFrameSamples * sizeof(*out));
+  memmove(history_, &history_[kFrameSamples],
+          (kHistory + kReconverge + kOverlap) * sizeof(*history_));
+}
+
+void MsbcPlc::GoodFrame(const int16_t* in, int16_t* out) {
+  const int16_t* concealed = &history_[kHistory];
+  size_t i = 0;
+  if (lost_frames_ > 0) {
+    /* The decoder needs a few samples to converge again: keep playing the
+     * concealment, then cross fade to the decoded samples */
+    for (; i < kReconverge; i++) out[i] = concealed[i];
+    for (; i < kReconverge + kOverlap; i++) {
+      size_t j = i - kReconverge;
+      out[i] = Crop(concealed[i] * kRcos[j] + in[i] * kRcos[kOverlap - 1 - j]);
+    }
+  }
+  for (; i < kFrameSamples; i++) out[i] = in[i];
+
+  memcpy(&history_[kHistory], out, kFrameSamples * sizeof(*out));
+  memmove(history_, &history_[kFrameSamples], kHistory * sizeof(*history_));
+  lost_frames_ = 0;
+}
+
+bool MsbcIsPacketStart(const uint8_t* data) {
+  if (data[0] != kH2Sync || data[kH2HeaderBytes] != OI_mSBC_SYNCWORD) {
+    return false;
+  }
+  return std::find(std::begin(kH2Sequence), std::end(kH2Sequence), data[1]) !=
+         std::end(kH2Sequence);
+}
+
+void MsbcEncoder::Reset() {
+  memset(&params_, 0, sizeof(params_));
+  params_.Format = SBC_FORMAT_MSBC;
+  SBC_Encoder_Init(&params_);
+  sequence_ = 0;
+}
+
+void MsbcEncoder::Encode(const int16_t* pcm, uint8_t* packet) {
+  /* SBC_Encode() does not take a const input */
+  int16_t input[kMsbcFrameSamples];
+  memcpy(input, pcm, sizeof(input));
+
+  packet[0] = kH2Sync;
+  packet[1] = kH2Sequence[sequence_];
+  sequence_ = (sequence_ + 1) % sizeof(kH2Sequence);
+  SBC_Encode(&params_, input, &packet[kH2HeaderBytes]);
+  packet[kMsbcPacketBytes - 1] = 0;
+}
+
+void MsbcDecoder::Reset() {
+  OI_CODEC_SBC_DecoderReset(&context_, context_data_, sizeof(context_data_), 1,
+                            1, false);
+  OI_CODEC_SBC_DecoderConfigureMSbc(&context_);
+  plc_.Reset();
+}
+
+bool MsbcDecoder::Decode(const uint8_t* packet, int16_t* pcm) {
+  if (packet != nullptr && MsbcIsPacketStart(packet)) {
+    int16_t decoded[kMsbcFrameSamples];
+    const OI_BYTE* frame = &packet[kH2HeaderBytes];
+    uint32_t frame_bytes = kMsbcPacketBytes - kH2HeaderBytes;
+    uint32_t pcm_bytes = sizeof(decoded);
+    OI_STATUS status = OI_CODEC_SBC_DecodeFrame(&context_, &frame, &frame_bytes,
+                                                decoded, &pcm_bytes);
+    if (OI_SUCCESS(status) && pcm_bytes == sizeof(decoded)) {
+      plc_.GoodFrame(decoded, pcm);
+      return true;
+    }
+  }
+
+  Conceal(pcm);
+  return false;
+}
+
+void MsbcDecoder::Conceal(int16_t* pcm) {
+  int16_t zir[kMsbcFrameSamples];
+  const OI_BYTE* frame = kSilentMsbcFrame.data();
+  uint32_t frame_bytes = kSilentMsbcFrame.size();
+  uint32_t pcm_bytes = sizeof(zir);
+  OI_STATUS status = OI_CODEC_SBC_DecodeFrame(&context_, &frame, &frame_bytes,
+                                              zir, &pcm_bytes);
+  if (!OI_SUCCESS(status) || pcm_bytes != sizeof(zir)) {
+    memset(zir, 0, sizeof(zir));
+  }
+  plc_.BadFrame(zir, pcm);
+}
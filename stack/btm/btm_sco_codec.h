@@ -0,0 +1,163 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "embdrv/sbc/decoder/include/oi_codec_sbc.h"
+#include "embdrv/sbc/encoder/include/sbc_encoder.h"
+
+/* Voice codecs of the (e)SCO links whose audio is carried over HCI and coded
+ * by the host rather than by the controller. */
+
+/* State shared by the CVSD encoder and decoder, which track the same
+ * estimate of the signal from the bit stream. */
+class CvsdState {
+ public:
+  CvsdState() { Reset(); }
+  void Reset();
+
+  /* Follows one bit of the stream, and returns the decoded sample */
+  int16_t Step(bool bit);
+
+  /* Bit coding |sample| against the current estimate */
+  bool Bit(int16_t sample) const {
+    return (static_cast<int32_t>(sample) << kFracBits) >= estimate_;
+  }
+
+ private:
+  /* Fixed point fraction bits of the estimate and the step size */
+  static constexpr int kFracBits = 10;
+
+  int32_t estimate_;
+  int32_t step_;
+  uint8_t history_;
+};
+
+/* CVSD of the Bluetooth Core specification (Vol 2, Part B, 9.2). The codec
+ * runs at 64 kHz, one bit per sample, and converts from and to 8 kHz linear
+ * PCM: each PCM sample is coded into one byte, sent least significant bit
+ * first. */
+class CvsdEncoder {
+ public:
+  CvsdEncoder() { Reset(); }
+  void Reset();
+
+  /* Codes |num_samples| samples of |pcm| into as many bytes of |out| */
+  void Encode(const int16_t* pcm, size_t num_samples, uint8_t* out);
+
+ private:
+  CvsdState state_;
+  int16_t last_sample_;
+};
+
+class CvsdDecoder {
+ public:
+  CvsdDecoder() { Reset(); }
+  void Reset();
+
+  /* Decodes |len| bytes of |data| into as many samples of |pcm| */
+  void Decode(const uint8_t* data, size_t len, int16_t* pcm);
+
+ private:
+  CvsdState state_;
+};
+
+/* mSBC packet loss concealment, as described by the informative appendix of
+ * the Hands-Free Profile specification. A lost frame is replaced by the
+ * stretch of the recent output that best continues the last good samples,
+ * scaled to their amplitude, and faded with the decoder's own output at both
+ * ends. */
+class MsbcPlc {
+ public:
+  static constexpr size_t kFrameSamples = 120;
+
+  MsbcPlc() { Reset(); }
+  void Reset();
+
+  /* Passes a good frame |in| to |out|, fading out the concealment of the
+   * frames lost before it */
+  void GoodFrame(const int16_t* in, int16_t* out);
+
+  /* Conceals a lost frame into |out|. |zir| holds the zero input response of
+   * the decoder, that is the output of its filters when fed a silent frame. */
+  void BadFrame(const int16_t* zir, int16_t* out);
+
+  /* Frames concealed in a row */
+  int lost_frames() const { return lost_frames_; }
+
+ private:
+  static constexpr size_t kWindow = 256;     /* pattern search window */
+  static constexpr size_t kTemplate = 64;    /* matched template */
+  static constexpr size_t kReconverge = 36;  /* SBC reconvergence time */
+  static constexpr size_t kOverlap = 16;     /* overlap-add length */
+  static constexpr size_t kHistory = kWindow + kFrameSamples - 1;
+
+  size_t PatternMatch() const;
+  float AmplitudeMatch(size_t best_match) const;
+
+  int16_t history_[kHistory + kFrameSamples + kReconverge + kOverlap];
+  size_t best_lag_;
+  int lost_frames_;
+};
+
+/* mSBC packets, as sent over eSCO by the Hands-Free Profile: a 57 byte mSBC
+ * frame coding 7.5 ms of 16 kHz audio, behind a two byte H2 synchronization
+ * header and followed by a padding byte. */
+constexpr size_t kMsbcPacketBytes = 60;
+constexpr size_t kMsbcFrameSamples = MsbcPlc::kFrameSamples;
+
+/* Whether the H2 header of an mSBC packet starts at |data| */
+bool MsbcIsPacketStart(const uint8_t* data);
+
+/* The SBC encoder state lives in |params_|, so an mSBC encoder may run along
+ * with the A2DP SBC encoder. Construction does not set the codec up: Reset()
+ * must be called before the first frame is coded. */
+class MsbcEncoder {
+ public:
+  MsbcEncoder() : params_(), sequence_(0) {}
+  void Reset();
+
+  /* Codes |kMsbcFrameSamples| samples of |pcm| into |kMsbcPacketBytes| bytes
+   * of |packet| */
+  void Encode(const int16_t* pcm, uint8_t* packet);
+
+ private:
+  SBC_ENC_PARAMS params_;
+  uint8_t sequence_;
+};
+
+class MsbcDecoder {
+ public:
+  MsbcDecoder() { Reset(); }
+  void Reset();
+
+  /* Decodes the packet |packet|, of |kMsbcPacketBytes| bytes, into
+   * |kMsbcFrameSamples| samples of |pcm|. When |packet| is null, or fails to
+   * decode, the frame is concealed and false is returned. */
+  bool Decode(const uint8_t* packet, int16_t* pcm);
+
+ private:
+  void Conceal(int16_t* pcm);
+
+  OI_CODEC_SBC_DECODER_CONTEXT context_;
+  uint32_t context_data_[CODEC_DATA_WORDS(1, SBC_CODEC_FAST_FILTER_BUFFERS)];
+  MsbcPlc plc_;
+};
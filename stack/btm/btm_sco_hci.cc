@@ -0,0 +1,434 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btm_sco_hci.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+/* Air time of one byte of a 64 kbit/s (e)SCO link */
+constexpr uint64_t kUsPerByte = 125;
+
+/* Alternating bits, which CVSD decodes to silence */
+constexpr uint8_t kCvsdIdle = 0x55;
+
+}  // namespace
+
+ScoHciPath::ScoHciPath(Clock clock, Transmit transmit)
+    : clock_(clock),
+      transmit_(std::move(transmit)),
+      active_(false),
+      handle_(0),
+      codec_(Codec::kCvsd),
+      sample_rate_(8000),
+      packet_len_(0),
+      /* Sized for the highest sample rate */
+      rx_ring_(ringbuffer_init(16000 * kRingUs / 1000000 * sizeof(int16_t))),
+      tx_ring_(ringbuffer_init(16000 * kRingUs / 1000000 * sizeof(int16_t))),
+      ring_samples_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+  ResetLocked();
+}
+
+ScoHciPath::~ScoHciPath() {
+  ringbuffer_free(rx_ring_);
+  ringbuffer_free(tx_ring_);
+}
+
+void ScoHciPath::ResetLocked() {
+  ringbuffer_delete(rx_ring_, ringbuffer_size(rx_ring_));
+  ringbuffer_delete(tx_ring_, ringbuffer_size(tx_ring_));
+  rx_buffer_len_ = 0;
+  rx_synced_ = true;
+  rx_skipped_bytes_ = 0;
+  tx_packet_offset_ = kMsbcPacketBytes;
+  next_tx_us_ = 0;
+  last_rx_us_ = 0;
+  last_rx_len_ = 0;
+  jitter_us_ = 0;
+  rx_ring_samples_ = 0;
+  rx_ring_reads_ = 0;
+  rx_ring_max_ = 0;
+  tx_ring_samples_ = 0;
+  tx_ring_takes_ = 0;
+  tx_ring_max_ = 0;
+}
+
+void ScoHciPath::Start(uint16_t handle, Codec codec, uint8_t packet_len) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ResetLocked();
+  memset(&stats_, 0, sizeof(stats_));
+
+  handle_ = handle;
+  codec_ = codec;
+  sample_rate_ = (codec == Codec::kMsbc) ? 16000 : 8000;
+  ring_samples_ = sample_rate_ * kRingUs / 1000000;
+  packet_len_ = packet_len;
+  if (codec == Codec::kMsbc) {
+    msbc_encoder_.Reset();
+    msbc_decoder_.Reset();
+  } else {
+    cvsd_encoder_.Reset();
+    cvsd_decoder_.Reset();
+  }
+  active_ = true;
+}
+
+void ScoHciPath::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  active_ = false;
+  ResetLocked();
+}
+
+bool ScoHciPath::IsActive() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return active_;
+}
+
+uint16_t ScoHciPath::handle() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return handle_;
+}
+
+int ScoHciPath::SampleRate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sample_rate_;
+}
+
+uint64_t ScoHciPath::SamplesToUs(uint64_t num_samples) const {
+  return num_samples * 1000000 / sample_rate_;
+}
+
+void ScoHciPath::OnRxPacket(uint8_t packet_status, const uint8_t* data,
+                            uint8_t len) {
+  Packet packets[kMaxBurst];
+  int count;
+  uint16_t handle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_) return;
+    uint64_t now_us = clock_();
+
+    stats_.rx_packets++;
+    stats_.rx_bytes += len;
+    if (packet_status == BTM_SCO_PKT_STATUS_NO_DATA) {
+      stats_.rx_lost_packets++;
+    } else if (packet_status != BTM_SCO_PKT_STATUS_GOOD) {
+      stats_.rx_error_packets++;
+    }
+
+    if (last_rx_us_ != 0) {
+      uint64_t expected_us = last_rx_len_ * kUsPerByte;
+      uint64_t gap_us = now_us - last_rx_us_;
+      double deviation_us = (gap_us > expected_us) ? gap_us - expected_us
+                                                   : expected_us - gap_us;
+      jitter_us_ += (deviation_us - jitter_us_) / 16;
+      stats_.rx_jitter_us = jitter_us_;
+      stats_.rx_max_jitter_us =
+          std::max(stats_.rx_max_jitter_us, stats_.rx_jitter_us);
+      if (gap_us > expected_us + expected_us / 2) stats_.rx_late_packets++;
+    }
+    last_rx_us_ = now_us;
+    last_rx_len_ = len;
+    if (len == 0) return;
+    packet_len_ = len;
+
+    if (codec_ == Codec::kMsbc) {
+      DecodeMsbcLocked(packet_status, data, len);
+    } else {
+      DecodeCvsdLocked(packet_status, data, len);
+    }
+
+    /* Answer with the packet due about now, and pace the next ones from the
+     * arrival of this one */
+    uint64_t period_us = packet_len_ * kUsPerByte;
+    count = CodeDuePacketsLocked(now_us + period_us / 2, packets);
+    if (count > 0) next_tx_us_ = now_us + period_us;
+    handle = handle_;
+  }
+  TransmitPackets(handle, packets, count);
+}
+
+void ScoHciPath::SendDuePackets() {
+  Packet packets[kMaxBurst];
+  int count;
+  uint16_t handle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!active_ || packet_len_ == 0) return;
+    count = CodeDuePacketsLocked(clock_(), packets);
+    handle = handle_;
+  }
+  TransmitPackets(handle, packets, count);
+}
+
+void ScoHciPath::TransmitPackets(uint16_t handle, const Packet* packets,
+                                 int count) {
+  for (int i = 0; i < count; i++) {
+    transmit_(handle, packets[i].data, packets[i].len);
+  }
+}
+
+int ScoHciPath::CodeDuePacketsLocked(uint64_t now_us, Packet* packets) {
+  uint64_t period_us = packet_len_ * kUsPerByte;
+  if (next_tx_us_ == 0) next_tx_us_ = now_us;
+
+  int count = 0;
+  while (next_tx_us_ <= now_us && count < kMaxBurst) {
+    CodePacketLocked(&packets[count++]);
+    next_tx_us_ += period_us;
+  }
+
+  /* Too far behind to catch up: skip the packets whose time has passed, and
+   * the audio they would have carried */
+  if (next_tx_us_ <= now_us) {
+    uint64_t skipped = (now_us - next_tx_us_) / period_us + 1;
+    stats_.tx_skipped_packets += skipped;
+    next_tx_us_ += skipped * period_us;
+    uint64_t skipped_samples =
+        skipped * packet_len_ * kUsPerByte * sample_rate_ / 1000000;
+    ringbuffer_delete(tx_ring_, skipped_samples * sizeof(int16_t));
+  }
+  stats_.tx_packets += count;
+  return count;
+}
+
+void ScoHciPath::CodePacketLocked(Packet* packet) {
+  packet->len = packet_len_;
+  if (codec_ == Codec::kCvsd) {
+    int16_t pcm[kMaxPacketBytes];
+    TakeTxPcmLocked(pcm, packet_len_);
+    cvsd_encoder_.Encode(pcm, packet_len_, packet->data);
+    return;
+  }
+
+  for (size_t i = 0; i < packet_len_; i++) {
+    if (tx_packet_offset_ == kMsbcPacketBytes) {
+      int16_t pcm[kMsbcFrameSamples];
+      TakeTxPcmLocked(pcm, kMsbcFrameSamples);
+      msbc_encoder_.Encode(pcm, tx_packet_);
+      tx_packet_offset_ = 0;
+    }
+    packet->data[i] = tx_packet_[tx_packet_offset_++];
+  }
+}
+
+void ScoHciPath::DecodeCvsdLocked(uint8_t packet_status, const uint8_t* data,
+                                  uint8_t len) {
+  int16_t pcm[kMaxPacketBytes];
+  if (packet_status == BTM_SCO_PKT_STATUS_NO_DATA) {
+    /* Let the decoder settle down to silence */
+    uint8_t idle[kMaxPacketBytes];
+    memset(idle, kCvsdIdle, len);
+    cvsd_decoder_.Decode(idle, len, pcm);
+    stats_.frames_concealed++;
+  } else {
+    cvsd_decoder_.Decode(data, len, pcm);
+    stats_.frames_decoded++;
+  }
+  QueueRxPcmLocked(pcm, len);
+}
+
+void ScoHciPath::DecodeMsbcLocked(uint8_t packet_status, const uint8_t* data,
+                                  uint8_t len) {
+  /* The frame CRC tells whether data flagged as invalid can be used */
+  bool good = packet_status == BTM_SCO_PKT_STATUS_GOOD ||
+              packet_status == BTM_SCO_PKT_STATUS_INVALID;
+  memcpy(&rx_buffer_[rx_buffer_len_], data, len);
+  memset(&rx_good_[rx_buffer_len_], good, len);
+  rx_buffer_len_ += len;
+
+  int16_t pcm[kMsbcFrameSamples];
+  size_t start = 0;
+  while (rx_buffer_len_ - start >= kMsbcPacketBytes) {
+    const bool* good_bytes = &rx_good_[start];
+    if (!good_bytes[0] && !good_bytes[1]) {
+      /* The controller keeps the packet boundaries of lost data: conceal the
+       * frame in its place */
+      msbc_decoder_.Decode(nullptr, pcm);
+      stats_.frames_concealed++;
+      start += kMsbcPacketBytes;
+    } else if (MsbcIsPacketStart(&rx_buffer_[start])) {
+      bool intact = std::all_of(good_bytes, good_bytes + kMsbcPacketBytes - 1,
+                                [](bool byte_good) { return byte_good; });
+      if (msbc_decoder_.Decode(intact ? &rx_buffer_[start] : nullptr, pcm)) {
+        stats_.frames_decoded++;
+      } else {
+        stats_.frames_concealed++;
+      }
+      rx_synced_ = true;
+      rx_skipped_bytes_ = 0;
+      start += kMsbcPacketBytes;
+    } else {
+      /* Out of sync: look for the next header, keeping the bytes that may
+       * start one, and conceal the time skipped */
+      if (rx_synced_) stats_.resyncs++;
+      rx_synced_ = false;
+      size_t next = start + 1;
+      while (next + 2 < rx_buffer_len_ && !MsbcIsPacketStart(&rx_buffer_[next]))
+        next++;
+      rx_skipped_bytes_ += next - start;
+      start = next;
+      while (rx_skipped_bytes_ >= kMsbcPacketBytes) {
+        rx_skipped_bytes_ -= kMsbcPacketBytes;
+        msbc_decoder_.Decode(nullptr, pcm);
+        stats_.frames_concealed++;
+        QueueRxPcmLocked(pcm, kMsbcFrameSamples);
+      }
+      continue;
+    }
+    QueueRxPcmLocked(pcm, kMsbcFrameSamples);
+  }
+
+  rx_buffer_len_ -= start;
+  memmove(rx_buffer_, &rx_buffer_[start], rx_buffer_len_);
+  memmove(rx_good_, &rx_good_[start], rx_buffer_len_);
+}
+
+void ScoHciPath::QueueRxPcmLocked(const int16_t* pcm, size_t num_samples) {
+  size_t queued = ringbuffer_size(rx_ring_) / sizeof(int16_t);
+  if (queued + num_samples > ring_samples_) {
+    /* The audio HAL fell behind: drop the oldest audio */
+    size_t dropped = std::min(queued + num_samples - ring_samples_, queued);
+    ringbuffer_delete(rx_ring_, dropped * sizeof(int16_t));
+    stats_.rx_ring_overruns += dropped;
+  }
+  ringbuffer_insert(rx_ring_, reinterpret_cast<const uint8_t*>(pcm),
+                    num_samples * sizeof(int16_t));
+}
+
+void ScoHciPath::TakeTxPcmLocked(int16_t* pcm, size_t num_samples) {
+  size_t queued = ringbuffer_size(tx_ring_) / sizeof(int16_t);
+  tx_ring_samples_ += queued;
+  tx_ring_takes_++;
+  tx_ring_max_ = std::max(tx_ring_max_, queued);
+
+  size_t taken = ringbuffer_pop(tx_ring_, reinterpret_cast<uint8_t*>(pcm),
+                                num_samples * sizeof(int16_t)) /
+                 sizeof(int16_t);
+  if (taken < num_samples) {
+    memset(&pcm[taken], 0, (num_samples - taken) * sizeof(int16_t));
+    stats_.tx_ring_underruns += num_samples - taken;
+  }
+}
+
+size_t ScoHciPath::ReadPcm(int16_t* pcm, size_t num_samples) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t read = 0;
+  if (active_) {
+    size_t queued = ringbuffer_size(rx_ring_) / sizeof(int16_t);
+    rx_ring_samples_ += queued;
+    rx_ring_reads_++;
+    rx_ring_max_ = std::max(rx_ring_max_, queued);
+    read = ringbuffer_pop(rx_ring_, reinterpret_cast<uint8_t*>(pcm),
+                          num_samples * sizeof(int16_t)) /
+           sizeof(int16_t);
+    stats_.rx_ring_underruns += num_samples - read;
+  }
+  memset(&pcm[read], 0, (num_samples - read) * sizeof(int16_t));
+  return read;
+}
+
+size_t ScoHciPath::WritePcm(const int16_t* pcm, size_t num_samples) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!active_) return 0;
+
+  /* Only the latest audio fits in the ring */
+  if (num_samples > ring_samples_) {
+    stats_.tx_ring_overruns += num_samples - ring_samples_;
+    pcm += num_samples - ring_samples_;
+    num_samples = ring_samples_;
+  }
+  size_t queued = ringbuffer_size(tx_ring_) / sizeof(int16_t);
+  if (queued + num_samples > ring_samples_) {
+    size_t dropped = queued + num_samples - ring_samples_;
+    ringbuffer_delete(tx_ring_, dropped * sizeof(int16_t));
+    stats_.tx_ring_overruns += dropped;
+  }
+  ringbuffer_insert(tx_ring_, reinterpret_cast<const uint8_t*>(pcm),
+                    num_samples * sizeof(int16_t));
+  return num_samples;
+}
+
+ScoHciStats ScoHciPath::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ScoHciStats stats = stats_;
+  if (rx_ring_reads_ > 0) {
+    stats.rx_ring_avg_us = SamplesToUs(rx_ring_samples_ / rx_ring_reads_);
+  }
+  stats.rx_ring_max_us = SamplesToUs(rx_ring_max_);
+  if (tx_ring_takes_ > 0) {
+    stats.tx_ring_avg_us = SamplesToUs(tx_ring_samples_ / tx_ring_takes_);
+  }
+  stats.tx_ring_max_us = SamplesToUs(tx_ring_max_);
+  return stats;
+}
+
+void ScoHciPath::Dump(int fd) {
+  ScoHciStats stats = GetStats();
+  std::lock_guard<std::mutex> lock(mutex_);
+  dprintf(fd,
+          "  Path (active/handle/codec/packet length)                : %s / "
+          "0x%04x / %s / %u\n",
+          active_ ? "true" : "false", handle_,
+          (codec_ == Codec::kMsbc) ? "mSBC" : "CVSD", packet_len_);
+  dprintf(fd,
+          "  RX packets (received/lost/errors/late)                  : %llu / "
+          "%llu / %llu / %llu\n",
+          (unsigned long long)stats.rx_packets,
+          (unsigned long long)stats.rx_lost_packets,
+          (unsigned long long)stats.rx_error_packets,
+          (unsigned long long)stats.rx_late_packets);
+  dprintf(fd,
+          "  RX jitter in us (current/max)                           : %u / "
+          "%u\n",
+          stats.rx_jitter_us, stats.rx_max_jitter_us);
+  dprintf(fd,
+          "  TX packets (sent/skipped)                               : %llu / "
+          "%llu\n",
+          (unsigned long long)stats.tx_packets,
+          (unsigned long long)stats.tx_skipped_packets);
+  dprintf(fd,
+          "  Frames (decoded/concealed/resyncs)                      : %llu / "
+          "%llu / %llu\n",
+          (unsigned long long)stats.frames_decoded,
+          (unsigned long long)stats.frames_concealed,
+          (unsigned long long)stats.resyncs);
+  dprintf(fd,
+          "  RX ring in us (average/max)                             : %u / "
+          "%u\n",
+          stats.rx_ring_avg_us, stats.rx_ring_max_us);
+  dprintf(fd,
+          "  TX ring in us (average/max)                             : %u / "
+          "%u\n",
+          stats.tx_ring_avg_us, stats.tx_ring_max_us);
+  dprintf(fd,
+          "  RX ring samples (overruns/underruns)                    : %llu / "
+          "%llu\n",
+          (unsigned long long)stats.rx_ring_overruns,
+          (unsigned long long)stats.rx_ring_underruns);
+  dprintf(fd,
+          "  TX ring samples (overruns/underruns)                    : %llu / "
+          "%llu\n",
+          (unsigned long long)stats.tx_ring_overruns,
+          (unsigned long long)stats.tx_ring_underruns);
+}
@@ -0,0 +1,200 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+
+#include "btm_sco_codec.h"
+#include "osi/include/ringbuffer.h"
+
+/* Packet status flag of the HCI SCO data packets (Core spec Vol 4, Part E,
+ * 5.4.3), reported by controllers with erroneous data reporting enabled */
+#define BTM_SCO_PKT_STATUS_GOOD 0
+#define BTM_SCO_PKT_STATUS_INVALID 1
+#define BTM_SCO_PKT_STATUS_NO_DATA 2
+#define BTM_SCO_PKT_STATUS_PARTIAL 3
+
+/* Counters of a SCO audio path carried over HCI */
+struct ScoHciStats {
+  uint64_t rx_packets;
+  uint64_t rx_bytes;
+  uint64_t rx_lost_packets;    /* reported by the controller as no data */
+  uint64_t rx_error_packets;   /* reported as invalid or partially lost */
+  uint64_t rx_late_packets;    /* arrived over half an interval late */
+  uint32_t rx_jitter_us;       /* interarrival jitter, as of RFC 3550 */
+  uint32_t rx_max_jitter_us;
+  uint64_t tx_packets;
+  uint64_t tx_skipped_packets; /* given up after the stack fell behind */
+  uint64_t frames_decoded;
+  uint64_t frames_concealed;
+  uint64_t resyncs;            /* mSBC headers searched for in the stream */
+  uint64_t rx_ring_overruns;   /* samples dropped for a slow audio HAL */
+  uint64_t rx_ring_underruns;  /* samples of silence read by the audio HAL */
+  uint64_t tx_ring_overruns;   /* samples dropped for a slow link */
+  uint64_t tx_ring_underruns;  /* samples of silence sent on the link */
+  uint32_t rx_ring_avg_us;     /* audio waiting for the audio HAL to read it */
+  uint32_t rx_ring_max_us;
+  uint32_t tx_ring_avg_us;     /* audio waiting for its packet to be sent */
+  uint32_t tx_ring_max_us;
+};
+
+/* Audio of an (e)SCO link routed over HCI, coded by the host.
+ *
+ * The controller gives one packet per eSCO interval, and takes the packets
+ * of the host at the same rate. Each RX packet is answered by a TX packet of
+ * its length, since the transport (USB in particular) may split the air
+ * packets: the link clocks the path. When RX packets stop coming, as they do
+ * on controllers reporting no lost packets, TX packets are paced at the rate
+ * of the air interface on the monotonic clock instead.
+ *
+ * mSBC packets are reassembled from the HCI packets by their H2 header, and
+ * frames lost on the air, as reported by the packet status flag, or damaged,
+ * are concealed. Decoded audio and audio to send go through two rings holding
+ * a few packets of audio, read and written by the audio HAL: the HAL reads
+ * silence rather than waiting when the link is late, and the oldest audio is
+ * dropped when a side falls behind, so that latency does not build up.
+ *
+ * The stack calls Start(), Stop(), OnRxPacket() and SendDuePackets() from its
+ * thread, while the audio HAL reads and writes PCM from its own.
+ */
+class ScoHciPath {
+ public:
+  enum class Codec { kCvsd, kMsbc };
+
+  /* Monotonic clock, in microseconds */
+  using Clock = uint64_t (*)();
+  /* Sends |len| bytes of audio on the link |handle| */
+  using Transmit =
+      std::function<void(uint16_t handle, const uint8_t* data, uint8_t len)>;
+
+  ScoHciPath(Clock clock, Transmit transmit);
+  ~ScoHciPath();
+
+  ScoHciPath(const ScoHciPath&) = delete;
+  ScoHciPath& operator=(const ScoHciPath&) = delete;
+
+  /* Starts the audio of the link |handle|. |packet_len| is the length of the
+   * packets expected from the controller, until the first one comes in. */
+  void Start(uint16_t handle, Codec codec, uint8_t packet_len);
+  void Stop();
+
+  bool IsActive();
+  uint16_t handle();
+
+  /* Handles |len| bytes of audio received with the packet status flag
+   * |packet_status|, then sends the packets due */
+  void OnRxPacket(uint8_t packet_status, const uint8_t* data, uint8_t len);
+
+  /* Sends the packets due by now on the monotonic clock, for the RX packets
+   * that did not come in. To be called about once per packet. */
+  void SendDuePackets();
+
+  /* Audio HAL: 16 bit mono PCM, at SampleRate() */
+  int SampleRate();
+  /* Reads |num_samples| samples of received audio into |pcm|, padded with
+   * silence. Returns the number of samples received. */
+  size_t ReadPcm(int16_t* pcm, size_t num_samples);
+  /* Queues |num_samples| samples of |pcm| to send. Returns the number of
+   * samples queued, which is all of them while the path is active. */
+  size_t WritePcm(const int16_t* pcm, size_t num_samples);
+
+  ScoHciStats GetStats();
+  void Dump(int fd);
+
+ private:
+  /* Largest packet of the HCI SCO data packets */
+  static constexpr size_t kMaxPacketBytes = 255;
+  /* Packets sent at once when the stack was held up */
+  static constexpr int kMaxBurst = 2;
+  /* Audio kept in each ring */
+  static constexpr uint64_t kRingUs = 40000;
+  /* mSBC reassembly: less than a packet left over, and one HCI packet */
+  static constexpr size_t kRxBufferBytes = kMsbcPacketBytes + kMaxPacketBytes;
+
+  struct Packet {
+    uint8_t data[kMaxPacketBytes];
+    uint8_t len;
+  };
+
+  void ResetLocked();
+  uint64_t SamplesToUs(uint64_t num_samples) const;
+  void DecodeCvsdLocked(uint8_t packet_status, const uint8_t* data,
+                        uint8_t len);
+  void DecodeMsbcLocked(uint8_t packet_status, const uint8_t* data,
+                        uint8_t len);
+  void QueueRxPcmLocked(const int16_t* pcm, size_t num_samples);
+  /* Takes |num_samples| samples to send into |pcm|, padded with silence */
+  void TakeTxPcmLocked(int16_t* pcm, size_t num_samples);
+  void CodePacketLocked(Packet* packet);
+  /* Codes the packets due at |now_us| into |packets|, of |kMaxBurst|
+   * entries, and returns their number */
+  int CodeDuePacketsLocked(uint64_t now_us, Packet* packets);
+  void TransmitPackets(uint16_t handle, const Packet* packets, int count);
+
+  const Clock clock_;
+  const Transmit transmit_;
+
+  std::mutex mutex_;
+  bool active_;
+  uint16_t handle_;
+  Codec codec_;
+  int sample_rate_;
+
+  CvsdEncoder cvsd_encoder_;
+  CvsdDecoder cvsd_decoder_;
+  MsbcEncoder msbc_encoder_;
+  MsbcDecoder msbc_decoder_;
+
+  /* mSBC reassembly, and whether each byte was received good */
+  uint8_t rx_buffer_[kRxBufferBytes];
+  bool rx_good_[kRxBufferBytes];
+  size_t rx_buffer_len_;
+  bool rx_synced_;
+  size_t rx_skipped_bytes_;
+
+  /* mSBC packet coded and not fully sent yet */
+  uint8_t tx_packet_[kMsbcPacketBytes];
+  size_t tx_packet_offset_;
+
+  /* Pacing */
+  uint8_t packet_len_;
+  uint64_t next_tx_us_;
+  uint64_t last_rx_us_;
+  uint8_t last_rx_len_;
+  double jitter_us_;
+
+  /* PCM rings, of |ring_samples_| samples each */
+  ringbuffer_t* rx_ring_;
+  ringbuffer_t* tx_ring_;
+  size_t ring_samples_;
+
+  /* Ring depth, summed over the HAL reads and the packets sent */
+  uint64_t rx_ring_samples_;
+  uint64_t rx_ring_reads_;
+  size_t rx_ring_max_;
+  uint64_t tx_ring_samples_;
+  uint64_t tx_ring_takes_;
+  size_t tx_ring_max_;
+
+  ScoHciStats stats_;
+};
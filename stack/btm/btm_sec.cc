@@ -1742,6 +1742,7 @@ tBTM_STATUS btm_sec_l2cap_access_req(const RawAddress& bd_addr, uint16_t psm,
   p_dev_rec = btm_find_or_alloc_dev(bd_addr);
 
   p_dev_rec->hci_handle = handle;
+  btm_sec_update_dev_index(p_dev_rec);
 
   /* Find the service record for the PSM */
   p_serv_rec = btm_sec_find_first_serv(conn_type, psm);
@@ -4159,6 +4160,7 @@ void btm_sec_connected(const RawAddress& bda, uint16_t handle, uint8_t status,
   }
 
   p_dev_rec->hci_handle = handle;
+  btm_sec_update_dev_index(p_dev_rec);
 
   /* role may not be correct here, it will be updated by l2cap, but we need to
    */
@@ -4329,6 +4331,7 @@ void btm_sec_disconnected(uint16_t handle, uint8_t reason) {
 
   if (transport == BT_TRANSPORT_LE) {
     p_dev_rec->ble_hci_handle = BTM_SEC_INVALID_HANDLE;
+    btm_sec_update_dev_index(p_dev_rec);
     p_dev_rec->sec_flags &= ~(BTM_SEC_LE_AUTHENTICATED | BTM_SEC_LE_ENCRYPTED);
     p_dev_rec->enc_key_size = 0;
 
@@ -4339,6 +4342,7 @@ void btm_sec_disconnected(uint16_t handle, uint8_t reason) {
     }
   } else {
     p_dev_rec->hci_handle = BTM_SEC_INVALID_HANDLE;
+    btm_sec_update_dev_index(p_dev_rec);
     p_dev_rec->sec_flags &=
         ~(BTM_SEC_AUTHORIZED | BTM_SEC_AUTHENTICATED | BTM_SEC_ENCRYPTED |
           BTM_SEC_ROLE_SWITCHED | BTM_SEC_16_DIGIT_PIN_AUTHED);
@@ -0,0 +1,150 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "btm_sec_dev_index.h"
+
+#include <algorithm>
+
+SecDevRecIndex::Keys SecDevRecIndex::KeysOf(const tBTM_SEC_DEV_REC* p_dev_rec,
+                                            uint64_t order) {
+  return Keys{order,
+              p_dev_rec->bd_addr,
+              p_dev_rec->ble.pseudo_addr,
+              p_dev_rec->ble.identity_addr,
+              p_dev_rec->hci_handle,
+              p_dev_rec->ble_hci_handle};
+}
+
+template <typename K>
+void SecDevRecIndex::Insert(std::unordered_map<K, Bucket>& map, const K& key,
+                            tBTM_SEC_DEV_REC* p_dev_rec) {
+  if (!IsIndexed(key)) return;
+  map[key].push_back(p_dev_rec);
+}
+
+template <typename K>
+void SecDevRecIndex::Erase(std::unordered_map<K, Bucket>& map, const K& key,
+                           tBTM_SEC_DEV_REC* p_dev_rec) {
+  if (!IsIndexed(key)) return;
+  auto it = map.find(key);
+  if (it == map.end()) return;
+
+  Bucket& bucket = it->second;
+  auto rec = std::find(bucket.begin(), bucket.end(), p_dev_rec);
+  if (rec != bucket.end()) bucket.erase(rec);
+  if (bucket.empty()) map.erase(it);
+}
+
+template <typename K>
+tBTM_SEC_DEV_REC* SecDevRecIndex::First(
+    const std::unordered_map<K, Bucket>& map, const K& key) const {
+  auto it = map.find(key);
+  if (it == map.end()) return nullptr;
+
+  const Bucket& bucket = it->second;
+  tBTM_SEC_DEV_REC* first = bucket[0];
+  for (size_t i = 1; i < bucket.size(); i++) {
+    if (keys_.at(bucket[i]).order < keys_.at(first).order) first = bucket[i];
+  }
+  return first;
+}
+
+void SecDevRecIndex::IndexKeys(const Keys& keys, tBTM_SEC_DEV_REC* p_dev_rec) {
+  Insert(by_address_, keys.bd_addr, p_dev_rec);
+  Insert(by_address_, keys.pseudo_addr, p_dev_rec);
+  Insert(by_identity_addr_, keys.identity_addr, p_dev_rec);
+  Insert(by_handle_, keys.hci_handle, p_dev_rec);
+  Insert(by_handle_, keys.ble_hci_handle, p_dev_rec);
+}
+
+void SecDevRecIndex::UnindexKeys(const Keys& keys,
+                                 tBTM_SEC_DEV_REC* p_dev_rec) {
+  Erase(by_address_, keys.bd_addr, p_dev_rec);
+  Erase(by_address_, keys.pseudo_addr, p_dev_rec);
+  Erase(by_identity_addr_, keys.identity_addr, p_dev_rec);
+  Erase(by_handle_, keys.hci_handle, p_dev_rec);
+  Erase(by_handle_, keys.ble_hci_handle, p_dev_rec);
+}
+
+void SecDevRecIndex::Add(tBTM_SEC_DEV_REC* p_dev_rec) {
+  if (keys_.count(p_dev_rec) != 0) {
+    Update(p_dev_rec);
+    return;
+  }
+  Keys keys = KeysOf(p_dev_rec, next_order_++);
+  keys_.emplace(p_dev_rec, keys);
+  IndexKeys(keys, p_dev_rec);
+}
+
+void SecDevRecIndex::Update(tBTM_SEC_DEV_REC* p_dev_rec) {
+  auto it = keys_.find(p_dev_rec);
+  if (it == keys_.end()) return;
+
+  Keys& old_keys = it->second;
+  Keys new_keys = KeysOf(p_dev_rec, old_keys.order);
+  if (old_keys.bd_addr != new_keys.bd_addr) {
+    Erase(by_address_, old_keys.bd_addr, p_dev_rec);
+    Insert(by_address_, new_keys.bd_addr, p_dev_rec);
+  }
+  if (old_keys.pseudo_addr != new_keys.pseudo_addr) {
+    Erase(by_address_, old_keys.pseudo_addr, p_dev_rec);
+    Insert(by_address_, new_keys.pseudo_addr, p_dev_rec);
+  }
+  if (old_keys.identity_addr != new_keys.identity_addr) {
+    Erase(by_identity_addr_, old_keys.identity_addr, p_dev_rec);
+    Insert(by_identity_addr_, new_keys.identity_addr, p_dev_rec);
+  }
+  if (old_keys.hci_handle != new_keys.hci_handle) {
+    Erase(by_handle_, old_keys.hci_handle, p_dev_rec);
+    Insert(by_handle_, new_keys.hci_handle, p_dev_rec);
+  }
+  if (old_keys.ble_hci_handle != new_keys.ble_hci_handle) {
+    Erase(by_handle_, old_keys.ble_hci_handle, p_dev_rec);
+    Insert(by_handle_, new_keys.ble_hci_handle, p_dev_rec);
+  }
+  old_keys = new_keys;
+}
+
+void SecDevRecIndex::Remove(tBTM_SEC_DEV_REC* p_dev_rec) {
+  auto it = keys_.find(p_dev_rec);
+  if (it == keys_.end()) return;
+
+  UnindexKeys(it->second, p_dev_rec);
+  keys_.erase(it);
+}
+
+void SecDevRecIndex::Clear() {
+  keys_.clear();
+  by_address_.clear();
+  by_identity_addr_.clear();
+  by_handle_.clear();
+}
+
+tBTM_SEC_DEV_REC* SecDevRecIndex::FindByAddress(
+    const RawAddress& bd_addr) const {
+  return First(by_address_, bd_addr);
+}
+
+tBTM_SEC_DEV_REC* SecDevRecIndex::FindByIdentityAddress(
+    const RawAddress& bd_addr) const {
+  return First(by_identity_addr_, bd_addr);
+}
+
+tBTM_SEC_DEV_REC* SecDevRecIndex::FindByHandle(uint16_t handle) const {
+  return First(by_handle_, handle);
+}
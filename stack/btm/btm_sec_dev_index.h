@@ -0,0 +1,106 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "btm_int_types.h"
+#include "types/raw_address.h"
+
+/* Hash index of the security device records of btm_cb.sec_dev_rec, on the BD
+ * address, the LE pseudo and identity addresses, and the BR/EDR and LE
+ * connection handles.
+ *
+ * The index remembers the keys each record was indexed with: Update() must be
+ * called after any of these fields of an indexed record is written. When
+ * several records share a key, lookups return the one added first, which is
+ * the one a scan of the record list finds first.
+ *
+ * Empty addresses and BTM_SEC_INVALID_HANDLE are shared by most records and
+ * are not indexed; lookups of these keys return nullptr and callers have to
+ * scan the list. */
+class SecDevRecIndex {
+ public:
+  /* Indexes |p_dev_rec|, which was just appended to the record list */
+  void Add(tBTM_SEC_DEV_REC* p_dev_rec);
+
+  /* Re-indexes |p_dev_rec| after its addresses or handles changed */
+  void Update(tBTM_SEC_DEV_REC* p_dev_rec);
+
+  /* Drops |p_dev_rec| from the index before it is freed */
+  void Remove(tBTM_SEC_DEV_REC* p_dev_rec);
+
+  void Clear();
+
+  /* First record whose BD address or LE pseudo address is |bd_addr| */
+  tBTM_SEC_DEV_REC* FindByAddress(const RawAddress& bd_addr) const;
+
+  /* First record whose LE identity address is |bd_addr| */
+  tBTM_SEC_DEV_REC* FindByIdentityAddress(const RawAddress& bd_addr) const;
+
+  /* First record whose BR/EDR or LE connection handle is |handle| */
+  tBTM_SEC_DEV_REC* FindByHandle(uint16_t handle) const;
+
+  /* Whether lookups of the key can be answered by the index */
+  static bool IsIndexed(const RawAddress& bd_addr) {
+    return !bd_addr.IsEmpty();
+  }
+  static bool IsIndexed(uint16_t handle) {
+    return handle != BTM_SEC_INVALID_HANDLE;
+  }
+
+  size_t size() const { return keys_.size(); }
+
+ private:
+  struct Keys {
+    uint64_t order;
+    RawAddress bd_addr;
+    RawAddress pseudo_addr;
+    RawAddress identity_addr;
+    uint16_t hci_handle;
+    uint16_t ble_hci_handle;
+  };
+
+  /* Records sharing a key. A record may appear twice, when both of its
+   * addresses or both of its handles are the same. */
+  using Bucket = std::vector<tBTM_SEC_DEV_REC*>;
+
+  template <typename K>
+  static void Insert(std::unordered_map<K, Bucket>& map, const K& key,
+                     tBTM_SEC_DEV_REC* p_dev_rec);
+  template <typename K>
+  static void Erase(std::unordered_map<K, Bucket>& map, const K& key,
+                    tBTM_SEC_DEV_REC* p_dev_rec);
+  template <typename K>
+  tBTM_SEC_DEV_REC* First(const std::unordered_map<K, Bucket>& map,
+                          const K& key) const;
+
+  void IndexKeys(const Keys& keys, tBTM_SEC_DEV_REC* p_dev_rec);
+  void UnindexKeys(const Keys& keys, tBTM_SEC_DEV_REC* p_dev_rec);
+  static Keys KeysOf(const tBTM_SEC_DEV_REC* p_dev_rec, uint64_t order);
+
+  std::unordered_map<tBTM_SEC_DEV_REC*, Keys> keys_;
+  std::unordered_map<RawAddress, Bucket> by_address_;
+  std::unordered_map<RawAddress, Bucket> by_identity_addr_;
+  std::unordered_map<uint16_t, Bucket> by_handle_;
+  uint64_t next_order_ = 0;
+};
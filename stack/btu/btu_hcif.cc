@@ -87,7 +87,7 @@ static void btu_hcif_command_complete_evt(BT_HDR* response, void* context);
 static void btu_hcif_command_status_evt(uint8_t status, BT_HDR* command,
                                         void* context);
 static void btu_hcif_hardware_error_evt(uint8_t* p);
-static void btu_hcif_flush_occured_evt(void);
+static void btu_hcif_flush_occured_evt(uint8_t* p);
 static void btu_hcif_role_change_evt(uint8_t* p);
 static void btu_hcif_num_compl_data_pkts_evt(uint8_t* p, uint8_t evt_len);
 static void btu_hcif_mode_change_evt(uint8_t* p);
@@ -369,7 +369,7 @@ void btu_hcif_process_event(UNUSED_ATTR uint8_t controller_id, BT_HDR* p_msg) {
       btu_hcif_hardware_error_evt(p);
       break;
     case HCI_FLUSH_OCCURED_EVT:
-      btu_hcif_flush_occured_evt();
+      btu_hcif_flush_occured_evt(p);
       break;
     case HCI_ROLE_CHANGE_EVT:
       btu_hcif_role_change_evt(p);
@@ -1727,7 +1727,12 @@ static void btu_hcif_hardware_error_evt(uint8_t* p) {
  * Returns          void
  *
  ******************************************************************************/
-static void btu_hcif_flush_occured_evt(void) {}
+static void btu_hcif_flush_occured_evt(uint8_t* p) {
+  uint16_t handle;
+
+  STREAM_TO_UINT16(handle, p);
+  btm_acl_flush_occurred(handle & HCI_DATA_HANDLE_MASK);
+}
 
 /*******************************************************************************
  *
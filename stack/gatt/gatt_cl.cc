@@ -27,6 +27,7 @@
 #include <string.h>
 #include "bt_common.h"
 #include "bt_utils.h"
+#include "btm_int.h"
 #include "gatt_int.h"
 #include "l2c_int.h"
 #include "log/log.h"
@@ -1015,6 +1016,7 @@ void gatt_process_mtu_rsp(tGATT_TCB& tcb, tGATT_CLCB* p_clcb, uint16_t len,
 
   l2cble_set_fixed_channel_tx_data_length(tcb.peer_bda, L2CAP_ATT_CID,
                                           tcb.payload_size);
+  btm_peer_profile_mtu(tcb.peer_bda, tcb.payload_size);
   gatt_end_operation(p_clcb, status, NULL);
 }
 /*******************************************************************************
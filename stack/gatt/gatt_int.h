@@ -29,7 +29,9 @@
 #include <base/strings/stringprintf.h>
 #include <string.h>
 #include <list>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #define GATT_CREATE_CONN_ID(tcb_idx, gatt_if) \
@@ -263,6 +265,31 @@ typedef struct {
   bool is_primary;
 } tGATT_SRV_LIST_ELEM;
 
+/* Entry of the attribute index of the local server database */
+typedef struct {
+  uint16_t handle;
+  tGATT_ATTR* p_attr;
+  std::list<tGATT_SRV_LIST_ELEM>::iterator srv_it; /* owning service */
+} tGATT_ATTR_INDEX_ELEM;
+
+/* Range of attribute index entries, sorted by handle */
+typedef std::pair<const tGATT_ATTR_INDEX_ELEM*, const tGATT_ATTR_INDEX_ELEM*>
+    tGATT_ATTR_INDEX_RANGE;
+
+/* Handle sorted index over the attributes of all started services, rebuilt
+ * whenever a service is started or stopped */
+typedef struct {
+  /* started services, sorted by start handle */
+  std::vector<std::list<tGATT_SRV_LIST_ELEM>::iterator> services;
+  /* attributes of all started services */
+  std::vector<tGATT_ATTR_INDEX_ELEM> attrs;
+  /* position in attrs + 1 by attribute handle, 0 if not in use */
+  std::vector<uint16_t> attr_pos_by_handle;
+  /* attributes of all started services, per attribute type */
+  std::unordered_map<bluetooth::Uuid, std::vector<tGATT_ATTR_INDEX_ELEM>>
+      attrs_by_type;
+} tGATT_ATTR_INDEX;
+
 typedef struct {
   std::queue<tGATT_CLCB*> pending_enc_clcb; /* pending encryption channel q */
   tGATT_SEC_ACTION sec_act;
@@ -475,6 +502,13 @@ extern bool gatt_auto_connect_dev_remove(tGATT_IF gatt_if,
 /* server function */
 extern std::list<tGATT_SRV_LIST_ELEM>::iterator gatt_sr_find_i_rcb_by_handle(
     uint16_t handle);
+extern void gatt_sr_rebuild_attr_index(void);
+extern const tGATT_ATTR_INDEX_ELEM* gatt_sr_find_attr_by_handle(
+    uint16_t handle);
+extern tGATT_ATTR_INDEX_RANGE gatt_sr_find_attrs(uint16_t s_handle,
+                                                 uint16_t e_handle);
+extern tGATT_ATTR_INDEX_RANGE gatt_sr_find_attrs_by_type(
+    const bluetooth::Uuid& type, uint16_t s_handle, uint16_t e_handle);
 extern tGATT_STATUS gatt_sr_process_app_rsp(tGATT_TCB& tcb, tGATT_IF gatt_if,
                                             uint32_t trans_id, uint8_t op_code,
                                             tGATT_STATUS status,
@@ -557,10 +591,10 @@ extern uint16_t gatts_add_characteristic(tGATT_SVC_DB& db, tGATT_PERM perm,
 extern uint16_t gatts_add_char_descr(tGATT_SVC_DB& db, tGATT_PERM perm,
                                      const bluetooth::Uuid& dscp_uuid);
 extern tGATT_STATUS gatts_db_read_attr_value_by_type(
-    tGATT_TCB& tcb, tGATT_SVC_DB* p_db, uint8_t op_code, BT_HDR* p_rsp,
-    uint16_t s_handle, uint16_t e_handle, const bluetooth::Uuid& type,
-    uint16_t* p_len, tGATT_SEC_FLAG sec_flag, uint8_t key_size,
-    uint32_t trans_id, uint16_t* p_cur_handle);
+    tGATT_TCB& tcb, uint8_t op_code, BT_HDR* p_rsp, uint16_t s_handle,
+    uint16_t e_handle, const bluetooth::Uuid& type, uint16_t* p_len,
+    tGATT_SEC_FLAG sec_flag, uint8_t key_size, uint32_t trans_id,
+    uint16_t* p_cur_handle);
 extern tGATT_STATUS gatts_read_attr_value_by_handle(
     tGATT_TCB& tcb, tGATT_SVC_DB* p_db, uint8_t op_code, uint16_t handle,
     uint16_t offset, uint8_t* p_value, uint16_t* p_len, uint16_t mtu,
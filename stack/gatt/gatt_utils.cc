@@ -26,6 +26,7 @@
 #include "osi/include/osi.h"
 
 #include <string.h>
+#include <algorithm>
 #include "bt_common.h"
 #include "stdio.h"
 
@@ -41,6 +42,9 @@
 using base::StringPrintf;
 using bluetooth::Uuid;
 
+/* attribute index of the started services, see gatt_sr_rebuild_attr_index */
+static tGATT_ATTR_INDEX gatt_sr_attr_index;
+
 /* check if [x, y] and [a, b] have overlapping range */
 #define GATT_VALIDATE_HANDLE_RANGE(x, y, a, b) ((y) >= (a) && (x) <= (b))
 
@@ -662,15 +666,156 @@ void gatt_ind_ack_timeout(void* data) {
  ******************************************************************************/
 std::list<tGATT_SRV_LIST_ELEM>::iterator gatt_sr_find_i_rcb_by_handle(
     uint16_t handle) {
-  auto it = gatt_cb.srv_list_info->begin();
+  const auto& services = gatt_sr_attr_index.services;
 
-  for (; it != gatt_cb.srv_list_info->end(); it++) {
-    if (it->s_hdl <= handle && it->e_hdl >= handle) {
-      return it;
+  /* last service starting at or before handle */
+  auto it = std::upper_bound(
+      services.begin(), services.end(), handle,
+      [](uint16_t handle, const std::list<tGATT_SRV_LIST_ELEM>::iterator& srv) {
+        return handle < srv->s_hdl;
+      });
+  if (it == services.begin()) return gatt_cb.srv_list_info->end();
+
+  --it;
+  if ((*it)->e_hdl < handle) return gatt_cb.srv_list_info->end();
+
+  return *it;
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_rebuild_attr_index
+ *
+ * Description      Rebuild the attribute index from the list of started
+ *                  services. Must be called whenever srv_list_info changes.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void gatt_sr_rebuild_attr_index(void) {
+  tGATT_ATTR_INDEX& index = gatt_sr_attr_index;
+
+  index.services.clear();
+  index.attrs.clear();
+  index.attr_pos_by_handle.clear();
+  index.attrs_by_type.clear();
+
+  if (!gatt_cb.srv_list_info) return;
+
+  for (auto it = gatt_cb.srv_list_info->begin();
+       it != gatt_cb.srv_list_info->end(); it++) {
+    index.services.push_back(it);
+    if (!it->p_db) continue;
+
+    for (tGATT_ATTR& attr : it->p_db->attr_list) {
+      index.attrs.push_back({attr.handle, &attr, it});
     }
   }
 
-  return it;
+  /* services are kept in handle order, this only guards against overlaps */
+  std::stable_sort(index.services.begin(), index.services.end(),
+                   [](const std::list<tGATT_SRV_LIST_ELEM>::iterator& a,
+                      const std::list<tGATT_SRV_LIST_ELEM>::iterator& b) {
+                     return a->s_hdl < b->s_hdl;
+                   });
+  std::stable_sort(
+      index.attrs.begin(), index.attrs.end(),
+      [](const tGATT_ATTR_INDEX_ELEM& a, const tGATT_ATTR_INDEX_ELEM& b) {
+        return a.handle < b.handle;
+      });
+
+  /* handles are allocated densely from 1, so a direct table stays small */
+  if (!index.attrs.empty()) {
+    index.attr_pos_by_handle.assign(index.attrs.back().handle + 1, 0);
+  }
+  for (size_t i = 0; i < index.attrs.size(); i++) {
+    const tGATT_ATTR_INDEX_ELEM& el = index.attrs[i];
+    index.attr_pos_by_handle[el.handle] = i + 1;
+    index.attrs_by_type[el.p_attr->uuid].push_back(el);
+  }
+
+  VLOG(1) << __func__ << ": services=" << index.services.size()
+          << ", attributes=" << index.attrs.size()
+          << ", types=" << index.attrs_by_type.size();
+}
+
+static tGATT_ATTR_INDEX_RANGE gatt_sr_attr_index_range(
+    const std::vector<tGATT_ATTR_INDEX_ELEM>& attrs, uint16_t s_handle,
+    uint16_t e_handle) {
+  const tGATT_ATTR_INDEX_ELEM* begin = attrs.data();
+  const tGATT_ATTR_INDEX_ELEM* end = attrs.data() + attrs.size();
+
+  const tGATT_ATTR_INDEX_ELEM* first = std::lower_bound(
+      begin, end, s_handle,
+      [](const tGATT_ATTR_INDEX_ELEM& el, uint16_t handle) {
+        return el.handle < handle;
+      });
+  if (e_handle < s_handle) return std::make_pair(first, first);
+
+  const tGATT_ATTR_INDEX_ELEM* last = std::upper_bound(
+      first, end, e_handle,
+      [](uint16_t handle, const tGATT_ATTR_INDEX_ELEM& el) {
+        return handle < el.handle;
+      });
+
+  return std::make_pair(first, last);
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_find_attr_by_handle
+ *
+ * Description      Find an attribute of a started service by its handle.
+ *
+ * Returns          index entry of the attribute, nullptr if not found.
+ *
+ ******************************************************************************/
+const tGATT_ATTR_INDEX_ELEM* gatt_sr_find_attr_by_handle(uint16_t handle) {
+  const tGATT_ATTR_INDEX& index = gatt_sr_attr_index;
+
+  if (handle >= index.attr_pos_by_handle.size()) return nullptr;
+
+  uint16_t pos = index.attr_pos_by_handle[handle];
+  if (pos == 0) return nullptr;
+
+  return &index.attrs[pos - 1];
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_find_attrs
+ *
+ * Description      Find all attributes of started services with handle in
+ *                  [s_handle, e_handle].
+ *
+ * Returns          range of index entries, sorted by handle.
+ *
+ ******************************************************************************/
+tGATT_ATTR_INDEX_RANGE gatt_sr_find_attrs(uint16_t s_handle,
+                                          uint16_t e_handle) {
+  return gatt_sr_attr_index_range(gatt_sr_attr_index.attrs, s_handle,
+                                  e_handle);
+}
+
+/*******************************************************************************
+ *
+ * Function         gatt_sr_find_attrs_by_type
+ *
+ * Description      Find all attributes of type |type| of started services
+ *                  with handle in [s_handle, e_handle].
+ *
+ * Returns          range of index entries, sorted by handle.
+ *
+ ******************************************************************************/
+tGATT_ATTR_INDEX_RANGE gatt_sr_find_attrs_by_type(const Uuid& type,
+                                                  uint16_t s_handle,
+                                                  uint16_t e_handle) {
+  auto it = gatt_sr_attr_index.attrs_by_type.find(type);
+  if (it == gatt_sr_attr_index.attrs_by_type.end()) {
+    return tGATT_ATTR_INDEX_RANGE(nullptr, nullptr);
+  }
+
+  return gatt_sr_attr_index_range(it->second, s_handle, e_handle);
 }
 
 /*******************************************************************************
@@ -77,4 +77,10 @@ uint64_t a2dp_aac_get_encoder_interval_ms(void);
 // |timestamp_us| is the current timestamp (in microseconds).
 void a2dp_aac_send_frames(uint64_t timestamp_us);
 
+// Set the link state for the AAC adaptive bitrate.
+void a2dp_aac_set_link_quality(const tA2DP_LINK_QUALITY* p_link_quality);
+
+// Get the AAC adaptive bitrate level the stream spent the most time at.
+int a2dp_aac_get_settled_link_quality_level(void);
+
 #endif  // A2DP_AAC_ENCODER_H
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//
+// Adaptive bitrate for the A2DP encoders without one of their own (SBC, AAC)
+//
+
+#ifndef A2DP_ABR_H
+#define A2DP_ABR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// State of the link sampled by the A2DP Source at every encoder tick.
+typedef struct {
+  // Number of encoded packets waiting in the Source TX queue.
+  size_t tx_queue_length;
+  // Number of times the AV data path found L2CAP still busy with earlier
+  // media packets, since AV was enabled.
+  uint32_t l2cap_stall_count;
+  // Number of packets the controller flushed on the ACL link after failing to
+  // deliver them, since the link was established.
+  uint32_t flush_count;
+} tA2DP_LINK_QUALITY;
+
+// Property turning the adaptive bitrate of SBC and AAC off when false.
+#define A2DP_ABR_ENABLED_PROP "persist.bluetooth.a2dp_abr.enabled"
+
+// Number of encoder quality levels. The top level is the bitrate the codec
+// was configured with.
+#define A2DP_ABR_NUM_LEVELS 4
+
+// Controller choosing the encoder quality level from the link state.
+// It steps down one level as soon as the link falls behind, and steps back up
+// only once the link stayed clear for a while; a step up the link could not
+// sustain makes it wait twice as long before the next attempt.
+//
+// Kept trivially copyable: it lives in the memset() encoder control blocks,
+// and Init() must be called before use.
+class A2dpAbr {
+ public:
+  // Resets the controller to |start_level|, the top level by default.
+  // |enabled| false keeps the top level but still counts the link events.
+  // |interval_ms| is the encoder interval, for the statistics.
+  void Init(bool enabled, uint64_t interval_ms,
+            int start_level = A2DP_ABR_NUM_LEVELS - 1);
+
+  // Feeds the link state of one encoder tick.
+  // Returns true if the level changed and the encoder has to be updated.
+  bool Update(const tA2DP_LINK_QUALITY& link_quality);
+
+  // Current quality level, from 0 to A2DP_ABR_NUM_LEVELS - 1.
+  int Level() const { return level_; }
+
+  // Percent of the configured bitrate to encode at, for the current level.
+  int BitratePercent() const { return BitratePercent(level_); }
+  static int BitratePercent(int level);
+
+  // Level the encoder spent the most time at since Init(), the current level
+  // before the first tick.
+  int SettledLevel() const;
+
+  // Dumps the controller state and statistics.
+  void Dump(int fd) const;
+
+ private:
+  void StepTo(int level, const char* reason,
+              const tA2DP_LINK_QUALITY& link_quality);
+
+  bool enabled_;
+  uint64_t interval_ms_;
+  int level_;
+
+  // Link counters seen on the previous tick
+  bool has_last_sample_;
+  uint32_t last_l2cap_stall_count_;
+  uint32_t last_flush_count_;
+
+  // Ticks since the last level change, and consecutive clear ticks
+  uint32_t ticks_since_change_;
+  uint32_t clear_ticks_;
+  // Clear ticks required before the next step up
+  uint32_t up_wait_ticks_;
+  bool last_change_was_up_;
+
+  // Statistics
+  size_t steps_down_;
+  size_t steps_up_;
+  size_t congested_ticks_;
+  uint64_t ticks_at_level_[A2DP_ABR_NUM_LEVELS];
+};
+
+#endif  // A2DP_ABR_H
@@ -31,6 +31,7 @@
 
 #include <hardware/bt_av.h>
 
+#include "a2dp_abr.h"
 #include "a2dp_api.h"
 #include "audio_a2dp_hw/include/audio_a2dp_hw.h"
 #include "avdt_api.h"
@@ -44,6 +45,8 @@ typedef struct {
   bool is_peer_edr;          // True if the A2DP peer supports EDR
   bool peer_supports_3mbps;  // True if the A2DP peer supports 3 Mbps EDR
   uint16_t peer_mtu;         // MTU of the A2DP peer
+  // Adaptive bitrate level to start at: the level the peer settled on before
+  int abr_start_level;
 } tA2DP_ENCODER_INIT_PEER_PARAMS;
 
 class A2dpCodecConfig {
@@ -538,6 +541,14 @@ typedef struct {
 
   // Set transmit queue length for the A2DP encoder.
   void (*set_transmit_queue_length)(size_t transmit_queue_length);
+
+  // Set the link state sampled before sending the frames of an encoder tick,
+  // for encoders adapting their bitrate to it.
+  void (*set_link_quality)(const tA2DP_LINK_QUALITY* p_link_quality);
+
+  // Get the adaptive bitrate level the encoder spent the most time at, to
+  // start the next stream to the peer from.
+  int (*get_settled_link_quality_level)(void);
 } tA2DP_ENCODER_INTERFACE;
 
 // Prototype for a callback to receive decoded audio data from a
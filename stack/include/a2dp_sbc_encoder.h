@@ -59,6 +59,12 @@ uint64_t a2dp_sbc_get_encoder_interval_ms(void);
 // |timestamp_us| is the current timestamp (in microseconds).
 void a2dp_sbc_send_frames(uint64_t timestamp_us);
 
+// Set the link state for the SBC adaptive bitpool.
+void a2dp_sbc_set_link_quality(const tA2DP_LINK_QUALITY* p_link_quality);
+
+// Get the SBC adaptive bitpool level the stream spent the most time at.
+int a2dp_sbc_get_settled_link_quality_level(void);
+
 // Get SBC bitrate
 // Returns |uint32_t| bitrate in bits per second
 uint32_t a2dp_sbc_get_bitrate();
@@ -45,8 +45,10 @@ class AdvertiseDataParser {
   }
 
  public:
-  static void RemoveTrailingZeros(std::vector<uint8_t>& ad) {
-    size_t position = 0;
+  /* Cuts the zero padding of the advertising data starting at |position| of
+   * |ad|, the data before it being left untouched. */
+  static void RemoveTrailingZeros(std::vector<uint8_t>& ad,
+                                  size_t position = 0) {
 
     size_t ad_len = ad.size();
     while (position != ad_len) {
@@ -301,9 +301,14 @@ extern tBNEP_RESULT BNEP_Disconnect(uint16_t handle);
  *                  BNEP_MTU_EXCEDED        - If the data length is greater
  *                                            than MTU
  *                  BNEP_IGNORE_CMD         - If the packet is filtered out
- *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full
+ *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full, the
+ *                                            buffer is not freed: the caller
+ *                                            still owns it, and frees it or
+ *                                            writes it again later
  *                  BNEP_SUCCESS            - If written successfully
  *
+ *                  The buffer is freed by BNEP on every other return.
+ *
  ******************************************************************************/
 extern tBNEP_RESULT BNEP_WriteBuf(uint16_t handle,
                                   const RawAddress& p_dest_addr, BT_HDR* p_buf,
@@ -330,10 +335,15 @@ extern tBNEP_RESULT BNEP_WriteBuf(uint16_t handle,
  *                  BNEP_MTU_EXCEDED        - If the data length is greater than
  *                                            the MTU
  *                  BNEP_IGNORE_CMD         - If the packet is filtered out
- *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full
+ *                  BNEP_Q_SIZE_EXCEEDED    - If the Tx Q is full, nothing
+ *                                            is copied and the caller may
+ *                                            write the data again later
  *                  BNEP_NO_RESOURCES       - If not able to allocate a buffer
  *                  BNEP_SUCCESS            - If written successfully
  *
+ *                  The data is copied, it always remains owned by the
+ *                  caller.
+ *
  ******************************************************************************/
 extern tBNEP_RESULT BNEP_Write(uint16_t handle, const RawAddress& p_dest_addr,
                                uint8_t* p_data, uint16_t len, uint16_t protocol,
@@ -750,6 +750,19 @@ extern tBTM_STATUS BTM_ReadRSSI(const RawAddress& remote_bda,
 extern tBTM_STATUS BTM_ReadFailedContactCounter(const RawAddress& remote_bda,
                                                 tBTM_CMPL_CB* p_cb);
 
+/*******************************************************************************
+ *
+ * Function         BTM_GetAclFlushCount
+ *
+ * Description      This function returns the number of packets the controller
+ *                  flushed on the BR/EDR ACL link to a peer, counted from the
+ *                  Flush Occurred events since the link was established.
+ *
+ * Returns          the count, or 0 if there is no link to the peer
+ *
+ ******************************************************************************/
+extern uint32_t BTM_GetAclFlushCount(const RawAddress& remote_bda);
+
 /*******************************************************************************
  *
  * Function         BTM_ReadAutomaticFlushTimeout
@@ -946,6 +959,108 @@ extern void BTM_EScoConnRsp(uint16_t sco_inx, uint8_t hci_status,
  ******************************************************************************/
 extern uint8_t BTM_GetNumScoLinks(void);
 
+/*******************************************************************************
+ *
+ * Function         BTM_WriteScoData
+ *
+ * Description      This function writes SCO data to a specified instance. The
+ *                  data to be written p_buf needs to carry an offset of
+ *                  HCI_SCO_PREAMBLE_SIZE bytes, and the data length can not
+ *                  exceed BTM_SCO_DATA_SIZE_MAX bytes. Data longer than the
+ *                  maximum bytes will be truncated. p_buf is freed by the
+ *                  stack.
+ *
+ * Returns          BTM_SUCCESS, BTM_SCO_BAD_LENGTH if the data was truncated,
+ *                  BTM_ILLEGAL_VALUE for an offset too small, or
+ *                  BTM_UNKNOWN_ADDR if the SCO is not connected or not routed
+ *                  via HCI.
+ *
+ ******************************************************************************/
+extern tBTM_STATUS BTM_WriteScoData(uint16_t sco_inx, BT_HDR* p_buf);
+
+/*******************************************************************************
+ *
+ * Function         BTM_ReadScoPcm
+ *
+ * Description      This function reads the audio received on the SCO
+ *                  connection routed over HCI: |num_samples| samples of 16 bit
+ *                  mono PCM at BTM_GetScoPcmSampleRate(), padded with silence.
+ *                  It can be called from the audio thread.
+ *
+ * Returns          The number of samples received
+ *
+ ******************************************************************************/
+extern uint32_t BTM_ReadScoPcm(int16_t* pcm, uint32_t num_samples);
+
+/*******************************************************************************
+ *
+ * Function         BTM_WriteScoPcm
+ *
+ * Description      This function queues |num_samples| samples of 16 bit mono
+ *                  PCM at BTM_GetScoPcmSampleRate() to send on the SCO
+ *                  connection routed over HCI. It can be called from the
+ *                  audio thread.
+ *
+ * Returns          The number of samples queued, 0 without SCO audio over HCI
+ *
+ ******************************************************************************/
+extern uint32_t BTM_WriteScoPcm(const int16_t* pcm, uint32_t num_samples);
+
+/*******************************************************************************
+ *
+ * Function         BTM_GetScoPcmSampleRate
+ *
+ * Description      This function returns the sample rate of the audio of the
+ *                  SCO connection routed over HCI: 8000 for CVSD, 16000 for
+ *                  mSBC.
+ *
+ * Returns          The sample rate in Hz
+ *
+ ******************************************************************************/
+extern uint32_t BTM_GetScoPcmSampleRate(void);
+
+/**
+ * Dump debug-related information for the SCO audio routed over HCI.
+ *
+ * @param fd the file descriptor to use for writing the ASCII formatted
+ * information
+ */
+void stack_debug_sco_dump(int fd);
+
+/*******************************************************************************
+ *
+ * Function         BTM_GetPeerA2dpAbrLevel
+ *
+ * Description      This function returns the A2DP adaptive bitrate level the
+ *                  streams to the peer settled on before, to start the next
+ *                  one at.
+ *
+ * Returns          true if a level was learned
+ *
+ ******************************************************************************/
+extern bool BTM_GetPeerA2dpAbrLevel(const RawAddress& bd_addr,
+                                    uint8_t* p_level);
+
+/*******************************************************************************
+ *
+ * Function         BTM_SetPeerA2dpAbrLevel
+ *
+ * Description      This function records the A2DP adaptive bitrate level a
+ *                  stream to the peer settled on.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void BTM_SetPeerA2dpAbrLevel(const RawAddress& bd_addr, uint8_t level);
+
+/**
+ * Dump debug-related information for the link parameters learned per peer.
+ *
+ * @param fd the file descriptor to use for writing the ASCII formatted
+ * information
+ */
+void stack_debug_peer_profile_dump(int fd);
+
 /*****************************************************************************
  *  SECURITY MANAGEMENT FUNCTIONS
  ****************************************************************************/
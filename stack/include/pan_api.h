@@ -309,8 +309,9 @@ extern tPAN_RESULT PAN_Disconnect(uint16_t handle);
  *                  on GN or NAP side and the packet is multicast or broadcast
  *                  it will be sent on all the links. Otherwise the correct link
  *                  is found based on the destination address and forwarded on
- *                  it. If the return value is not PAN_SUCCESS the application
- *                  should take care of releasing the message buffer
+ *                  it. If the return value is PAN_Q_SIZE_EXCEEDED, the
+ *                  application should take care of releasing or resending the
+ *                  message buffer; it is released on every other return.
  *
  * Parameters:      dst      - MAC or BD Addr of the destination device
  *                  src      - MAC or BD Addr of the source who sent this packet
@@ -336,8 +337,9 @@ extern tPAN_RESULT PAN_Write(uint16_t handle, const RawAddress& dst,
  *                  on GN or NAP side and the packet is multicast or broadcast
  *                  it will be sent on all the links. Otherwise the correct link
  *                  is found based on the destination address and forwarded on
- *                  it. If the return value is not PAN_SUCCESS the application
- *                  should take care of releasing the message buffer
+ *                  it. If the return value is PAN_Q_SIZE_EXCEEDED, the
+ *                  application should take care of releasing or resending the
+ *                  message buffer; it is released on every other return.
  *
  * Parameters:      dst      - MAC or BD Addr of the destination device
  *                  src      - MAC or BD Addr of the source who sent this packet
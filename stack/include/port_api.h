@@ -422,4 +422,16 @@ extern uint8_t PORT_SetTraceLevel(uint8_t new_level);
  ******************************************************************************/
 extern const char* PORT_GetResultString(const uint8_t result_code);
 
+/*******************************************************************************
+ *
+ * Function         stack_debug_rfcomm_dump
+ *
+ * Description      This function dumps the flow control state and the data
+ *                  transfer statistics of the RFCOMM ports.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void stack_debug_rfcomm_dump(int fd);
+
 #endif /* PORT_API_H */
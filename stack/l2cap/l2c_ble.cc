@@ -306,6 +306,7 @@ void l2cble_conn_comp(uint16_t handle, uint8_t role, const RawAddress& bda,
 
   /* update link parameter, set slave link as non-spec default upon link up */
   p_lcb->min_interval = p_lcb->max_interval = conn_interval;
+  p_lcb->conn_interval = conn_interval;
   p_lcb->timeout = conn_timeout;
   p_lcb->latency = conn_latency;
   p_lcb->conn_update_mask = L2C_BLE_NOT_DEFAULT_PARAM;
@@ -448,6 +449,10 @@ void l2cble_process_conn_update_evt(uint16_t handle, uint8_t status,
 
   if (status != HCI_SUCCESS) {
     L2CAP_TRACE_WARNING("%s: Error status: %d", __func__, status);
+  } else {
+    p_lcb->conn_interval = interval;
+    btm_peer_profile_conn_params(p_lcb->remote_bd_addr, interval, latency,
+                                 timeout);
   }
 
   l2cble_start_conn_update(p_lcb);
@@ -1001,7 +1006,10 @@ void l2cble_process_data_length_change_event(uint16_t handle,
   L2CAP_TRACE_DEBUG("%s TX data len = %d", __func__, tx_data_len);
   if (p_lcb == NULL) return;
 
-  if (tx_data_len > 0) p_lcb->tx_data_len = tx_data_len;
+  if (tx_data_len > 0) {
+    p_lcb->tx_data_len = tx_data_len;
+    btm_peer_profile_data_length(p_lcb->remote_bd_addr, tx_data_len);
+  }
 
   /* ignore rx_data len for now */
 }
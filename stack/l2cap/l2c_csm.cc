@@ -1130,6 +1130,12 @@ static void l2c_csm_open(tL2C_CCB* p_ccb, uint16_t event, void* p_data) {
         l2cble_send_peer_disc_req(p_ccb);
       } else {
         p_ccb->peer_conn_cfg.credits += *credit;
+        if (p_ccb->le_credit.tx_stall_start_us != 0) {
+          p_ccb->le_credit.tx_stall_us +=
+              bluetooth::common::time_get_os_boottime_us() -
+              p_ccb->le_credit.tx_stall_start_us;
+          p_ccb->le_credit.tx_stall_start_us = 0;
+        }
 
         tL2CA_CREDITS_RECEIVED_CB* cr_cb =
             p_ccb->p_rcb->api.pL2CA_CreditsReceived_Cb;
@@ -95,11 +95,46 @@ static void prepare_I_frame(tL2C_CCB* p_ccb, BT_HDR* p_buf,
 static void process_stream_frame(tL2C_CCB* p_ccb, BT_HDR* p_buf);
 static bool do_sar_reassembly(tL2C_CCB* p_ccb, BT_HDR* p_buf,
                               uint16_t ctrl_word);
+static void l2c_lcc_return_credits(tL2C_CCB* p_ccb);
 
 #if (L2CAP_ERTM_STATS == TRUE)
 static void l2c_fcr_collect_ack_delay(tL2C_CCB* p_ccb, uint8_t num_bufs_acked);
 #endif
 
+/*******************************************************************************
+ *
+ * Function         wack_push
+ *
+ * Description      Adds an I-frame that was just sent to the frames waiting
+ *                  for an ack. Frames are sent in sequence, so its TxSeq
+ *                  follows the one of the newest waiting frame.
+ *
+ * Returns          -
+ *
+ ******************************************************************************/
+static void wack_push(tL2C_FCRB* p_fcrb, BT_HDR* p_buf) {
+  uint8_t tx_seq = (p_fcrb->last_rx_ack + p_fcrb->num_waiting_for_ack) &
+                   L2CAP_FCR_SEQ_MODULO;
+  p_fcrb->waiting_for_ack[tx_seq] = p_buf;
+  p_fcrb->num_waiting_for_ack++;
+}
+
+/*******************************************************************************
+ *
+ * Function         wack_find
+ *
+ * Description      Looks up the I-frame with sequence number |tx_seq| in the
+ *                  frames waiting for an ack.
+ *
+ * Returns          pointer to the frame, or NULL if it is not waiting
+ *
+ ******************************************************************************/
+static BT_HDR* wack_find(tL2C_FCRB* p_fcrb, uint8_t tx_seq) {
+  uint8_t index = (tx_seq - p_fcrb->last_rx_ack) & L2CAP_FCR_SEQ_MODULO;
+  if (index >= p_fcrb->num_waiting_for_ack) return NULL;
+  return p_fcrb->waiting_for_ack[tx_seq & L2CAP_FCR_SEQ_MODULO];
+}
+
 /*******************************************************************************
  *
  * Function         l2c_fcr_updcrc
@@ -218,8 +253,11 @@ void l2c_fcr_cleanup(tL2C_CCB* p_ccb) {
 
   osi_free_and_reset((void**)&p_fcrb->p_rx_sdu);
 
-  fixed_queue_free(p_fcrb->waiting_for_ack_q, osi_free);
-  p_fcrb->waiting_for_ack_q = NULL;
+  for (uint8_t xx = 0; xx < p_fcrb->num_waiting_for_ack; xx++) {
+    osi_free(p_fcrb->waiting_for_ack[(p_fcrb->last_rx_ack + xx) &
+                                     L2CAP_FCR_SEQ_MODULO]);
+  }
+  p_fcrb->num_waiting_for_ack = 0;
 
   fixed_queue_free(p_fcrb->srej_rcv_hold_q, osi_free);
   p_fcrb->srej_rcv_hold_q = NULL;
@@ -227,6 +265,29 @@ void l2c_fcr_cleanup(tL2C_CCB* p_ccb) {
   fixed_queue_free(p_fcrb->retrans_q, osi_free);
   p_fcrb->retrans_q = NULL;
 
+  osi_free_and_reset((void**)&p_ccb->ble_sdu);
+
+  if ((p_ccb->local_cid >= L2CAP_BASE_APPL_CID) &&
+      (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_LE_COC_MODE) &&
+      (p_ccb->le_credit.open_us != 0)) {
+    tL2C_LE_CREDIT* p_lec = &p_ccb->le_credit;
+    uint64_t dur = bluetooth::common::time_get_os_boottime_us() -
+                   p_lec->open_us;
+    L2CAP_TRACE_EVENT(
+        "LE CoC stats CID: 0x%04x duration: %ums window: %d rx frames: %u "
+        "rx stalls: %u credit pdus: %u credits returned: %u",
+        p_ccb->local_cid, (uint32_t)(dur / 1000), p_lec->window,
+        p_lec->rx_frames, p_lec->rx_stalls, p_lec->credit_pdus,
+        p_lec->credits_returned);
+    L2CAP_TRACE_EVENT(
+        "LE CoC stats CID: 0x%04x tx stalls: %u stalled: %ums sdus in place: "
+        "%u sdus copied: %u",
+        p_ccb->local_cid, p_lec->tx_stalls,
+        (uint32_t)(p_lec->tx_stall_us / 1000), p_lec->sdus_in_place,
+        p_lec->sdus_copied);
+    p_lec->open_us = 0;
+  }
+
 #if (L2CAP_ERTM_STATS == TRUE)
   if ((p_ccb->local_cid >= L2CAP_BASE_APPL_CID) &&
       (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE)) {
@@ -377,8 +438,7 @@ bool l2c_fcr_is_flow_controlled(tL2C_CCB* p_ccb) {
   if (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE) {
     /* Check if remote side flowed us off or the transmit window is full */
     if ((p_ccb->fcrb.remote_busy) ||
-        (fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q) >=
-         p_ccb->peer_cfg.fcr.tx_win_sz)) {
+        (p_ccb->fcrb.num_waiting_for_ack >= p_ccb->peer_cfg.fcr.tx_win_sz)) {
 #if (L2CAP_ERTM_STATS == TRUE)
       if (!fixed_queue_is_empty(p_ccb->xmit_hold_q)) {
         p_ccb->fcrb.xmit_window_closed++;
@@ -664,7 +724,7 @@ void l2c_fcr_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
       "%u, wt_q.cnt %u, tries %u",
       p_ccb->fcrb.next_tx_seq, p_ccb->fcrb.last_rx_ack,
       p_ccb->fcrb.next_seq_expected, p_ccb->fcrb.last_ack_sent,
-      fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q), p_ccb->fcrb.num_tries);
+      p_ccb->fcrb.num_waiting_for_ack, p_ccb->fcrb.num_tries);
 
   /* Verify FCS if using */
   if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) {
@@ -723,8 +783,7 @@ void l2c_fcr_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
     /* P and F are mutually exclusive */
     if (ctrl_word & L2CAP_FCR_S_FRAME_BIT) ctrl_word &= ~L2CAP_FCR_P_BIT;
 
-    if (fixed_queue_is_empty(p_ccb->fcrb.waiting_for_ack_q))
-      p_ccb->fcrb.num_tries = 0;
+    if (p_ccb->fcrb.num_waiting_for_ack == 0) p_ccb->fcrb.num_tries = 0;
 
     l2c_fcr_stop_timer(p_ccb);
   } else {
@@ -813,7 +872,8 @@ void l2c_fcr_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
  * Function         l2c_lcc_proc_pdu
  *
  * Description      This function is the entry point for processing of a
- *                  received PDU when in LE Coc flow control modes.
+ *                  received PDU when in LE Coc flow control modes. Credits
+ *                  are only given back for the PDUs accepted.
  *
  * Returns          -
  *
@@ -825,6 +885,10 @@ void l2c_lcc_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
   uint16_t sdu_length;
   BT_HDR* p_data = NULL;
 
+  /* The remote device has one less credit left, whatever the PDU holds */
+  if (p_ccb->remote_credit_count > 0) --p_ccb->remote_credit_count;
+  if (p_ccb->remote_credit_count == 0) p_ccb->le_credit.rx_stalls++;
+
   /* Buffer length should not exceed local mps */
   if (p_buf->len > p_ccb->local_conn_cfg.mps) {
     /* Discard the buffer */
@@ -861,6 +925,16 @@ void l2c_lcc_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
       return;
     }
 
+    if (sdu_length == p_buf->len) {
+      /* The whole SDU is in this K-frame, hand it up without a copy. Credits
+       * go out first, the upper layer may close the channel from its data
+       * callback. */
+      p_ccb->le_credit.sdus_in_place++;
+      l2c_lcc_return_credits(p_ccb);
+      l2c_csm_execute(p_ccb, L2CEVT_L2CAP_DATA, p_buf);
+      return;
+    }
+
     p_data = (BT_HDR*)osi_malloc(BT_HDR_SIZE + sdu_length);
     if (p_data == NULL) {
       osi_free(p_buf);
@@ -892,11 +966,14 @@ void l2c_lcc_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
     }
   }
 
+  l2c_lcc_return_credits(p_ccb);
+
   memcpy((uint8_t*)(p_data + 1) + p_data->offset + p_data->len,
          (uint8_t*)(p_buf + 1) + p_buf->offset, p_buf->len);
   p_data->len += p_buf->len;
   p = (uint8_t*)(p_data + 1) + p_data->offset;
   if (p_data->len == p_ccb->ble_sdu_length) {
+    p_ccb->le_credit.sdus_copied++;
     l2c_csm_execute(p_ccb, L2CEVT_L2CAP_DATA, p_data);
     p_ccb->is_first_seg = true;
     p_ccb->ble_sdu = NULL;
@@ -909,6 +986,111 @@ void l2c_lcc_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
   return;
 }
 
+/* Largest receive window the memory budget allows for the local MPS */
+static uint16_t l2c_lcc_max_window(tL2C_CCB* p_ccb) {
+  uint32_t mps = std::max(p_ccb->local_conn_cfg.mps, L2CAP_LE_MIN_MPS);
+  uint32_t window = std::max<uint32_t>(L2CAP_LE_CREDIT_RX_BUDGET / mps,
+                                       L2CAP_LE_CREDIT_MIN_WINDOW);
+  return std::min<uint32_t>(window, L2CAP_LE_CREDIT_MAX);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_lcc_init_credits
+ *
+ * Description      This function sets up the receive window of a LE CoC
+ *                  channel once the local configuration is known. The initial
+ *                  credits are capped by the memory budget.
+ *
+ * Returns          -
+ *
+ ******************************************************************************/
+void l2c_lcc_init_credits(tL2C_CCB* p_ccb) {
+  CHECK(p_ccb != NULL);
+  tL2C_LE_CREDIT* p_lec = &p_ccb->le_credit;
+
+  uint16_t max_window = l2c_lcc_max_window(p_ccb);
+  if (p_ccb->local_conn_cfg.credits > max_window) {
+    L2CAP_TRACE_DEBUG("%s: CID 0x%04x initial credits %d capped to %d",
+                      __func__, p_ccb->local_cid,
+                      p_ccb->local_conn_cfg.credits, max_window);
+    p_ccb->local_conn_cfg.credits = max_window;
+  }
+  p_ccb->remote_credit_count = p_ccb->local_conn_cfg.credits;
+
+  memset(p_lec, 0, sizeof(tL2C_LE_CREDIT));
+  p_lec->window = std::max(p_ccb->local_conn_cfg.credits,
+                           L2CAP_LE_CREDIT_MIN_WINDOW);
+  p_lec->open_us = bluetooth::common::time_get_os_boottime_us();
+  p_lec->rate_start_us = p_lec->open_us;
+}
+
+/* Resizes the receive window to the rate |frames| were received at over the
+ * last |elapsed_us|. The window covers the credit round trip twice, so that
+ * returning credits when half of them are used never starves the remote. */
+static void l2c_lcc_update_window(tL2C_CCB* p_ccb, uint32_t frames,
+                                  uint64_t elapsed_us) {
+  tL2C_LE_CREDIT* p_lec = &p_ccb->le_credit;
+  uint16_t interval =
+      std::max<uint16_t>(p_ccb->p_lcb->conn_interval, BTM_BLE_CONN_INT_MIN);
+  uint64_t rtt_us = interval * 1250ull * L2CAP_LE_CREDIT_RTT_INTERVALS;
+
+  uint64_t target =
+      2 * frames * rtt_us / elapsed_us + L2CAP_LE_CREDIT_MIN_WINDOW;
+  target = std::min<uint64_t>(target, l2c_lcc_max_window(p_ccb));
+
+  /* Open up at once, close slowly so that bursts after a lull still fit */
+  uint16_t window = p_lec->window;
+  if (target >= window)
+    window = target;
+  else
+    window -= (window - target) / 4;
+
+  if (window != p_lec->window) {
+    L2CAP_TRACE_DEBUG("%s: CID 0x%04x %u frames in %u us, window %d -> %d",
+                      __func__, p_ccb->local_cid, frames,
+                      (uint32_t)elapsed_us, p_lec->window, window);
+    p_lec->window = window;
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_lcc_return_credits
+ *
+ * Description      This function accounts for a K-frame accepted on a LE CoC
+ *                  channel and gives credits back to the remote once it has
+ *                  used half of its receive window.
+ *
+ * Returns          -
+ *
+ ******************************************************************************/
+static void l2c_lcc_return_credits(tL2C_CCB* p_ccb) {
+  tL2C_LE_CREDIT* p_lec = &p_ccb->le_credit;
+
+  p_lec->rx_frames++;
+  p_lec->rate_frames++;
+
+  uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
+  uint64_t elapsed_us = now_us - p_lec->rate_start_us;
+  if (elapsed_us >= L2CAP_LE_CREDIT_RATE_PERIOD_US) {
+    if (elapsed_us <= 4 * L2CAP_LE_CREDIT_RATE_PERIOD_US)
+      l2c_lcc_update_window(p_ccb, p_lec->rate_frames, elapsed_us);
+    p_lec->rate_start_us = now_us;
+    p_lec->rate_frames = 0;
+  }
+
+  if (p_ccb->remote_credit_count > p_lec->window / 2) return;
+
+  uint16_t credits = p_lec->window - p_ccb->remote_credit_count;
+  p_ccb->remote_credit_count = p_lec->window;
+  p_lec->credit_pdus++;
+  p_lec->credits_returned += credits;
+
+  /* Return back credits */
+  l2c_csm_execute(p_ccb, L2CEVT_L2CA_SEND_FLOW_CONTROL_CREDIT, &credits);
+}
+
 /*******************************************************************************
  *
  * Function         l2c_fcr_proc_tout
@@ -924,7 +1106,7 @@ void l2c_fcr_proc_tout(tL2C_CCB* p_ccb) {
       "l2c_fcr_proc_tout:  CID: 0x%04x  num_tries: %u (max: %u)  wait_ack: %u  "
       "ack_q_count: %u",
       p_ccb->local_cid, p_ccb->fcrb.num_tries, p_ccb->peer_cfg.fcr.max_transmit,
-      p_ccb->fcrb.wait_ack, fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q));
+      p_ccb->fcrb.wait_ack, p_ccb->fcrb.num_waiting_for_ack);
 
 #if (L2CAP_ERTM_STATS == TRUE)
   p_ccb->fcrb.retrans_touts++;
@@ -994,8 +1176,7 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
        (L2CAP_FCR_SUP_SREJ << L2CAP_FCR_SUP_SHIFT)) &&
       ((ctrl_word & L2CAP_FCR_P_BIT) == 0)) {
     /* If anything still waiting for ack, restart the timer if it was stopped */
-    if (!fixed_queue_is_empty(p_fcrb->waiting_for_ack_q))
-      l2c_fcr_start_timer(p_ccb);
+    if (p_fcrb->num_waiting_for_ack != 0) l2c_fcr_start_timer(p_ccb);
 
     return (true);
   }
@@ -1007,13 +1188,12 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
   num_bufs_acked = (req_seq - p_fcrb->last_rx_ack) & L2CAP_FCR_SEQ_MODULO;
 
   /* Verify the request sequence is in range before proceeding */
-  if (num_bufs_acked > fixed_queue_length(p_fcrb->waiting_for_ack_q)) {
+  if (num_bufs_acked > p_fcrb->num_waiting_for_ack) {
     /* The channel is closed if ReqSeq is not in range */
     L2CAP_TRACE_WARNING(
         "L2CAP eRTM Frame BAD Req_Seq - ctrl_word: 0x%04x  req_seq 0x%02x  "
         "last_rx_ack: 0x%02x  QCount: %u",
-        ctrl_word, req_seq, p_fcrb->last_rx_ack,
-        fixed_queue_length(p_fcrb->waiting_for_ack_q));
+        ctrl_word, req_seq, p_fcrb->last_rx_ack, p_fcrb->num_waiting_for_ack);
 
     l2cu_disconnect_chnl(p_ccb);
     return (false);
@@ -1031,9 +1211,11 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
     l2c_fcr_collect_ack_delay(p_ccb, num_bufs_acked);
 #endif
 
+    /* The acked frames are the oldest ones, up to TxSeq req_seq - 1 */
     for (xx = 0; xx < num_bufs_acked; xx++) {
-      BT_HDR* p_tmp =
-          (BT_HDR*)fixed_queue_try_dequeue(p_fcrb->waiting_for_ack_q);
+      uint8_t tx_seq = (req_seq - num_bufs_acked + xx) & L2CAP_FCR_SEQ_MODULO;
+      BT_HDR* p_tmp = p_fcrb->waiting_for_ack[tx_seq];
+      p_fcrb->waiting_for_ack[tx_seq] = NULL;
       ls = p_tmp->layer_specific & L2CAP_FCR_SAR_BITS;
 
       if ((ls == L2CAP_FCR_UNSEG_SDU) || (ls == L2CAP_FCR_END_SDU))
@@ -1041,6 +1223,7 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
 
       osi_free(p_tmp);
     }
+    p_fcrb->num_waiting_for_ack -= num_bufs_acked;
 
     /* If we are still in a wait_ack state, do not mess with the timer */
     if (!p_ccb->fcrb.wait_ack) l2c_fcr_stop_timer(p_ccb);
@@ -1049,7 +1232,7 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
     if ((p_ccb->p_rcb) && (p_ccb->p_rcb->api.pL2CA_TxComplete_Cb) &&
         (full_sdus_xmitted)) {
       /* Special case for eRTM, if all packets sent, send 0xFFFF */
-      if (fixed_queue_is_empty(p_fcrb->waiting_for_ack_q) &&
+      if ((p_fcrb->num_waiting_for_ack == 0) &&
           fixed_queue_is_empty(p_ccb->xmit_hold_q)) {
         full_sdus_xmitted = 0xFFFF;
       }
@@ -1060,8 +1243,7 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
   }
 
   /* If anything still waiting for ack, restart the timer if it was stopped */
-  if (!fixed_queue_is_empty(p_fcrb->waiting_for_ack_q))
-    l2c_fcr_start_timer(p_ccb);
+  if (p_fcrb->num_waiting_for_ack != 0) l2c_fcr_start_timer(p_ccb);
   return (true);
 }
 
@@ -1553,20 +1735,17 @@ static bool do_sar_reassembly(tL2C_CCB* p_ccb, BT_HDR* p_buf,
 static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq) {
   CHECK(p_ccb != NULL);
 
-  BT_HDR* p_buf = NULL;
-  uint8_t* p;
-  uint8_t buf_seq;
-  uint16_t ctrl_word;
+  tL2C_FCRB* p_fcrb = &p_ccb->fcrb;
+  uint8_t first, count;
 
-  if ((!fixed_queue_is_empty(p_ccb->fcrb.waiting_for_ack_q)) &&
+  if ((p_fcrb->num_waiting_for_ack != 0) &&
       (p_ccb->peer_cfg.fcr.max_transmit != 0) &&
-      (p_ccb->fcrb.num_tries >= p_ccb->peer_cfg.fcr.max_transmit)) {
+      (p_fcrb->num_tries >= p_ccb->peer_cfg.fcr.max_transmit)) {
     L2CAP_TRACE_EVENT(
         "Max Tries Exceeded:  (last_acq: %d  CID: 0x%04x  num_tries: %u (max: "
         "%u) ack_q_count: %u",
-        p_ccb->fcrb.last_rx_ack, p_ccb->local_cid, p_ccb->fcrb.num_tries,
-        p_ccb->peer_cfg.fcr.max_transmit,
-        fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q));
+        p_fcrb->last_rx_ack, p_ccb->local_cid, p_fcrb->num_tries,
+        p_ccb->peer_cfg.fcr.max_transmit, p_fcrb->num_waiting_for_ack);
 
     l2cu_disconnect_chnl(p_ccb);
     return (false);
@@ -1574,40 +1753,15 @@ static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq) {
 
   /* tx_seq indicates whether to retransmit a specific sequence or all (if ==
    * L2C_FCR_RETX_ALL_PKTS) */
-  list_t* list_ack = NULL;
-  const list_node_t* node_ack = NULL;
-  if (!fixed_queue_is_empty(p_ccb->fcrb.waiting_for_ack_q)) {
-    list_ack = fixed_queue_get_list(p_ccb->fcrb.waiting_for_ack_q);
-    node_ack = list_begin(list_ack);
-  }
   if (tx_seq != L2C_FCR_RETX_ALL_PKTS) {
-    /* If sending only one, the sequence number tells us which one. Look for it.
-    */
-    if (list_ack != NULL) {
-      for (; node_ack != list_end(list_ack); node_ack = list_next(node_ack)) {
-        p_buf = (BT_HDR*)list_node(node_ack);
-        /* Get the old control word */
-        p = ((uint8_t*)(p_buf + 1)) + p_buf->offset + L2CAP_PKT_OVERHEAD;
-
-        STREAM_TO_UINT16(ctrl_word, p);
-
-        buf_seq =
-            (ctrl_word & L2CAP_FCR_TX_SEQ_BITS) >> L2CAP_FCR_TX_SEQ_BITS_SHIFT;
-
-        L2CAP_TRACE_DEBUG(
-            "retransmit_i_frames()   cur seq: %u  looking for: %u", buf_seq,
-            tx_seq);
-
-        if (tx_seq == buf_seq) break;
-      }
-    }
-
-    if (!p_buf) {
+    /* If sending only one, the sequence number tells us which one */
+    if (!wack_find(p_fcrb, tx_seq)) {
       L2CAP_TRACE_ERROR("retransmit_i_frames() UNKNOWN seq: %u  q_count: %u",
-                        tx_seq,
-                        fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q));
+                        tx_seq, p_fcrb->num_waiting_for_ack);
       return (true);
     }
+    first = tx_seq;
+    count = 1;
   } else {
     // Iterate though list and flush the amount requested from
     // the transmit data queue that satisfy the layer and event conditions.
@@ -1624,32 +1778,29 @@ static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq) {
     }
 
     /* Also flush our retransmission queue */
-    while (!fixed_queue_is_empty(p_ccb->fcrb.retrans_q))
-      osi_free(fixed_queue_try_dequeue(p_ccb->fcrb.retrans_q));
+    while (!fixed_queue_is_empty(p_fcrb->retrans_q))
+      osi_free(fixed_queue_try_dequeue(p_fcrb->retrans_q));
 
-    if (list_ack != NULL) node_ack = list_begin(list_ack);
+    first = p_fcrb->last_rx_ack;
+    count = p_fcrb->num_waiting_for_ack;
   }
 
-  if (list_ack != NULL) {
-    while (node_ack != list_end(list_ack)) {
-      p_buf = (BT_HDR*)list_node(node_ack);
-      node_ack = list_next(node_ack);
-
-      BT_HDR* p_buf2 = l2c_fcr_clone_buf(p_buf, p_buf->offset, p_buf->len);
-      if (p_buf2) {
-        p_buf2->layer_specific = p_buf->layer_specific;
+  /* The waiting frames stay in the window until acked, HCI frees what it sends
+   * so the retransmissions are copies */
+  for (uint8_t xx = 0; xx < count; xx++) {
+    BT_HDR* p_buf =
+        p_fcrb->waiting_for_ack[(first + xx) & L2CAP_FCR_SEQ_MODULO];
 
-        fixed_queue_enqueue(p_ccb->fcrb.retrans_q, p_buf2);
-      }
+    BT_HDR* p_buf2 = l2c_fcr_clone_buf(p_buf, p_buf->offset, p_buf->len);
+    p_buf2->layer_specific = p_buf->layer_specific;
 
-      if ((tx_seq != L2C_FCR_RETX_ALL_PKTS) || (p_buf2 == NULL)) break;
-    }
+    fixed_queue_enqueue(p_fcrb->retrans_q, p_buf2);
   }
 
   l2c_link_check_send_pkts(p_ccb->p_lcb, NULL, NULL);
 
-  if (fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q)) {
-    p_ccb->fcrb.num_tries++;
+  if (p_fcrb->num_waiting_for_ack != 0) {
+    p_fcrb->num_tries++;
     l2c_fcr_start_timer(p_ccb);
   }
 
@@ -1794,7 +1945,7 @@ BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
       if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) p_xmit->len -= L2CAP_FCS_LEN;
 
       /* Pretend we sent it and it got lost */
-      fixed_queue_enqueue(p_ccb->fcrb.waiting_for_ack_q, p_xmit);
+      wack_push(&p_ccb->fcrb, p_xmit);
       return (NULL);
     } else {
 #if (L2CAP_ERTM_STATS == TRUE)
@@ -1812,7 +1963,7 @@ BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
       if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) p_wack->len -= L2CAP_FCS_LEN;
 
       p_wack->layer_specific = p_xmit->layer_specific;
-      fixed_queue_enqueue(p_ccb->fcrb.waiting_for_ack_q, p_wack);
+      wack_push(&p_ccb->fcrb, p_wack);
     }
 
 #if (L2CAP_ERTM_STATS == TRUE)
@@ -2370,49 +2521,40 @@ static void l2c_fcr_collect_ack_delay(tL2C_CCB* p_ccb, uint8_t num_bufs_acked) {
   index = p_ccb->fcrb.ack_delay_avg_index;
 
   /* update sum, max and min of waiting for ack queue size */
-  p_ccb->fcrb.ack_q_count_avg[index] +=
-      fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q);
-
-  if (fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q) >
-      p_ccb->fcrb.ack_q_count_max[index])
-    p_ccb->fcrb.ack_q_count_max[index] =
-        fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q);
-
-  if (fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q) <
-      p_ccb->fcrb.ack_q_count_min[index])
-    p_ccb->fcrb.ack_q_count_min[index] =
-        fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q);
-
-  /* update sum, max and min of round trip delay of acking */
-  list_t* list = NULL;
-  if (!fixed_queue_is_empty(p_ccb->fcrb.waiting_for_ack_q))
-    list = fixed_queue_get_list(p_ccb->fcrb.waiting_for_ack_q);
-  if (list != NULL) {
-    for (const list_node_t *node = list_begin(list), xx = 0;
-         (node != list_end(list)) && (xx < num_bufs_acked);
-         node = list_next(node), xx++) {
-      p_buf = list_node(node);
-      /* adding up length of acked I-frames to get throughput */
-      p_ccb->fcrb.throughput[index] += p_buf->len - 8;
-
-      if (xx == num_bufs_acked - 1) {
-        /* get timestamp from tx I-frame that receiver is acking */
-        p = ((uint8_t*)(p_buf + 1)) + p_buf->offset + p_buf->len;
-        if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) {
-          p += L2CAP_FCS_LEN;
-        }
+  p_ccb->fcrb.ack_q_count_avg[index] += p_ccb->fcrb.num_waiting_for_ack;
+
+  if (p_ccb->fcrb.num_waiting_for_ack > p_ccb->fcrb.ack_q_count_max[index])
+    p_ccb->fcrb.ack_q_count_max[index] = p_ccb->fcrb.num_waiting_for_ack;
+
+  if (p_ccb->fcrb.num_waiting_for_ack < p_ccb->fcrb.ack_q_count_min[index])
+    p_ccb->fcrb.ack_q_count_min[index] = p_ccb->fcrb.num_waiting_for_ack;
+
+  /* update sum, max and min of round trip delay of acking, the acked frames
+   * are the oldest ones, ending before last_rx_ack */
+  for (xx = 0; xx < num_bufs_acked; xx++) {
+    p_buf = p_ccb->fcrb.waiting_for_ack[(p_ccb->fcrb.last_rx_ack -
+                                         num_bufs_acked + xx) &
+                                        L2CAP_FCR_SEQ_MODULO];
+    /* adding up length of acked I-frames to get throughput */
+    p_ccb->fcrb.throughput[index] += p_buf->len - 8;
+
+    if (xx == num_bufs_acked - 1) {
+      /* get timestamp from tx I-frame that receiver is acking */
+      p = ((uint8_t*)(p_buf + 1)) + p_buf->offset + p_buf->len;
+      if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) {
+        p += L2CAP_FCS_LEN;
+      }
 
-        STREAM_TO_UINT32(timestamp, p);
-        delay = static_cast<uint32_t>(
-                    bluetooth::common::time_get_os_boottime_ms()) -
-                timestamp;
+      STREAM_TO_UINT32(timestamp, p);
+      delay = static_cast<uint32_t>(
+                  bluetooth::common::time_get_os_boottime_ms()) -
+              timestamp;
 
-        p_ccb->fcrb.ack_delay_avg[index] += delay;
-        if (delay > p_ccb->fcrb.ack_delay_max[index])
-          p_ccb->fcrb.ack_delay_max[index] = delay;
-        if (delay < p_ccb->fcrb.ack_delay_min[index])
-          p_ccb->fcrb.ack_delay_min[index] = delay;
-      }
+      p_ccb->fcrb.ack_delay_avg[index] += delay;
+      if (delay > p_ccb->fcrb.ack_delay_max[index])
+        p_ccb->fcrb.ack_delay_max[index] = delay;
+      if (delay < p_ccb->fcrb.ack_delay_min[index])
+        p_ccb->fcrb.ack_delay_min[index] = delay;
     }
   }
 
@@ -43,16 +43,29 @@ constexpr uint16_t L2CAP_LE_MIN_MPS = 23;
 constexpr uint16_t L2CAP_LE_MAX_MPS = 65533;
 constexpr uint16_t L2CAP_LE_CREDIT_MAX = 65535;
 
-// This is initial amout of credits we send, and amount to which we increase
-// credits once they fall below threshold
+// This is the initial amount of credits we give, before the memory budget
+// below caps it
 constexpr uint16_t L2CAP_LE_CREDIT_DEFAULT = 0xffff;
 
-// If credit count on remote fall below this value, we send back credits to
-// reach default value.
-constexpr uint16_t L2CAP_LE_CREDIT_THRESHOLD = 0x0040;
+// The receive window of a LE CoC channel, the credits the remote is topped up
+// to, follows the rate at which K-frames are received. It covers the frames
+// received during this many connection intervals, the time for returned
+// credits to reach the remote and be used, twice over.
+constexpr uint16_t L2CAP_LE_CREDIT_RTT_INTERVALS = 4;
 
-static_assert(L2CAP_LE_CREDIT_THRESHOLD < L2CAP_LE_CREDIT_DEFAULT,
-              "Threshold must be smaller then default credits");
+// Smallest receive window, so that a channel can ramp up from idle
+constexpr uint16_t L2CAP_LE_CREDIT_MIN_WINDOW = 8;
+
+static_assert(L2CAP_LE_CREDIT_MIN_WINDOW < L2CAP_LE_CREDIT_DEFAULT,
+              "Minimum window must be smaller then default credits");
+
+// Bytes a single channel lets the remote have in flight, which caps the
+// receive window to this budget divided by the local MPS
+constexpr uint32_t L2CAP_LE_CREDIT_RX_BUDGET = 64 * 1024;
+
+// Period over which the receive rate is sampled. Samples spanning more than
+// four periods come after an idle time and are not used.
+constexpr uint64_t L2CAP_LE_CREDIT_RATE_PERIOD_US = 250 * 1000;
 
 #define L2CAP_NO_IDLE_TIMEOUT 0xFFFF
 
@@ -203,8 +216,10 @@ typedef struct {
 
   uint16_t rx_sdu_len; /* Length of the SDU being received */
   BT_HDR* p_rx_sdu;    /* Buffer holding the SDU being received */
-  fixed_queue_t*
-      waiting_for_ack_q;          /* Buffers sent and waiting for peer to ack */
+  /* Buffers sent and waiting for peer to ack, indexed by TxSeq. The oldest
+   * one has TxSeq last_rx_ack */
+  BT_HDR* waiting_for_ack[L2CAP_FCR_SEQ_MODULO + 1];
+  uint8_t num_waiting_for_ack;    /* Number of buffers waiting for ack */
   fixed_queue_t* srej_rcv_hold_q; /* Buffers rcvd but held pending SREJ rsp */
   fixed_queue_t* retrans_q;       /* Buffers being retransmitted */
 
@@ -239,6 +254,24 @@ typedef struct {
 #endif
 } tL2C_FCRB;
 
+/* Receive window and credit statistics of a LE CoC channel */
+typedef struct {
+  uint16_t window;            /* credits the remote is topped up to */
+  uint64_t rate_start_us;     /* start of the current rate sample */
+  uint32_t rate_frames;       /* K-frames received in the current sample */
+  uint64_t tx_stall_start_us; /* when we ran out of credits, 0 if we have some */
+  uint64_t open_us;           /* when the credits were set up */
+
+  uint32_t rx_frames;        /* K-frames received */
+  uint32_t rx_stalls;        /* times the remote ran out of credits */
+  uint32_t credit_pdus;      /* LE Flow Control Credit packets sent */
+  uint32_t credits_returned; /* credits given back to the remote */
+  uint32_t tx_stalls;        /* times we ran out of credits with data queued */
+  uint64_t tx_stall_us;      /* time spent waiting for credits to send */
+  uint32_t sdus_in_place;    /* SDUs delivered in the received K-frame */
+  uint32_t sdus_copied;      /* SDUs reassembled from several K-frames */
+} tL2C_LE_CREDIT;
+
 typedef struct {
   bool in_use;
   bool log_packets;
@@ -344,6 +377,8 @@ typedef struct t_l2c_ccb {
   /* Number of LE frames that the remote can send to us (credit count in
    * remote). Valid only for LE CoC */
   uint16_t remote_credit_count;
+
+  tL2C_LE_CREDIT le_credit; /* LE CoC receive window and credit statistics */
 } tL2C_CCB;
 
 /***********************************************************************
@@ -449,6 +484,7 @@ typedef struct t_l2c_linkcb {
   uint16_t timeout;
   uint16_t min_ce_len;
   uint16_t max_ce_len;
+  uint16_t conn_interval; /* current connection interval, 1.25 ms units */
 
 #if (L2CAP_ROUND_ROBIN_CHANNEL_SERVICE == TRUE)
   /* each priority group is limited burst transmission */
@@ -765,6 +801,7 @@ extern BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
                                              uint16_t max_packet_length);
 extern void l2c_fcr_start_timer(tL2C_CCB* p_ccb);
 extern void l2c_lcc_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf);
+extern void l2c_lcc_init_credits(tL2C_CCB* p_ccb);
 extern BT_HDR* l2c_lcc_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
                                              bool* last_piece_of_sdu);
 
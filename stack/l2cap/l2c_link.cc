@@ -35,6 +35,7 @@
 #include "btm_api.h"
 #include "btm_int.h"
 #include "btu.h"
+#include "common/a2dp_latency_tracer.h"
 #include "device/include/controller.h"
 #include "hcimsgs.h"
 #include "l2c_api.h"
@@ -43,6 +44,8 @@
 #include "log/log.h"
 #include "osi/include/osi.h"
 
+using bluetooth::common::A2dpLatencyTracer;
+
 static bool l2c_link_send_to_lower(tL2C_LCB* p_lcb, BT_HDR* p_buf,
                                    tL2C_TX_COMPLETE_CB_INFO* p_cbi);
 
@@ -1131,6 +1134,8 @@ static bool l2c_link_send_to_lower(tL2C_LCB* p_lcb, BT_HDR* p_buf,
     }
     p_lcb->sent_not_acked++;
     p_buf->layer_specific = 0;
+    A2dpLatencyTracer::GetInstance().OnL2capSend(p_buf, p_lcb->handle,
+                                                 p_lcb->sent_not_acked);
 
     if (p_lcb->transport == BT_TRANSPORT_LE) {
       l2cb.controller_le_xmit_window--;
@@ -1180,6 +1185,8 @@ static bool l2c_link_send_to_lower(tL2C_LCB* p_lcb, BT_HDR* p_buf,
     }
 
     p_lcb->sent_not_acked += num_segs;
+    A2dpLatencyTracer::GetInstance().OnL2capSend(p_buf, p_lcb->handle,
+                                                 p_lcb->sent_not_acked);
     if (p_lcb->transport == BT_TRANSPORT_LE) {
       bte_main_hci_send(
           p_buf, (uint16_t)(BT_EVT_TO_LM_HCI_ACL | LOCAL_BLE_CONTROLLER_ID));
@@ -1241,6 +1248,8 @@ void l2c_link_process_num_completed_pkts(uint8_t* p, uint8_t evt_len) {
     STREAM_TO_UINT16(handle, p);
     STREAM_TO_UINT16(num_sent, p);
 
+    A2dpLatencyTracer::GetInstance().OnPacketsCompleted(handle, num_sent);
+
     p_lcb = l2cu_find_lcb_by_handle(handle);
 
     /* Callback for number of completed packet event    */
@@ -223,18 +223,6 @@ void l2c_rcv_acl_data(BT_HDR* p_msg) {
 
   if (p_lcb->transport == BT_TRANSPORT_LE) {
     l2c_lcc_proc_pdu(p_ccb, p_msg);
-
-    /* The remote device has one less credit left */
-    --p_ccb->remote_credit_count;
-
-    /* If the credits left on the remote device are getting low, send some */
-    if (p_ccb->remote_credit_count <= L2CAP_LE_CREDIT_THRESHOLD) {
-      uint16_t credits = L2CAP_LE_CREDIT_DEFAULT - p_ccb->remote_credit_count;
-      p_ccb->remote_credit_count = L2CAP_LE_CREDIT_DEFAULT;
-
-      /* Return back credits */
-      l2c_csm_execute(p_ccb, L2CEVT_L2CA_SEND_FLOW_CONTROL_CREDIT, &credits);
-    }
   } else {
     /* Basic mode packets go straight to the state machine */
     if (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_BASIC_MODE)
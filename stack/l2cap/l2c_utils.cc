@@ -32,6 +32,7 @@
 #include "btm_api.h"
 #include "btm_int.h"
 #include "btu.h"
+#include "common/time_util.h"
 #include "device/include/controller.h"
 #include "hci/include/btsnoop.h"
 #include "hcidefs.h"
@@ -1450,6 +1451,8 @@ tL2C_CCB* l2cu_allocate_ccb(tL2C_LCB* p_lcb, uint16_t cid) {
 
   p_ccb->bypass_fcs = 0;
   memset(&p_ccb->ertm_info, 0, sizeof(tL2CAP_ERTM_INFO));
+  memset(&p_ccb->le_credit, 0, sizeof(tL2C_LE_CREDIT));
+  p_ccb->le_credit.window = L2CAP_LE_CREDIT_MIN_WINDOW;
   p_ccb->peer_cfg_already_rejected = false;
   p_ccb->fcr_cfg_tries = L2CAP_MAX_FCR_CFG_TRIES;
 
@@ -1477,7 +1480,6 @@ tL2C_CCB* l2cu_allocate_ccb(tL2C_LCB* p_lcb, uint16_t cid) {
   p_ccb->xmit_hold_q = fixed_queue_new(SIZE_MAX);
   p_ccb->fcrb.srej_rcv_hold_q = fixed_queue_new(SIZE_MAX);
   p_ccb->fcrb.retrans_q = fixed_queue_new(SIZE_MAX);
-  p_ccb->fcrb.waiting_for_ack_q = fixed_queue_new(SIZE_MAX);
 
   p_ccb->cong_sent = false;
   p_ccb->buff_quota = 2; /* This gets set after config */
@@ -3316,6 +3318,12 @@ BT_HDR* l2cu_get_next_buffer_to_send(tL2C_LCB* p_lcb,
     bool last_piece_of_sdu = false;
     p_buf = l2c_lcc_get_next_xmit_sdu_seg(p_ccb, &last_piece_of_sdu);
     p_ccb->peer_conn_cfg.credits--;
+    if (p_ccb->peer_conn_cfg.credits == 0 &&
+        !fixed_queue_is_empty(p_ccb->xmit_hold_q)) {
+      p_ccb->le_credit.tx_stalls++;
+      p_ccb->le_credit.tx_stall_start_us =
+          bluetooth::common::time_get_os_boottime_us();
+    }
 
     if (last_piece_of_sdu) {
       // TODO: send callback up the stack. Investigate setting p_cbi->cb to
@@ -472,7 +472,9 @@ tPAN_RESULT PAN_Write(uint16_t handle, const RawAddress& dst,
   memcpy((uint8_t*)buffer + sizeof(BT_HDR) + buffer->offset, p_data,
          buffer->len);
 
-  return PAN_WriteBuf(handle, dst, src, protocol, buffer, ext);
+  tPAN_RESULT result = PAN_WriteBuf(handle, dst, src, protocol, buffer, ext);
+  if (result == PAN_Q_SIZE_EXCEEDED) osi_free(buffer);
+  return result;
 }
 
 /*******************************************************************************
@@ -483,8 +485,9 @@ tPAN_RESULT PAN_Write(uint16_t handle, const RawAddress& dst,
  *                  on GN or NAP side and the packet is multicast or broadcast
  *                  it will be sent on all the links. Otherwise the correct link
  *                  is found based on the destination address and forwarded on
- *                  it. If the return value is not PAN_SUCCESS, the application
- *                  should take care of releasing the message buffer.
+ *                  it. If the return value is PAN_Q_SIZE_EXCEEDED, the
+ *                  application should take care of releasing or resending the
+ *                  message buffer.
  *
  * Parameters:      handle   - handle for the connection
  *                  dst      - MAC or BD Addr of the destination device
@@ -27,6 +27,7 @@
 #include <base/logging.h>
 #include <string.h>
 
+#include "common/time_util.h"
 #include "osi/include/log.h"
 #include "osi/include/mutex.h"
 
@@ -803,6 +804,18 @@ static int port_write(tPORT* p_port, BT_HDR* p_buf) {
         (p_port->rfc.p_mcb && p_port->rfc.p_mcb->peer_ready), p_port->rfc.state,
         p_port->port_ctrl);
 
+    /* Data of an opened port starts waiting for credits or for the channel */
+    if ((p_port->rfc.state == RFC_STATE_OPENED) &&
+        (p_port->stats.stall_start_us == 0)) {
+      p_port->stats.stall_start_us =
+          bluetooth::common::time_get_os_boottime_us();
+      if (p_port->tx.peer_fc) {
+        p_port->stats.credit_stalls++;
+      } else {
+        p_port->stats.link_stalls++;
+      }
+    }
+
     fixed_queue_enqueue(p_port->tx.queue, p_buf);
     p_port->tx.queue_size += p_buf->len;
 
@@ -867,45 +880,43 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
   if (available == 0) return PORT_SUCCESS;
   /* Length for each buffer is the smaller of GKI buffer, peer MTU, or max_len
    */
-  length = RFCOMM_DATA_BUF_SIZE -
-           (uint16_t)(sizeof(BT_HDR) + L2CAP_MIN_OFFSET + RFCOMM_DATA_OVERHEAD);
+  length = port_tx_frame_len(p_port);
 
-  /* If there are buffers scheduled for transmission check if requested */
-  /* data fits into the end of the queue */
+  /* If there are buffers scheduled for transmission fill up the last one, */
+  /* so that the data is sent in as few frames of the peer MTU as possible. */
+  /* A credit octet stays free in them, so that credits can be returned. */
   mutex_global_lock();
 
   p_buf = (BT_HDR*)fixed_queue_try_peek_last(p_port->tx.queue);
-  if ((p_buf != NULL) &&
-      (((int)p_buf->len + available) <= (int)p_port->peer_mtu) &&
-      (((int)p_buf->len + available) <= (int)length)) {
+  if ((p_buf != NULL) && (p_buf->len < length)) {
+    int count = length - p_buf->len;
+    if (available < count) count = available;
+
     // if(recv(fd, (uint8_t *)(p_buf + 1) + p_buf->offset + p_buf->len,
-    // available, 0) != available)
+    // count, 0) != count)
     if (!p_port->p_data_co_callback(
             handle, (uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len,
-            available, DATA_CO_CALLBACK_TYPE_OUTGOING))
+            count, DATA_CO_CALLBACK_TYPE_OUTGOING))
 
     {
       error(
           "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING failed, "
-          "available:%d",
-          available);
+          "count:%d",
+          count);
       mutex_global_unlock();
       return (PORT_UNKNOWN_ERROR);
     }
-    // memcpy ((uint8_t *)(p_buf + 1) + p_buf->offset + p_buf->len, p_data,
-    // max_len);
-    p_port->tx.queue_size += (uint16_t)available;
-
-    *p_len = available;
-    p_buf->len += (uint16_t)available;
+    p_port->tx.queue_size += (uint16_t)count;
 
-    mutex_global_unlock();
-
-    return (PORT_SUCCESS);
+    *p_len = count;
+    p_buf->len += (uint16_t)count;
+    available -= count;
   }
 
   mutex_global_unlock();
 
+  if (available == 0) return (PORT_SUCCESS);
+
   // int max_read = length < p_port->peer_mtu ? length : p_port->peer_mtu;
 
   // max_read = available < max_read ? available : max_read;
@@ -928,7 +939,6 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
     p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
     p_buf->layer_specific = handle;
 
-    if (p_port->peer_mtu < length) length = p_port->peer_mtu;
     if (available < (int)length) length = (uint16_t)available;
     p_buf->len = length;
     p_buf->event = BT_EVT_TO_BTU_SP_DATA;
@@ -1014,29 +1024,31 @@ int PORT_WriteData(uint16_t handle, const char* p_data, uint16_t max_len,
 
   /* Length for each buffer is the smaller of GKI buffer, peer MTU, or max_len
    */
-  length = RFCOMM_DATA_BUF_SIZE -
-           (uint16_t)(sizeof(BT_HDR) + L2CAP_MIN_OFFSET + RFCOMM_DATA_OVERHEAD);
+  length = port_tx_frame_len(p_port);
 
-  /* If there are buffers scheduled for transmission check if requested */
-  /* data fits into the end of the queue */
+  /* If there are buffers scheduled for transmission fill up the last one, */
+  /* so that the data is sent in as few frames of the peer MTU as possible. */
+  /* A credit octet stays free in them, so that credits can be returned. */
   mutex_global_lock();
 
   p_buf = (BT_HDR*)fixed_queue_try_peek_last(p_port->tx.queue);
-  if ((p_buf != NULL) && ((p_buf->len + max_len) <= p_port->peer_mtu) &&
-      ((p_buf->len + max_len) <= length)) {
-    memcpy((uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len, p_data, max_len);
-    p_port->tx.queue_size += max_len;
+  if ((p_buf != NULL) && (p_buf->len < length)) {
+    uint16_t count = length - p_buf->len;
+    if (max_len < count) count = max_len;
 
-    *p_len = max_len;
-    p_buf->len += max_len;
+    memcpy((uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len, p_data, count);
+    p_port->tx.queue_size += count;
 
-    mutex_global_unlock();
-
-    return (PORT_SUCCESS);
+    *p_len = count;
+    p_buf->len += count;
+    max_len -= count;
+    p_data += count;
   }
 
   mutex_global_unlock();
 
+  if (max_len == 0) return (PORT_SUCCESS);
+
   while (max_len) {
     /* if we're over buffer high water mark, we're done */
     if ((p_port->tx.queue_size > PORT_TX_HIGH_WM) ||
@@ -1048,7 +1060,6 @@ int PORT_WriteData(uint16_t handle, const char* p_data, uint16_t max_len,
     p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
     p_buf->layer_specific = handle;
 
-    if (p_port->peer_mtu < length) length = p_port->peer_mtu;
     if (max_len < length) length = max_len;
     p_buf->len = length;
     p_buf->event = BT_EVT_TO_BTU_SP_DATA;
@@ -1136,3 +1147,56 @@ const char* PORT_GetResultString(const uint8_t result_code) {
 
   return result_code_strings[result_code];
 }
+
+/*******************************************************************************
+ *
+ * Function         stack_debug_rfcomm_dump
+ *
+ * Description      This function dumps the flow control state and the data
+ *                  transfer statistics of the RFCOMM ports.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void stack_debug_rfcomm_dump(int fd) {
+  uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
+
+  dprintf(fd, "\nRFCOMM Ports:\n");
+
+  for (int i = 0; i < MAX_RFC_PORTS; i++) {
+    const tPORT* p_port = &rfc_cb.port.port[i];
+    if (!p_port->in_use || (p_port->rfc.p_mcb == NULL)) continue;
+
+    const tPORT_STATS& stats = p_port->stats;
+    uint64_t stall_us = stats.stall_us;
+    if (stats.stall_start_us != 0) stall_us += now_us - stats.stall_start_us;
+
+    dprintf(fd, "\n  Port: %d peer: %s\n", p_port->handle,
+            p_port->bd_addr.ToString().c_str());
+    dprintf(fd, "    DLCI: %d SCN: %d UUID: 0x%04x\n", p_port->dlci,
+            p_port->scn, p_port->uuid);
+    dprintf(fd, "    State: %d RFCOMM state: %d\n", p_port->state,
+            p_port->rfc.state);
+    dprintf(fd, "    MTU (local/peer): %d / %d\n", p_port->mtu,
+            p_port->peer_mtu);
+    dprintf(fd, "    TX credits: %d\n", p_port->credit_tx);
+    dprintf(fd, "    RX credits (given/window/low watermark): %d / %d / %d\n",
+            p_port->credit_rx, p_port->credit_rx_max, p_port->credit_rx_low);
+    dprintf(fd, "    RX credit round trip in us: %u\n",
+            p_port->rx_window.rtt_us);
+    dprintf(fd, "    RX frames consumed per second: %u\n",
+            p_port->rx_window.consumed.per_sec);
+    dprintf(fd, "    TX (frames/bytes/bytes per second): %u / %llu / %u\n",
+            stats.tx_frames, (unsigned long long)stats.tx_bytes,
+            stats.tx_rate.per_sec);
+    dprintf(fd, "    RX (frames/bytes/bytes per second): %u / %llu / %u\n",
+            stats.rx_frames, (unsigned long long)stats.rx_bytes,
+            stats.rx_rate.per_sec);
+    dprintf(fd, "    TX queue (buffers/bytes): %zu / %u\n",
+            fixed_queue_length(p_port->tx.queue), p_port->tx.queue_size);
+    dprintf(fd, "    TX stalls (on credits/on channel/total ms): %u / %u / "
+            "%llu\n",
+            stats.credit_stalls, stats.link_stalls,
+            (unsigned long long)(stall_us / 1000));
+  }
+}
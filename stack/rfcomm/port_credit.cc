@@ -0,0 +1,155 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  Port Emulation entity: estimate of the credit window that keeps the peer
+ *  sending at the rate the application takes the data at
+ *
+ ******************************************************************************/
+#include "port_int.h"
+
+/* Credit round trips are remembered for this long when no lower one is
+ * timed, so that the estimate follows a link getting slower */
+#define PORT_RTT_EXPIRY_US 10000000
+
+/* The window is the consumption rate times the round trip, times this gain:
+ * a window limiting the peer makes the application consume one window per
+ * round trip, so the window grows until the link or the application limits
+ * the rate instead */
+#define PORT_RX_WINDOW_GAIN 2
+
+/*******************************************************************************
+ *
+ * Function         port_rate_add
+ *
+ * Description      Counts |count| events at |now_us|. The count of each
+ *                  interval of PORT_RATE_INTERVAL_US is weighted into the
+ *                  rate at 1/4 when the interval closes.
+ *
+ ******************************************************************************/
+void port_rate_add(tPORT_RATE* p_rate, uint32_t count, uint64_t now_us) {
+  if (p_rate->start_us == 0) {
+    p_rate->start_us = now_us;
+  } else if (now_us - p_rate->start_us >= PORT_RATE_INTERVAL_US) {
+    uint64_t per_sec =
+        (uint64_t)p_rate->count * 1000000 / (now_us - p_rate->start_us);
+    if (p_rate->per_sec == 0) {
+      p_rate->per_sec = (uint32_t)per_sec;
+    } else {
+      p_rate->per_sec =
+          (uint32_t)((3 * (uint64_t)p_rate->per_sec + per_sec) / 4);
+    }
+    p_rate->start_us = now_us;
+    p_rate->count = 0;
+  }
+  p_rate->count += count;
+}
+
+/*******************************************************************************
+ *
+ * Function         port_rx_window_frame
+ *
+ * Description      Counts a frame received at |now_us|, and times the round
+ *                  trip of the credits granted when it is the first frame
+ *                  the peer sent on them.
+ *
+ ******************************************************************************/
+void port_rx_window_frame(tPORT_RX_WINDOW* p_window, uint64_t now_us) {
+  p_window->frames_rx++;
+
+  if (p_window->grant_us == 0 ||
+      (int32_t)(p_window->frames_rx - p_window->grant_frame) < 0)
+    return;
+
+  uint64_t rtt_us = now_us - p_window->grant_us;
+  if (rtt_us == 0) rtt_us = 1;
+  if (rtt_us > UINT32_MAX) rtt_us = UINT32_MAX;
+  p_window->grant_us = 0;
+
+  /* Take the lowest round trip: the others include the time the peer had
+   * no data to send, or still had credits to send it on */
+  if (p_window->rtt_us == 0 || rtt_us <= p_window->rtt_us ||
+      now_us - p_window->rtt_set_us > PORT_RTT_EXPIRY_US) {
+    p_window->rtt_us = (uint32_t)rtt_us;
+    p_window->rtt_set_us = now_us;
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         port_rx_window_consumed
+ *
+ * Description      Counts |count| frames consumed by the application at
+ *                  |now_us|.
+ *
+ ******************************************************************************/
+void port_rx_window_consumed(tPORT_RX_WINDOW* p_window, uint16_t count,
+                             uint64_t now_us) {
+  /* The application may give back credits for frames it was never sent */
+  uint32_t in_hand = p_window->frames_rx - p_window->frames_consumed;
+  if (count > in_hand) count = (uint16_t)in_hand;
+
+  p_window->frames_consumed += count;
+  port_rate_add(&p_window->consumed, count, now_us);
+}
+
+/*******************************************************************************
+ *
+ * Function         port_rx_window_grant
+ *
+ * Description      Notes credits granted at |now_us|, when the peer is owed
+ *                  |credit_rx| credits for frames not consumed yet, to time
+ *                  their round trip unless one is being timed already.
+ *
+ ******************************************************************************/
+void port_rx_window_grant(tPORT_RX_WINDOW* p_window, uint16_t credit_rx,
+                          uint64_t now_us) {
+  if (p_window->grant_us != 0) return;
+
+  /* Credits the peer still holds are used before the ones granted */
+  uint32_t in_hand = p_window->frames_rx - p_window->frames_consumed;
+  uint32_t held = (credit_rx > in_hand) ? credit_rx - in_hand : 0;
+
+  p_window->grant_us = now_us;
+  p_window->grant_frame = p_window->frames_rx + held + 1;
+}
+
+/*******************************************************************************
+ *
+ * Function         port_rx_window_credits
+ *
+ * Description      Returns the credit window for the estimated consumption
+ *                  rate and round trip, between |min_credits| and
+ *                  |max_credits|. Returns |min_credits| until both have been
+ *                  measured.
+ *
+ ******************************************************************************/
+uint16_t port_rx_window_credits(const tPORT_RX_WINDOW* p_window,
+                                uint16_t min_credits, uint16_t max_credits) {
+  if (p_window->rtt_us == 0 || p_window->consumed.per_sec == 0)
+    return min_credits;
+
+  uint64_t credits = ((uint64_t)p_window->consumed.per_sec * p_window->rtt_us *
+                          PORT_RX_WINDOW_GAIN +
+                      999999) /
+                     1000000;
+  if (credits < min_credits) return min_credits;
+  if (credits > max_credits) return max_credits;
+  return (uint16_t)credits;
+}
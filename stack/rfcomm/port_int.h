@@ -50,6 +50,48 @@ typedef struct {
   tPORT_CALLBACK* p_callback; /* Address of the callback function */
 } tPORT_DATA;
 
+/*
+ * Rate of an event count, smoothed over intervals of PORT_RATE_INTERVAL_US
+*/
+#define PORT_RATE_INTERVAL_US 200000
+
+typedef struct {
+  uint64_t start_us; /* Start of the interval being counted */
+  uint32_t count;    /* Count of the interval being counted */
+  uint32_t per_sec;  /* Smoothed count per second */
+} tPORT_RATE;
+
+/*
+ * Estimate of the credit window the peer needs to keep sending: the rate the
+ * application consumes frames at, times the round trip of the credits, which
+ * is timed from a grant to the first frame sent on its credits.
+*/
+typedef struct {
+  uint32_t frames_rx;       /* Frames received from the peer */
+  uint32_t frames_consumed; /* Frames consumed by the application */
+  tPORT_RATE consumed;      /* Frames consumed per second */
+  uint64_t grant_us;        /* Time of the grant being timed, 0 if none */
+  uint32_t grant_frame;     /* Count of frames_rx reached on its credits */
+  uint32_t rtt_us;          /* Lowest credit round trip of recent grants */
+  uint64_t rtt_set_us;      /* Time rtt_us was last lowered */
+} tPORT_RX_WINDOW;
+
+/*
+ * Data transfer statistics of a port
+*/
+typedef struct {
+  uint64_t tx_bytes;
+  uint32_t tx_frames;
+  tPORT_RATE tx_rate; /* Bytes sent per second */
+  uint64_t rx_bytes;
+  uint32_t rx_frames;
+  tPORT_RATE rx_rate;       /* Bytes received per second */
+  uint32_t credit_stalls;   /* Times data waited for credits from the peer */
+  uint32_t link_stalls;     /* Times data waited for the multiplexer */
+  uint64_t stall_us;        /* Time data waited, in total */
+  uint64_t stall_start_us;  /* Start of the current wait, 0 if none */
+} tPORT_STATS;
+
 /*
  * Port control structure used to pass modem info
 */
@@ -97,6 +139,8 @@ typedef struct {
       pending_lcid; /* store LCID for incoming connection while connecting */
   uint8_t
       pending_id; /* store l2cap ID for incoming connection while connecting */
+  uint8_t tx_next_port; /* Index of the port whose turn is next to send */
+  bool tx_turn_open;    /* true if that port was stopped during its turn */
 } tRFC_MCB;
 
 /*
@@ -186,6 +230,10 @@ typedef struct {
   bool keep_port_handle;    /* true if port is not deallocated when closing */
   /* it is set to true for server when allocating port */
   uint16_t keep_mtu; /* Max MTU that port can receive by server */
+
+  uint32_t tx_deficit;       /* Bytes the port may still send in its turn */
+  tPORT_RX_WINDOW rx_window; /* Credit window needed by the peer */
+  tPORT_STATS stats;
 } tPORT;
 
 /* Define the PORT/RFCOMM control structure
@@ -201,6 +249,7 @@ typedef struct {
 extern tPORT* port_allocate_port(uint8_t dlci, const RawAddress& bd_addr);
 extern void port_set_defaults(tPORT* p_port);
 extern void port_select_mtu(tPORT* p_port);
+extern uint16_t port_tx_frame_len(tPORT* p_port);
 extern void port_release_port(tPORT* p_port);
 extern tPORT* port_find_mcb_dlci_port(tRFC_MCB* p_mcb, uint8_t dlci);
 extern tRFC_MCB* port_find_mcb(const RawAddress& bd_addr);
@@ -221,4 +270,17 @@ extern void port_start_control(tPORT* p_port);
 extern void port_start_close(tPORT* p_port);
 extern void port_rfc_closed(tPORT* p_port, uint8_t res);
 
+/*
+ * Functions provided by the port_credit.cc
+*/
+extern void port_rate_add(tPORT_RATE* p_rate, uint32_t count, uint64_t now_us);
+extern void port_rx_window_frame(tPORT_RX_WINDOW* p_window, uint64_t now_us);
+extern void port_rx_window_consumed(tPORT_RX_WINDOW* p_window, uint16_t count,
+                                    uint64_t now_us);
+extern void port_rx_window_grant(tPORT_RX_WINDOW* p_window, uint16_t credit_rx,
+                                 uint64_t now_us);
+extern uint16_t port_rx_window_credits(const tPORT_RX_WINDOW* p_window,
+                                       uint16_t min_credits,
+                                       uint16_t max_credits);
+
 #endif
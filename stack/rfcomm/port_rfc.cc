@@ -25,6 +25,7 @@
 #include <base/logging.h>
 #include <string.h>
 
+#include "common/time_util.h"
 #include "osi/include/mutex.h"
 #include "osi/include/osi.h"
 
@@ -42,6 +43,7 @@
  * Local function definitions
 */
 uint32_t port_rfc_send_tx_data(tPORT* p_port);
+static void port_rfc_schedule_tx(tRFC_MCB* p_mcb, uint32_t* p_events);
 void port_rfc_closed(tPORT* p_port, uint8_t res);
 void port_get_credits(tPORT* p_port, uint8_t k);
 
@@ -767,6 +769,13 @@ void PORT_DataInd(tRFC_MCB* p_mcb, uint8_t dlci, BT_HDR* p_buf) {
     osi_free(p_buf);
     return;
   }
+
+  uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
+  port_rx_window_frame(&p_port->rx_window, now_us);
+  p_port->stats.rx_frames++;
+  p_port->stats.rx_bytes += p_buf->len;
+  port_rate_add(&p_port->stats.rx_rate, p_buf->len, now_us);
+
   /* If client registered callout callback with flow control we can just deliver
    * receive data */
   if (p_port->p_data_co_callback) {
@@ -846,7 +855,7 @@ void PORT_DataInd(tRFC_MCB* p_mcb, uint8_t dlci, BT_HDR* p_buf) {
  ******************************************************************************/
 void PORT_FlowInd(tRFC_MCB* p_mcb, uint8_t dlci, bool enable_data) {
   tPORT* p_port = (tPORT*)NULL;
-  uint32_t events = 0;
+  uint32_t events[MAX_RFC_PORTS] = {0};
   int i;
 
   RFCOMM_TRACE_EVENT("PORT_FlowInd fc:%d", enable_data);
@@ -860,32 +869,72 @@ void PORT_FlowInd(tRFC_MCB* p_mcb, uint8_t dlci, bool enable_data) {
     p_port->tx.peer_fc = !enable_data;
   }
 
+  /* Check if data can be sent and send it.  Any port of the multiplexer may
+   * send, as the ports take turns. */
+  port_rfc_schedule_tx(p_mcb, events);
+
   for (i = 0; i < MAX_RFC_PORTS; i++) {
-    /* If DLCI is 0 event applies to all ports */
-    if (dlci == 0) {
-      p_port = &rfc_cb.port.port[i];
-      if (!p_port->in_use || (p_port->rfc.p_mcb != p_mcb) ||
-          (p_port->rfc.state != RFC_STATE_OPENED))
-        continue;
+    p_port = &rfc_cb.port.port[i];
+    if (!p_port->in_use || (p_port->rfc.p_mcb != p_mcb)) continue;
+
+    /* If DLCI is 0 event applies to all opened ports, otherwise to that port
+     * and to the ports which sent in its place */
+    if ((dlci == 0) ? (p_port->rfc.state == RFC_STATE_OPENED)
+                    : (p_port->dlci == dlci)) {
+      /* Check if flow of data is still enabled */
+      events[i] |= port_flow_control_user(p_port);
     }
-    events = 0;
-
-    /* Check if flow of data is still enabled */
-    events |= port_flow_control_user(p_port);
-
-    /* Check if data can be sent and send it */
-    events |= port_rfc_send_tx_data(p_port);
 
     /* Mask out all events that are not of interest to user */
-    events &= p_port->ev_mask;
+    events[i] &= p_port->ev_mask;
 
     /* Send event to the application */
-    if (p_port->p_callback && events)
-      (p_port->p_callback)(events, p_port->handle);
+    if (p_port->p_callback && events[i])
+      (p_port->p_callback)(events[i], p_port->handle);
+  }
+}
+
+/*******************************************************************************
+ *
+ * Function         port_rfc_send_tx_buf
+ *
+ * Description      This function sends the first buffer of the tx queue if
+ *                  it is no longer than |*p_deficit|, and takes its length
+ *                  off |*p_deficit|.
+ *
+ * Returns          true if a buffer was sent
+ *
+ ******************************************************************************/
+static bool port_rfc_send_tx_buf(tPORT* p_port, uint32_t* p_deficit) {
+  BT_HDR* p_buf;
+
+  /* get data from tx queue and send it */
+  mutex_global_lock();
+
+  p_buf = (BT_HDR*)fixed_queue_try_peek_first(p_port->tx.queue);
+  if ((p_buf == NULL) || (p_buf->len > *p_deficit)) {
+    mutex_global_unlock();
+    return false;
+  }
+  fixed_queue_try_dequeue(p_port->tx.queue);
+  p_port->tx.queue_size -= p_buf->len;
 
-    /* If DLCI is not 0 event applies to one port only */
-    if (dlci != 0) break;
+  mutex_global_unlock();
+
+  *p_deficit -= p_buf->len;
+
+  /* Data that waited is moving again */
+  if (p_port->stats.stall_start_us != 0) {
+    p_port->stats.stall_us += bluetooth::common::time_get_os_boottime_us() -
+                              p_port->stats.stall_start_us;
+    p_port->stats.stall_start_us = 0;
   }
+
+  RFCOMM_TRACE_DEBUG("Sending RFCOMM_DataReq tx.queue_size=%d",
+                     p_port->tx.queue_size);
+
+  RFCOMM_DataReq(p_port->rfc.p_mcb, p_port->dlci, p_buf);
+  return true;
 }
 
 /*******************************************************************************
@@ -897,38 +946,22 @@ void PORT_FlowInd(tRFC_MCB* p_mcb, uint8_t dlci, bool enable_data) {
  ******************************************************************************/
 uint32_t port_rfc_send_tx_data(tPORT* p_port) {
   uint32_t events = 0;
-  BT_HDR* p_buf;
+  uint32_t unlimited = UINT32_MAX;
 
   /* if there is data to be sent */
   if (p_port->tx.queue_size > 0) {
     /* while the rfcomm peer is not flow controlling us, and peer is ready */
     while (!p_port->tx.peer_fc && p_port->rfc.p_mcb &&
            p_port->rfc.p_mcb->peer_ready) {
-      /* get data from tx queue and send it */
-      mutex_global_lock();
-
-      p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_port->tx.queue);
-      if (p_buf != NULL) {
-        p_port->tx.queue_size -= p_buf->len;
-
-        mutex_global_unlock();
-
-        RFCOMM_TRACE_DEBUG("Sending RFCOMM_DataReq tx.queue_size=%d",
-                           p_port->tx.queue_size);
-
-        RFCOMM_DataReq(p_port->rfc.p_mcb, p_port->dlci, p_buf);
-
-        events |= PORT_EV_TXCHAR;
-
-        if (p_port->tx.queue_size == 0) {
-          events |= PORT_EV_TXEMPTY;
-          break;
-        }
-      }
       /* queue is empty-- all data sent */
-      else {
-        mutex_global_unlock();
+      if (!port_rfc_send_tx_buf(p_port, &unlimited)) {
+        events |= PORT_EV_TXEMPTY;
+        break;
+      }
+
+      events |= PORT_EV_TXCHAR;
 
+      if (p_port->tx.queue_size == 0) {
         events |= PORT_EV_TXEMPTY;
         break;
       }
@@ -939,6 +972,65 @@ uint32_t port_rfc_send_tx_data(tPORT* p_port) {
   return (events & p_port->ev_mask);
 }
 
+/*******************************************************************************
+ *
+ * Function         port_rfc_schedule_tx
+ *
+ * Description      This function sends the data queued on the ports of the
+ *                  multiplexer channel, while the peer and L2CAP take it.
+ *                  The ports take turns by deficit round robin: each turn
+ *                  lets a port send one L2CAP frame worth of bytes more, so
+ *                  that a port with bulk data to send gets no more of the
+ *                  channel than the other ports with data to send.  When
+ *                  L2CAP gets congested the turn goes on once it is not.
+ *                  Events of the ports are added to |p_events|, by index.
+ *
+ ******************************************************************************/
+static void port_rfc_schedule_tx(tRFC_MCB* p_mcb, uint32_t* p_events) {
+  uint32_t quantum =
+      p_mcb->peer_l2cap_mtu ? p_mcb->peer_l2cap_mtu : L2CAP_DEFAULT_MTU;
+  bool sent = true;
+
+  while (sent && p_mcb->peer_ready) {
+    sent = false;
+
+    for (int n = 0; (n < MAX_RFC_PORTS) && p_mcb->peer_ready; n++) {
+      int i = p_mcb->tx_next_port;
+      tPORT* p_port = &rfc_cb.port.port[i];
+
+      if (p_port->in_use && (p_port->rfc.p_mcb == p_mcb) &&
+          (p_port->rfc.state == RFC_STATE_OPENED) && !p_port->tx.peer_fc &&
+          (p_port->tx.queue_size > 0)) {
+        if (!p_mcb->tx_turn_open) {
+          p_port->tx_deficit += quantum;
+          p_mcb->tx_turn_open = true;
+        }
+
+        while (p_mcb->peer_ready && !p_port->tx.peer_fc &&
+               port_rfc_send_tx_buf(p_port, &p_port->tx_deficit)) {
+          p_events[i] |= PORT_EV_TXCHAR;
+          sent = true;
+        }
+        if (!p_mcb->peer_ready) break;
+
+        if (p_port->tx.queue_size == 0) p_events[i] |= PORT_EV_TXEMPTY;
+
+        /* If we flow controlled user based on the queue size enable data
+         * again */
+        p_events[i] |= port_flow_control_user(p_port);
+      }
+
+      /* A port with nothing it may send leaves the round, and its deficit */
+      if ((p_port->rfc.p_mcb == p_mcb) &&
+          (p_port->tx.peer_fc || (p_port->tx.queue_size == 0)))
+        p_port->tx_deficit = 0;
+
+      p_mcb->tx_turn_open = false;
+      p_mcb->tx_next_port = (i + 1) % MAX_RFC_PORTS;
+    }
+  }
+}
+
 /*******************************************************************************
  *
  * Function         port_rfc_closed
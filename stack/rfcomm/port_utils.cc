@@ -24,6 +24,7 @@
 #include <base/logging.h>
 #include <string.h>
 
+#include "common/time_util.h"
 #include "osi/include/mutex.h"
 
 #include "bt_common.h"
@@ -122,6 +123,10 @@ void port_set_defaults(tPORT* p_port) {
   memset(&p_port->rx, 0, sizeof(p_port->rx));
   memset(&p_port->tx, 0, sizeof(p_port->tx));
 
+  p_port->tx_deficit = 0;
+  memset(&p_port->rx_window, 0, sizeof(p_port->rx_window));
+  memset(&p_port->stats, 0, sizeof(p_port->stats));
+
   p_port->tx.queue = fixed_queue_new(SIZE_MAX);
   p_port->rx.queue = fixed_queue_new(SIZE_MAX);
 }
@@ -191,6 +196,27 @@ void port_select_mtu(tPORT* p_port) {
       p_port->credit_rx_max, p_port->credit_rx_low, p_port->rx_buf_critical);
 }
 
+/*******************************************************************************
+ *
+ * Function         port_tx_frame_len
+ *
+ * Description      Returns the number of data bytes written in a frame to the
+ *                  peer: the smaller of the buffer size and the peer MTU. With
+ *                  credit based flow control, one octet of the MTU is left for
+ *                  the credits returned in the frame.
+ *
+ ******************************************************************************/
+uint16_t port_tx_frame_len(tPORT* p_port) {
+  uint16_t length =
+      RFCOMM_DATA_BUF_SIZE -
+      (uint16_t)(sizeof(BT_HDR) + L2CAP_MIN_OFFSET + RFCOMM_DATA_OVERHEAD);
+  uint16_t mtu = p_port->peer_mtu;
+  if (p_port->rfc.p_mcb && (p_port->rfc.p_mcb->flow == PORT_FC_CREDIT) &&
+      (mtu > 1))
+    mtu--;
+  return (mtu < length) ? mtu : length;
+}
+
 /*******************************************************************************
  *
  * Function         port_release_port
@@ -439,6 +465,40 @@ uint32_t port_get_signal_changes(tPORT* p_port, uint8_t old_signals,
   return (p_port->ev_mask & events);
 }
 
+/*******************************************************************************
+ *
+ * Function         port_adapt_credit_window
+ *
+ * Description      Resizes the credit window of a port delivering the data
+ *                  received to a callback, for the rate the application
+ *                  consumes the data at.  The window stays between the one
+ *                  set by port_select_mtu and PORT_RX_BUF_MAX_WM, and the low
+ *                  watermark keeps its ratio to the window.  Ports queuing
+ *                  the data received keep the window their receive queue
+ *                  watermarks are sized for.
+ *
+ * Returns          nothing
+ *
+ ******************************************************************************/
+static void port_adapt_credit_window(tPORT* p_port) {
+  if (!p_port->p_data_callback && !p_port->p_data_co_callback) return;
+  if (p_port->mtu == 0) return;
+
+  uint16_t min_credits = PORT_RX_HIGH_WM / p_port->mtu;
+  if (min_credits > PORT_RX_BUF_HIGH_WM) min_credits = PORT_RX_BUF_HIGH_WM;
+
+  uint16_t credits = port_rx_window_credits(&p_port->rx_window, min_credits,
+                                            PORT_RX_BUF_MAX_WM);
+  if (credits == p_port->credit_rx_max) return;
+
+  RFCOMM_TRACE_DEBUG("%s: handle %d, credit_rx_max %d -> %d, rtt %u us",
+                     __func__, p_port->handle, p_port->credit_rx_max, credits,
+                     p_port->rx_window.rtt_us);
+
+  p_port->credit_rx_max = credits;
+  p_port->credit_rx_low = credits * PORT_RX_BUF_LOW_WM / PORT_RX_BUF_HIGH_WM;
+}
+
 /*******************************************************************************
  *
  * Function         port_flow_control_peer
@@ -457,6 +517,11 @@ void port_flow_control_peer(tPORT* p_port, bool enable, uint16_t count) {
   if (p_port->rfc.p_mcb->flow == PORT_FC_CREDIT) {
     /* if want to enable flow from peer */
     if (enable) {
+      uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
+
+      port_rx_window_consumed(&p_port->rx_window, count, now_us);
+      port_adapt_credit_window(p_port);
+
       /* update rx credits */
       if (count > p_port->credit_rx) {
         p_port->credit_rx = 0;
@@ -469,6 +534,8 @@ void port_flow_control_peer(tPORT* p_port, bool enable, uint16_t count) {
       /* There might be a special case when we just adjusted rx_max */
       if ((p_port->credit_rx <= p_port->credit_rx_low) && !p_port->rx.user_fc &&
           (p_port->credit_rx_max > p_port->credit_rx)) {
+        port_rx_window_grant(&p_port->rx_window, p_port->credit_rx, now_us);
+
         rfc_send_credit(p_port->rfc.p_mcb, p_port->dlci,
                         (uint8_t)(p_port->credit_rx_max - p_port->credit_rx));
 
@@ -28,6 +28,7 @@
 #include "bt_utils.h"
 #include "btm_api.h"
 #include "btm_int.h"
+#include "common/time_util.h"
 #include "osi/include/osi.h"
 #include "port_api.h"
 #include "port_int.h"
@@ -431,7 +432,13 @@ void rfc_port_sm_opened(tPORT* p_port, uint16_t event, void* p_data) {
       rfc_port_closed(p_port);
       return;
 
-    case RFC_EVENT_DATA:
+    case RFC_EVENT_DATA: {
+      uint64_t now_us = bluetooth::common::time_get_os_boottime_us();
+
+      p_port->stats.tx_frames++;
+      p_port->stats.tx_bytes += ((BT_HDR*)p_data)->len;
+      port_rate_add(&p_port->stats.tx_rate, ((BT_HDR*)p_data)->len, now_us);
+
       /* Send credits in the frame.  Pass them in the layer specific member of
        * the hdr. */
       /* There might be an initial case when we reduced rx_max and credit_rx is
@@ -441,6 +448,7 @@ void rfc_port_sm_opened(tPORT* p_port, uint16_t event, void* p_data) {
           (((BT_HDR*)p_data)->len < p_port->peer_mtu) &&
           (!p_port->rx.user_fc) &&
           (p_port->credit_rx_max > p_port->credit_rx)) {
+        port_rx_window_grant(&p_port->rx_window, p_port->credit_rx, now_us);
         ((BT_HDR*)p_data)->layer_specific =
             (uint8_t)(p_port->credit_rx_max - p_port->credit_rx);
         p_port->credit_rx = p_port->credit_rx_max;
@@ -450,6 +458,7 @@ void rfc_port_sm_opened(tPORT* p_port, uint16_t event, void* p_data) {
       rfc_send_buf_uih(p_port->rfc.p_mcb, p_port->dlci, (BT_HDR*)p_data);
       rfc_dec_credit(p_port);
       return;
+    }
 
     case RFC_EVENT_UA:
       return;
@@ -0,0 +1,351 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "stack/include/a2dp_abr.h"
+
+namespace {
+
+constexpr uint64_t kTickMs = 20;
+constexpr int kTopLevel = A2DP_ABR_NUM_LEVELS - 1;
+
+tA2DP_LINK_QUALITY Sample(size_t tx_queue_length) {
+  tA2DP_LINK_QUALITY link_quality = {};
+  link_quality.tx_queue_length = tx_queue_length;
+  return link_quality;
+}
+
+// Feeds |ticks| ticks with |tx_queue_length| queued packets, and returns the
+// number of level changes.
+int Feed(A2dpAbr* abr, size_t tx_queue_length, int ticks) {
+  int changes = 0;
+  for (int i = 0; i < ticks; i++) {
+    if (abr->Update(Sample(tx_queue_length))) changes++;
+  }
+  return changes;
+}
+
+TEST(A2dpAbrTest, starts_at_configured_bitrate) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs);
+  EXPECT_EQ(abr.Level(), kTopLevel);
+  EXPECT_EQ(abr.BitratePercent(), 100);
+  EXPECT_EQ(Feed(&abr, 1, 1000), 0);
+  EXPECT_EQ(abr.Level(), kTopLevel);
+}
+
+TEST(A2dpAbrTest, steps_down_once_per_hold_period) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs);
+
+  EXPECT_TRUE(abr.Update(Sample(6)));
+  EXPECT_EQ(abr.Level(), kTopLevel - 1);
+  // The lower level is given time to drain the queue
+  EXPECT_EQ(Feed(&abr, 10, 9), 0);
+  EXPECT_TRUE(abr.Update(Sample(10)));
+  EXPECT_EQ(abr.Level(), kTopLevel - 2);
+
+  // Never below the lowest level
+  Feed(&abr, 20, 100);
+  EXPECT_EQ(abr.Level(), 0);
+  EXPECT_EQ(abr.BitratePercent(), A2dpAbr::BitratePercent(0));
+}
+
+TEST(A2dpAbrTest, steps_up_after_clear_period) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs);
+  abr.Update(Sample(8));
+  ASSERT_EQ(abr.Level(), kTopLevel - 1);
+
+  // A queue above the low threshold is not clear
+  EXPECT_EQ(Feed(&abr, 3, 1000), 0);
+  EXPECT_EQ(Feed(&abr, 2, 149), 0);
+  EXPECT_TRUE(abr.Update(Sample(2)));
+  EXPECT_EQ(abr.Level(), kTopLevel);
+}
+
+TEST(A2dpAbrTest, failed_step_up_doubles_wait) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs);
+  abr.Update(Sample(8));
+  Feed(&abr, 0, 150);
+  ASSERT_EQ(abr.Level(), kTopLevel);
+
+  // The link could not sustain the step up
+  Feed(&abr, 0, 20);
+  EXPECT_TRUE(abr.Update(Sample(8)));
+  EXPECT_EQ(Feed(&abr, 0, 299), 0);
+  EXPECT_TRUE(abr.Update(Sample(0)));
+  EXPECT_EQ(abr.Level(), kTopLevel);
+
+  // A step up that held brings the wait back
+  Feed(&abr, 0, 300);
+  EXPECT_TRUE(abr.Update(Sample(8)));
+  EXPECT_EQ(Feed(&abr, 0, 150), 1);
+}
+
+TEST(A2dpAbrTest, steps_down_on_flushed_packets) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs);
+
+  // The first sample gives the count since the link was established
+  tA2DP_LINK_QUALITY link_quality = Sample(0);
+  link_quality.flush_count = 500;
+  EXPECT_FALSE(abr.Update(link_quality));
+  EXPECT_FALSE(abr.Update(link_quality));
+  EXPECT_EQ(abr.Level(), kTopLevel);
+
+  link_quality.flush_count = 501;
+  EXPECT_TRUE(abr.Update(link_quality));
+  EXPECT_EQ(abr.Level(), kTopLevel - 1);
+
+  // A new link starts counting again
+  for (int i = 0; i < 20; i++) abr.Update(link_quality);
+  link_quality.flush_count = 3;
+  EXPECT_FALSE(abr.Update(link_quality));
+  EXPECT_EQ(abr.Level(), kTopLevel - 1);
+}
+
+TEST(A2dpAbrTest, l2cap_stalls_need_a_queue) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs);
+  tA2DP_LINK_QUALITY link_quality = Sample(1);
+  EXPECT_FALSE(abr.Update(link_quality));
+  link_quality.l2cap_stall_count = 5;
+  EXPECT_FALSE(abr.Update(link_quality));
+  link_quality.tx_queue_length = 3;
+  link_quality.l2cap_stall_count = 6;
+  EXPECT_TRUE(abr.Update(link_quality));
+}
+
+TEST(A2dpAbrTest, disabled_keeps_configured_bitrate) {
+  A2dpAbr abr;
+  abr.Init(false, kTickMs);
+  EXPECT_EQ(Feed(&abr, 20, 100), 0);
+  EXPECT_EQ(abr.Level(), kTopLevel);
+
+  // Even when the level the peer last settled on is lower
+  abr.Init(false, kTickMs, 0);
+  EXPECT_EQ(abr.Level(), kTopLevel);
+}
+
+TEST(A2dpAbrTest, starts_at_learned_level_and_steps_up) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs, 1);
+  EXPECT_EQ(abr.Level(), 1);
+  EXPECT_EQ(abr.SettledLevel(), 1);
+
+  // A clear link steps up as from any level below the top
+  EXPECT_EQ(Feed(&abr, 0, 149), 0);
+  EXPECT_TRUE(abr.Update(Sample(0)));
+  EXPECT_EQ(abr.Level(), 2);
+}
+
+TEST(A2dpAbrTest, settled_level_is_the_most_used) {
+  A2dpAbr abr;
+  abr.Init(true, kTickMs);
+  Feed(&abr, 0, 10);
+  abr.Update(Sample(8));
+  ASSERT_EQ(abr.Level(), kTopLevel - 1);
+  Feed(&abr, 3, 20);
+  EXPECT_EQ(abr.SettledLevel(), kTopLevel - 1);
+
+  // Back to the top, for less time than at the level below
+  Feed(&abr, 0, 150);
+  ASSERT_EQ(abr.Level(), kTopLevel);
+  Feed(&abr, 0, 50);
+  EXPECT_EQ(abr.SettledLevel(), kTopLevel - 1);
+  Feed(&abr, 0, 200);
+  EXPECT_EQ(abr.SettledLevel(), kTopLevel);
+}
+
+//
+// Link simulation: an encoder producing packets every tick into the Source
+// TX queue, drained by a link whose throughput and flushed packets follow a
+// recorded trace. A TX queue overflow flushes the whole queue, as
+// btif_a2dp_source_enqueue_callback() does: that is an audible drop-out.
+//
+
+// Encoder bitrate at the top level (SBC high quality, 44.1 kHz)
+constexpr int kConfiguredKbps = 454;
+// Bytes of a media packet, about a 2-DH5 AVDTP MTU
+constexpr int kPacketBytes = 600;
+// MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ
+constexpr size_t kMaxTxQueueLength = 28;
+
+struct TraceSegment {
+  int duration_ms;
+  int throughput_kbps;
+  int flushes_per_second;
+};
+
+struct LinkTrace {
+  const char* name;
+  std::vector<TraceSegment> segments;
+};
+
+struct SimulationResult {
+  int dropouts = 0;
+  int level_changes = 0;
+  int final_level = 0;
+  double average_bitrate_percent = 0;
+};
+
+SimulationResult Simulate(const LinkTrace& trace, bool adaptive) {
+  SimulationResult result;
+  A2dpAbr abr;
+  abr.Init(adaptive, kTickMs);
+
+  std::deque<int> tx_queue;  // bytes of each queued packet
+  double encoded_bytes = 0;
+  double link_bytes = 0;
+  double flushes = 0;
+  tA2DP_LINK_QUALITY link_quality = {};
+  long ticks = 0;
+  long percent_sum = 0;
+
+  for (const TraceSegment& segment : trace.segments) {
+    for (uint64_t t = 0; t < segment.duration_ms / kTickMs; t++, ticks++) {
+      // Encoder tick: sample the link, then encode
+      link_quality.tx_queue_length = tx_queue.size();
+      if (abr.Update(link_quality)) result.level_changes++;
+      percent_sum += abr.BitratePercent();
+
+      encoded_bytes += kConfiguredKbps * abr.BitratePercent() / 100.0 *
+                       kTickMs / 8;
+      while (encoded_bytes >= kPacketBytes) {
+        encoded_bytes -= kPacketBytes;
+        if (tx_queue.size() + 1 > kMaxTxQueueLength) {
+          result.dropouts++;
+          tx_queue.clear();
+        }
+        tx_queue.push_back(kPacketBytes);
+      }
+
+      // Link until the next tick
+      link_bytes += segment.throughput_kbps * kTickMs / 8.0;
+      while (!tx_queue.empty() && link_bytes >= tx_queue.front()) {
+        link_bytes -= tx_queue.front();
+        tx_queue.pop_front();
+      }
+      if (tx_queue.empty()) {
+        link_bytes = 0;
+      } else {
+        link_quality.l2cap_stall_count++;
+      }
+
+      flushes += segment.flushes_per_second * kTickMs / 1000.0;
+      link_quality.flush_count = (uint32_t)flushes;
+    }
+  }
+
+  result.final_level = abr.Level();
+  result.average_bitrate_percent = (double)percent_sum / ticks;
+  return result;
+}
+
+// |segments| repeated |times| times, then |tail|
+std::vector<TraceSegment> Repeat(const std::vector<TraceSegment>& segments,
+                                 int times, const TraceSegment& tail) {
+  std::vector<TraceSegment> repeated;
+  for (int i = 0; i < times; i++) {
+    repeated.insert(repeated.end(), segments.begin(), segments.end());
+  }
+  repeated.push_back(tail);
+  return repeated;
+}
+
+const std::vector<LinkTrace>& Traces() {
+  static const std::vector<LinkTrace> traces = {
+      {"clear_link", {{60000, 1000, 0}}},
+      // The sink moves away from the phone and comes back
+      {"walking_away",
+       {{10000, 1000, 0},
+        {10000, 500, 0},
+        {10000, 380, 1},
+        {10000, 300, 3},
+        {20000, 1000, 0}}},
+      // Wi-Fi scans on the shared antenna, every 1.5 seconds for a minute
+      {"wifi_scans",
+       Repeat({{800, 900, 0}, {700, 120, 0}}, 40, {20000, 1000, 0})},
+      // Throughput holds but the controller keeps flushing packets
+      {"interference",
+       {{10000, 800, 0}, {10000, 800, 20}, {30000, 800, 0}}},
+  };
+  return traces;
+}
+
+TEST(A2dpAbrSimulationTest, replay_link_traces) {
+  for (const LinkTrace& trace : Traces()) {
+    SCOPED_TRACE(trace.name);
+    SimulationResult fixed = Simulate(trace, false);
+    SimulationResult adaptive = Simulate(trace, true);
+
+    // Reported in the test output XML, to compare runs
+    std::string name = trace.name;
+    ::testing::Test::RecordProperty(name + "_fixed_dropouts", fixed.dropouts);
+    ::testing::Test::RecordProperty(name + "_adaptive_dropouts",
+                                    adaptive.dropouts);
+    ::testing::Test::RecordProperty(name + "_adaptive_level_changes",
+                                    adaptive.level_changes);
+    ::testing::Test::RecordProperty(
+        name + "_adaptive_bitrate_percent",
+        std::to_string(adaptive.average_bitrate_percent));
+
+    EXPECT_EQ(fixed.level_changes, 0);
+    EXPECT_EQ(adaptive.dropouts, 0);
+    EXPECT_LE(adaptive.dropouts, fixed.dropouts);
+    // The hold periods keep the level from following every short fade: at
+    // most one trip down to the lowest level and back up
+    EXPECT_LE(adaptive.level_changes, 2 * kTopLevel);
+    EXPECT_GE(adaptive.average_bitrate_percent, 50.0);
+    EXPECT_LE(adaptive.average_bitrate_percent, 100.0);
+    // Every trace ends on a clear link
+    EXPECT_EQ(adaptive.final_level, kTopLevel);
+  }
+}
+
+TEST(A2dpAbrSimulationTest, clear_link_keeps_configured_bitrate) {
+  SimulationResult result = Simulate(Traces()[0], true);
+  EXPECT_EQ(result.dropouts, 0);
+  EXPECT_EQ(result.level_changes, 0);
+}
+
+TEST(A2dpAbrSimulationTest, adapting_avoids_dropouts) {
+  for (const char* name : {"walking_away", "wifi_scans"}) {
+    for (const LinkTrace& trace : Traces()) {
+      if (std::string(trace.name) != name) continue;
+      SimulationResult fixed = Simulate(trace, false);
+      SimulationResult adaptive = Simulate(trace, true);
+      EXPECT_GT(fixed.dropouts, 0) << name;
+      EXPECT_EQ(adaptive.dropouts, 0) << name;
+    }
+  }
+}
+
+TEST(A2dpAbrSimulationTest, flushed_packets_lower_bitrate) {
+  SimulationResult result = Simulate(Traces()[3], true);
+  EXPECT_EQ(result.dropouts, 0);
+  EXPECT_GT(result.level_changes, 0);
+  EXPECT_LT(result.average_bitrate_percent, 100);
+}
+
+}  // namespace
@@ -0,0 +1,162 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <list>
+#include <random>
+
+#include "stack/btm/btm_ble_adv_cache.h"
+
+namespace {
+
+RawAddress make_address(uint32_t n) {
+  return RawAddress({0xc0, 0x00, (uint8_t)(n >> 24), (uint8_t)(n >> 16),
+                     (uint8_t)(n >> 8), (uint8_t)n});
+}
+
+}  // namespace
+
+TEST(AdvertisingCacheTest, get_creates_entry) {
+  AdvertisingCache cache(8);
+  RawAddress addr = make_address(1);
+
+  EXPECT_EQ(nullptr, cache.Find(0, addr));
+  AdvertisingCache::Entry& entry = cache.Get(0, addr);
+  EXPECT_EQ(addr, entry.addr);
+  EXPECT_EQ(0, entry.addr_type);
+  EXPECT_TRUE(entry.data.empty());
+  EXPECT_FALSE(entry.pending);
+  EXPECT_EQ(AdvertisingCache::kNoInqDbIndex, entry.inq_db_index);
+  EXPECT_EQ(1u, cache.size());
+
+  entry.data = {0x02, 0x01, 0x06};
+  entry.pending = true;
+  AdvertisingCache::Entry* found = cache.Find(0, addr);
+  ASSERT_EQ(&entry, found);
+  EXPECT_EQ(&entry, &cache.Get(0, addr));
+  EXPECT_TRUE(found->pending);
+  EXPECT_EQ(3u, found->data.size());
+  EXPECT_EQ(1u, cache.size());
+}
+
+TEST(AdvertisingCacheTest, address_type_is_part_of_the_key) {
+  AdvertisingCache cache(8);
+  RawAddress addr = make_address(1);
+
+  AdvertisingCache::Entry& public_entry = cache.Get(0, addr);
+  AdvertisingCache::Entry& random_entry = cache.Get(1, addr);
+  EXPECT_NE(&public_entry, &random_entry);
+  EXPECT_EQ(2u, cache.size());
+}
+
+TEST(AdvertisingCacheTest, evicts_least_recently_used) {
+  AdvertisingCache cache(3);
+  cache.Get(0, make_address(1));
+  cache.Get(0, make_address(2));
+  cache.Get(0, make_address(3));
+
+  // Hearing from 1 again makes 2 the oldest
+  cache.Get(0, make_address(1));
+  cache.Get(0, make_address(4));
+
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(1u, cache.evictions());
+  EXPECT_NE(nullptr, cache.Find(0, make_address(1)));
+  EXPECT_EQ(nullptr, cache.Find(0, make_address(2)));
+  EXPECT_NE(nullptr, cache.Find(0, make_address(3)));
+  EXPECT_NE(nullptr, cache.Find(0, make_address(4)));
+}
+
+TEST(AdvertisingCacheTest, recycled_entry_is_reset) {
+  AdvertisingCache cache(1);
+  AdvertisingCache::Entry& entry = cache.Get(0, make_address(1));
+  entry.data.assign(31, 0x55);
+  entry.pending = true;
+  entry.reported_hash = 1;
+  entry.reported_time_ms = 1;
+  entry.inq_db_index = 3;
+  size_t capacity = entry.data.capacity();
+
+  AdvertisingCache::Entry& recycled = cache.Get(0, make_address(2));
+  EXPECT_EQ(&entry, &recycled);
+  EXPECT_EQ(make_address(2), recycled.addr);
+  EXPECT_TRUE(recycled.data.empty());
+  EXPECT_FALSE(recycled.pending);
+  EXPECT_EQ(0u, recycled.reported_hash);
+  EXPECT_EQ(0u, recycled.reported_time_ms);
+  EXPECT_EQ(AdvertisingCache::kNoInqDbIndex, recycled.inq_db_index);
+  // The data buffer is reused
+  EXPECT_EQ(capacity, recycled.data.capacity());
+}
+
+TEST(AdvertisingCacheTest, clear) {
+  AdvertisingCache cache(4);
+  for (uint32_t i = 0; i < 4; i++) cache.Get(0, make_address(i));
+  cache.Clear();
+  EXPECT_EQ(0u, cache.size());
+  for (uint32_t i = 0; i < 4; i++)
+    EXPECT_EQ(nullptr, cache.Find(0, make_address(i)));
+  EXPECT_TRUE(cache.Get(0, make_address(7)).data.empty());
+}
+
+/* Checks the table against a reference LRU list on a long random stream of
+ * advertisers, which exercises probing and deletions from the index */
+TEST(AdvertisingCacheTest, matches_reference_lru) {
+  const size_t kCapacity = 64;
+  AdvertisingCache cache(kCapacity);
+  std::list<RawAddress> reference;
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<uint32_t> pick(0, 4 * kCapacity);
+
+  for (int i = 0; i < 20000; i++) {
+    RawAddress addr = make_address(pick(rng));
+    reference.remove(addr);
+    reference.push_front(addr);
+    if (reference.size() > kCapacity) reference.pop_back();
+
+    AdvertisingCache::Entry& entry = cache.Get(0, addr);
+    ASSERT_EQ(addr, entry.addr);
+  }
+
+  ASSERT_EQ(reference.size(), cache.size());
+  for (const RawAddress& addr : reference) {
+    AdvertisingCache::Entry* entry = cache.Find(0, addr);
+    ASSERT_NE(nullptr, entry);
+    EXPECT_EQ(addr, entry->addr);
+  }
+  for (uint32_t n = 0; n <= 4 * kCapacity; n++) {
+    RawAddress addr = make_address(n);
+    bool expected = std::find(reference.begin(), reference.end(), addr) !=
+                    reference.end();
+    EXPECT_EQ(expected, cache.Find(0, addr) != nullptr);
+  }
+}
+
+TEST(AdvertisingCacheTest, hash_data) {
+  std::vector<uint8_t> data1 = {0x02, 0x01, 0x06, 0x03, 0x03, 0x0f, 0x18};
+  std::vector<uint8_t> data2 = data1;
+  data2[6] = 0x19;
+
+  EXPECT_EQ(AdvertisingCache::HashData(data1.data(), data1.size()),
+            AdvertisingCache::HashData(data1.data(), data1.size()));
+  EXPECT_NE(AdvertisingCache::HashData(data1.data(), data1.size()),
+            AdvertisingCache::HashData(data2.data(), data2.size()));
+  EXPECT_NE(AdvertisingCache::HashData(data1.data(), data1.size()),
+            AdvertisingCache::HashData(data1.data(), data1.size() - 1));
+}
@@ -0,0 +1,236 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "bt_types.h"
+#include "btm_api_types.h"
+#include "btm_ble_api_types.h"
+#include "stack/btm/btm_ble_scan_filter.h"
+
+using bluetooth::Uuid;
+
+namespace {
+
+const RawAddress kAddress({0xc0, 0x11, 0x22, 0x33, 0x44, 0x55});
+const RawAddress kOtherAddress({0xc0, 0x11, 0x22, 0x33, 0x44, 0x66});
+
+std::vector<uint8_t> field(uint8_t type, std::vector<uint8_t> value) {
+  std::vector<uint8_t> data = {(uint8_t)(value.size() + 1), type};
+  data.insert(data.end(), value.begin(), value.end());
+  return data;
+}
+
+std::vector<uint8_t> operator+(std::vector<uint8_t> a,
+                               const std::vector<uint8_t>& b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+std::vector<uint8_t> name(const std::string& name) {
+  return field(BT_EIR_COMPLETE_LOCAL_NAME_TYPE,
+               std::vector<uint8_t>(name.begin(), name.end()));
+}
+
+ApcfCommand command(uint8_t type) {
+  ApcfCommand cmd = {};
+  cmd.type = type;
+  return cmd;
+}
+
+class ScanFilterTest : public ::testing::Test {
+ protected:
+  void SetUp() override { engine_.Enable(true); }
+
+  bool Match(const std::vector<uint8_t>& data,
+             const RawAddress& addr = kAddress, int8_t rssi = -50) {
+    return engine_.Match(BLE_ADDR_PUBLIC, addr, rssi, data.data(),
+                         data.size());
+  }
+
+  ScanFilterEngine engine_;
+};
+
+}  // namespace
+
+TEST_F(ScanFilterTest, disabled_passes_everything) {
+  engine_.Enable(false);
+  EXPECT_TRUE(Match(name("anything")));
+}
+
+TEST_F(ScanFilterTest, no_filter_passes_nothing) {
+  EXPECT_FALSE(Match(name("anything")));
+}
+
+TEST_F(ScanFilterTest, empty_feature_selection_passes_everything) {
+  engine_.SetParams(0, 0, BTM_BLE_PF_LOGIC_OR, -128);
+  EXPECT_TRUE(Match(name("anything")));
+}
+
+TEST_F(ScanFilterTest, address) {
+  ApcfCommand cmd = command(BTM_BLE_PF_ADDR_FILTER);
+  cmd.address = kAddress;
+  cmd.addr_type = BLE_ADDR_PUBLIC;
+  engine_.Add(1, cmd);
+
+  EXPECT_TRUE(Match({}));
+  EXPECT_FALSE(Match({}, kOtherAddress));
+  EXPECT_FALSE(engine_.Match(BLE_ADDR_RANDOM, kAddress, -50, nullptr, 0));
+}
+
+TEST_F(ScanFilterTest, address_any_type) {
+  ApcfCommand cmd = command(BTM_BLE_PF_ADDR_FILTER);
+  cmd.address = kAddress;
+  cmd.addr_type = BLE_ADDR_ANONYMOUS;
+  engine_.Add(1, cmd);
+
+  EXPECT_TRUE(engine_.Match(BLE_ADDR_RANDOM, kAddress, -50, nullptr, 0));
+}
+
+TEST_F(ScanFilterTest, service_uuid_short_and_long_forms) {
+  ApcfCommand cmd = command(BTM_BLE_PF_SRVC_UUID);
+  cmd.uuid = Uuid::From16Bit(0x180d);
+  engine_.Add(2, cmd);
+
+  EXPECT_TRUE(Match(field(BT_EIR_COMPLETE_16BITS_UUID_TYPE,
+                          {0x0f, 0x18, 0x0d, 0x18})));
+  Uuid::UUID128Bit uuid = Uuid::From16Bit(0x180d).To128BitLE();
+  EXPECT_TRUE(Match(field(BT_EIR_COMPLETE_128BITS_UUID_TYPE,
+                          std::vector<uint8_t>(uuid.begin(), uuid.end()))));
+  EXPECT_FALSE(Match(field(BT_EIR_COMPLETE_16BITS_UUID_TYPE, {0x0f, 0x18})));
+  /* Solicitation is a different feature */
+  EXPECT_FALSE(Match(field(0x14, {0x0d, 0x18})));
+}
+
+TEST_F(ScanFilterTest, service_uuid_mask) {
+  ApcfCommand cmd = command(BTM_BLE_PF_SRVC_UUID);
+  cmd.uuid = Uuid::From16Bit(0x1800);
+  cmd.uuid_mask = Uuid::From16Bit(0xff00);
+  engine_.Add(2, cmd);
+
+  EXPECT_TRUE(Match(field(BT_EIR_MORE_16BITS_UUID_TYPE, {0x42, 0x18})));
+  EXPECT_FALSE(Match(field(BT_EIR_MORE_16BITS_UUID_TYPE, {0x42, 0x19})));
+}
+
+TEST_F(ScanFilterTest, local_name_prefix) {
+  ApcfCommand cmd = command(BTM_BLE_PF_LOCAL_NAME);
+  std::string filter_name = "Pixel";
+  cmd.name.assign(filter_name.begin(), filter_name.end());
+  engine_.Add(3, cmd);
+
+  EXPECT_TRUE(Match(name("Pixel Buds")));
+  EXPECT_FALSE(Match(name("Pix")));
+  EXPECT_FALSE(Match(name("My Pixel")));
+}
+
+TEST_F(ScanFilterTest, manufacturer_data_with_mask) {
+  ApcfCommand cmd = command(BTM_BLE_PF_MANU_DATA);
+  cmd.company = 0x00e0;
+  cmd.data = {0x01, 0x20};
+  cmd.data_mask = {0xff, 0xf0};
+  engine_.Add(4, cmd);
+
+  EXPECT_TRUE(Match(field(BT_EIR_MANUFACTURER_SPECIFIC_TYPE,
+                          {0xe0, 0x00, 0x01, 0x2a, 0x99})));
+  EXPECT_FALSE(Match(field(BT_EIR_MANUFACTURER_SPECIFIC_TYPE,
+                           {0xe0, 0x00, 0x01, 0x3a})));
+  EXPECT_FALSE(Match(field(BT_EIR_MANUFACTURER_SPECIFIC_TYPE,
+                           {0x4c, 0x00, 0x01, 0x20})));
+}
+
+TEST_F(ScanFilterTest, manufacturer_company_only) {
+  ApcfCommand cmd = command(BTM_BLE_PF_MANU_DATA);
+  cmd.company = 0x004c;
+  cmd.data = {0x02};
+  engine_.Add(4, cmd);
+
+  /* Data without a mask is not matched, as with the controller */
+  EXPECT_TRUE(Match(field(BT_EIR_MANUFACTURER_SPECIFIC_TYPE,
+                          {0x4c, 0x00, 0x10})));
+}
+
+TEST_F(ScanFilterTest, service_data_pattern) {
+  ApcfCommand cmd = command(BTM_BLE_PF_SRVC_DATA_PATTERN);
+  cmd.data = {0xaa, 0xfe, 0x10};
+  cmd.data_mask = {0xff, 0xff, 0xff};
+  engine_.Add(5, cmd);
+
+  EXPECT_TRUE(Match(field(BT_EIR_SERVICE_DATA_16BITS_UUID_TYPE,
+                          {0xaa, 0xfe, 0x10, 0x00})));
+  EXPECT_FALSE(Match(field(BT_EIR_SERVICE_DATA_16BITS_UUID_TYPE,
+                           {0xaa, 0xfe, 0x20, 0x00})));
+}
+
+TEST_F(ScanFilterTest, feature_logic) {
+  ApcfCommand uuid = command(BTM_BLE_PF_SRVC_UUID);
+  uuid.uuid = Uuid::From16Bit(0xfeaa);
+  ApcfCommand local_name = command(BTM_BLE_PF_LOCAL_NAME);
+  local_name.name = {'b', 'e', 'a', 'c', 'o', 'n'};
+  engine_.Add(6, uuid);
+  engine_.Add(6, local_name);
+
+  std::vector<uint8_t> uuid_only =
+      field(BT_EIR_COMPLETE_16BITS_UUID_TYPE, {0xaa, 0xfe});
+  std::vector<uint8_t> both = uuid_only + name("beacon");
+
+  /* Without parameters all the features of the filter are required */
+  EXPECT_FALSE(Match(uuid_only));
+  EXPECT_TRUE(Match(both));
+
+  uint16_t feat_seln =
+      (1 << BTM_BLE_PF_SRVC_UUID) | (1 << BTM_BLE_PF_LOCAL_NAME);
+  engine_.SetParams(6, feat_seln, BTM_BLE_PF_LOGIC_OR, -128);
+  EXPECT_TRUE(Match(uuid_only));
+
+  engine_.SetParams(6, feat_seln, BTM_BLE_PF_LOGIC_AND, -60);
+  EXPECT_TRUE(Match(both));
+  EXPECT_FALSE(Match(both, kAddress, -70));
+
+  engine_.DeleteParams(6);
+  engine_.Clear(6);
+  EXPECT_FALSE(Match(both));
+}
+
+TEST_F(ScanFilterTest, many_filters) {
+  for (int i = 0; i < 200; i++) {
+    ApcfCommand cmd = command(BTM_BLE_PF_LOCAL_NAME);
+    std::string filter_name = "device " + std::to_string(i);
+    cmd.name.assign(filter_name.begin(), filter_name.end());
+    engine_.Add(i, cmd);
+  }
+
+  EXPECT_TRUE(Match(name("device 199")));
+  EXPECT_TRUE(Match(name("device 42")));
+  EXPECT_FALSE(Match(name("device")));
+  engine_.Clear(42);
+  /* Now "device 4" matches */
+  EXPECT_TRUE(Match(name("device 42")));
+  engine_.Clear(4);
+  EXPECT_FALSE(Match(name("device 42")));
+}
+
+TEST_F(ScanFilterTest, malformed_data) {
+  ApcfCommand cmd = command(BTM_BLE_PF_LOCAL_NAME);
+  cmd.name = {'a'};
+  engine_.Add(0, cmd);
+
+  EXPECT_FALSE(Match({0x05, BT_EIR_COMPLETE_LOCAL_NAME_TYPE, 'a'}));
+  EXPECT_FALSE(Match({0x00, 0x02, BT_EIR_COMPLETE_LOCAL_NAME_TYPE, 'a'}));
+}
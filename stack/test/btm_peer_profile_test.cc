@@ -0,0 +1,248 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+
+#include "btm_peer_profile.h"
+
+namespace {
+
+const RawAddress kPeer({0x11, 0x22, 0x33, 0x44, 0x55, 0x66});
+
+uint64_t now_us;
+uint64_t FakeClock() { return now_us; }
+
+class PeerProfileCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    now_us = 1000000;
+    cache_.reset(new PeerProfileCache(
+        FakeClock,
+        [this](const RawAddress& bd_addr, PeerProfile* p_profile) {
+          auto it = storage_.find(bd_addr);
+          if (it == storage_.end()) return false;
+          *p_profile = it->second;
+          return true;
+        },
+        [this](const RawAddress& bd_addr, const PeerProfile* p_profile) {
+          stores_++;
+          if (p_profile == nullptr) {
+            storage_.erase(bd_addr);
+          } else {
+            storage_[bd_addr] = *p_profile;
+          }
+        }));
+  }
+
+  /* An LE link created with a 50 ms interval */
+  static PeerProfile LeInitial() {
+    PeerProfile initial;
+    initial.conn_interval = 40;
+    initial.conn_latency = 0;
+    initial.supervision_tout = 500;
+    initial.tx_phy = 1;
+    initial.rx_phy = 1;
+    initial.tx_data_len = 27;
+    return initial;
+  }
+
+  std::unique_ptr<PeerProfileCache> cache_;
+  std::map<RawAddress, PeerProfile> storage_;
+  int stores_ = 0;
+};
+
+TEST_F(PeerProfileCacheTest, first_link_learns_what_it_settled_on) {
+  PeerProfile learned;
+  EXPECT_FALSE(cache_->OnLinkUp(kPeer, true, LeInitial(), &learned));
+
+  now_us += 2000000;
+  cache_->OnConnParams(kPeer, 12, 4, 600);
+  cache_->OnPhy(kPeer, 2, 2);
+  cache_->OnDataLength(kPeer, 251);
+  cache_->OnMtu(kPeer, 517);
+  now_us += 60000000;
+  cache_->OnLinkDown(kPeer, true, false);
+
+  ASSERT_EQ(storage_.count(kPeer), 1u);
+  const PeerProfile& stored = storage_[kPeer];
+  EXPECT_EQ(stored.conn_interval, 12);
+  EXPECT_EQ(stored.conn_latency, 4);
+  EXPECT_EQ(stored.supervision_tout, 600);
+  EXPECT_EQ(stored.tx_phy, 2);
+  EXPECT_EQ(stored.rx_phy, 2);
+  EXPECT_EQ(stored.tx_data_len, 251);
+  EXPECT_EQ(stored.att_mtu, 517);
+  EXPECT_EQ(stored.a2dp_level, -1);
+
+  EXPECT_TRUE(cache_->OnLinkUp(kPeer, true, LeInitial(), &learned));
+  EXPECT_EQ(learned.conn_interval, 12);
+  EXPECT_EQ(learned.tx_phy, 2);
+}
+
+TEST_F(PeerProfileCacheTest, profile_is_loaded_from_storage) {
+  PeerProfile stored;
+  stored.a2dp_level = 1;
+  storage_[kPeer] = stored;
+
+  PeerProfile learned;
+  EXPECT_TRUE(cache_->Get(kPeer, &learned));
+  EXPECT_EQ(learned.a2dp_level, 1);
+  EXPECT_EQ(learned.conn_interval, 0);
+}
+
+TEST_F(PeerProfileCacheTest, longest_held_conn_params_are_learned) {
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+
+  /* A transfer at a short interval, then idle at a long one */
+  now_us += 1000000;
+  cache_->OnConnParams(kPeer, 6, 0, 500);
+  now_us += 5000000;
+  cache_->OnConnParams(kPeer, 24, 2, 500);
+  now_us += 20000000;
+  /* A short transfer again just before disconnecting */
+  cache_->OnConnParams(kPeer, 6, 0, 500);
+  now_us += 2000000;
+  cache_->OnLinkDown(kPeer, true, false);
+
+  EXPECT_EQ(storage_[kPeer].conn_interval, 24);
+  EXPECT_EQ(storage_[kPeer].conn_latency, 2);
+}
+
+TEST_F(PeerProfileCacheTest, unreported_parameters_keep_learned_values) {
+  PeerProfile stored = LeInitial();
+  stored.tx_phy = 2;
+  stored.rx_phy = 2;
+  stored.att_mtu = 247;
+  stored.a2dp_level = 2;
+  storage_[kPeer] = stored;
+
+  /* An A2DP stream on the BR/EDR link does not touch the LE parameters */
+  PeerProfile bredr_initial;
+  cache_->OnLinkUp(kPeer, false, bredr_initial, nullptr);
+  cache_->OnA2dpLevel(kPeer, 3);
+  cache_->OnRssi(kPeer, false, -60);
+  cache_->OnLinkDown(kPeer, false, false);
+
+  EXPECT_EQ(storage_[kPeer].a2dp_level, 3);
+  EXPECT_EQ(storage_[kPeer].rssi, -60);
+  EXPECT_EQ(storage_[kPeer].tx_phy, 2);
+  EXPECT_EQ(storage_[kPeer].att_mtu, 247);
+}
+
+TEST_F(PeerProfileCacheTest, unchanged_profile_is_not_stored_again) {
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+  cache_->OnLinkDown(kPeer, true, false);
+  EXPECT_EQ(stores_, 1);
+
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+  cache_->OnLinkDown(kPeer, true, false);
+  EXPECT_EQ(stores_, 1);
+
+  /* Nor is a BR/EDR link reporting nothing */
+  cache_->OnLinkUp(kPeer, false, PeerProfile(), nullptr);
+  cache_->OnLinkDown(kPeer, false, false);
+  EXPECT_EQ(stores_, 1);
+}
+
+TEST_F(PeerProfileCacheTest, rssi_is_averaged) {
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+  cache_->OnRssi(kPeer, true, -40);
+  cache_->OnRssi(kPeer, true, PEER_PROFILE_NO_RSSI);
+  cache_->OnRssi(kPeer, true, -80);
+  cache_->OnLinkDown(kPeer, true, false);
+  EXPECT_EQ(storage_[kPeer].rssi, -50);
+}
+
+TEST_F(PeerProfileCacheTest, lost_link_learns_nothing) {
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+  cache_->OnPhy(kPeer, 3, 3);
+  cache_->OnLinkDown(kPeer, true, true);
+  EXPECT_EQ(stores_, 0);
+  EXPECT_EQ(storage_.count(kPeer), 0u);
+}
+
+TEST_F(PeerProfileCacheTest, lost_link_forgets_the_parameters_applied) {
+  PeerProfile stored = LeInitial();
+  stored.conn_interval = 800;
+  stored.tx_phy = 3;
+  stored.rx_phy = 3;
+  stored.a2dp_level = 1;
+  storage_[kPeer] = stored;
+
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+  cache_->OnApplied(kPeer, true, PeerProfileCache::kPhy);
+  cache_->OnLinkDown(kPeer, true, true);
+
+  /* The connection parameters were not applied: they are kept */
+  ASSERT_EQ(storage_.count(kPeer), 1u);
+  EXPECT_EQ(storage_[kPeer].tx_phy, 0);
+  EXPECT_EQ(storage_[kPeer].rx_phy, 0);
+  EXPECT_EQ(storage_[kPeer].conn_interval, 800);
+  EXPECT_EQ(storage_[kPeer].a2dp_level, 1);
+}
+
+TEST_F(PeerProfileCacheTest, profile_left_empty_is_erased) {
+  PeerProfile stored;
+  stored.tx_phy = 2;
+  stored.rx_phy = 2;
+  storage_[kPeer] = stored;
+
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+  cache_->OnApplied(kPeer, true, PeerProfileCache::kPhy);
+  cache_->OnLinkDown(kPeer, true, true);
+  EXPECT_EQ(storage_.count(kPeer), 0u);
+  PeerProfile learned;
+  EXPECT_FALSE(cache_->Get(kPeer, &learned));
+}
+
+TEST_F(PeerProfileCacheTest, applied_parameters_are_counted_once_per_link) {
+  PeerProfile stored = LeInitial();
+  stored.tx_phy = 2;
+  stored.rx_phy = 2;
+  storage_[kPeer] = stored;
+
+  cache_->OnLinkUp(kPeer, true, LeInitial(), nullptr);
+  cache_->OnApplied(kPeer, true, PeerProfileCache::kPhy);
+  cache_->OnApplied(kPeer, true, PeerProfileCache::kPhy);
+  /* No link: nothing to count */
+  cache_->OnApplied(kPeer, false, PeerProfileCache::kA2dpLevel);
+  cache_->OnPhy(kPeer, 2, 2);
+  cache_->OnLinkDown(kPeer, true, false);
+
+  FILE* file = tmpfile();
+  ASSERT_NE(file, nullptr);
+  cache_->Dump(fileno(file));
+  fflush(file);
+  rewind(file);
+  char line[256];
+  bool found = false;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    if (strstr(line, "Learned PHY") == nullptr) continue;
+    found = true;
+    EXPECT_NE(strstr(line, ": 1 / 1"), nullptr) << line;
+  }
+  fclose(file);
+  EXPECT_TRUE(found);
+}
+
+}  // namespace
@@ -0,0 +1,465 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <vector>
+
+#include "stack/btm/btm_sco_codec.h"
+#include "stack/btm/btm_sco_hci.h"
+
+namespace {
+
+constexpr uint16_t kHandle = 0x0006;
+
+std::vector<int16_t> Tone(double frequency, double amplitude, int sample_rate,
+                          size_t num_samples) {
+  std::vector<int16_t> pcm(num_samples);
+  for (size_t i = 0; i < num_samples; i++) {
+    pcm[i] = lrint(amplitude * sin(2 * M_PI * frequency * i / sample_rate));
+  }
+  return pcm;
+}
+
+/* Signal to noise ratio in dB of |decoded| against the tone it codes,
+ * delayed by |delay| samples. The first |skip| samples let the codec settle. */
+double ToneSnrAt(const std::vector<int16_t>& decoded, double frequency,
+                 double amplitude, int sample_rate, double delay, size_t skip) {
+  double signal = 0;
+  double noise = 0;
+  for (size_t i = skip; i < decoded.size(); i++) {
+    double expected =
+        amplitude * sin(2 * M_PI * frequency * (i - delay) / sample_rate);
+    signal += expected * expected;
+    noise += (decoded[i] - expected) * (decoded[i] - expected);
+  }
+  return 10 * log10(signal / noise);
+}
+
+/* Same at the delay of the codec, up to |max_delay| samples, found to 1/16
+ * sample */
+double ToneSnr(const std::vector<int16_t>& decoded, double frequency,
+               double amplitude, int sample_rate, int max_delay, size_t skip) {
+  int best_delay = 0;
+  double best_snr = -100;
+  for (int delay = 0; delay <= max_delay; delay++) {
+    double snr =
+        ToneSnrAt(decoded, frequency, amplitude, sample_rate, delay, skip);
+    if (snr > best_snr) {
+      best_snr = snr;
+      best_delay = delay;
+    }
+  }
+  for (double delay = best_delay - 1; delay <= best_delay + 1;
+       delay += 1.0 / 16) {
+    best_snr = std::max(best_snr, ToneSnrAt(decoded, frequency, amplitude,
+                                            sample_rate, delay, skip));
+  }
+  return best_snr;
+}
+
+std::vector<uint8_t> MsbcPackets(const std::vector<int16_t>& pcm) {
+  MsbcEncoder encoder;
+  encoder.Reset();
+  size_t num_frames = pcm.size() / kMsbcFrameSamples;
+  std::vector<uint8_t> packets(num_frames * kMsbcPacketBytes);
+  for (size_t i = 0; i < num_frames; i++) {
+    encoder.Encode(&pcm[i * kMsbcFrameSamples], &packets[i * kMsbcPacketBytes]);
+  }
+  return packets;
+}
+
+TEST(BtmScoCodecTest, cvsd_codes_voice_band_tone) {
+  std::vector<int16_t> pcm = Tone(500, 8000, 8000, 8000);
+  std::vector<uint8_t> bits(pcm.size());
+  std::vector<int16_t> decoded(pcm.size());
+
+  CvsdEncoder encoder;
+  CvsdDecoder decoder;
+  encoder.Encode(pcm.data(), pcm.size(), bits.data());
+  decoder.Decode(bits.data(), bits.size(), decoded.data());
+
+  EXPECT_GT(ToneSnr(decoded, 500, 8000, 8000, 2, 80), 25);
+
+  /* Idle pattern decodes to silence */
+  std::vector<uint8_t> idle(800, 0x55);
+  decoder.Decode(idle.data(), idle.size(), decoded.data());
+  for (size_t i = 400; i < idle.size(); i++) {
+    EXPECT_LT(abs(decoded[i]), 64) << i;
+  }
+}
+
+TEST(BtmScoCodecTest, msbc_round_trip) {
+  std::vector<int16_t> pcm = Tone(1000, 10000, 16000, 100 * kMsbcFrameSamples);
+  std::vector<uint8_t> packets = MsbcPackets(pcm);
+
+  /* H2 headers with their sequence numbers, and mSBC frames */
+  const uint8_t sequence[] = {0x08, 0x38, 0xc8, 0xf8};
+  for (size_t i = 0; i < 8; i++) {
+    const uint8_t* packet = &packets[i * kMsbcPacketBytes];
+    EXPECT_TRUE(MsbcIsPacketStart(packet));
+    EXPECT_EQ(packet[0], 0x01);
+    EXPECT_EQ(packet[1], sequence[i % 4]);
+    EXPECT_EQ(packet[2], 0xad);
+  }
+
+  MsbcDecoder decoder;
+  std::vector<int16_t> decoded(pcm.size());
+  for (size_t i = 0; i < pcm.size() / kMsbcFrameSamples; i++) {
+    EXPECT_TRUE(decoder.Decode(&packets[i * kMsbcPacketBytes],
+                               &decoded[i * kMsbcFrameSamples]));
+  }
+  EXPECT_GT(ToneSnr(decoded, 1000, 10000, 16000, 100, 240), 40);
+}
+
+TEST(BtmScoCodecTest, msbc_encoder_runs_along_with_sbc_encoder) {
+  std::vector<int16_t> pcm = Tone(1000, 10000, 16000, 50 * kMsbcFrameSamples);
+  std::vector<uint8_t> expected = MsbcPackets(pcm);
+
+  /* An A2DP stream coding between the mSBC frames */
+  SBC_ENC_PARAMS sbc;
+  memset(&sbc, 0, sizeof(sbc));
+  sbc.s16SamplingFreq = SBC_sf44100;
+  sbc.s16ChannelMode = SBC_JOINT_STEREO;
+  sbc.s16NumOfSubBands = 8;
+  sbc.s16NumOfChannels = 2;
+  sbc.s16NumOfBlocks = 16;
+  sbc.s16AllocationMethod = SBC_LOUDNESS;
+  sbc.s16BitPool = 53;
+  sbc.Format = SBC_FORMAT_GENERAL;
+  SBC_Encoder_Init(&sbc);
+  std::vector<int16_t> music = Tone(440, 20000, 44100, 16 * 8 * 2);
+  uint8_t sbc_frame[512];
+
+  MsbcEncoder encoder;
+  encoder.Reset();
+  std::vector<uint8_t> packets(expected.size());
+  for (size_t i = 0; i < pcm.size() / kMsbcFrameSamples; i++) {
+    SBC_Encode(&sbc, music.data(), sbc_frame);
+    encoder.Encode(&pcm[i * kMsbcFrameSamples], &packets[i * kMsbcPacketBytes]);
+  }
+  EXPECT_EQ(packets, expected);
+}
+
+TEST(BtmScoCodecTest, msbc_concealment_beats_silence) {
+  std::vector<int16_t> pcm = Tone(440, 10000, 16000, 200 * kMsbcFrameSamples);
+  std::vector<uint8_t> packets = MsbcPackets(pcm);
+
+  /* One frame in ten lost, never two in a row */
+  MsbcDecoder decoder;
+  std::vector<int16_t> concealed(pcm.size());
+  std::vector<int16_t> silenced(pcm.size());
+  srand(7);
+  for (size_t i = 0; i < pcm.size() / kMsbcFrameSamples; i++) {
+    bool lost = i > 4 && i % 10 == static_cast<size_t>(rand() % 10);
+    int16_t* out = &concealed[i * kMsbcFrameSamples];
+    EXPECT_EQ(decoder.Decode(lost ? nullptr : &packets[i * kMsbcPacketBytes],
+                             out),
+              !lost);
+    if (!lost) {
+      memcpy(&silenced[i * kMsbcFrameSamples], out,
+             kMsbcFrameSamples * sizeof(int16_t));
+    }
+  }
+
+  double concealed_snr = ToneSnr(concealed, 440, 10000, 16000, 100, 600);
+  double silenced_snr = ToneSnr(silenced, 440, 10000, 16000, 100, 600);
+  EXPECT_GT(concealed_snr, 20);
+  EXPECT_GT(concealed_snr, silenced_snr + 10);
+}
+
+/* Simulated controller on a fake clock */
+class ScoHciPathTest : public ::testing::Test {
+ protected:
+  ScoHciPathTest()
+      : path_(FakeClock, [this](uint16_t handle, const uint8_t* data,
+                                uint8_t len) {
+          EXPECT_EQ(handle, kHandle);
+          sent_.emplace_back(data, data + len);
+        }) {
+    now_us_ = 1000000;
+  }
+
+  static uint64_t FakeClock() { return now_us_; }
+
+  static uint64_t now_us_;
+  ScoHciPath path_;
+  std::deque<std::vector<uint8_t>> sent_;
+};
+
+uint64_t ScoHciPathTest::now_us_;
+
+TEST_F(ScoHciPathTest, reassembles_msbc_packets_and_resyncs) {
+  path_.Start(kHandle, ScoHciPath::Codec::kMsbc, 24);
+  ASSERT_EQ(path_.SampleRate(), 16000);
+  std::vector<int16_t> pcm = Tone(1000, 10000, 16000, 20 * kMsbcFrameSamples);
+  std::vector<uint8_t> stream = MsbcPackets(pcm);
+  /* Stray bytes after the fourth packet */
+  stream.insert(stream.begin() + 4 * kMsbcPacketBytes, 24, 0x01);
+
+  for (size_t offset = 0; offset < stream.size(); offset += 24) {
+    uint8_t len = std::min<size_t>(24, stream.size() - offset);
+    path_.OnRxPacket(BTM_SCO_PKT_STATUS_GOOD, &stream[offset], len);
+    now_us_ += len * 125;
+  }
+
+  ScoHciStats stats = path_.GetStats();
+  EXPECT_EQ(stats.frames_decoded, 20u);
+  EXPECT_EQ(stats.frames_concealed, 0u);
+  EXPECT_EQ(stats.resyncs, 1u);
+
+  /* Answered with packets of the same length, as mSBC packets */
+  ASSERT_GE(sent_.size(), 5u);
+  std::vector<uint8_t> tx;
+  for (const auto& packet : sent_) {
+    EXPECT_EQ(packet.size(), 24u);
+    tx.insert(tx.end(), packet.begin(), packet.end());
+  }
+  for (size_t offset = 0; offset + kMsbcPacketBytes <= tx.size();
+       offset += kMsbcPacketBytes) {
+    EXPECT_TRUE(MsbcIsPacketStart(&tx[offset])) << offset;
+  }
+
+  /* The ring keeps the last 40 ms */
+  int16_t out[20 * kMsbcFrameSamples];
+  EXPECT_EQ(path_.ReadPcm(out, 20 * kMsbcFrameSamples), 640u);
+  EXPECT_EQ(path_.GetStats().rx_ring_overruns, 20 * kMsbcFrameSamples - 640);
+}
+
+TEST_F(ScoHciPathTest, conceals_lost_packets) {
+  path_.Start(kHandle, ScoHciPath::Codec::kMsbc, 60);
+  std::vector<int16_t> pcm = Tone(1000, 10000, 16000, 10 * kMsbcFrameSamples);
+  std::vector<uint8_t> stream = MsbcPackets(pcm);
+
+  for (size_t i = 0; i < 10; i++) {
+    uint8_t* packet = &stream[i * kMsbcPacketBytes];
+    uint8_t status = BTM_SCO_PKT_STATUS_GOOD;
+    if (i == 3) {
+      status = BTM_SCO_PKT_STATUS_NO_DATA;
+      memset(packet, 0, kMsbcPacketBytes);
+    } else if (i == 5) {
+      status = BTM_SCO_PKT_STATUS_PARTIAL;
+    } else if (i == 7) {
+      /* Damaged data: the frame CRC catches it */
+      status = BTM_SCO_PKT_STATUS_INVALID;
+      packet[20] ^= 0xff;
+      packet[4] ^= 0xff;
+    }
+    path_.OnRxPacket(status, packet, kMsbcPacketBytes);
+    now_us_ += 7500;
+  }
+
+  ScoHciStats stats = path_.GetStats();
+  EXPECT_EQ(stats.rx_packets, 10u);
+  EXPECT_EQ(stats.rx_lost_packets, 1u);
+  EXPECT_EQ(stats.rx_error_packets, 2u);
+  EXPECT_EQ(stats.frames_decoded, 7u);
+  EXPECT_EQ(stats.frames_concealed, 3u);
+  EXPECT_EQ(stats.resyncs, 0u);
+
+  /* CVSD decodes lost packets from the idle pattern */
+  path_.Start(kHandle, ScoHciPath::Codec::kCvsd, 30);
+  uint8_t packet[30];
+  memset(packet, 0xff, sizeof(packet));
+  path_.OnRxPacket(BTM_SCO_PKT_STATUS_NO_DATA, packet, sizeof(packet));
+  int16_t out[30];
+  EXPECT_EQ(path_.ReadPcm(out, 30), 30u);
+  for (int16_t sample : out) EXPECT_LT(abs(sample), 64);
+  EXPECT_EQ(path_.GetStats().frames_concealed, 1u);
+}
+
+TEST_F(ScoHciPathTest, times_rx_packets) {
+  path_.Start(kHandle, ScoHciPath::Codec::kCvsd, 30);
+  uint8_t packet[30] = {};
+  const uint64_t gaps_us[] = {0, 3750, 3750, 3750, 9000, 500, 3750, 3750};
+  for (uint64_t gap_us : gaps_us) {
+    now_us_ += gap_us;
+    path_.OnRxPacket(BTM_SCO_PKT_STATUS_GOOD, packet, sizeof(packet));
+  }
+
+  ScoHciStats stats = path_.GetStats();
+  EXPECT_EQ(stats.rx_packets, 8u);
+  EXPECT_EQ(stats.rx_late_packets, 1u);
+  /* (9000 - 3750) / 16, then (3750 - 500) pulls it further */
+  EXPECT_GT(stats.rx_max_jitter_us, 500u);
+  EXPECT_LT(stats.rx_jitter_us, stats.rx_max_jitter_us);
+  EXPECT_GT(stats.rx_jitter_us, 0u);
+
+  /* One packet answered for each packet received, the early one included
+   * since the late one was not answered by a timer */
+  EXPECT_EQ(sent_.size(), 8u);
+}
+
+TEST_F(ScoHciPathTest, paces_tx_without_rx) {
+  path_.Start(kHandle, ScoHciPath::Codec::kCvsd, 30);
+  for (int i = 0; i < 9; i++) {
+    path_.SendDuePackets();
+    now_us_ += 1000;
+  }
+  /* One packet every 3.75 ms */
+  EXPECT_EQ(sent_.size(), 3u);
+
+  /* Held up for 20 ms: a burst, then the missed packets are skipped */
+  now_us_ += 20000;
+  path_.SendDuePackets();
+  EXPECT_EQ(sent_.size(), 5u);
+  ScoHciStats stats = path_.GetStats();
+  EXPECT_EQ(stats.tx_packets, 5u);
+  EXPECT_EQ(stats.tx_skipped_packets, 3u);
+  path_.SendDuePackets();
+  EXPECT_EQ(sent_.size(), 5u);
+
+  /* The RX packets take over, without sending twice per interval */
+  uint8_t packet[30] = {};
+  now_us_ += 1000;
+  path_.OnRxPacket(BTM_SCO_PKT_STATUS_GOOD, packet, sizeof(packet));
+  EXPECT_EQ(sent_.size(), 6u);
+  now_us_ += 3750;
+  path_.SendDuePackets();
+  path_.OnRxPacket(BTM_SCO_PKT_STATUS_GOOD, packet, sizeof(packet));
+  EXPECT_EQ(sent_.size(), 7u);
+}
+
+TEST_F(ScoHciPathTest, drops_oldest_audio_of_full_rings) {
+  path_.Start(kHandle, ScoHciPath::Codec::kCvsd, 30);
+  std::vector<int16_t> pcm(8000 * 100 / 1000, 1000);
+  EXPECT_EQ(path_.WritePcm(pcm.data(), pcm.size()), 320u);
+
+  uint8_t packet[30] = {};
+  for (int i = 0; i < 20; i++) {
+    path_.OnRxPacket(BTM_SCO_PKT_STATUS_GOOD, packet, sizeof(packet));
+    now_us_ += 3750;
+  }
+  int16_t out[400];
+  EXPECT_EQ(path_.ReadPcm(out, 400), 320u);
+
+  ScoHciStats stats = path_.GetStats();
+  EXPECT_EQ(stats.tx_ring_overruns, 800u - 320u);
+  EXPECT_EQ(stats.tx_ring_underruns, 20u * 30u - 320u);
+  EXPECT_EQ(stats.rx_ring_overruns, 20u * 30u - 320u);
+  EXPECT_EQ(stats.rx_ring_underruns, 80u);
+  EXPECT_EQ(stats.rx_ring_max_us, 40000u);
+  EXPECT_EQ(stats.tx_ring_max_us, 40000u);
+
+  path_.Stop();
+  EXPECT_EQ(path_.WritePcm(pcm.data(), pcm.size()), 0u);
+  EXPECT_EQ(path_.ReadPcm(out, 400), 0u);
+}
+
+/* Mouth to ear latency of the path, looped back by the remote device.
+ *
+ * At each eSCO anchor, the controller sends the oldest packet the host queued
+ * and receives the remote packet, which is the host packet of the previous
+ * interval sent back. The audio HAL writes the microphone audio captured
+ * during the last |kHalPeriodUs|, and reads the audio to play during the
+ * next one. */
+class ScoHciLoopbackTest : public ScoHciPathTest {
+ protected:
+  static constexpr uint64_t kHalPeriodUs = 10000;
+  static constexpr double kToneAmplitude = 8000;
+
+  /* Returns the latency in microseconds of a tone burst */
+  uint64_t MeasureLatency(ScoHciPath::Codec codec, uint8_t packet_len) {
+    path_.Start(kHandle, codec, packet_len);
+    const int rate = path_.SampleRate();
+    const size_t hal_samples = rate * kHalPeriodUs / 1000000;
+    const uint64_t interval_us = packet_len * 125;
+
+    /* Silence, then the burst from the 100th HAL period */
+    std::vector<int16_t> mic(200 * hal_samples);
+    const size_t onset = 100 * hal_samples + hal_samples / 3;
+    std::vector<int16_t> tone =
+        Tone(1000, kToneAmplitude, rate, mic.size() - onset);
+    std::copy(tone.begin(), tone.end(), mic.begin() + onset);
+    uint64_t onset_us = 0;
+
+    std::deque<std::vector<uint8_t>> air;
+    uint64_t start_us = now_us_;
+    uint64_t next_anchor_us = now_us_ + 1000;
+    uint64_t next_hal_us = now_us_ + kHalPeriodUs;
+    size_t mic_offset = 0;
+    std::vector<int16_t> speaker(hal_samples);
+
+    while (mic_offset < mic.size()) {
+      now_us_ = std::min(next_anchor_us, next_hal_us);
+      if (now_us_ == next_anchor_us) {
+        if (!air.empty()) {
+          path_.OnRxPacket(BTM_SCO_PKT_STATUS_GOOD, air.front().data(),
+                           air.front().size());
+          air.pop_front();
+        } else {
+          std::vector<uint8_t> none(packet_len);
+          path_.OnRxPacket(BTM_SCO_PKT_STATUS_NO_DATA, none.data(),
+                           none.size());
+        }
+        if (!sent_.empty()) {
+          air.push_back(sent_.front());
+          sent_.pop_front();
+        }
+        next_anchor_us += interval_us;
+      } else {
+        if (mic_offset <= onset && onset < mic_offset + hal_samples) {
+          onset_us = now_us_ - kHalPeriodUs +
+                     (onset - mic_offset) * 1000000 / rate;
+        }
+        path_.WritePcm(&mic[mic_offset], hal_samples);
+        mic_offset += hal_samples;
+        path_.ReadPcm(speaker.data(), hal_samples);
+        for (size_t i = 0; i < hal_samples; i++) {
+          if (onset_us != 0 && abs(speaker[i]) > kToneAmplitude / 4) {
+            return now_us_ + i * 1000000 / rate - onset_us;
+          }
+        }
+        next_hal_us += kHalPeriodUs;
+      }
+      path_.SendDuePackets();
+    }
+    ADD_FAILURE() << "tone not heard after " << now_us_ - start_us << " us";
+    return 0;
+  }
+};
+
+TEST_F(ScoHciLoopbackTest, mouth_to_ear_latency_cvsd) {
+  uint64_t latency_us = MeasureLatency(ScoHciPath::Codec::kCvsd, 30);
+  /* HAL periods on both ends, two eSCO intervals and the rings */
+  EXPECT_GT(latency_us, 2 * kHalPeriodUs);
+  EXPECT_LT(latency_us, 40000u);
+  ScoHciStats stats = path_.GetStats();
+  EXPECT_EQ(stats.tx_skipped_packets, 0u);
+  EXPECT_EQ(stats.rx_ring_overruns, 0u);
+  EXPECT_EQ(stats.tx_ring_overruns, 0u);
+}
+
+TEST_F(ScoHciLoopbackTest, mouth_to_ear_latency_msbc) {
+  uint64_t latency_us = MeasureLatency(ScoHciPath::Codec::kMsbc, 60);
+  /* Plus the frames and the codec delay of mSBC */
+  EXPECT_GT(latency_us, 2 * kHalPeriodUs);
+  EXPECT_LT(latency_us, 50000u);
+  ScoHciStats stats = path_.GetStats();
+  EXPECT_EQ(stats.tx_skipped_packets, 0u);
+  EXPECT_EQ(stats.rx_ring_overruns, 0u);
+  EXPECT_EQ(stats.tx_ring_overruns, 0u);
+  EXPECT_EQ(stats.resyncs, 0u);
+}
+
+}  // namespace
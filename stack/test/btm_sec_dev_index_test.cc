@@ -0,0 +1,253 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+#include "bt_target.h"
+#include "stack/btm/btm_sec_dev_index.h"
+
+namespace {
+
+/* The record list as btm_cb.sec_dev_rec keeps it, in allocation order, and
+ * the lookups the stack did before the index: the first record of the list
+ * with a matching field. */
+class RecordList {
+ public:
+  ~RecordList() {
+    for (auto* p_dev_rec : records_) free(p_dev_rec);
+  }
+
+  tBTM_SEC_DEV_REC* Allocate() {
+    auto* p_dev_rec =
+        static_cast<tBTM_SEC_DEV_REC*>(calloc(1, sizeof(tBTM_SEC_DEV_REC)));
+    records_.push_back(p_dev_rec);
+    index_.Add(p_dev_rec);
+    return p_dev_rec;
+  }
+
+  void Free(size_t i) {
+    index_.Remove(records_[i]);
+    free(records_[i]);
+    records_.erase(records_.begin() + i);
+  }
+
+  tBTM_SEC_DEV_REC* ScanByAddress(const RawAddress& bd_addr) const {
+    for (auto* p_dev_rec : records_) {
+      if (p_dev_rec->bd_addr == bd_addr) return p_dev_rec;
+      if (p_dev_rec->ble.pseudo_addr == bd_addr) return p_dev_rec;
+    }
+    return nullptr;
+  }
+
+  tBTM_SEC_DEV_REC* ScanByIdentityAddress(const RawAddress& bd_addr) const {
+    for (auto* p_dev_rec : records_) {
+      if (p_dev_rec->ble.identity_addr == bd_addr) return p_dev_rec;
+    }
+    return nullptr;
+  }
+
+  tBTM_SEC_DEV_REC* ScanByHandle(uint16_t handle) const {
+    for (auto* p_dev_rec : records_) {
+      if (p_dev_rec->hci_handle == handle ||
+          p_dev_rec->ble_hci_handle == handle)
+        return p_dev_rec;
+    }
+    return nullptr;
+  }
+
+  std::vector<tBTM_SEC_DEV_REC*> records_;
+  SecDevRecIndex index_;
+};
+
+RawAddress MakeAddress(uint32_t n) {
+  RawAddress addr;
+  addr.address[0] = 0xc0;
+  addr.address[1] = 0x11;
+  addr.address[2] = n >> 24;
+  addr.address[3] = n >> 16;
+  addr.address[4] = n >> 8;
+  addr.address[5] = n;
+  return addr;
+}
+
+TEST(SecDevRecIndexTest, finds_records_by_each_key) {
+  RecordList list;
+  tBTM_SEC_DEV_REC* p_dev_rec = list.Allocate();
+  p_dev_rec->bd_addr = MakeAddress(1);
+  p_dev_rec->ble.pseudo_addr = MakeAddress(2);
+  p_dev_rec->ble.identity_addr = MakeAddress(3);
+  p_dev_rec->hci_handle = 0x0001;
+  p_dev_rec->ble_hci_handle = 0x0040;
+  list.index_.Update(p_dev_rec);
+
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(1)), p_dev_rec);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(2)), p_dev_rec);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(3)), nullptr);
+  EXPECT_EQ(list.index_.FindByIdentityAddress(MakeAddress(3)), p_dev_rec);
+  EXPECT_EQ(list.index_.FindByIdentityAddress(MakeAddress(1)), nullptr);
+  EXPECT_EQ(list.index_.FindByHandle(0x0001), p_dev_rec);
+  EXPECT_EQ(list.index_.FindByHandle(0x0040), p_dev_rec);
+  EXPECT_EQ(list.index_.FindByHandle(0x0002), nullptr);
+}
+
+TEST(SecDevRecIndexTest, follows_updates_and_removal) {
+  RecordList list;
+  tBTM_SEC_DEV_REC* p_dev_rec = list.Allocate();
+  p_dev_rec->bd_addr = MakeAddress(1);
+  p_dev_rec->hci_handle = 0x0001;
+  list.index_.Update(p_dev_rec);
+
+  /* LE pairing replaces the random address with the identity address */
+  p_dev_rec->bd_addr = MakeAddress(9);
+  p_dev_rec->hci_handle = BTM_SEC_INVALID_HANDLE;
+  list.index_.Update(p_dev_rec);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(1)), nullptr);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(9)), p_dev_rec);
+  EXPECT_EQ(list.index_.FindByHandle(0x0001), nullptr);
+
+  list.Free(0);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(9)), nullptr);
+  EXPECT_EQ(list.index_.size(), 0u);
+}
+
+TEST(SecDevRecIndexTest, shared_keys_resolve_to_the_oldest_record) {
+  RecordList list;
+  tBTM_SEC_DEV_REC* first = list.Allocate();
+  tBTM_SEC_DEV_REC* second = list.Allocate();
+
+  /* The newer record takes the key first */
+  second->bd_addr = MakeAddress(5);
+  second->hci_handle = 0x0002;
+  list.index_.Update(second);
+  first->ble.pseudo_addr = MakeAddress(5);
+  first->ble_hci_handle = 0x0002;
+  list.index_.Update(first);
+
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(5)), first);
+  EXPECT_EQ(list.index_.FindByHandle(0x0002), first);
+
+  list.Free(0);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(5)), second);
+  EXPECT_EQ(list.index_.FindByHandle(0x0002), second);
+}
+
+TEST(SecDevRecIndexTest, both_keys_of_a_record_can_be_equal) {
+  RecordList list;
+  tBTM_SEC_DEV_REC* p_dev_rec = list.Allocate();
+  p_dev_rec->bd_addr = MakeAddress(7);
+  p_dev_rec->ble.pseudo_addr = MakeAddress(7);
+  p_dev_rec->hci_handle = 0x0003;
+  p_dev_rec->ble_hci_handle = 0x0003;
+  list.index_.Update(p_dev_rec);
+
+  p_dev_rec->ble.pseudo_addr = MakeAddress(8);
+  p_dev_rec->ble_hci_handle = 0x0004;
+  list.index_.Update(p_dev_rec);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(7)), p_dev_rec);
+  EXPECT_EQ(list.index_.FindByHandle(0x0003), p_dev_rec);
+
+  p_dev_rec->bd_addr = MakeAddress(8);
+  p_dev_rec->hci_handle = 0x0004;
+  list.index_.Update(p_dev_rec);
+  EXPECT_EQ(list.index_.FindByAddress(MakeAddress(7)), nullptr);
+  EXPECT_EQ(list.index_.FindByHandle(0x0003), nullptr);
+}
+
+TEST(SecDevRecIndexTest, empty_address_and_invalid_handle_are_not_indexed) {
+  EXPECT_FALSE(SecDevRecIndex::IsIndexed(RawAddress::kEmpty));
+  EXPECT_FALSE(SecDevRecIndex::IsIndexed(
+      static_cast<uint16_t>(BTM_SEC_INVALID_HANDLE)));
+
+  RecordList list;
+  list.Allocate();
+  EXPECT_EQ(list.index_.FindByAddress(RawAddress::kEmpty), nullptr);
+  EXPECT_EQ(list.index_.FindByHandle(BTM_SEC_INVALID_HANDLE), nullptr);
+}
+
+/* Random allocations, frees and key writes over small pools of addresses and
+ * handles, so that records keep sharing keys; after each step every indexed
+ * lookup must return what a scan of the list returns. */
+TEST(SecDevRecIndexTest, equivalent_to_list_scan) {
+  constexpr int kSteps = 20000;
+  constexpr uint32_t kAddresses = 40;
+  constexpr uint16_t kHandles = 24;
+
+  std::mt19937 gen(42);
+  auto random = [&gen](uint32_t n) {
+    return std::uniform_int_distribution<uint32_t>(0, n - 1)(gen);
+  };
+  auto random_address = [&]() {
+    uint32_t n = random(kAddresses + 1);
+    return n == kAddresses ? RawAddress::kEmpty : MakeAddress(n);
+  };
+  auto random_handle = [&]() -> uint16_t {
+    uint32_t n = random(kHandles + 1);
+    return n == kHandles ? BTM_SEC_INVALID_HANDLE : n;
+  };
+
+  RecordList list;
+  for (int step = 0; step < kSteps; step++) {
+    uint32_t op = random(10);
+    if (op < 2 || list.records_.empty()) {
+      list.Allocate();
+    } else if (op < 3) {
+      list.Free(random(list.records_.size()));
+    } else {
+      tBTM_SEC_DEV_REC* p_dev_rec = list.records_[random(list.records_.size())];
+      switch (random(5)) {
+        case 0:
+          p_dev_rec->bd_addr = random_address();
+          break;
+        case 1:
+          p_dev_rec->ble.pseudo_addr = random_address();
+          break;
+        case 2:
+          p_dev_rec->ble.identity_addr = random_address();
+          break;
+        case 3:
+          p_dev_rec->hci_handle = random_handle();
+          break;
+        default:
+          p_dev_rec->ble_hci_handle = random_handle();
+          break;
+      }
+      list.index_.Update(p_dev_rec);
+    }
+
+    ASSERT_EQ(list.index_.size(), list.records_.size());
+    for (uint32_t n = 0; n < kAddresses; n++) {
+      RawAddress addr = MakeAddress(n);
+      ASSERT_EQ(list.index_.FindByAddress(addr), list.ScanByAddress(addr))
+          << "step " << step;
+      ASSERT_EQ(list.index_.FindByIdentityAddress(addr),
+                list.ScanByIdentityAddress(addr))
+          << "step " << step;
+    }
+    for (uint16_t handle = 0; handle < kHandles; handle++) {
+      ASSERT_EQ(list.index_.FindByHandle(handle), list.ScanByHandle(handle))
+          << "step " << step;
+    }
+  }
+}
+
+}  // namespace
@@ -79,8 +79,8 @@ void gatt_act_discovery(tGATT_CLCB* p_clcb) {}
 bool gatt_disconnect(tGATT_TCB* p_tcb) { return false; }
 tGATT_CH_STATE gatt_get_ch_state(tGATT_TCB* p_tcb) { return 0; }
 tGATT_STATUS gatts_db_read_attr_value_by_type(
-    tGATT_TCB& tcb, tGATT_SVC_DB* p_db, uint8_t op_code, BT_HDR* p_rsp,
-    uint16_t s_handle, uint16_t e_handle, const Uuid& type, uint16_t* p_len,
+    tGATT_TCB& tcb, uint8_t op_code, BT_HDR* p_rsp, uint16_t s_handle,
+    uint16_t e_handle, const Uuid& type, uint16_t* p_len,
     tGATT_SEC_FLAG sec_flag, uint8_t key_size, uint32_t trans_id,
     uint16_t* p_cur_handle) {
   return 0;
@@ -318,3 +318,152 @@ TEST_F(GattSrTest, gatts_process_write_req_request_write_typical) {
         false);
   CHECK(test_state_.application_request_callback.data_.write_req.len == length);
 }
+
+namespace {
+/* Adds a started service with |num_attr| attributes to srv_list_info. The
+ * first attribute is the service declaration, the others alternate between
+ * characteristic declarations and values of 16 bit UUID |char_uuid|. */
+void AddService(tGATT_SVC_DB& db, uint16_t s_hdl, uint16_t num_attr,
+                uint16_t char_uuid) {
+  db.attr_list.clear();
+  for (uint16_t i = 0; i < num_attr; i++) {
+    tGATT_ATTR attr;
+    attr.handle = s_hdl + i;
+    attr.permission = GATT_PERM_READ;
+    if (i == 0) {
+      attr.uuid = Uuid::From16Bit(GATT_UUID_PRI_SERVICE);
+      attr.gatt_type = BTGATT_DB_PRIMARY_SERVICE;
+    } else if (i % 2) {
+      attr.uuid = Uuid::From16Bit(GATT_UUID_CHAR_DECLARE);
+      attr.gatt_type = BTGATT_DB_CHARACTERISTIC;
+    } else {
+      attr.uuid = Uuid::From16Bit(char_uuid);
+      attr.gatt_type = BTGATT_DB_CHARACTERISTIC;
+    }
+    db.attr_list.emplace_back(std::move(attr));
+  }
+  db.end_handle = s_hdl + num_attr - 1;
+
+  tGATT_SRV_LIST_ELEM el;
+  memset(&el, 0, sizeof(el));
+  el.gatt_if = 1;
+  el.s_hdl = s_hdl;
+  el.e_hdl = db.end_handle;
+  el.p_db = &db;
+  el.is_primary = true;
+  gatt_cb.srv_list_info->push_back(el);
+}
+}  // namespace
+
+class GattSrAttrIndexTest : public GattSrTest {
+ protected:
+  void SetUp() override {
+    GattSrTest::SetUp();
+    gatt_cb.srv_list_info = new std::list<tGATT_SRV_LIST_ELEM>();
+
+    /* two services with a gap of unused handles in between */
+    AddService(db_[0], 0x0001, 5, 0x2A00);
+    AddService(db_[1], 0x0010, 7, 0x2A01);
+    gatt_sr_rebuild_attr_index();
+  }
+
+  void TearDown() override {
+    delete gatt_cb.srv_list_info;
+    gatt_cb.srv_list_info = nullptr;
+    gatt_sr_rebuild_attr_index();
+    GattSrTest::TearDown();
+  }
+
+  tGATT_SVC_DB db_[2];
+};
+
+TEST_F(GattSrAttrIndexTest, find_service_by_handle) {
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0000),
+            gatt_cb.srv_list_info->end());
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0001)->s_hdl, 0x0001);
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0005)->s_hdl, 0x0001);
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0006),
+            gatt_cb.srv_list_info->end());
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0010)->s_hdl, 0x0010);
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0016)->s_hdl, 0x0010);
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0017),
+            gatt_cb.srv_list_info->end());
+}
+
+TEST_F(GattSrAttrIndexTest, find_attr_by_handle) {
+  const tGATT_ATTR_INDEX_ELEM* p_el = gatt_sr_find_attr_by_handle(0x0012);
+  ASSERT_NE(p_el, nullptr);
+  EXPECT_EQ(p_el->p_attr, &db_[1].attr_list[2]);
+  EXPECT_EQ(p_el->srv_it->s_hdl, 0x0010);
+
+  EXPECT_EQ(gatt_sr_find_attr_by_handle(0x0008), nullptr);
+  EXPECT_EQ(gatt_sr_find_attr_by_handle(0xFFFF), nullptr);
+}
+
+TEST_F(GattSrAttrIndexTest, find_attrs_by_type_in_range) {
+  tGATT_ATTR_INDEX_RANGE range =
+      gatt_sr_find_attrs_by_type(Uuid::From16Bit(GATT_UUID_CHAR_DECLARE),
+                                 0x0002, 0x0011);
+  std::vector<uint16_t> handles;
+  for (auto* el = range.first; el != range.second; el++)
+    handles.push_back(el->handle);
+  EXPECT_EQ(handles, std::vector<uint16_t>({0x0002, 0x0004, 0x0011}));
+
+  range = gatt_sr_find_attrs_by_type(Uuid::From16Bit(0x2A01), 0x0001, 0x0005);
+  EXPECT_EQ(range.first, range.second);
+
+  range = gatt_sr_find_attrs_by_type(Uuid::From16Bit(0x1234), 0x0001, 0xFFFF);
+  EXPECT_EQ(range.first, range.second);
+}
+
+TEST_F(GattSrAttrIndexTest, find_info_spans_services) {
+  BT_HDR* p_msg = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + 64 + L2CAP_MIN_OFFSET);
+  uint16_t len = 64;
+
+  EXPECT_EQ(gatt_build_find_info_rsp(p_msg, len, 0x0004, 0x0011),
+            GATT_SUCCESS);
+
+  /* 0x0004, 0x0005, 0x0010 and 0x0011 as 16 bit handle/UUID pairs */
+  EXPECT_EQ(p_msg->offset, GATT_INFO_TYPE_PAIR_16);
+  EXPECT_EQ(p_msg->len, 4 * 4);
+  EXPECT_EQ(len, 64 - 4 * 4);
+
+  uint8_t* p = (uint8_t*)(p_msg + 1) + L2CAP_MIN_OFFSET + 2 * 4;
+  uint16_t handle;
+  STREAM_TO_UINT16(handle, p);
+  EXPECT_EQ(handle, 0x0010);
+
+  osi_free(p_msg);
+}
+
+TEST_F(GattSrAttrIndexTest, find_info_stops_when_full) {
+  BT_HDR* p_msg = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + 64 + L2CAP_MIN_OFFSET);
+  uint16_t len = 9;
+
+  EXPECT_EQ(gatt_build_find_info_rsp(p_msg, len, 0x0001, 0xFFFF),
+            GATT_SUCCESS);
+  EXPECT_EQ(p_msg->len, 2 * 4);
+  EXPECT_EQ(len, 1);
+
+  osi_free(p_msg);
+}
+
+TEST_F(GattSrAttrIndexTest, find_info_not_found) {
+  BT_HDR* p_msg = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + 64 + L2CAP_MIN_OFFSET);
+  uint16_t len = 64;
+
+  EXPECT_EQ(gatt_build_find_info_rsp(p_msg, len, 0x0006, 0x000F),
+            GATT_NOT_FOUND);
+
+  osi_free(p_msg);
+}
+
+TEST_F(GattSrAttrIndexTest, stop_service_updates_index) {
+  gatt_cb.srv_list_info->pop_front();
+  gatt_sr_rebuild_attr_index();
+
+  EXPECT_EQ(gatt_sr_find_i_rcb_by_handle(0x0001),
+            gatt_cb.srv_list_info->end());
+  EXPECT_EQ(gatt_sr_find_attr_by_handle(0x0001), nullptr);
+  EXPECT_NE(gatt_sr_find_attr_by_handle(0x0010), nullptr);
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* ERTM stress test: two channels exchange SDUs over a link that loses frames
+ * at a configurable rate. The link and the ERTM timers run on virtual time,
+ * one millisecond per frame, so the test covers REJ, SREJ and poll recovery
+ * deterministically. */
+
+#include <base/logging.h>
+#include <gtest/gtest.h>
+#include <time.h>
+#include <deque>
+#include <random>
+#include <string>
+
+#include "osi/test/AllocationTestHarness.h"
+#include "stack/l2cap/l2c_fcr.cc"
+#include "stack/test/l2cap/l2c_test_stubs.h"
+
+namespace {
+
+constexpr uint16_t kSduSize = 1000;
+constexpr uint16_t kMps = 300;
+constexpr uint8_t kTxWindow = 16;
+constexpr int kSdusQueued = 4;
+
+struct Frame {
+  tL2C_CCB* dest;
+  BT_HDR* packet;
+};
+
+/* State of one stress run, shared with the stack stubs */
+struct Link {
+  tL2C_LCB lcb[2];
+  tL2C_CCB ccb[2];
+  std::deque<Frame> air;
+  std::mt19937 rng;
+  int loss_percent;
+
+  uint32_t sdus_delivered;
+  uint64_t bytes_delivered;
+  uint64_t bytes_on_air;
+  uint32_t frames_lost;
+  bool disconnected;
+  bool corrupted;
+};
+
+Link* test_link;
+
+tL2C_CCB* peer_of(tL2C_LCB* p_lcb) {
+  return p_lcb == &test_link->lcb[0] ? &test_link->ccb[1] : &test_link->ccb[0];
+}
+
+void send_on_air(tL2C_CCB* dest, BT_HDR* p_buf) {
+  test_link->bytes_on_air += p_buf->len;
+  if (std::uniform_int_distribution<int>(0, 99)(test_link->rng) <
+      test_link->loss_percent) {
+    test_link->frames_lost++;
+    osi_free(p_buf);
+    return;
+  }
+  test_link->air.push_back({dest, p_buf});
+}
+
+/* Sends what the channel may send, like l2cu_get_next_buffer_to_send() */
+void pump(tL2C_CCB* p_ccb) {
+  while (p_ccb->in_use && !p_ccb->fcrb.wait_ack && !p_ccb->fcrb.remote_busy) {
+    if (fixed_queue_is_empty(p_ccb->fcrb.retrans_q) &&
+        (fixed_queue_is_empty(p_ccb->xmit_hold_q) ||
+         l2c_fcr_is_flow_controlled(p_ccb)))
+      return;
+    BT_HDR* p_buf = l2c_fcr_get_next_xmit_sdu_seg(p_ccb, 0);
+    if (p_buf == NULL) return;
+    send_on_air(peer_of(p_ccb->p_lcb), p_buf);
+  }
+}
+
+BT_HDR* make_sdu(uint32_t index) {
+  BT_HDR* p_buf = (BT_HDR*)osi_malloc(BT_HDR_SIZE + L2CAP_MIN_OFFSET +
+                                      kSduSize + L2CAP_FCS_LEN +
+                                      sizeof(uint32_t));
+  p_buf->offset = L2CAP_MIN_OFFSET;
+  p_buf->len = kSduSize;
+  p_buf->event = 0;
+  p_buf->layer_specific = 0;
+  uint8_t* p = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  for (uint16_t i = 0; i < kSduSize; i++) p[i] = (uint8_t)(index + i);
+  return p_buf;
+}
+
+void setup_channel(int i, uint16_t local_cid, uint16_t remote_cid) {
+  tL2C_CCB* p_ccb = &test_link->ccb[i];
+  test_link->lcb[i].link_xmit_data_q = list_new(NULL);
+  p_ccb->p_lcb = &test_link->lcb[i];
+  p_ccb->in_use = true;
+  p_ccb->chnl_state = CST_OPEN;
+  p_ccb->local_cid = local_cid;
+  p_ccb->remote_cid = remote_cid;
+  p_ccb->max_rx_mtu = kSduSize;
+  p_ccb->tx_mps = kMps;
+  p_ccb->ertm_info.fcr_rx_buf_size = L2CAP_FCR_RX_BUF_SIZE;
+  p_ccb->our_cfg.fcr.mode = p_ccb->peer_cfg.fcr.mode = L2CAP_FCR_ERTM_MODE;
+  p_ccb->our_cfg.fcr.tx_win_sz = p_ccb->peer_cfg.fcr.tx_win_sz = kTxWindow;
+  p_ccb->peer_cfg.fcr.max_transmit = 0; /* retry forever */
+  p_ccb->our_cfg.fcr.rtrans_tout = 200;
+  p_ccb->our_cfg.fcr.mon_tout = 1000;
+  p_ccb->fcrb.max_held_acks = kTxWindow / 3;
+  p_ccb->fcrb.ack_timer = alarm_new("ack_timer");
+  p_ccb->fcrb.mon_retrans_timer = alarm_new("mon_retrans_timer");
+  p_ccb->xmit_hold_q = fixed_queue_new(SIZE_MAX);
+  p_ccb->fcrb.srej_rcv_hold_q = fixed_queue_new(SIZE_MAX);
+  p_ccb->fcrb.retrans_q = fixed_queue_new(SIZE_MAX);
+}
+
+void release_channel(int i) {
+  tL2C_CCB* p_ccb = &test_link->ccb[i];
+  l2c_fcr_cleanup(p_ccb);
+  fixed_queue_free(p_ccb->xmit_hold_q, osi_free);
+  list_free(test_link->lcb[i].link_xmit_data_q);
+}
+
+void disconnect_chnl(tL2C_CCB* p_ccb) { test_link->disconnected = true; }
+
+void link_check_send_pkts(tL2C_LCB* p_lcb, tL2C_CCB* p_ccb, BT_HDR* p_buf) {
+  /* S-frames go out right away, I-frames are pulled by the link loop */
+  if (p_buf != NULL) send_on_air(peer_of(p_lcb), p_buf);
+}
+
+void csm_execute(tL2C_CCB* p_ccb, uint16_t event, void* p_data) {
+  BT_HDR* p_buf = (BT_HDR*)p_data;
+  uint8_t* p = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  bool intact = (p_buf->len == kSduSize);
+  for (uint16_t i = 0; intact && i < kSduSize; i++)
+    intact = (p[i] == (uint8_t)(test_link->sdus_delivered + i));
+  if (!intact) test_link->corrupted = true;
+  test_link->sdus_delivered++;
+  test_link->bytes_delivered += p_buf->len;
+  osi_free(p_buf);
+}
+
+/* Share of the bytes on air that are SDU data, given the loss rate in percent.
+ * Without loss only the headers and the acknowledgments are overhead, each
+ * lost frame costs at least its retransmission and the recovery frames. */
+double MinGoodputPercent(int loss_percent) {
+  switch (loss_percent) {
+    case 0:
+      return 95.0;
+    case 1:
+      return 90.0;
+    case 5:
+      return 70.0;
+    default:
+      return 30.0;
+  }
+}
+
+}  // namespace
+
+class ErtmStressTest : public AllocationTestHarness,
+                       public ::testing::WithParamInterface<int> {
+ protected:
+  void SetUp() override {
+    AllocationTestHarness::SetUp();
+    test_link = new Link();
+    test_link->rng.seed(GetParam() + 1);
+    test_link->loss_percent = GetParam();
+    l2c_test_now_us = 0;
+    l2c_test_hooks = {csm_execute, link_check_send_pkts, disconnect_chnl};
+    setup_channel(0, 0x0040, 0x0041);
+    setup_channel(1, 0x0041, 0x0040);
+  }
+
+  void TearDown() override {
+    for (const Frame& frame : test_link->air) osi_free(frame.packet);
+    release_channel(0);
+    release_channel(1);
+    delete test_link;
+    test_link = nullptr;
+    l2c_test_hooks = {};
+    AllocationTestHarness::TearDown();
+  }
+
+  /* Sends |num_sdus| SDUs from channel 0 to channel 1 */
+  void Run(uint32_t num_sdus) {
+    tL2C_CCB* sender = &test_link->ccb[0];
+    tL2C_CCB* receiver = &test_link->ccb[1];
+    uint32_t sdus_written = 0;
+    int steps = 0;
+
+    clock_t start = clock();
+    while (test_link->sdus_delivered < num_sdus ||
+           sender->fcrb.num_waiting_for_ack != 0) {
+      ASSERT_LT(++steps, 10000000) << "the transfer stalled";
+      ASSERT_FALSE(test_link->disconnected);
+
+      while (sdus_written < num_sdus &&
+             fixed_queue_length(sender->xmit_hold_q) < kSdusQueued)
+        fixed_queue_enqueue(sender->xmit_hold_q, make_sdu(sdus_written++));
+      pump(sender);
+
+      if (test_link->air.empty()) {
+        ASSERT_TRUE(l2c_test_fire_next_alarm())
+            << "nothing to send and no timer";
+        continue;
+      }
+
+      Frame frame = test_link->air.front();
+      test_link->air.pop_front();
+      l2c_test_now_us += 1000;
+      /* The receiver gets the PDU after the basic L2CAP header */
+      frame.packet->offset += L2CAP_PKT_OVERHEAD;
+      frame.packet->len -= L2CAP_PKT_OVERHEAD;
+      l2c_fcr_proc_pdu(frame.dest, frame.packet);
+      l2c_test_fire_due_alarms();
+    }
+    double cpu_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    EXPECT_FALSE(test_link->corrupted);
+    EXPECT_EQ(num_sdus, test_link->sdus_delivered);
+    EXPECT_EQ(0u, receiver->fcrb.num_waiting_for_ack);
+
+    /* Frames are only lost and sent again when the link loses them */
+    EXPECT_EQ(test_link->loss_percent == 0, test_link->frames_lost == 0u);
+    double goodput_percent =
+        100.0 * test_link->bytes_delivered / test_link->bytes_on_air;
+    EXPECT_GE(goodput_percent, MinGoodputPercent(test_link->loss_percent));
+
+    /* Reported in the test output XML, to compare runs and builds */
+    double mb = test_link->bytes_delivered / (1024.0 * 1024.0);
+    RecordProperty("goodput_percent", std::to_string(goodput_percent));
+    RecordProperty("bytes_on_air", std::to_string(test_link->bytes_on_air));
+    RecordProperty("frames_lost", test_link->frames_lost);
+    RecordProperty("cpu_ms_per_mb", std::to_string(cpu_s * 1000 / mb));
+  }
+};
+
+TEST_P(ErtmStressTest, transfer_completes_in_order) { Run(2000); }
+
+/* Loss rates in percent */
+INSTANTIATE_TEST_CASE_P(LossRates, ErtmStressTest,
+                        ::testing::Values(0, 1, 5, 20));
+
+/* The unacked frames are found by TxSeq across the sequence number wrap */
+TEST(ErtmWindowTest, find_across_wrap) {
+  tL2C_FCRB fcrb = {};
+  BT_HDR frames[8];
+  fcrb.last_rx_ack = L2CAP_FCR_SEQ_MODULO - 2;
+  for (BT_HDR& frame : frames) wack_push(&fcrb, &frame);
+
+  EXPECT_EQ(8u, fcrb.num_waiting_for_ack);
+  for (uint8_t i = 0; i < 8; i++) {
+    EXPECT_EQ(&frames[i],
+              wack_find(&fcrb, (L2CAP_FCR_SEQ_MODULO - 2 + i) &
+                                   L2CAP_FCR_SEQ_MODULO));
+  }
+  EXPECT_EQ(nullptr, wack_find(&fcrb, 6));
+  EXPECT_EQ(nullptr, wack_find(&fcrb, L2CAP_FCR_SEQ_MODULO - 3));
+}
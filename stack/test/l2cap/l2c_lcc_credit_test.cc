@@ -0,0 +1,222 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* LE CoC receive window test: a remote sends K-frames at a fixed rate as long
+ * as it has credits, and the credits we return reach it one connection
+ * interval later. Time is virtual. */
+
+#include <base/logging.h>
+#include <gtest/gtest.h>
+#include <deque>
+
+#include "osi/test/AllocationTestHarness.h"
+#include "stack/l2cap/l2c_int.h"
+#include "stack/test/l2cap/l2c_test_stubs.h"
+
+namespace {
+
+constexpr uint16_t kMps = 100;
+constexpr uint16_t kConnInterval = 24; /* 30 ms */
+constexpr uint64_t kConnIntervalUs = kConnInterval * 1250;
+
+struct CreditReturn {
+  uint64_t arrival_us;
+  uint16_t credits;
+};
+
+/* The remote device, and what the channel hands up */
+struct Remote {
+  uint32_t credits;
+  std::deque<CreditReturn> returns;
+  uint32_t frames_sent;
+  uint32_t sdus_received;
+  BT_HDR* last_sdu;
+  uint16_t last_sdu_len;
+};
+
+Remote* remote;
+
+BT_HDR* make_k_frame(bool first, uint16_t sdu_length, uint16_t len) {
+  BT_HDR* p_buf = (BT_HDR*)osi_malloc(BT_HDR_SIZE + L2CAP_MIN_OFFSET + len);
+  p_buf->offset = L2CAP_MIN_OFFSET;
+  p_buf->len = len;
+  uint8_t* p = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  uint16_t payload = len;
+  if (first) {
+    UINT16_TO_STREAM(p, sdu_length);
+    payload -= sizeof(uint16_t);
+  }
+  for (uint16_t i = 0; i < payload; i++) *p++ = (uint8_t)i;
+  return p_buf;
+}
+
+void csm_execute(tL2C_CCB* p_ccb, uint16_t event, void* p_data) {
+  if (event == L2CEVT_L2CA_SEND_FLOW_CONTROL_CREDIT) {
+    remote->returns.push_back(
+        {l2c_test_now_us + kConnIntervalUs, *(uint16_t*)p_data});
+    return;
+  }
+  BT_HDR* p_buf = (BT_HDR*)p_data;
+  remote->sdus_received++;
+  remote->last_sdu = p_buf;
+  remote->last_sdu_len = p_buf->len;
+  osi_free(p_buf);
+}
+
+}  // namespace
+
+class LeCreditTest : public AllocationTestHarness {
+ protected:
+  void SetUp() override {
+    AllocationTestHarness::SetUp();
+    remote = new Remote();
+    l2c_test_now_us = 1000000;
+    l2c_test_hooks = {};
+    l2c_test_hooks.csm_execute = csm_execute;
+    lcb_ = {};
+    lcb_.conn_interval = kConnInterval;
+    ccb_ = {};
+    ccb_.in_use = true;
+    ccb_.p_lcb = &lcb_;
+    ccb_.local_cid = 0x0040;
+    ccb_.peer_cfg.fcr.mode = L2CAP_FCR_LE_COC_MODE;
+    ccb_.is_first_seg = true;
+    ccb_.local_conn_cfg.mtu = 1000;
+    ccb_.local_conn_cfg.mps = kMps;
+  }
+
+  void TearDown() override {
+    l2c_fcr_cleanup(&ccb_);
+    delete remote;
+    remote = nullptr;
+    l2c_test_hooks = {};
+    AllocationTestHarness::TearDown();
+  }
+
+  void Open(uint16_t initial_credits) {
+    ccb_.local_conn_cfg.credits = initial_credits;
+    l2c_lcc_init_credits(&ccb_);
+    remote->credits = ccb_.local_conn_cfg.credits;
+  }
+
+  void Receive(BT_HDR* p_buf) { l2c_lcc_proc_pdu(&ccb_, p_buf); }
+
+  /* The remote offers one single K-frame SDU every |period_us| */
+  void Stream(uint64_t duration_us, uint64_t period_us) {
+    uint64_t end_us = l2c_test_now_us + duration_us;
+    for (; l2c_test_now_us < end_us; l2c_test_now_us += period_us) {
+      while (!remote->returns.empty() &&
+             remote->returns.front().arrival_us <= l2c_test_now_us) {
+        remote->credits += remote->returns.front().credits;
+        remote->returns.pop_front();
+      }
+      if (remote->credits == 0) continue;
+      remote->credits--;
+      remote->frames_sent++;
+      Receive(make_k_frame(true, 50, 52));
+    }
+  }
+
+  tL2C_LCB lcb_;
+  tL2C_CCB ccb_;
+};
+
+/* Initial credits are capped to what the memory budget allows */
+TEST_F(LeCreditTest, initial_credits_capped) {
+  Open(L2CAP_LE_CREDIT_DEFAULT);
+  EXPECT_EQ(L2CAP_LE_CREDIT_RX_BUDGET / kMps, ccb_.local_conn_cfg.credits);
+  EXPECT_EQ(ccb_.local_conn_cfg.credits, ccb_.remote_credit_count);
+  EXPECT_EQ(ccb_.local_conn_cfg.credits, ccb_.le_credit.window);
+}
+
+/* A steady stream shrinks the window to about twice the credit round trip */
+TEST_F(LeCreditTest, window_follows_rate) {
+  Open(L2CAP_LE_CREDIT_DEFAULT);
+  Stream(10000000, 1000);
+
+  uint16_t expected =
+      2 * kConnIntervalUs * L2CAP_LE_CREDIT_RTT_INTERVALS / 1000 +
+      L2CAP_LE_CREDIT_MIN_WINDOW;
+  EXPECT_GE(ccb_.le_credit.window, expected * 9 / 10);
+  EXPECT_LE(ccb_.le_credit.window, expected * 11 / 10);
+  EXPECT_EQ(10000u, remote->frames_sent);
+  EXPECT_EQ(0u, ccb_.le_credit.rx_stalls);
+  EXPECT_LT(ccb_.le_credit.credit_pdus, remote->frames_sent / 50);
+}
+
+/* A channel opened with few credits opens its window to the offered rate */
+TEST_F(LeCreditTest, window_opens_from_minimum) {
+  Open(1);
+  Stream(5000000, 1000);
+  uint32_t ramp_up_frames = remote->frames_sent;
+  Stream(1000000, 1000);
+
+  EXPECT_EQ(1000u, remote->frames_sent - ramp_up_frames);
+  EXPECT_GT(ccb_.le_credit.window, 2 * L2CAP_LE_CREDIT_MIN_WINDOW);
+}
+
+/* An SDU in a single K-frame goes up in the received buffer */
+TEST_F(LeCreditTest, single_k_frame_sdu_not_copied) {
+  Open(L2CAP_LE_CREDIT_MIN_WINDOW);
+  BT_HDR* p_buf = make_k_frame(true, 50, 52);
+  Receive(p_buf);
+
+  EXPECT_EQ(1u, remote->sdus_received);
+  EXPECT_EQ(p_buf, remote->last_sdu);
+  EXPECT_EQ(50, remote->last_sdu_len);
+  EXPECT_EQ(1u, ccb_.le_credit.sdus_in_place);
+  EXPECT_EQ(0u, ccb_.le_credit.sdus_copied);
+}
+
+TEST_F(LeCreditTest, segmented_sdu_reassembled) {
+  Open(L2CAP_LE_CREDIT_MIN_WINDOW);
+  Receive(make_k_frame(true, 150, kMps));
+  EXPECT_EQ(0u, remote->sdus_received);
+  Receive(make_k_frame(false, 0, 52));
+
+  EXPECT_EQ(1u, remote->sdus_received);
+  EXPECT_EQ(150, remote->last_sdu_len);
+  EXPECT_EQ(0u, ccb_.le_credit.sdus_in_place);
+  EXPECT_EQ(1u, ccb_.le_credit.sdus_copied);
+}
+
+/* A partial SDU is freed with the channel */
+TEST_F(LeCreditTest, partial_sdu_freed) {
+  Open(L2CAP_LE_CREDIT_MIN_WINDOW);
+  Receive(make_k_frame(true, 150, kMps));
+  EXPECT_EQ(0u, remote->sdus_received);
+}
+
+/* Credits are only given back for the K-frames accepted */
+TEST_F(LeCreditTest, discarded_k_frames_return_no_credits) {
+  Open(L2CAP_LE_CREDIT_MIN_WINDOW);
+  uint16_t window = ccb_.le_credit.window;
+  for (uint16_t i = 0; i < window; i++) {
+    /* Larger than the local MPS */
+    Receive(make_k_frame(true, 150, kMps + 1));
+  }
+  EXPECT_EQ(0u, remote->sdus_received);
+  EXPECT_TRUE(remote->returns.empty());
+  EXPECT_EQ(0, ccb_.remote_credit_count);
+  EXPECT_EQ(0u, ccb_.le_credit.credit_pdus);
+
+  /* The remote got one more credit from us than we knew of */
+  ccb_.remote_credit_count = 1;
+  Receive(make_k_frame(true, 50, 52));
+  EXPECT_EQ(1u, remote->sdus_received);
+  ASSERT_EQ(1u, remote->returns.size());
+  EXPECT_EQ(window, remote->returns.front().credits);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stack/test/l2cap/l2c_test_stubs.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "osi/include/alarm.h"
+
+tL2C_CB l2cb;
+
+uint64_t l2c_test_now_us;
+tL2C_TEST_HOOKS l2c_test_hooks;
+
+namespace {
+
+struct FakeAlarm {
+  alarm_callback_t cb;
+  void* data;
+  bool scheduled;
+  uint64_t deadline_us;
+};
+
+std::vector<FakeAlarm*> alarms;
+
+}  // namespace
+
+bool l2c_test_fire_next_alarm() {
+  FakeAlarm* next = nullptr;
+  for (FakeAlarm* alarm : alarms) {
+    if (alarm->scheduled &&
+        (next == nullptr || alarm->deadline_us < next->deadline_us))
+      next = alarm;
+  }
+  if (next == nullptr) return false;
+  if (next->deadline_us > l2c_test_now_us) l2c_test_now_us = next->deadline_us;
+  next->scheduled = false;
+  next->cb(next->data);
+  return true;
+}
+
+void l2c_test_fire_due_alarms() {
+  for (FakeAlarm* alarm : alarms) {
+    if (alarm->scheduled && alarm->deadline_us <= l2c_test_now_us) {
+      alarm->scheduled = false;
+      alarm->cb(alarm->data);
+    }
+  }
+}
+
+namespace bluetooth {
+namespace common {
+uint64_t time_get_os_boottime_ms() { return l2c_test_now_us / 1000; }
+uint64_t time_get_os_boottime_us() { return l2c_test_now_us; }
+uint64_t time_gettimeofday_us() { return l2c_test_now_us; }
+}  // namespace common
+}  // namespace bluetooth
+
+alarm_t* alarm_new(const char* name) {
+  FakeAlarm* alarm = new FakeAlarm();
+  alarms.push_back(alarm);
+  return (alarm_t*)alarm;
+}
+void alarm_free(alarm_t* alarm) {
+  if (alarm == nullptr) return;
+  alarms.erase(std::find(alarms.begin(), alarms.end(), (FakeAlarm*)alarm));
+  delete (FakeAlarm*)alarm;
+}
+void alarm_set_on_mloop(alarm_t* alarm, uint64_t interval_ms,
+                        alarm_callback_t cb, void* data) {
+  FakeAlarm* fake = (FakeAlarm*)alarm;
+  fake->cb = cb;
+  fake->data = data;
+  fake->scheduled = true;
+  fake->deadline_us = l2c_test_now_us + interval_ms * 1000;
+}
+void alarm_cancel(alarm_t* alarm) {
+  if (alarm != nullptr) ((FakeAlarm*)alarm)->scheduled = false;
+}
+bool alarm_is_scheduled(const alarm_t* alarm) {
+  return alarm != nullptr && ((const FakeAlarm*)alarm)->scheduled;
+}
+
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+void l2c_ccb_timer_timeout(void* data) { l2c_fcr_proc_tout((tL2C_CCB*)data); }
+void l2c_fcrb_ack_timer_timeout(void* data) {
+  l2c_fcr_proc_ack_tout((tL2C_CCB*)data);
+}
+void l2cu_set_acl_hci_header(BT_HDR* p_buf, tL2C_CCB* p_ccb) {}
+void l2cu_process_our_cfg_req(tL2C_CCB* p_ccb, tL2CAP_CFG_INFO* p_cfg) {}
+void l2cu_send_peer_config_req(tL2C_CCB* p_ccb, tL2CAP_CFG_INFO* p_cfg) {}
+
+void l2cu_disconnect_chnl(tL2C_CCB* p_ccb) {
+  if (l2c_test_hooks.disconnect_chnl) l2c_test_hooks.disconnect_chnl(p_ccb);
+}
+
+void l2c_link_check_send_pkts(tL2C_LCB* p_lcb, tL2C_CCB* p_ccb,
+                              BT_HDR* p_buf) {
+  if (l2c_test_hooks.link_check_send_pkts)
+    l2c_test_hooks.link_check_send_pkts(p_lcb, p_ccb, p_buf);
+}
+
+void l2c_csm_execute(tL2C_CCB* p_ccb, uint16_t event, void* p_data) {
+  if (l2c_test_hooks.csm_execute)
+    l2c_test_hooks.csm_execute(p_ccb, event, p_data);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "stack/l2cap/l2c_int.h"
+
+/* Stubs of what l2c_fcr.cc calls outside of it, shared by the L2CAP tests.
+ * The clock and the alarms run on virtual time. */
+
+/* Virtual time returned by the time functions, tests move it forward */
+extern uint64_t l2c_test_now_us;
+
+/* Fires the earliest scheduled alarm, moving the virtual time to it. Returns
+ * false when no alarm is scheduled. */
+bool l2c_test_fire_next_alarm();
+
+/* Fires the alarms due at the virtual time */
+void l2c_test_fire_due_alarms();
+
+/* What the stubs of the L2CAP state machine and link do, set by each test.
+ * The stubs do nothing where a hook is left NULL. */
+typedef struct {
+  void (*csm_execute)(tL2C_CCB* p_ccb, uint16_t event, void* p_data);
+  void (*link_check_send_pkts)(tL2C_LCB* p_lcb, tL2C_CCB* p_ccb,
+                               BT_HDR* p_buf);
+  void (*disconnect_chnl)(tL2C_CCB* p_ccb);
+} tL2C_TEST_HOOKS;
+
+extern tL2C_TEST_HOOKS l2c_test_hooks;
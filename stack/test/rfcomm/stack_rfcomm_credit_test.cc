@@ -0,0 +1,167 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "port_int.h"
+
+namespace {
+
+constexpr uint64_t kStartUs = 1000000;
+
+class StackRfcommCreditTest : public ::testing::Test {
+ protected:
+  void SetUp() override { memset(&window_, 0, sizeof(window_)); }
+
+  /* The peer sends |frames| frames, |interval_us| apart, which the
+   * application consumes as they come in */
+  void ReceiveFrames(int frames, uint64_t interval_us) {
+    for (int i = 0; i < frames; i++) {
+      now_us_ += interval_us;
+      port_rx_window_frame(&window_, now_us_);
+      port_rx_window_consumed(&window_, 1, now_us_);
+    }
+  }
+
+  tPORT_RX_WINDOW window_;
+  uint64_t now_us_ = kStartUs;
+};
+
+TEST_F(StackRfcommCreditTest, rate_is_smoothed_over_intervals) {
+  tPORT_RATE rate;
+  memset(&rate, 0, sizeof(rate));
+
+  /* 100 per interval of 200 ms */
+  uint64_t now_us = kStartUs;
+  for (int i = 0; i <= 10; i++) {
+    port_rate_add(&rate, 100, now_us);
+    now_us += PORT_RATE_INTERVAL_US;
+  }
+  EXPECT_EQ(rate.per_sec, 500u);
+
+  /* Twice as many: the rate moves a quarter of the way per interval */
+  port_rate_add(&rate, 200, now_us);
+  now_us += PORT_RATE_INTERVAL_US;
+  port_rate_add(&rate, 200, now_us);
+  EXPECT_EQ(rate.per_sec, 625u);
+}
+
+TEST_F(StackRfcommCreditTest, window_defaults_until_measured) {
+  EXPECT_EQ(port_rx_window_credits(&window_, 10, 40), 10);
+
+  /* A consumption rate but no round trip yet */
+  ReceiveFrames(300, 1000);
+  EXPECT_NE(window_.consumed.per_sec, 0u);
+  EXPECT_EQ(port_rx_window_credits(&window_, 10, 40), 10);
+}
+
+TEST_F(StackRfcommCreditTest, round_trip_is_timed_from_grant_to_first_frame) {
+  /* The peer holds the 7 initial credits and sends on all of them before the
+   * first frame on the 3 granted */
+  port_rx_window_grant(&window_, 7, now_us_);
+  uint64_t grant_us = now_us_;
+  ReceiveFrames(7, 1000);
+  EXPECT_EQ(window_.rtt_us, 0u);
+
+  ReceiveFrames(1, 20000);
+  EXPECT_EQ(window_.rtt_us, now_us_ - grant_us);
+  EXPECT_EQ(window_.grant_us, 0u);
+}
+
+TEST_F(StackRfcommCreditTest, frames_in_hand_do_not_count_as_held) {
+  /* 4 frames received and not consumed: of 7 credits given, the peer holds 3
+   */
+  for (int i = 0; i < 4; i++) port_rx_window_frame(&window_, now_us_);
+  port_rx_window_grant(&window_, 7, now_us_);
+  EXPECT_EQ(window_.grant_frame, 4u + 3u + 1u);
+}
+
+TEST_F(StackRfcommCreditTest, only_one_grant_is_timed_at_a_time) {
+  port_rx_window_grant(&window_, 0, now_us_);
+  uint64_t grant_us = now_us_;
+  now_us_ += 5000;
+  port_rx_window_grant(&window_, 0, now_us_);
+
+  ReceiveFrames(1, 10000);
+  EXPECT_EQ(window_.rtt_us, 15000u);
+  EXPECT_EQ(window_.rtt_us, now_us_ - grant_us);
+}
+
+TEST_F(StackRfcommCreditTest, lowest_round_trip_is_kept_until_it_expires) {
+  port_rx_window_grant(&window_, 0, now_us_);
+  ReceiveFrames(1, 20000);
+  EXPECT_EQ(window_.rtt_us, 20000u);
+
+  /* A round trip including the peer's idle time */
+  port_rx_window_grant(&window_, 0, now_us_);
+  ReceiveFrames(1, 500000);
+  EXPECT_EQ(window_.rtt_us, 20000u);
+
+  /* After 10 s without a lower one, the link did get slower */
+  now_us_ += 10000000;
+  port_rx_window_grant(&window_, 0, now_us_);
+  ReceiveFrames(1, 40000);
+  EXPECT_EQ(window_.rtt_us, 40000u);
+}
+
+TEST_F(StackRfcommCreditTest, credits_returned_unreceived_are_ignored) {
+  ReceiveFrames(2, 1000);
+  port_rx_window_consumed(&window_, 10, now_us_);
+  EXPECT_EQ(window_.frames_consumed, 2u);
+}
+
+TEST_F(StackRfcommCreditTest, window_covers_twice_rate_times_round_trip) {
+  /* 50 ms round trip */
+  port_rx_window_grant(&window_, 0, now_us_);
+  ReceiveFrames(1, 50000);
+
+  /* 400 frames per second: 20 frames per round trip */
+  ReceiveFrames(1000, 2500);
+  EXPECT_EQ(window_.consumed.per_sec, 400u);
+  EXPECT_EQ(port_rx_window_credits(&window_, 10, 40), 40);
+  EXPECT_EQ(port_rx_window_credits(&window_, 10, 100), 40);
+
+  /* 100 frames per second: 5 frames per round trip */
+  ReceiveFrames(1000, 10000);
+  EXPECT_EQ(window_.consumed.per_sec, 100u);
+  EXPECT_EQ(port_rx_window_credits(&window_, 4, 40), 10);
+  EXPECT_EQ(port_rx_window_credits(&window_, 12, 40), 12);
+}
+
+TEST_F(StackRfcommCreditTest, window_grows_while_it_limits_the_peer) {
+  constexpr uint64_t kRttUs = 30000;
+  constexpr uint64_t kFrameUs = 1000;
+  uint16_t credits = 10;
+
+  /* On a link of 1000 frames per second and 30 ms round trip, the peer sends
+   * its window of frames, then waits for the credits granted once all of them
+   * are consumed */
+  for (int round = 0; round < 100; round++) {
+    port_rx_window_grant(&window_, 0, now_us_);
+    now_us_ += kRttUs - kFrameUs;
+    ReceiveFrames(credits, kFrameUs);
+    credits = port_rx_window_credits(&window_, 10, PORT_RX_BUF_MAX_WM);
+  }
+
+  /* The window settles once it covers the 30 frames in flight */
+  EXPECT_NEAR(credits, 31, 2);
+}
+
+}  // namespace
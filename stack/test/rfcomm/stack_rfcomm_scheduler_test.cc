@@ -0,0 +1,290 @@
+/******************************************************************************
+ *
+ *  Copyright 2020 The Android Open Source Project
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "stack/rfcomm/port_rfc.cc"
+
+/* Tests the deficit round robin sending of the ports of a multiplexer, with
+ * the frames RFCOMM_DataReq is given recorded instead of sent */
+
+tRFC_CB rfc_cb;
+
+namespace {
+
+constexpr uint16_t kPeerMtu = 1000;
+constexpr int kPorts = 3;
+
+/* Frames sent, as DLCI and length */
+std::vector<std::pair<uint8_t, uint16_t>> sent;
+uint32_t sent_bytes;
+
+/* L2CAP becomes congested once this many bytes are sent, 0 for never */
+uint32_t congest_after_bytes;
+
+/* Port callback events, by port handle */
+std::map<uint16_t, uint32_t> port_events;
+
+void port_callback(uint32_t code, uint16_t port_handle) {
+  port_events[port_handle] |= code;
+}
+
+}  // namespace
+
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+
+void RFCOMM_DataReq(tRFC_MCB* p_mcb, uint8_t dlci, BT_HDR* p_buf) {
+  sent.emplace_back(dlci, p_buf->len);
+  sent_bytes += p_buf->len;
+  osi_free(p_buf);
+
+  /* L2CAP reports congestion from within the write */
+  if (congest_after_bytes != 0 && sent_bytes >= congest_after_bytes) {
+    congest_after_bytes = 0;
+    PORT_FlowInd(p_mcb, 0, false);
+  }
+}
+
+void RFCOMM_StartReq(tRFC_MCB* p_mcb) {}
+void RFCOMM_StartRsp(tRFC_MCB* p_mcb, uint16_t result) {}
+void RFCOMM_DlcEstablishReq(tRFC_MCB* p_mcb, uint8_t dlci, uint16_t mtu) {}
+void RFCOMM_DlcEstablishRsp(tRFC_MCB* p_mcb, uint8_t dlci, uint16_t mtu,
+                            uint16_t result) {}
+void RFCOMM_DlcReleaseReq(tRFC_MCB* p_mcb, uint8_t dlci) {}
+void RFCOMM_ParameterNegotiationRequest(tRFC_MCB* p_mcb, uint8_t dlci,
+                                        uint16_t mtu) {}
+void RFCOMM_ParameterNegotiationResponse(tRFC_MCB* p_mcb, uint8_t dlci,
+                                         uint16_t mtu, uint8_t cl, uint8_t k) {}
+void RFCOMM_FlowReq(tRFC_MCB* p_mcb, uint8_t dlci, bool state) {}
+void RFCOMM_PortParameterNegotiationRequest(tRFC_MCB* p_mcb, uint8_t dlci,
+                                            tPORT_STATE* p_pars) {}
+void RFCOMM_PortParameterNegotiationResponse(tRFC_MCB* p_mcb, uint8_t dlci,
+                                             tPORT_STATE* p_pars,
+                                             uint16_t param_mask) {}
+void RFCOMM_ControlReq(tRFC_MCB* p_mcb, uint8_t dlci, tPORT_CTRL* p_pars) {}
+void RFCOMM_LineStatusReq(tRFC_MCB* p_mcb, uint8_t dlci, uint8_t line_status) {
+}
+const char* PORT_GetResultString(const uint8_t result_code) { return ""; }
+
+tRFC_MCB* rfc_alloc_multiplexer_channel(const RawAddress& bd_addr,
+                                        bool is_initiator) {
+  return nullptr;
+}
+void rfc_release_multiplexer_channel(tRFC_MCB* p_rfc_mcb) {}
+void rfc_check_mcb_active(tRFC_MCB* p_mcb) {}
+void rfc_timer_stop(tRFC_MCB* p_rfc_mcb) {}
+void rfc_port_timer_stop(tPORT* p_port) {}
+void rfc_send_dm(tRFC_MCB* p_rfc_mcb, uint8_t dlci, bool pf) {}
+void rfc_send_credit(tRFC_MCB* p_mcb, uint8_t dlci, uint8_t credit) {}
+uint16_t btm_get_max_packet_size(const RawAddress& addr) { return 0; }
+
+alarm_t* alarm_new(const char* name) { return nullptr; }
+void alarm_free(alarm_t* alarm) {}
+void alarm_cancel(alarm_t* alarm) {}
+
+namespace {
+
+class StackRfcommSchedulerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    memset(&rfc_cb, 0, sizeof(rfc_cb));
+    memset(&mcb_, 0, sizeof(mcb_));
+    mcb_.peer_ready = true;
+    mcb_.peer_l2cap_mtu = kPeerMtu;
+
+    for (int i = 0; i < kPorts; i++) {
+      tPORT* p_port = &rfc_cb.port.port[i];
+      p_port->handle = i + 1;
+      p_port->in_use = true;
+      p_port->dlci = Dlci(i);
+      p_port->state = PORT_STATE_OPENED;
+      p_port->rfc.state = RFC_STATE_OPENED;
+      p_port->rfc.p_mcb = &mcb_;
+      p_port->tx.queue = fixed_queue_new(SIZE_MAX);
+      p_port->ev_mask = PORT_EV_TXCHAR | PORT_EV_TXEMPTY | PORT_EV_FC |
+                        PORT_EV_FCS;
+      p_port->p_callback = port_callback;
+      mcb_.port_handles[p_port->dlci] = p_port->handle;
+    }
+
+    sent.clear();
+    sent_bytes = 0;
+    congest_after_bytes = 0;
+    port_events.clear();
+  }
+
+  void TearDown() override {
+    for (int i = 0; i < kPorts; i++)
+      fixed_queue_free(rfc_cb.port.port[i].tx.queue, osi_free);
+  }
+
+  static uint8_t Dlci(int port) { return 2 * (port + 1); }
+
+  /* Queues |count| buffers of |len| bytes to send on |port| */
+  void Queue(int port, int count, uint16_t len) {
+    tPORT* p_port = &rfc_cb.port.port[port];
+    for (int i = 0; i < count; i++) {
+      BT_HDR* p_buf = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + len);
+      p_buf->len = len;
+      fixed_queue_enqueue(p_port->tx.queue, p_buf);
+      p_port->tx.queue_size += len;
+    }
+  }
+
+  /* Bytes sent on |port| among the frames recorded from |first| on */
+  static uint32_t SentBytes(int port, size_t first = 0) {
+    uint32_t bytes = 0;
+    for (size_t i = first; i < sent.size(); i++)
+      if (sent[i].first == Dlci(port)) bytes += sent[i].second;
+    return bytes;
+  }
+
+  tRFC_MCB mcb_;
+};
+
+TEST_F(StackRfcommSchedulerTest, ports_get_equal_byte_shares) {
+  /* Bulk, small and medium buffers */
+  Queue(0, 20, 1000);
+  Queue(1, 100, 100);
+  Queue(2, 40, 500);
+  congest_after_bytes = 9 * kPeerMtu;
+
+  PORT_FlowInd(&mcb_, 0, true);
+
+  ASSERT_FALSE(mcb_.peer_ready);
+  EXPECT_EQ(sent_bytes, 9u * kPeerMtu);
+  for (int port = 0; port < kPorts; port++) {
+    SCOPED_TRACE(port);
+    EXPECT_EQ(SentBytes(port), 3u * kPeerMtu);
+  }
+
+  /* Every round of turns gives each port one MTU of bytes */
+  size_t round_start = 0;
+  for (int round = 0; round < 3; round++) {
+    SCOPED_TRACE(round);
+    uint32_t round_bytes = 0;
+    size_t i = round_start;
+    while (i < sent.size() && round_bytes < kPorts * kPeerMtu)
+      round_bytes += sent[i++].second;
+    for (int port = 0; port < kPorts; port++) {
+      uint32_t bytes = 0;
+      for (size_t j = round_start; j < i; j++)
+        if (sent[j].first == Dlci(port)) bytes += sent[j].second;
+      EXPECT_EQ(bytes, kPeerMtu);
+    }
+    round_start = i;
+  }
+}
+
+TEST_F(StackRfcommSchedulerTest, congestion_mid_turn_resumes_turn) {
+  Queue(0, 5, 1000);
+  Queue(1, 20, 100);
+  Queue(2, 10, 500);
+  /* Port 0 sends its MTU, port 1 gets congested 300 bytes into its turn */
+  congest_after_bytes = kPeerMtu + 300;
+
+  PORT_FlowInd(&mcb_, 0, true);
+
+  ASSERT_FALSE(mcb_.peer_ready);
+  EXPECT_EQ(SentBytes(0), kPeerMtu);
+  EXPECT_EQ(SentBytes(1), 300u);
+  EXPECT_EQ(SentBytes(2), 0u);
+  EXPECT_EQ(mcb_.tx_next_port, 1);
+  EXPECT_TRUE(mcb_.tx_turn_open);
+  EXPECT_EQ(rfc_cb.port.port[1].tx_deficit, 700u);
+
+  /* Port 1 finishes its turn without a new quantum, then port 2 has its turn
+   * and port 0 the next one */
+  size_t resumed = sent.size();
+  PORT_FlowInd(&mcb_, 0, true);
+
+  ASSERT_GE(sent.size(), resumed + 10);
+  for (size_t i = resumed; i < resumed + 7; i++)
+    EXPECT_EQ(sent[i], std::make_pair(Dlci(1), (uint16_t)100));
+  for (size_t i = resumed + 7; i < resumed + 9; i++)
+    EXPECT_EQ(sent[i], std::make_pair(Dlci(2), (uint16_t)500));
+  EXPECT_EQ(sent[resumed + 9], std::make_pair(Dlci(0), (uint16_t)1000));
+
+  /* All queues drained */
+  EXPECT_EQ(SentBytes(0), 5u * 1000);
+  EXPECT_EQ(SentBytes(1), 20u * 100);
+  EXPECT_EQ(SentBytes(2), 10u * 500);
+  for (int port = 0; port < kPorts; port++)
+    EXPECT_EQ(rfc_cb.port.port[port].tx_deficit, 0u);
+}
+
+TEST_F(StackRfcommSchedulerTest, flow_controlled_port_is_skipped) {
+  Queue(0, 4, 1000);
+  Queue(1, 4, 1000);
+  Queue(2, 4, 1000);
+  rfc_cb.port.port[1].tx.peer_fc = true;
+
+  PORT_FlowInd(&mcb_, 0, true);
+
+  EXPECT_EQ(SentBytes(0), 4u * 1000);
+  EXPECT_EQ(SentBytes(1), 0u);
+  EXPECT_EQ(SentBytes(2), 4u * 1000);
+  EXPECT_EQ(rfc_cb.port.port[1].tx_deficit, 0u);
+
+  /* The peer lets port 1 send again */
+  sent.clear();
+  PORT_FlowInd(&mcb_, Dlci(1), true);
+  EXPECT_EQ(SentBytes(1), 4u * 1000);
+}
+
+TEST_F(StackRfcommSchedulerTest, dlci_flow_notifies_only_changed_ports) {
+  Queue(1, 2, 100);
+  rfc_cb.port.port[1].tx.peer_fc = true;
+  rfc_cb.port.port[1].tx.user_fc = true;
+  /* The application of port 0 was flow controlled for its own reasons */
+  rfc_cb.port.port[0].tx.user_fc = true;
+
+  PORT_FlowInd(&mcb_, Dlci(1), true);
+
+  EXPECT_EQ(SentBytes(1), 200u);
+  EXPECT_EQ(port_events[rfc_cb.port.port[1].handle],
+            (uint32_t)(PORT_EV_TXCHAR | PORT_EV_TXEMPTY | PORT_EV_FC |
+                       PORT_EV_FCS));
+  EXPECT_EQ(port_events.count(rfc_cb.port.port[0].handle), 0u);
+  EXPECT_EQ(port_events.count(rfc_cb.port.port[2].handle), 0u);
+  EXPECT_TRUE(rfc_cb.port.port[0].tx.user_fc);
+}
+
+TEST_F(StackRfcommSchedulerTest, credit_frames_leave_an_octet_for_credits) {
+  tPORT* p_port = &rfc_cb.port.port[0];
+  p_port->peer_mtu = kPeerMtu;
+
+  /* Filled frames can still return credits in their credit octet */
+  mcb_.flow = PORT_FC_CREDIT;
+  EXPECT_EQ(port_tx_frame_len(p_port), kPeerMtu - 1);
+
+  mcb_.flow = PORT_FC_TS710;
+  EXPECT_EQ(port_tx_frame_len(p_port), kPeerMtu);
+
+  /* The buffer size still bounds the frames */
+  p_port->peer_mtu = RFCOMM_DATA_BUF_SIZE;
+  EXPECT_LT(port_tx_frame_len(p_port), RFCOMM_DATA_BUF_SIZE);
+}
+
+}  // namespace
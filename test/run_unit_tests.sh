@@ -10,9 +10,11 @@ known_tests=(
   net_test_bluetooth
   net_test_btcore
   net_test_bta
+  net_test_bta_gatt_cache
   net_test_btif
   net_test_btif_profile_queue
   net_test_btif_config_cache
+  net_test_controller
   net_test_device
   net_test_hci
   net_test_stack
@@ -24,6 +26,7 @@ known_tests=(
   net_test_osi
   net_test_performance
   net_test_stack_rfcomm
+  net_test_stack_rfcomm_scheduler
   net_test_gatt_conn_multiplexing
 )
 
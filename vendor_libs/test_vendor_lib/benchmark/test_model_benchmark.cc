@@ -0,0 +1,139 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A crowded LE phy simulated in virtual time: beacon swarms advertising every
+// 100 ms and pairs of devices exchanging addressed packets at every tick, as
+// when load testing a stack against hundreds of beacons and phones. The
+// counter is the simulated time covered per second of wall time.
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "model/devices/beacon_swarm.h"
+#include "model/devices/device.h"
+#include "model/setup/simulation_clock.h"
+#include "model/setup/test_model.h"
+
+using ::benchmark::State;
+using namespace test_vendor_lib;
+
+namespace {
+
+constexpr std::chrono::milliseconds kTimerPeriod(10);
+
+std::string MakeAddress(uint8_t kind, size_t n) {
+  std::stringstream address;
+  address << std::hex << std::setfill('0') << std::setw(2) << +kind
+          << ":00:00:00:" << std::setw(2) << (n >> 8) << ":" << std::setw(2)
+          << (n & 0xff);
+  return address.str();
+}
+
+// Sends an addressed packet to its peer at every tick
+class Pinger : public Device {
+ public:
+  Pinger(Address address, Address peer) : address_(address), peer_(peer) {}
+
+  void Initialize(const std::vector<std::string>&) override {}
+  std::string GetTypeString() const override { return "pinger"; }
+
+  void TimerTick() override {
+    SendLinkLayerPacket(
+        model::packets::DisconnectBuilder::Create(address_, peer_, 0x13),
+        Phy::Type::LOW_ENERGY);
+  }
+
+ private:
+  Address address_;
+  Address peer_;
+};
+
+}  // namespace
+
+class BM_TestModel : public ::benchmark::Fixture {
+ protected:
+  void SetUp(State& st) override {
+    ::benchmark::Fixture::SetUp(st);
+    model_ = std::make_unique<TestModel>(
+        [](std::chrono::milliseconds, const TaskCallback& task) {
+          task();
+          return kInvalidTaskId;
+        },
+        [](std::chrono::milliseconds, std::chrono::milliseconds,
+           const TaskCallback&) { return kInvalidTaskId; },
+        [](AsyncTaskId) {}, [](const std::string&, int) { return -1; });
+    model_->SetTimerPeriod(kTimerPeriod);
+    size_t phy = model_->AddPhy(Phy::Type::LOW_ENERGY);
+
+    size_t num_devices = st.range(0);
+    for (size_t i = 0; i < num_devices; i++) {
+      std::shared_ptr<Device> device;
+      if (i % 2 == 0) {
+        device = std::make_shared<BeaconSwarm>();
+        device->Initialize({"beacon_swarm", MakeAddress(0xbe, i), "100"});
+      } else {
+        // Pair with the next pinger
+        size_t peer = (i % 4 == 1) ? i + 2 : i - 2;
+        Address address;
+        Address peer_address;
+        Address::FromString(MakeAddress(0xc0, i), address);
+        Address::FromString(MakeAddress(0xc0, peer), peer_address);
+        device = std::make_shared<Pinger>(address, peer_address);
+      }
+      model_->AddDeviceToPhy(model_->Add(device), phy);
+    }
+
+    model_->SetTickShards(st.range(1));
+    model_->SetVirtualTime(true);
+  }
+
+  void TearDown(State& st) override {
+    model_->SetVirtualTime(false);
+    model_->Reset();
+    model_.reset();
+    ::benchmark::Fixture::TearDown(st);
+  }
+
+  std::unique_ptr<TestModel> model_;
+};
+
+// Arguments are the number of devices and of tick shards
+BENCHMARK_DEFINE_F(BM_TestModel, run_ticks)(State& state) {
+  for (auto _ : state) {
+    model_->RunTicks(100);
+  }
+  state.counters["simulated_x"] = ::benchmark::Counter(
+      state.iterations() * 100 * kTimerPeriod.count() / 1000.0,
+      ::benchmark::Counter::kIsRate);
+}
+BENCHMARK_REGISTER_F(BM_TestModel, run_ticks)
+    ->Args({100, 1})
+    ->Args({1000, 1})
+    ->Args({1000, 4})
+    ->UseRealTime()
+    ->Unit(::benchmark::kMillisecond);
+
+int main(int argc, char** argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  ::benchmark::RunSpecifiedBenchmarks();
+}
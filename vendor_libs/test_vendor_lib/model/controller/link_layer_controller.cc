@@ -17,6 +17,7 @@
 #include "link_layer_controller.h"
 
 #include "include/le_advertisement.h"
+#include "model/setup/simulation_clock.h"
 #include "os/log.h"
 #include "packet/raw_builder.h"
 
@@ -1038,7 +1039,7 @@ void LinkLayerController::LeAdvertising() {
   if (!le_advertising_enable_) {
     return;
   }
-  steady_clock::time_point now = steady_clock::now();
+  steady_clock::time_point now = SimulationClock::Now();
   if (duration_cast<milliseconds>(now - last_le_advertisement_) <
       milliseconds(200)) {
     return;
@@ -1741,7 +1742,7 @@ bool LinkLayerController::LeResolvingListFull() {
 
 void LinkLayerController::Reset() {
   inquiry_state_ = Inquiry::InquiryState::STANDBY;
-  last_inquiry_ = steady_clock::now();
+  last_inquiry_ = SimulationClock::Now();
   le_scan_enable_ = bluetooth::hci::OpCode::NONE;
   le_advertising_enable_ = 0;
   le_connect_ = 0;
@@ -1780,7 +1781,7 @@ void LinkLayerController::SetInquiryMaxResponses(uint8_t max) {
 }
 
 void LinkLayerController::Inquiry() {
-  steady_clock::time_point now = steady_clock::now();
+  steady_clock::time_point now = SimulationClock::Now();
   if (duration_cast<milliseconds>(now - last_inquiry_) < milliseconds(2000)) {
     return;
   }
@@ -60,7 +60,7 @@ void Beacon::Initialize(const vector<std::string>& args) {
 
 void Beacon::TimerTick() {
   if (IsAdvertisementAvailable()) {
-    last_advertisement_ = std::chrono::steady_clock::now();
+    last_advertisement_ = SimulationClock::Now();
     auto ad = model::packets::LeAdvertisementBuilder::Create(
         properties_.GetLeAddress(), Address::kEmpty,
         model::packets::AddressType::PUBLIC,
@@ -26,6 +26,7 @@
 #include "hci/address.h"
 #include "model/devices/device_properties.h"
 #include "model/setup/phy_layer.h"
+#include "model/setup/simulation_clock.h"
 
 #include "packets/link_layer_packets.h"
 
@@ -38,7 +39,7 @@ using ::bluetooth::hci::Address;
 class Device {
  public:
   Device(const std::string properties_filename = "")
-      : last_advertisement_(std::chrono::steady_clock::now()), properties_(properties_filename) {}
+      : last_advertisement_(SimulationClock::Now()), properties_(properties_filename) {}
   virtual ~Device() = default;
 
   // Initialize the device based on the values of |args|.
@@ -80,6 +81,12 @@ class Device {
 
   virtual void IncomingPacket(model::packets::LinkLayerPacketView){};
 
+  // Return true if the device needs the packets addressed to other devices,
+  // and not only the ones addressed to it or to all.
+  virtual bool ReceivesAllPackets() const {
+    return false;
+  }
+
   virtual void SendLinkLayerPacket(
       std::shared_ptr<model::packets::LinkLayerPacketBuilder> packet,
       Phy::Type phy_type);
@@ -22,6 +22,7 @@
 
 #include "model/devices/scripted_beacon_ble_payload.pb.h"
 #include "model/setup/device_boutique.h"
+#include "model/setup/simulation_clock.h"
 #include "os/log.h"
 
 using std::vector;
@@ -72,7 +73,7 @@ ScriptedBeacon::ScriptedBeacon() {
 }
 
 bool has_time_elapsed(steady_clock::time_point time_point) {
-  return steady_clock::now() > time_point;
+  return SimulationClock::Now() > time_point;
 }
 
 void ScriptedBeacon::Initialize(const vector<std::string>& args) {
@@ -125,16 +126,16 @@ void ScriptedBeacon::TimerTick() {
       Beacon::TimerTick();
       break;
     case PlaybackEvent::SCANNED_ONCE:
-      next_check_time_ =
-          steady_clock::now() + steady_clock::duration(std::chrono::seconds(1));
+      next_check_time_ = SimulationClock::Now() +
+                         steady_clock::duration(std::chrono::seconds(1));
       set_state(PlaybackEvent::WAITING_FOR_FILE);
       break;
     case PlaybackEvent::WAITING_FOR_FILE:
       if (!has_time_elapsed(next_check_time_)) {
         return;
       }
-      next_check_time_ =
-          steady_clock::now() + steady_clock::duration(std::chrono::seconds(1));
+      next_check_time_ = SimulationClock::Now() +
+                         steady_clock::duration(std::chrono::seconds(1));
       if (access(config_file_.c_str(), F_OK) == -1) {
         return;
       }
@@ -159,7 +160,7 @@ void ScriptedBeacon::TimerTick() {
         set_state(PlaybackEvent::PLAYBACK_STARTED);
         LOG_INFO("Starting Ble advertisement playback from file: %s",
                  config_file_.c_str());
-        next_ad_.ad_time = steady_clock::now();
+        next_ad_.ad_time = SimulationClock::Now();
         get_next_advertisement();
         input.close();
       }
@@ -49,6 +49,8 @@ class Sniffer : public Device {
 
   virtual void TimerTick() override;
 
+  virtual bool ReceivesAllPackets() const override { return true; }
+
  private:
   static bool registered_;
   Address device_to_sniff_;
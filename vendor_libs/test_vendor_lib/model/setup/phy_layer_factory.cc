@@ -15,10 +15,17 @@
  */
 
 #include "phy_layer_factory.h"
+#include <algorithm>
 #include <sstream>
 
 namespace test_vendor_lib {
 
+namespace {
+
+thread_local std::vector<DeferredSend>* deferred_sends_ = nullptr;
+
+}  // namespace
+
 PhyLayerFactory::PhyLayerFactory(Phy::Type phy_type, uint32_t factory_id)
     : phy_type_(phy_type), factory_id_(factory_id) {}
 
@@ -33,15 +40,38 @@ uint32_t PhyLayerFactory::GetFactoryId() {
 std::shared_ptr<PhyLayer> PhyLayerFactory::GetPhyLayer(
     const std::function<void(model::packets::LinkLayerPacketView)>&
         device_receive,
-    uint32_t device_id) {
+    uint32_t device_id, bool receive_all) {
   std::shared_ptr<PhyLayer> new_phy = std::make_shared<PhyLayerImpl>(
-      phy_type_, next_id_++, device_receive, device_id,
-      std::shared_ptr<PhyLayerFactory>(this));
+      phy_type_, next_id_++, device_receive, device_id, shared_from_this());
   phy_layers_.push_back(new_phy);
+  phy_addresses_[new_phy->GetId()].phy = new_phy.get();
+  if (receive_all) {
+    receive_all_phys_.push_back(new_phy.get());
+  }
   return new_phy;
 }
 
 void PhyLayerFactory::UnregisterPhyLayer(uint32_t id) {
+  auto addresses = phy_addresses_.find(id);
+  if (addresses != phy_addresses_.end()) {
+    for (const auto& address : addresses->second.addresses) {
+      auto& route = routes_[address];
+      route.erase(std::remove_if(route.begin(), route.end(),
+                                 [id](PhyLayer* phy) {
+                                   return phy->GetId() == id;
+                                 }),
+                  route.end());
+      if (route.empty()) {
+        routes_.erase(address);
+      }
+    }
+    phy_addresses_.erase(addresses);
+  }
+  receive_all_phys_.erase(
+      std::remove_if(receive_all_phys_.begin(), receive_all_phys_.end(),
+                     [id](PhyLayer* phy) { return phy->GetId() == id; }),
+      receive_all_phys_.end());
+
   for (auto it = phy_layers_.begin(); it != phy_layers_.end();) {
     if ((*it)->GetId() == id) {
       it = phy_layers_.erase(it);
@@ -70,13 +100,90 @@ void PhyLayerFactory::Send(
 
 void PhyLayerFactory::Send(model::packets::LinkLayerPacketView packet,
                            uint32_t id) {
-  for (const auto& phy : phy_layers_) {
+  if (deferred_sends_ != nullptr) {
+    deferred_sends_->push_back({this, packet, id});
+    return;
+  }
+  Deliver(packet, id);
+}
+
+void PhyLayerFactory::Deliver(model::packets::LinkLayerPacketView packet,
+                              uint32_t id) {
+  Address destination = packet.GetDestinationAddress();
+  if (destination == Address::kEmpty) {
+    for (const auto& phy : phy_layers_) {
+      if (id != phy->GetId()) {
+        phy->Receive(packet);
+      }
+    }
+    return;
+  }
+
+  // Broadcasters such as beacon swarms may change address at every packet,
+  // only learn from the addressed ones
+  Address source = packet.GetSourceAddress();
+  if (source != Address::kEmpty) {
+    LearnAddress(source, id);
+  }
+
+  auto route = routes_.find(destination);
+  if (route == routes_.end()) {
+    for (const auto& phy : phy_layers_) {
+      if (id != phy->GetId()) {
+        phy->Receive(packet);
+      }
+    }
+    return;
+  }
+
+  // Receivers may send in turn and change the routes, go over a copy
+  std::vector<PhyLayer*> receivers = route->second;
+  for (PhyLayer* phy : receive_all_phys_) {
+    if (std::find(receivers.begin(), receivers.end(), phy) == receivers.end()) {
+      receivers.push_back(phy);
+    }
+  }
+  for (PhyLayer* phy : receivers) {
     if (id != phy->GetId()) {
       phy->Receive(packet);
     }
   }
 }
 
+void PhyLayerFactory::LearnAddress(const Address& address, uint32_t id) {
+  auto learned = phy_addresses_.find(id);
+  if (learned == phy_addresses_.end()) return;
+
+  auto& addresses = learned->second.addresses;
+  if (std::find(addresses.begin(), addresses.end(), address) !=
+      addresses.end()) {
+    return;
+  }
+
+  PhyLayer* sender = learned->second.phy;
+  if (addresses.size() == kMaxAddressesPerPhy) {
+    auto& route = routes_[addresses.front()];
+    route.erase(std::remove(route.begin(), route.end(), sender), route.end());
+    if (route.empty()) {
+      routes_.erase(addresses.front());
+    }
+    addresses.pop_front();
+  }
+  addresses.push_back(address);
+  routes_[address].push_back(sender);
+}
+
+void PhyLayerFactory::DeferSends(std::vector<DeferredSend>* outbox) {
+  deferred_sends_ = outbox;
+}
+
+void PhyLayerFactory::DeliverDeferred(std::vector<DeferredSend>* outbox) {
+  for (auto& deferred : *outbox) {
+    deferred.factory->Deliver(deferred.packet, deferred.id);
+  }
+  outbox->clear();
+}
+
 void PhyLayerFactory::TimerTick() {
   for (auto& phy : phy_layers_) {
     phy->TimerTick();
@@ -16,16 +16,36 @@
 
 #pragma once
 
+#include <deque>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
+#include "hci/address.h"
 #include "include/phy.h"
 #include "packets/link_layer_packets.h"
 #include "phy_layer.h"
 
 namespace test_vendor_lib {
 
-class PhyLayerFactory {
+using ::bluetooth::hci::Address;
+
+class PhyLayerFactory;
+
+// A packet sent while its delivery is deferred
+struct DeferredSend {
+  PhyLayerFactory* factory;
+  model::packets::LinkLayerPacketView packet;
+  uint32_t id;
+};
+
+// Delivers link layer packets between the phy layers of the devices on it.
+// Packets addressed to a device only go to the phy layers that have sent an
+// addressed packet from that address, and to those taking every packet.
+// Packets without a destination, such as advertisements and inquiries, and
+// packets for an address not heard from yet go to all. Every receiver gets a
+// view of the same serialized packet.
+class PhyLayerFactory : public std::enable_shared_from_this<PhyLayerFactory> {
   friend class PhyLayerImpl;
 
  public:
@@ -37,10 +57,12 @@ class PhyLayerFactory {
 
   uint32_t GetFactoryId();
 
+  // |receive_all| gives the device the packets addressed to others too. The
+  // factory must be owned by a shared_ptr, which the phy layers share.
   std::shared_ptr<PhyLayer> GetPhyLayer(
       const std::function<void(model::packets::LinkLayerPacketView)>&
           device_receive,
-      uint32_t device_id);
+      uint32_t device_id, bool receive_all = false);
 
   void UnregisterPhyLayer(uint32_t id);
 
@@ -48,6 +70,14 @@ class PhyLayerFactory {
 
   virtual std::string ToString() const;
 
+  // While |outbox| is set, packets sent from the calling thread are queued in
+  // it rather than delivered. Devices ticked in parallel use this to leave
+  // each other alone until the tick is over.
+  static void DeferSends(std::vector<DeferredSend>* outbox);
+
+  // Deliver and clear the packets queued in |outbox|, in the order sent
+  static void DeliverDeferred(std::vector<DeferredSend>* outbox);
+
  protected:
   virtual void Send(
       const std::shared_ptr<model::packets::LinkLayerPacketBuilder> packet,
@@ -55,8 +85,23 @@ class PhyLayerFactory {
   virtual void Send(model::packets::LinkLayerPacketView packet, uint32_t id);
 
  private:
+  // Addresses a phy layer is remembered for. A device may use a public, a
+  // random and a resolvable address; the oldest is forgotten past that.
+  static constexpr size_t kMaxAddressesPerPhy = 4;
+
+  void Deliver(model::packets::LinkLayerPacketView packet, uint32_t id);
+  void LearnAddress(const Address& address, uint32_t id);
+
   Phy::Type phy_type_;
   std::vector<std::shared_ptr<PhyLayer>> phy_layers_;
+  std::vector<PhyLayer*> receive_all_phys_;
+  // Phy layers to deliver to for the addresses they have sent from
+  std::unordered_map<Address, std::vector<PhyLayer*>> routes_;
+  struct PhyAddresses {
+    PhyLayer* phy;
+    std::deque<Address> addresses;
+  };
+  std::unordered_map<uint32_t, PhyAddresses> phy_addresses_;
   uint32_t next_id_{1};
   const uint32_t factory_id_;
 };
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sharded_ticker.h"
+
+namespace test_vendor_lib {
+
+ShardedTicker::ShardedTicker(size_t num_shards)
+    : num_shards_(num_shards == 0 ? 1 : num_shards) {
+  for (size_t shard = 1; shard < num_shards_; shard++) {
+    workers_.emplace_back([this, shard]() { Work(shard); });
+  }
+}
+
+ShardedTicker::~ShardedTicker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ShardedTicker::Run(size_t count, const std::function<void(size_t)>& tick) {
+  if (workers_.empty()) {
+    for (size_t i = 0; i < count; i++) {
+      tick(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tick_ = &tick;
+    count_ = count;
+    pending_ = workers_.size();
+    generation_++;
+  }
+  start_.notify_all();
+
+  RunShard(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return pending_ == 0; });
+  tick_ = nullptr;
+}
+
+void ShardedTicker::RunShard(size_t shard) {
+  for (size_t i = shard; i < count_; i += num_shards_) {
+    (*tick_)(i);
+  }
+}
+
+void ShardedTicker::Work(size_t shard) {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [this, generation]() {
+        return stopping_ || generation_ != generation;
+      });
+      if (stopping_) return;
+      generation = generation_;
+    }
+
+    RunShard(shard);
+
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      last = --pending_ == 0;
+    }
+    if (last) done_.notify_one();
+  }
+}
+
+}  // namespace test_vendor_lib
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace test_vendor_lib {
+
+// Runs one step for each of a number of items, spread over a fixed set of
+// threads. Item i always goes to shard i % num_shards, and the calling thread
+// runs shard 0 itself, so a single shard is a plain loop.
+class ShardedTicker {
+ public:
+  explicit ShardedTicker(size_t num_shards);
+  ~ShardedTicker();
+
+  size_t GetNumShards() const { return num_shards_; }
+
+  // Call |tick| for every item in [0, count) and return once all are done.
+  // Items of one shard are ticked in increasing order.
+  void Run(size_t count, const std::function<void(size_t)>& tick);
+
+ private:
+  void RunShard(size_t shard);
+  void Work(size_t shard);
+
+  const size_t num_shards_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  uint64_t generation_{0};
+  size_t pending_{0};
+  bool stopping_{false};
+  size_t count_{0};
+  const std::function<void(size_t)>* tick_{nullptr};
+
+  ShardedTicker(const ShardedTicker&) = delete;
+  ShardedTicker& operator=(const ShardedTicker&) = delete;
+};
+
+}  // namespace test_vendor_lib
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simulation_clock.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace test_vendor_lib {
+
+namespace {
+
+// Devices read the clock from the threads ticking them, in nanoseconds since
+// the steady clock epoch.
+std::atomic<bool> virtual_time_{false};
+std::atomic<int64_t> virtual_now_{0};
+
+}  // namespace
+
+SimulationClock::time_point SimulationClock::Now() {
+  if (!virtual_time_.load(std::memory_order_acquire)) {
+    return std::chrono::steady_clock::now();
+  }
+  return time_point(std::chrono::duration_cast<duration>(
+      std::chrono::nanoseconds(virtual_now_.load(std::memory_order_relaxed))));
+}
+
+void SimulationClock::SetVirtualTime(bool virtual_time) {
+  if (virtual_time == IsVirtualTime()) return;
+  if (virtual_time) {
+    virtual_now_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count(),
+                       std::memory_order_relaxed);
+  }
+  virtual_time_.store(virtual_time, std::memory_order_release);
+}
+
+bool SimulationClock::IsVirtualTime() {
+  return virtual_time_.load(std::memory_order_acquire);
+}
+
+void SimulationClock::Advance(duration delta) {
+  if (!IsVirtualTime()) return;
+  virtual_now_.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(delta).count(),
+      std::memory_order_relaxed);
+}
+
+}  // namespace test_vendor_lib
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+
+namespace test_vendor_lib {
+
+// The time seen by the simulated devices. It is the steady clock, unless the
+// test model drives the simulation in virtual time: the clock then only moves
+// when the model advances it, one timer period per tick, so a run does not
+// depend on how long the ticks take and can go faster than real time.
+class SimulationClock {
+ public:
+  using time_point = std::chrono::steady_clock::time_point;
+  using duration = std::chrono::steady_clock::duration;
+
+  static time_point Now();
+
+  // Switch to virtual time, starting from the current time, or back to the
+  // steady clock.
+  static void SetVirtualTime(bool virtual_time);
+
+  static bool IsVirtualTime();
+
+  // Move virtual time forward by |delta|. Does nothing on the steady clock.
+  static void Advance(duration delta);
+};
+
+}  // namespace test_vendor_lib
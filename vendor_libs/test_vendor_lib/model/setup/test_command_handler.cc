@@ -48,6 +48,9 @@ TestCommandHandler::TestCommandHandler(TestModel& test_model) : model_(test_mode
   SET_HANDLER("set_timer_period", SetTimerPeriod);
   SET_HANDLER("start_timer", StartTimer);
   SET_HANDLER("stop_timer", StopTimer);
+  SET_HANDLER("set_tick_shards", SetTickShards);
+  SET_HANDLER("set_virtual_time", SetVirtualTime);
+  SET_HANDLER("run_ticks", RunTicks);
 #undef SET_HANDLER
 }
 
@@ -251,4 +254,37 @@ void TestCommandHandler::StopTimer(const vector<std::string>& args) {
   model_.StopTimer();
 }
 
+void TestCommandHandler::SetTickShards(const vector<std::string>& args) {
+  if (args.size() != 1) {
+    response_string_ = "set_tick_shards takes 1 argument";
+    send_response_(response_string_);
+    return;
+  }
+  model_.SetTickShards(std::stoi(args[0]));
+  response_string_ = "set_tick_shards " + args[0];
+  send_response_(response_string_);
+}
+
+void TestCommandHandler::SetVirtualTime(const vector<std::string>& args) {
+  if (args.size() != 1 || (args[0] != "on" && args[0] != "off")) {
+    response_string_ = "set_virtual_time takes on or off";
+    send_response_(response_string_);
+    return;
+  }
+  model_.SetVirtualTime(args[0] == "on");
+  response_string_ = "set_virtual_time " + args[0];
+  send_response_(response_string_);
+}
+
+void TestCommandHandler::RunTicks(const vector<std::string>& args) {
+  if (args.size() != 1) {
+    response_string_ = "run_ticks takes 1 argument";
+    send_response_(response_string_);
+    return;
+  }
+  model_.RunTicks(std::stoi(args[0]));
+  response_string_ = "run_ticks " + args[0];
+  send_response_(response_string_);
+}
+
 }  // namespace test_vendor_lib
@@ -79,6 +79,15 @@ class TestCommandHandler {
 
   void StopTimer(const std::vector<std::string>& args);
 
+  // Spread device ticks over threads
+  void SetTickShards(const std::vector<std::string>& args);
+
+  // Switch virtual time "on" or "off"
+  void SetVirtualTime(const std::vector<std::string>& args);
+
+  // Tick a number of times, as fast as possible
+  void RunTicks(const std::vector<std::string>& args);
+
   // For manual testing
   void AddDefaults();
 
@@ -43,6 +43,7 @@
 #include "include/phy.h"
 #include "model/devices/hci_socket_device.h"
 #include "model/devices/link_layer_socket_device.h"
+#include "simulation_clock.h"
 
 using std::vector;
 
@@ -137,7 +138,7 @@ void TestModel::AddDeviceToPhy(size_t dev_index, size_t phy_index) {
       [dev](model::packets::LinkLayerPacketView packet) {
         dev->IncomingPacket(packet);
       },
-      device->first));
+      device->first, dev->ReceivesAllPackets()));
 }
 
 void TestModel::DelDeviceFromPhy(size_t dev_index, size_t phy_index) {
@@ -232,10 +233,62 @@ const std::string& TestModel::List() {
 }
 
 void TestModel::TimerTick() {
-  for (auto dev = devices_.begin(); dev != devices_.end();) {
-    auto tmp = dev;
-    dev++;
-    tmp->second->TimerTick();
+  SimulationClock::Advance(timer_period_);
+
+  if (ticker_ == nullptr) {
+    for (auto dev = devices_.begin(); dev != devices_.end();) {
+      auto tmp = dev;
+      dev++;
+      tmp->second->TimerTick();
+    }
+    return;
+  }
+
+  // Devices may be removed while ticking, hold on to them until the end
+  for (auto& dev : devices_) {
+    tick_devices_.push_back(dev.second);
+  }
+  if (tick_outboxes_.size() < tick_devices_.size()) {
+    tick_outboxes_.resize(tick_devices_.size());
+  }
+
+  ticker_->Run(tick_devices_.size(), [this](size_t i) {
+    PhyLayerFactory::DeferSends(&tick_outboxes_[i]);
+    tick_devices_[i]->TimerTick();
+    PhyLayerFactory::DeferSends(nullptr);
+  });
+
+  for (size_t i = 0; i < tick_devices_.size(); i++) {
+    PhyLayerFactory::DeliverDeferred(&tick_outboxes_[i]);
+  }
+  tick_devices_.clear();
+}
+
+void TestModel::SetTickShards(size_t num_shards) {
+  // Swap the ticker between two ticks, on the thread running them
+  schedule_task_(std::chrono::milliseconds(0), [this, num_shards]() {
+    LOG_INFO("SetTickShards(%zu)", num_shards);
+    if (num_shards <= 1) {
+      ticker_.reset();
+      tick_outboxes_.clear();
+    } else {
+      ticker_ = std::make_unique<ShardedTicker>(num_shards);
+    }
+  });
+}
+
+void TestModel::SetVirtualTime(bool virtual_time) {
+  LOG_INFO("SetVirtualTime(%s)", virtual_time ? "true" : "false");
+  SimulationClock::SetVirtualTime(virtual_time);
+}
+
+void TestModel::RunTicks(size_t count) {
+  if (timer_tick_task_ != kInvalidTaskId) {
+    LOG_WARN("%s: stop the timer first", __func__);
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    TimerTick();
   }
 }
 
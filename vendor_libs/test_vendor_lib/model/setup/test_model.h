@@ -26,6 +26,7 @@
 #include "async_manager.h"
 #include "model/devices/device.h"
 #include "phy_layer_factory.h"
+#include "sharded_ticker.h"
 #include "test_channel_transport.h"
 
 namespace test_vendor_lib {
@@ -78,6 +79,19 @@ class TestModel {
   void StopTimer();
   void SetTimerPeriod(std::chrono::milliseconds new_period);
 
+  // Spread the device ticks over |num_shards| threads. Packets sent during a
+  // tick are then delivered once all devices have ticked, in device order.
+  void SetTickShards(size_t num_shards);
+
+  // Drive the devices from a virtual clock, advanced by the timer period at
+  // each tick, instead of the steady clock
+  void SetVirtualTime(bool virtual_time);
+
+  // Tick |count| times without waiting for the timer, which must be stopped.
+  // With virtual time, this simulates |count| timer periods as fast as the
+  // devices can go.
+  void RunTicks(size_t count);
+
   // List the devices that the test knows about
   const std::string& List();
 
@@ -101,6 +115,11 @@ class TestModel {
   AsyncTaskId timer_tick_task_{kInvalidTaskId};
   std::chrono::milliseconds timer_period_;
 
+  // Set when ticks are sharded
+  std::unique_ptr<ShardedTicker> ticker_;
+  std::vector<std::shared_ptr<Device>> tick_devices_;
+  std::vector<std::vector<DeferredSend>> tick_outboxes_;
+
   TestModel(TestModel& model) = delete;
   TestModel& operator=(const TestModel& model) = delete;
 
@@ -221,6 +221,24 @@ class TestChannelShell(cmd.Cmd):
     """
         self._test_channel.send_command('list', args.split())
 
+    def do_set_tick_shards(self, args):
+        """Arguments: num_shards Spread the device ticks over num_shards threads.
+
+    """
+        self._test_channel.send_command('set_tick_shards', args.split())
+
+    def do_set_virtual_time(self, args):
+        """Arguments: on|off Drive the devices from a virtual clock advanced at each tick.
+
+    """
+        self._test_channel.send_command('set_virtual_time', args.split())
+
+    def do_run_ticks(self, args):
+        """Arguments: count Tick count times as fast as possible, with the timer stopped.
+
+    """
+        self._test_channel.send_command('run_ticks', args.split())
+
     def do_quit(self, args):
         """Arguments: None.
 
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "model/setup/phy_layer_factory.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+namespace test_vendor_lib {
+
+namespace {
+
+const Address kAddress1({0x01, 0x00, 0x00, 0xca, 0x1a, 0xc0});
+const Address kAddress2({0x02, 0x00, 0x00, 0xca, 0x1a, 0xc0});
+const Address kAddress3({0x03, 0x00, 0x00, 0xca, 0x1a, 0xc0});
+
+std::shared_ptr<model::packets::LinkLayerPacketBuilder> Disconnect(
+    const Address& source, const Address& destination) {
+  return model::packets::DisconnectBuilder::Create(source, destination, 0x13);
+}
+
+}  // namespace
+
+class PhyLayerFactoryTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    factory_ = std::make_shared<PhyLayerFactory>(Phy::Type::LOW_ENERGY, 1);
+    received_.resize(4);
+    for (uint32_t i = 0; i < received_.size(); i++) {
+      phys_.push_back(factory_->GetPhyLayer(
+          [this, i](model::packets::LinkLayerPacketView packet) {
+            received_[i].push_back(packet);
+          },
+          i, i == 3));
+    }
+  }
+
+  void TearDown() override {
+    for (auto& phy : phys_) {
+      phy->Unregister();
+    }
+    phys_.clear();
+  }
+
+  std::shared_ptr<PhyLayerFactory> factory_;
+  std::vector<std::shared_ptr<PhyLayer>> phys_;
+  // Phy 3 receives all packets
+  std::vector<std::vector<model::packets::LinkLayerPacketView>> received_;
+};
+
+TEST_F(PhyLayerFactoryTest, broadcastGoesToAll) {
+  phys_[0]->Send(Disconnect(kAddress1, Address::kEmpty));
+  EXPECT_EQ(0u, received_[0].size());
+  EXPECT_EQ(1u, received_[1].size());
+  EXPECT_EQ(1u, received_[2].size());
+  EXPECT_EQ(1u, received_[3].size());
+}
+
+TEST_F(PhyLayerFactoryTest, unknownDestinationGoesToAll) {
+  phys_[0]->Send(Disconnect(kAddress1, kAddress2));
+  EXPECT_EQ(1u, received_[1].size());
+  EXPECT_EQ(1u, received_[2].size());
+  EXPECT_EQ(1u, received_[3].size());
+}
+
+TEST_F(PhyLayerFactoryTest, learnedDestinationIsTargeted) {
+  phys_[0]->Send(Disconnect(kAddress1, kAddress2));
+  phys_[1]->Send(Disconnect(kAddress2, kAddress1));
+  EXPECT_EQ(1u, received_[0].size());
+  EXPECT_EQ(1u, received_[2].size());
+
+  phys_[0]->Send(Disconnect(kAddress1, kAddress2));
+  EXPECT_EQ(2u, received_[1].size());
+  EXPECT_EQ(1u, received_[2].size());
+  EXPECT_EQ(3u, received_[3].size());
+}
+
+TEST_F(PhyLayerFactoryTest, broadcastsDoNotTeachAddresses) {
+  phys_[1]->Send(Disconnect(kAddress2, Address::kEmpty));
+  phys_[0]->Send(Disconnect(kAddress1, kAddress2));
+  EXPECT_EQ(2u, received_[2].size());
+}
+
+TEST_F(PhyLayerFactoryTest, unregisteredPhyIsForgotten) {
+  phys_[0]->Send(Disconnect(kAddress1, kAddress2));
+  phys_[1]->Send(Disconnect(kAddress2, kAddress1));
+  phys_[1]->Unregister();
+
+  // kAddress2 is unknown again
+  phys_[0]->Send(Disconnect(kAddress1, kAddress2));
+  EXPECT_EQ(2u, received_[2].size());
+}
+
+TEST_F(PhyLayerFactoryTest, deferredSendsWaitForDelivery) {
+  std::vector<DeferredSend> outbox;
+  PhyLayerFactory::DeferSends(&outbox);
+  phys_[0]->Send(Disconnect(kAddress1, Address::kEmpty));
+  phys_[0]->Send(Disconnect(kAddress3, Address::kEmpty));
+  PhyLayerFactory::DeferSends(nullptr);
+  EXPECT_EQ(0u, received_[1].size());
+  EXPECT_EQ(2u, outbox.size());
+
+  PhyLayerFactory::DeliverDeferred(&outbox);
+  EXPECT_TRUE(outbox.empty());
+  ASSERT_EQ(2u, received_[1].size());
+  EXPECT_EQ(kAddress1, received_[1][0].GetSourceAddress());
+  EXPECT_EQ(kAddress3, received_[1][1].GetSourceAddress());
+}
+
+}  // namespace test_vendor_lib
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "model/setup/sharded_ticker.h"
+#include "model/setup/simulation_clock.h"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace test_vendor_lib {
+
+TEST(ShardedTickerTest, ticksEveryItemOnce) {
+  for (size_t num_shards : {1, 2, 4, 7}) {
+    ShardedTicker ticker(num_shards);
+    std::vector<std::atomic<int>> ticks(1000);
+    for (int run = 0; run < 10; run++) {
+      ticker.Run(ticks.size(), [&ticks](size_t i) { ticks[i]++; });
+    }
+    for (auto& count : ticks) {
+      ASSERT_EQ(10, count.load()) << num_shards << " shards";
+    }
+  }
+}
+
+TEST(ShardedTickerTest, itemsStayOnTheirShard) {
+  ShardedTicker ticker(4);
+  std::vector<std::thread::id> first_run(100);
+  ticker.Run(first_run.size(), [&first_run](size_t i) {
+    first_run[i] = std::this_thread::get_id();
+  });
+  for (int run = 0; run < 5; run++) {
+    ticker.Run(first_run.size(), [&first_run](size_t i) {
+      EXPECT_EQ(first_run[i], std::this_thread::get_id());
+    });
+  }
+  // The caller runs shard 0
+  EXPECT_EQ(std::this_thread::get_id(), first_run[0]);
+  EXPECT_EQ(first_run[1], first_run[5]);
+  EXPECT_NE(first_run[0], first_run[1]);
+}
+
+TEST(ShardedTickerTest, fewerItemsThanShards) {
+  ShardedTicker ticker(8);
+  std::atomic<int> ticks{0};
+  ticker.Run(3, [&ticks](size_t) { ticks++; });
+  ticker.Run(0, [&ticks](size_t) { ticks++; });
+  EXPECT_EQ(3, ticks.load());
+}
+
+TEST(SimulationClockTest, virtualTimeOnlyMovesWhenAdvanced) {
+  SimulationClock::SetVirtualTime(true);
+  auto start = SimulationClock::Now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_EQ(start, SimulationClock::Now());
+
+  SimulationClock::Advance(std::chrono::seconds(10));
+  EXPECT_EQ(start + std::chrono::seconds(10), SimulationClock::Now());
+
+  SimulationClock::SetVirtualTime(false);
+  SimulationClock::Advance(std::chrono::seconds(10));
+  EXPECT_LT(SimulationClock::Now(), start + std::chrono::seconds(10));
+}
+
+}  // namespace test_vendor_lib